@@ -0,0 +1,232 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "ArrowExport.h"
+
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace Ingester {
+namespace arrow {
+namespace {
+
+    /// \brief Everything an exported ArrowSchema points to.
+    struct SchemaData
+    {
+        std::string format;
+        std::string name;
+        std::vector<std::unique_ptr<ArrowSchema>> children;
+        std::vector<ArrowSchema*> childPtrs;
+        std::unique_ptr<ArrowSchema> dictionary;
+    };
+
+    /// \brief Everything an exported ArrowArray points to.
+    struct ArrayData
+    {
+        std::vector<const void*> buffers;
+        std::vector<std::shared_ptr<const void>> owners;
+        std::vector<std::unique_ptr<ArrowArray>> children;
+        std::vector<ArrowArray*> childPtrs;
+        std::unique_ptr<ArrowArray> dictionary;
+    };
+
+    void releaseSchema(ArrowSchema* schema)
+    {
+        if (schema->release == nullptr) return;
+
+        auto data = static_cast<SchemaData*>(schema->private_data);
+        for (auto& child : data->children)
+        {
+            if (child->release != nullptr) child->release(child.get());
+        }
+
+        if (data->dictionary && data->dictionary->release != nullptr)
+        {
+            data->dictionary->release(data->dictionary.get());
+        }
+
+        delete data;
+        schema->release = nullptr;
+    }
+
+    void releaseArray(ArrowArray* array)
+    {
+        if (array->release == nullptr) return;
+
+        auto data = static_cast<ArrayData*>(array->private_data);
+        for (auto& child : data->children)
+        {
+            if (child->release != nullptr) child->release(child.get());
+        }
+
+        if (data->dictionary && data->dictionary->release != nullptr)
+        {
+            data->dictionary->release(data->dictionary.get());
+        }
+
+        delete data;
+        array->release = nullptr;
+    }
+}  // namespace
+
+    void exportColumn(Column&& column, ArrowSchema* schema, ArrowArray* array)
+    {
+        auto schemaData = new SchemaData();
+        schemaData->format = std::move(column.format);
+        schemaData->name = std::move(column.name);
+
+        auto arrayData = new ArrayData();
+        arrayData->buffers = std::move(column.buffers);
+        arrayData->owners = std::move(column.owners);
+
+        for (auto& child : column.children)
+        {
+            schemaData->children.emplace_back(new ArrowSchema());
+            arrayData->children.emplace_back(new ArrowArray());
+            exportColumn(std::move(child),
+                         schemaData->children.back().get(),
+                         arrayData->children.back().get());
+
+            schemaData->childPtrs.push_back(schemaData->children.back().get());
+            arrayData->childPtrs.push_back(arrayData->children.back().get());
+        }
+
+        if (column.dictionary)
+        {
+            schemaData->dictionary.reset(new ArrowSchema());
+            arrayData->dictionary.reset(new ArrowArray());
+            exportColumn(std::move(*column.dictionary),
+                         schemaData->dictionary.get(),
+                         arrayData->dictionary.get());
+        }
+
+        schema->format = schemaData->format.c_str();
+        schema->name = schemaData->name.c_str();
+        schema->metadata = nullptr;
+        schema->flags = column.flags;
+        schema->n_children = static_cast<int64_t>(schemaData->childPtrs.size());
+        schema->children = schemaData->childPtrs.empty() ? nullptr : schemaData->childPtrs.data();
+        schema->dictionary = schemaData->dictionary.get();
+        schema->release = &releaseSchema;
+        schema->private_data = schemaData;
+
+        array->length = column.length;
+        array->null_count = column.nullCount;
+        array->offset = 0;
+        array->n_buffers = static_cast<int64_t>(arrayData->buffers.size());
+        array->buffers = arrayData->buffers.empty() ? nullptr : arrayData->buffers.data();
+        array->n_children = static_cast<int64_t>(arrayData->childPtrs.size());
+        array->children = arrayData->childPtrs.empty() ? nullptr : arrayData->childPtrs.data();
+        array->dictionary = arrayData->dictionary.get();
+        array->release = &releaseArray;
+        array->private_data = arrayData;
+    }
+
+    Column makeStruct(const std::string& name, int64_t length, std::vector<Column>&& children)
+    {
+        for (const auto& child : children)
+        {
+            if (child.length != length)
+            {
+                std::ostringstream errStr;
+                errStr << "Arrow struct " << name << " has a field (" << child.name << ") ";
+                errStr << "with " << child.length << " rows instead of " << length << ".";
+                throw eckit::BadParameter(errStr.str());
+            }
+        }
+
+        Column column;
+        column.format = "+s";
+        column.name = name;
+        column.length = length;
+        column.buffers = {nullptr};
+        column.children = std::move(children);
+
+        return column;
+    }
+
+    Column nestDims(Column&& values,
+                    const std::vector<int>& dims,
+                    const std::vector<std::string>& dimNames)
+    {
+        Column column = std::move(values);
+
+        // Wrap from the innermost dimension outwards. The length of each level is the product of
+        // the dimensions outside of it.
+        for (size_t dimIdx = dims.size(); dimIdx > 1; --dimIdx)
+        {
+            const auto listSize = dims[dimIdx - 1];
+
+            Column list;
+            list.format = "+w:" + std::to_string(listSize);
+            list.name = column.name;
+            list.length = listSize > 0 ? column.length / listSize : 0;
+            list.buffers = {nullptr};
+
+            column.name = dimIdx - 1 < dimNames.size() ? dimNames[dimIdx - 1] : "item";
+            list.children.push_back(std::move(column));
+            column = std::move(list);
+        }
+
+        return column;
+    }
+
+    Column makeDictionaryStrings(const std::string& name,
+                                 const std::vector<std::string>& data,
+                                 const std::string& missing)
+    {
+        auto indices = std::make_shared<std::vector<int32_t>>(data.size(), 0);
+        auto validity = std::make_shared<std::vector<uint8_t>>((data.size() + 7) / 8, 0);
+        auto offsets = std::make_shared<std::vector<int32_t>>(1, 0);
+        auto chars = std::make_shared<std::string>();
+
+        int64_t nullCount = 0;
+        std::unordered_map<std::string, int32_t> dictIdxs;
+        for (size_t idx = 0; idx < data.size(); ++idx)
+        {
+            if (data[idx] == missing)
+            {
+                ++nullCount;
+                continue;
+            }
+
+            auto entry = dictIdxs.emplace(data[idx], static_cast<int32_t>(dictIdxs.size()));
+            if (entry.second)
+            {
+                chars->append(data[idx]);
+                offsets->push_back(static_cast<int32_t>(chars->size()));
+            }
+
+            (*indices)[idx] = entry.first->second;
+            (*validity)[idx / 8] |= static_cast<uint8_t>(1u << (idx % 8));
+        }
+
+        auto dictionary = std::make_shared<Column>();
+        dictionary->format = "u";
+        dictionary->name = "";
+        dictionary->length = static_cast<int64_t>(dictIdxs.size());
+        dictionary->buffers = {nullptr, offsets->data(), chars->data()};
+        dictionary->owners = {offsets, chars};
+
+        Column column;
+        column.format = "i";
+        column.name = name;
+        column.flags = ARROW_FLAG_NULLABLE;
+        column.length = static_cast<int64_t>(data.size());
+        column.nullCount = nullCount;
+        column.buffers = {nullCount > 0 ? validity->data() : nullptr, indices->data()};
+        column.owners = {validity, indices};
+        column.dictionary = dictionary;
+
+        return column;
+    }
+}  // namespace arrow
+}  // namespace Ingester
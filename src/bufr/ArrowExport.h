@@ -0,0 +1,228 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Structures of the Arrow C data interface, copied verbatim from the specification
+// (https://arrow.apache.org/docs/format/CDataInterface.html) so no Arrow library is needed.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C"
+{
+    struct ArrowSchema
+    {
+        // Array type description
+        const char* format;
+        const char* name;
+        const char* metadata;
+        int64_t flags;
+        int64_t n_children;
+        struct ArrowSchema** children;
+        struct ArrowSchema* dictionary;
+
+        // Release callback
+        void (*release)(struct ArrowSchema*);
+        // Opaque producer-specific data
+        void* private_data;
+    };
+
+    struct ArrowArray
+    {
+        // Array data description
+        int64_t length;
+        int64_t null_count;
+        int64_t offset;
+        int64_t n_buffers;
+        int64_t n_children;
+        const void** buffers;
+        struct ArrowArray** children;
+        struct ArrowArray* dictionary;
+
+        // Release callback
+        void (*release)(struct ArrowArray*);
+        // Opaque producer-specific data
+        void* private_data;
+    };
+}  // extern "C"
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+
+namespace Ingester {
+namespace arrow {
+
+    /// \brief Description of an Arrow array (and its type) that is turned into the C data
+    ///        interface structures by exportColumn. The buffers are only referenced, owners keeps
+    ///        whatever they point into alive until the consumer releases the exported array.
+    struct Column
+    {
+        std::string format;
+        std::string name;
+        int64_t flags = 0;
+        int64_t length = 0;
+        int64_t nullCount = 0;
+        std::vector<const void*> buffers;
+        std::vector<std::shared_ptr<const void>> owners;
+        std::vector<Column> children;
+        std::shared_ptr<Column> dictionary;
+    };
+
+    /// \brief Move a column into the (uninitialized) C data interface structures. The consumer
+    ///        becomes responsible for calling their release callbacks.
+    /// \param column The column to export.
+    /// \param schema The schema structure to fill.
+    /// \param array The array structure to fill.
+    void exportColumn(Column&& column, ArrowSchema* schema, ArrowArray* array);
+
+    /// \brief Make a struct column (one row per element of the children, which must all have the
+    ///        same length).
+    /// \param name The name of the column.
+    /// \param length The number of rows.
+    /// \param children The fields of the struct.
+    Column makeStruct(const std::string& name, int64_t length, std::vector<Column>&& children);
+
+    /// \brief Wrap the flat (row major) values column into nested fixed size lists so it has the
+    ///        shape given by dims (one row per element of dims[0]).
+    /// \param values The leaf values column (length is the product of dims).
+    /// \param dims The dimensions of the data.
+    /// \param dimNames The names to use for the list items of the inner dimensions (dimension
+    ///        paths), "item" is used when there are not enough names.
+    Column nestDims(Column&& values,
+                    const std::vector<int>& dims,
+                    const std::vector<std::string>& dimNames);
+
+    /// \brief Get the Arrow format string for a numeric type.
+    template<typename T>
+    const char* formatFor()
+    {
+        static_assert(std::is_arithmetic<T>::value, "Arrow export needs a numeric type.");
+
+        if (std::is_same<T, float>::value) return "f";
+        if (std::is_same<T, double>::value) return "g";
+
+        switch (sizeof(T))
+        {
+            case 1: return std::is_signed<T>::value ? "c" : "C";
+            case 2: return std::is_signed<T>::value ? "s" : "S";
+            case 4: return std::is_signed<T>::value ? "i" : "I";
+            default: return std::is_signed<T>::value ? "l" : "L";
+        }
+    }
+
+    /// \brief Make the validity bitmap (bit set for valid values) for the elements that are not
+    ///        the missing value.
+    /// \param data The values.
+    /// \param missing The missing value.
+    /// \param nullCount Set to the number of missing values.
+    /// \return The bitmap or an empty pointer if nothing is missing.
+    template<typename T>
+    std::shared_ptr<std::vector<uint8_t>> makeValidity(const std::vector<T>& data,
+                                                       const T& missing,
+                                                       int64_t& nullCount)
+    {
+        auto bitmap = std::make_shared<std::vector<uint8_t>>((data.size() + 7) / 8, 0);
+
+        nullCount = 0;
+        for (size_t idx = 0; idx < data.size(); ++idx)
+        {
+            if (data[idx] == missing)
+            {
+                ++nullCount;
+            }
+            else
+            {
+                (*bitmap)[idx / 8] |= static_cast<uint8_t>(1u << (idx % 8));
+            }
+        }
+
+        if (nullCount == 0) bitmap.reset();
+        return bitmap;
+    }
+
+    /// \brief Make a flat column of numbers with a validity bitmap that is already packed.
+    /// \param name The name of the column.
+    /// \param data The values.
+    /// \param validity The validity bitmap (one bit per value, lowest bit first).
+    /// \param nullCount The number of missing values (the bitmap isn't used if there are none).
+    /// \param validityOwner Object that keeps the bitmap alive.
+    /// \param owner Object that keeps data alive. The values are copied if it's empty.
+    template<typename T>
+    Column makeNumeric(const std::string& name,
+                       const std::vector<T>& data,
+                       const uint8_t* validity,
+                       int64_t nullCount,
+                       std::shared_ptr<const void> validityOwner,
+                       std::shared_ptr<const void> owner)
+    {
+        Column column;
+        column.format = formatFor<T>();
+        column.name = name;
+        column.flags = ARROW_FLAG_NULLABLE;
+        column.length = static_cast<int64_t>(data.size());
+        column.nullCount = nullCount;
+
+        column.buffers.push_back(nullCount > 0 ? validity : nullptr);
+        column.owners.push_back(nullCount > 0 ? std::move(validityOwner) : nullptr);
+
+        if (owner)
+        {
+            column.buffers.push_back(data.data());
+            column.owners.push_back(std::move(owner));
+        }
+        else
+        {
+            auto copy = std::make_shared<std::vector<T>>(data);
+            column.buffers.push_back(copy->data());
+            column.owners.push_back(copy);
+        }
+
+        return column;
+    }
+
+    /// \brief Make a flat column of numbers with a validity bitmap built from the missing value.
+    /// \param name The name of the column.
+    /// \param data The values.
+    /// \param missing The missing value.
+    /// \param owner Object that keeps data alive. The values are copied if it's empty.
+    template<typename T>
+    Column makeNumeric(const std::string& name,
+                       const std::vector<T>& data,
+                       const T& missing,
+                       std::shared_ptr<const void> owner)
+    {
+        int64_t nullCount = 0;
+        auto validity = makeValidity(data, missing, nullCount);
+        return makeNumeric(name,
+                           data,
+                           validity ? validity->data() : nullptr,
+                           nullCount,
+                           validity,
+                           std::move(owner));
+    }
+
+    /// \brief Make a flat dictionary encoded column of strings (int32 indices into a utf8
+    ///        dictionary of the distinct values in order of first appearance). The missing
+    ///        strings are null.
+    /// \param name The name of the column.
+    /// \param data The values.
+    /// \param missing The missing value.
+    Column makeDictionaryStrings(const std::string& name,
+                                 const std::vector<std::string>& data,
+                                 const std::string& missing);
+}  // namespace arrow
+}  // namespace Ingester
@@ -0,0 +1,475 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "BufrDataTransfer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "DataObject.h"
+#include "Query/QueryParser.h"
+
+
+namespace
+{
+    using Ingester::DataObject;
+    using Ingester::DataObjectBase;
+    using Ingester::Dimensions;
+
+    // MPI message tag used for the transfers.
+    const int TransferTag = 7301;
+
+    // Largest piece sent in one MPI message (MPI counts are ints).
+    const size_t MaxMessageBytes = 1 << 30;
+
+    /// \brief The value types of the DataObjects.
+    enum class TypeTag : std::uint8_t
+    {
+        Float,
+        Double,
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        String
+    };
+
+    /// \brief Appends values to a byte buffer.
+    class Writer
+    {
+     public:
+        explicit Writer(std::string& buffer) : buffer_(buffer) {}
+
+        template<typename T>
+        void put(const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Can only put plain values.");
+            buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void put(const std::string& str)
+        {
+            put(static_cast<std::uint64_t>(str.size()));
+            buffer_.append(str);
+        }
+
+        template<typename T>
+        void put(const std::vector<T>& values)
+        {
+            put(static_cast<std::uint64_t>(values.size()));
+            buffer_.append(reinterpret_cast<const char*>(values.data()),
+                           values.size() * sizeof(T));
+        }
+
+        void put(const std::vector<std::string>& values)
+        {
+            put(static_cast<std::uint64_t>(values.size()));
+            for (const auto& value : values) put(value);
+        }
+
+     private:
+        std::string& buffer_;
+    };
+
+    /// \brief Reads values back from a byte buffer made by a Writer.
+    class Reader
+    {
+     public:
+        explicit Reader(const std::string& buffer) : buffer_(buffer) {}
+
+        bool atEnd() const { return pos_ == buffer_.size(); }
+
+        template<typename T>
+        void get(T& value)
+        {
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        }
+
+        void get(std::string& str)
+        {
+            const auto size = count();
+            str.assign(take(size), size);
+        }
+
+        template<typename T>
+        void get(std::vector<T>& values)
+        {
+            const auto size = count();
+            values.resize(size);
+            if (size > 0) std::memcpy(values.data(), take(size * sizeof(T)), size * sizeof(T));
+        }
+
+        void get(std::vector<std::string>& values)
+        {
+            values.resize(count());
+            for (auto& value : values) get(value);
+        }
+
+     private:
+        const std::string& buffer_;
+        size_t pos_ = 0;
+
+        size_t count()
+        {
+            std::uint64_t size = 0;
+            get(size);
+            return static_cast<size_t>(size);
+        }
+
+        const char* take(size_t numBytes)
+        {
+            if (numBytes > buffer_.size() - pos_)
+            {
+                throw eckit::BadValue("BufrDataTransfer: The data buffer is truncated.");
+            }
+
+            const auto data = buffer_.data() + pos_;
+            pos_ += numBytes;
+            return data;
+        }
+    };
+
+    /// \brief The DataObject properties other than its values.
+    struct Header
+    {
+        std::string fieldName;
+        std::string groupByFieldName;
+        std::string query;
+        Dimensions dims;
+        std::vector<Ingester::bufr::Query> dimPaths;
+    };
+
+    void packHeader(const DataObjectBase& object, Writer& writer)
+    {
+        writer.put(object.getFieldName());
+        writer.put(object.getGroupByFieldName());
+        writer.put(object.getPath());
+        writer.put(object.getDims());
+
+        std::vector<std::string> dimPaths;
+        for (const auto& dimPath : object.getDimPaths())
+        {
+            dimPaths.push_back(dimPath.str());
+        }
+
+        writer.put(dimPaths);
+    }
+
+    Header unpackHeader(Reader& reader)
+    {
+        Header header;
+        reader.get(header.fieldName);
+        reader.get(header.groupByFieldName);
+        reader.get(header.query);
+        reader.get(header.dims);
+
+        std::vector<std::string> dimPaths;
+        reader.get(dimPaths);
+        for (const auto& dimPath : dimPaths)
+        {
+            header.dimPaths.push_back(Ingester::bufr::QueryParser::parse(dimPath).front());
+        }
+
+        return header;
+    }
+
+    template<typename T>
+    bool packAs(const std::shared_ptr<DataObjectBase>& object, TypeTag tag, Writer& writer)
+    {
+        const auto typedObject = std::dynamic_pointer_cast<DataObject<T>>(object);
+        if (!typedObject) return false;
+
+        writer.put(tag);
+        packHeader(*typedObject, writer);
+        writer.put(typedObject->getRawData());
+        return true;
+    }
+
+    void packObject(const std::shared_ptr<DataObjectBase>& object, Writer& writer)
+    {
+        if (!packAs<float>(object, TypeTag::Float, writer) &&
+            !packAs<double>(object, TypeTag::Double, writer) &&
+            !packAs<int32_t>(object, TypeTag::Int32, writer) &&
+            !packAs<uint32_t>(object, TypeTag::UInt32, writer) &&
+            !packAs<int64_t>(object, TypeTag::Int64, writer) &&
+            !packAs<uint64_t>(object, TypeTag::UInt64, writer) &&
+            !packAs<std::string>(object, TypeTag::String, writer))
+        {
+            std::ostringstream errStr;
+            errStr << "BufrDataTransfer: Can't send field " << object->getFieldName();
+            errStr << " (unknown type).";
+            throw eckit::BadValue(errStr.str());
+        }
+    }
+
+    template<typename T>
+    std::shared_ptr<DataObjectBase> unpackAs(Reader& reader)
+    {
+        const auto header = unpackHeader(reader);
+
+        std::vector<T> values;
+        reader.get(values);
+
+        return std::make_shared<DataObject<T>>(values,
+                                               header.fieldName,
+                                               header.groupByFieldName,
+                                               header.dims,
+                                               header.query,
+                                               header.dimPaths);
+    }
+
+    std::shared_ptr<DataObjectBase> unpackObject(Reader& reader)
+    {
+        TypeTag tag;
+        reader.get(tag);
+
+        switch (tag)
+        {
+            case TypeTag::Float: return unpackAs<float>(reader);
+            case TypeTag::Double: return unpackAs<double>(reader);
+            case TypeTag::Int32: return unpackAs<int32_t>(reader);
+            case TypeTag::UInt32: return unpackAs<uint32_t>(reader);
+            case TypeTag::Int64: return unpackAs<int64_t>(reader);
+            case TypeTag::UInt64: return unpackAs<uint64_t>(reader);
+            case TypeTag::String: return unpackAs<std::string>(reader);
+        }
+
+        throw eckit::BadValue("BufrDataTransfer: Unknown field type in the data buffer.");
+    }
+
+    /// \brief For each element of a row with the given dimensions, its offset in a row with the
+    ///        (larger or equal) padded dimensions.
+    std::vector<size_t> paddedOffsets(const Dimensions& dims, const Dimensions& paddedDims)
+    {
+        size_t rowSize = 1;
+        for (size_t dimIdx = 1; dimIdx < dims.size(); ++dimIdx) rowSize *= dims[dimIdx];
+
+        std::vector<size_t> offsets(rowSize);
+        for (size_t elemIdx = 0; elemIdx < rowSize; ++elemIdx)
+        {
+            size_t remainder = elemIdx;
+            size_t offset = 0;
+            size_t stride = 1;
+            for (size_t dimIdx = dims.size() - 1; dimIdx >= 1; --dimIdx)
+            {
+                offset += (remainder % dims[dimIdx]) * stride;
+                remainder /= dims[dimIdx];
+                stride *= paddedDims[dimIdx];
+            }
+
+            offsets[elemIdx] = offset;
+        }
+
+        return offsets;
+    }
+
+    template<typename T>
+    bool stackAs(const std::vector<std::shared_ptr<DataObjectBase>>& parts,
+                 std::shared_ptr<DataObjectBase>& stacked)
+    {
+        if (!std::dynamic_pointer_cast<DataObject<T>>(parts.front())) return false;
+
+        const auto& first = *parts.front();
+        auto dims = first.getDims();
+        dims[0] = 0;
+        for (const auto& part : parts)
+        {
+            const auto partDims = part->getDims();
+            if (!std::dynamic_pointer_cast<DataObject<T>>(part) || partDims.size() != dims.size())
+            {
+                std::ostringstream errStr;
+                errStr << "BufrDataTransfer: Field " << first.getFieldName();
+                errStr << " has a different type or shape on some of the ranks.";
+                throw eckit::BadValue(errStr.str());
+            }
+
+            dims[0] += partDims[0];
+            for (size_t dimIdx = 1; dimIdx < dims.size(); ++dimIdx)
+            {
+                dims[dimIdx] = std::max(dims[dimIdx], partDims[dimIdx]);
+            }
+        }
+
+        size_t rowSize = 1;
+        for (size_t dimIdx = 1; dimIdx < dims.size(); ++dimIdx) rowSize *= dims[dimIdx];
+
+        std::vector<T> data(static_cast<size_t>(dims[0]) * rowSize, DataObject<T>::missingValue());
+        size_t rowIdx = 0;
+        for (const auto& part : parts)
+        {
+            const auto& partData = std::static_pointer_cast<DataObject<T>>(part)->getRawData();
+            const auto partDims = part->getDims();
+            const auto offsets = paddedOffsets(partDims, dims);
+
+            for (size_t partRowIdx = 0; partRowIdx < static_cast<size_t>(partDims[0]);
+                 ++partRowIdx, ++rowIdx)
+            {
+                for (size_t elemIdx = 0; elemIdx < offsets.size(); ++elemIdx)
+                {
+                    data[rowIdx * rowSize + offsets[elemIdx]] =
+                        partData[partRowIdx * offsets.size() + elemIdx];
+                }
+            }
+        }
+
+        stacked = std::make_shared<DataObject<T>>(data,
+                                                  first.getFieldName(),
+                                                  first.getGroupByFieldName(),
+                                                  dims,
+                                                  first.getPath(),
+                                                  first.getDimPaths());
+        return true;
+    }
+
+    std::shared_ptr<DataObjectBase>
+    stackObjects(const std::vector<std::shared_ptr<DataObjectBase>>& parts)
+    {
+        if (parts.size() == 1) return parts.front();
+
+        std::shared_ptr<DataObjectBase> stacked;
+        if (!stackAs<float>(parts, stacked) &&
+            !stackAs<double>(parts, stacked) &&
+            !stackAs<int32_t>(parts, stacked) &&
+            !stackAs<uint32_t>(parts, stacked) &&
+            !stackAs<int64_t>(parts, stacked) &&
+            !stackAs<uint64_t>(parts, stacked) &&
+            !stackAs<std::string>(parts, stacked))
+        {
+            std::ostringstream errStr;
+            errStr << "BufrDataTransfer: Can't stack field " << parts.front()->getFieldName();
+            errStr << " (unknown type).";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        return stacked;
+    }
+}  // namespace
+
+namespace Ingester
+{
+    BufrDataMap BufrDataTransfer::gather(const BufrDataMap& dataMap,
+                                         const eckit::mpi::Comm& comm,
+                                         size_t root)
+    {
+        if (comm.size() == 1) return dataMap;
+
+        if (comm.rank() != root)
+        {
+            const auto buffer = pack(dataMap);
+            const auto size = static_cast<std::uint64_t>(buffer.size());
+            comm.send(&size, 1, static_cast<int>(root), TransferTag);
+            for (size_t offset = 0; offset < buffer.size(); offset += MaxMessageBytes)
+            {
+                comm.send(buffer.data() + offset,
+                          std::min(MaxMessageBytes, buffer.size() - offset),
+                          static_cast<int>(root),
+                          TransferTag);
+            }
+
+            return BufrDataMap();
+        }
+
+        std::vector<BufrDataMap> dataMaps(comm.size());
+        for (size_t rank = 0; rank < comm.size(); ++rank)
+        {
+            if (rank == root)
+            {
+                dataMaps[rank] = dataMap;
+                continue;
+            }
+
+            std::uint64_t size = 0;
+            comm.receive(&size, 1, static_cast<int>(rank), TransferTag);
+
+            std::string buffer(static_cast<size_t>(size), '\0');
+            for (size_t offset = 0; offset < buffer.size(); offset += MaxMessageBytes)
+            {
+                comm.receive(&buffer[offset],
+                             std::min(MaxMessageBytes, buffer.size() - offset),
+                             static_cast<int>(rank),
+                             TransferTag);
+            }
+
+            dataMaps[rank] = unpack(buffer);
+        }
+
+        return stack(dataMaps);
+    }
+
+    std::string BufrDataTransfer::pack(const BufrDataMap& dataMap)
+    {
+        std::string buffer;
+        Writer writer(buffer);
+        for (const auto& field : dataMap)
+        {
+            writer.put(field.first);
+            packObject(field.second, writer);
+        }
+
+        return buffer;
+    }
+
+    BufrDataMap BufrDataTransfer::unpack(const std::string& buffer)
+    {
+        BufrDataMap dataMap;
+        Reader reader(buffer);
+        while (!reader.atEnd())
+        {
+            std::string name;
+            reader.get(name);
+            dataMap[name] = unpackObject(reader);
+        }
+
+        return dataMap;
+    }
+
+    BufrDataMap BufrDataTransfer::stack(const std::vector<BufrDataMap>& dataMaps)
+    {
+        const BufrDataMap* firstMap = nullptr;
+        for (const auto& dataMap : dataMaps)
+        {
+            if (!dataMap.empty())
+            {
+                firstMap = &dataMap;
+                break;
+            }
+        }
+
+        BufrDataMap stacked;
+        if (firstMap == nullptr) return stacked;
+
+        for (const auto& field : *firstMap)
+        {
+            std::vector<std::shared_ptr<DataObjectBase>> parts;
+            for (const auto& dataMap : dataMaps)
+            {
+                if (dataMap.empty()) continue;
+
+                const auto partIt = dataMap.find(field.first);
+                if (partIt == dataMap.end())
+                {
+                    std::ostringstream errStr;
+                    errStr << "BufrDataTransfer: Field " << field.first;
+                    errStr << " is missing on some of the ranks.";
+                    throw eckit::BadValue(errStr.str());
+                }
+
+                parts.push_back(partIt->second);
+            }
+
+            stacked[field.first] = stackObjects(parts);
+        }
+
+        return stacked;
+    }
+}  // namespace Ingester
@@ -0,0 +1,50 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "eckit/mpi/Comm.h"
+
+#include "IngesterTypes.h"
+
+
+namespace Ingester
+{
+    /// \brief Moves the fields (BufrDataMap) the MPI ranks collected for their ranges of the BUFR
+    ///        messages to the root rank, where they are stacked back together in rank order.
+    class BufrDataTransfer
+    {
+     public:
+        /// \brief Gather the fields of all the ranks on the root rank (collective).
+        /// \param dataMap The fields of this rank (empty if its messages had no data).
+        /// \param comm The communicator.
+        /// \param root The rank to gather the fields on.
+        /// \return On the root the stacked fields of all the ranks (see stack). Empty on the
+        ///         other ranks.
+        static BufrDataMap gather(const BufrDataMap& dataMap,
+                                  const eckit::mpi::Comm& comm,
+                                  size_t root = 0);
+
+        /// \brief Serialize fields into a byte buffer.
+        /// \param dataMap The fields.
+        static std::string pack(const BufrDataMap& dataMap);
+
+        /// \brief Rebuild the fields from a byte buffer made by pack.
+        /// \param buffer The byte buffer.
+        static BufrDataMap unpack(const std::string& buffer);
+
+        /// \brief Stack the fields of several ranges of messages. The rows are concatenated in
+        ///        order, the other dimensions are padded with missing values to the largest size
+        ///        in any of the ranges (as they would have been if the messages were read
+        ///        together). Empty maps are skipped.
+        /// \param dataMaps The fields of each range, in message order.
+        static BufrDataMap stack(const std::vector<BufrDataMap>& dataMaps);
+    };
+}  // namespace Ingester
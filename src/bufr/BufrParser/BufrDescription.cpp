@@ -9,6 +9,8 @@
 #include <memory>
 
 #include "eckit/exception/Exceptions.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/Duration.h"
 #include "oops/util/IntSetParser.h"
 
 #include "BufrDescription.h"
@@ -20,7 +22,33 @@ namespace
     {
         const char* Filename = "obsdatain";
         const char* TablePath = "tablepath";
+        const char* IndexPath = "indexpath";
+        const char* PlanCachePath = "plancachepath";
+        const char* TableCachePath = "tablecachepath";
+        const char* ResultCachePath = "resultcachepath";
+        const char* MemoryBudget = "memorybudget";
+        const char* SpillPath = "spillpath";
+        const char* NativeDecoding = "nativedecoding";
+        const char* ReadAhead = "readahead";
+        const char* StreamCategories = "streamcategories";
         const char* Exports = "exports";
+        const char* TimeWindow = "time window";
+
+        namespace TimeWindowKeys
+        {
+            const char* Begin = "begin";
+            const char* End = "end";
+            const char* Margin = "margin";
+        }  // namespace TimeWindowKeys
+
+        const char* Sampling = "sampling";
+
+        namespace SamplingKeys
+        {
+            const char* Every = "every";
+            const char* Fraction = "fraction";
+            const char* Seed = "seed";
+        }  // namespace SamplingKeys
     }  // namespace ConfKeys
 }  // namespace
 
@@ -29,7 +57,15 @@ namespace Ingester
     BufrDescription::BufrDescription(const eckit::Configuration &conf) :
         export_(Export(conf.getSubConfiguration(ConfKeys::Exports)))
     {
-        setFilepath(conf.getString(ConfKeys::Filename));
+        // A single path or a list of them (each can be a glob pattern)
+        if (conf.isList(ConfKeys::Filename))
+        {
+            setFilepaths(conf.getStringVector(ConfKeys::Filename));
+        }
+        else
+        {
+            setFilepath(conf.getString(ConfKeys::Filename));
+        }
 
         if (conf.has(ConfKeys::TablePath))
         {
@@ -39,5 +75,137 @@ namespace Ingester
         {
             setTablepath("");
         }
+
+        if (conf.has(ConfKeys::IndexPath))
+        {
+            setIndexpath(conf.getString(ConfKeys::IndexPath));
+        }
+
+        if (conf.has(ConfKeys::PlanCachePath))
+        {
+            setPlanCachePath(conf.getString(ConfKeys::PlanCachePath));
+        }
+
+        if (conf.has(ConfKeys::TableCachePath))
+        {
+            setTableCachePath(conf.getString(ConfKeys::TableCachePath));
+        }
+
+        if (conf.has(ConfKeys::ResultCachePath))
+        {
+            setResultCachePath(conf.getString(ConfKeys::ResultCachePath));
+        }
+
+        if (conf.has(ConfKeys::MemoryBudget))
+        {
+            const auto budgetMB = conf.getDouble(ConfKeys::MemoryBudget);
+            if (budgetMB < 0)
+            {
+                throw eckit::BadParameter("The memory budget (MB) can't be negative.");
+            }
+
+            setMemoryBudget(static_cast<std::uint64_t>(budgetMB * 1024 * 1024));
+        }
+
+        if (conf.has(ConfKeys::SpillPath))
+        {
+            setSpillPath(conf.getString(ConfKeys::SpillPath));
+        }
+
+        if (conf.has(ConfKeys::NativeDecoding))
+        {
+            setNativeDecoding(conf.getBool(ConfKeys::NativeDecoding));
+        }
+
+        if (conf.has(ConfKeys::ReadAhead))
+        {
+            setReadAhead(conf.getBool(ConfKeys::ReadAhead));
+        }
+
+        if (conf.has(ConfKeys::StreamCategories))
+        {
+            setStreamCategories(conf.getBool(ConfKeys::StreamCategories));
+        }
+
+        if (conf.has(ConfKeys::TimeWindow))
+        {
+            const auto windowConf = conf.getSubConfiguration(ConfKeys::TimeWindow);
+            const util::DateTime epoch(1970, 1, 1, 0, 0, 0);
+
+            bufr::TimeWindow timeWindow;
+            timeWindow.start =
+                (util::DateTime(windowConf.getString(ConfKeys::TimeWindowKeys::Begin))
+                    - epoch).toSeconds();
+            timeWindow.end =
+                (util::DateTime(windowConf.getString(ConfKeys::TimeWindowKeys::End))
+                    - epoch).toSeconds();
+
+            if (windowConf.has(ConfKeys::TimeWindowKeys::Margin))
+            {
+                timeWindow.margin = windowConf.getInt(ConfKeys::TimeWindowKeys::Margin);
+            }
+
+            if (timeWindow.end < timeWindow.start)
+            {
+                throw eckit::BadParameter("The time window ends before it begins.");
+            }
+
+            setTimeWindow(timeWindow);
+        }
+
+        if (conf.has(ConfKeys::Sampling))
+        {
+            const auto samplingConf = conf.getSubConfiguration(ConfKeys::Sampling);
+
+            bufr::MessageSampling sampling;
+            if (samplingConf.has(ConfKeys::SamplingKeys::Every))
+            {
+                const auto every = samplingConf.getInt(ConfKeys::SamplingKeys::Every);
+                if (every < 1)
+                {
+                    throw eckit::BadParameter("sampling::every has to be at least 1.");
+                }
+
+                sampling.every = static_cast<size_t>(every);
+            }
+
+            if (samplingConf.has(ConfKeys::SamplingKeys::Fraction))
+            {
+                sampling.fraction = samplingConf.getDouble(ConfKeys::SamplingKeys::Fraction);
+                if (sampling.fraction <= 0 || sampling.fraction > 1)
+                {
+                    throw eckit::BadParameter("sampling::fraction has to be in (0, 1].");
+                }
+            }
+
+            if (samplingConf.has(ConfKeys::SamplingKeys::Seed))
+            {
+                sampling.seed =
+                    static_cast<std::uint64_t>(samplingConf.getInt(ConfKeys::SamplingKeys::Seed));
+            }
+
+            setSampling(sampling);
+        }
+    }
+
+    bool BufrDescription::hasSameInput(const BufrDescription& other) const
+    {
+        if (filepaths_ != other.filepaths_ ||
+            tablepath_ != other.tablepath_ ||
+            indexpath_ != other.indexpath_ ||
+            tableCachePath_ != other.tableCachePath_ ||
+            nativeDecoding_ != other.nativeDecoding_ ||
+            readAhead_ != other.readAhead_ ||
+            skipMessages_ != other.skipMessages_ ||
+            sampling_ != other.sampling_ ||
+            hasTimeWindow_ != other.hasTimeWindow_)
+        {
+            return false;
+        }
+
+        return !hasTimeWindow_ ||
+               (timeWindow_.start == other.timeWindow_.start &&
+                timeWindow_.end == other.timeWindow_.end &&
+                timeWindow_.margin == other.timeWindow_.margin);
     }
 }  // namespace Ingester
@@ -7,16 +7,26 @@
 
 #pragma once
 
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "eckit/config/LocalConfiguration.h"
 
 #include "Exports/Export.h"
+#include "Query/MessageSampling.h"
+#include "Query/TimeWindow.h"
 
 
 namespace Ingester
 {
+    namespace bufr
+    {
+        class SharedTargetCache;
+    }  // namespace bufr
+
     class BufrMnemonicSet;
     class Variable;
 
@@ -31,24 +41,125 @@ namespace Ingester
         /// \param mnemonicSet BufrMnemonicSet to add
         void addMnemonicSet(const BufrMnemonicSet& mnemonicSet);
 
+        /// \brief True if the other description reads the same data (files, tables, sidecars,
+        ///        time window and sampling), so both can be parsed in one pass over the files.
+        /// \param other The other description.
+        bool hasSameInput(const BufrDescription& other) const;
+
         // Setters
-        inline void setFilepath(const std::string& filepath) { filepath_ = filepath; }
+        inline void setFilepath(const std::string& filepath) { filepaths_ = {filepath}; }
+        inline void setFilepaths(const std::vector<std::string>& filepaths)
+        {
+            filepaths_ = filepaths;
+        }
         inline void setTablepath(const std::string& tablepath) { tablepath_ = tablepath; }
+        inline void setIndexpath(const std::string& indexpath) { indexpath_ = indexpath; }
+        inline void setPlanCachePath(const std::string& path) { planCachePath_ = path; }
+        inline void setTableCachePath(const std::string& path) { tableCachePath_ = path; }
+        inline void setResultCachePath(const std::string& path) { resultCachePath_ = path; }
         inline void setExport(const Export& newExport) { export_ = newExport; }
+        inline void setMemoryBudget(std::uint64_t bytes) { memoryBudget_ = bytes; }
+        inline void setSpillPath(const std::string& path) { spillPath_ = path; }
+        inline void setNativeDecoding(bool enable) { nativeDecoding_ = enable; }
+        inline void setReadAhead(bool enable) { readAhead_ = enable; }
+        inline void setStreamCategories(bool enable) { streamCategories_ = enable; }
+        inline void setSkipMessages(size_t count) { skipMessages_ = count; }
+        inline void setTargetCache(const std::shared_ptr<bufr::SharedTargetCache>& targetCache)
+        {
+            targetCache_ = targetCache;
+        }
+        inline void setTimeWindow(const bufr::TimeWindow& timeWindow)
+        {
+            timeWindow_ = timeWindow;
+            hasTimeWindow_ = true;
+        }
+        inline void setSampling(const bufr::MessageSampling& sampling) { sampling_ = sampling; }
 
         // Getters
-        inline std::string filepath() const { return filepath_; }
+        inline std::string filepath() const
+        {
+            return filepaths_.empty() ? std::string() : filepaths_.front();
+        }
+        inline std::vector<std::string> filepaths() const { return filepaths_; }
         inline std::string tablepath() const { return tablepath_; }
+        inline std::string indexpath() const { return indexpath_; }
+        inline std::string planCachePath() const { return planCachePath_; }
+        inline std::string tableCachePath() const { return tableCachePath_; }
+        inline std::string resultCachePath() const { return resultCachePath_; }
         inline Export getExport() const { return export_; }
+        inline std::uint64_t memoryBudget() const { return memoryBudget_; }
+        inline std::string spillPath() const
+        {
+            if (!spillPath_.empty()) return spillPath_;
+
+            const char* tmpDir = std::getenv("TMPDIR");
+            return tmpDir ? std::string(tmpDir) : std::string("/tmp");
+        }
+        inline bool nativeDecoding() const { return nativeDecoding_; }
+        inline bool readAhead() const { return readAhead_; }
+        inline bool streamCategories() const { return streamCategories_; }
+        inline size_t skipMessages() const { return skipMessages_; }
+        inline std::shared_ptr<bufr::SharedTargetCache> targetCache() const
+        {
+            return targetCache_;
+        }
+        inline bool hasTimeWindow() const { return hasTimeWindow_; }
+        inline bufr::TimeWindow timeWindow() const { return timeWindow_; }
+        inline bufr::MessageSampling sampling() const { return sampling_; }
 
      private:
-        /// \brief Specifies the relative path to the BUFR file to read.
-        std::string filepath_;
+        /// \brief Specifies the relative paths (or glob patterns) of the BUFR files to read.
+        std::vector<std::string> filepaths_;
 
         /// \brief Specifies the relative path to the master tables (applies to std BUFR files).
         std::string tablepath_;
 
+        /// \brief Specifies the path to the message index sidecar file (optional).
+        std::string indexpath_;
+
+        /// \brief Specifies the directory to cache the compiled query plans in (optional).
+        std::string planCachePath_;
+
+        /// \brief Specifies the path to the WMO table cache sidecar file (optional).
+        std::string tableCachePath_;
+
+        /// \brief Specifies the directory to cache the query results in (optional, see
+        ///        ResultCache).
+        std::string resultCachePath_;
+
         /// \brief Map of export strings to Variable classes.
         Export export_;
+
+        /// \brief Bytes the exported data can take before sub categories are spilled to disk
+        ///        (0 for no limit, see DataContainer::limitMemory).
+        std::uint64_t memoryBudget_ = 0;
+
+        /// \brief Specifies the directory for the spilled sub categories (defaults to TMPDIR).
+        std::string spillPath_;
+
+        /// \brief Decode the data sections with the native decoder where it can (optional).
+        bool nativeDecoding_ = false;
+
+        /// \brief Read the files through buffers filled ahead of the decoding (optional).
+        bool readAhead_ = false;
+
+        /// \brief Export the variables of the split categories one at a time, when they are
+        ///        encoded, instead of all at once (optional).
+        bool streamCategories_ = false;
+
+        /// \brief Data messages at the start of the files that were already converted (see
+        ///        bufr::FileSet::skipMessages). Set by incremental conversions, not the YAML.
+        size_t skipMessages_ = 0;
+
+        /// \brief Targets shared with the parsers of other files (optional, see
+        ///        bufr::FileSet::setTargetCache). Set by long running conversions, not the YAML.
+        std::shared_ptr<bufr::SharedTargetCache> targetCache_;
+
+        /// \brief Only read the data inside this time window (optional).
+        bool hasTimeWindow_ = false;
+        bufr::TimeWindow timeWindow_;
+
+        /// \brief Only read some of the data messages, for previews (optional).
+        bufr::MessageSampling sampling_;
     };
 }  // namespace Ingester
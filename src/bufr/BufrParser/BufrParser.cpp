@@ -7,75 +7,233 @@
 
 #include "BufrParser.h"
 
+#include <algorithm>
 #include <ostream>
 #include <iostream>
 #include <chrono>  // NOLINT
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
 
 #include "eckit/exception/Exceptions.h"
 #include "oops/util/Logger.h"
 
 #include "DataContainer.h"
+#include "BufrDataTransfer.h"
 #include "DataObject.h"
 #include "Exports/Export.h"
 #include "Exports/Splits/Split.h"
+#include "ResultCache.h"
 
+#include "Query/Parallel.h"
+#include "Query/Profiler.h"
 #include "Query/QuerySet.h"
 
 
 namespace Ingester {
     BufrParser::BufrParser(const BufrDescription &description) :
             description_(description),
-            file_(bufr::File(description_.filepath(),
-                             description_.tablepath()))
+            files_(description_.filepaths(),
+                   description_.tablepath(),
+                   description_.indexpath(),
+                   description_.tableCachePath())
     {
+        if (description_.nativeDecoding()) files_.setNativeDecoding(true);
+        if (description_.readAhead()) files_.setReadAhead(true);
+        if (description_.targetCache()) files_.setTargetCache(description_.targetCache());
+        files_.skipMessages(description_.skipMessages());
+
         // print message
-        oops::Log::info() << "BufrParser: Parsing file " << description_.filepath() << std::endl;
+        for (const auto& filename : files_.filenames())
+        {
+            oops::Log::info() << "BufrParser: Parsing file " << filename << std::endl;
+        }
     }
 
     BufrParser::BufrParser(const eckit::LocalConfiguration &conf) :
             description_(BufrDescription(conf)),
-            file_(bufr::File(description_.filepath(),
-                             description_.tablepath()))
+            files_(description_.filepaths(),
+                   description_.tablepath(),
+                   description_.indexpath(),
+                   description_.tableCachePath())
     {
+        if (description_.nativeDecoding()) files_.setNativeDecoding(true);
+        if (description_.readAhead()) files_.setReadAhead(true);
+        if (description_.targetCache()) files_.setTargetCache(description_.targetCache());
+        files_.skipMessages(description_.skipMessages());
+
         // print message
-        oops::Log::info() << "BufrParser: Parsing file " << description_.filepath() << std::endl;
+        for (const auto& filename : files_.filenames())
+        {
+            oops::Log::info() << "BufrParser: Parsing file " << filename << std::endl;
+        }
     }
 
     BufrParser::~BufrParser()
     {
-        file_.close();
+        files_.close();
     }
 
-    std::shared_ptr<DataContainer> BufrParser::parse(const size_t maxMsgsToParse)
+    std::shared_ptr<DataContainer> BufrParser::parse(const size_t maxMsgsToParse,
+                                                     const size_t numThreads)
     {
         auto startTime = std::chrono::steady_clock::now();
 
-        auto querySet = bufr::QuerySet(description_.getExport().getSubsets());
+        // Only whole files are cached (chunks depend on where the previous parse stopped).
+        const bool useCache = maxMsgsToParse == 0 &&
+                              description_.skipMessages() == 0 &&
+                              !description_.resultCachePath().empty();
+        std::string cacheKey;
+        BufrDataMap srcData;
+        bool isCached = false;
+        if (useCache)
+        {
+            cacheKey = ResultCache::keyFor(files_.filenames(), description_);
+            isCached = ResultCache(description_.resultCachePath()).load(cacheKey, srcData);
+        }
 
-        for (const auto &var : description_.getExport().getVariables())
+        if (isCached)
         {
-            for (const auto &queryPair : var->getQueryList())
+            oops::Log::info() << "Loaded the cached query results" << std::endl;
+        }
+        else
+        {
+            const auto querySet = makeQuerySet(description_);
+
+            oops::Log::info() << "Executing Queries" << std::endl;
+            auto resultSet = [&]()
             {
-                querySet.add(queryPair.name, queryPair.query);
+                bufr::ScopedTimer timer("query.execute");
+                return files_.execute(querySet, maxMsgsToParse, numThreads);
+            }();
+
+            srcData = collectFields(description_, resultSet, numThreads);
+
+            if (useCache) ResultCache(description_.resultCachePath()).store(cacheKey, srcData);
+        }
+
+        oops::Log::info()  << "Exporting Data" << std::endl;
+        auto exportedData = exportData(description_, srcData, numThreads);
+
+        auto timeElapsed = std::chrono::steady_clock::now() - startTime;
+        auto timeElapsedDuration = std::chrono::duration_cast<std::chrono::milliseconds>
+                (timeElapsed);
+        oops::Log::info()  << "Finished "
+                           << "[" << timeElapsedDuration.count() / 1000.0 << "s]"
+                           << std::endl;
+
+        return exportedData;
+    }
+
+    std::vector<std::shared_ptr<DataContainer>>
+    BufrParser::parseShared(const std::vector<BufrDescription>& descriptions,
+                            const size_t maxMsgsToParse,
+                            const size_t numThreads,
+                            std::vector<size_t>* messagesRead)
+    {
+        if (descriptions.empty()) return {};
+
+        for (const auto& description : descriptions)
+        {
+            if (!description.hasSameInput(descriptions.front()))
+            {
+                throw eckit::BadParameter(
+                    "BufrParser::parseShared: The descriptions read different inputs.");
             }
         }
 
-        oops::Log::info() << "Executing Queries" << std::endl;
-        const auto resultSet = file_.execute(querySet, maxMsgsToParse);
+        auto startTime = std::chrono::steady_clock::now();
 
-        oops::Log::info() << "Building Bufr Data" << std::endl;
-        auto srcData = BufrDataMap();
-        for (const auto& var : description_.getExport().getVariables())
+        const auto& inputDescription = descriptions.front();
+
+        // The descriptions with cached results don't need the files.
+        std::vector<BufrDataMap> srcData(descriptions.size());
+        std::vector<std::string> cacheKeys(descriptions.size());
+        std::vector<size_t> uncached;
+        const auto filePaths = bufr::FileSet::expand(inputDescription.filepaths());
+        for (size_t descIdx = 0; descIdx < descriptions.size(); ++descIdx)
         {
-            for (const auto& queryInfo : var->getQueryList())
+            const auto& description = descriptions[descIdx];
+            if (maxMsgsToParse == 0 &&
+                description.skipMessages() == 0 &&
+                !description.resultCachePath().empty())
             {
-                srcData[queryInfo.name] = resultSet.get(
-                    queryInfo.name, queryInfo.groupByField, queryInfo.type);
+                cacheKeys[descIdx] = ResultCache::keyFor(filePaths, description);
+                if (ResultCache(description.resultCachePath()).load(cacheKeys[descIdx],
+                                                                    srcData[descIdx]))
+                {
+                    oops::Log::info() << "Loaded the cached query results for observation type "
+                                      << descIdx << std::endl;
+                    continue;
+                }
             }
+
+            uncached.push_back(descIdx);
         }
 
-        oops::Log::info()  << "Exporting Data" << std::endl;
-        auto exportedData = exportData(srcData);
+        if (!uncached.empty())
+        {
+            auto files = bufr::FileSet(inputDescription.filepaths(),
+                                       inputDescription.tablepath(),
+                                       inputDescription.indexpath(),
+                                       inputDescription.tableCachePath());
+            if (inputDescription.nativeDecoding()) files.setNativeDecoding(true);
+            if (inputDescription.readAhead()) files.setReadAhead(true);
+            if (inputDescription.targetCache())
+            {
+                files.setTargetCache(inputDescription.targetCache());
+            }
+            files.skipMessages(inputDescription.skipMessages());
+
+            for (const auto& filename : files.filenames())
+            {
+                oops::Log::info() << "BufrParser: Parsing file " << filename << " for "
+                                  << uncached.size() << " observation types" << std::endl;
+            }
+
+            std::vector<bufr::QuerySet> querySets;
+            for (const auto descIdx : uncached)
+            {
+                querySets.push_back(makeQuerySet(descriptions[descIdx]));
+            }
+
+            oops::Log::info() << "Executing Queries" << std::endl;
+            auto resultSets = [&]()
+            {
+                bufr::ScopedTimer timer("query.execute");
+                return files.execute(querySets, maxMsgsToParse, numThreads);
+            }();
+
+            if (messagesRead) *messagesRead = files.messagesRead();
+            files.close();
+
+            for (size_t setIdx = 0; setIdx < uncached.size(); ++setIdx)
+            {
+                const auto descIdx = uncached[setIdx];
+                const auto& description = descriptions[descIdx];
+                srcData[descIdx] = collectFields(description, resultSets[setIdx], numThreads);
+
+                // Free the collected data as soon as its fields are built.
+                resultSets[setIdx] = bufr::ResultSet();
+
+                if (!cacheKeys[descIdx].empty())
+                {
+                    ResultCache(description.resultCachePath()).store(cacheKeys[descIdx],
+                                                                     srcData[descIdx]);
+                }
+            }
+        }
+
+        std::vector<std::shared_ptr<DataContainer>> exportedData;
+        for (size_t descIdx = 0; descIdx < descriptions.size(); ++descIdx)
+        {
+            oops::Log::info()  << "Exporting Data" << std::endl;
+            exportedData.push_back(exportData(descriptions[descIdx], srcData[descIdx], numThreads));
+
+            // Free the fields as soon as they are exported.
+            srcData[descIdx] = BufrDataMap();
+        }
 
         auto timeElapsed = std::chrono::steady_clock::now() - startTime;
         auto timeElapsedDuration = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -87,58 +245,383 @@ namespace Ingester {
         return exportedData;
     }
 
-    std::shared_ptr<DataContainer> BufrParser::exportData(const BufrDataMap &srcData) {
-        auto exportDescription = description_.getExport();
+    std::vector<std::shared_ptr<DataContainer>>
+    BufrParser::parseDistributed(const std::vector<BufrDescription>& descriptions,
+                                 const eckit::mpi::Comm& comm,
+                                 const size_t maxMsgsToParse,
+                                 const size_t numThreads)
+    {
+        if (descriptions.empty()) return {};
+
+        for (const auto& description : descriptions)
+        {
+            if (!description.hasSameInput(descriptions.front()))
+            {
+                throw eckit::BadParameter(
+                    "BufrParser::parseDistributed: The descriptions read different inputs.");
+            }
+        }
+
+        // The ranges are split over all the messages of the files.
+        if (descriptions.front().skipMessages() > 0)
+        {
+            throw eckit::BadParameter(
+                "BufrParser::parseDistributed: Can't skip the converted messages.");
+        }
+
+        const size_t root = 0;
+        auto startTime = std::chrono::steady_clock::now();
+
+        const auto& inputDescription = descriptions.front();
+        auto files = bufr::FileSet(inputDescription.filepaths(),
+                                   inputDescription.tablepath(),
+                                   inputDescription.indexpath(),
+                                   inputDescription.tableCachePath());
+        if (inputDescription.nativeDecoding()) files.setNativeDecoding(true);
+        if (inputDescription.readAhead()) files.setReadAhead(true);
+        if (inputDescription.targetCache())
+        {
+            files.setTargetCache(inputDescription.targetCache());
+        }
+
+        std::vector<bufr::QuerySet> querySets;
+        for (const auto& description : descriptions)
+        {
+            querySets.push_back(makeQuerySet(description));
+        }
+
+        // Every rank splits the messages the same way, so there is nothing to communicate.
+        const auto ranges = files.splitMessages(querySets, comm.size(), maxMsgsToParse);
+        const auto& range = ranges[comm.rank()];
+
+        oops::Log::info() << "BufrParser: Rank " << comm.rank() << " parsing " << range.count
+                          << " messages starting at message " << range.first << std::endl;
+
+        std::vector<bufr::ResultSet> resultSets(querySets.size());
+        if (range.count > 0)
+        {
+            files.skipMessages(range.first);
+
+            bufr::ScopedTimer timer("query.execute");
+            resultSets = files.execute(querySets, range.count, numThreads);
+        }
+
+        files.close();
+
+        std::vector<std::shared_ptr<DataContainer>> exportedData(descriptions.size());
+        for (size_t descIdx = 0; descIdx < descriptions.size(); ++descIdx)
+        {
+            BufrDataMap srcData;
+            if (!resultSets[descIdx].empty())
+            {
+                srcData = collectFields(descriptions[descIdx], resultSets[descIdx], numThreads);
+            }
+
+            resultSets[descIdx] = bufr::ResultSet();
+
+            // The filters and splits work on whole rows (ex: over all the channels), which are
+            // only complete once the ranks are stacked, so they are run on the root.
+            srcData = BufrDataTransfer::gather(srcData, comm, root);
+            if (comm.rank() != root) continue;
+
+            if (srcData.empty())
+            {
+                throw eckit::BadValue("ResultSet has no data.");
+            }
+
+            oops::Log::info()  << "Exporting Data" << std::endl;
+            exportedData[descIdx] = exportData(descriptions[descIdx], srcData, numThreads);
+        }
+
+        auto timeElapsed = std::chrono::steady_clock::now() - startTime;
+        auto timeElapsedDuration = std::chrono::duration_cast<std::chrono::milliseconds>
+                (timeElapsed);
+        oops::Log::info()  << "Finished "
+                           << "[" << timeElapsedDuration.count() / 1000.0 << "s]"
+                           << std::endl;
+
+        return exportedData;
+    }
+
+    bufr::QuerySet BufrParser::makeQuerySet(const BufrDescription& description)
+    {
+        auto querySet = bufr::QuerySet(description.getExport().getSubsets());
+        if (description.hasTimeWindow())
+        {
+            querySet.setTimeWindow(description.timeWindow());
+        }
+
+        querySet.setSampling(description.sampling());
+        querySet.setPlanCacheDir(description.planCachePath());
+
+        for (const auto &var : description.getExport().getVariables())
+        {
+            for (const auto &queryPair : var->getQueryList())
+            {
+                querySet.add(queryPair.name, queryPair.query);
+            }
+        }
+
+        // Subsets the splits and filters would drop all the rows of aren't collected at all.
+        // The constraints are checked against the values as they are in the BUFR file, so the
+        // variables with transforms are left to the export.
+        std::set<std::string> transformed;
+        for (const auto &var : description.getExport().getVariables())
+        {
+            if (var->hasTransforms()) transformed.insert(var->getExportName());
+        }
+
+        const auto names = querySet.names();
+        for (const auto& constraint : description.getExport().getValueConstraints())
+        {
+            if (std::find(names.begin(), names.end(), constraint.name) != names.end() &&
+                transformed.find(constraint.name) == transformed.end())
+            {
+                querySet.addValueConstraint(constraint);
+            }
+        }
+
+        return querySet;
+    }
+
+    BufrDataMap BufrParser::collectFields(const BufrDescription& description,
+                                          bufr::ResultSet& resultSet,
+                                          size_t numThreads)
+    {
+        // Every field is only requested once so there is no point in memoizing them.
+        resultSet.setCaching(false);
+
+        oops::Log::info() << "Building Bufr Data" << std::endl;
+        bufr::ScopedTimer timer("query.collect_fields");
+        bufr::Profiler::count("query.frames", resultSet.numFrames());
+        if (bufr::Profiler::isTrackingMemory())
+        {
+            bufr::Profiler::recordBytes("query.result_set", resultSet.byteSize());
+        }
+
+        auto fields = std::vector<bufr::ResultSet::FieldRequest>();
+        for (const auto& var : description.getExport().getVariables())
+        {
+            for (const auto& queryInfo : var->getQueryList())
+            {
+                fields.push_back({queryInfo.name, queryInfo.groupByField, queryInfo.type});
+            }
+        }
+
+        auto srcData = BufrDataMap();
+        const auto dataObjects = resultSet.getMany(fields, numThreads);
+        size_t fieldBytes = 0;
+        for (size_t fieldIdx = 0; fieldIdx < fields.size(); ++fieldIdx)
+        {
+            srcData[fields[fieldIdx].fieldName] = dataObjects[fieldIdx];
+            if (bufr::Profiler::isEnabled())
+            {
+                bufr::Profiler::count("query.field_bytes." + fields[fieldIdx].fieldName,
+                                      dataObjects[fieldIdx]->byteSize());
+                fieldBytes += dataObjects[fieldIdx]->byteSize();
+            }
+        }
+
+        bufr::Profiler::recordBytes("query.fields", fieldBytes);
+        return srcData;
+    }
+
+    std::shared_ptr<DataContainer> BufrParser::exportData(const BufrDescription& description,
+                                                          const BufrDataMap &srcData,
+                                                          size_t numThreads) {
+        auto exportDescription = description.getExport();
 
         auto filters = exportDescription.getFilters();
         auto splits = exportDescription.getSplits();
         auto vars = exportDescription.getVariables();
 
-        // Filter
+        // Filter (the data is sliced once, by the rows all the filters keep)
         BufrDataMap dataCopy = srcData;  // make mutable copy
-        for (const auto &filter : filters)
         {
-            filter->apply(dataCopy);
+            bufr::ScopedTimer timer("export.filters");
+            Filter::apply(filters, dataCopy);
         }
 
-        // Split
-        CategoryMap catMap;
-        for (const auto &split : splits)
+        // Sort (every field is sliced by the same order, so the splits stay in order too)
+        if (exportDescription.getSort())
         {
-            std::ostringstream catName;
-            catName << "splits/" << split->getName();
-            catMap.insert({catName.str(), split->subCategories(dataCopy)});
+            bufr::ScopedTimer timer("export.sort");
+            exportDescription.getSort()->apply(dataCopy, numThreads);
         }
 
+        // Split
+        CategoryMap catMap;
         BufrParser::CatDataMap splitDataMaps;
-        splitDataMaps.insert({std::vector<std::string>(), dataCopy});
-        for (const auto &split : splits)
         {
-            splitDataMaps = splitData(splitDataMaps, *split);
+            bufr::ScopedTimer timer("export.splits");
+            for (const auto &split : splits)
+            {
+                std::ostringstream catName;
+                catName << "splits/" << split->getName();
+                catMap.insert({catName.str(), split->subCategories(dataCopy)});
+            }
+
+            splitDataMaps.insert({std::vector<std::string>(), dataCopy});
+            for (const auto &split : splits)
+            {
+                splitDataMaps = splitData(splitDataMaps, *split);
+            }
         }
 
-        // Export
+        bufr::Profiler::count("export.categories", splitDataMaps.size());
+
+        // With streamed categories the variables of each category are only exported when the
+        // category is needed (ex: encoded), so one category is held at a time.
         auto exportData = std::make_shared<Ingester::DataContainer>(catMap);
+        if (description.streamCategories())
+        {
+            std::vector<std::string> fieldNames;
+            for (const auto& var : vars)
+            {
+                fieldNames.push_back("variables/" + var->getExportName());
+            }
+
+            std::map<SubCategory, size_t> numRows;
+            for (const auto& dataPair : splitDataMaps)
+            {
+                numRows[dataPair.first] = dataPair.second.empty() ?
+                    0 : dataPair.second.begin()->second->getDims().at(0);
+            }
+
+            auto sharedDataMaps = std::make_shared<const CatDataMap>(std::move(splitDataMaps));
+            exportData->produceOnDemand(fieldNames, numRows,
+                [sharedDataMaps, vars, numThreads](const SubCategory& categoryId)
+                {
+                    const auto categoryIt = sharedDataMaps->find(categoryId);
+                    if (categoryIt == sharedDataMaps->end())
+                    {
+                        std::ostringstream errStr;
+                        errStr << "BufrParser: There is no split category";
+                        for (const auto& category : categoryId) errStr << " " << category;
+                        errStr << ".";
+                        throw eckit::BadValue(errStr.str());
+                    }
+
+                    const auto exported = exportVariables(vars, {&*categoryIt}, numThreads);
+
+                    DataSetMap fields;
+                    for (const auto& var : vars)
+                    {
+                        fields.insert({"variables/" + var->getExportName(),
+                                       exported.front().at(var->getExportName())});
+                    }
+
+                    return fields;
+                });
+
+            return exportData;
+        }
+
+        std::vector<const CatDataMap::value_type*> categories;
         for (const auto &dataPair : splitDataMaps)
+        {
+            categories.push_back(&dataPair);
+        }
+
+        const auto exported = exportVariables(vars, categories, numThreads);
+        for (size_t catIdx = 0; catIdx < categories.size(); ++catIdx)
         {
             for (const auto &var : vars)
             {
+                oops::Log::debug() << "Exporting variable = " << var->getExportName() << std::endl;
+
                 std::ostringstream pathStr;
                 pathStr << "variables/" << var->getExportName();
-
-                std::string ovar;
-                ovar = var->getExportName();
-                oops::Log::debug() << "Exporting variable = " << ovar << std::endl;
-
                 exportData->add(pathStr.str(),
-                                var->exportData(dataPair.second),
-                                dataPair.first);
+                                exported[catIdx].at(var->getExportName()),
+                                categories[catIdx]->first);
             }
         }
 
+        if (bufr::Profiler::isTrackingMemory())
+        {
+            bufr::Profiler::recordBytes("export.data_container", exportData->byteSize());
+        }
+
+        if (description.memoryBudget() > 0)
+        {
+            exportData->limitMemory(description.memoryBudget(), description.spillPath());
+        }
+
         return exportData;
     }
 
+    std::vector<ExportedDataMap>
+        BufrParser::exportVariables(const Export::Variables& vars,
+                                    const std::vector<const CatDataMap::value_type*>& categories,
+                                    size_t numThreads)
+    {
+        bufr::ScopedTimer variablesTimer("export.variables");
+
+        // Export. A variable's level is one more than the highest level of its dependencies.
+        // The variables of each level (over all the categories) are exported together, on a
+        // pool of threads unless they aren't thread safe.
+        std::vector<size_t> varLevels(vars.size());
+        std::map<std::string, size_t> levelsByName;
+        size_t numLevels = 0;
+        for (size_t varIdx = 0; varIdx < vars.size(); ++varIdx)
+        {
+            size_t level = 0;
+            for (const auto& dependency : vars[varIdx]->getDependencies())
+            {
+                level = std::max(level, levelsByName.at(dependency) + 1);
+            }
+
+            varLevels[varIdx] = level;
+            levelsByName[vars[varIdx]->getExportName()] = level;
+            numLevels = std::max(numLevels, level + 1);
+        }
+
+        std::vector<ExportedDataMap> exported(categories.size());
+        for (size_t level = 0; level < numLevels; ++level)
+        {
+            // (category, variable) pairs
+            std::vector<std::pair<size_t, size_t>> tasks;
+            std::vector<std::pair<size_t, size_t>> serialTasks;
+            for (size_t catIdx = 0; catIdx < categories.size(); ++catIdx)
+            {
+                for (size_t varIdx = 0; varIdx < vars.size(); ++varIdx)
+                {
+                    if (varLevels[varIdx] != level) continue;
+
+                    auto& levelTasks = vars[varIdx]->isThreadSafe() ? tasks : serialTasks;
+                    levelTasks.push_back({catIdx, varIdx});
+                }
+            }
+
+            tasks.insert(tasks.end(), serialTasks.begin(), serialTasks.end());
+            std::vector<std::shared_ptr<DataObjectBase>> objects(tasks.size());
+            auto exportTask = [&](size_t taskIdx)
+            {
+                const auto catIdx = tasks[taskIdx].first;
+                bufr::ScopedTimer timer("export.variable.",
+                                        vars[tasks[taskIdx].second]->getExportName());
+                objects[taskIdx] = vars[tasks[taskIdx].second]->exportData(
+                    categories[catIdx]->second, exported[catIdx]);
+            };
+
+            const auto numParallel = tasks.size() - serialTasks.size();
+            bufr::parallelFor(numParallel, numThreads, exportTask);
+            for (size_t taskIdx = numParallel; taskIdx < tasks.size(); ++taskIdx)
+            {
+                exportTask(taskIdx);
+            }
+
+            for (size_t taskIdx = 0; taskIdx < tasks.size(); ++taskIdx)
+            {
+                exported[tasks[taskIdx].first].insert(
+                    {vars[tasks[taskIdx].second]->getExportName(), objects[taskIdx]});
+            }
+        }
+
+        return exported;
+    }
+
     BufrParser::CatDataMap BufrParser::splitData(BufrParser::CatDataMap &splitMaps, Split &split)
     {
         CatDataMap splitDataMap;
@@ -160,7 +643,8 @@ namespace Ingester {
 
     void BufrParser::reset()
     {
-        file_.rewind();
+        files_.rewind();
+        files_.skipMessages(description_.skipMessages());
     }
 
     void BufrParser::printMap(const BufrParser::CatDataMap &map)
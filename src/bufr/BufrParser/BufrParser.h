@@ -15,8 +15,9 @@
 #include "Eigen/Dense"
 
 #include "eckit/config/LocalConfiguration.h"
+#include "eckit/mpi/Comm.h"
 
-#include "Query/File.h"
+#include "Query/FileSet.h"
 #include "Parser.h"
 #include "BufrDescription.h"
 
@@ -35,30 +36,108 @@ namespace Ingester {
 
         /// \brief Uses the provided description to parse the buffer file.
         /// \param maxMsgsToParse Messages to parse (0 for everything)
-        std::shared_ptr<DataContainer> parse(const size_t maxMsgsToParse = 0) final;
+        /// \param numThreads Number of threads used to decode the BUFR messages and to build
+        ///        the fields
+        std::shared_ptr<DataContainer> parse(const size_t maxMsgsToParse = 0,
+                                             const size_t numThreads = 1) final;
 
-        /// \brief Start over from beginning of the BUFR file
+        /// \brief Start over from beginning of the BUFR file (after the messages the
+        ///        description skips)
         void reset() final;
 
+        /// \brief Get the number of data messages read from each file so far, the skipped
+        ///        ones included (see bufr::FileSet::messagesRead).
+        std::vector<size_t> messagesRead() const { return files_.messagesRead(); }
+
+        /// \brief Parse several descriptions that read the same BUFR files (see
+        ///        BufrDescription::hasSameInput) with one pass over the files. Each subset is
+        ///        decoded once for all the descriptions that want it.
+        /// \param descriptions The descriptions.
+        /// \param maxMsgsToParse Messages to parse (0 for everything)
+        /// \param numThreads Number of threads used to decode the BUFR messages and to build
+        ///        the fields
+        /// \param messagesRead (Optional) Filled with the number of data messages read from
+        ///        each file, the skipped ones included (unchanged when every description had
+        ///        cached results).
+        /// \return The DataContainer for each description (in the same order).
+        static std::vector<std::shared_ptr<DataContainer>>
+        parseShared(const std::vector<BufrDescription>& descriptions,
+                    const size_t maxMsgsToParse = 0,
+                    const size_t numThreads = 1,
+                    std::vector<size_t>* messagesRead = nullptr);
+
+        /// \brief Parse descriptions that read the same BUFR files (see parseShared) with the
+        ///        messages split over the MPI ranks (collective). Each rank decodes a contiguous
+        ///        range of the messages (see bufr::FileSet::splitMessages) and builds the fields
+        ///        for it. The fields are gathered on the root rank in rank order, which is also
+        ///        the message order, and exported there, so the data is the same as it would be
+        ///        from a single process.
+        /// \param descriptions The descriptions.
+        /// \param comm The communicator to split the messages over.
+        /// \param maxMsgsToParse Messages to parse over all the ranks (0 for everything)
+        /// \param numThreads Number of threads each rank uses to decode its messages and to
+        ///        build the fields
+        /// \return On the root rank the DataContainer for each description (in the same order).
+        ///         Null pointers on the other ranks.
+        static std::vector<std::shared_ptr<DataContainer>>
+        parseDistributed(const std::vector<BufrDescription>& descriptions,
+                         const eckit::mpi::Comm& comm,
+                         const size_t maxMsgsToParse = 0,
+                         const size_t numThreads = 1);
+
      private:
         typedef std::map<std::vector<std::string>, BufrDataMap> CatDataMap;
 
         /// \brief The description the defines what to parse from the BUFR file
         BufrDescription description_;
 
-        /// \brief The Bufr file object we are working with
-        bufr::File file_;
+        /// \brief The Bufr files we are working with
+        bufr::FileSet files_;
+
+        /// \brief Make the QuerySet with all the queries of a description.
+        /// \param description The description.
+        static bufr::QuerySet makeQuerySet(const BufrDescription& description);
+
+        /// \brief Build the fields (the query results) of a description from the collected
+        ///        data.
+        /// \param description The description.
+        /// \param resultSet The data collected for the description's QuerySet.
+        /// \param numThreads Number of threads used to build the fields
+        static BufrDataMap collectFields(const BufrDescription& description,
+                                         bufr::ResultSet& resultSet,
+                                         size_t numThreads);
 
         /// \brief Exports collected data into a DataContainer
+        /// \param description The description of what to export
         /// \param srcData Data to export
-        std::shared_ptr<DataContainer> exportData(const BufrDataMap& srcData);
+        /// \param numThreads Number of threads the variables (of all the categories) are
+        ///        exported on (see Variable::isThreadSafe)
+        /// \note With BufrDescription::streamCategories the variables of each category are
+        ///       exported when its fields are first needed (see DataContainer::produceOnDemand).
+        static std::shared_ptr<DataContainer> exportData(const BufrDescription& description,
+                                                         const BufrDataMap& srcData,
+                                                         size_t numThreads = 1);
+
+        /// \brief Export the variables of some split categories.
+        /// \param vars The variables.
+        /// \param categories The split categories (their data).
+        /// \param numThreads Number of threads the variables (of all the categories) are
+        ///        exported on (see Variable::isThreadSafe)
+        /// \return The exported variables of each category (in the same order).
+        static std::vector<ExportedDataMap>
+            exportVariables(const Export::Variables& vars,
+                            const std::vector<const CatDataMap::value_type*>& categories,
+                            size_t numThreads);
 
         /// \brief Function responsible for dividing the data into subcategories.
         /// \details This function is intended to be called over and over for each specified Split
         ///          object, sub-splitting the data given into all the possible subcategories.
+        ///          The fields of the subcategories are views of the parsed data that share
+        ///          one list of rows per subcategory. Their values are only gathered when a
+        ///          subcategory is written (IodaEncoder frees them again right after).
         /// \param splitMaps Pre-split map of data.
         /// \param split Object that knows how to split data.
-        CatDataMap splitData(CatDataMap& splitMaps, Split& split);
+        static CatDataMap splitData(CatDataMap& splitMaps, Split& split);
 
         /// \brief Opens a BUFR file using the Fortran BUFR interface.
         /// \param filepath Path to bufr file.
@@ -7,13 +7,21 @@
 
 #include "Export.h"
 
+#include <functional>
+#include <map>
 #include <ostream>
 #include <iostream>
+#include <sstream>
 
 #include "eckit/exception/Exceptions.h"
 
 #include "Filters/BoundingFilter.h"
+#include "Filters/DuplicatesFilter.h"
+#include "Filters/RegionFilter.h"
+#include "Filters/ThinningFilter.h"
 #include "Splits/CategorySplit.h"
+#include "Splits/GeoBoxSplit.h"
+#include "Splits/TimeSplit.h"
 #include "Variables/QueryVariable.h"
 #include "Variables/DatetimeVariable.h"
 #include "Variables/WigosidVariable.h"
@@ -35,6 +43,7 @@ namespace
         const char* Variables = "variables";
         const char* GroupByVariable = "group_by_variable";
         const char* Subsets = "subsets";
+        const char* Sort = "sort";
 
         namespace Variable
         {
@@ -52,11 +61,16 @@ namespace
         namespace Split
         {
             const char* Category = "category";
+            const char* Time = "time";
+            const char* GeoBox = "geobox";
         }  // namespace Split
 
         namespace Filter
         {
             const char* Bounding = "bounding";
+            const char* Thinning = "thinning";
+            const char* Region = "region";
+            const char* Duplicates = "duplicates";
         }
     }  // namespace ConfKeys
 }  // namespace
@@ -70,6 +84,11 @@ namespace Ingester
             addFilters(conf.getSubConfiguration(ConfKeys::Filters));
         }
 
+        if (conf.has(ConfKeys::Sort))  // Optional
+        {
+            sort_ = std::make_shared<Sort>(conf.getSubConfiguration(ConfKeys::Sort));
+        }
+
         if (conf.has(ConfKeys::Splits))  // Optional
         {
             addSplits(conf.getSubConfiguration(ConfKeys::Splits));
@@ -90,6 +109,9 @@ namespace Ingester
         {
             addVariables(conf.getSubConfiguration(ConfKeys::Variables),
                          groupByVariable);
+            orderVariables();
+            if (sort_) sort_->resolveFields(variables_);
+            for (const auto& split : splits_) split->resolveVariables(variables_);
         }
         else
         {
@@ -170,6 +192,65 @@ namespace Ingester
         }
     }
 
+    void Export::orderVariables()
+    {
+        std::map<std::string, std::shared_ptr<Variable>> varsByName;
+        for (const auto& var : variables_)
+        {
+            varsByName.insert({var->getExportName(), var});
+        }
+
+        // Depth first, so each variable follows its dependencies (and otherwise keeps its place).
+        enum class State { Visiting, Done };
+        std::map<std::string, State> states;
+        Variables orderedVars;
+        orderedVars.reserve(variables_.size());
+
+        std::function<void(const std::shared_ptr<Variable>&)> visit =
+            [&](const std::shared_ptr<Variable>& var)
+        {
+            const auto stateIt = states.find(var->getExportName());
+            if (stateIt != states.end())
+            {
+                if (stateIt->second == State::Visiting)
+                {
+                    std::ostringstream errStr;
+                    errStr << "The export variable " << var->getExportName();
+                    errStr << " depends on itself (through its dependencies).";
+                    throw eckit::BadParameter(errStr.str());
+                }
+
+                return;
+            }
+
+            states[var->getExportName()] = State::Visiting;
+            for (const auto& dependency : var->getDependencies())
+            {
+                const auto depIt = varsByName.find(dependency);
+                if (depIt == varsByName.end())
+                {
+                    std::ostringstream errStr;
+                    errStr << "The export variable " << var->getExportName();
+                    errStr << " depends on " << dependency;
+                    errStr << ", which is not in the export::variables section.";
+                    throw eckit::BadParameter(errStr.str());
+                }
+
+                visit(depIt->second);
+            }
+
+            states[var->getExportName()] = State::Done;
+            orderedVars.push_back(var);
+        };
+
+        for (const auto& var : variables_)
+        {
+            visit(var);
+        }
+
+        variables_ = orderedVars;
+    }
+
     void Export::addSplits(const eckit::Configuration &conf)
     {
         typedef ObjectFactory<Split,
@@ -178,6 +259,8 @@ namespace Ingester
 
         SplitFactory splitFactory;
         splitFactory.registerObject<CategorySplit>(ConfKeys::Split::Category);
+        splitFactory.registerObject<TimeSplit>(ConfKeys::Split::Time);
+        splitFactory.registerObject<GeoBoxSplit>(ConfKeys::Split::GeoBox);
 
         if (conf.keys().size() == 0)
         {
@@ -197,6 +280,26 @@ namespace Ingester
         }
     }
 
+    std::vector<bufr::ValueConstraint> Export::getValueConstraints() const
+    {
+        std::vector<bufr::ValueConstraint> constraints;
+        for (const auto& split : splits_)
+        {
+            const auto splitConstraints = split->valueConstraints();
+            constraints.insert(constraints.end(), splitConstraints.begin(), splitConstraints.end());
+        }
+
+        for (const auto& filter : filters_)
+        {
+            const auto filterConstraints = filter->valueConstraints();
+            constraints.insert(constraints.end(),
+                               filterConstraints.begin(),
+                               filterConstraints.end());
+        }
+
+        return constraints;
+    }
+
     void Export::addFilters(const eckit::Configuration &conf)
     {
         typedef ObjectFactory<Filter,
@@ -204,6 +307,9 @@ namespace Ingester
 
         FilterFactory filterFactory;
         filterFactory.registerObject<BoundingFilter>(ConfKeys::Filter::Bounding);
+        filterFactory.registerObject<ThinningFilter>(ConfKeys::Filter::Thinning);
+        filterFactory.registerObject<RegionFilter>(ConfKeys::Filter::Region);
+        filterFactory.registerObject<DuplicatesFilter>(ConfKeys::Filter::Duplicates);
 
         auto subConfs = conf.getSubConfigurations();
         if (subConfs.size() == 0)
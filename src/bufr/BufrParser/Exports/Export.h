@@ -13,6 +13,7 @@
 #include "eckit/config/LocalConfiguration.h"
 
 #include "Filters/Filter.h"
+#include "Sort.h"
 #include "Splits/Split.h"
 #include "Variables/Variable.h"
 
@@ -35,14 +36,23 @@ namespace Ingester
 
         // Getters
         inline Splits getSplits() const { return splits_; }
+        /// \brief The variables, ordered so dependencies come first.
         inline Variables getVariables() const { return variables_; }
         inline Filters getFilters() const { return filters_; }
+        /// \brief The order to put the rows in before they are split (null to keep the order
+        ///        of the BUFR files).
+        inline std::shared_ptr<Sort> getSort() const { return sort_; }
         inline std::vector<std::string> getSubsets() const { return subsets_; }
 
+        /// \brief The value constraints of the splits and filters (see
+        ///        bufr::QuerySet::addValueConstraint).
+        std::vector<bufr::ValueConstraint> getValueConstraints() const;
+
      private:
         Splits splits_;
         Variables  variables_;
         Filters filters_;
+        std::shared_ptr<Sort> sort_;
         std::vector<std::string> subsets_;
 
 
@@ -50,6 +60,10 @@ namespace Ingester
         void addVariables(const eckit::Configuration &conf,
                           const std::string& groupByVariable = "");
 
+        /// \brief Order the variables so each one comes after the ones it is computed from (see
+        ///        Variable::getDependencies).
+        void orderVariables();
+
         /// \brief Create Splits exports from config.
         void addSplits(const eckit::Configuration &conf);
 
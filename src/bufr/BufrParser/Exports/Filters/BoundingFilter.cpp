@@ -7,14 +7,13 @@
 
 #include "BoundingFilter.h"
 
+#include <algorithm>
 #include <ostream>
 
 #include "eckit/exception/Exceptions.h"
 
 #include "DataObject.h"
 
-#include "Eigen/Dense"
-
 
 namespace
 {
@@ -29,8 +28,6 @@ namespace
 
 namespace Ingester
 {
-    typedef Eigen::Array<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> EigArray;
-
     BoundingFilter::BoundingFilter(const eckit::LocalConfiguration& conf) :
       Filter(conf),
       variable_(conf.getString(ConfKeys::Variable))
@@ -60,9 +57,22 @@ namespace Ingester
         }
     }
 
-    void BoundingFilter::apply(BufrDataMap& dataMap)
+    std::vector<bufr::ValueConstraint> BoundingFilter::valueConstraints() const
+    {
+        bufr::ValueConstraint constraint;
+        constraint.name = variable_;
+        if (lowerBound_) constraint.lower = *lowerBound_;
+        if (upperBound_) constraint.upper = *upperBound_;
+
+        // Rows with missing values are kept if the missing value is within the bounds.
+        const float missing = DataObject<float>::missingValue();
+        constraint.allowsMissing = missing >= constraint.lower && missing <= constraint.upper;
+
+        return {constraint};
+    }
+
+    void BoundingFilter::mask(const BufrDataMap& dataMap, RowMask& keep) const
     {
-        std::vector<size_t> validRows;
         if (dataMap.find(variable_) == dataMap.end())
         {
             std::ostringstream errStr;
@@ -72,43 +82,25 @@ namespace Ingester
 
         if (const auto& var = std::dynamic_pointer_cast<DataObject<float>>(dataMap.at(variable_)))
         {
-            auto dims = var->getDims();
-            size_t extraDims = 1;
+            const auto view = var->view();
+            const auto aboveLower = [this](float value) { return value >= *lowerBound_; };
+            const auto belowUpper = [this](float value) { return value <= *upperBound_; };
 
-            for (size_t dimIdx = 1; dimIdx < dims.size(); ++dimIdx)
+            for (size_t rowIdx = 0; rowIdx < view.numRows(); rowIdx++)
             {
-                extraDims *= dims[dimIdx];
-            }
+                if (!keep[rowIdx]) continue;
 
-            // Make local copy otherwise you get weird memory corruption issue.
-            auto rawData = var->getRawData();
-            auto array = Eigen::Map<EigArray> (rawData.data(), dims[0], extraDims);
-
-            for (auto rowIdx = 0; rowIdx < dims[0]; rowIdx++)
-            {
+                const auto row = view.row(rowIdx);
                 if (lowerBound_ && upperBound_)
                 {
-                    if ((array.row(rowIdx) >= *lowerBound_).all() &&
-                        (array.row(rowIdx) <= *upperBound_).all())
-                    {
-                        validRows.push_back(rowIdx);
-                    }
+                    keep[rowIdx] = std::all_of(row.begin(), row.end(), aboveLower) &&
+                                   std::all_of(row.begin(), row.end(), belowUpper);
                 }
                 else
                 {
-                    if ((lowerBound_ && (array.row(rowIdx) >= *lowerBound_).all()) ||
-                        (upperBound_ && (array.row(rowIdx) <= *upperBound_).all()))
-                    {
-                        validRows.push_back(rowIdx);
-                    }
-                }
-            }
-
-            if (validRows.size() != static_cast<size_t>(dims[0]))
-            {
-                for (const auto& dataPair : dataMap)
-                {
-                    dataMap[dataPair.first] = dataPair.second->slice(validRows);
+                    keep[rowIdx] =
+                        (lowerBound_ && std::all_of(row.begin(), row.end(), aboveLower)) ||
+                        (upperBound_ && std::all_of(row.begin(), row.end(), belowUpper));
                 }
             }
         }
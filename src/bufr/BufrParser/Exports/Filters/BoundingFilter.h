@@ -25,10 +25,14 @@ namespace Ingester
 
         virtual ~BoundingFilter() = default;
 
-        /// \brief Apply the filter to the dataevant data.
-        void apply(BufrDataMap& dataMap) final;
+        /// \brief Clear the flags of the rows with values out of the bounds.
+        /// \param dataMap The data to filter.
+        /// \param keep The rows to keep.
+        void mask(const BufrDataMap& dataMap, RowMask& keep) const final;
+
+        /// \brief The bounds.
+        std::vector<bufr::ValueConstraint> valueConstraints() const final;
 
-        /// \param dataMap Map to modify by filtering out rel
      private:
          const std::string variable_;
          std::shared_ptr<float> lowerBound_;
@@ -0,0 +1,222 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "DuplicatesFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ostream>
+#include <unordered_map>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "DataObject.h"
+
+
+namespace
+{
+    namespace ConfKeys
+    {
+        const char* Variables = "variables";
+        const char* Resolutions = "resolutions";
+        const char* Keep = "keep";
+        const char* Priority = "priority";
+        const char* Prefer = "prefer";
+    }  // namespace ConfKeys
+
+    /// \brief The code of missing values.
+    const uint64_t MissingCode = ~uint64_t(0);
+}  // namespace
+
+
+namespace Ingester
+{
+    DuplicatesFilter::DuplicatesFilter(const eckit::LocalConfiguration& conf) :
+      Filter(conf),
+      variables_(conf.getStringVector(ConfKeys::Variables))
+    {
+        if (variables_.empty())
+        {
+            std::ostringstream errStr;
+            errStr << "DuplicatesFilter must have a list of variables.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        resolutions_.assign(variables_.size(), 0.0f);
+        if (conf.has(ConfKeys::Resolutions))
+        {
+            resolutions_ = conf.getFloatVector(ConfKeys::Resolutions);
+            if (resolutions_.size() != variables_.size())
+            {
+                std::ostringstream errStr;
+                errStr << "DuplicatesFilter needs one resolution per variable.";
+                throw eckit::BadParameter(errStr.str());
+            }
+        }
+
+        if (conf.has(ConfKeys::Priority))
+        {
+            keep_ = Keep::Priority;
+            priority_ = conf.getString(ConfKeys::Priority);
+            preferLowest_ = conf.has(ConfKeys::Prefer) &&
+                            conf.getString(ConfKeys::Prefer) == "lowest";
+        }
+        else if (conf.has(ConfKeys::Keep))
+        {
+            const auto keep = conf.getString(ConfKeys::Keep);
+            if (keep != "first" && keep != "last")
+            {
+                std::ostringstream errStr;
+                errStr << "DuplicatesFilter keep must be first or last (found " << keep << ").";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            keep_ = (keep == "first") ? Keep::First : Keep::Last;
+        }
+    }
+
+    void DuplicatesFilter::mask(const BufrDataMap& dataMap, RowMask& keep) const
+    {
+        const size_t numRows = keep.size();
+        const size_t numKeys = variables_.size();
+
+        std::vector<uint64_t> codes(numRows * numKeys);
+        for (size_t keyIdx = 0; keyIdx < numKeys; keyIdx++)
+        {
+            encodeKey(dataMap, keyIdx, numRows, codes);
+        }
+
+        std::vector<double> priorities;
+        if (keep_ == Keep::Priority) priorities = rowValues(dataMap, priority_, numRows);
+
+        // Should the row replace the one kept so far (missing priorities are worst)?
+        const auto isBetter = [this, &priorities](size_t rowIdx, size_t bestIdx)
+        {
+            switch (keep_)
+            {
+                case Keep::First:
+                    return false;
+                case Keep::Last:
+                    return true;
+                default:
+                    break;
+            }
+
+            if (std::isnan(priorities[rowIdx])) return false;
+            if (std::isnan(priorities[bestIdx])) return true;
+
+            return preferLowest_ ? priorities[rowIdx] < priorities[bestIdx] :
+                                   priorities[rowIdx] > priorities[bestIdx];
+        };
+
+        // The rows are hashed by their codes, so the map only stores the row indices.
+        const auto hashRow = [&codes, numKeys](size_t rowIdx)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t keyIdx = 0; keyIdx < numKeys; keyIdx++)
+            {
+                hash = (hash ^ codes[rowIdx * numKeys + keyIdx]) * 1099511628211ull;
+            }
+
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        };
+
+        const auto equalRows = [&codes, numKeys](size_t lhsIdx, size_t rhsIdx)
+        {
+            return std::equal(codes.begin() + lhsIdx * numKeys,
+                              codes.begin() + (lhsIdx + 1) * numKeys,
+                              codes.begin() + rhsIdx * numKeys);
+        };
+
+        std::unordered_map<size_t, size_t, decltype(hashRow), decltype(equalRows)>
+            bestRows(numRows, hashRow, equalRows);
+
+        for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+        {
+            if (!keep[rowIdx]) continue;
+
+            const auto result = bestRows.emplace(rowIdx, rowIdx);
+            if (result.second) continue;
+
+            auto& bestIdx = result.first->second;
+            if (isBetter(rowIdx, bestIdx))
+            {
+                keep[bestIdx] = 0;
+                bestIdx = rowIdx;
+            }
+            else
+            {
+                keep[rowIdx] = 0;
+            }
+        }
+    }
+
+    void DuplicatesFilter::encodeKey(const BufrDataMap& dataMap,
+                                     size_t keyIdx,
+                                     size_t numRows,
+                                     std::vector<uint64_t>& codes) const
+    {
+        const auto& variable = variables_[keyIdx];
+        const size_t numKeys = variables_.size();
+
+        if (dataMap.find(variable) == dataMap.end())
+        {
+            std::ostringstream errStr;
+            errStr << "Unknown variable " << variable << " found in duplicates filter.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const auto& object = dataMap.at(variable);
+        if (std::dynamic_pointer_cast<DataObject<std::string>>(object))
+        {
+            // Number the distinct strings
+            std::vector<std::string> values;
+            object->copyAs(values);
+
+            const size_t rowLength = numRows > 0 ? values.size() / numRows : 0;
+            std::unordered_map<std::string, uint64_t> stringCodes;
+            for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+            {
+                uint64_t code = MissingCode;
+                if (rowLength > 0)
+                {
+                    code = stringCodes.emplace(values[rowIdx * rowLength],
+                                               stringCodes.size()).first->second;
+                }
+
+                codes[rowIdx * numKeys + keyIdx] = code;
+            }
+
+            return;
+        }
+
+        const auto values = rowValues(dataMap, variable, numRows);
+        const double resolution = resolutions_[keyIdx];
+        for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+        {
+            const double value = values[rowIdx];
+
+            uint64_t code = MissingCode;
+            if (!std::isnan(value))
+            {
+                if (resolution > 0)
+                {
+                    const auto quantized = static_cast<int64_t>(std::llround(value / resolution));
+                    std::memcpy(&code, &quantized, sizeof(code));
+                }
+                else
+                {
+                    const double exact = value + 0.0;  // -0 == 0
+                    std::memcpy(&code, &exact, sizeof(code));
+                }
+            }
+
+            codes[rowIdx * numKeys + keyIdx] = code;
+        }
+    }
+}  // namespace Ingester
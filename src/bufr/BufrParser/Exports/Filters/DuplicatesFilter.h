@@ -0,0 +1,60 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include "Filter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Ingester
+{
+    /// \brief Class that removes duplicate reports. Rows are duplicates when they have the same
+    ///        values (rounded to a resolution) for all the key variables. One row of each set of
+    ///        duplicates is kept: the last (default) or first one, or the one with the best
+    ///        priority value.
+    class DuplicatesFilter : public Filter
+    {
+     public:
+        /// \brief Constructor
+        /// \param conf The configuration for this filter
+        explicit DuplicatesFilter(const eckit::LocalConfiguration& conf);
+
+        virtual ~DuplicatesFilter() = default;
+
+        /// \brief Clear the flags of the duplicate rows that aren't kept.
+        /// \param dataMap The data to filter.
+        /// \param keep The rows to keep.
+        void mask(const BufrDataMap& dataMap, RowMask& keep) const final;
+
+     private:
+        enum class Keep
+        {
+            First,
+            Last,
+            Priority
+        };
+
+        const std::vector<std::string> variables_;
+        std::vector<float> resolutions_;
+        Keep keep_ = Keep::Last;
+        std::string priority_;
+        bool preferLowest_ = false;
+
+        /// \brief Encode the first value of each row of a key variable as an integer (equal
+        ///        codes are equal values).
+        /// \param dataMap The data.
+        /// \param keyIdx The index of the key variable.
+        /// \param codes The codes of all the key variables (numRows x number of keys).
+        void encodeKey(const BufrDataMap& dataMap,
+                       size_t keyIdx,
+                       size_t numRows,
+                       std::vector<uint64_t>& codes) const;
+    };
+}  // namespace Ingester
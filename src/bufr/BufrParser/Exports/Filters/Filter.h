@@ -6,9 +6,17 @@
  */
 #pragma once
 
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "IngesterTypes.h"
+#include "BufrParser/Query/ValueConstraint.h"
 
 #include "eckit/config/LocalConfiguration.h"
+#include "eckit/exception/Exceptions.h"
 
 namespace Ingester
 {
@@ -20,11 +28,108 @@ namespace Ingester
         /// \param conf The configuration for this filter
         explicit Filter(const eckit::LocalConfiguration& conf) : conf_(conf) {}
 
+        virtual ~Filter() = default;
+
+        /// \brief Flags for the rows of a BufrDataMap (1 to keep the row).
+        typedef std::vector<char> RowMask;
+
+        /// \brief Clear the flags of the rows this filter drops (without changing the data).
+        ///        Rows already dropped by other filters can be skipped.
+        /// \param dataMap The data to filter.
+        /// \param keep The rows to keep (one flag per row of the data).
+        virtual void mask(const BufrDataMap& dataMap, RowMask& keep) const = 0;
+
+        /// \brief The values this filter can keep, so the subsets without them don't have to be
+        ///        collected. Filters that don't only depend on the values of one variable have
+        ///        none.
+        virtual std::vector<bufr::ValueConstraint> valueConstraints() const { return {}; }
+
         /// \brief Apply the filter to the data
         /// \param dataMap Map to modify by filtering out relevant data.
-        virtual void apply(BufrDataMap& dataMap) = 0;
+        void apply(BufrDataMap& dataMap) const
+        {
+            RowMask keep(numRows(dataMap), 1);
+            mask(dataMap, keep);
+            sliceRows(dataMap, keep);
+        }
+
+        /// \brief Apply several filters to the data. The masks of the filters are combined so
+        ///        the data is only sliced once (the same as applying them one after the other).
+        /// \param filters The filters.
+        /// \param dataMap Map to modify by filtering out relevant data.
+        static void apply(const std::vector<std::shared_ptr<Filter>>& filters,
+                          BufrDataMap& dataMap)
+        {
+            if (filters.empty()) return;
+
+            RowMask keep(numRows(dataMap), 1);
+            for (const auto& filter : filters)
+            {
+                filter->mask(dataMap, keep);
+            }
+
+            sliceRows(dataMap, keep);
+        }
 
      protected:
         eckit::LocalConfiguration conf_;
+
+        /// \brief The first value of each row of a numeric variable (missing values are NaN).
+        /// \param dataMap The data.
+        /// \param variable The variable.
+        /// \param numRows The number of rows of the data.
+        static std::vector<double> rowValues(const BufrDataMap& dataMap,
+                                             const std::string& variable,
+                                             size_t numRows)
+        {
+            if (dataMap.find(variable) == dataMap.end())
+            {
+                std::ostringstream errStr;
+                errStr << "Unknown variable " << variable << " found in filter.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            std::vector<double> values;
+            dataMap.at(variable)->copyAs(values);
+
+            std::vector<double> rows(numRows, std::numeric_limits<double>::quiet_NaN());
+            const size_t rowLength = numRows > 0 ? values.size() / numRows : 0;
+            if (rowLength == 0) return rows;
+
+            for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+            {
+                const double value = values[rowIdx * rowLength];
+                if (value != DataObject<double>::missingValue()) rows[rowIdx] = value;
+            }
+
+            return rows;
+        }
+
+     private:
+        /// \brief The number of rows of the data.
+        static size_t numRows(const BufrDataMap& dataMap)
+        {
+            if (dataMap.empty() || dataMap.begin()->second->getDims().empty()) return 0;
+            return dataMap.begin()->second->getDims()[0];
+        }
+
+        /// \brief Keep the flagged rows of every field (nothing is done if all are kept).
+        static void sliceRows(BufrDataMap& dataMap, const RowMask& keep)
+        {
+            auto rows = std::make_shared<std::vector<size_t>>();
+            for (size_t rowIdx = 0; rowIdx < keep.size(); rowIdx++)
+            {
+                if (keep[rowIdx]) rows->push_back(rowIdx);
+            }
+
+            if (rows->size() == keep.size()) return;
+
+            const std::shared_ptr<const std::vector<size_t>> sharedRows = rows;
+            SliceCache cache;
+            for (auto& dataPair : dataMap)
+            {
+                dataPair.second = dataPair.second->slice(sharedRows, cache);
+            }
+        }
     };
 }  // namespace Ingester
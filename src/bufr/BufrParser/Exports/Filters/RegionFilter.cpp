@@ -0,0 +1,305 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "RegionFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    namespace ConfKeys
+    {
+        const char* Latitude = "latitude";
+        const char* Longitude = "longitude";
+        const char* Boxes = "boxes";
+        const char* Polygons = "polygons";
+
+        namespace Box
+        {
+            const char* South = "south";
+            const char* North = "north";
+            const char* West = "west";
+            const char* East = "east";
+        }  // namespace Box
+
+        namespace Polygon
+        {
+            const char* Latitudes = "latitudes";
+            const char* Longitudes = "longitudes";
+        }  // namespace Polygon
+    }  // namespace ConfKeys
+
+    const size_t NumLatCells = 180;
+    const size_t NumLonCells = 360;
+
+    /// \brief Wrap a longitude into [-180, 180).
+    double wrapLongitude(double lon)
+    {
+        if (lon >= -180.0 && lon < 180.0) return lon;
+
+        lon = std::fmod(lon + 180.0, 360.0);
+        if (lon < 0) lon += 360.0;
+        return lon - 180.0;
+    }
+
+    /// \brief Round a coordinate to float precision (the latitudes and longitudes are floats),
+    ///        so the locations on the edges are in the region the way they are within the
+    ///        bounds of a bounding filter.
+    double toFloatPrecision(double value)
+    {
+        return static_cast<double>(static_cast<float>(value));
+    }
+
+    /// \brief Is a point on the segment between two vertices?
+    bool isOnSegment(double lat, double lon, double lat1, double lon1, double lat2, double lon2)
+    {
+        if (lat < std::min(lat1, lat2) || lat > std::max(lat1, lat2) ||
+            lon < std::min(lon1, lon2) || lon > std::max(lon1, lon2))
+        {
+            return false;
+        }
+
+        return (lon2 - lon1) * (lat - lat1) == (lat2 - lat1) * (lon - lon1);
+    }
+
+    size_t latCell(double lat)
+    {
+        return std::min(static_cast<size_t>(std::max(0.0, lat + 90.0)), NumLatCells - 1);
+    }
+}  // namespace
+
+
+namespace Ingester
+{
+    RegionFilter::RegionFilter(const eckit::LocalConfiguration& conf) :
+      Filter(conf),
+      latitude_(conf.getString(ConfKeys::Latitude)),
+      longitude_(conf.getString(ConfKeys::Longitude))
+    {
+        if (conf.has(ConfKeys::Boxes))
+        {
+            for (const auto& boxConf : conf.getSubConfigurations(ConfKeys::Boxes))
+            {
+                const double south = toFloatPrecision(boxConf.getDouble(ConfKeys::Box::South));
+                const double north = toFloatPrecision(boxConf.getDouble(ConfKeys::Box::North));
+                if (north < south)
+                {
+                    std::ostringstream errStr;
+                    errStr << "RegionFilter box north must be greater or equal to south.";
+                    throw eckit::BadParameter(errStr.str());
+                }
+
+                addBox(south,
+                       north,
+                       toFloatPrecision(boxConf.getDouble(ConfKeys::Box::West)),
+                       toFloatPrecision(boxConf.getDouble(ConfKeys::Box::East)));
+            }
+        }
+
+        if (conf.has(ConfKeys::Polygons))
+        {
+            for (const auto& polygonConf : conf.getSubConfigurations(ConfKeys::Polygons))
+            {
+                addPolygon(polygonConf.getDoubleVector(ConfKeys::Polygon::Latitudes),
+                           polygonConf.getDoubleVector(ConfKeys::Polygon::Longitudes));
+            }
+        }
+
+        if (boxes_.empty() && polygons_.empty())
+        {
+            std::ostringstream errStr;
+            errStr << "RegionFilter must contain boxes, polygons or both.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        buildIndex();
+    }
+
+    void RegionFilter::mask(const BufrDataMap& dataMap, RowMask& keep) const
+    {
+        const auto lats = rowValues(dataMap, latitude_, keep.size());
+        const auto lons = rowValues(dataMap, longitude_, keep.size());
+
+        for (size_t rowIdx = 0; rowIdx < keep.size(); rowIdx++)
+        {
+            if (!keep[rowIdx]) continue;
+            keep[rowIdx] = contains(lats[rowIdx], lons[rowIdx]);
+        }
+    }
+
+    bool RegionFilter::contains(double latitude, double longitude) const
+    {
+        if (!(std::abs(latitude) <= 90.0) || !std::isfinite(longitude)) return false;
+
+        const double lon = wrapLongitude(longitude);
+        const size_t lonCell = std::min(static_cast<size_t>(lon + 180.0), NumLonCells - 1);
+        const size_t cell = latCell(latitude) * NumLonCells + lonCell;
+
+        for (auto shapeIdx = cellStarts_[cell]; shapeIdx < cellStarts_[cell + 1]; shapeIdx++)
+        {
+            if (shapeContains(cellShapes_[shapeIdx], latitude, lon)) return true;
+        }
+
+        return false;
+    }
+
+    void RegionFilter::addBox(double south, double north, double west, double east)
+    {
+        if (east - west >= 360.0)
+        {
+            boxes_.push_back({south, north, -180.0, 180.0});
+            return;
+        }
+
+        west = wrapLongitude(west);
+        east = (east == 180.0) ? east : wrapLongitude(east);
+
+        if (west <= east)
+        {
+            boxes_.push_back({south, north, west, east});
+        }
+        else
+        {
+            // Crosses the dateline
+            boxes_.push_back({south, north, west, 180.0});
+            boxes_.push_back({south, north, -180.0, east});
+        }
+    }
+
+    void RegionFilter::addPolygon(const std::vector<double>& lats, const std::vector<double>& lons)
+    {
+        if (lats.size() != lons.size() || lats.size() < 3)
+        {
+            std::ostringstream errStr;
+            errStr << "RegionFilter polygons need the same number (at least 3) of latitudes and ";
+            errStr << "longitudes.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        Polygon polygon;
+        polygon.lats.resize(lats.size());
+        std::transform(lats.begin(), lats.end(), polygon.lats.begin(), toFloatPrecision);
+
+        std::vector<double> roundedLons(lons.size());
+        std::transform(lons.begin(), lons.end(), roundedLons.begin(), toFloatPrecision);
+
+        polygon.lons.resize(lons.size());
+        polygon.lons[0] = wrapLongitude(roundedLons[0]);
+        for (size_t idx = 1; idx < lons.size(); idx++)
+        {
+            // Take the short way around between neighbouring vertices
+            double delta = std::fmod(roundedLons[idx] - roundedLons[idx - 1], 360.0);
+            if (delta > 180.0) delta -= 360.0;
+            if (delta < -180.0) delta += 360.0;
+            polygon.lons[idx] = polygon.lons[idx - 1] + delta;
+        }
+
+        const auto latRange = std::minmax_element(polygon.lats.begin(), polygon.lats.end());
+        const auto lonRange = std::minmax_element(polygon.lons.begin(), polygon.lons.end());
+        polygon.bounds = {*latRange.first, *latRange.second, *lonRange.first, *lonRange.second};
+
+        polygons_.push_back(std::move(polygon));
+    }
+
+    void RegionFilter::buildIndex()
+    {
+        // Count the shapes of each cell, then fill them in (compressed rows).
+        std::vector<std::pair<uint32_t, uint32_t>> cellsAndShapes;
+
+        const auto addBounds = [&cellsAndShapes](const Box& bounds, uint32_t shapeIdx)
+        {
+            const auto firstLon = static_cast<int64_t>(std::floor(bounds.west + 180.0));
+            const auto lastLon = std::min(static_cast<int64_t>(std::floor(bounds.east + 180.0)),
+                                          firstLon + static_cast<int64_t>(NumLonCells) - 1);
+
+            for (size_t latIdx = latCell(bounds.south); latIdx <= latCell(bounds.north); latIdx++)
+            {
+                for (int64_t lonIdx = firstLon; lonIdx <= lastLon; lonIdx++)
+                {
+                    const int64_t wrapped = ((lonIdx % static_cast<int64_t>(NumLonCells)) +
+                                             static_cast<int64_t>(NumLonCells)) % NumLonCells;
+                    const auto cell = static_cast<uint32_t>(latIdx * NumLonCells + wrapped);
+                    cellsAndShapes.push_back({cell, shapeIdx});
+                }
+            }
+        };
+
+        for (size_t boxIdx = 0; boxIdx < boxes_.size(); boxIdx++)
+        {
+            addBounds(boxes_[boxIdx], boxIdx);
+        }
+
+        for (size_t polygonIdx = 0; polygonIdx < polygons_.size(); polygonIdx++)
+        {
+            addBounds(polygons_[polygonIdx].bounds, boxes_.size() + polygonIdx);
+        }
+
+        cellStarts_.assign(NumLatCells * NumLonCells + 1, 0);
+        for (const auto& cellAndShape : cellsAndShapes)
+        {
+            cellStarts_[cellAndShape.first + 1]++;
+        }
+
+        for (size_t cell = 0; cell < NumLatCells * NumLonCells; cell++)
+        {
+            cellStarts_[cell + 1] += cellStarts_[cell];
+        }
+
+        auto nextSlot = cellStarts_;
+        cellShapes_.resize(cellsAndShapes.size());
+        for (const auto& cellAndShape : cellsAndShapes)
+        {
+            cellShapes_[nextSlot[cellAndShape.first]++] = cellAndShape.second;
+        }
+    }
+
+    bool RegionFilter::shapeContains(size_t shapeIdx, double latitude, double longitude) const
+    {
+        if (shapeIdx < boxes_.size())
+        {
+            const auto& box = boxes_[shapeIdx];
+            return latitude >= box.south && latitude <= box.north &&
+                   longitude >= box.west && longitude <= box.east;
+        }
+
+        const auto& polygon = polygons_[shapeIdx - boxes_.size()];
+        const auto& bounds = polygon.bounds;
+        if (latitude < bounds.south || latitude > bounds.north) return false;
+
+        // The polygon longitudes are unwrapped, so try the location a turn either way.
+        for (const double shift : {0.0, 360.0, -360.0})
+        {
+            const double lon = longitude + shift;
+            if (lon < bounds.west || lon > bounds.east) continue;
+
+            // Even-odd rule (ray cast towards the east). The locations on the edges are inside.
+            bool isInside = false;
+            const size_t numVertices = polygon.lats.size();
+            for (size_t idx = 0, prevIdx = numVertices - 1; idx < numVertices; prevIdx = idx++)
+            {
+                const double lat1 = polygon.lats[idx];
+                const double lat2 = polygon.lats[prevIdx];
+                const double lon1 = polygon.lons[idx];
+                const double lon2 = polygon.lons[prevIdx];
+                if (isOnSegment(latitude, lon, lat1, lon1, lat2, lon2)) return true;
+                if ((lat1 > latitude) == (lat2 > latitude)) continue;
+
+                const double crossing = lon1 + (latitude - lat1) / (lat2 - lat1) * (lon2 - lon1);
+                if (lon < crossing) isInside = !isInside;
+            }
+
+            if (isInside) return true;
+        }
+
+        return false;
+    }
+}  // namespace Ingester
@@ -0,0 +1,83 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include "Filter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Ingester
+{
+    /// \brief Class that keeps the locations inside a region made of latitude/longitude boxes
+    ///        (which can cross the dateline) and polygons. The shapes are indexed on a one
+    ///        degree grid so each location is only tested against the shapes near it.
+    class RegionFilter : public Filter
+    {
+     public:
+        /// \brief Constructor
+        /// \param conf The configuration for this filter
+        explicit RegionFilter(const eckit::LocalConfiguration& conf);
+
+        virtual ~RegionFilter() = default;
+
+        /// \brief Clear the flags of the rows outside of the region (or with missing
+        ///        coordinates).
+        /// \param dataMap The data to filter.
+        /// \param keep The rows to keep.
+        void mask(const BufrDataMap& dataMap, RowMask& keep) const final;
+
+        /// \brief Is a location inside the region?
+        /// \param latitude The latitude (degrees).
+        /// \param longitude The longitude (degrees, any range).
+        bool contains(double latitude, double longitude) const;
+
+     private:
+        /// \brief Latitude/longitude bounds (west <= east, longitudes can be outside of
+        ///        [-180, 180] for polygons).
+        struct Box
+        {
+            double south;
+            double north;
+            double west;
+            double east;
+        };
+
+        /// \brief Polygon with its longitudes unwrapped (no jumps of more than 180 degrees
+        ///        between vertices).
+        struct Polygon
+        {
+            std::vector<double> lats;
+            std::vector<double> lons;
+            Box bounds;
+        };
+
+        const std::string latitude_;
+        const std::string longitude_;
+        std::vector<Box> boxes_;
+        std::vector<Polygon> polygons_;
+
+        /// \brief The shapes touching each grid cell (boxes first, then polygons), stored as
+        ///        cellStarts_[cell] to cellStarts_[cell + 1] in cellShapes_.
+        std::vector<uint32_t> cellStarts_;
+        std::vector<uint32_t> cellShapes_;
+
+        /// \brief Add a box, split in two if it crosses the dateline.
+        void addBox(double south, double north, double west, double east);
+
+        /// \brief Add a polygon.
+        void addPolygon(const std::vector<double>& lats, const std::vector<double>& lons);
+
+        /// \brief Build the grid index of the shapes.
+        void buildIndex();
+
+        /// \brief Is a location (with its longitude in [-180, 180)) inside a shape?
+        bool shapeContains(size_t shapeIdx, double latitude, double longitude) const;
+    };
+}  // namespace Ingester
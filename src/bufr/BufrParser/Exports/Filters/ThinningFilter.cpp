@@ -0,0 +1,134 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "ThinningFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <unordered_map>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "DataObject.h"
+
+
+namespace
+{
+    namespace ConfKeys
+    {
+        const char* Latitude = "latitude";
+        const char* Longitude = "longitude";
+        const char* Resolution = "resolution";
+        const char* Priority = "priority";
+        const char* Prefer = "prefer";
+    }  // namespace ConfKeys
+
+    const double EarthRadiusKm = 6371.0;
+    const double DegToRad = M_PI / 180.0;
+}  // namespace
+
+
+namespace Ingester
+{
+    ThinningFilter::ThinningFilter(const eckit::LocalConfiguration& conf) :
+      Filter(conf),
+      latitude_(conf.getString(ConfKeys::Latitude)),
+      longitude_(conf.getString(ConfKeys::Longitude)),
+      priority_(conf.has(ConfKeys::Priority) ? conf.getString(ConfKeys::Priority) : "")
+    {
+        const double resolution = conf.getDouble(ConfKeys::Resolution);
+        if (!(resolution > 0))
+        {
+            std::ostringstream errStr;
+            errStr << "ThinningFilter resolution must be a positive number of km.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        if (conf.has(ConfKeys::Prefer))
+        {
+            const auto prefer = conf.getString(ConfKeys::Prefer);
+            if (prefer != "highest" && prefer != "lowest")
+            {
+                std::ostringstream errStr;
+                errStr << "ThinningFilter prefer must be highest or lowest (found " << prefer;
+                errStr << ").";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            preferLowest_ = (prefer == "lowest");
+        }
+
+        // Bands of equal height, split into cells about as wide as they are high (at the
+        // center of the band) so all the cells have about the same area.
+        bandHeight_ = std::min(180.0, resolution / (EarthRadiusKm * DegToRad));
+        const auto numBands = static_cast<size_t>(std::ceil(180.0 / bandHeight_));
+
+        bandCells_.resize(numBands);
+        for (size_t bandIdx = 0; bandIdx < numBands; bandIdx++)
+        {
+            const double center = std::min(90.0, -90.0 + (bandIdx + 0.5) * bandHeight_);
+            const double cells = std::round(360.0 * std::cos(center * DegToRad) / bandHeight_);
+            bandCells_[bandIdx] = static_cast<uint32_t>(std::max(1.0, cells));
+        }
+    }
+
+    void ThinningFilter::mask(const BufrDataMap& dataMap, RowMask& keep) const
+    {
+        const auto lats = rowValues(dataMap, latitude_, keep.size());
+        const auto lons = rowValues(dataMap, longitude_, keep.size());
+
+        std::vector<double> priorities;
+        if (!priority_.empty()) priorities = rowValues(dataMap, priority_, keep.size());
+
+        // Is the row a better choice than the one kept so far (missing priorities are worst)?
+        const auto isBetter = [this, &priorities](size_t rowIdx, size_t bestIdx)
+        {
+            if (priorities.empty() || std::isnan(priorities[rowIdx])) return false;
+            if (std::isnan(priorities[bestIdx])) return true;
+
+            return preferLowest_ ? priorities[rowIdx] < priorities[bestIdx] :
+                                   priorities[rowIdx] > priorities[bestIdx];
+        };
+
+        std::unordered_map<uint64_t, size_t> bestRows;
+        for (size_t rowIdx = 0; rowIdx < keep.size(); rowIdx++)
+        {
+            if (!keep[rowIdx]) continue;
+            if (!(std::abs(lats[rowIdx]) <= 90) || !std::isfinite(lons[rowIdx])) continue;
+
+            const auto result = bestRows.emplace(cellIndex(lats[rowIdx], lons[rowIdx]), rowIdx);
+            if (result.second) continue;
+
+            auto& bestIdx = result.first->second;
+            if (isBetter(rowIdx, bestIdx))
+            {
+                keep[bestIdx] = 0;
+                bestIdx = rowIdx;
+            }
+            else
+            {
+                keep[rowIdx] = 0;
+            }
+        }
+    }
+
+    uint64_t ThinningFilter::cellIndex(double latitude, double longitude) const
+    {
+        const auto bandIdx = std::min(static_cast<size_t>((latitude + 90.0) / bandHeight_),
+                                      bandCells_.size() - 1);
+
+        const uint32_t numCells = bandCells_[bandIdx];
+        double lon = std::fmod(longitude + 180.0, 360.0);
+        if (lon < 0) lon += 360.0;
+
+        const auto cellIdx = std::min(static_cast<uint32_t>(lon / 360.0 * numCells),
+                                      numCells - 1);
+
+        return (static_cast<uint64_t>(bandIdx) << 32) | cellIdx;
+    }
+}  // namespace Ingester
@@ -0,0 +1,50 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include "Filter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Ingester
+{
+    /// \brief Class that thins the data to (at most) one location per cell of an equal area
+    ///        grid. The location with the best priority value in each cell is kept (the first
+    ///        one if there is no priority). Locations with missing coordinates are kept.
+    class ThinningFilter : public Filter
+    {
+     public:
+        /// \brief Constructor
+        /// \param conf The configuration for this filter
+        explicit ThinningFilter(const eckit::LocalConfiguration& conf);
+
+        virtual ~ThinningFilter() = default;
+
+        /// \brief Clear the flags of the rows that aren't the best of their grid cell.
+        /// \param dataMap The data to filter.
+        /// \param keep The rows to keep.
+        void mask(const BufrDataMap& dataMap, RowMask& keep) const final;
+
+     private:
+        const std::string latitude_;
+        const std::string longitude_;
+        const std::string priority_;
+        bool preferLowest_ = false;
+
+        /// \brief The height of the latitude bands of the grid (degrees).
+        double bandHeight_;
+
+        /// \brief The number of cells in each latitude band (south to north).
+        std::vector<uint32_t> bandCells_;
+
+        /// \brief The grid cell of a location.
+        uint64_t cellIndex(double latitude, double longitude) const;
+    };
+}  // namespace Ingester
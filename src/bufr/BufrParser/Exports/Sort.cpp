@@ -0,0 +1,370 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "Sort.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <ostream>
+#include <unordered_map>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "BufrParser/Query/Parallel.h"
+#include "DataObject.h"
+
+
+namespace
+{
+    namespace ConfKeys
+    {
+        const char* Variables = "variables";
+        const char* Curve = "curve";
+        const char* Latitude = "latitude";
+        const char* Longitude = "longitude";
+    }  // namespace ConfKeys
+
+    /// \brief The code of missing values (sorted last).
+    const uint64_t MissingCode = ~uint64_t(0);
+
+    /// \brief Fewer rows than this are sorted by one thread.
+    const size_t MinParallelRows = 64 * 1024;
+
+    /// \brief A code for a number that compares like the number (the sign bit is flipped for
+    ///        positive numbers, all the bits for negative ones).
+    uint64_t numberCode(double value)
+    {
+        if (value == 0) value = 0;  // -0 and 0 are the same
+
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return (bits & (uint64_t(1) << 63)) ? ~bits : bits | (uint64_t(1) << 63);
+    }
+
+    /// \brief The cell (of a 2^32 by 2^32 grid) of a latitude or longitude.
+    uint32_t gridCoord(double value, double min, double max)
+    {
+        const double scaled = (value - min) / (max - min) * 4294967296.0;
+        return static_cast<uint32_t>(std::min(std::max(scaled, 0.0), 4294967295.0));
+    }
+
+    /// \brief The position of a grid cell along the Hilbert curve.
+    uint64_t hilbertIndex(uint32_t x, uint32_t y)
+    {
+        uint64_t index = 0;
+        for (uint32_t s = uint32_t(1) << 31; s > 0; s >>= 1)
+        {
+            const uint32_t rx = (x & s) ? 1 : 0;
+            const uint32_t ry = (y & s) ? 1 : 0;
+            index += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+
+            // Rotate the quadrant so the curve continues from where it ended.
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = ~x;
+                    y = ~y;
+                }
+
+                std::swap(x, y);
+            }
+        }
+
+        return index;
+    }
+
+    /// \brief Spread the bits of a 32 bit number out to the even bits of a 64 bit one.
+    uint64_t spreadBits(uint32_t value)
+    {
+        uint64_t bits = value;
+        bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFULL;
+        bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FFULL;
+        bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        bits = (bits | (bits << 2)) & 0x3333333333333333ULL;
+        bits = (bits | (bits << 1)) & 0x5555555555555555ULL;
+        return bits;
+    }
+
+    /// \brief The position of a grid cell along the Morton (Z order) curve.
+    uint64_t mortonIndex(uint32_t x, uint32_t y)
+    {
+        return (spreadBits(y) << 1) | spreadBits(x);
+    }
+}  // namespace
+
+
+namespace Ingester
+{
+    Sort::Sort(const eckit::LocalConfiguration& conf)
+    {
+        if (conf.has(ConfKeys::Variables))
+        {
+            variables_ = conf.getStringVector(ConfKeys::Variables);
+            fields_ = variables_;
+        }
+
+        if (conf.has(ConfKeys::Curve))
+        {
+            const auto curve = conf.getString(ConfKeys::Curve);
+            if (curve == "hilbert")
+            {
+                curve_ = Curve::Hilbert;
+            }
+            else if (curve == "morton")
+            {
+                curve_ = Curve::Morton;
+            }
+            else
+            {
+                std::ostringstream errStr;
+                errStr << "exports::sort::curve must be hilbert or morton (found " << curve;
+                errStr << ").";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            if (!conf.has(ConfKeys::Latitude) || !conf.has(ConfKeys::Longitude))
+            {
+                std::ostringstream errStr;
+                errStr << "exports::sort needs the latitude and longitude variables to sort ";
+                errStr << "along a curve.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            latitude_ = conf.getString(ConfKeys::Latitude);
+            longitude_ = conf.getString(ConfKeys::Longitude);
+        }
+
+        if (variables_.empty() && curve_ == Curve::None)
+        {
+            std::ostringstream errStr;
+            errStr << "exports::sort must have a list of variables or a curve.";
+            throw eckit::BadParameter(errStr.str());
+        }
+    }
+
+    void Sort::resolveFields(const std::vector<std::shared_ptr<Variable>>& variables)
+    {
+        fields_.clear();
+        for (const auto& name : variables_)
+        {
+            const auto varIt = std::find_if(variables.begin(), variables.end(),
+                [&name](const std::shared_ptr<Variable>& variable)
+                {
+                    return variable->getExportName() == name;
+                });
+
+            if (varIt == variables.end())
+            {
+                fields_.push_back(name);
+                continue;
+            }
+
+            for (const auto& queryInfo : (*varIt)->getQueryList())
+            {
+                fields_.push_back(queryInfo.name);
+            }
+        }
+    }
+
+    void Sort::apply(BufrDataMap& dataMap, size_t numThreads) const
+    {
+        if (dataMap.empty() || dataMap.begin()->second->getDims().empty()) return;
+
+        const size_t numRows = dataMap.begin()->second->getDims()[0];
+        size_t numKeys = 0;
+        const auto keys = rowKeys(dataMap, numRows, numKeys);
+
+        const auto isBefore = [&keys, numKeys](size_t lhsIdx, size_t rhsIdx)
+        {
+            return std::lexicographical_compare(keys.begin() + lhsIdx * numKeys,
+                                                keys.begin() + (lhsIdx + 1) * numKeys,
+                                                keys.begin() + rhsIdx * numKeys,
+                                                keys.begin() + (rhsIdx + 1) * numKeys);
+        };
+
+        auto rows = std::make_shared<std::vector<size_t>>(numRows);
+        std::iota(rows->begin(), rows->end(), 0);
+
+        // Each thread sorts a piece of the rows, then the pieces are merged in pairs.
+        const size_t numPieces =
+            (numRows < MinParallelRows) ? 1 : std::max<size_t>(numThreads, 1);
+        const size_t pieceSize = (numRows + numPieces - 1) / numPieces;
+        const auto pieceStart = [&rows, pieceSize](size_t pieceIdx)
+        {
+            return rows->begin() + std::min(pieceIdx * pieceSize, rows->size());
+        };
+
+        bufr::parallelFor(numPieces, numThreads, [&](size_t pieceIdx)
+        {
+            std::stable_sort(pieceStart(pieceIdx), pieceStart(pieceIdx + 1), isBefore);
+        });
+
+        for (size_t width = 1; width < numPieces; width *= 2)
+        {
+            const size_t numMerges = (numPieces + 2 * width - 1) / (2 * width);
+            bufr::parallelFor(numMerges, numThreads, [&](size_t mergeIdx)
+            {
+                const size_t firstPiece = mergeIdx * 2 * width;
+                std::inplace_merge(pieceStart(firstPiece),
+                                   pieceStart(std::min(firstPiece + width, numPieces)),
+                                   pieceStart(std::min(firstPiece + 2 * width, numPieces)),
+                                   isBefore);
+            });
+        }
+
+        if (std::is_sorted(rows->begin(), rows->end())) return;
+
+        const std::shared_ptr<const std::vector<size_t>> sharedRows = rows;
+        SliceCache cache;
+        for (auto& dataPair : dataMap)
+        {
+            dataPair.second = dataPair.second->slice(sharedRows, cache);
+        }
+    }
+
+    std::vector<uint64_t> Sort::rowKeys(const BufrDataMap& dataMap,
+                                        size_t numRows,
+                                        size_t& numKeys) const
+    {
+        numKeys = fields_.size() + (curve_ != Curve::None ? 1 : 0);
+
+        std::vector<uint64_t> keys(numRows * numKeys);
+        size_t keyIdx = 0;
+        if (curve_ != Curve::None)
+        {
+            appendCurveKeys(dataMap, numRows, keyIdx++, numKeys, keys);
+        }
+
+        for (const auto& field : fields_)
+        {
+            appendFieldKeys(dataMap, field, numRows, keyIdx++, numKeys, keys);
+        }
+
+        return keys;
+    }
+
+    void Sort::appendCurveKeys(const BufrDataMap& dataMap,
+                               size_t numRows,
+                               size_t keyIdx,
+                               size_t numKeys,
+                               std::vector<uint64_t>& keys) const
+    {
+        // The first values of the rows (as doubles, missing is the missing value).
+        const auto rowValues = [&dataMap, numRows](const std::string& variable)
+        {
+            if (dataMap.find(variable) == dataMap.end())
+            {
+                std::ostringstream errStr;
+                errStr << "Unknown variable " << variable << " found in sort.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            std::vector<double> values;
+            dataMap.at(variable)->copyAs(values);
+
+            std::vector<double> rows(numRows, DataObject<double>::missingValue());
+            const size_t rowLength = numRows > 0 ? values.size() / numRows : 0;
+            for (size_t rowIdx = 0; rowLength > 0 && rowIdx < numRows; rowIdx++)
+            {
+                rows[rowIdx] = values[rowIdx * rowLength];
+            }
+
+            return rows;
+        };
+
+        const auto lats = rowValues(latitude_);
+        const auto lons = rowValues(longitude_);
+        for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+        {
+            auto& key = keys[rowIdx * numKeys + keyIdx];
+
+            const double lat = lats[rowIdx];
+            double lon = lons[rowIdx];
+            if (!(std::abs(lat) <= 90) || !std::isfinite(lon) ||
+                lon == DataObject<double>::missingValue())
+            {
+                key = MissingCode;
+                continue;
+            }
+
+            lon = std::fmod(lon + 180.0, 360.0);
+            if (lon < 0) lon += 360.0;
+
+            const auto x = gridCoord(lon, 0.0, 360.0);
+            const auto y = gridCoord(lat, -90.0, 90.0);
+            key = (curve_ == Curve::Hilbert) ? hilbertIndex(x, y) : mortonIndex(x, y);
+        }
+    }
+
+    void Sort::appendFieldKeys(const BufrDataMap& dataMap,
+                               const std::string& field,
+                               size_t numRows,
+                               size_t keyIdx,
+                               size_t numKeys,
+                               std::vector<uint64_t>& keys) const
+    {
+        if (dataMap.find(field) == dataMap.end())
+        {
+            std::ostringstream errStr;
+            errStr << "Unknown variable " << field << " found in sort.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const auto& object = dataMap.at(field);
+        if (std::dynamic_pointer_cast<DataObject<std::string>>(object))
+        {
+            // The codes of the strings are their ranks among the distinct strings.
+            std::vector<std::string> values;
+            object->copyAs(values);
+
+            const size_t rowLength = numRows > 0 ? values.size() / numRows : 0;
+            std::vector<std::string> distinct;
+            if (rowLength > 0)
+            {
+                for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+                {
+                    distinct.push_back(values[rowIdx * rowLength]);
+                }
+
+                std::sort(distinct.begin(), distinct.end());
+                distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+            }
+
+            std::unordered_map<std::string, uint64_t> ranks;
+            for (size_t rank = 0; rank < distinct.size(); rank++)
+            {
+                ranks.emplace(distinct[rank], rank);
+            }
+
+            for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+            {
+                keys[rowIdx * numKeys + keyIdx] = (rowLength > 0) ?
+                    ranks.at(values[rowIdx * rowLength]) : MissingCode;
+            }
+
+            return;
+        }
+
+        std::vector<double> values;
+        object->copyAs(values);
+
+        const size_t rowLength = numRows > 0 ? values.size() / numRows : 0;
+        for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+        {
+            const double value = (rowLength > 0) ? values[rowIdx * rowLength]
+                                                 : DataObject<double>::missingValue();
+
+            keys[rowIdx * numKeys + keyIdx] =
+                (value == DataObject<double>::missingValue() || std::isnan(value)) ?
+                    MissingCode : numberCode(value);
+        }
+    }
+}  // namespace Ingester
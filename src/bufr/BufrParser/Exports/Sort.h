@@ -0,0 +1,90 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "eckit/config/LocalConfiguration.h"
+
+#include "IngesterTypes.h"
+#include "Variables/Variable.h"
+
+
+namespace Ingester
+{
+    /// \brief Puts the rows of the exported data in a new order before they are split and
+    ///        encoded, so nearby observations (in time, by station or in space) end up next to
+    ///        each other in the output. That compresses better and lets readers that only want
+    ///        part of the locations (a time window, a region) read fewer chunks.
+    ///
+    ///        The rows are ordered along a space filling curve through the locations (Hilbert
+    ///        or Morton, optional), then by the first values of the listed variables (missing
+    ///        values last). Equal rows keep their order. The order is computed once, and every
+    ///        field is sliced by it (so the values are gathered once, when they are needed).
+    class Sort
+    {
+     public:
+        /// \brief The space filling curves the locations can be ordered along.
+        enum class Curve
+        {
+            None,
+            Hilbert,
+            Morton
+        };
+
+        /// \brief Constructor
+        /// \param conf The configuration of the sort (exports::sort)
+        explicit Sort(const eckit::LocalConfiguration& conf);
+
+        /// \brief Order the rows by the fields the listed export variables are made of (ex:
+        ///        the year, month, day, hour, minute and second of a datetime variable). Names
+        ///        that aren't export variables are taken to be fields.
+        /// \param variables The export variables.
+        void resolveFields(const std::vector<std::shared_ptr<Variable>>& variables);
+
+        /// \brief Put the rows of the data in order.
+        /// \param dataMap The data to sort (each field is replaced by a slice of it).
+        /// \param numThreads The number of threads to sort with.
+        void apply(BufrDataMap& dataMap, size_t numThreads = 1) const;
+
+        /// \brief The names of the fields the rows are ordered by (after the curve).
+        const std::vector<std::string>& fields() const { return fields_; }
+
+     private:
+        std::vector<std::string> variables_;
+        std::vector<std::string> fields_;
+        Curve curve_ = Curve::None;
+        std::string latitude_;
+        std::string longitude_;
+
+        /// \brief The sort key of every row: one code per key (the curve first, then the
+        ///        fields) that compares like the values.
+        std::vector<uint64_t> rowKeys(const BufrDataMap& dataMap,
+                                      size_t numRows,
+                                      size_t& numKeys) const;
+
+        /// \brief Add the position of the location of each row along the curve to the keys.
+        void appendCurveKeys(const BufrDataMap& dataMap,
+                             size_t numRows,
+                             size_t keyIdx,
+                             size_t numKeys,
+                             std::vector<uint64_t>& keys) const;
+
+        /// \brief Add the codes of the values of a field to the keys.
+        void appendFieldKeys(const BufrDataMap& dataMap,
+                             const std::string& field,
+                             size_t numRows,
+                             size_t keyIdx,
+                             size_t numKeys,
+                             std::vector<uint64_t>& keys) const;
+    };
+}  // namespace Ingester
@@ -18,6 +18,34 @@ namespace
         const char* NameMap = "map";
         const char* Variable = "variable";
     }  // namespace ConfKeys
+
+    /// \brief Get the first value of each row of a field as an integer.
+    std::vector<int> rowValues(const std::shared_ptr<Ingester::DataObjectBase>& dataObject)
+    {
+        std::vector<int> values;
+        if (auto intObject = std::dynamic_pointer_cast<Ingester::DataObject<int>>(dataObject))
+        {
+            const auto view = intObject->view();
+            values.reserve(view.numRows());
+            for (const auto row : view)
+            {
+                values.push_back(row[0]);
+            }
+
+            return values;
+        }
+
+        dataObject->copyAs(values);
+        const size_t numRows = dataObject->getDims()[0];
+        const size_t rowSize = numRows > 0 ? values.size() / numRows : 0;
+        for (size_t rowIdx = 1; rowIdx < numRows; rowIdx++)
+        {
+            values[rowIdx] = values[rowIdx * rowSize];
+        }
+
+        values.resize(numRows);
+        return values;
+    }
 }  // namespace
 
 namespace Ingester
@@ -50,65 +78,87 @@ namespace Ingester
         return categories;
     }
 
+    std::vector<bufr::ValueConstraint> CategorySplit::valueConstraints() const
+    {
+        if (!conf_.has(ConfKeys::NameMap)) return {};
+
+        bufr::ValueConstraint constraint;
+        constraint.name = variable_;
+        for (const auto& mapPair : nameMap_)
+        {
+            constraint.categories.push_back(mapPair.first);  // Sorted (std::map)
+        }
+
+        return {constraint};
+    }
+
     std::unordered_map<std::string, BufrDataMap> CategorySplit::split(const BufrDataMap &dataMap)
     {
         updateNameMap(dataMap);
 
         std::unordered_map<std::string, BufrDataMap> dataMaps;
 
-        const auto& dataObject = dataMap.at(variable_);
-
-        for (const auto& mapPair : nameMap_)
+        for (auto& category : partition(dataMap))
         {
-            // Find matching rows
-            std::vector<size_t> indexVec;
-            for (auto rowIdx = 0; rowIdx < dataObject->getDims()[0]; rowIdx++)
-            {
-                auto location = Location(dataObject->getDims().size(), 0);
-                location[0] = rowIdx;
-
-                if (dataObject->getAsInt(location) == mapPair.first)
-                {
-                    indexVec.push_back(rowIdx);
-                }
-            }
-
-            // Make new data map
+            // Every field is sliced by the same (shared) rows.
             BufrDataMap newDataMap;
+            SliceCache cache;
             for (const auto& dataPair : dataMap)
             {
-                const auto newArr = dataPair.second->slice(indexVec);
-                newDataMap.insert({dataPair.first, newArr});
+                newDataMap.insert({dataPair.first,
+                                   dataPair.second->slice(category.second, cache)});
             }
 
-            dataMaps.insert({mapPair.second, newDataMap});
+            dataMaps.insert({nameMap_.at(category.first), std::move(newDataMap)});
         }
 
         return dataMaps;
     }
 
+    std::map<int, std::shared_ptr<const std::vector<size_t>>>
+        CategorySplit::partition(const BufrDataMap& dataMap) const
+    {
+        std::map<int, std::shared_ptr<std::vector<size_t>>> categoryRows;
+        for (const auto& mapPair : nameMap_)
+        {
+            categoryRows.insert({mapPair.first, std::make_shared<std::vector<size_t>>()});
+        }
+
+        // One pass over the rows (looking the categories up in a small hash map).
+        std::unordered_map<int, std::vector<size_t>*> rowsOfCategory;
+        for (auto& category : categoryRows)
+        {
+            rowsOfCategory.insert({category.first, category.second.get()});
+        }
+
+        const auto values = rowValues(dataMap.at(variable_));
+        for (size_t rowIdx = 0; rowIdx < values.size(); rowIdx++)
+        {
+            auto rowsIt = rowsOfCategory.find(values[rowIdx]);
+            if (rowsIt != rowsOfCategory.end()) rowsIt->second->push_back(rowIdx);
+        }
+
+        return {categoryRows.begin(), categoryRows.end()};
+    }
+
     void CategorySplit::updateNameMap(const BufrDataMap& dataMap)
     {
         if (nameMap_.empty())
         {
             const auto& dataObject = dataMap.at(variable_);
-            for (auto rowIdx = 0; rowIdx < dataObject->getDims()[0]; rowIdx++)
+            auto dat = std::dynamic_pointer_cast<DataObject<int>> (dataObject);
+            if (!dat)
+            {
+                std::stringstream errStr;
+                errStr << "Can't turn " << variable_ << " into a category as it contains ";
+                errStr << "non-integer values.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            for (const auto row : dat->view())
             {
-                auto location = Location(dataObject->getDims().size(), 0);
-                location[0] = rowIdx;
-
-                if (auto dat = std::dynamic_pointer_cast<DataObject<int>> (dataObject))
-                {
-                    auto itemVal = dat->get(location);
-                    nameMap_.insert({itemVal, std::to_string(itemVal)});
-                }
-                else
-                {
-                    std::stringstream errStr;
-                    errStr << "Can't turn " << variable_ << " into a category as it contains ";
-                    errStr << "non-integer values.";
-                    throw eckit::BadParameter(errStr.str());
-                }
+                const auto itemVal = row[0];
+                nameMap_.insert({itemVal, std::to_string(itemVal)});
             }
         }
 
@@ -9,6 +9,8 @@
 
 #include "Split.h"
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -55,12 +57,21 @@ namespace Ingester
         /// \result map of split data where the category is the key
         std::unordered_map<std::string, BufrDataMap> split(const BufrDataMap& dataMap) final;
 
+        /// \brief The categories of the map (none if the categories come from the data).
+        std::vector<bufr::ValueConstraint> valueConstraints() const final;
+
      private:
         const std::string variable_;
 
         NameMap nameMap_;
 
 
+        /// \brief Find the rows of each category (in one pass over the data).
+        /// \param dataMap Data to be split
+        /// \result The rows of each category of nameMap_.
+        std::map<int, std::shared_ptr<const std::vector<size_t>>>
+            partition(const BufrDataMap& dataMap) const;
+
         /// \brief Adds values to nameMap_ using the data if nameMap_ is empty.
         /// \param dataMap Data to be split
         void updateNameMap(const BufrDataMap& dataMap);
@@ -0,0 +1,251 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "GeoBoxSplit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    namespace ConfKeys
+    {
+        const char* Latitude = "latitude";
+        const char* Longitude = "longitude";
+        const char* LatitudeStep = "latitudeStep";
+        const char* LongitudeStep = "longitudeStep";
+        const char* South = "south";
+        const char* North = "north";
+        const char* West = "west";
+        const char* East = "east";
+    }  // namespace ConfKeys
+
+    /// \brief Wrap a longitude into [-180, 180).
+    double wrapLongitude(double lon)
+    {
+        if (lon >= -180.0 && lon < 180.0) return lon;
+
+        lon = std::fmod(lon + 180.0, 360.0);
+        if (lon < 0) lon += 360.0;
+        return lon - 180.0;
+    }
+
+    /// \brief Get the first value of each row of a field (missing values are NaN).
+    std::vector<double> rowValues(const Ingester::BufrDataMap& dataMap,
+                                  const std::string& variable,
+                                  const std::string& splitName)
+    {
+        if (dataMap.find(variable) == dataMap.end())
+        {
+            std::ostringstream errStr;
+            errStr << "Unknown variable " << variable << " found in geobox split " << splitName;
+            errStr << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const auto& dataObject = dataMap.at(variable);
+        std::vector<double> values;
+        dataObject->copyAs(values);
+
+        const auto& dims = dataObject->getDims();
+        const size_t numRows = dims.empty() ? 0 : static_cast<size_t>(dims[0]);
+        const size_t rowSize = numRows > 0 ? values.size() / numRows : 0;
+
+        std::vector<double> rows(numRows, std::nan(""));
+        for (size_t rowIdx = 0; rowSize > 0 && rowIdx < numRows; rowIdx++)
+        {
+            const double value = values[rowIdx * rowSize];
+            if (value != Ingester::DataObject<double>::missingValue()) rows[rowIdx] = value;
+        }
+
+        return rows;
+    }
+
+    /// \brief Write a bound of a tile (with only the digits it needs, ex: 2.5 or 30).
+    std::string boundStr(double bound)
+    {
+        std::ostringstream str;
+        str << bound;
+        return str.str();
+    }
+}  // namespace
+
+namespace Ingester
+{
+    GeoBoxSplit::GeoBoxSplit(const std::string& name, const eckit::LocalConfiguration& conf) :
+        Split(name, conf),
+        latitude_(conf.getString(ConfKeys::Latitude)),
+        longitude_(conf.getString(ConfKeys::Longitude)),
+        latStep_(conf.getDouble(ConfKeys::LatitudeStep))
+    {
+        lonStep_ = conf.has(ConfKeys::LongitudeStep) ?
+            conf.getDouble(ConfKeys::LongitudeStep) : latStep_;
+
+        if (!(latStep_ > 0) || !(lonStep_ > 0))
+        {
+            std::ostringstream errStr;
+            errStr << "splits::" << name << "::geobox steps must be greater than 0.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        if (conf.has(ConfKeys::South)) south_ = conf.getDouble(ConfKeys::South);
+        if (conf.has(ConfKeys::North)) north_ = conf.getDouble(ConfKeys::North);
+        if (north_ <= south_)
+        {
+            std::ostringstream errStr;
+            errStr << "splits::" << name << "::geobox north must be greater than south.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        if (conf.has(ConfKeys::West) || conf.has(ConfKeys::East))
+        {
+            const double west = wrapLongitude(conf.getDouble(ConfKeys::West));
+            const double east = conf.getDouble(ConfKeys::East);
+            west_ = west;
+            width_ = wrapLongitude(east) - west;
+            if (width_ <= 0) width_ += 360.0;
+        }
+
+        numLatTiles_ = static_cast<size_t>(std::ceil((north_ - south_) / latStep_));
+        numLonTiles_ = static_cast<size_t>(std::ceil(width_ / lonStep_));
+    }
+
+    std::vector<std::string> GeoBoxSplit::subCategories(const BufrDataMap& dataMap)
+    {
+        tiles_ = tilesWithData(rowTiles(dataMap));
+
+        std::vector<std::string> categories;
+        for (const auto tileIdx : tiles_)
+        {
+            categories.push_back(tileName(tileIdx));
+        }
+
+        return categories;
+    }
+
+    std::unordered_map<std::string, BufrDataMap> GeoBoxSplit::split(const BufrDataMap& dataMap)
+    {
+        const auto tileOfRow = rowTiles(dataMap);
+        const auto tiles = tiles_.empty() ? tilesWithData(tileOfRow) : tiles_;
+
+        // Count the rows of each tile, then gather them (in order).
+        std::unordered_map<size_t, size_t> slotOfTile;
+        for (size_t slot = 0; slot < tiles.size(); slot++)
+        {
+            slotOfTile.insert({tiles[slot], slot});
+        }
+
+        std::vector<size_t> slotOfRow(tileOfRow.size(), NoTile);
+        std::vector<size_t> counts(tiles.size(), 0);
+        for (size_t rowIdx = 0; rowIdx < tileOfRow.size(); rowIdx++)
+        {
+            if (tileOfRow[rowIdx] == NoTile) continue;
+
+            const auto slotIt = slotOfTile.find(tileOfRow[rowIdx]);
+            if (slotIt == slotOfTile.end()) continue;
+
+            slotOfRow[rowIdx] = slotIt->second;
+            counts[slotIt->second]++;
+        }
+
+        std::vector<std::shared_ptr<std::vector<size_t>>> tileRows;
+        for (const auto count : counts)
+        {
+            tileRows.push_back(std::make_shared<std::vector<size_t>>());
+            tileRows.back()->reserve(count);
+        }
+
+        for (size_t rowIdx = 0; rowIdx < slotOfRow.size(); rowIdx++)
+        {
+            if (slotOfRow[rowIdx] != NoTile) tileRows[slotOfRow[rowIdx]]->push_back(rowIdx);
+        }
+
+        std::unordered_map<std::string, BufrDataMap> dataMaps;
+        for (size_t slot = 0; slot < tiles.size(); slot++)
+        {
+            // Every field is sliced by the same (shared) rows.
+            const std::shared_ptr<const std::vector<size_t>> rows = tileRows[slot];
+            BufrDataMap newDataMap;
+            SliceCache cache;
+            for (const auto& dataPair : dataMap)
+            {
+                newDataMap.insert({dataPair.first, dataPair.second->slice(rows, cache)});
+            }
+
+            dataMaps.insert({tileName(tiles[slot]), std::move(newDataMap)});
+        }
+
+        return dataMaps;
+    }
+
+    std::vector<size_t> GeoBoxSplit::rowTiles(const BufrDataMap& dataMap) const
+    {
+        const auto lats = rowValues(dataMap, latitude_, name_);
+        const auto lons = rowValues(dataMap, longitude_, name_);
+
+        std::vector<size_t> tiles(lats.size(), NoTile);
+        for (size_t rowIdx = 0; rowIdx < lats.size(); rowIdx++)
+        {
+            const double lat = lats[rowIdx];
+            const double lon = lons[rowIdx];
+            if (!(lat >= south_ && lat <= north_) || !std::isfinite(lon)) continue;
+
+            // Degrees east of the west bound.
+            double east = wrapLongitude(lon) - west_;
+            if (east < 0) east += 360.0;
+            if (east > width_) continue;
+
+            // The north and east bounds are in the last tiles.
+            const auto latTile = std::min(static_cast<size_t>((lat - south_) / latStep_),
+                                          numLatTiles_ - 1);
+            const auto lonTile = std::min(static_cast<size_t>(east / lonStep_), numLonTiles_ - 1);
+            tiles[rowIdx] = latTile * numLonTiles_ + lonTile;
+        }
+
+        return tiles;
+    }
+
+    std::vector<size_t> GeoBoxSplit::tilesWithData(const std::vector<size_t>& rowTiles) const
+    {
+        std::vector<size_t> tiles;
+        std::copy_if(rowTiles.begin(), rowTiles.end(), std::back_inserter(tiles),
+                     [](size_t tileIdx) { return tileIdx != NoTile; });
+
+        std::sort(tiles.begin(), tiles.end());
+        tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+        return tiles;
+    }
+
+    std::string GeoBoxSplit::tileName(size_t tileIdx) const
+    {
+        const size_t latTile = tileIdx / numLonTiles_;
+        const size_t lonTile = tileIdx % numLonTiles_;
+
+        const double south = south_ + latTile * latStep_;
+        const double north = std::min(south + latStep_, north_);
+        const double westOffset = lonTile * lonStep_;
+        const double eastOffset = std::min(westOffset + lonStep_, width_);
+
+        // The east bound of a tile that ends on the dateline is 180 (not -180).
+        const double west = wrapLongitude(west_ + westOffset);
+        double east = wrapLongitude(west_ + eastOffset);
+        if (east <= west) east += 360.0;
+        if (east > 180.0) east -= 360.0;
+        if (east == -180.0) east = 180.0;
+
+        std::ostringstream name;
+        name << "lat_" << boundStr(south) << "_" << boundStr(north);
+        name << "__lon_" << boundStr(west) << "_" << boundStr(east);
+        return name.str();
+    }
+}  // namespace Ingester
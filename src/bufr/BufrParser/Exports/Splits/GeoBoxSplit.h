@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include "Split.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Ingester
+{
+    /// \brief Data splitter class that splits data into latitude/longitude tiles.
+    /// \details The tiles are latitudeStep by longitudeStep degrees, starting at the south west
+    ///          corner of the (optional) bounds, which are the whole globe by default. The tile of
+    ///          each row is found from its coordinates in one pass, then the rows of each tile are
+    ///          gathered. Only the tiles with data are categories, named by their bounds (ex:
+    ///          lat_25_30__lon_20_25). Rows with missing coordinates or outside of the bounds
+    ///          are left out. Bounds with west greater than east cross the dateline.
+    class GeoBoxSplit : public Split
+    {
+     public:
+        /// \brief constructor
+        /// \param name The name of the split.
+        /// \param conf The configuration of the split (splits::<name>::geobox).
+        GeoBoxSplit(const std::string& name, const eckit::LocalConfiguration& conf);
+
+        /// \brief Get list of sub categories this split will create (the tiles with data).
+        /// \result List of unique strings.
+        std::vector<std::string> subCategories(const BufrDataMap& dataMap) final;
+
+        /// \brief Split the data according to internal rules
+        /// \param dataMap Data to be split
+        /// \result map of split data where the category is the key
+        std::unordered_map<std::string, BufrDataMap> split(const BufrDataMap& dataMap) final;
+
+     private:
+        /// \brief Tile index of rows that aren't in any tile.
+        static constexpr size_t NoTile = static_cast<size_t>(-1);
+
+        const std::string latitude_;
+        const std::string longitude_;
+        double latStep_;
+        double lonStep_;
+        double south_ = -90.0;
+        double north_ = 90.0;
+        double west_ = -180.0;
+        double width_ = 360.0;  // Degrees east of west_ the bounds go
+        size_t numLatTiles_;
+        size_t numLonTiles_;
+
+        /// \brief The tiles with data found by subCategories (by tile index).
+        std::vector<size_t> tiles_;
+
+        /// \brief Find the tile of each row (NoTile if it isn't in any).
+        std::vector<size_t> rowTiles(const BufrDataMap& dataMap) const;
+
+        /// \brief The tiles that have some of the rows (in tile index order).
+        std::vector<size_t> tilesWithData(const std::vector<size_t>& rowTiles) const;
+
+        /// \brief The name of a tile (from its bounds).
+        std::string tileName(size_t tileIdx) const;
+    };
+}  // namespace Ingester
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -14,6 +15,8 @@
 #include "eckit/config/LocalConfiguration.h"
 
 #include "IngesterTypes.h"
+#include "BufrParser/Query/ValueConstraint.h"
+#include "../Variables/Variable.h"
 
 
 namespace Ingester
@@ -38,6 +41,15 @@ namespace Ingester
         /// \result map of split data where the category is the key
         virtual std::unordered_map<std::string, BufrDataMap> split(const BufrDataMap& dataMap) = 0;
 
+        /// \brief The values this split keeps (rows with other values aren't in any of the
+        ///        sub categories), so the subsets without them don't have to be collected.
+        virtual std::vector<bufr::ValueConstraint> valueConstraints() const { return {}; }
+
+        /// \brief Look up the export variables the split needs (ex: to compute its values from
+        ///        the fields). Called once the variables are known.
+        /// \param variables The export variables.
+        virtual void resolveVariables(const std::vector<std::shared_ptr<Variable>>& variables) {}
+
         /// \brief Get the split name
         inline std::string getName() const { return name_; }
 
@@ -0,0 +1,208 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "TimeSplit.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <set>
+#include <sstream>
+
+#include "eckit/exception/Exceptions.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/Duration.h"
+
+
+namespace
+{
+    namespace ConfKeys
+    {
+        const char* Variable = "variable";
+        const char* HalfWidth = "halfWidth";
+        const char* Windows = "windows";
+
+        namespace Window
+        {
+            const char* Center = "center";
+            const char* Name = "name";
+            const char* HalfWidth = "halfWidth";
+        }  // namespace Window
+    }  // namespace ConfKeys
+
+    /// \brief The half width of the windows unless it is configured (6 hour cycles).
+    const char* DefaultHalfWidth = "PT3H";
+
+    /// \brief The date and hour of a time (YYYYMMDDHH).
+    std::string hourName(const util::DateTime& dateTime)
+    {
+        int year, month, day, hour, minute, second;
+        dateTime.getDateTime(year, month, day, hour, minute, second);
+
+        std::ostringstream name;
+        name << std::setfill('0') << std::setw(4) << year << std::setw(2) << month;
+        name << std::setw(2) << day << std::setw(2) << hour;
+        return name.str();
+    }
+}  // namespace
+
+namespace Ingester
+{
+    TimeSplit::TimeSplit(const std::string& name, const eckit::LocalConfiguration& conf) :
+        Split(name, conf),
+        variable_(conf.getString(ConfKeys::Variable))
+    {
+        const std::string halfWidth = conf.has(ConfKeys::HalfWidth) ?
+            conf.getString(ConfKeys::HalfWidth) : std::string(DefaultHalfWidth);
+
+        if (!conf.has(ConfKeys::Windows))
+        {
+            std::ostringstream errStr;
+            errStr << "splits::" << name << "::time must have a list of windows.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const util::DateTime epoch(1970, 1, 1, 0, 0, 0);
+        std::set<std::string> names;
+        for (const auto& windowConf : conf.getSubConfigurations(ConfKeys::Windows))
+        {
+            const util::DateTime center(windowConf.getString(ConfKeys::Window::Center));
+            const auto windowHalfWidth = util::Duration(
+                windowConf.has(ConfKeys::Window::HalfWidth) ?
+                    windowConf.getString(ConfKeys::Window::HalfWidth) : halfWidth).toSeconds();
+
+            if (windowHalfWidth <= 0)
+            {
+                std::ostringstream errStr;
+                errStr << "splits::" << name << "::time windows must have a positive half width.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            Window window;
+            window.name = windowConf.has(ConfKeys::Window::Name) ?
+                windowConf.getString(ConfKeys::Window::Name) : hourName(center);
+            window.begin = (center - epoch).toSeconds() - windowHalfWidth;
+            window.end = (center - epoch).toSeconds() + windowHalfWidth;
+
+            if (!names.insert(window.name).second)
+            {
+                std::ostringstream errStr;
+                errStr << "splits::" << name << "::time has more than one window named ";
+                errStr << window.name << ".";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            windows_.push_back(window);
+        }
+
+        if (windows_.empty())
+        {
+            std::ostringstream errStr;
+            errStr << "splits::" << name << "::time must have a list of windows.";
+            throw eckit::BadParameter(errStr.str());
+        }
+    }
+
+    void TimeSplit::resolveVariables(const std::vector<std::shared_ptr<Variable>>& variables)
+    {
+        const auto varIt = std::find_if(variables.begin(), variables.end(),
+            [this](const std::shared_ptr<Variable>& variable)
+            {
+                return variable->getExportName() == variable_;
+            });
+
+        timeVariable_ = (varIt != variables.end()) ? *varIt : nullptr;
+    }
+
+    std::vector<std::string> TimeSplit::subCategories(const BufrDataMap& dataMap)
+    {
+        std::vector<std::string> categories;
+        for (const auto& window : windows_)
+        {
+            categories.push_back(window.name);
+        }
+
+        return categories;
+    }
+
+    std::unordered_map<std::string, BufrDataMap> TimeSplit::split(const BufrDataMap& dataMap)
+    {
+        std::vector<std::shared_ptr<std::vector<size_t>>> windowRows;
+        for (size_t windowIdx = 0; windowIdx < windows_.size(); windowIdx++)
+        {
+            windowRows.push_back(std::make_shared<std::vector<size_t>>());
+        }
+
+        // One pass over the rows (a row goes in every window it is in).
+        const auto times = rowTimes(dataMap);
+        const auto missingTime = DataObject<std::int64_t>::missingValue();
+        for (size_t rowIdx = 0; rowIdx < times.size(); rowIdx++)
+        {
+            const auto time = times[rowIdx];
+            if (time == missingTime) continue;
+
+            for (size_t windowIdx = 0; windowIdx < windows_.size(); windowIdx++)
+            {
+                if (time > windows_[windowIdx].begin && time <= windows_[windowIdx].end)
+                {
+                    windowRows[windowIdx]->push_back(rowIdx);
+                }
+            }
+        }
+
+        std::unordered_map<std::string, BufrDataMap> dataMaps;
+        for (size_t windowIdx = 0; windowIdx < windows_.size(); windowIdx++)
+        {
+            // Every field is sliced by the same (shared) rows.
+            const std::shared_ptr<const std::vector<size_t>> rows = windowRows[windowIdx];
+            BufrDataMap newDataMap;
+            SliceCache cache;
+            for (const auto& dataPair : dataMap)
+            {
+                newDataMap.insert({dataPair.first, dataPair.second->slice(rows, cache)});
+            }
+
+            dataMaps.insert({windows_[windowIdx].name, std::move(newDataMap)});
+        }
+
+        return dataMaps;
+    }
+
+    std::vector<std::int64_t> TimeSplit::rowTimes(const BufrDataMap& dataMap) const
+    {
+        std::shared_ptr<DataObjectBase> timeObject;
+        if (timeVariable_)
+        {
+            timeObject = timeVariable_->exportData(dataMap);
+        }
+        else if (dataMap.find(variable_) != dataMap.end())
+        {
+            timeObject = dataMap.at(variable_);
+        }
+        else
+        {
+            std::ostringstream errStr;
+            errStr << "Unknown variable " << variable_ << " found in time split " << name_ << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        std::vector<std::int64_t> values;
+        timeObject->copyAs(values);
+
+        const auto& dims = timeObject->getDims();
+        const size_t numRows = dims.empty() ? 0 : static_cast<size_t>(dims[0]);
+        const size_t rowSize = numRows > 0 ? values.size() / numRows : 0;
+
+        std::vector<std::int64_t> times(numRows, DataObject<std::int64_t>::missingValue());
+        for (size_t rowIdx = 0; rowSize > 0 && rowIdx < numRows; rowIdx++)
+        {
+            times[rowIdx] = values[rowIdx * rowSize];
+        }
+
+        return times;
+    }
+}  // namespace Ingester
@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include "Split.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Ingester
+{
+    /// \brief Data splitter class that splits data into (assimilation) time windows.
+    /// \details Each window is a center time plus or minus a half width, and has the rows whose
+    ///          time is in (center - half width, center + half width]. The windows may overlap,
+    ///          in which case the rows in more than one of them are in each of them. Rows without
+    ///          a time, or outside of all the windows, are left out. One decode of a long dump
+    ///          can so make the files of several consecutive cycles (through the {splits/<name>}
+    ///          substitution of the file names), ex:
+    ///            cycle:
+    ///              time:
+    ///                variable: timestamp
+    ///                halfWidth: PT3H
+    ///                windows:
+    ///                  - center: "2020-10-27T00:00:00Z"
+    ///                  - center: "2020-10-27T06:00:00Z"
+    ///                    name: "t06z"
+    ///          The windows are named by the date and hour of their center (YYYYMMDDHH) unless
+    ///          they have a name.
+    class TimeSplit : public Split
+    {
+     public:
+        /// \brief constructor
+        /// \param name The name of the split.
+        /// \param conf The configuration of the split (splits::<name>::time).
+        TimeSplit(const std::string& name, const eckit::LocalConfiguration& conf);
+
+        /// \brief Get list of sub categories this split will create (the window names).
+        /// \result List of unique strings.
+        std::vector<std::string> subCategories(const BufrDataMap& dataMap) final;
+
+        /// \brief Split the data according to internal rules
+        /// \param dataMap Data to be split
+        /// \result map of split data where the category is the key
+        std::unordered_map<std::string, BufrDataMap> split(const BufrDataMap& dataMap) final;
+
+        /// \brief Find the datetime variable the times come from.
+        void resolveVariables(const std::vector<std::shared_ptr<Variable>>& variables) final;
+
+     private:
+        /// \brief A time window (in seconds since the epoch).
+        struct Window
+        {
+            std::string name;
+            std::int64_t begin;  // Exclusive
+            std::int64_t end;  // Inclusive
+        };
+
+        const std::string variable_;
+        std::vector<Window> windows_;
+
+        /// \brief The export variable that makes the times (none if the variable is a field of
+        ///        the data, holding the seconds since the epoch).
+        std::shared_ptr<Variable> timeVariable_;
+
+        /// \brief The time of each row (the first value of the row).
+        std::vector<std::int64_t> rowTimes(const BufrDataMap& dataMap) const;
+    };
+}  // namespace Ingester
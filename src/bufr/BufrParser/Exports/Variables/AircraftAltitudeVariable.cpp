@@ -5,10 +5,12 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <cmath>
+#include <cstdint>
 #include <string>
 
 #include <ostream>
-#include <time.h>
+#include <utility>
 #include <vector>
 
 #include "eckit/exception/Exceptions.h"
@@ -55,27 +57,33 @@ namespace Ingester
     {
         checkKeys(map);
 
-        std::unordered_map<std::string, std::shared_ptr<DataObjectBase>> includedFieldMap;
-        std::vector<std::string> includedFields;
-
-        std::shared_ptr<DataObjectBase> referenceObj = nullptr;
+        // The included fields, in the order they are preferred in: the pressure, then the
+        // indicated altitude (only used with the pressure), then the other fields in order.
+        std::vector<std::string> sourceFields;
         for (const auto& fieldName : FieldNames)
         {
-            if (conf_.has(fieldName))
+            if (!conf_.has(fieldName)) continue;
+
+            if (fieldName == ConfKeys::AircraftIndicatedAltitude && !conf_.has(ConfKeys::Pressure))
             {
-                includedFieldMap.insert({fieldName, map.at(getExportKey(fieldName))});
-                includedFields.push_back(fieldName);
+                continue;
             }
+
+            sourceFields.push_back(fieldName);
+        }
+
+        if (sourceFields.empty())
+        {
+            throw eckit::BadParameter("AircraftAltitude needs at least one altitude field.");
         }
 
-        referenceObj = (*includedFieldMap.begin()).second;
+        const auto& referenceObj = map.at(getExportKey(sourceFields.front()));
 
         // Validation: make sure the dimensions are consistent
-        auto path = referenceObj->getPath();
-        for (const auto& fieldName : FieldNames)
+        const auto path = referenceObj->getPath();
+        for (const auto& fieldName : sourceFields)
         {
-            if (includedFieldMap.find(fieldName) != includedFieldMap.end() &&
-                includedFieldMap[fieldName]->getPath() != path)
+            if (map.at(getExportKey(fieldName))->getPath() != path)
             {
                 std::ostringstream errStr;
                 errStr << "Inconsistent dimensions found in source data.";
@@ -83,55 +91,60 @@ namespace Ingester
             }
         }
 
-        std::vector<float> aircraftAlts;
-        aircraftAlts.resize(referenceObj->size(), DataObject<float>::missingValue());
+        const auto missingFloat = DataObject<float>::missingValue();
+        const size_t numValues = referenceObj->size();
+        std::vector<std::vector<float>> sourceValues(sourceFields.size());
+        for (size_t srcIdx = 0; srcIdx < sourceFields.size(); srcIdx++)
+        {
+            map.at(getExportKey(sourceFields[srcIdx]))->copyAs(sourceValues[srcIdx]);
+        }
+
+        // The first source with a value for each location (sourceFields.size() for none).
+        std::vector<uint8_t> sources(numValues, static_cast<uint8_t>(sourceFields.size()));
+        for (size_t srcIdx = sourceFields.size(); srcIdx-- > 0;)
+        {
+            const auto& values = sourceValues[srcIdx];
+            for (size_t idx = 0; idx < numValues; idx++)
+            {
+                if (values[idx] != missingFloat) sources[idx] = static_cast<uint8_t>(srcIdx);
+            }
+        }
 
-        for (size_t idx = 0; idx < referenceObj->size(); idx++)
+        // Fill the locations of each source in a pass over its values.
+        std::vector<float> aircraftAlts(numValues, missingFloat);
+        for (size_t srcIdx = 0; srcIdx < sourceFields.size(); srcIdx++)
         {
-            for (auto nameIt = includedFields.rbegin(); nameIt != includedFields.rend(); ++nameIt)
+            const auto& values = sourceValues[srcIdx];
+            if (sourceFields[srcIdx] == ConfKeys::Pressure)
             {
-                const auto& fieldName = *nameIt;
-                const auto& fieldValues = includedFieldMap.at(fieldName);
-                if (fieldName == ConfKeys::Pressure)
+                for (size_t idx = 0; idx < numValues; idx++)
                 {
-                    if (!fieldValues->isMissing(idx))
+                    if (sources[idx] != srcIdx) continue;
+
+                    const auto value = values[idx];
+                    if (value < 22630.0f)
                     {
-                        auto value = fieldValues->getAsFloat(idx);
-                        if (value < 22630.0f)
-                        {
-                            aircraftAlts[idx]  =
-                                11000.0f - (std::log1p(value / 22630.0f) / 0.0001576106f);
-                        }
-                        else
-                        {
-                            aircraftAlts[idx]  =
-                                (1.0f - powf((value / 101325.0f),
-                                             (1.0f / 5.256f))) * (288.15f / 0.0065f);
-                        }
+                        aircraftAlts[idx] =
+                            11000.0f - (std::log1p(value / 22630.0f) / 0.0001576106f);
                     }
-                    else if (includedFieldMap.find(ConfKeys::AircraftIndicatedAltitude)
-                             != includedFieldMap.end())
+                    else
                     {
-                        if (!includedFieldMap[ConfKeys::AircraftIndicatedAltitude]->isMissing(idx))
-                        {
-                            aircraftAlts[idx] =
-                             includedFieldMap[ConfKeys::AircraftIndicatedAltitude]->getAsFloat(idx);
-                        }
+                        aircraftAlts[idx] =
+                            (1.0f - powf((value / 101325.0f), (1.0f / 5.256f))) *
+                            (288.15f / 0.0065f);
                     }
                 }
-                else if (fieldName == ConfKeys::AircraftIndicatedAltitude)
-                {
-                    // This variable is only used in conjunction with pressure.
-                    continue;
-                }
-                else if (!fieldValues->isMissing(idx))
+            }
+            else
+            {
+                for (size_t idx = 0; idx < numValues; idx++)
                 {
-                    aircraftAlts[idx] = fieldValues->getAsFloat(idx);
+                    aircraftAlts[idx] = (sources[idx] == srcIdx) ? values[idx] : aircraftAlts[idx];
                 }
             }
         }
 
-        return std::make_shared<DataObject<float>>(aircraftAlts,
+        return std::make_shared<DataObject<float>>(std::move(aircraftAlts),
                                                     getExportName(),
                                                     groupByField_,
                                                     referenceObj->getDims(),
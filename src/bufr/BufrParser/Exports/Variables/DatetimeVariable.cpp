@@ -11,7 +11,7 @@
 #include <unordered_map>
 
 #include <ostream>
-#include <time.h>
+#include <utility>
 #include <vector>
 
 #include "eckit/exception/Exceptions.h"
@@ -20,6 +20,7 @@
     #include "oops/util/Logger.h"
 #endif
 
+#include "BufrParser/Query/EpochTime.h"
 #include "DataObject.h"
 #include "DatetimeVariable.h"
 
@@ -68,21 +69,8 @@ namespace Ingester
     std::shared_ptr<DataObjectBase> DatetimeVariable::exportData(const BufrDataMap& map)
     {
         checkKeys(map);
-        static const int missingInt = DataObject<int>::missingValue();
-
-        setenv("TZ", "UTC", 1);      // Force UTC time zone
-        std::tm tm{};                // zero initialise
-        tm.tm_year = 1970-1900;      // 1970
-        tm.tm_mon = 0;               // Jan=0, Feb=1, ...
-        tm.tm_mday = 1;              // 1st
-        tm.tm_hour = 0;              // midnight
-        tm.tm_min = 0;
-        tm.tm_sec = 0;
-        tm.tm_isdst = 0;             // Not daylight saving
-        std::time_t epochDt = std::mktime(&tm);
 
         std::vector<int64_t> timeOffsets;
-        timeOffsets.reserve(map.at(getExportKey(ConfKeys::Year))->size());
 
         auto yearVar = map.at(getExportKey(ConfKeys::Year));
 
@@ -99,77 +87,79 @@ namespace Ingester
             throw eckit::BadParameter(errStr.str());
         }
 
-        for (unsigned int idx = 0; idx < map.at(getExportKey(ConfKeys::Year))->size(); idx++)
+        std::vector<int> years;
+        std::vector<int> months;
+        std::vector<int> days;
+        std::vector<int> hours;
+        std::vector<int> minuteValues;
+        std::vector<int> secondValues;
+        yearVar->copyAs(years);
+        map.at(getExportKey(ConfKeys::Month))->copyAs(months);
+        map.at(getExportKey(ConfKeys::Day))->copyAs(days);
+        map.at(getExportKey(ConfKeys::Hour))->copyAs(hours);
+        if (!minuteQuery_.empty()) map.at(getExportKey(ConfKeys::Minute))->copyAs(minuteValues);
+        if (!secondQuery_.empty()) map.at(getExportKey(ConfKeys::Second))->copyAs(secondValues);
+
+        // A datetime is missing if any of its year, month, day or hour is (one bitwise and of
+        // the validities the fields were assembled with).
+        auto validity = yearVar->validity();
+        validity.intersect(map.at(getExportKey(ConfKeys::Month))->validity());
+        validity.intersect(map.at(getExportKey(ConfKeys::Day))->validity());
+        validity.intersect(map.at(getExportKey(ConfKeys::Hour))->validity());
+
+        // Integer arithmetic only (no mktime), so the loop doesn't touch the time zone and can
+        // be vectorized. Out of range minutes and seconds count as 0.
+        const int64_t utcOffset = hoursFromUtc_ * 3600;
+        const auto missingOffset = DataObject<int64_t>::missingValue();
+        timeOffsets.resize(years.size());
+        bool hasSuspiciousDate = false;
+        for (size_t idx = 0; idx < years.size(); idx++)
         {
-            int year = map.at(getExportKey(ConfKeys::Year))->getAsInt(idx);
-            int month = map.at(getExportKey(ConfKeys::Month))->getAsInt(idx);
-            int day = map.at(getExportKey(ConfKeys::Day))->getAsInt(idx);
-            int hour = map.at(getExportKey(ConfKeys::Hour))->getAsInt(idx);
-            int minutes = 0;
-            int seconds = 0;
-
-            auto diff_time = DataObject<int64_t>::missingValue();
-            if (year != missingInt &&
-                month != missingInt &&
-                day != missingInt &&
-                hour != missingInt)
-            {
-                tm.tm_year = year - 1900;
-                tm.tm_mon = month - 1;
-                tm.tm_mday = day;
-                tm.tm_hour = hour;
-                tm.tm_min = 0;
-                tm.tm_sec = 0;
-                tm.tm_isdst = 0;
-
-                if (!minuteQuery_.empty())
-                {
-                    minutes = map.at(getExportKey(ConfKeys::Minute))->getAsInt(idx);
-
-                    if (minutes >= 0 && minutes < 60)
-                    {
-                        tm.tm_min = minutes;
-                    }
-                }
+            int minutes = minuteValues.empty() ? 0 : minuteValues[idx];
+            int seconds = secondValues.empty() ? 0 : secondValues[idx];
+            if (minutes < 0 || minutes >= 60) minutes = 0;
+            if (seconds < 0 || seconds >= 60) seconds = 0;
+
+            const bool isMissing = !validity.isValid(idx);
+
+            const auto offset = bufr::secondsSinceEpoch(years[idx],
+                                                        months[idx],
+                                                        days[idx],
+                                                        hours[idx],
+                                                        minutes,
+                                                        seconds);
+
+            hasSuspiciousDate |= (!isMissing && offset < 0);
+            timeOffsets[idx] = isMissing ? missingOffset : offset + utcOffset;
+        }
 
-                if (!secondQuery_.empty())
+        if (hasSuspiciousDate)
+        {
+            for (size_t idx = 0; idx < years.size(); idx++)
+            {
+                if (timeOffsets[idx] == missingOffset || timeOffsets[idx] - utcOffset >= 0)
                 {
-                    seconds = map.at(getExportKey(ConfKeys::Second))->getAsInt(idx);
-
-                    if (seconds >= 0 && seconds < 60)
-                    {
-                        tm.tm_sec = seconds;
-                    }
+                    continue;
                 }
 
-                // Be careful with mktime as it can be very slow.
-                auto thisTime = std::mktime(&tm);
-                if (thisTime < 0)
-                {
 #ifdef BUILD_IODA_BINDING
-                     oops::Log::warning() << "Caution, date suspicious date (year, month, day): "
-                                          << year << ", "
-                                          << month << ", "
-                                          << day << std::endl;
+                oops::Log::warning() << "Caution, date suspicious date (year, month, day): "
+                                     << years[idx] << ", "
+                                     << months[idx] << ", "
+                                     << days[idx] << std::endl;
 #endif
 
 #ifndef BUILD_IODA_BINDING
-                    std::cout << "Caution, date suspicious date (year, month, day): "
-                              << year << ", "
-                              << month << ", "
-                              << day << std::endl;
+                std::cout << "Caution, date suspicious date (year, month, day): "
+                          << years[idx] << ", "
+                          << months[idx] << ", "
+                          << days[idx] << std::endl;
 #endif
-                }
-
-                diff_time = static_cast<int64_t>(difftime(thisTime, epochDt)
-                    + hoursFromUtc_ * 3600);
             }
-
-            timeOffsets.push_back(diff_time);
         }
 
         return std::make_shared<DataObject<int64_t>>(
-                timeOffsets,
+                std::move(timeOffsets),
                 getExportName(),
                 groupByField_,
                 map.at(getExportKey(ConfKeys::Year))->getDims(),
@@ -9,8 +9,10 @@
 #include <iomanip>
 #include <memory>
 #include <ostream>
-#include <time.h>
+#include <sstream>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "eckit/exception/Exceptions.h"
@@ -45,14 +47,31 @@ namespace Ingester
                                                        const std::string& exportName,
                                                        const std::string& groupByField,
                                                        const eckit::LocalConfiguration &conf) :
-      Variable(exportName, groupByField, conf),
-      datetime_(exportName, groupByField, conf_.getSubConfiguration(ConfKeys::ObsTime))
+      Variable(exportName, groupByField, conf)
     {
+        // obsTime is either the name of an exported datetime variable or its own queries.
+        if (conf_.isString(ConfKeys::ObsTime))
+        {
+            obsTimeName_ = conf_.getString(ConfKeys::ObsTime);
+        }
+        else
+        {
+            datetime_ = std::make_unique<DatetimeVariable>(
+                exportName, groupByField, conf_.getSubConfiguration(ConfKeys::ObsTime));
+        }
+
         initQueryMap();
     }
 
     std::shared_ptr<DataObjectBase> RemappedBrightnessTemperatureVariable::exportData(
                                                        const BufrDataMap& map)
+    {
+        return exportData(map, ExportedDataMap());
+    }
+
+    std::shared_ptr<DataObjectBase> RemappedBrightnessTemperatureVariable::exportData(
+                                                       const BufrDataMap& map,
+                                                       const ExportedDataMap& exported)
     {
         checkKeys(map);
 
@@ -79,42 +98,57 @@ namespace Ingester
         std::vector<int> scanline(fovnObj->size(), DataObject<int>::missingValue());
 
         // Get observation time (obstime) variable
-        auto datetimeObj = datetime_.exportData(map);
+        std::shared_ptr<DataObjectBase> datetimeObj;
+        if (datetime_)
+        {
+            datetimeObj = datetime_->exportData(map);
+        }
+        else
+        {
+            const auto datetimeIt = exported.find(obsTimeName_);
+            if (datetimeIt == exported.end())
+            {
+                std::ostringstream errStr;
+                errStr << "The obsTime variable " << obsTimeName_ << " of " << getExportName();
+                errStr << " has not been exported.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            datetimeObj = datetimeIt->second;
+        }
+
         std::vector<int64_t> obstime;
-        obstime = std::dynamic_pointer_cast<DataObject<int64_t>>(datetimeObj)->getRawData();
+        datetimeObj->copyAs(obstime);
 
         // Get field-of-view number
-        std::vector<int> fovn(fovnObj->size(), DataObject<int>::missingValue());
-        for (size_t idx = 0; idx < fovnObj->size(); idx++)
-        {
-           fovn[idx] = fovnObj->getAsInt(idx);
-        }
+        std::vector<int> fovn;
+        fovnObj->copyAs(fovn);
 
         // Get sensor channel
-        std::vector<int> channel(sensorChanObj->size(), DataObject<int>::missingValue());
-        for (size_t idx = 0; idx < sensorChanObj->size(); idx++)
-        {
-           channel[idx] = sensorChanObj->getAsInt(idx);
-        }
+        std::vector<int> channel;
+        sensorChanObj->copyAs(channel);
 
         // Get brightness temperature (observation)
-        std::vector<float> btobs(radObj->size(), DataObject<float>::missingValue());
-        for (size_t idx = 0; idx < radObj->size(); idx++)
-        {
-           btobs[idx] = radObj->getAsFloat(idx);
-        }
+        std::vector<float> btobs;
+        radObj->copyAs(btobs);
 
         // Perform FFT image remapping
         // input only variables: nobs, nchn obstime, fovn, channel
         // input & output variables: btobs, scanline, error_status
         if (nobs > 0) {
             int error_status;
-            ATMS_Spatial_Average_f(nobs, nchn, &obstime, &fovn, &channel, &btobs,
-                                               &scanline, &error_status);
+            ATMS_Spatial_Average_f(nobs, nchn, obstime.data(), fovn.data(), channel.data(),
+                                   btobs.data(), scanline.data(), &error_status);
+
+            if (error_status != 0)
+            {
+                oops::Log::warning() << "RemappedBrightnessTemperatureVariable: the remapping of "
+                                     << getExportName() << " failed." << std::endl;
+            }
         }
 
         // Export remapped observation (btobs)
-        return std::make_shared<DataObject<float>>(btobs,
+        return std::make_shared<DataObject<float>>(std::move(btobs),
                                                    getExportName(),
                                                    groupByField_,
                                                    radObj->getDims(),
@@ -155,6 +189,12 @@ namespace Ingester
         }
     }
 
+    std::vector<std::string> RemappedBrightnessTemperatureVariable::getDependencies() const
+    {
+        if (datetime_) return {};
+        return {obsTimeName_};
+    }
+
     QueryList RemappedBrightnessTemperatureVariable::makeQueryList() const
     {
         auto queries = QueryList();
@@ -171,8 +211,11 @@ namespace Ingester
             }
         }
 
-        auto datetimequerys = datetime_.makeQueryList();
-        queries.insert(queries.end(), datetimequerys.begin(), datetimequerys.end());
+        if (datetime_)
+        {
+            auto datetimequerys = datetime_->makeQueryList();
+            queries.insert(queries.end(), datetimequerys.begin(), datetimequerys.end());
+        }
 
         return queries;
     }
@@ -34,11 +34,28 @@ namespace Ingester
         /// \param map BufrDataMap that contains the parsed data for each mnemonic
         std::shared_ptr<DataObjectBase> exportData(const BufrDataMap& map) final;
 
+        /// \brief Get the configured mnemonics and turn them into RemappedBrightnessTemperature,
+        ///        with the observation times of another exported variable if obsTime names one
+        /// \param map BufrDataMap that contains the parsed data for each mnemonic
+        /// \param exported The variables exported so far
+        std::shared_ptr<DataObjectBase> exportData(const BufrDataMap& map,
+                                                   const ExportedDataMap& exported) final;
+
+        /// \brief The datetime variable obsTime names (if it does)
+        std::vector<std::string> getDependencies() const final;
+
+        /// \brief The (Fortran) remapping isn't reentrant without OpenMP (and uses it itself).
+        bool isThreadSafe() const final { return false; }
+
         /// \brief Get a list of queries for this variable
         QueryList makeQueryList() const final;
 
      private:
-        DatetimeVariable datetime_;
+        /// \brief Computes the observation times (null when obsTime names an exported variable)
+        std::unique_ptr<DatetimeVariable> datetime_;
+
+        /// \brief The exported variable with the observation times (empty with datetime_)
+        std::string obsTimeName_;
 
         /// \brief makes sure the bufr data map has all the required keys.
         void checkKeys(const BufrDataMap& map);
@@ -0,0 +1,152 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DataObject.h"
+
+
+namespace Ingester
+{
+namespace scan
+{
+    /// \brief The scan geometries the sensor scan variables know about.
+    enum class Sensor
+    {
+        CrossTrack,  // One field of view per scan position (ex: amsua, atms, mhs)
+        Iasi         // 2x2 fields of view per field of regard
+    };
+
+    /// \brief The sensor for a configured sensor name.
+    inline Sensor sensorFromName(const std::string& name)
+    {
+        return name == "iasi" ? Sensor::Iasi : Sensor::CrossTrack;
+    }
+
+    /// \brief The scan angle parameters (degrees).
+    struct AngleParams
+    {
+        float start = 0;
+        float step = 0;
+        float stepAdjust = 0;  // Iasi only
+    };
+
+    template<Sensor S>
+    struct Geometry;
+
+    template<>
+    struct Geometry<Sensor::CrossTrack>
+    {
+        /// \brief What the angles carry from one field of view to the next (nothing).
+        struct State {};
+
+        static int position(int fovn) { return fovn; }
+
+        static float angle(int fovn, int, const AngleParams& params, State&)
+        {
+            return params.start + static_cast<float>(fovn - 1) * params.step;
+        }
+    };
+
+    template<>
+    struct Geometry<Sensor::Iasi>
+    {
+        /// \brief Whether an odd scan position was seen yet.
+        struct State
+        {
+            bool isAdjustUp = false;
+        };
+
+        static int position(int fovn) { return (fovn - 1) / 2 + 1; }
+
+        // The adjustment is -stepAdjust up to the first odd scan position of the export and
+        // +stepAdjust from then on (the values the reference outputs were made with).
+        static float angle(int fovn, int position, const AngleParams& params, State& state)
+        {
+            if (position % 2 == 1) state.isAdjustUp = true;
+
+            const float adjust = state.isAdjustUp ? params.stepAdjust : -params.stepAdjust;
+            return params.start + static_cast<float>((fovn - 1) / 4) * params.step + adjust;
+        }
+    };
+
+    /// \brief Compute the scan positions. Missing fields of view stay missing.
+    template<Sensor S>
+    void positions(const std::vector<int>& fovn, std::vector<int>& position)
+    {
+        const int missingInt = DataObject<int>::missingValue();
+
+        position.resize(fovn.size());
+        for (size_t idx = 0; idx < fovn.size(); idx++)
+        {
+            const int fov = fovn[idx];
+            position[idx] = (fov != missingInt) ? Geometry<S>::position(fov) : missingInt;
+        }
+    }
+
+    /// \brief Compute the scan positions and angles in one pass. Missing fields of view stay
+    ///        missing.
+    template<Sensor S>
+    void anglesAndPositions(const std::vector<int>& fovn,
+                            const AngleParams& params,
+                            std::vector<float>& angle,
+                            std::vector<int>& position)
+    {
+        const int missingInt = DataObject<int>::missingValue();
+        const float missingFloat = DataObject<float>::missingValue();
+
+        typename Geometry<S>::State state;
+        angle.resize(fovn.size());
+        position.resize(fovn.size());
+        for (size_t idx = 0; idx < fovn.size(); idx++)
+        {
+            const int fov = fovn[idx];
+            const bool isValid = fov != missingInt;
+            const int pos = Geometry<S>::position(fov);
+            const float value = Geometry<S>::angle(fov, pos, params, state);
+
+            position[idx] = isValid ? pos : missingInt;
+            angle[idx] = isValid ? value : missingFloat;
+        }
+    }
+
+    /// \brief Compute the scan positions with the kernel for the sensor.
+    inline void positions(Sensor sensor, const std::vector<int>& fovn, std::vector<int>& position)
+    {
+        switch (sensor)
+        {
+            case Sensor::Iasi:
+                positions<Sensor::Iasi>(fovn, position);
+                break;
+            case Sensor::CrossTrack:
+                positions<Sensor::CrossTrack>(fovn, position);
+                break;
+        }
+    }
+
+    /// \brief Compute the scan positions and angles with the kernel for the sensor.
+    inline void anglesAndPositions(Sensor sensor,
+                                   const std::vector<int>& fovn,
+                                   const AngleParams& params,
+                                   std::vector<float>& angle,
+                                   std::vector<int>& position)
+    {
+        switch (sensor)
+        {
+            case Sensor::Iasi:
+                anglesAndPositions<Sensor::Iasi>(fovn, params, angle, position);
+                break;
+            case Sensor::CrossTrack:
+                anglesAndPositions<Sensor::CrossTrack>(fovn, params, angle, position);
+                break;
+        }
+    }
+}  // namespace scan
+}  // namespace Ingester
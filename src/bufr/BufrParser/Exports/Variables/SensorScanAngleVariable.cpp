@@ -11,6 +11,7 @@
 #include <ostream>
 #include <time.h>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "eckit/exception/Exceptions.h"
@@ -43,99 +44,47 @@ namespace Ingester
       Variable(exportName, groupByField, conf)
     {
         initQueryMap();
-    }
 
-    std::shared_ptr<DataObjectBase> SensorScanAngleVariable::exportData(const BufrDataMap& map)
-    {
-        checkKeys(map);
-
-        // Get input parameters for sensor scan angle calculation
-        std::string sensor;
-        if (conf_.has(ConfKeys::Sensor) )
-        {
-             sensor = conf_.getString(ConfKeys::Sensor);
-        }
-        else
+        if (!conf_.has(ConfKeys::Sensor))
         {
             throw eckit::BadParameter("Missing required parameters: sensor. "
                                       "Check your configuration.");
         }
 
-        float start = 0;
-        float step = 0;
-        float stepAdj = 0;
-        if (conf_.has(ConfKeys::ScanStart) && conf_.has(ConfKeys::ScanStep))
-        {
-             start = conf_.getFloat(ConfKeys::ScanStart);
-             step = conf_.getFloat(ConfKeys::ScanStep);
-        }
-        else
+        if (!conf_.has(ConfKeys::ScanStart) || !conf_.has(ConfKeys::ScanStep))
         {
             throw eckit::BadParameter("Missing required parameters: scan starting angle and step. "
                                       "Check your configuration.");
         }
 
-        if (conf_.has(ConfKeys::ScanStepAdjust) && sensor == "iasi" )
+        sensor_ = scan::sensorFromName(conf_.getString(ConfKeys::Sensor));
+        params_.start = conf_.getFloat(ConfKeys::ScanStart);
+        params_.step = conf_.getFloat(ConfKeys::ScanStep);
+
+        if (sensor_ == scan::Sensor::Iasi && conf_.has(ConfKeys::ScanStepAdjust))
         {
-             sensor = conf_.getString(ConfKeys::Sensor);
-             stepAdj = conf_.getFloat(ConfKeys::ScanStepAdjust);
+            params_.stepAdjust = conf_.getFloat(ConfKeys::ScanStepAdjust);
         }
+    }
 
-        // Read the variables from the map
+    std::shared_ptr<DataObjectBase> SensorScanAngleVariable::exportData(const BufrDataMap& map)
+    {
+        checkKeys(map);
 
+        // Read the variables from the map
         auto& fovnObj = map.at(getExportKey(ConfKeys::FieldOfViewNumber));
 
-        // Declare and initialize scanline array
-        // scanline has the same dimension as fovn
-        std::vector<float> scanang(fovnObj->size(), DataObject<float>::missingValue());
-        std::vector<int> scanpos(fovnObj->size(), DataObject<int>::missingValue());
-
         // Get field-of-view number
-        std::vector<int> fovn(fovnObj->size(), DataObject<int>::missingValue());
-        for (size_t idx = 0; idx < fovnObj->size(); idx++)
-        {
-           fovn[idx] = fovnObj->getAsInt(idx);
-        }
-
-        if (sensor == "iasi")
-        {
-           for (size_t idx = 0; idx < fovnObj->size(); idx++)
-           {
-              scanpos[idx] = (fovnObj->getAsInt(idx) - 1) / 2 + 1;
-           }
-        }
-        else
-        {
-           for (size_t idx = 0; idx < fovnObj->size(); idx++)
-           {
-              scanpos[idx] = fovnObj->getAsInt(idx);
-           }
-        }
+        std::vector<int> fovn;
+        fovnObj->copyAs(fovn);
 
-        if (sensor == "iasi")
-        {
-           float tmp;
-           tmp = -stepAdj;
-           // Calculate sensor scan angle
-           for (size_t idx = 0; idx < fovnObj->size(); idx++)
-           {
-              if (scanpos[idx] % 2 == 1)
-              {
-                 tmp = stepAdj;
-              }
-              scanang[idx] = start + static_cast<float>((fovn[idx]-1)/4) * step + tmp;
-           }
-        }
-        else
-        {
-           for (size_t idx = 0; idx < fovnObj->size(); idx++)
-           {
-              scanang[idx] = start + static_cast<float>(fovn[idx]-1) * step;
-           }
-        }
+        // Calculate the sensor scan angle (scanang has the same dimensions as fovn)
+        std::vector<float> scanang;
+        std::vector<int> scanpos;
+        scan::anglesAndPositions(sensor_, fovn, params_, scanang, scanpos);
 
         // Export sensor scan angle (view angle)
-        return std::make_shared<DataObject<float>>(scanang,
+        return std::make_shared<DataObject<float>>(std::move(scanang),
                                                    getExportName(),
                                                    groupByField_,
                                                    fovnObj->getDims(),
@@ -14,6 +14,7 @@
 #include "eckit/config/LocalConfiguration.h"
 
 #include "Variable.h"
+#include "SensorScan.h"
 
 
 namespace Ingester
@@ -37,6 +38,12 @@ namespace Ingester
         QueryList makeQueryList() const final;
 
      private:
+        /// \brief The scan geometry of the sensor.
+        scan::Sensor sensor_;
+
+        /// \brief The scan angle parameters.
+        scan::AngleParams params_;
+
         /// \brief makes sure the bufr data map has all the required keys.
         void checkKeys(const BufrDataMap& map);
 
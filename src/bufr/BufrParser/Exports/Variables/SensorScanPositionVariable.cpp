@@ -11,6 +11,7 @@
 #include <ostream>
 #include <time.h>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "eckit/exception/Exceptions.h"
@@ -41,55 +42,38 @@ namespace Ingester
       Variable(exportName, groupByField, conf)
     {
         initQueryMap();
+
+        if (!conf_.has(ConfKeys::Sensor))
+        {
+            throw eckit::BadParameter("Missing required parameters: sensor. "
+                                      "Check your configuration.");
+        }
+
+        sensor_ = scan::sensorFromName(conf_.getString(ConfKeys::Sensor));
     }
 
     std::shared_ptr<DataObjectBase> SensorScanPositionVariable::exportData(const BufrDataMap& map)
     {
         checkKeys(map);
 
-        // Get input parameters for sensor scan position calculation
-        std::string sensor;
-        if (conf_.has(ConfKeys::Sensor) )
-        {
-             sensor = conf_.getString(ConfKeys::Sensor);
-        }
-        else
-        {
-            throw eckit::BadParameter("Missing required parameters: sensor"
-                                      "Check your configuration.");
-        }
-
         // Read the variables from the map
         auto& fovnObj = map.at(getExportKey(ConfKeys::FieldOfViewNumber));
 
-        // Declare and initialize scanline array
-        // scanline has the same dimension as fovn
-        std::vector<int> scanpos(fovnObj->size(), DataObject<int>::missingValue());
-
         // Get field-of-view number
-        std::vector<int> fovn(fovnObj->size(), DataObject<int>::missingValue());
-        if (sensor == "iasi")
-        {
-           for (size_t idx = 0; idx < fovnObj->size(); idx++)
-           {
-              scanpos[idx] = (fovnObj->getAsInt(idx) - 1) / 2 + 1;
-           }
-        }
-        else
-        {
-           for (size_t idx = 0; idx < fovnObj->size(); idx++)
-           {
-              scanpos[idx] = fovnObj->getAsInt(idx);
-           }
-        }
-
-        // Export sensor scan angle (view angle)
-        return std::make_shared<DataObject<int>>(scanpos,
-                                                   getExportName(),
-                                                   groupByField_,
-                                                   fovnObj->getDims(),
-                                                   fovnObj->getPath(),
-                                                   fovnObj->getDimPaths());
+        std::vector<int> fovn;
+        fovnObj->copyAs(fovn);
+
+        // Calculate the scan position (scanpos has the same dimensions as fovn)
+        std::vector<int> scanpos;
+        scan::positions(sensor_, fovn, scanpos);
+
+        // Export sensor scan position
+        return std::make_shared<DataObject<int>>(std::move(scanpos),
+                                                 getExportName(),
+                                                 groupByField_,
+                                                 fovnObj->getDims(),
+                                                 fovnObj->getPath(),
+                                                 fovnObj->getDimPaths());
     }
 
     void SensorScanPositionVariable::checkKeys(const BufrDataMap& map)
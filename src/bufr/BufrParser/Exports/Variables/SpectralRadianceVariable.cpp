@@ -5,12 +5,13 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <memory>
 #include <ostream>
-#include <time.h>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "eckit/exception/Exceptions.h"
@@ -59,35 +60,86 @@ namespace Ingester
         auto& endChanObj = map.at(getExportKey(ConfKeys::EndChannel));
         auto& scaleFactorObj = map.at(getExportKey(ConfKeys::ScaleFactor));
 
-        // Declare unscale spectral radiance data array from scaled spectral radiance
-        std::vector<float> outData((radObj->size()), DataObject<float>::missingValue());
-
         // Get dimensions
-        size_t nchns = (radObj->getDims())[1];
-        size_t nbands = (startChanObj->getDims())[1];
+        const size_t nchns = (radObj->getDims())[1];
+        const size_t nbands = (startChanObj->getDims())[1];
+
+        std::vector<float> radiances;
+        std::vector<int> channels;
+        std::vector<int> startChannels;
+        std::vector<int> endChannels;
+        std::vector<float> scaleFactors;
+        radObj->copyAs(radiances);
+        sensorChanObj->copyAs(channels);
+        startChanObj->copyAs(startChannels);
+        endChanObj->copyAs(endChannels);
+        scaleFactorObj->copyAs(scaleFactors);
+
+        // The scale of each band (missing scale factors give missing radiances)
+        const auto missingFloat = DataObject<float>::missingValue();
+        std::vector<float> bandScales(scaleFactors.size(), missingFloat);
+        for (size_t bandOffset = 0; bandOffset < scaleFactors.size(); bandOffset++)
+        {
+            if (scaleFactors[bandOffset] != missingFloat)
+            {
+                bandScales[bandOffset] = powf(10.0f, -scaleFactors[bandOffset]);
+            }
+        }
 
-        // Convert the scaled radiance to unscaled radiance
-        for (size_t idx = 0; idx < radObj->size(); idx++)
+        // Convert the scaled radiance to unscaled radiance, one location at a time. The bands of
+        // the channels (the first band with the channel, otherwise the last one) are only looked
+        // up again when the channels or the band definitions change from the previous location.
+        std::vector<float> outData(radiances.size(), missingFloat);
+        std::vector<size_t> chanBands(nchns, 0);
+        std::vector<float> chanScales(nchns, missingFloat);
+        const size_t nlocs = (nchns > 0) ? radiances.size() / nchns : 0;
+        for (size_t iloc = 0; iloc < nlocs; iloc++)
         {
-            auto channel = sensorChanObj->getAsInt(idx);
-            size_t iloc = static_cast<size_t>(floor(idx / nchns));
-            size_t bandOffset;
+            const auto chanBegin = channels.begin() + iloc * nchns;
+            const auto bandBegin = iloc * nbands;
+            const bool isSameLayout = iloc > 0 &&
+                std::equal(chanBegin, chanBegin + nchns, chanBegin - nchns) &&
+                std::equal(startChannels.begin() + bandBegin,
+                           startChannels.begin() + bandBegin + nbands,
+                           startChannels.begin() + bandBegin - nbands) &&
+                std::equal(endChannels.begin() + bandBegin,
+                           endChannels.begin() + bandBegin + nbands,
+                           endChannels.begin() + bandBegin - nbands);
+
+            if (!isSameLayout)
+            {
+                for (size_t ichn = 0; ichn < nchns; ichn++)
+                {
+                    const auto channel = chanBegin[ichn];
+                    size_t ibnd = 0;
+                    while (ibnd + 1 < nbands &&
+                           !(channel >= startChannels[bandBegin + ibnd] &&
+                             channel <= endChannels[bandBegin + ibnd]))
+                    {
+                        ibnd++;
+                    }
+
+                    chanBands[ichn] = ibnd;
+                }
+            }
 
-            for (size_t ibnd = 0; ibnd < nbands; ibnd++)
+            for (size_t ichn = 0; ichn < nchns; ichn++)
             {
-                bandOffset = iloc * nbands + ibnd;
-               if (channel >= startChanObj->getAsInt(bandOffset) &&
-                   channel <= endChanObj->getAsInt(bandOffset)) break;
+                chanScales[ichn] = (nbands > 0) ? bandScales[bandBegin + chanBands[ichn]]
+                                                : missingFloat;
             }
 
-            if (!radObj->isMissing(idx) && !scaleFactorObj->isMissing(bandOffset))
+            const float* radRow = radiances.data() + iloc * nchns;
+            float* outRow = outData.data() + iloc * nchns;
+            for (size_t ichn = 0; ichn < nchns; ichn++)
             {
-                auto scaleFactor = powf(10.0f, -(scaleFactorObj->getAsFloat(bandOffset) ));
-                outData[idx] = radObj->getAsFloat(idx) * scaleFactor;
+                const bool isMissing = radRow[ichn] == missingFloat ||
+                                       chanScales[ichn] == missingFloat;
+                outRow[ichn] = isMissing ? missingFloat : radRow[ichn] * chanScales[ichn];
             }
         }
 
-        return std::make_shared<DataObject<float>>(outData,
+        return std::make_shared<DataObject<float>>(std::move(outData),
                                                    getExportName(),
                                                    groupByField_,
                                                    radObj->getDims(),
@@ -10,12 +10,14 @@
 #include <locale>
 #include <ostream>
 #include <ctime>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
 #include "eckit/exception/Exceptions.h"
 #include "oops/util/Logger.h"
 
+#include "BufrParser/Query/EpochTime.h"
 #include "DataObject.h"
 #include "TimeoffsetVariable.h"
 #include "Transforms/TransformBuilder.h"
@@ -46,16 +48,6 @@ namespace Ingester
     {
         checkKeys(map);
 
-        std::tm tm{};                // zero initialise
-        tm.tm_year = 1970 - 1900;    // 1970
-        tm.tm_mon = 0;               // Jan=0, Feb=1, ...
-        tm.tm_mday = 1;              // 1st
-        tm.tm_hour = 0;              // midnight
-        tm.tm_min = 0;
-        tm.tm_sec = 0;
-        tm.tm_isdst = 0;             // Not daylight saving
-        std::time_t epochDt = timegm(&tm);
-
         // Convert the reference time (ISO8601 string) to time struct
         std::tm ref_time = {};
         std::istringstream ss(conf_.getString(ConfKeys::Referencetime));
@@ -78,22 +70,24 @@ namespace Ingester
             }
         }
 
-        auto timeDiffs = std::vector<int64_t> (timeOffsets->size());
-        for (size_t idx = 0; idx < timeOffsets->size(); ++idx)
-        {
-            auto diff_time = DataObject<int64_t>::missingValue();
-            if (!timeOffsets->isMissing(idx))
-            {
-                auto obs_tm = ref_time;
-                obs_tm.tm_sec = ref_time.tm_sec + timeOffsets->getAsInt(idx);
-                auto thisTime = timegm(&obs_tm);
-                diff_time = static_cast<int64_t>(difftime(thisTime, epochDt));
-            }
+        const auto refTime = bufr::secondsSinceEpoch(ref_time.tm_year + 1900,
+                                                     ref_time.tm_mon + 1,
+                                                     ref_time.tm_mday,
+                                                     ref_time.tm_hour,
+                                                     ref_time.tm_min,
+                                                     ref_time.tm_sec);
+
+        // The offsets are truncated to whole seconds (like getAsInt).
+        std::vector<int64_t> timeDiffs;
+        timeOffsets->copyAs(timeDiffs);
 
-            timeDiffs[idx] = diff_time;
+        const auto missingDiff = DataObject<int64_t>::missingValue();
+        for (auto& timeDiff : timeDiffs)
+        {
+            timeDiff = (timeDiff == missingDiff) ? missingDiff : refTime + timeDiff;
         }
 
-        return std::make_shared<DataObject<int64_t>>(timeDiffs,
+        return std::make_shared<DataObject<int64_t>>(std::move(timeDiffs),
                                                      getExportName(),
                                                      groupByField_,
                                                      timeOffsets->getDims(),
@@ -0,0 +1,433 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "ExpressionTransform.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    /// \brief The number of values the program runs over at once.
+    const size_t BlockSize = 256;
+}  // namespace
+
+namespace Ingester
+{
+    /// \brief Recursive descent parser that compiles an expression into a postfix program.
+    class ExpressionTransform::Parser
+    {
+     public:
+        Parser(const std::string& expression, std::vector<Op>& program) :
+          expression_(expression),
+          program_(program)
+        {
+        }
+
+        void parse()
+        {
+            parseSum();
+            skipSpaces();
+            if (pos_ != expression_.size()) fail("unexpected character");
+        }
+
+     private:
+        const std::string& expression_;
+        std::vector<Op>& program_;
+        size_t pos_ = 0;
+
+        void emit(OpCode code, double value = 0) { program_.push_back({code, value}); }
+
+        [[noreturn]] void fail(const std::string& reason) const
+        {
+            std::ostringstream errStr;
+            errStr << "Invalid transform expression \"" << expression_ << "\": " << reason;
+            errStr << " at position " << pos_ << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        void skipSpaces()
+        {
+            while (pos_ < expression_.size() && std::isspace(expression_[pos_])) pos_++;
+        }
+
+        bool accept(char token)
+        {
+            skipSpaces();
+            if (pos_ < expression_.size() && expression_[pos_] == token)
+            {
+                pos_++;
+                return true;
+            }
+
+            return false;
+        }
+
+        void expect(char token)
+        {
+            if (!accept(token)) fail(std::string("expected '") + token + "'");
+        }
+
+        // sum := product (('+' | '-') product)*
+        void parseSum()
+        {
+            parseProduct();
+            for (;;)
+            {
+                if (accept('+'))
+                {
+                    parseProduct();
+                    emit(OpCode::Add);
+                }
+                else if (accept('-'))
+                {
+                    parseProduct();
+                    emit(OpCode::Sub);
+                }
+                else
+                {
+                    return;
+                }
+            }
+        }
+
+        // product := unary (('*' | '/') unary)*
+        void parseProduct()
+        {
+            parseUnary();
+            for (;;)
+            {
+                if (accept('*'))
+                {
+                    parseUnary();
+                    emit(OpCode::Mul);
+                }
+                else if (accept('/'))
+                {
+                    parseUnary();
+                    emit(OpCode::Div);
+                }
+                else
+                {
+                    return;
+                }
+            }
+        }
+
+        // unary := ('-' | '+') unary | power
+        void parseUnary()
+        {
+            if (accept('-'))
+            {
+                parseUnary();
+                emit(OpCode::Neg);
+            }
+            else if (accept('+'))
+            {
+                parseUnary();
+            }
+            else
+            {
+                parsePower();
+            }
+        }
+
+        // power := primary ('^' unary)?  (right associative, -x^2 is -(x^2))
+        void parsePower()
+        {
+            parsePrimary();
+            if (accept('^'))
+            {
+                parseUnary();
+                emit(OpCode::Pow);
+            }
+        }
+
+        // primary := number | x | function '(' sum (',' sum)* ')' | '(' sum ')'
+        void parsePrimary()
+        {
+            skipSpaces();
+            if (pos_ >= expression_.size()) fail("unexpected end");
+
+            const char next = expression_[pos_];
+            if (std::isdigit(next) || next == '.')
+            {
+                const char* begin = expression_.c_str() + pos_;
+                char* end = nullptr;
+                const double value = std::strtod(begin, &end);
+                if (end == begin) fail("invalid number");
+                pos_ += end - begin;
+                emit(OpCode::PushConst, value);
+            }
+            else if (std::isalpha(next))
+            {
+                const auto nameStart = pos_;
+                while (pos_ < expression_.size() &&
+                       (std::isalnum(expression_[pos_]) || expression_[pos_] == '_'))
+                {
+                    pos_++;
+                }
+
+                const auto name = expression_.substr(nameStart, pos_ - nameStart);
+                if (name == "x")
+                {
+                    emit(OpCode::PushX);
+                }
+                else
+                {
+                    parseFunction(name);
+                }
+            }
+            else if (accept('('))
+            {
+                parseSum();
+                expect(')');
+            }
+            else
+            {
+                fail("unexpected character");
+            }
+        }
+
+        void parseFunction(const std::string& name)
+        {
+            struct Function
+            {
+                OpCode code;
+                size_t numArgs;
+            };
+
+            static const std::unordered_map<std::string, Function> Functions = {
+                {"abs", {OpCode::Abs, 1}},
+                {"sqrt", {OpCode::Sqrt, 1}},
+                {"exp", {OpCode::Exp, 1}},
+                {"log", {OpCode::Log, 1}},
+                {"log10", {OpCode::Log10, 1}},
+                {"min", {OpCode::Min, 2}},
+                {"max", {OpCode::Max, 2}},
+                {"pow", {OpCode::Pow, 2}},
+                {"clip", {OpCode::Clip, 3}}
+            };
+
+            const auto function = Functions.find(name);
+            if (function == Functions.end())
+            {
+                fail("unknown name " + name);
+            }
+
+            const auto code = function->second.code;
+            const auto numArgs = function->second.numArgs;
+
+            expect('(');
+            for (size_t argIdx = 0; argIdx < numArgs; argIdx++)
+            {
+                if (argIdx > 0) expect(',');
+                parseSum();
+            }
+
+            expect(')');
+            emit(code);
+        }
+    };
+
+    ExpressionTransform::ExpressionTransform(const std::string& expression)
+    {
+        Parser(expression, program_).parse();
+
+        size_t depth = 0;
+        for (const auto& op : program_)
+        {
+            switch (op.code)
+            {
+                case OpCode::PushX:
+                case OpCode::PushConst:
+                    depth++;
+                    break;
+                case OpCode::Add:
+                case OpCode::Sub:
+                case OpCode::Mul:
+                case OpCode::Div:
+                case OpCode::Pow:
+                case OpCode::Min:
+                case OpCode::Max:
+                    depth--;
+                    break;
+                case OpCode::Clip:
+                    depth -= 2;
+                    break;
+                default:
+                    break;
+            }
+
+            stackDepth_ = std::max(stackDepth_, depth);
+        }
+    }
+
+    void ExpressionTransform::apply(std::shared_ptr<DataObjectBase>& dataObject)
+    {
+        dataObject->mapValues([this](double* values, size_t count)
+        {
+            evaluate(values, count);
+        });
+    }
+
+    void ExpressionTransform::evaluate(double* values, size_t count) const
+    {
+        // Each op runs over a whole block of values, so the op dispatch is paid once per block.
+        std::vector<double> stack(stackDepth_ * BlockSize);
+        for (size_t blockStart = 0; blockStart < count; blockStart += BlockSize)
+        {
+            const size_t num = std::min(BlockSize, count - blockStart);
+            double* blockValues = values + blockStart;
+
+            size_t depth = 0;
+            auto top = [&](size_t fromTop) { return stack.data() + (depth - fromTop) * BlockSize; };
+
+            for (const auto& op : program_)
+            {
+                switch (op.code)
+                {
+                    case OpCode::PushX:
+                        depth++;
+                        std::copy(blockValues, blockValues + num, top(1));
+                        break;
+                    case OpCode::PushConst:
+                        depth++;
+                        std::fill(top(1), top(1) + num, op.value);
+                        break;
+                    case OpCode::Add:
+                    {
+                        double* lhs = top(2);
+                        const double* rhs = top(1);
+                        for (size_t idx = 0; idx < num; idx++) lhs[idx] += rhs[idx];
+                        depth--;
+                        break;
+                    }
+                    case OpCode::Sub:
+                    {
+                        double* lhs = top(2);
+                        const double* rhs = top(1);
+                        for (size_t idx = 0; idx < num; idx++) lhs[idx] -= rhs[idx];
+                        depth--;
+                        break;
+                    }
+                    case OpCode::Mul:
+                    {
+                        double* lhs = top(2);
+                        const double* rhs = top(1);
+                        for (size_t idx = 0; idx < num; idx++) lhs[idx] *= rhs[idx];
+                        depth--;
+                        break;
+                    }
+                    case OpCode::Div:
+                    {
+                        double* lhs = top(2);
+                        const double* rhs = top(1);
+                        for (size_t idx = 0; idx < num; idx++) lhs[idx] /= rhs[idx];
+                        depth--;
+                        break;
+                    }
+                    case OpCode::Pow:
+                    {
+                        double* lhs = top(2);
+                        const double* rhs = top(1);
+                        for (size_t idx = 0; idx < num; idx++)
+                        {
+                            lhs[idx] = std::pow(lhs[idx], rhs[idx]);
+                        }
+
+                        depth--;
+                        break;
+                    }
+                    case OpCode::Min:
+                    {
+                        double* lhs = top(2);
+                        const double* rhs = top(1);
+                        for (size_t idx = 0; idx < num; idx++)
+                        {
+                            lhs[idx] = std::min(lhs[idx], rhs[idx]);
+                        }
+
+                        depth--;
+                        break;
+                    }
+                    case OpCode::Max:
+                    {
+                        double* lhs = top(2);
+                        const double* rhs = top(1);
+                        for (size_t idx = 0; idx < num; idx++)
+                        {
+                            lhs[idx] = std::max(lhs[idx], rhs[idx]);
+                        }
+
+                        depth--;
+                        break;
+                    }
+                    case OpCode::Clip:
+                    {
+                        double* value = top(3);
+                        const double* lower = top(2);
+                        const double* upper = top(1);
+                        for (size_t idx = 0; idx < num; idx++)
+                        {
+                            value[idx] = std::min(std::max(value[idx], lower[idx]), upper[idx]);
+                        }
+
+                        depth -= 2;
+                        break;
+                    }
+                    case OpCode::Neg:
+                    {
+                        double* arg = top(1);
+                        for (size_t idx = 0; idx < num; idx++) arg[idx] = -arg[idx];
+                        break;
+                    }
+                    case OpCode::Abs:
+                    {
+                        double* arg = top(1);
+                        for (size_t idx = 0; idx < num; idx++) arg[idx] = std::fabs(arg[idx]);
+                        break;
+                    }
+                    case OpCode::Sqrt:
+                    {
+                        double* arg = top(1);
+                        for (size_t idx = 0; idx < num; idx++) arg[idx] = std::sqrt(arg[idx]);
+                        break;
+                    }
+                    case OpCode::Exp:
+                    {
+                        double* arg = top(1);
+                        for (size_t idx = 0; idx < num; idx++) arg[idx] = std::exp(arg[idx]);
+                        break;
+                    }
+                    case OpCode::Log:
+                    {
+                        double* arg = top(1);
+                        for (size_t idx = 0; idx < num; idx++) arg[idx] = std::log(arg[idx]);
+                        break;
+                    }
+                    case OpCode::Log10:
+                    {
+                        double* arg = top(1);
+                        for (size_t idx = 0; idx < num; idx++) arg[idx] = std::log10(arg[idx]);
+                        break;
+                    }
+                }
+            }
+
+            std::copy(stack.data(), stack.data() + num, blockValues);
+        }
+    }
+}  // namespace Ingester
@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Transform.h"
+
+
+namespace Ingester
+{
+    /// \brief Transforms data with an arithmetic expression of the values (x), for example
+    ///        "(x - 273.15) * 1.8 + 32" or "clip(x, 0, 100)". The expression is compiled once
+    ///        and evaluated in one pass over the data. Missing values stay missing, and results
+    ///        that aren't finite (ex: log(0)) become missing.
+    ///
+    ///        Supports numbers, x, + - * / ^ (power), parentheses and the functions abs, sqrt,
+    ///        exp, log, log10, min, max, pow and clip(value, lower, upper).
+    class ExpressionTransform : public Transform
+    {
+     public:
+        /// \brief Constructor
+        /// \param expression The expression (throws eckit::BadParameter if it is invalid).
+        explicit ExpressionTransform(const std::string& expression);
+        ~ExpressionTransform() = default;
+
+        /// \brief Modify data according to the rules of the transform.
+        /// \param array Array of data to modify.
+        void apply(std::shared_ptr<DataObjectBase>& dataObject) override;
+
+        /// \brief Replace values by the expression of them.
+        /// \param values The values.
+        /// \param count The number of values.
+        void evaluate(double* values, size_t count) const;
+
+     private:
+        enum class OpCode
+        {
+            PushX,
+            PushConst,
+            Add,
+            Sub,
+            Mul,
+            Div,
+            Pow,
+            Neg,
+            Abs,
+            Sqrt,
+            Exp,
+            Log,
+            Log10,
+            Min,
+            Max,
+            Clip
+        };
+
+        struct Op
+        {
+            OpCode code;
+            double value;  // PushConst only
+        };
+
+        /// \brief The expression in postfix order (evaluated on a stack of blocks of values).
+        std::vector<Op> program_;
+
+        /// \brief The deepest the stack gets.
+        size_t stackDepth_ = 0;
+
+        class Parser;
+    };
+}  // namespace Ingester
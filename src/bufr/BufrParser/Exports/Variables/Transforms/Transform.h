@@ -20,7 +20,9 @@ namespace Ingester
      public:
         virtual ~Transform() = default;
 
-        /// \brief Modify data according to the rules of the transform.
+        /// \brief Modify data according to the rules of the transform. The values are changed
+        ///        in place (see DataObjectBase::mapValues), they are only copied first when the
+        ///        object shares them (ex: with its slices).
         /// \param array Array of data to modify.
         virtual void apply(std::shared_ptr<DataObjectBase>& dataObject) = 0;
     };
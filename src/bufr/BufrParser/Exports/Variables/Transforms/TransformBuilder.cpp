@@ -11,11 +11,13 @@
 
 #include "ScalingTransform.h"
 #include "OffsetTransform.h"
+#include "ExpressionTransform.h"
 
 
 static const char* TRANSFORMS_SECTION = "transforms";
 static const char* OFFSET_KEY = "offset";
 static const char* SCALE_KEY = "scale";
+static const char* EXPRESSION_KEY = "expression";
 
 namespace Ingester
 {
@@ -30,6 +32,10 @@ namespace Ingester
         {
             transform = std::make_shared<ScalingTransform>(conf.getFloat(SCALE_KEY));
         }
+        else if (conf.has(EXPRESSION_KEY))
+        {
+            transform = std::make_shared<ExpressionTransform>(conf.getString(EXPRESSION_KEY));
+        }
         else
         {
             throw eckit::BadParameter("Tried to create unknown export transform type. "
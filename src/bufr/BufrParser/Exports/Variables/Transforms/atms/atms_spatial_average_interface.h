@@ -16,12 +16,24 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-  void ATMS_Spatial_Average_f(int num_loc, int nchanl, void* time, void* fov, void* channel,
-                              void* btobs, void* scanline, int* error_status);
+  /// \brief Remap the brightness temperatures of ATMS (3-by-3 averaged footprints).
+  /// \param num_loc The number of locations.
+  /// \param nchanl The number of channels.
+  /// \param time The observation times of the locations (seconds since epoch).
+  /// \param fov The field of view numbers of the locations.
+  /// \param channel The channel numbers (nchanl per location).
+  /// \param btobs The brightness temperatures (nchanl per location), remapped in place.
+  /// \param scanline Set to the scan line of each location.
+  /// \param error_status Set to 0 on success.
+  void ATMS_Spatial_Average_f(int num_loc, int nchanl, const int64_t* time, const int* fov,
+                              const int* channel, float* btobs, int* scanline,
+                              int* error_status);
 
 #ifdef __cplusplus
 }
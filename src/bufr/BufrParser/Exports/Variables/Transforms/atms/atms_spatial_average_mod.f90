@@ -11,6 +11,8 @@ Module ATMS_Spatial_Average_Mod
 ! Program history log:
 !    2011-11-18   collard   - Original version
 !    2017-07-13   yanqiu zhu - fix index bugs in subroutine ATMS_Spatial_Average
+!    2023-10-14   cache the beamwidth requirements and FFT twiddle factors, process
+!                 the channels in parallel (OpenMP)
 ! 
 
   use iodaconv_kinds, only: r_kind,r_double,i_kind, i_llong
@@ -21,6 +23,41 @@ Module ATMS_Spatial_Average_Mod
 ! Declare module level parameters
   real(r_double), parameter    :: Missing_Value=1.e11_r_double
 
+  ! Maximum number of channels 
+  integer(i_kind), parameter :: maxchans = 22
+
+  integer(i_kind), parameter :: nxmax=128  !Max number of spots per scan line
+  integer(i_kind), parameter :: nymax=8192 !Max number of lines. Allows 6hrs of ATMS.
+
+  real(r_kind), parameter :: TWOPI = 6.2831853071795864769 
+
+  ! Beamwidth requirements of one satellite (read from atms_beamwidth.txt)
+  type beamwidth_table
+     integer(i_kind) :: wmosatid = 999
+     integer(i_kind) :: nchannels = 0
+     real(r_kind)    :: sampling_dist = 0.0_r_kind
+     integer(i_kind) :: channelnumber(maxchans) = 0
+     real(r_kind)    :: beamwidth(maxchans) = 0.0_r_kind
+     real(r_kind)    :: newwidth(maxchans) = 0.0_r_kind
+     real(r_kind)    :: cutoff(maxchans) = 0.0_r_kind
+     integer(i_kind) :: nxaverage(maxchans) = 0
+     integer(i_kind) :: nyaverage(maxchans) = 0
+     integer(i_kind) :: qc_dist(maxchans) = 0
+  end type beamwidth_table
+
+  ! The twiddle factors of the FFTs of length N = 2 ** M (see SFFTCF and SFFTCB). The
+  ! factors of the stage of length 2 ** K start after ioffset(K).
+  type fft_plan
+     integer(i_kind) :: n = 0, m = 0
+     integer(i_kind), allocatable :: ioffset(:)
+     real(r_kind), allocatable :: cc1(:), ss1(:), cc3(:), ss3(:)
+  end type fft_plan
+
+  ! The beamwidth requirements read so far, so the file is only read once per satellite
+  integer(i_kind), parameter :: max_tables = 8
+  type(beamwidth_table), save :: tables(max_tables)
+  integer(i_kind), save :: num_tables = 0
+
   private
   public :: ATMS_Spatial_Average
 
@@ -47,13 +84,9 @@ CONTAINS
     ! -------------------------------------------------------------------- 
     ! Declare local parameters
     integer(i_kind), parameter :: atms1c_h_wmosatid = 224
-    integer(i_kind), parameter :: lninfile = 15
     integer(i_kind), parameter :: max_fov = 96
     real(r_kind), parameter    :: scan_interval = 8.0_r_kind/3.0_r_kind
 
-    ! Maximum number of channels 
-    integer(i_kind), parameter :: maxchans = 22
-
     ! Minimum allowed BT as a function of channel number
     real(r_kind), parameter :: minbt(maxchans) = &
          (/ 120.0_r_kind, 120.0_r_kind, 190.0_r_kind, 190.0_r_kind, &
@@ -72,18 +105,17 @@ CONTAINS
             300.0_r_kind, 300.0_r_kind /)
 
     ! Declare local variables
-    character(30) :: cline
-
-    integer(i_kind) :: i, iscan, ifov, ichan, nchannels, wmosatid, version
+    integer(i_kind) :: i, iscan, ifov, ichan
     integer(i_kind) :: ios, max_scan, mintime
-    integer(i_kind) :: nxaverage(nchanl), nyaverage(nchanl)
-    integer(i_Kind) :: channelnumber(nchanl),qc_dist(nchanl)
+    integer(i_kind) :: xpow2, ypow2
     integer(i_kind), allocatable ::  scanline_back(:,:)
 
-    real(r_kind) :: sampling_dist, beamwidth(nchanl)
-    real(r_kind) :: newwidth(nchanl), cutoff(nchanl),err(nchanl)
+    real(r_kind) :: err(nchanl)
     real(r_kind), allocatable, target :: bt_image(:,:,:)
 
+    type(beamwidth_table) :: table
+    type(fft_plan) :: xplan, yplan
+
     ! ------------------------------------------------------------------------------
 
     ! Reshape to 2D array for FFT processing
@@ -176,63 +208,9 @@ CONTAINS
        return 
     endif
 
-    ! Read the beamwidth requirements
-    open(lninfile,file='atms_beamwidth.txt',form='formatted',status='old', &
-         iostat=ios)
-    if (ios /= 0) then 
-       write(*,*) 'Unable to open atms_beamwidth.txt'
-       error_status=1
-       return 
-    endif 
-    wmosatid=999
-    read(lninfile,'(a30)',iostat=ios) cline
-    do while (wmosatid /= atms1c_h_wmosatid .AND. ios == 0)
-       do while (cline(1:1) == '#')
-          read(lninfile,'(a30)') cline
-       enddo 
-       read(cline,*) wmosatid
-
-       read(lninfile,'(a30)') cline
-       do while (cline(1:1) == '#')
-          read(lninfile,'(a30)') cline
-       enddo 
-       read(cline,*) version
-
-       read(lninfile,'(a30)') cline
-       do while (cline(1:1) == '#')
-          read(lninfile,'(a30)') cline
-       enddo 
-       read(cline,*) sampling_dist
-
-       read(lninfile,'(a30)') cline
-       do while (cline(1:1) == '#')
-          read(lninfile,'(a30)') cline
-       enddo 
-       read(cline,*) nchannels
-
-       read(lninfile,'(a30)') cline
-       if (nchannels > 0) then
-          do ichan=1,nchannels
-             read(lninfile,'(a30)') cline
-             do while (cline(1:1) == '#')
-                read(lninfile,'(a30)') cline
-             enddo 
-             read(cline,*) channelnumber(ichan),beamwidth(ichan), &
-                  newwidth(ichan),cutoff(ichan),nxaverage(ichan), &
-                  nyaverage(ichan), qc_dist(ichan)
-!            write(6,*) channelnumber(ichan),beamwidth(ichan), &
-!                 newwidth(ichan),cutoff(ichan),nxaverage(ichan), &
-!                 nyaverage(ichan), qc_dist(ichan)
-          enddo 
-       end if
-       read(lninfile,'(a30)',iostat=ios) cline
-    enddo 
-    if (wmosatid /= atms1c_h_wmosatid) then 
-       write(*,*) 'ATMS_Spatial_Averaging: sat id not matched in atms_beamwidth.dat'
-       error_status=1
-       return 
-    endif 
-    close(lninfile)
+    ! Get the beamwidth requirements
+    call get_beamwidth_table(atms1c_h_wmosatid, table, error_status)
+    if (error_status /= 0) return
 
     ! Determine scanline from time
     mintime = minval(time)
@@ -241,6 +219,14 @@ CONTAINS
     write(6,*) 'ATMS_Spatial_Average: minval/maxval scanline = ', &
                 minval(scanline), maxval(scanline)
 
+    ! The FFTs of all the channels have the same lengths (see MODIFY_BEAMWIDTH)
+    xpow2 = pad_power(max_fov)
+    ypow2 = pad_power(max_scan)
+    if (2**xpow2 <= nxmax .and. 2**ypow2 <= nymax) then
+       call make_fft_plan(xpow2, xplan)
+       call make_fft_plan(ypow2, yplan)
+    endif
+
     allocate(bt_image(max_fov, max_scan, nchanl))
     allocate(scanline_back(max_fov, max_scan))
     bT_image(:,:,:) = 1000.0_r_kind
@@ -254,7 +240,8 @@ CONTAINS
     end do 
 301 format(i6,2x,i6,2x,22(f8.3))
 
-    ! Do FFT transform
+    ! Do FFT transform (the channels are independent)
+    !$omp parallel do private(i, iscan, ifov, ios) schedule(dynamic)
     DO ichan = 1, nchanl
 
        err(ichan) = 0
@@ -268,14 +255,16 @@ CONTAINS
        ! If the channel number is present in the channelnumber array we should
        ! process it 
        ! (otherwise bt_inout just keeps the same value):
-       do i = 1, nchannels
+       do i = 1, table%nchannels
 
-          if (channelnumber(i) == ichan) then
+          if (table%channelnumber(i) == ichan) then
 
              call MODIFY_BEAMWIDTH ( max_fov, max_scan, bt_image(:,:,ichan),   &
-                                     sampling_dist, beamwidth(i), newwidth(i), &
-                                     cutoff(i), nxaverage(i), nyaverage(i),    &
-                                     qc_dist(i), minbt(Ichan), maxbt(ichan), ios)
+                                     table%sampling_dist, table%beamwidth(i),  &
+                                     table%newwidth(i), table%cutoff(i),       &
+                                     table%nxaverage(i), table%nyaverage(i),   &
+                                     table%qc_dist(i), minbt(Ichan), maxbt(ichan), &
+                                     xplan, yplan, ios)
           
              ! Load the transform image array back
              if (ios == 0) THEN
@@ -292,6 +281,7 @@ CONTAINS
           end if
        enddo
     enddo 
+    !$omp end parallel do
 
     do ichan = 1,nchanl
       if(err(ichan) >= 1)then
@@ -309,9 +299,183 @@ CONTAINS
 
 END Subroutine ATMS_Spatial_Average
 
+SUBROUTINE get_beamwidth_table(wmosatid, table, error_status)
+!
+! Get the beamwidth requirements of a satellite, reading atms_beamwidth.txt 
+! (from the current directory) the first time they are needed.
+!
+    IMPLICIT NONE
+
+    integer(i_kind),       intent(in   ) :: wmosatid
+    type(beamwidth_table), intent(  out) :: table
+    integer(i_kind),       intent(  out) :: error_status
+
+    integer(i_kind) :: itable
+
+    error_status = 0
+
+    !$omp critical (atms_beamwidth_tables)
+    itable = 1
+    do while (itable <= num_tables)
+       if (tables(itable)%wmosatid == wmosatid) exit
+       itable = itable + 1
+    enddo
+
+    if (itable <= num_tables) then
+       table = tables(itable)
+    else
+       call read_beamwidth_table(wmosatid, table, error_status)
+       if (error_status == 0 .and. num_tables < max_tables) then
+          num_tables = num_tables + 1
+          tables(num_tables) = table
+       endif
+    endif
+    !$omp end critical (atms_beamwidth_tables)
+
+END SUBROUTINE get_beamwidth_table
+
+SUBROUTINE read_beamwidth_table(atms1c_h_wmosatid, table, error_status)
+!
+! Read the beamwidth requirements of a satellite from atms_beamwidth.txt
+!
+    IMPLICIT NONE
+
+    integer(i_kind),       intent(in   ) :: atms1c_h_wmosatid
+    type(beamwidth_table), intent(  out) :: table
+    integer(i_kind),       intent(  out) :: error_status
+
+    character(30) :: cline
+    integer(i_kind) :: lninfile, ios, ichan, nchannels, wmosatid, version
+
+    error_status = 0
+
+    ! Read the beamwidth requirements
+    open(newunit=lninfile,file='atms_beamwidth.txt',form='formatted',status='old', &
+         iostat=ios)
+    if (ios /= 0) then 
+       write(*,*) 'Unable to open atms_beamwidth.txt'
+       error_status=1
+       return 
+    endif 
+    wmosatid=999
+    read(lninfile,'(a30)',iostat=ios) cline
+    do while (wmosatid /= atms1c_h_wmosatid .AND. ios == 0)
+       do while (cline(1:1) == '#')
+          read(lninfile,'(a30)') cline
+       enddo 
+       read(cline,*) wmosatid
+
+       read(lninfile,'(a30)') cline
+       do while (cline(1:1) == '#')
+          read(lninfile,'(a30)') cline
+       enddo 
+       read(cline,*) version
+
+       read(lninfile,'(a30)') cline
+       do while (cline(1:1) == '#')
+          read(lninfile,'(a30)') cline
+       enddo 
+       read(cline,*) table%sampling_dist
+
+       read(lninfile,'(a30)') cline
+       do while (cline(1:1) == '#')
+          read(lninfile,'(a30)') cline
+       enddo 
+       read(cline,*) nchannels
+
+       if (nchannels > maxchans) then
+          write(*,*) 'ATMS_Spatial_Averaging: too many channels in atms_beamwidth.txt: ', &
+                     nchannels
+          close(lninfile)
+          error_status=1
+          return
+       endif
+
+       read(lninfile,'(a30)') cline
+       if (nchannels > 0) then
+          do ichan=1,nchannels
+             read(lninfile,'(a30)') cline
+             do while (cline(1:1) == '#')
+                read(lninfile,'(a30)') cline
+             enddo 
+             read(cline,*) table%channelnumber(ichan),table%beamwidth(ichan), &
+                  table%newwidth(ichan),table%cutoff(ichan),table%nxaverage(ichan), &
+                  table%nyaverage(ichan), table%qc_dist(ichan)
+          enddo 
+       end if
+       table%nchannels = max(nchannels, 0)
+       read(lninfile,'(a30)',iostat=ios) cline
+    enddo 
+    close(lninfile)
+    if (wmosatid /= atms1c_h_wmosatid) then 
+       write(*,*) 'ATMS_Spatial_Averaging: sat id not matched in atms_beamwidth.dat'
+       error_status=1
+       return 
+    endif 
+    table%wmosatid = wmosatid
+
+END SUBROUTINE read_beamwidth_table
+
+FUNCTION pad_power(n) RESULT(pow2)
+!
+! The power of 2 MODIFY_BEAMWIDTH pads an image dimension of size n to
+!
+    IMPLICIT NONE
+
+    integer(i_kind), intent(in) :: n
+    integer(i_kind) :: pow2
+
+    real(r_kind) :: LN2
+
+    LN2 = LOG(2.0_r_kind)
+    pow2 = INT(LOG(n*1.0_r_kind)/LN2 + 1.0_r_kind)
+
+END FUNCTION pad_power
+
+SUBROUTINE make_fft_plan(m, plan)
+!
+! Compute the twiddle factors of the FFTs of length 2 ** m once, the same way
+! SFFTCF and SFFTCB used to compute them for every call.
+!
+    IMPLICIT NONE
+
+    integer(i_kind), intent(in   ) :: m
+    type(fft_plan),  intent(  out) :: plan
+
+    integer(i_kind) :: j, k, n2, n8, nfactors
+    real(r_kind) :: a, e
+
+    plan%m = m
+    plan%n = 2**m
+    allocate(plan%ioffset(max(m, 1)))
+
+    nfactors = 0
+    do k = 1, m
+       plan%ioffset(k) = nfactors
+       nfactors = nfactors + max(2**k/8 - 1, 0)
+    enddo
+
+    allocate(plan%cc1(nfactors), plan%ss1(nfactors), plan%cc3(nfactors), plan%ss3(nfactors))
+
+    do k = 2, m
+       n2 = 2**k
+       n8 = n2/8
+       e = TWOPI / n2
+       a = e
+       do j = 2, n8
+          plan%cc1(plan%ioffset(k) + j - 1) = COS(a)
+          plan%ss1(plan%ioffset(k) + j - 1) = SIN(a)
+          plan%cc3(plan%ioffset(k) + j - 1) = COS(3 * a)
+          plan%ss3(plan%ioffset(k) + j - 1) = SIN(3 * a)
+          a = j * e
+       enddo
+    enddo
+
+END SUBROUTINE make_fft_plan
+
 SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,& 
      beamwidth, newwidth, mtfcutoff, nxaverage, nyaverage, qc_dist, &
-     Minval, MaxVal, Error)
+     Minval, MaxVal, xplan, yplan, Error)
      
 !-----------------------------------------
 ! Name: $Id$
@@ -355,10 +519,6 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
 
 
       IMPLICIT NONE
-! Parameters
-      INTEGER(I_KIND), PARAMETER :: nxmax=128  !Max number of spots per scan line
-      INTEGER(I_KIND), PARAMETER :: nymax=8192 !Max number of lines. Allows 6hrs of ATMS.
-
 ! Arguments
       INTEGER(I_KIND), INTENT(IN)  :: nx, ny         !Size of image
       REAL(R_KIND), INTENT(INOUT)  :: image(nx,ny)   !BT or radiance image
@@ -371,6 +531,7 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
       INTEGER(I_KIND), INTENT(IN)  :: qc_dist        !Number of samples around missing data to set to 
       REAL(R_KIND), INTENT(IN)     :: maxval         !BTs above this are considered missing
       REAL(R_KIND), INTENT(IN)     :: minval         !BTs below this are considered missing
+      TYPE(FFT_PLAN), INTENT(IN)   :: xplan, yplan   !FFT twiddle factors (padded sizes)
       INTEGER(I_KIND), INTENT(OUT) :: Error          !Error Status
        
 ! Local variables
@@ -406,8 +567,8 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
 !1) Pad the image up to the nearest power of 2 in each dimension, by reversing
 !the points near the edge.
 
-      xpow2 = INT(LOG(nx*1.0_r_kind)/LN2 + 1.0_r_kind)
-      ypow2 = INT(LOG(ny*1.0_r_kind)/LN2 + 1.0_r_kind)
+      xpow2 = pad_power(nx)
+      ypow2 = pad_power(ny)
       nxpad = 2**xpow2
       nypad = 2**ypow2
       dx = (nxpad - nx)/2
@@ -523,8 +684,8 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
             mtfyout(nypad-i+2) = mtfyout(i)
           ENDIF
         ENDDO
-        DO i=1,nxpad
-          DO j=1,nypad
+        DO j=1,nypad
+          DO i=1,nxpad
             mtfin = mtfxin(i)*mtfyin(j)
             mtfout = mtfxout(i)*mtfyout(j)
             if (mtfcutoff > 0.0_r_kind) THEN
@@ -541,11 +702,11 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
 !the rest contain the imaginary part in reverse order.
 
         DO j=1,nypad
-           CALL SFFTCF(imagepad(:,j),nxpad,xpow2)
+           CALL SFFTCF(imagepad(:,j),nxpad,xpow2,xplan)
         ENDDO
 
         DO i=1,nxpad
-           CALL SFFTCF(imagepad(i,:),nypad,ypow2)
+           CALL SFFTCF(imagepad(i,:),nypad,ypow2,yplan)
 
 !4) Multiply the spectrum by the MTF factor
            DO j=1,nypad
@@ -556,11 +717,11 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
 !5) Inverse Fourier transform, column by column then line by line 
 
         DO i=1,nxpad
-          CALL SFFTCB(imagepad(i,:),nypad,ypow2)
+          CALL SFFTCB(imagepad(i,:),nypad,ypow2,yplan)
         ENDDO
 
         DO j=1,nypad
-          CALL SFFTCB(imagepad(:,j),nxpad,xpow2)
+          CALL SFFTCB(imagepad(:,j),nxpad,xpow2,xplan)
         ENDDO
      ENDIF   !New width is specified
 
@@ -650,23 +811,24 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
 !
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 !
-      SUBROUTINE SFFTCF( X, N, M )
+      SUBROUTINE SFFTCF( X, N, M, PLAN )
 
       IMPLICIT NONE
 
 ! ... Parameters ...
       REAL(R_KIND), PARAMETER :: SQRT2 = 1.4142135623730950488
-      REAL(R_KIND), PARAMETER :: TWOPI = 6.2831853071795864769 
 
 ! ... Scalar arguments ...
       INTEGER(I_KIND), INTENT(IN) :: N, M
 ! ... Array arguments ...
       REAL(R_KIND), INTENT(INOUT) ::  X(N)
+! ... Twiddle factors (see make_fft_plan) ...
+      TYPE(FFT_PLAN), INTENT(IN) :: PLAN
 ! ... Local scalars ...
       INTEGER(I_KIND)  J, I, K, IS, ID, I0, I1, I2, I3, I4, I5, I6, I7, I8
       INTEGER(I_KIND)  N1, N2, N4, N8
       REAL(R_KIND)  XT, R1, T1, T2, T3, T4, T5, T6
-      REAL(R_KIND)  A, A3, E, CC1, SS1, CC3, SS3
+      REAL(R_KIND)  CC1, SS1, CC3, SS3
 !
 ! ... Exe. statements ...
 !
@@ -707,7 +869,6 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
          N2 = N2 * 2
          N4 = N2 / 4
          N8 = N2 / 8
-         E = TWOPI / N2
          IS = 0
          ID = N2 * 2
          LOOP2: DO
@@ -736,14 +897,11 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
             ID = 4 * ID
             IF ( IS >=  N ) EXIT LOOP2
          END DO LOOP2
-         A = E
          DO 32, J = 2, N8
-            A3 = 3 * A
-            CC1 = COS(A)
-            SS1 = SIN(A)
-            CC3 = COS(A3)
-            SS3 = SIN(A3)
-            A = J * E
+            CC1 = PLAN%CC1(PLAN%IOFFSET(K) + J - 1)
+            SS1 = PLAN%SS1(PLAN%IOFFSET(K) + J - 1)
+            CC3 = PLAN%CC3(PLAN%IOFFSET(K) + J - 1)
+            SS3 = PLAN%SS3(PLAN%IOFFSET(K) + J - 1)
             IS = 0
             ID = 2 * N2
             LOOP3: DO
@@ -817,7 +975,7 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
 !
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 !
-      SUBROUTINE SFFTCB( X, N, M )
+      SUBROUTINE SFFTCB( X, N, M, PLAN )
 
       use iodaconv_kinds, only: r_kind,r_double,i_kind
 
@@ -825,17 +983,19 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
 
 ! ... Parameters ...
       REAL(R_KIND), PARAMETER :: SQRT2 = 1.4142135623730950488
-      REAL(R_KIND), PARAMETER :: TWOPI = 6.2831853071795864769 
 
 ! ... Scalar arguments ...
       INTEGER(I_KIND), INTENT(IN) :: N, M
 ! ... Array arguments ...
       REAL(R_KIND), INTENT(INOUT) ::  X(N)
+! ... Twiddle factors (see make_fft_plan) ...
+      TYPE(FFT_PLAN), INTENT(IN) :: PLAN
 ! ... Local scalars ...
       INTEGER(I_KIND)  J, I, K, IS, ID, I0, I1, I2, I3, I4, I5, I6, I7, I8
       INTEGER(I_KIND)  N1, N2, N4, N8
       REAL(R_KIND)  XT, R1, T1, T2, T3, T4, T5
-      REAL(R_KIND)  A, A3, E, CC1, SS1, CC3, SS3
+      REAL(R_KIND)  CC1, SS1, CC3, SS3
+      INTEGER(I_KIND)  ISTAGE
 !
 ! ... Exe. statements ...
 !
@@ -848,7 +1008,7 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
          N2 = N2 / 2
          N4 = N2 / 4
          N8 = N4 / 2
-         E = TWOPI / N2
+         ISTAGE = M - K + 1       ! N2 = 2 ** ISTAGE
          LOOP1: DO
             DO 15, I = IS, N-1, ID
                I1 = I + 1
@@ -876,14 +1036,11 @@ SUBROUTINE MODIFY_BEAMWIDTH ( nx, ny, image, sampling_dist,&
             ID = 4 * ID
             IF ( IS >= N-1 ) EXIT LOOP1
          END DO LOOP1
-         A = E
          DO 20, J = 2, N8
-            A3 = 3 * A
-            CC1 = COS(A)
-            SS1 = SIN(A)
-            CC3 = COS(A3)
-            SS3 = SIN(A3)
-            A = J * E
+            CC1 = PLAN%CC1(PLAN%IOFFSET(ISTAGE) + J - 1)
+            SS1 = PLAN%SS1(PLAN%IOFFSET(ISTAGE) + J - 1)
+            CC3 = PLAN%CC3(PLAN%IOFFSET(ISTAGE) + J - 1)
+            SS3 = PLAN%SS3(PLAN%IOFFSET(ISTAGE) + J - 1)
             IS = 0
             ID = 2 * N2
             LOOP2: DO
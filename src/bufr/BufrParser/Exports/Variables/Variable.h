@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <map>
 #include <vector>
 #include <string>
 #include <memory>
@@ -27,6 +28,9 @@ namespace Ingester
     typedef std::string QueryName;
     typedef std::vector<QueryInfo> QueryList;
 
+    /// \brief The variables already exported for a category, by export name.
+    typedef std::map<std::string, std::shared_ptr<DataObjectBase>> ExportedDataMap;
+
     /// \brief Abstract base class for all Exports.
     class Variable
     {
@@ -46,12 +50,34 @@ namespace Ingester
         /// \brief Variable data objects for previously parsed data from BufrDataMap.
         virtual std::shared_ptr<DataObjectBase> exportData(const BufrDataMap& dataMap) = 0;
 
+        /// \brief Variable data objects computed from the parsed data and other exported
+        ///        variables (see getDependencies), so their data isn't computed twice.
+        /// \param dataMap The parsed data.
+        /// \param exported The variables exported so far for the same data, which includes all
+        ///        the dependencies.
+        virtual std::shared_ptr<DataObjectBase> exportData(const BufrDataMap& dataMap,
+                                                           const ExportedDataMap& exported)
+        {
+            return exportData(dataMap);
+        }
+
+        /// \brief Export names of the variables this one is computed from (they are exported
+        ///        first).
+        virtual std::vector<std::string> getDependencies() const { return {}; }
+
+        /// \brief Can the variable be exported on several threads at once (for different
+        ///        data). Variables that aren't are exported one at a time.
+        virtual bool isThreadSafe() const { return true; }
+
         /// \brief Get Query List
         inline QueryList getQueryList() { return queryList_; }
 
         /// \brief Get Export Name
         inline std::string getExportName() const { return exportName_; }
 
+        /// \brief Does the variable transform its values (ex: an offset) when it is exported.
+        inline bool hasTransforms() const { return conf_.has("transforms"); }
+
      protected:
         /// \brief The for field of interest
         const std::string groupByField_;
@@ -5,12 +5,14 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <charconv>
 #include <climits>
 #include <iomanip>
+#include <iterator>
 #include <unordered_map>
+#include <utility>
 
 #include <ostream>
-#include <time.h>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -34,6 +36,14 @@ namespace
         const char* Wgosisnm = "wgosisnm";
         const char* Wgoslid = "wgoslid";
     }  // namespace ConfKeys
+
+    /// \brief Write a number and a '-' (no locale or allocations, unlike a stringstream).
+    char* writeComponent(char* pos, char* end, int value)
+    {
+        pos = std::to_chars(pos, end, value).ptr;
+        *pos++ = '-';
+        return pos;
+    }
 }  // namespace
 
 
@@ -71,30 +81,48 @@ namespace Ingester
             throw eckit::BadParameter(errStr.str());
         }
 
-        for (unsigned int idx = 0; idx < map.at(getExportKey(ConfKeys::Wgosids))->size(); idx++)
+        std::vector<int> wgosidsValues;
+        std::vector<int> wgosisidValues;
+        std::vector<int> wgosisnmValues;
+        std::vector<std::string> wgoslidValues;
+        wgosidsVar->copyAs(wgosidsValues);
+        map.at(getExportKey(ConfKeys::Wgosisid))->copyAs(wgosisidValues);
+        map.at(getExportKey(ConfKeys::Wgosisnm))->copyAs(wgosisnmValues);
+        map.at(getExportKey(ConfKeys::Wgoslid))->copyAs(wgoslidValues);
+
+        // The numbers (3 ints and their '-') of an ID
+        char numbers[3 * 12];
+        for (size_t idx = 0; idx < wgosidsValues.size(); idx++)
         {
-            auto wgosids = map.at(getExportKey(ConfKeys::Wgosids))->getAsInt(idx);
-            auto wgosisid = map.at(getExportKey(ConfKeys::Wgosisid))->getAsInt(idx);
-            auto wgosisnm = map.at(getExportKey(ConfKeys::Wgosisnm))->getAsInt(idx);
-            auto wgoslid = map.at(getExportKey(ConfKeys::Wgoslid))->getAsString(idx);
-
-            std::stringstream wgosAll;
-            if (wgosids != missingInt &&
-                wgosisid != missingInt &&
-                wgosisnm != missingInt &&
-                wgoslid != "")
+            const auto wgosids = wgosidsValues[idx];
+            const auto wgosisid = wgosisidValues[idx];
+            const auto wgosisnm = wgosisnmValues[idx];
+            const auto& wgoslid = wgoslidValues[idx];
+
+            if (wgosids == missingInt ||
+                wgosisid == missingInt ||
+                wgosisnm == missingInt ||
+                wgoslid.empty())
             {
-                wgosAll << wgosids <<  "-";
-                wgosAll << wgosisid <<  "-";
-                wgosAll << wgosisnm <<  "-";
-                wgosAll << wgoslid;
-                // std::cout << "WGOSID: "  <<  wgosAll.str() << std::endl;
+                wigosID.emplace_back();
+                continue;
             }
-            wigosID.push_back(wgosAll.str());
+
+            const auto numbersEnd = std::end(numbers);
+            auto pos = writeComponent(numbers, numbersEnd, wgosids);
+            pos = writeComponent(pos, numbersEnd, wgosisid);
+            pos = writeComponent(pos, numbersEnd, wgosisnm);
+
+            std::string wgosAll;
+            wgosAll.reserve((pos - numbers) + wgoslid.size());
+            wgosAll.append(numbers, pos);
+            wgosAll.append(wgoslid);
+            wigosID.push_back(std::move(wgosAll));
         }
 
+        // Stations repeat, so the DataObject keeps the IDs dictionary encoded.
         return std::make_shared<DataObject<std::string>>(
-                wigosID,
+                std::move(wigosID),
                 getExportName(),
                 groupByField_,
                 map.at(getExportKey(ConfKeys::Wgosids))->getDims(),
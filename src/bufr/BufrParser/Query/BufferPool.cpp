@@ -0,0 +1,44 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "BufferPool.h"
+
+
+namespace Ingester {
+namespace bufr {
+    std::atomic<size_t> BufferPool::limit_(0);
+    std::atomic<size_t> BufferPool::heldBytes_(0);
+
+    void BufferPool::setLimit(size_t bytes)
+    {
+        limit_ = bytes;
+        if (heldBytes() > bytes) clear();
+    }
+
+    void BufferPool::clear()
+    {
+        shelf<double>().clear();
+        shelf<float>().clear();
+        shelf<int32_t>().clear();
+        shelf<int64_t>().clear();
+        shelf<uint32_t>().clear();
+        shelf<uint64_t>().clear();
+    }
+
+    bool BufferPool::reserveBytes(size_t bytes)
+    {
+        auto held = heldBytes();
+        do
+        {
+            if (held + bytes > limit()) return false;
+        } while (!heldBytes_.compare_exchange_weak(held, held + bytes,
+                                                   std::memory_order_relaxed));
+
+        return true;
+    }
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,236 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Profiler.h"
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Process wide free lists of large numeric buffers (std::vectors), so the buffers
+    ///        of one file (the columns of a ResultSet, the assembled fields, the values of the
+    ///        DataObjects) are reused by the next one instead of going back to malloc. The
+    ///        buffers are kept by size class (powers of 2 of their capacity in bytes) and a
+    ///        request takes a buffer at most 4 times bigger than it needs.
+    ///
+    ///        Off by default (the limit is 0) since a one shot conversion has nothing to reuse
+    ///        the buffers for and the pool would only keep its memory. The conversion server
+    ///        turns it on (see ConversionServer).
+    class BufferPool
+    {
+     public:
+        /// \brief Is a type of buffer pooled (the types DataObjects hold numbers as)?
+        template<typename T>
+        static constexpr bool isPooled()
+        {
+            return std::is_same<T, double>::value || std::is_same<T, float>::value ||
+                   std::is_same<T, int32_t>::value || std::is_same<T, int64_t>::value ||
+                   std::is_same<T, uint32_t>::value || std::is_same<T, uint64_t>::value;
+        }
+
+        /// \brief Buffers smaller than this are left to malloc.
+        static constexpr size_t MinBufferBytes = 64 * 1024;
+
+        BufferPool() = delete;
+
+        /// \brief Set the most bytes the pool can keep (0 turns it off and frees the buffers).
+        static void setLimit(size_t bytes);
+
+        /// \brief The most bytes the pool can keep.
+        static size_t limit() { return limit_.load(std::memory_order_relaxed); }
+
+        /// \brief The bytes the pool keeps now.
+        static size_t heldBytes() { return heldBytes_.load(std::memory_order_relaxed); }
+
+        /// \brief Free the buffers the pool keeps.
+        static void clear();
+
+        /// \brief Get an empty buffer with room for at least size values.
+        template<typename T>
+        static std::vector<T> take(size_t size)
+        {
+            std::vector<T> buffer;
+            if constexpr (isPooled<T>())
+            {
+                if (limit() > 0 && size * sizeof(T) >= MinBufferBytes)
+                {
+                    shelf<T>().take(size, buffer);
+                }
+            }
+
+            buffer.reserve(size);
+            return buffer;
+        }
+
+        /// \brief Make a buffer hold size values (the new ones value initialized), moving its
+        ///        values to a pooled buffer when it has to grow (at least doubling it, like
+        ///        std::vector would).
+        template<typename T>
+        static void resize(std::vector<T>& buffer, size_t size)
+        {
+            if (size > buffer.capacity())
+            {
+                auto newBuffer = take<T>(std::max(size, 2 * buffer.capacity()));
+                newBuffer.insert(newBuffer.end(),
+                                 std::make_move_iterator(buffer.begin()),
+                                 std::make_move_iterator(buffer.end()));
+                give(buffer);
+                buffer = std::move(newBuffer);
+            }
+
+            buffer.resize(size);
+        }
+
+        /// \brief Keep a buffer for later (or free it if the pool is full). The buffer is left
+        ///        empty.
+        template<typename T>
+        static void give(std::vector<T>& buffer)
+        {
+            if constexpr (isPooled<T>())
+            {
+                if (limit() > 0 && buffer.capacity() * sizeof(T) >= MinBufferBytes)
+                {
+                    shelf<T>().give(buffer);
+                }
+            }
+
+            std::vector<T>().swap(buffer);
+        }
+
+        /// \brief Share a buffer, giving it back to the pool when the last owner lets go.
+        template<typename T>
+        static std::shared_ptr<std::vector<T>> share(std::vector<T>&& buffer)
+        {
+            if constexpr (isPooled<T>())
+            {
+                if (limit() > 0)
+                {
+                    return std::shared_ptr<std::vector<T>>(
+                        new std::vector<T>(std::move(buffer)),
+                        [](std::vector<T>* ptr)
+                        {
+                            give(*ptr);
+                            delete ptr;
+                        });
+                }
+            }
+
+            return std::make_shared<std::vector<T>>(std::move(buffer));
+        }
+
+     private:
+        /// \brief The number of size classes (buffers up to 2^NumClasses bytes are pooled).
+        static constexpr size_t NumClasses = 48;
+
+        /// \brief How many classes above the one it needs a request may take from.
+        static constexpr size_t MaxOversize = 1;
+
+        static std::atomic<size_t> limit_;
+        static std::atomic<size_t> heldBytes_;
+
+        /// \brief Reserve room for bytes in the pool.
+        static bool reserveBytes(size_t bytes);
+
+        /// \brief Give back the room of a buffer that left the pool.
+        static void releaseBytes(size_t bytes)
+        {
+            heldBytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        /// \brief The class of a buffer (the largest power of 2 not above its bytes).
+        static size_t sizeClass(size_t bytes)
+        {
+            size_t sizeClass = 0;
+            while (sizeClass + 1 < NumClasses && (bytes >> (sizeClass + 1)) > 0) ++sizeClass;
+            return sizeClass;
+        }
+
+        /// \brief The buffers of one type.
+        template<typename T>
+        class Shelf
+        {
+         public:
+            void take(size_t size, std::vector<T>& buffer)
+            {
+                // The buffers of the class of the request may be too small, the ones of the
+                // classes above aren't.
+                const auto firstClass = sizeClass(size * sizeof(T));
+                const auto lastClass = std::min(firstClass + MaxOversize, NumClasses - 1);
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto classIdx = firstClass; classIdx <= lastClass; ++classIdx)
+                {
+                    auto& buffers = classes_[classIdx];
+                    for (auto it = buffers.rbegin(); it != buffers.rend(); ++it)
+                    {
+                        if (it->capacity() < size) continue;
+
+                        buffer = std::move(*it);
+                        buffers.erase(std::next(it).base());
+                        releaseBytes(buffer.capacity() * sizeof(T));
+                        Profiler::count("pool.hits");
+                        return;
+                    }
+                }
+
+                Profiler::count("pool.misses");
+            }
+
+            void give(std::vector<T>& buffer)
+            {
+                const auto bytes = buffer.capacity() * sizeof(T);
+                if (!reserveBytes(bytes)) return;
+
+                buffer.clear();
+                std::lock_guard<std::mutex> lock(mutex_);
+                classes_[sizeClass(bytes)].push_back(std::move(buffer));
+            }
+
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto& buffers : classes_)
+                {
+                    for (const auto& buffer : buffers)
+                    {
+                        releaseBytes(buffer.capacity() * sizeof(T));
+                    }
+
+                    buffers.clear();
+                }
+            }
+
+         private:
+            std::mutex mutex_;
+            std::array<std::vector<std::vector<T>>, NumClasses> classes_;
+        };
+
+        /// \brief The shelf of a type. It is never destroyed, so buffers that are let go while
+        ///        the program exits (ex: by Python objects) can still be given back.
+        template<typename T>
+        static Shelf<T>& shelf()
+        {
+            static auto shelf = new Shelf<T>();
+            return *shelf;
+        }
+    };
+}  // namespace bufr
+}  // namespace Ingester
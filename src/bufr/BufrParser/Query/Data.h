@@ -7,11 +7,14 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 #include <limits>
 #include <cmath>
 
+#include "BufferPool.h"
 #include "Constants.h"
 
 namespace Ingester {
@@ -23,13 +26,28 @@ namespace bufr {
     ///        is too slow). This means that we need to explicitly call the destructor and
     ///        constructor for the union members. Many of the methods exposed on the class mimic
     ///        those of std::vector.
+    ///
+    /// \par Numeric data can also be stored narrow (as floats or 32 bit ints) when the type it
+    ///      will end up as is known (see Storage). Narrow data uses the largest value of its
+    ///      type as the missing value (like DataObject).
     struct Data
     {
-        /// \brief A union to hold the data. Either a vector of doubles or a vector of strings.
+        /// \brief How the values are stored.
+        enum class Storage
+        {
+            Octets,   // value.octets (doubles, or 8 character strings)
+            Strings,  // value.strings (long strings)
+            Floats,   // value.floats
+            Ints      // value.ints
+        };
+
+        /// \brief A union to hold the data. Either a vector of doubles, floats, ints or strings.
         union Value
         {
             std::vector<double> octets;
             std::vector<std::string> strings;
+            std::vector<float> floats;
+            std::vector<int32_t> ints;
 
             Value() {}
             ~Value() {}
@@ -45,110 +63,135 @@ namespace bufr {
             {
                 new (&strings) std::vector<std::string>();
             }
+
+            /// \brief Explicitly call the constructor for the float vector.
+            void initFloat()
+            {
+                new (&floats) std::vector<float>();
+            }
+
+            /// \brief Explicitly call the constructor for the int vector.
+            void initInt()
+            {
+                new (&ints) std::vector<int32_t>();
+            }
         };
 
         Value value;
 
-        Data() : isLongString(false)
+        Data() : storage_(Storage::Octets)
         {
             value.initOctet();
         }
 
         /// \brief Constructor
-        explicit Data(bool isLongString) : isLongString(isLongString)
+        explicit Data(bool isLongString) :
+            storage_(isLongString ? Storage::Strings : Storage::Octets)
         {
-            if (isLongString)
-            {
-                value.initString();
-            }
-            else
-            {
-                value.initOctet();
-            }
+            init();
         }
 
         /// \brief Copy constructor
-        Data(const Data& other) : isLongString(other.isLongString)
+        Data(const Data& other) : storage_(other.storage_)
         {
-            if (isLongString)
-            {
-                value.initString();
-                value.strings = other.value.strings;
-            }
-            else
-            {
-                value.initOctet();
-                value.octets = other.value.octets;
-            }
+            init();
+            *this = other;
+        }
+
+        /// \brief Move constructor
+        Data(Data&& other) : storage_(other.storage_)
+        {
+            init();
+            *this = std::move(other);
         }
 
         /// \brief Destructor. Be careful to clean up the union here.
         ~Data()
         {
-            if (isLongString)
-            {
-                value.strings.~vector();
-            }
-            else
-            {
-                value.octets.~vector();
-            }
+            destroy();
         }
 
         /// \brief Assignemnt operator defention (copy)
         void operator=(const Data& other)
         {
-            isLongStr(other.isLongString);
+            setStorage(other.storage_);
 
-            if (isLongString)
-            {
-                value.strings = other.value.strings;
-            }
-            else
+            switch (storage_)
             {
-                value.octets = other.value.octets;
+                case Storage::Strings: value.strings = other.value.strings; break;
+                case Storage::Floats: value.floats = other.value.floats; break;
+                case Storage::Ints: value.ints = other.value.ints; break;
+                default: value.octets = other.value.octets;
             }
         }
 
         /// \brief Assignemnt operator defention (move)
         void operator=(Data&& other)
         {
-            isLongStr(other.isLongString);
+            setStorage(other.storage_);
 
-            if (isLongString)
-            {
-                value.strings = std::move(other.value.strings);
-            }
-            else
+            switch (storage_)
             {
-                value.octets = std::move(other.value.octets);
+                case Storage::Strings: value.strings = std::move(other.value.strings); break;
+                case Storage::Floats: value.floats = std::move(other.value.floats); break;
+                case Storage::Ints: value.ints = std::move(other.value.ints); break;
+                default: value.octets = std::move(other.value.octets);
             }
         }
 
         /// \brief Get the size of the data.
         size_t size() const
         {
-            if (isLongString)
-            {
-                return value.strings.size();
-            }
-            else
+            switch (storage_)
             {
-                return value.octets.size();
+                case Storage::Strings: return value.strings.size();
+                case Storage::Floats: return value.floats.size();
+                case Storage::Ints: return value.ints.size();
+                default: return value.octets.size();
             }
         }
 
-        /// \brief Resize the data.
+        /// \brief Resize the data (new elements are missing values).
         /// \param size The new size of the data.
         void resize(size_t size)
         {
-            if (isLongString)
+            switch (storage_)
             {
-                value.strings.resize(size, MissingStringValue);
+                case Storage::Strings:
+                    value.strings.resize(size, MissingStringValue);
+                    break;
+                case Storage::Floats:
+                    value.floats.resize(size, missingValue<float>());
+                    break;
+                case Storage::Ints:
+                    value.ints.resize(size, missingValue<int32_t>());
+                    break;
+                default:
+                    value.octets.resize(size, MissingOctetValue);
             }
-            else
+        }
+
+        /// \brief Size empty data to hold size values (missing values), taking the buffer from
+        ///        the BufferPool. The buffer goes back to the pool when the data is destroyed.
+        /// \param size The size of the data.
+        void allocate(size_t size)
+        {
+            switch (storage_)
             {
-                value.octets.resize(size, MissingOctetValue);
+                case Storage::Strings:
+                    value.strings.resize(size, MissingStringValue);
+                    break;
+                case Storage::Floats:
+                    value.floats = BufferPool::take<float>(size);
+                    value.floats.resize(size, missingValue<float>());
+                    break;
+                case Storage::Ints:
+                    value.ints = BufferPool::take<int32_t>(size);
+                    value.ints.resize(size, missingValue<int32_t>());
+                    break;
+                default:
+                    value.octets = BufferPool::take<double>(size);
+                    value.octets.resize(size, MissingOctetValue);
             }
         }
 
@@ -156,13 +199,12 @@ namespace bufr {
         /// \param size The size to reserve.
         void reserve(size_t size)
         {
-            if (isLongString)
-            {
-                value.strings.reserve(size);
-            }
-            else
+            switch (storage_)
             {
-                value.octets.reserve(size);
+                case Storage::Strings: value.strings.reserve(size); break;
+                case Storage::Floats: value.floats.reserve(size); break;
+                case Storage::Ints: value.ints.reserve(size); break;
+                default: value.octets.reserve(size);
             }
         }
 
@@ -186,14 +228,7 @@ namespace bufr {
         /// \return True if the data is empty.
         bool empty() const
         {
-            if (isLongString)
-            {
-                return value.strings.empty();
-            }
-            else
-            {
-                return value.octets.empty();
-            }
+            return size() == 0;
         }
 
         /// \brief Is the value stored at the given index a missing value.
@@ -201,49 +236,123 @@ namespace bufr {
         /// \return True if the value is missing.
         bool isMissing(size_t idx) const
         {
-            if (isLongString)
+            switch (storage_)
             {
-                return value.strings[idx] == MissingStringValue;
-            }
-            else
-            {
-                return std::fabs(value.octets[idx] - MissingOctetValue)
-                       <= std::numeric_limits<double>::epsilon() * MissingOctetValue * 100;
+                case Storage::Strings: return value.strings[idx] == MissingStringValue;
+                case Storage::Floats: return value.floats[idx] == missingValue<float>();
+                case Storage::Ints: return value.ints[idx] == missingValue<int32_t>();
+                default: return isMissingOctet(value.octets[idx]);
             }
         }
 
+        /// \brief Is the octet value the missing value.
+        /// \param octet The value.
+        static bool isMissingOctet(double octet)
+        {
+            return std::fabs(octet - MissingOctetValue)
+                   <= std::numeric_limits<double>::epsilon() * MissingOctetValue * 100;
+        }
+
+        /// \brief The missing value of narrow data.
+        template<typename T>
+        static constexpr T missingValue()
+        {
+            return std::numeric_limits<T>::max();
+        }
+
+        /// \brief Convert an octet to a narrow value (missing stays missing).
+        /// \param octet The value.
+        template<typename T>
+        static T narrow(double octet)
+        {
+            return isMissingOctet(octet) ? missingValue<T>() : static_cast<T>(octet);
+        }
+
         /// \brief Set the isLongString attribute
         /// \param isLongString True if the data is a long string.
         void isLongStr(bool isLongString)
         {
-            if (isLongString)
-            {
-                if (!this->isLongString)
-                {
-                    value.octets.~vector();
-                    value.initString();
-                }
-            }
-            else
-            {
-                if (this->isLongString)
-                {
-                    value.strings.~vector();
-                    value.initOctet();
-                }
-            }
-            this->isLongString = isLongString;
+            setStorage(isLongString ? Storage::Strings : Storage::Octets);
         }
 
         /// \brief Get the isLongString attribute
         /// \return True if the data is a long string.
         bool isLongStr() const
         {
-            return isLongString;
+            return storage_ == Storage::Strings;
+        }
+
+        /// \brief Change how the values are stored (the data is cleared if it changes).
+        /// \param storage The new storage.
+        void setStorage(Storage storage)
+        {
+            if (storage == storage_) return;
+
+            destroy();
+            storage_ = storage;
+            init();
+        }
+
+        /// \brief Get how the values are stored.
+        Storage storage() const
+        {
+            return storage_;
+        }
+
+        /// \brief Get the vector of values of type T (double, std::string, float or int32_t).
+        /// \note Only valid if the data is stored as that type.
+        template<typename T>
+        std::vector<T>& values();
+
+        template<typename T>
+        const std::vector<T>& values() const
+        {
+            return const_cast<Data*>(this)->values<T>();
         }
 
      private:
-        bool isLongString;
+        Storage storage_;
+
+        /// \brief Construct the union member for the storage.
+        void init()
+        {
+            switch (storage_)
+            {
+                case Storage::Strings: value.initString(); break;
+                case Storage::Floats: value.initFloat(); break;
+                case Storage::Ints: value.initInt(); break;
+                default: value.initOctet();
+            }
+        }
+
+        /// \brief Destroy the union member for the storage (numeric buffers go back to the
+        ///        BufferPool).
+        void destroy()
+        {
+            switch (storage_)
+            {
+                case Storage::Strings: value.strings.~vector(); break;
+                case Storage::Floats:
+                    BufferPool::give(value.floats);
+                    value.floats.~vector();
+                    break;
+                case Storage::Ints:
+                    BufferPool::give(value.ints);
+                    value.ints.~vector();
+                    break;
+                default:
+                    BufferPool::give(value.octets);
+                    value.octets.~vector();
+            }
+        }
     };
+
+    template<> inline std::vector<double>& Data::values<double>() { return value.octets; }
+    template<> inline std::vector<std::string>& Data::values<std::string>()
+    {
+        return value.strings;
+    }
+    template<> inline std::vector<float>& Data::values<float>() { return value.floats; }
+    template<> inline std::vector<int32_t>& Data::values<int32_t>() { return value.ints; }
 }  // namespace bufr
 }  // namespace Ingester
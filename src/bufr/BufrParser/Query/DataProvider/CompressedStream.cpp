@@ -0,0 +1,470 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "CompressedStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#ifdef BUFR_HAS_ZLIB
+    #include <zlib.h>
+#endif
+
+#ifdef BUFR_HAS_BZIP2
+    #include <bzlib.h>
+#endif
+
+#ifdef BUFR_HAS_ZSTD
+    #include <zstd.h>
+#endif
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    const size_t InChunkSize = 1 << 18;
+    const size_t OutChunkSize = 1 << 20;
+    const size_t MaxQueuedChunks = 8;
+
+    const size_t Section0Size = 8;
+    const size_t EndSectionSize = 4;
+
+    typedef std::function<bool(std::string&&)> EmitFunc;
+
+    using Ingester::bufr::Compression;
+
+    const char* nameFor(Compression compression)
+    {
+        switch (compression)
+        {
+            case Compression::Gzip: return "gzip";
+            case Compression::Bzip2: return "bzip2";
+            case Compression::Zstd: return "zstd";
+            default: return "uncompressed";
+        }
+    }
+
+    /// \brief Read the next piece of the compressed file.
+    size_t readInput(std::ifstream& file, std::vector<char>& in)
+    {
+        file.read(in.data(), in.size());
+        return static_cast<size_t>(file.gcount());
+    }
+
+    void throwCorrupt(const std::string& filePath, Compression compression)
+    {
+        std::ostringstream errStr;
+        errStr << "The " << nameFor(compression) << " compressed file " << filePath;
+        errStr << " is corrupt or truncated.";
+        throw eckit::BadValue(errStr.str());
+    }
+
+#ifdef BUFR_HAS_ZLIB
+    void inflateFile(std::ifstream& file, const std::string& filePath, const EmitFunc& emit)
+    {
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+
+        // 32 lets zlib find the gzip (or zlib) header itself
+        if (inflateInit2(&stream, 15 + 32) != Z_OK)
+        {
+            throw eckit::BadValue("Couldn't initialize zlib.");
+        }
+
+        std::vector<char> in(InChunkSize);
+        bool endOfMember = false;
+        bool outputFull = false;
+        bool stopped = false;
+        try
+        {
+            while (true)
+            {
+                // A full output chunk can mean there is more to come without reading any more.
+                if (stream.avail_in == 0 && !outputFull)
+                {
+                    stream.avail_in = static_cast<uInt>(readInput(file, in));
+                    stream.next_in = reinterpret_cast<Bytef*>(in.data());
+                    if (stream.avail_in == 0) break;
+                }
+
+                // Files made with cat a.gz b.gz have several members, so start over after one.
+                if (endOfMember)
+                {
+                    inflateReset(&stream);
+                    endOfMember = false;
+                }
+
+                std::string out(OutChunkSize, '\0');
+                stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+                stream.avail_out = static_cast<uInt>(out.size());
+
+                const auto result = inflate(&stream, Z_NO_FLUSH);
+                if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+                {
+                    throwCorrupt(filePath, Compression::Gzip);
+                }
+
+                endOfMember = (result == Z_STREAM_END);
+                outputFull = (!endOfMember && stream.avail_out == 0);
+
+                out.resize(out.size() - stream.avail_out);
+                if (!out.empty() && !emit(std::move(out)))
+                {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+        catch (...)
+        {
+            inflateEnd(&stream);
+            throw;
+        }
+
+        inflateEnd(&stream);
+
+        if (!endOfMember && !stopped) throwCorrupt(filePath, Compression::Gzip);
+    }
+#endif
+
+#ifdef BUFR_HAS_BZIP2
+    void bunzipFile(std::ifstream& file, const std::string& filePath, const EmitFunc& emit)
+    {
+        bz_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK)
+        {
+            throw eckit::BadValue("Couldn't initialize bzip2.");
+        }
+
+        std::vector<char> in(InChunkSize);
+        bool endOfStream = false;
+        bool outputFull = false;
+        bool stopped = false;
+        try
+        {
+            while (true)
+            {
+                if (stream.avail_in == 0 && !outputFull)
+                {
+                    stream.avail_in = static_cast<unsigned int>(readInput(file, in));
+                    stream.next_in = in.data();
+                    if (stream.avail_in == 0) break;
+                }
+
+                // Concatenated bzip2 streams (ex: made by pbzip2)
+                if (endOfStream)
+                {
+                    BZ2_bzDecompressEnd(&stream);
+                    auto nextIn = stream.next_in;
+                    auto availIn = stream.avail_in;
+                    std::memset(&stream, 0, sizeof(stream));
+                    if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK)
+                    {
+                        throw eckit::BadValue("Couldn't initialize bzip2.");
+                    }
+
+                    stream.next_in = nextIn;
+                    stream.avail_in = availIn;
+                    endOfStream = false;
+                }
+
+                std::string out(OutChunkSize, '\0');
+                stream.next_out = &out[0];
+                stream.avail_out = static_cast<unsigned int>(out.size());
+
+                const auto result = BZ2_bzDecompress(&stream);
+                if (result != BZ_OK && result != BZ_STREAM_END)
+                {
+                    throwCorrupt(filePath, Compression::Bzip2);
+                }
+
+                endOfStream = (result == BZ_STREAM_END);
+                outputFull = (!endOfStream && stream.avail_out == 0);
+
+                out.resize(out.size() - stream.avail_out);
+                if (!out.empty() && !emit(std::move(out)))
+                {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+        catch (...)
+        {
+            BZ2_bzDecompressEnd(&stream);
+            throw;
+        }
+
+        BZ2_bzDecompressEnd(&stream);
+
+        if (!endOfStream && !stopped) throwCorrupt(filePath, Compression::Bzip2);
+    }
+#endif
+
+#ifdef BUFR_HAS_ZSTD
+    void unzstdFile(std::ifstream& file, const std::string& filePath, const EmitFunc& emit)
+    {
+        ZSTD_DStream* stream = ZSTD_createDStream();
+        if (stream == nullptr)
+        {
+            throw eckit::BadValue("Couldn't initialize zstd.");
+        }
+
+        std::vector<char> in(InChunkSize);
+        ZSTD_inBuffer input = {in.data(), 0, 0};
+        size_t result = 0;
+        bool outputFull = false;
+        bool stopped = false;
+        try
+        {
+            while (true)
+            {
+                if (input.pos == input.size && !outputFull)
+                {
+                    input.size = readInput(file, in);
+                    input.pos = 0;
+                    if (input.size == 0) break;
+                }
+
+                std::string out(OutChunkSize, '\0');
+                ZSTD_outBuffer output = {&out[0], out.size(), 0};
+
+                // Concatenated frames are handled by the library.
+                result = ZSTD_decompressStream(stream, &output, &input);
+                if (ZSTD_isError(result))
+                {
+                    throwCorrupt(filePath, Compression::Zstd);
+                }
+
+                outputFull = (output.pos == output.size);
+
+                out.resize(output.pos);
+                if (!out.empty() && !emit(std::move(out)))
+                {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+        catch (...)
+        {
+            ZSTD_freeDStream(stream);
+            throw;
+        }
+
+        ZSTD_freeDStream(stream);
+
+        // A non zero hint means the last frame wasn't finished.
+        if (result != 0 && !stopped) throwCorrupt(filePath, Compression::Zstd);
+    }
+#endif
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    CompressedStream::CompressedStream(const std::string& filePath, Compression compression) :
+        filePath_(filePath),
+        compression_(compression),
+        file_(filePath, std::ios::binary)
+    {
+        if (!file_)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't open the BUFR file " << filePath << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        bool isSupported = false;
+        switch (compression_)
+        {
+#ifdef BUFR_HAS_ZLIB
+            case Compression::Gzip: isSupported = true; break;
+#endif
+#ifdef BUFR_HAS_BZIP2
+            case Compression::Bzip2: isSupported = true; break;
+#endif
+#ifdef BUFR_HAS_ZSTD
+            case Compression::Zstd: isSupported = true; break;
+#endif
+            default: break;
+        }
+
+        if (!isSupported)
+        {
+            std::ostringstream errStr;
+            errStr << "Can't read " << filePath << ". It is " << nameFor(compression_);
+            errStr << " compressed, which wasn't supported when the converters were built.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        thread_ = std::thread(&CompressedStream::decompress, this);
+    }
+
+    CompressedStream::~CompressedStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+
+        chunkTaken_.notify_all();
+        thread_.join();
+    }
+
+    Compression CompressedStream::detect(const std::string& filePath)
+    {
+        unsigned char magic[4] = {0, 0, 0, 0};
+
+        std::ifstream file(filePath, std::ios::binary);
+        file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+        if (file.gcount() < 3) return Compression::None;
+
+        if (magic[0] == 0x1f && magic[1] == 0x8b) return Compression::Gzip;
+        if (magic[0] == 'B' && magic[1] == 'Z' && magic[2] == 'h') return Compression::Bzip2;
+        if (file.gcount() == 4 &&
+            magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        {
+            return Compression::Zstd;
+        }
+
+        return Compression::None;
+    }
+
+    bool CompressedStream::nextMessage(const unsigned char*& msg,
+                                       size_t& length,
+                                       std::uint64_t& offset)
+    {
+        const char* marker = "BUFR";
+        while (true)
+        {
+            const auto pos = pending_.find(marker, pendingPos_, 4);
+            if (pos == std::string::npos)
+            {
+                // Keep the tail in case the marker is split across chunks.
+                if (pending_.size() > pendingPos_ + 3) pendingPos_ = pending_.size() - 3;
+                if (!fill()) return false;
+                continue;
+            }
+
+            pendingPos_ = pos;
+            if (pending_.size() - pos < Section0Size)
+            {
+                if (!fill()) return false;
+                continue;
+            }
+
+            const auto bytes = reinterpret_cast<const unsigned char*>(pending_.data()) + pos;
+            length = (static_cast<size_t>(bytes[4]) << 16) |
+                     (static_cast<size_t>(bytes[5]) << 8) |
+                     static_cast<size_t>(bytes[6]);
+            const auto edition = bytes[7];
+
+            // Skip anything that isn't a complete BUFR message (or one we can't handle).
+            if (edition < 2 || edition > 4 || length < Section0Size + EndSectionSize)
+            {
+                pendingPos_ += 4;
+                continue;
+            }
+
+            if (pending_.size() - pos < length)
+            {
+                if (!fill()) pendingPos_ += 4;
+                continue;
+            }
+
+            if (std::memcmp(bytes + length - EndSectionSize, "7777", EndSectionSize) != 0)
+            {
+                pendingPos_ += 4;
+                continue;
+            }
+
+            msg = bytes;
+            offset = pendingOffset_ + pos;
+            pendingPos_ = pos + length;
+            return true;
+        }
+    }
+
+    void CompressedStream::decompress()
+    {
+        try
+        {
+            auto emitFunc = [this](std::string&& chunk) { return emit(std::move(chunk)); };
+            switch (compression_)
+            {
+#ifdef BUFR_HAS_ZLIB
+                case Compression::Gzip: inflateFile(file_, filePath_, emitFunc); break;
+#endif
+#ifdef BUFR_HAS_BZIP2
+                case Compression::Bzip2: bunzipFile(file_, filePath_, emitFunc); break;
+#endif
+#ifdef BUFR_HAS_ZSTD
+                case Compression::Zstd: unzstdFile(file_, filePath_, emitFunc); break;
+#endif
+                default: break;
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+
+        chunkAdded_.notify_all();
+    }
+
+    bool CompressedStream::emit(std::string&& chunk)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        chunkTaken_.wait(lock, [this]() { return stop_ || chunks_.size() < MaxQueuedChunks; });
+        if (stop_) return false;
+
+        chunks_.push_back(std::move(chunk));
+        lock.unlock();
+
+        chunkAdded_.notify_one();
+        return true;
+    }
+
+    bool CompressedStream::fill()
+    {
+        std::string chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            chunkAdded_.wait(lock, [this]() { return done_ || !chunks_.empty(); });
+
+            if (chunks_.empty())
+            {
+                if (error_) std::rethrow_exception(error_);
+                return false;
+            }
+
+            chunk = std::move(chunks_.front());
+            chunks_.pop_front();
+        }
+
+        chunkTaken_.notify_one();
+
+        pending_.erase(0, pendingPos_);
+        pendingOffset_ += pendingPos_;
+        pendingPos_ = 0;
+        pending_.append(chunk);
+        return true;
+    }
+}  // namespace bufr
+}  // namespace Ingester
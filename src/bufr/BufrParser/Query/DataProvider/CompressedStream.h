@@ -0,0 +1,95 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief The kinds of compressed BUFR files we can read.
+    enum class Compression
+    {
+        None,
+        Gzip,
+        Bzip2,
+        Zstd
+    };
+
+    /// \brief Reads the BUFR messages of a compressed (gzip, bzip2 or zstd) file. A background
+    ///        thread decompresses the file into a small queue of chunks while the messages are
+    ///        being decoded, so the file never has to be decompressed to disk. Support for each
+    ///        format depends on the libraries that were available at build time (BUFR_HAS_ZLIB,
+    ///        BUFR_HAS_BZIP2 and BUFR_HAS_ZSTD).
+    class CompressedStream
+    {
+     public:
+        /// \brief Constructor. Starts decompressing the file.
+        /// \param filePath Path to the compressed BUFR file.
+        /// \param compression The compression of the file (see detect).
+        CompressedStream(const std::string& filePath, Compression compression);
+
+        ~CompressedStream();
+
+        CompressedStream(const CompressedStream&) = delete;
+        CompressedStream& operator=(const CompressedStream&) = delete;
+
+        /// \brief Get the compression of a file from its leading (magic) bytes.
+        /// \param filePath Path to the file.
+        /// \return Compression::None for uncompressed files or files that can't be opened.
+        static Compression detect(const std::string& filePath);
+
+        /// \brief Get the next (complete) BUFR message.
+        /// \param msg Set to the bytes of the message. They stay valid until the next call.
+        /// \param length Set to the length of the message in bytes.
+        /// \param offset Set to the offset of the message in the decompressed stream.
+        /// \return false once there are no more messages.
+        bool nextMessage(const unsigned char*& msg, size_t& length, std::uint64_t& offset);
+
+     private:
+        const std::string filePath_;
+        const Compression compression_;
+        std::ifstream file_;
+
+        // Decompressed chunks handed from the decompression thread to the reader
+        std::mutex mutex_;
+        std::condition_variable chunkAdded_;
+        std::condition_variable chunkTaken_;
+        std::deque<std::string> chunks_;
+        bool done_ = false;
+        bool stop_ = false;
+        std::exception_ptr error_;
+        std::thread thread_;
+
+        // Decompressed bytes that haven't been read yet (only touched by the reader)
+        std::string pending_;
+        size_t pendingPos_ = 0;
+        std::uint64_t pendingOffset_ = 0;  // Offset of pending_[0] in the decompressed stream
+
+        /// \brief Decompress the file into chunks_ (runs on thread_).
+        void decompress();
+
+        /// \brief Queue a decompressed chunk, waiting for room in the queue.
+        /// \return false if the stream is being destroyed.
+        bool emit(std::string&& chunk);
+
+        /// \brief Append the next decompressed chunk to pending_ (dropping the bytes that were
+        ///        already read).
+        /// \return false once the whole file has been decompressed.
+        bool fill();
+    };
+}  // namespace bufr
+}  // namespace Ingester
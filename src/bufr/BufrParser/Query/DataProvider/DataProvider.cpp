@@ -7,21 +7,401 @@
 
 #include "DataProvider.h"
 #include "bufr_interface.h"
+#include "bufr_ext_interface.h"
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <iostream>
+#include <set>
+#include <sstream>
 #include <unordered_map>
 
 #include "eckit/exception/Exceptions.h"
 
+#include "../Constants.h"
+#include "../Profiler.h"
+
+
+namespace
+{
+    // Fortran unit numbers handed out to DataProvider instances. Units 13 and 14 are reserved
+    // for the master table files opened by the WmoDataProvider.
+    const int FirstFileUnit = 12;
+    const std::set<int> ReservedFileUnits = {13, 14};
+
+    // NCEPLIB-bufr can only have this many BUFR files open at the same time (NFILES).
+    const size_t MaxOpenFiles = 32;
+
+    // readerme return code for DX table messages (they are stored, not returned).
+    const int DictionaryMessage = 11;
+
+    std::set<int>& usedFileUnits()
+    {
+        static std::set<int> units;
+        return units;
+    }
+
+    int acquireFileUnit()
+    {
+        std::lock_guard<std::recursive_mutex> lock(Ingester::bufr::DataProvider::fortranMutex());
+
+        auto& units = usedFileUnits();
+        if (units.size() >= MaxOpenFiles)
+        {
+            std::ostringstream errStr;
+            errStr << "Too many BUFR files are open at the same time (max " << MaxOpenFiles;
+            errStr << ").";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        int unit = FirstFileUnit;
+        while (units.find(unit) != units.end() ||
+               ReservedFileUnits.find(unit) != ReservedFileUnits.end())
+        {
+            unit++;
+        }
+
+        units.insert(unit);
+        return unit;
+    }
+
+    void releaseFileUnit(int unit)
+    {
+        std::lock_guard<std::recursive_mutex> lock(Ingester::bufr::DataProvider::fortranMutex());
+        usedFileUnits().erase(unit);
+    }
+
+    unsigned int readUInt(const unsigned char* bytes, size_t numBytes)
+    {
+        unsigned int value = 0;
+        for (size_t byteIdx = 0; byteIdx < numBytes; byteIdx++)
+        {
+            value = (value << 8) | bytes[byteIdx];
+        }
+
+        return value;
+    }
+
+    /// \brief Read the section 1 and 3 fields of a message into its header.
+    void readHeaderSections(const unsigned char* msg,
+                            size_t size,
+                            Ingester::bufr::MessageHeader& header)
+    {
+        const size_t Section0Size = 8;
+
+        header.length = 0;
+        header.edition = 0;
+        header.dataCategory = 0;
+        header.dataSubCategory = 0;
+        header.numSubsets = 0;
+        header.isCompressed = false;
+        header.descriptors.clear();
+        if (size < Section0Size) return;
+
+        header.length = readUInt(&msg[4], 3);
+        header.edition = msg[7];
+
+        const size_t length = std::min(header.length, size);
+        if (length < Section0Size + 3) return;
+
+        // Section 1 layout depends on the edition
+        const unsigned char* section1 = &msg[Section0Size];
+        const size_t section1Len = readUInt(section1, 3);
+        if (Section0Size + section1Len > length || section1Len < 13) return;
+
+        const bool isEdition4 = header.edition == 4;
+        const bool hasSection2 = (isEdition4 ? section1[9] : section1[7]) & 0x80;
+        header.dataCategory = isEdition4 ? section1[10] : section1[8];
+        header.dataSubCategory = isEdition4 ? section1[12] : section1[9];
+
+        size_t section3Pos = Section0Size + section1Len;
+        if (hasSection2 && section3Pos + 3 <= length)
+        {
+            section3Pos += readUInt(&msg[section3Pos], 3);
+        }
+
+        if (section3Pos + 7 > length) return;
+
+        const size_t section3Len = std::min(static_cast<size_t>(readUInt(&msg[section3Pos], 3)),
+                                            length - section3Pos);
+        header.numSubsets = static_cast<int>(readUInt(&msg[section3Pos + 4], 2));
+        header.isCompressed = msg[section3Pos + 6] & 0x40;
+
+        for (size_t pos = section3Pos + 7; pos + 2 <= section3Pos + section3Len; pos += 2)
+        {
+            const int f = msg[pos] >> 6;
+            const int x = msg[pos] & 0x3F;
+            const int y = msg[pos + 1];
+            header.descriptors.push_back(f * 100000 + x * 1000 + y);
+        }
+    }
+}  // namespace
 
 namespace Ingester {
 namespace bufr {
+    DataProvider::DataProvider(const std::string filePath) :
+      filePath_(filePath),
+      fileUnit_(acquireFileUnit())
+    {
+        // Compressed files are decompressed in memory as they are read.
+        compression_ = CompressedStream::detect(filePath_);
+    }
+
+    DataProvider::~DataProvider()
+    {
+        if (isOpen_)
+        {
+            close();
+        }
+
+        releaseFileUnit(fileUnit_);
+    }
+
+    std::recursive_mutex& DataProvider::fortranMutex()
+    {
+        static std::recursive_mutex mutex;
+        return mutex;
+    }
+
+    void DataProvider::setNativeDecoding(bool enable)
+    {
+        if (!enable)
+        {
+            nativeDecoder_.reset();
+            return;
+        }
+
+        if (!holdsMessageBytes()) buffer_ = MessageBuffer::mapFile(filePath_);
+        if (!nativeDecoder_) nativeDecoder_ = std::make_unique<NativeDecoder>();
+    }
+
+    void DataProvider::skipMessages(size_t count)
+    {
+        std::lock_guard<std::recursive_mutex> lock(fortranMutex());
+        for (size_t msgIdx = 0; msgIdx < count; msgIdx++)
+        {
+            if (!nextMessage()) break;
+        }
+    }
+
+    void DataProvider::scanHeaders(const std::function<void(const MessageHeader&)>& processHeader)
+    {
+        if (isOpen_)
+        {
+            std::ostringstream errStr;
+            errStr << "Tried to call DataProvider::scanHeaders, but the file is already open!";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        // The headers are read from the bytes of the messages.
+        const auto buffer = buffer_;
+        if (!holdsMessageBytes()) buffer_ = MessageBuffer::mapFile(filePath_);
+
+        open();
+
+        MessageHeader header;
+        std::unique_lock<std::recursive_mutex> lock(fortranMutex());
+        while (nextMessage())
+        {
+            // NCEPLIB-bufr has the tables of the message (which tell the variant) as soon as
+            // it is read.
+            loadMessage();
+            updateTableData(subset_);
+
+            header.variant = getSubsetVariant();
+            header.date = msgDate_;
+            readHeaderSections(reinterpret_cast<const unsigned char*>(msgBuffer_.data()),
+                               msgBuffer_.size() * sizeof(int),
+                               header);
+
+            lock.unlock();
+            processHeader(header);
+            lock.lock();
+        }
+
+        deleteData();
+        lock.unlock();
+
+        close();
+        buffer_ = buffer;
+    }
+
+    void DataProvider::resetMessagePosition()
+    {
+        messagesRead_ = 0;
+        indexPos_ = 0;
+        foundIndexedData_ = false;
+        bufferPos_ = 0;
+
+        // The table data may be made again (the variants keep their indices).
+        indexedSubset_.clear();
+        indexedTableData_ = nullptr;
+
+        if (indexedFile_.is_open()) indexedFile_.close();
+
+        compressedStream_.reset();
+        if (buffer_ == nullptr && compression_ != Compression::None)
+        {
+            compressedStream_ = std::make_unique<CompressedStream>(filePath_, compression_);
+        }
+
+        readAheadFile_.reset();
+        if (readsAhead()) readAheadFile_ = std::make_unique<ReadAheadFile>(filePath_);
+    }
+
+    bool DataProvider::nextMessage()
+    {
+        static int SubsetLen = 9;
+        char subsetChars[SubsetLen];
+
+        if (buffer_ || compressedStream_ || readAheadFile_)
+        {
+            if (!readBufferMessage()) return false;
+        }
+        else if (index_)
+        {
+            const auto& entries = index_->entries();
+            while (indexPos_ < entries.size() && entries[indexPos_].isDictionary)
+            {
+                // The leading dictionary messages are read when the file is opened (unless it
+                // isn't read by NCEPLIB-bufr), but any later ones replace the tables and have
+                // to be loaded.
+                if (foundIndexedData_ || !readsFromFile()) readIndexedMessage(entries[indexPos_]);
+                indexPos_++;
+            }
+
+            if (indexPos_ >= entries.size()) return false;
+
+            subset_ = entries[indexPos_].subset;
+            msgDate_ = entries[indexPos_].date;
+            foundIndexedData_ = true;
+            indexPos_++;
+        }
+        else
+        {
+            if (ireadmg_f(fileUnit_, subsetChars, &msgDate_, SubsetLen) != 0) return false;
+
+            subset_ = std::string(subsetChars);
+            subset_.erase(std::remove_if(subset_.begin(), subset_.end(), isspace),
+                          subset_.end());
+        }
+
+        messagesRead_++;
+        return true;
+    }
+
+    void DataProvider::loadMessage()
+    {
+        if (index_)
+        {
+            readIndexedMessage(index_->entries()[indexPos_ - 1]);
+        }
+    }
+
+    void DataProvider::readIndexedMessage(const MessageIndexEntry& entry)
+    {
+        static int SubsetLen = 9;
+        char subsetChars[SubsetLen];
+        int iddate;
+        int iret;
+
+        msgBuffer_.assign((entry.length + sizeof(int) - 1) / sizeof(int), 0);
+
+        size_t numRead = 0;
+        if (remoteFile_)
+        {
+            remoteFile_->read(entry.offset, entry.length, msgBuffer_.data());
+            numRead = entry.length;
+        }
+        else
+        {
+            if (!indexedFile_.is_open())
+            {
+                indexedFile_.open(filePath_, std::ios::binary);
+            }
+
+            indexedFile_.clear();
+            indexedFile_.seekg(static_cast<std::streamoff>(entry.offset));
+            indexedFile_.read(reinterpret_cast<char*>(msgBuffer_.data()), entry.length);
+            numRead = static_cast<size_t>(indexedFile_.gcount());
+        }
+
+        if (numRead != entry.length)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't read the message at offset " << entry.offset << " in ";
+            errStr << filePath_ << ". Is the index out of date?";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        readerme_f(msgBuffer_.data(), fileUnit_, subsetChars, SubsetLen, &iddate, &iret);
+
+        if (iret < 0 || (!entry.isDictionary && iret != 0))
+        {
+            std::ostringstream errStr;
+            errStr << "NCEPLIB-bufr couldn't read the message at offset " << entry.offset;
+            errStr << " in " << filePath_ << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+    }
+
+    bool DataProvider::readBufferMessage()
+    {
+        static int SubsetLen = 9;
+        char subsetChars[SubsetLen];
+        int iret;
+
+        const unsigned char* msg = nullptr;
+        size_t length = 0;
+        std::uint64_t offset = 0;
+        while (nextBufferMessage(msg, length, offset))
+        {
+            // NCEPLIB-bufr wants whole (aligned) 4 byte words.
+            msgBuffer_.assign((length + sizeof(int) - 1) / sizeof(int), 0);
+            std::memcpy(msgBuffer_.data(), msg, length);
+
+            readerme_f(msgBuffer_.data(), fileUnit_, subsetChars, SubsetLen, &msgDate_, &iret);
+
+            if (iret == DictionaryMessage) continue;
+
+            if (iret != 0)
+            {
+                std::ostringstream errStr;
+                errStr << "NCEPLIB-bufr couldn't read the message at offset " << offset;
+                errStr << " in " << filePath_ << ".";
+                throw eckit::BadValue(errStr.str());
+            }
+
+            subset_ = std::string(subsetChars);
+            subset_.erase(std::remove_if(subset_.begin(), subset_.end(), isspace),
+                          subset_.end());
+            return true;
+        }
+
+        return false;
+    }
+
+    bool DataProvider::nextBufferMessage(const unsigned char*& msg,
+                                         size_t& length,
+                                         std::uint64_t& offset)
+    {
+        if (compressedStream_) return compressedStream_->nextMessage(msg, length, offset);
+        if (readAheadFile_) return readAheadFile_->nextMessage(msg, length, offset);
+
+        if (!buffer_->findMessage(bufferPos_, length)) return false;
+
+        msg = buffer_->data() + bufferPos_;
+        offset = bufferPos_;
+        bufferPos_ += length;
+        return true;
+    }
+
     void DataProvider::run(const QuerySet& querySet,
                            const std::function<void()> processSubset,
                            const std::function<void()> processMsg,
-                           const std::function<bool()> continueProcessing)
+                           const std::function<bool()> continueProcessing,
+                           const std::function<bool()> decodeMsg)
     {
         if (!isOpen_)
         {
@@ -30,42 +410,155 @@ namespace bufr {
             throw eckit::BadParameter(errStr.str());
         }
 
-        static int SubsetLen = 9;
-        char subsetChars[SubsetLen];
-        int iddate;
-
         int bufrLoc;
         int il, im;  // throw away
 
         bool foundBufrMsg = false;
         bool foundBufrSubset = false;
 
-        while (ireadmg_f(FileUnit, subsetChars, &iddate, SubsetLen) == 0)
+        // Running out of messages part way through the file (ex: after running it in chunks) is
+        // fine, it's only an error if the file has no (valid) messages at all.
+        const bool startedAtBeginning = (messagesRead_ == 0);
+
+        // What was decoded (only added to the Profiler at the end, see below).
+        std::uint64_t numDecodedMsgs = 0;
+        std::uint64_t numDecodedSubsets = 0;
+        std::uint64_t numDecodedValues = 0;
+
+        // The lock is only held while we are inside NCEPLIB-bufr, so other threads can work on
+        // their own data while we run the callbacks.
+        std::unique_lock<std::recursive_mutex> lock(fortranMutex());
+        while (nextMessage())
         {
             foundBufrMsg = true;
-            subset_ = std::string(subsetChars);
-            subset_.erase(std::remove_if(subset_.begin(), subset_.end(), isspace), subset_.end());
 
             if (querySet.includesSubset(subset_))
             {
-                while (ireadsb_f(FileUnit) == 0)
+                // Skip the messages that are entirely outside the time window, and check the
+                // subsets of the ones on its edges.
+                bool checkSubsetTimes = false;
+                if (querySet.hasTimeWindow())
+                {
+                    if (querySet.timeWindow().excludesMessage(msgDate_))
+                    {
+                        foundBufrSubset = true;
+                        continue;
+                    }
+
+                    checkSubsetTimes = !querySet.timeWindow().includesMessage(msgDate_);
+                }
+
+                // The messages left out of the sample are skipped the same way.
+                if (querySet.sampling().isSampling() &&
+                    !querySet.sampling().includes(messagesRead_ - 1))
+                {
+                    foundBufrSubset = true;
+                    continue;
+                }
+
+                lock.unlock();
+                bool decode = decodeMsg();
+                lock.lock();
+
+                if (!decode)
                 {
                     foundBufrSubset = true;
-                    status_f(FileUnit, &bufrLoc, &il, &im);
-                    updateData(bufrLoc);
 
-                    processSubset();
-                    if (!continueProcessing()) break;
+                    lock.unlock();
+                    bool shouldContinue = continueProcessing();
+                    lock.lock();
+
+                    if (!shouldContinue) break;
+                    continue;
+                }
+
+                loadMessage();
+                numDecodedMsgs++;
+
+                auto nativeResult = NativeDecoder::Result::Unsupported;
+                if (nativeDecoder_ && holdsMessageBytes())
+                {
+                    status_f(fileUnit_, &bufrLoc, &il, &im);
+                    nativeResult = decodeNative(bufrLoc);
+                }
+
+                bool shouldContinue = true;
+                if (nativeResult == NativeDecoder::Result::Decoded)
+                {
+                    for (size_t subsetIdx = 0;
+                         subsetIdx < nativeDecoder_->numSubsets();
+                         subsetIdx++)
+                    {
+                        foundBufrSubset = true;
+                        useNativeSubset(subsetIdx);
+
+                        if (checkSubsetTimes && !subsetInTimeWindow(querySet.timeWindow()))
+                        {
+                            continue;
+                        }
+
+                        numDecodedSubsets++;
+                        numDecodedValues += static_cast<std::uint64_t>(nval_);
+
+                        lock.unlock();
+                        processSubset();
+                        shouldContinue = continueProcessing();
+                        lock.lock();
+
+                        if (!shouldContinue) break;
+                    }
+                }
+                else
+                {
+                    const bool isValidating = nativeResult == NativeDecoder::Result::Validate;
+                    size_t subsetIdx = 0;
+                    while (ireadsb_f(fileUnit_) == 0)
+                    {
+                        foundBufrSubset = true;
+                        status_f(fileUnit_, &bufrLoc, &il, &im);
+                        updateData(bufrLoc);
+
+                        if (isValidating)
+                        {
+                            nativeDecoder_->validate(subsetIdx++, val_, inv_, nval_);
+                        }
+
+                        if (checkSubsetTimes && !subsetInTimeWindow(querySet.timeWindow()))
+                        {
+                            continue;
+                        }
+
+                        numDecodedSubsets++;
+                        numDecodedValues += static_cast<std::uint64_t>(nval_);
+
+                        lock.unlock();
+                        processSubset();
+                        shouldContinue = continueProcessing();
+                        lock.lock();
+
+                        if (!shouldContinue) break;
+                    }
+
+                    if (isValidating) nativeDecoder_->finishValidation(subsetIdx);
                 }
 
+                lock.unlock();
                 processMsg();
-                if (!continueProcessing()) break;
+                shouldContinue = continueProcessing();
+                lock.lock();
+
+                if (!shouldContinue) break;
             }
         }
 
         deleteData();
+        lock.unlock();
 
-        if (!foundBufrMsg)
+        Profiler::count("decode.messages", numDecodedMsgs);
+        Profiler::count("decode.subsets", numDecodedSubsets);
+        Profiler::count("decode.values", numDecodedValues);
+
+        if (!foundBufrMsg && startedAtBeginning)
         {
             std::ostringstream errStr;
             errStr << "No BUFR messages were found! ";
@@ -73,7 +566,7 @@ namespace bufr {
             throw eckit::BadValue(errStr.str());
         }
 
-        if (!foundBufrSubset)
+        if (!foundBufrSubset && startedAtBeginning)
         {
             std::ostringstream errStr;
             errStr << "No valid BUFR subsets were found from your queries! ";
@@ -103,7 +596,97 @@ namespace bufr {
         inv_ = gsl::span<const int>(intPtr, size);
     }
 
+    void DataProvider::updateVariantIndex()
+    {
+        const auto tableData = getTableData().get();
+        if (tableData == indexedTableData_ && subset_ == indexedSubset_) return;
+
+        indexedTableData_ = tableData;
+        indexedSubset_ = subset_;
+        variantIndex_ = variantIndices_.insert({getSubsetVariant(), variantIndices_.size()})
+                            .first->second;
+    }
+
+    NativeDecoder::Result DataProvider::decodeNative(int bufrLoc)
+    {
+        // The message is loaded in NCEPLIB-bufr (for the tables), just not unpacked.
+        bufrLoc_ = bufrLoc;
+        get_inode_f(bufrLoc, &inode_);
+        updateTableData(subset_);
+
+        return nativeDecoder_->decode(*this,
+                                      getTableData(),
+                                      reinterpret_cast<const unsigned char*>(msgBuffer_.data()),
+                                      msgBuffer_.size() * sizeof(int));
+    }
+
+    void DataProvider::useNativeSubset(size_t subsetIdx)
+    {
+        val_ = nativeDecoder_->vals(subsetIdx);
+        inv_ = nativeDecoder_->invs(subsetIdx);
+        nval_ = static_cast<int>(val_.size());
+    }
+
+    bool DataProvider::subsetInTimeWindow(const TimeWindow& timeWindow) const
+    {
+        static const std::array<const char*, 6> TimeTags =
+            {"YEAR", "MNTH", "DAYS", "HOUR", "MINU", "SECO"};
+
+        std::array<double, 6> timeVals;
+        timeVals.fill(MissingOctetValue);
+
+        // The time fields are near the start of the subsets, so stop as soon as we have them.
+        const auto& tags = getTableData()->tag;
+        size_t numFound = 0;
+        for (int valIdx = 0; valIdx < nval_ && numFound < TimeTags.size(); ++valIdx)
+        {
+            const auto& tag = tags[inv_[valIdx] - 1];
+            for (size_t timeIdx = 0; timeIdx < TimeTags.size(); ++timeIdx)
+            {
+                if (timeVals[timeIdx] == MissingOctetValue && tag == TimeTags[timeIdx])
+                {
+                    timeVals[timeIdx] = val_[valIdx];
+                    numFound++;
+                    break;
+                }
+            }
+        }
+
+        // We can't tell without the date and hour
+        for (size_t timeIdx = 0; timeIdx < 4; ++timeIdx)
+        {
+            if (timeVals[timeIdx] >= MissingOctetValue) return true;
+        }
+
+        // Minutes and seconds are optional
+        for (size_t timeIdx = 4; timeIdx < TimeTags.size(); ++timeIdx)
+        {
+            if (timeVals[timeIdx] >= MissingOctetValue) timeVals[timeIdx] = 0;
+        }
+
+        const auto subsetTime = TimeWindow::toEpoch(static_cast<int>(timeVals[0]),
+                                                    static_cast<int>(timeVals[1]),
+                                                    static_cast<int>(timeVals[2]),
+                                                    static_cast<int>(timeVals[3]),
+                                                    static_cast<int>(timeVals[4]),
+                                                    static_cast<int>(timeVals[5]));
+
+        return timeWindow.contains(subsetTime);
+    }
+
     TypeInfo DataProvider::getTypeInfo(FortranIdx idx) const
+    {
+        const auto tag = getTag(idx);
+        auto infoIt = typeInfos_.find(tag);
+        if (infoIt == typeInfos_.end())
+        {
+            infoIt = typeInfos_.emplace(tag, readTypeInfo(tag)).first;
+        }
+
+        return infoIt->second;
+    }
+
+    TypeInfo DataProvider::readTypeInfo(const std::string& tag) const
     {
         static const unsigned int UNIT_STR_LEN = 24;
         static const unsigned int DESC_STR_LEN = 55;
@@ -114,13 +697,14 @@ namespace bufr {
         int retVal;
         TypeInfo info;
 
-        nemdefs_f(FileUnit,
-                  getTag(idx).c_str(),
-                   unitCStr,
-                   UNIT_STR_LEN,
-                   descCStr,
-                   DESC_STR_LEN,
-                   &retVal);
+        std::lock_guard<std::recursive_mutex> lock(fortranMutex());
+        nemdefs_f(fileUnit_,
+                  tag.c_str(),
+                  unitCStr,
+                  UNIT_STR_LEN,
+                  descCStr,
+                  DESC_STR_LEN,
+                  &retVal);
 
         if (retVal == 0)
         {
@@ -141,7 +725,7 @@ namespace bufr {
             char table_type;
 
             nemtab_f(bufrLoc_,
-                     getTag(idx).c_str(),
+                     tag.c_str(),
                      &descriptor,
                      &table_type,
                      &table_idx);
@@ -165,7 +749,8 @@ namespace bufr {
         static int MaxLongStrLen = 120;
         char charPtr[MaxLongStrLen];
 
-        readlc_f(FileUnit, longStrId.c_str(), charPtr, MaxLongStrLen);
+        std::lock_guard<std::recursive_mutex> lock(fortranMutex());
+        readlc_f(fileUnit_, longStrId.c_str(), charPtr, MaxLongStrLen);
 
         if (charPtr[0] == '\xff')
         {
@@ -174,5 +759,26 @@ namespace bufr {
 
         return std::string(charPtr, strlen(charPtr));
     }
+
+    void DataProvider::readLongStrs(const std::vector<std::string>& longStrIds,
+                                    std::string& chars,
+                                    std::vector<size_t>& ends) const
+    {
+        static int MaxLongStrLen = 120;
+        char charPtr[MaxLongStrLen];
+
+        ends.resize(longStrIds.size());
+        if (longStrIds.empty()) return;
+
+        std::lock_guard<std::recursive_mutex> lock(fortranMutex());
+        for (size_t strIdx = 0; strIdx < longStrIds.size(); ++strIdx)
+        {
+            readlc_f(fileUnit_, longStrIds[strIdx].c_str(), charPtr, MaxLongStrLen);
+
+            // Missing long strings are empty (see getLongStr)
+            if (charPtr[0] != '\xff') chars.append(charPtr, strlen(charPtr));
+            ends[strIdx] = chars.size();
+        }
+    }
 }  // namespace bufr
 }  // namespace Ingester
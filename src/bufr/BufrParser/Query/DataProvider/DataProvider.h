@@ -7,17 +7,25 @@
 
 #pragma once
 
+#include <fstream>
 #include <functional>
 #include <set>
 #include <string>
 #include <vector>
 #include <math.h>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <gsl/gsl-lite.hpp>
 #include <unordered_map>
 
 #include "bufr_interface.h"
 #include "../QuerySet.h"
+#include "CompressedStream.h"
+#include "MessageBuffer.h"
+#include "MessageIndex.h"
+#include "NativeDecoder.h"
+#include "ReadAheadFile.h"
+#include "RemoteFile.h"
 #include "SubsetVariant.h"
 
 
@@ -120,6 +128,20 @@ namespace bufr {
         int varientNumber;
     };
 
+    /// \brief The header (section 1 and 3) information of a data message.
+    struct MessageHeader
+    {
+        SubsetVariant variant;
+        int date = 0;  // YYYYMMDDHH (as returned by ireadmg_f)
+        size_t length = 0;  // Bytes in the message
+        int edition = 0;
+        int dataCategory = 0;
+        int dataSubCategory = 0;  // The local sub category
+        int numSubsets = 0;
+        bool isCompressed = false;
+        std::vector<int> descriptors;  // The section 3 descriptors (FXXYYY)
+    };
+
     class DataProvider;
     typedef std::shared_ptr<DataProvider> DataProviderType;
 
@@ -129,12 +151,9 @@ namespace bufr {
      public:
         DataProvider() = delete;
 
-        explicit DataProvider(const std::string filePath) :
-            filePath_(filePath)
-        {
-        }
+        explicit DataProvider(const std::string filePath);
 
-        virtual ~DataProvider() = default;
+        virtual ~DataProvider();
 
         /// \brief Runs through the contents of the BUFR file. Calls the functions given as its
         ///        its running.
@@ -142,10 +161,20 @@ namespace bufr {
         /// \param processMsg (Optional) Function to call when finish processing a message.
         /// \param continueProcessing (Optional) Function to call to figure out if we should keep
         ///                           running or not.
+        /// \param decodeMsg (Optional) Function to call to figure out if the subsets of the
+        ///                  current message should be decoded. Messages that are not decoded are
+        ///                  still counted against continueProcessing.
         void run(const QuerySet& querySet,
                  const std::function<void()> processSubset,
                  const std::function<void()> processMsg = [](){},
-                 const std::function<bool()> continueProcessing = [](){ return true; });
+                 const std::function<bool()> continueProcessing = [](){ return true; },
+                 const std::function<bool()> decodeMsg = [](){ return true; });
+
+        /// \brief Read the headers of the data messages without decoding any of their subsets
+        ///        (ireadsb_f is never called). Opens and closes the file, so it can't already be
+        ///        open. Files NCEPLIB-bufr would read itself are memory mapped for the scan.
+        /// \param processHeader The function to call with the header of each data message.
+        void scanHeaders(const std::function<void(const MessageHeader&)>& processHeader);
 
         /// \brief Open the BUFR file with NCEPLIB-bufr
         virtual void open() = 0;
@@ -153,8 +182,10 @@ namespace bufr {
         /// \brief Close the currently open BUFR file.
         void close()
         {
-            closbf_f(FileUnit);
-            close_f(FileUnit);
+            std::lock_guard<std::recursive_mutex> lock(fortranMutex());
+
+            closbf_f(fileUnit_);
+            close_f(fileUnit_);
             isOpen_ = false;
         }
 
@@ -170,7 +201,11 @@ namespace bufr {
 
         /// \brief Tells the Fortran BUFR interface to delete its temporary data structures that are
         /// are needed to support this class instanc.
-        inline void deleteData() { delete_table_data_f(); }
+        inline void deleteData()
+        {
+            std::lock_guard<std::recursive_mutex> lock(fortranMutex());
+            delete_table_data_f();
+        }
 
         /// \brief Get the current active suibset variant.
         SubsetVariant getSubsetVariant() const
@@ -178,9 +213,74 @@ namespace bufr {
             return SubsetVariant(subset_, variantId(), hasVariants());
         }
 
+        /// \brief Get the dense index (0, 1, 2 ...) of the current subset variant, in the order
+        ///        the variants were first seen by this instance. Cheaper to key caches with than
+        ///        getSubsetVariant, which copies the subset name. Valid while executing "run".
+        inline size_t getVariantIndex() const { return variantIndex_; }
+
+        /// \brief Get the number of subset variants indexed so far (see getVariantIndex).
+        inline size_t getNumVariants() const { return variantIndices_.size(); }
+
         /// \brief Get the filepath for the currently open BUFR file.
         std::string getFilepath() const { return filePath_; }
 
+        /// \brief Get the Fortran file unit this instance uses for the BUFR file.
+        inline int getFileUnit() const { return fileUnit_; }
+
+        /// \brief Get the number of BUFR messages read since the file was opened.
+        inline size_t getMessagesRead() const { return messagesRead_; }
+
+        /// \brief Read past the next messages in the file without decoding them.
+        /// \param count The number of messages to skip.
+        void skipMessages(size_t count);
+
+        /// \brief Get the subset name of the current message.
+        inline std::string getSubset() const { return subset_; }
+
+        /// \brief Get the date (YYYYMMDDHH) of the current message.
+        inline int getMessageDate() const { return msgDate_; }
+
+        /// \brief Use a message index to find the messages in the file. Messages for subsets
+        ///        that aren't part of the QuerySet are then skipped without being read, and the
+        ///        others are read straight from their offsets. Set before opening the file.
+        /// \param index The index for the file.
+        void setMessageIndex(const std::shared_ptr<const MessageIndex>& index) { index_ = index; }
+
+        /// \brief Decode the messages from memory instead of from the file (the file path is
+        ///        then only used in messages). Set before opening the file.
+        /// \param buffer The BUFR messages.
+        void setMessageBuffer(const std::shared_ptr<const MessageBuffer>& buffer)
+        {
+            buffer_ = buffer;
+        }
+
+        /// \brief Read the messages of a remote file (through its message index, see
+        ///        setMessageIndex). Set before opening the file.
+        /// \param remoteFile The remote file.
+        void setRemoteFile(const std::shared_ptr<const RemoteFile>& remoteFile)
+        {
+            remoteFile_ = remoteFile;
+        }
+
+        /// \brief Decode the data sections of the messages with the NativeDecoder where it can
+        ///        (NCEPLIB-bufr decodes the rest). The decoder needs the bytes of the messages, so
+        ///        files NCEPLIB-bufr would read itself are memory mapped instead. Set before
+        ///        opening the file.
+        /// \param enable Use the native decoder.
+        void setNativeDecoding(bool enable);
+
+        /// \brief Read the file through large buffers that a background thread fills ahead of
+        ///        the decoding (see ReadAheadFile) instead of leaving the reads to NCEPLIB-bufr.
+        ///        Only local, uncompressed files read without a message index (or a memory
+        ///        mapping) are read this way. Set before opening the file.
+        /// \param enable Read ahead.
+        void setReadAhead(bool enable) { readAhead_ = enable; }
+
+        /// \brief Mutex that must be held while calling into NCEPLIB-bufr. The library keeps
+        ///        its state in global (module) variables so it can't be entered by more than
+        ///        one thread at a time, no matter how many files are open.
+        static std::recursive_mutex& fortranMutex();
+
         /// \brief Get the initial (start) BUFR table node for that
         ///        that corresponds to the data.
         inline FortranIdx getInode() const { return inode_; }
@@ -201,11 +301,25 @@ namespace bufr {
         /// \param The index of the data object for which you want a value.
         inline gsl::span<const double> getVals() const { return val_; }
 
+        /// \brief Get the table node ids for all the data elements (see getInv).
+        inline gsl::span<const int> getInvs() const { return inv_; }
+
 
         std::string getLongStr(const std::string& longStrId) const;
 
+        /// \brief Read several long strings of the current subset at once (with one buffer and
+        ///        one lock). The strings are appended one after the other to chars.
+        /// \param longStrIds The long string ids (mnemonic#occurrence).
+        /// \param chars The buffer to append the characters to.
+        /// \param ends Filled with the end offset (in chars) of each string.
+        void readLongStrs(const std::vector<std::string>& longStrIds,
+                          std::string& chars,
+                          std::vector<size_t>& ends) const;
+
 
-        /// \brief Get the TypeInfo object for the table node at the given idx.
+        /// \brief Get the TypeInfo object for the table node at the given idx. The TypeInfo of
+        ///        each mnemonic is read from NCEPLIB-bufr once (the nodes of every variant that
+        ///        have the mnemonic share it), since the tables of a file don't change.
         /// \param idx BUFR table node index
         TypeInfo getTypeInfo(FortranIdx idx) const;
 
@@ -256,11 +370,12 @@ namespace bufr {
         virtual void initAllTableData() {}
 
      protected:
-        static const int FileUnit = 12;
-
         const std::string filePath_;
+        const int fileUnit_;
         std::string subset_;
         bool isOpen_ = false;
+        size_t messagesRead_ = 0;
+        int msgDate_ = 0;
 
         // BUFR table meta data elements
         int inode_;
@@ -271,16 +386,111 @@ namespace bufr {
         gsl::span<const double> val_;
         gsl::span<const int> inv_;
 
+        /// \brief The TypeInfo of the mnemonics asked about so far (see getTypeInfo).
+        mutable std::unordered_map<std::string, TypeInfo> typeInfos_;
+
         /// \brief Update the table data for the currently loaded subset.
         /// \param subset The subset string.
         virtual void updateTableData(const std::string& subset) = 0;
 
+        /// \brief Find the index of the current subset variant (see getVariantIndex). Called
+        ///        by updateTableData, only looks the variant up when the subset or its table
+        ///        data changed.
+        void updateVariantIndex();
+
         /// \brief Read the data from the BUFR interface for the current subset and reset the
         /// internal data structures.
         ////// \param bufrLoc The Fortran idx for the subset we need to read.
         void updateData(int bufrLoc);
 
+        /// \brief Go back to the start of the file. Called when the file is (re)opened.
+        void resetMessagePosition();
+
+        /// \brief False if the messages are decoded from memory (a MessageBuffer, the
+        ///        messages fetched from a RemoteFile, those of a compressed file or the ones read
+        ///        ahead) rather than read from the file by NCEPLIB-bufr.
+        bool readsFromFile() const
+        {
+            return buffer_ == nullptr &&
+                   remoteFile_ == nullptr &&
+                   compression_ == Compression::None &&
+                   !readsAhead();
+        }
+
+        /// \brief True if the messages are read through a ReadAheadFile (see setReadAhead).
+        bool readsAhead() const
+        {
+            return readAhead_ &&
+                   index_ == nullptr &&
+                   buffer_ == nullptr &&
+                   remoteFile_ == nullptr &&
+                   compression_ == Compression::None;
+        }
+
+        /// \brief The path to connect the Fortran unit to when opening (a placeholder when the
+        ///        messages aren't read from the file).
+        const char* openPath() const { return readsFromFile() ? filePath_.c_str() : "/dev/null"; }
+
      private:
+        std::shared_ptr<const MessageIndex> index_;
+        size_t indexPos_ = 0;
+        bool foundIndexedData_ = false;
+        std::ifstream indexedFile_;
+        std::vector<int> msgBuffer_;
+        std::shared_ptr<const MessageBuffer> buffer_;
+        size_t bufferPos_ = 0;
+        std::shared_ptr<const RemoteFile> remoteFile_;
+        Compression compression_ = Compression::None;
+        std::unique_ptr<CompressedStream> compressedStream_;
+        bool readAhead_ = false;
+        std::unique_ptr<ReadAheadFile> readAheadFile_;
+        std::unique_ptr<NativeDecoder> nativeDecoder_;
+
+        // The indices of the subset variants seen so far (see getVariantIndex).
+        std::unordered_map<SubsetVariant, size_t> variantIndices_;
+        size_t variantIndex_ = 0;
+        std::string indexedSubset_;
+        const TableData* indexedTableData_ = nullptr;
+
+        /// \brief Advance to the next data message and update the subset name and date. With an
+        ///        index the message is not read yet (see loadMessage).
+        /// \return false once there are no more messages.
+        bool nextMessage();
+
+        /// \brief Make sure the current message is loaded so its subsets can be read.
+        void loadMessage();
+
+        /// \brief Read a message from the file via its index entry into the Fortran unit.
+        void readIndexedMessage(const MessageIndexEntry& entry);
+
+        /// \brief Read the next data message from the MessageBuffer (or the CompressedStream or
+        ///        the ReadAheadFile) into the Fortran unit (the DX table messages on the way are
+        ///        stored by NCEPLIB-bufr).
+        /// \return false once there are no more messages.
+        bool readBufferMessage();
+
+        /// \brief Get the next message held in memory (see readBufferMessage).
+        /// \return false once there are no more messages.
+        bool nextBufferMessage(const unsigned char*& msg, size_t& length, std::uint64_t& offset);
+
+        /// \brief Are the bytes of the current message in msgBuffer_ (rather than only in
+        ///        NCEPLIB-bufr)?
+        bool holdsMessageBytes() const { return index_ != nullptr || !readsFromFile(); }
+
+        /// \brief Read the TypeInfo of a mnemonic from NCEPLIB-bufr (nemdefs, nemtab and nemtbb).
+        TypeInfo readTypeInfo(const std::string& tag) const;
+
+        /// \brief Decode the current message with the native decoder.
+        /// \param bufrLoc The Fortran idx for the file.
+        NativeDecoder::Result decodeNative(int bufrLoc);
+
+        /// \brief Point the data of the current subset to a subset decoded natively.
+        void useNativeSubset(size_t subsetIdx);
+
+        /// \brief Check the time (YEAR, MNTH, DAYS, HOUR, MINU, SECO) of the current subset
+        ///        against the time window. Subsets without a time are kept.
+        bool subsetInTimeWindow(const TimeWindow& timeWindow) const;
+
         /// \brief Get the currently valid subset table data
         virtual std::shared_ptr<TableData> getTableData() const = 0;
     };
@@ -0,0 +1,128 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "MessageBuffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    const size_t Section0Size = 8;
+    const size_t EndSectionSize = 4;
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    MessageBuffer::MessageBuffer(const void* data, size_t size, std::shared_ptr<const void> owner) :
+        data_(static_cast<const unsigned char*>(data)),
+        size_(size),
+        owner_(std::move(owner))
+    {
+    }
+
+    std::shared_ptr<const MessageBuffer> MessageBuffer::copyOf(const void* data, size_t size)
+    {
+        auto bytes = std::make_shared<std::vector<unsigned char>>(
+            static_cast<const unsigned char*>(data),
+            static_cast<const unsigned char*>(data) + size);
+
+        return std::make_shared<MessageBuffer>(bytes->data(), bytes->size(), bytes);
+    }
+
+    std::shared_ptr<const MessageBuffer> MessageBuffer::mapFile(const std::string& filePath)
+    {
+        const int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't open the BUFR file " << filePath << " to map it.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        struct stat fileInfo;
+        if (fstat(fd, &fileInfo) != 0)
+        {
+            ::close(fd);
+
+            std::ostringstream errStr;
+            errStr << "Couldn't stat the BUFR file " << filePath << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const auto size = static_cast<size_t>(fileInfo.st_size);
+        if (size == 0)
+        {
+            ::close(fd);
+            return std::make_shared<MessageBuffer>(nullptr, 0);
+        }
+
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (addr == MAP_FAILED)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't memory map the BUFR file " << filePath << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        // The messages are decoded in order (only a hint).
+        madvise(addr, size, MADV_SEQUENTIAL);
+
+        std::shared_ptr<const void> mapping(addr, [size](const void* ptr)
+        {
+            munmap(const_cast<void*>(ptr), size);
+        });
+
+        return std::make_shared<MessageBuffer>(addr, size, mapping);
+    }
+
+    bool MessageBuffer::findMessage(size_t& pos, size_t& length) const
+    {
+        const char* marker = "BUFR";
+        while (pos + Section0Size <= size_)
+        {
+            auto found = std::search(data_ + pos, data_ + size_, marker, marker + 4);
+            if (found == data_ + size_) break;
+
+            pos = static_cast<size_t>(found - data_);
+            if (pos + Section0Size > size_) break;
+
+            length = (static_cast<size_t>(data_[pos + 4]) << 16) |
+                     (static_cast<size_t>(data_[pos + 5]) << 8) |
+                     static_cast<size_t>(data_[pos + 6]);
+            const auto edition = data_[pos + 7];
+
+            // Skip anything that isn't a complete BUFR message (or one we can't handle).
+            if (edition >= 2 && edition <= 4 &&
+                length >= Section0Size + EndSectionSize &&
+                pos + length <= size_ &&
+                std::memcmp(data_ + pos + length - EndSectionSize, "7777", EndSectionSize) == 0)
+            {
+                return true;
+            }
+
+            pos += 4;
+        }
+
+        pos = size_;
+        return false;
+    }
+}  // namespace bufr
+}  // namespace Ingester
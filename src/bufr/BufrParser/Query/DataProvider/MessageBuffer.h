@@ -0,0 +1,54 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Read only bytes holding BUFR messages (the contents of a BUFR file) that are
+    ///        decoded straight from memory, ex: bulletins received from a message queue or a
+    ///        memory mapped file.
+    class MessageBuffer
+    {
+     public:
+        /// \brief Constructor. The bytes are not copied.
+        /// \param data The bytes.
+        /// \param size The number of bytes.
+        /// \param owner (Optional) Object that keeps the bytes alive as long as the buffer.
+        MessageBuffer(const void* data, size_t size, std::shared_ptr<const void> owner = nullptr);
+
+        /// \brief Make a buffer holding a copy of the bytes.
+        /// \param data The bytes.
+        /// \param size The number of bytes.
+        static std::shared_ptr<const MessageBuffer> copyOf(const void* data, size_t size);
+
+        /// \brief Make a buffer on a memory mapped (read only) file.
+        /// \param filePath Path to the BUFR file.
+        static std::shared_ptr<const MessageBuffer> mapFile(const std::string& filePath);
+
+        const unsigned char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+        /// \brief Find the next (complete) BUFR message at or after pos.
+        /// \param pos The position to start looking at. Set to the start of the message.
+        /// \param length Set to the length of the message in bytes.
+        /// \return false if there are no more messages.
+        bool findMessage(size_t& pos, size_t& length) const;
+
+     private:
+        const unsigned char* data_;
+        size_t size_;
+        std::shared_ptr<const void> owner_;
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,386 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "MessageIndex.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "../QuerySet.h"
+#include "NcepDataProvider.h"
+#include "RemoteFile.h"
+#include "WmoDataProvider.h"
+
+
+namespace
+{
+    const char* IndexMagic = "BUFRIDX";
+    const int IndexVersion = 1;
+    const char* NoSubset = "-";
+
+    const size_t ScanChunkSize = 65536;
+    const size_t Section0Size = 8;
+    const int DictionaryDataCategory = 11;
+
+    struct FileStat
+    {
+        std::uint64_t size = 0;
+        std::int64_t modTime = 0;
+    };
+
+    FileStat statFile(const std::string& filePath)
+    {
+        // Object stores don't give a usable modification time, so remote files are checked by
+        // size only.
+        if (Ingester::bufr::RemoteFile::isRemote(filePath))
+        {
+            FileStat fileStat;
+            fileStat.size = Ingester::bufr::RemoteFile(filePath).size();
+            return fileStat;
+        }
+
+        struct stat fileInfo;
+        if (stat(filePath.c_str(), &fileInfo) != 0)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't stat the BUFR file " << filePath << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        FileStat fileStat;
+        fileStat.size = static_cast<std::uint64_t>(fileInfo.st_size);
+        fileStat.modTime = static_cast<std::int64_t>(fileInfo.st_mtime);
+        return fileStat;
+    }
+
+    unsigned int readUInt(const unsigned char* bytes, size_t numBytes)
+    {
+        unsigned int value = 0;
+        for (size_t byteIdx = 0; byteIdx < numBytes; byteIdx++)
+        {
+            value = (value << 8) | bytes[byteIdx];
+        }
+
+        return value;
+    }
+
+    /// \brief Make the index entry for a (complete) BUFR message.
+    Ingester::bufr::MessageIndexEntry entryFor(const unsigned char* msg,
+                                               size_t length,
+                                               std::uint64_t pos)
+    {
+        const auto edition = msg[7];
+
+        // Section 1 layout depends on the edition
+        const unsigned char* section1 = &msg[Section0Size];
+        const auto section1Len = readUInt(section1, 3);
+        const bool hasSection2 = (edition == 4 ? section1[9] : section1[7]) & 0x80;
+        const int dataCategory = (edition == 4 ? section1[10] : section1[8]);
+
+        size_t section3Pos = Section0Size + section1Len;
+        if (hasSection2 && section3Pos + 3 <= length)
+        {
+            section3Pos += readUInt(&msg[section3Pos], 3);
+        }
+
+        Ingester::bufr::MessageIndexEntry entry;
+        entry.offset = pos;
+        entry.length = static_cast<std::uint32_t>(length);
+        entry.isDictionary = (dataCategory == DictionaryDataCategory);
+        if (section3Pos + 6 <= length)
+        {
+            entry.numSubsets = static_cast<int>(readUInt(&msg[section3Pos + 4], 2));
+        }
+
+        return entry;
+    }
+
+    /// \brief Find the start of the next BUFR message at or after pos.
+    bool findMessage(std::ifstream& file, std::uint64_t& pos)
+    {
+        std::vector<char> chunk(ScanChunkSize);
+        while (true)
+        {
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(pos));
+            file.read(chunk.data(), chunk.size());
+
+            const auto numRead = static_cast<size_t>(file.gcount());
+            if (numRead < 4) return false;
+
+            const char* marker = "BUFR";
+            auto found = std::search(chunk.begin(), chunk.begin() + numRead, marker, marker + 4);
+            if (found != chunk.begin() + numRead)
+            {
+                pos += static_cast<std::uint64_t>(found - chunk.begin());
+                return true;
+            }
+
+            // Overlap the chunks so a marker on the boundary isn't missed
+            pos += numRead - 3;
+        }
+    }
+
+    /// \brief Find all the BUFR messages in the file, and read the parts of their headers we
+    ///        need in order to index them.
+    std::vector<Ingester::bufr::MessageIndexEntry> scanMessages(const std::string& filePath)
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't open the BUFR file " << filePath << " to index it.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        std::vector<Ingester::bufr::MessageIndexEntry> entries;
+        std::vector<unsigned char> msg;
+
+        std::uint64_t pos = 0;
+        while (findMessage(file, pos))
+        {
+            unsigned char section0[Section0Size];
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(pos));
+            file.read(reinterpret_cast<char*>(section0), Section0Size);
+            if (static_cast<size_t>(file.gcount()) < Section0Size) break;
+
+            const auto length = readUInt(&section0[4], 3);
+            const auto edition = section0[7];
+            if (edition < 2 || edition > 4 || length < Section0Size + 4)
+            {
+                // Not a real BUFR message (or one we can't handle), keep looking.
+                pos += 4;
+                continue;
+            }
+
+            msg.resize(length);
+            file.seekg(static_cast<std::streamoff>(pos));
+            file.read(reinterpret_cast<char*>(msg.data()), length);
+            if (static_cast<size_t>(file.gcount()) < length ||
+                std::memcmp(&msg[length - 4], "7777", 4) != 0)
+            {
+                pos += 4;
+                continue;
+            }
+
+            entries.push_back(entryFor(msg.data(), length, pos));
+            pos += length;
+        }
+
+        return entries;
+    }
+
+    /// \brief Find all the BUFR messages in a buffer and index them.
+    std::vector<Ingester::bufr::MessageIndexEntry> scanMessages(
+        const Ingester::bufr::MessageBuffer& buffer)
+    {
+        std::vector<Ingester::bufr::MessageIndexEntry> entries;
+
+        size_t pos = 0;
+        size_t length = 0;
+        while (buffer.findMessage(pos, length))
+        {
+            entries.push_back(entryFor(buffer.data() + pos, length, pos));
+            pos += length;
+        }
+
+        return entries;
+    }
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    MessageIndex MessageIndex::build(const std::string& filePath,
+                                     const std::string& wmoTablePath)
+    {
+        const auto fileStat = statFile(filePath);
+
+        MessageIndex index;
+        index.fileSize_ = fileStat.size;
+        index.fileModTime_ = fileStat.modTime;
+
+        // Remote files are fetched once and indexed from memory.
+        std::shared_ptr<const MessageBuffer> buffer;
+        if (RemoteFile::isRemote(filePath))
+        {
+            buffer = RemoteFile(filePath).readAll();
+            index.entries_ = scanMessages(*buffer);
+        }
+        else
+        {
+            index.entries_ = scanMessages(filePath);
+        }
+
+        // Get the subset names and dates the same way the DataProvider sees them.
+        std::shared_ptr<DataProvider> dataProvider;
+        if (wmoTablePath.empty())
+        {
+            dataProvider = std::make_shared<NcepDataProvider>(filePath);
+        }
+        else
+        {
+            dataProvider = std::make_shared<WmoDataProvider>(filePath, wmoTablePath);
+        }
+
+        if (buffer) dataProvider->setMessageBuffer(buffer);
+
+        std::vector<std::pair<std::string, int>> msgHeaders;
+        auto readHeader = [&msgHeaders, &dataProvider]() -> bool
+        {
+            msgHeaders.emplace_back(dataProvider->getSubset(), dataProvider->getMessageDate());
+            return false;
+        };
+
+        dataProvider->open();
+        dataProvider->run(QuerySet(),
+                          [](){},
+                          [](){},
+                          [](){ return true; },
+                          readHeader);
+        dataProvider->close();
+
+        if (msgHeaders.size() != index.numMessages())
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't index " << filePath << ". Found " << index.numMessages();
+            errStr << " data messages but NCEPLIB-bufr read " << msgHeaders.size() << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        auto header = msgHeaders.begin();
+        for (auto& entry : index.entries_)
+        {
+            if (entry.isDictionary) continue;
+
+            entry.subset = header->first;
+            entry.date = header->second;
+            ++header;
+        }
+
+        return index;
+    }
+
+    MessageIndex MessageIndex::read(const std::string& indexPath)
+    {
+        std::ifstream file(indexPath);
+        if (!file)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't open the BUFR index file " << indexPath << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        std::string magic;
+        int version = 0;
+        size_t numEntries = 0;
+
+        MessageIndex index;
+        file >> magic >> version >> index.fileSize_ >> index.fileModTime_ >> numEntries;
+        if (!file || magic != IndexMagic || version != IndexVersion)
+        {
+            std::ostringstream errStr;
+            errStr << "The file " << indexPath << " is not a valid BUFR index file.";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        index.entries_.resize(numEntries);
+        for (auto& entry : index.entries_)
+        {
+            file >> entry.offset >> entry.length >> entry.isDictionary >> entry.subset
+                 >> entry.date >> entry.numSubsets;
+
+            if (entry.subset == NoSubset) entry.subset = "";
+        }
+
+        if (!file)
+        {
+            std::ostringstream errStr;
+            errStr << "The BUFR index file " << indexPath << " is truncated.";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        return index;
+    }
+
+    std::shared_ptr<const MessageIndex> MessageIndex::load(const std::string& filePath,
+                                                           const std::string& indexPath,
+                                                           const std::string& wmoTablePath)
+    {
+        if (std::ifstream(indexPath).good())
+        {
+            try
+            {
+                auto index = std::make_shared<MessageIndex>(MessageIndex::read(indexPath));
+                if (index->isValidFor(filePath)) return index;
+            }
+            catch (const eckit::Exception&)
+            {
+                // Unreadable index files are just rebuilt.
+            }
+        }
+
+        auto index = std::make_shared<MessageIndex>(MessageIndex::build(filePath, wmoTablePath));
+
+        try
+        {
+            index->write(indexPath);
+        }
+        catch (const eckit::Exception&)
+        {
+            // Not being able to store the sidecar (ex: read only directory) only means it has
+            // to be built again next time.
+        }
+
+        return index;
+    }
+
+    void MessageIndex::write(const std::string& indexPath) const
+    {
+        std::ofstream file(indexPath);
+        if (!file)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't write the BUFR index file " << indexPath << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        file << IndexMagic << " " << IndexVersion << "\n";
+        file << fileSize_ << " " << fileModTime_ << "\n";
+        file << entries_.size() << "\n";
+
+        for (const auto& entry : entries_)
+        {
+            file << entry.offset << " "
+                 << entry.length << " "
+                 << entry.isDictionary << " "
+                 << (entry.subset.empty() ? NoSubset : entry.subset) << " "
+                 << entry.date << " "
+                 << entry.numSubsets << "\n";
+        }
+    }
+
+    bool MessageIndex::isValidFor(const std::string& filePath) const
+    {
+        const auto fileStat = statFile(filePath);
+        return fileStat.size == fileSize_ && fileStat.modTime == fileModTime_;
+    }
+
+    size_t MessageIndex::numMessages() const
+    {
+        return std::count_if(entries_.begin(), entries_.end(),
+                             [](const MessageIndexEntry& entry) { return !entry.isDictionary; });
+    }
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,80 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Location and header information for one message in a BUFR file.
+    struct MessageIndexEntry
+    {
+        std::uint64_t offset = 0;  // Byte offset of "BUFR" in the file
+        std::uint32_t length = 0;  // Total length of the message in bytes
+        bool isDictionary = false;  // DX table message (ireadmg_f skips these)
+        std::string subset;  // Subset name as returned by ireadmg_f
+        int date = 0;  // Message date (YYYYMMDDHH) as returned by ireadmg_f
+        int numSubsets = 0;  // Number of data subsets
+    };
+
+    /// \brief Index of the messages in a BUFR file. It makes it possible to find the messages
+    ///        belonging to given subsets and to read them without reading the rest of the file.
+    ///        The index can be stored in a small sidecar file next to the BUFR file.
+    class MessageIndex
+    {
+     public:
+        MessageIndex() = default;
+
+        /// \brief Scan a BUFR file (local or remote, see RemoteFile) and build its index.
+        /// \param filePath Path to the BUFR file to index.
+        /// \param wmoTablePath (Optional) Path to the WMO master tables (for WMO BUFR files).
+        static MessageIndex build(const std::string& filePath,
+                                  const std::string& wmoTablePath = "");
+
+        /// \brief Read an index from a sidecar file.
+        /// \param indexPath Path to the index file.
+        static MessageIndex read(const std::string& indexPath);
+
+        /// \brief Get the index for a BUFR file from its sidecar file. The index is (re)built
+        ///        and written if the sidecar doesn't exist or no longer matches the BUFR file.
+        /// \param filePath Path to the BUFR file.
+        /// \param indexPath Path to the index file.
+        /// \param wmoTablePath (Optional) Path to the WMO master tables (for WMO BUFR files).
+        static std::shared_ptr<const MessageIndex> load(const std::string& filePath,
+                                                        const std::string& indexPath,
+                                                        const std::string& wmoTablePath = "");
+
+        /// \brief The default sidecar path for a BUFR file.
+        static std::string defaultPath(const std::string& filePath) { return filePath + ".idx"; }
+
+        /// \brief Write the index to a sidecar file.
+        /// \param indexPath Path to the index file.
+        void write(const std::string& indexPath) const;
+
+        /// \brief True if the index was built for the current version of the BUFR file.
+        /// \param filePath Path to the BUFR file.
+        bool isValidFor(const std::string& filePath) const;
+
+        /// \brief Get all the entries (data and dictionary messages) in file order.
+        const std::vector<MessageIndexEntry>& entries() const { return entries_; }
+
+        /// \brief Get the number of data messages (the ones ireadmg_f would return).
+        size_t numMessages() const;
+
+     private:
+        std::uint64_t fileSize_ = 0;
+        std::int64_t fileModTime_ = 0;
+        std::vector<MessageIndexEntry> entries_;
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,656 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "NativeDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "DataProvider.h"
+#include "../Constants.h"
+
+
+namespace
+{
+    // Bits of the increment widths in compressed messages.
+    const int IncrementWidthBits = 6;
+
+    // Guard against corrupt messages (NCEPLIB-bufr allows no more than this many per subset).
+    const size_t MaxSubsetValues = 1000000;
+
+    // The bit reader loads 8 bytes at a time, so the data is padded with this many bytes.
+    const size_t SectionPadding = 8;
+
+    size_t readLength(const unsigned char* bytes)
+    {
+        return (static_cast<size_t>(bytes[0]) << 16) |
+               (static_cast<size_t>(bytes[1]) << 8) |
+               static_cast<size_t>(bytes[2]);
+    }
+
+    /// \brief Find the data section of a message.
+    /// \return false if the message is too short or malformed.
+    bool findDataSection(const unsigned char* msg,
+                         size_t size,
+                         size_t& dataStart,
+                         size_t& dataSize,
+                         size_t& numSubsets,
+                         bool& isCompressed)
+    {
+        if (size < 8 || std::memcmp(msg, "BUFR", 4) != 0) return false;
+
+        const size_t msgLength = readLength(msg + 4);
+        const int edition = msg[7];
+        if (edition < 2 || msgLength > size) return false;
+
+        // Section 1 (and the flag for the optional section 2)
+        size_t pos = 8;
+        if (pos + 10 > msgLength) return false;
+        const bool hasSection2 = (msg[pos + (edition >= 4 ? 9 : 7)] & 0x80) != 0;
+        pos += readLength(msg + pos);
+
+        if (hasSection2)
+        {
+            if (pos + 3 > msgLength) return false;
+            pos += readLength(msg + pos);
+        }
+
+        // Section 3
+        if (pos + 7 > msgLength) return false;
+        numSubsets = (static_cast<size_t>(msg[pos + 4]) << 8) | msg[pos + 5];
+        isCompressed = (msg[pos + 6] & 0x40) != 0;
+        pos += readLength(msg + pos);
+
+        // Section 4
+        if (pos + 4 > msgLength) return false;
+        const size_t sectionLength = readLength(msg + pos);
+        if (sectionLength < 4 || pos + sectionLength > msgLength) return false;
+
+        dataStart = pos + 4;
+        dataSize = sectionLength - 4;
+        return true;
+    }
+
+    /// \brief The value with all the bits set (a missing value) for a width.
+    inline std::uint64_t allOnesFor(int numBits)
+    {
+        return numBits == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << numBits) - 1;
+    }
+
+    inline bool isSameBits(double lhs, double rhs)
+    {
+        return std::memcmp(&lhs, &rhs, sizeof(double)) == 0;
+    }
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    NativeDecoder::Result NativeDecoder::decode(const DataProvider& provider,
+                                                const std::shared_ptr<TableData>& tableData,
+                                                const unsigned char* msg,
+                                                size_t size)
+    {
+        subsetStarts_.assign(1, 0);
+        vals_.clear();
+        invs_.clear();
+        elementIdxs_.clear();
+
+        plan_ = &planFor(provider, tableData);
+        if (plan_->state == State::Unsupported) return Result::Unsupported;
+
+        size_t dataStart = 0;
+        size_t dataSize = 0;
+        size_t numSubsets = 0;
+        bool isCompressed = false;
+        if (!findDataSection(msg, size, dataStart, dataSize, numSubsets, isCompressed))
+        {
+            return Result::Unsupported;
+        }
+
+        section_.resize(dataSize + SectionPadding);
+        std::memcpy(section_.data(), msg + dataStart, dataSize);
+        std::memset(section_.data() + dataSize, 0, SectionPadding);
+        numBits_ = dataSize * 8;
+        bitPos_ = 0;
+
+        const bool isValidating = plan_->state == State::Unvalidated;
+        const bool isDecoded = isCompressed ? decodeCompressed(numSubsets, isValidating)
+                                            : decodeSubsets(numSubsets, isValidating);
+
+        if (!isDecoded)
+        {
+            // A trusted template can still meet a structural node it has no value for yet (or a
+            // corrupt message), so the next message is validated again.
+            subsetStarts_.assign(1, 0);
+            if (isValidating)
+            {
+                reject();
+            }
+            else
+            {
+                plan_->state = State::Unvalidated;
+            }
+
+            return Result::Unsupported;
+        }
+
+        if (isValidating)
+        {
+            isMatching_ = true;
+            return Result::Validate;
+        }
+
+        return Result::Decoded;
+    }
+
+    void NativeDecoder::validate(size_t subsetIdx,
+                                 gsl::span<const double> vals,
+                                 gsl::span<const int> invs,
+                                 size_t numVals)
+    {
+        if (!isMatching_) return;
+
+        if (subsetIdx >= numSubsets() ||
+            subsetStarts_[subsetIdx + 1] - subsetStarts_[subsetIdx] != numVals)
+        {
+            isMatching_ = false;
+            return;
+        }
+
+        const size_t start = subsetStarts_[subsetIdx];
+        for (size_t valIdx = 0; valIdx < numVals; ++valIdx)
+        {
+            if (invs_[start + valIdx] != invs[valIdx])
+            {
+                isMatching_ = false;
+                return;
+            }
+
+            const auto elementIdx = elementIdxs_[start + valIdx];
+            if (plan_->elements[elementIdx].kind == Kind::Structural ||
+                plan_->elements[elementIdx].kind == Kind::FixedRep)
+            {
+                if (!plan_->isLearned[elementIdx])
+                {
+                    plan_->structuralVals[elementIdx] = vals[valIdx];
+                    plan_->isLearned[elementIdx] = true;
+                    continue;
+                }
+
+                if (!isSameBits(plan_->structuralVals[elementIdx], vals[valIdx]))
+                {
+                    isMatching_ = false;
+                    return;
+                }
+
+                continue;
+            }
+
+            if (!isSameBits(vals_[start + valIdx], vals[valIdx]))
+            {
+                isMatching_ = false;
+                return;
+            }
+        }
+    }
+
+    void NativeDecoder::finishValidation(size_t numValidated)
+    {
+        if (plan_ == nullptr || plan_->state != State::Unvalidated) return;
+
+        if (isMatching_)
+        {
+            if (numValidated == numSubsets()) plan_->state = State::Trusted;
+            return;
+        }
+
+        reject();
+    }
+
+    void NativeDecoder::reject()
+    {
+        // The delayed replication factors are 8 bits wide unless the tables use the 16 bit
+        // descriptor, so that is the one other width worth trying.
+        if (plan_->hasDelayedRep && plan_->factorBits == 8)
+        {
+            plan_->factorBits = 16;
+            return;
+        }
+
+        plan_->state = State::Unsupported;
+    }
+
+    NativeDecoder::Plan& NativeDecoder::planFor(const DataProvider& provider,
+                                                const std::shared_ptr<TableData>& tableData)
+    {
+        auto& plan = plans_[provider.getSubsetVariant()];
+        if (plan.tableData == tableData) return plan;
+
+        plan = Plan();
+        plan.tableData = tableData;
+        if (!compile(provider, static_cast<int>(provider.getInode()), plan))
+        {
+            plan.state = State::Unsupported;
+        }
+
+        plan.structuralVals.assign(plan.elements.size(), 0);
+        plan.isLearned.assign(plan.elements.size(), false);
+        return plan;
+    }
+
+    bool NativeDecoder::compile(const DataProvider& provider, int nodeIdx, Plan& plan) const
+    {
+        const auto elementIdx = plan.elements.size();
+        plan.elements.emplace_back();
+
+        Element element;
+        element.nodeIdx = nodeIdx;
+
+        const auto typ = provider.getTyp(nodeIdx);
+        const auto itp = provider.getItp(nodeIdx);
+        bool isContainer = true;
+        switch (typ)
+        {
+            case Typ::Number:
+            case Typ::Character:
+            {
+                const auto info = provider.getTypeInfo(nodeIdx);
+                if (info.bits <= 0 || info.bits > 64) return false;
+
+                if (typ == Typ::Character)
+                {
+                    // Long strings are read by mnemonic through NCEPLIB-bufr (see readlc).
+                    if (itp != 3 || info.bits % 8 != 0) return false;
+                    element.kind = Kind::Character;
+                }
+                else
+                {
+                    if (itp != 2) return false;
+                    element.kind = Kind::Number;
+                    element.reference = info.reference;
+                    element.scaleFactor = std::pow(10.0, -info.scale);
+                }
+
+                element.bits = info.bits;
+                isContainer = false;
+                break;
+            }
+            case Typ::DelayedRep:
+            case Typ::DelayedRepStacked:
+                if (itp != 1) return false;
+                element.kind = Kind::DelayedRep;
+                plan.hasDelayedRep = true;
+                break;
+            case Typ::DelayedBinary:
+                if (itp != 1) return false;
+                element.kind = Kind::DelayedBinary;
+                element.bits = 1;
+                break;
+            case Typ::FixedRep:
+                element.kind = Kind::FixedRep;
+                element.fixedCount = provider.getIrf(nodeIdx);
+                break;
+            case Typ::Subset:
+            case Typ::Sequence:
+            case Typ::Repeat:
+            case Typ::StackedRepeat:
+                if (itp != 0) return false;
+                element.kind = Kind::Structural;
+                break;
+        }
+
+        if (isContainer)
+        {
+            // The children follow their parent in the table (see SubsetTable).
+            auto lastNode = static_cast<int>(provider.getLink(nodeIdx)) - 1;
+            if (lastNode == -1) lastNode = static_cast<int>(provider.getIsc(provider.getInode()));
+
+            auto childIdx = nodeIdx + 1;
+            while (childIdx != 0 && childIdx <= lastNode)
+            {
+                if (!compile(provider, childIdx, plan)) return false;
+                childIdx = static_cast<int>(provider.getLink(childIdx));
+            }
+        }
+
+        element.end = plan.elements.size();
+        plan.elements[elementIdx] = element;
+        return true;
+    }
+
+    bool NativeDecoder::decodeSubsets(size_t numSubsets, bool isValidating)
+    {
+        for (size_t subsetIdx = 0; subsetIdx < numSubsets; ++subsetIdx)
+        {
+            if (!decodeElements(0, plan_->elements.size(), vals_.size(), isValidating))
+            {
+                return false;
+            }
+
+            subsetStarts_.push_back(vals_.size());
+        }
+
+        return true;
+    }
+
+    bool NativeDecoder::decodeElements(size_t begin,
+                                       size_t end,
+                                       size_t subsetStart,
+                                       bool isValidating)
+    {
+        size_t elementIdx = begin;
+        while (elementIdx < end)
+        {
+            const auto& element = plan_->elements[elementIdx];
+            if (vals_.size() - subsetStart >= MaxSubsetValues) return false;
+
+            invs_.push_back(element.nodeIdx);
+            if (isValidating) elementIdxs_.push_back(static_cast<unsigned int>(elementIdx));
+
+            std::uint64_t raw = 0;
+            switch (element.kind)
+            {
+                case Kind::Structural:
+                {
+                    double value;
+                    if (!structuralVal(elementIdx, isValidating, value)) return false;
+                    vals_.push_back(value);
+                    elementIdx++;
+                    break;
+                }
+                case Kind::Number:
+                {
+                    if (!readBits(element.bits, raw)) return false;
+
+                    const auto allOnes = allOnesFor(element.bits);
+                    vals_.push_back(raw == allOnes
+                        ? MissingOctetValue
+                        : static_cast<double>(static_cast<std::int64_t>(raw) + element.reference)
+                              * element.scaleFactor);
+                    elementIdx++;
+                    break;
+                }
+                case Kind::Character:
+                {
+                    double value;
+                    if (!readChars(static_cast<size_t>(element.bits / 8), value)) return false;
+                    vals_.push_back(value);
+                    elementIdx++;
+                    break;
+                }
+                case Kind::DelayedRep:
+                case Kind::DelayedBinary:
+                case Kind::FixedRep:
+                {
+                    size_t count = element.fixedCount;
+                    if (element.kind == Kind::FixedRep)
+                    {
+                        double value;
+                        if (!structuralVal(elementIdx, isValidating, value)) return false;
+                        vals_.push_back(value);
+                    }
+                    else
+                    {
+                        const int bits = element.kind == Kind::DelayedBinary ? element.bits
+                                                                             : plan_->factorBits;
+                        if (!readBits(bits, raw)) return false;
+                        if (bits > 1 && raw == allOnesFor(bits)) return false;
+
+                        count = static_cast<size_t>(raw);
+                        vals_.push_back(static_cast<double>(count));
+                    }
+
+                    for (size_t repIdx = 0; repIdx < count; ++repIdx)
+                    {
+                        if (!decodeElements(elementIdx + 1, element.end, subsetStart, isValidating))
+                        {
+                            return false;
+                        }
+                    }
+
+                    elementIdx = element.end;
+                    break;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool NativeDecoder::decodeCompressed(size_t numSubsets, bool isValidating)
+    {
+        if (numSubsets == 0) return false;
+
+        columns_.clear();
+        templateInvs_.clear();
+        templateElementIdxs_.clear();
+        if (!decodeCompressedElements(0, plan_->elements.size(), numSubsets, isValidating))
+        {
+            return false;
+        }
+
+        // All the subsets share the template, so lay the columns out subset by subset.
+        const size_t numVals = templateInvs_.size();
+        vals_.resize(numSubsets * numVals);
+        invs_.resize(numSubsets * numVals);
+        if (isValidating) elementIdxs_.resize(numSubsets * numVals);
+
+        for (size_t subsetIdx = 0; subsetIdx < numSubsets; ++subsetIdx)
+        {
+            const size_t start = subsetIdx * numVals;
+            for (size_t valIdx = 0; valIdx < numVals; ++valIdx)
+            {
+                vals_[start + valIdx] = columns_[valIdx * numSubsets + subsetIdx];
+            }
+
+            std::copy(templateInvs_.begin(), templateInvs_.end(), invs_.begin() + start);
+            if (isValidating)
+            {
+                std::copy(templateElementIdxs_.begin(),
+                          templateElementIdxs_.end(),
+                          elementIdxs_.begin() + start);
+            }
+
+            subsetStarts_.push_back(start + numVals);
+        }
+
+        return true;
+    }
+
+    bool NativeDecoder::decodeCompressedElements(size_t begin,
+                                                 size_t end,
+                                                 size_t numSubsets,
+                                                 bool isValidating)
+    {
+        size_t elementIdx = begin;
+        while (elementIdx < end)
+        {
+            const auto& element = plan_->elements[elementIdx];
+            if (templateInvs_.size() >= MaxSubsetValues) return false;
+
+            templateInvs_.push_back(element.nodeIdx);
+            if (isValidating) templateElementIdxs_.push_back(static_cast<unsigned int>(elementIdx));
+
+            std::uint64_t base = 0;
+            std::uint64_t incrementBits = 0;
+            std::uint64_t increment = 0;
+            switch (element.kind)
+            {
+                case Kind::Structural:
+                {
+                    double value;
+                    if (!structuralVal(elementIdx, isValidating, value)) return false;
+                    columns_.insert(columns_.end(), numSubsets, value);
+                    elementIdx++;
+                    break;
+                }
+                case Kind::Number:
+                {
+                    // The reference value of the subsets, then the width of their increments.
+                    if (!readBits(element.bits, base)) return false;
+                    if (!readBits(IncrementWidthBits, incrementBits)) return false;
+
+                    const auto allOnes = allOnesFor(element.bits);
+                    if (incrementBits == 0)
+                    {
+                        const double value = base == allOnes
+                            ? MissingOctetValue
+                            : static_cast<double>(static_cast<std::int64_t>(base) +
+                                                  element.reference) * element.scaleFactor;
+                        columns_.insert(columns_.end(), numSubsets, value);
+                    }
+                    else
+                    {
+                        const auto incrementOnes = allOnesFor(static_cast<int>(incrementBits));
+                        for (size_t subsetIdx = 0; subsetIdx < numSubsets; ++subsetIdx)
+                        {
+                            if (!readBits(static_cast<int>(incrementBits), increment)) return false;
+                            columns_.push_back(increment == incrementOnes
+                                ? MissingOctetValue
+                                : static_cast<double>(static_cast<std::int64_t>(base + increment) +
+                                                      element.reference) * element.scaleFactor);
+                        }
+                    }
+
+                    elementIdx++;
+                    break;
+                }
+                case Kind::Character:
+                {
+                    // The common characters, then the number of characters of every subset.
+                    const auto numChars = static_cast<size_t>(element.bits / 8);
+                    double value;
+                    if (!readChars(numChars, value)) return false;
+                    if (!readBits(IncrementWidthBits, incrementBits)) return false;
+
+                    if (incrementBits == 0)
+                    {
+                        columns_.insert(columns_.end(), numSubsets, value);
+                    }
+                    else
+                    {
+                        if (incrementBits != numChars) return false;
+                        for (size_t subsetIdx = 0; subsetIdx < numSubsets; ++subsetIdx)
+                        {
+                            if (!readChars(numChars, value)) return false;
+                            columns_.push_back(value);
+                        }
+                    }
+
+                    elementIdx++;
+                    break;
+                }
+                case Kind::DelayedRep:
+                case Kind::DelayedBinary:
+                case Kind::FixedRep:
+                {
+                    size_t count = element.fixedCount;
+                    if (element.kind == Kind::FixedRep)
+                    {
+                        double value;
+                        if (!structuralVal(elementIdx, isValidating, value)) return false;
+                        columns_.insert(columns_.end(), numSubsets, value);
+                    }
+                    else
+                    {
+                        // The subsets of compressed messages all have the same replications.
+                        const int bits = element.kind == Kind::DelayedBinary ? element.bits
+                                                                             : plan_->factorBits;
+                        if (!readBits(bits, base)) return false;
+                        if (!readBits(IncrementWidthBits, incrementBits)) return false;
+                        if (incrementBits != 0) return false;
+                        if (bits > 1 && base == allOnesFor(bits)) return false;
+
+                        count = static_cast<size_t>(base);
+                        columns_.insert(columns_.end(), numSubsets, static_cast<double>(count));
+                    }
+
+                    for (size_t repIdx = 0; repIdx < count; ++repIdx)
+                    {
+                        if (!decodeCompressedElements(elementIdx + 1,
+                                                      element.end,
+                                                      numSubsets,
+                                                      isValidating))
+                        {
+                            return false;
+                        }
+                    }
+
+                    elementIdx = element.end;
+                    break;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool NativeDecoder::structuralVal(size_t elementIdx, bool isValidating, double& value) const
+    {
+        if (plan_->isLearned[elementIdx])
+        {
+            value = plan_->structuralVals[elementIdx];
+            return true;
+        }
+
+        // Learned from NCEPLIB-bufr while validating.
+        value = 0;
+        return isValidating;
+    }
+
+    bool NativeDecoder::readBits(int numBits, std::uint64_t& value)
+    {
+        if (numBits == 0)
+        {
+            value = 0;
+            return true;
+        }
+
+        if (bitPos_ + static_cast<size_t>(numBits) > numBits_) return false;
+
+        // Up to 57 bits fit in the 8 bytes starting at the current byte. Wider values are read
+        // in two parts.
+        if (numBits > 57)
+        {
+            std::uint64_t high;
+            std::uint64_t low;
+            readBits(numBits - 32, high);
+            readBits(32, low);
+            value = (high << 32) | low;
+            return true;
+        }
+
+        const unsigned char* bytes = section_.data() + bitPos_ / 8;
+        std::uint64_t word = 0;
+        for (size_t byteIdx = 0; byteIdx < 8; ++byteIdx)
+        {
+            word = (word << 8) | bytes[byteIdx];
+        }
+
+        value = (word << (bitPos_ % 8)) >> (64 - numBits);
+        bitPos_ += static_cast<size_t>(numBits);
+        return true;
+    }
+
+    bool NativeDecoder::readChars(size_t numChars, double& value)
+    {
+        char chars[sizeof(double)];
+        std::memset(chars, ' ', sizeof(chars));
+
+        std::uint64_t raw;
+        for (size_t charIdx = 0; charIdx < numChars; ++charIdx)
+        {
+            if (!readBits(8, raw)) return false;
+            chars[charIdx] = static_cast<char>(raw);
+        }
+
+        std::memcpy(&value, chars, sizeof(double));
+        return true;
+    }
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,192 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <gsl/gsl-lite.hpp>
+
+#include "SubsetVariant.h"
+
+
+namespace Ingester {
+namespace bufr {
+    class DataProvider;
+    struct TableData;
+
+    /// \brief Decodes the data section (section 4) of BUFR messages without NCEPLIB-bufr, into
+    ///        the same val/inv arrays NCEPLIB-bufr would have made (see DataProvider::getVals).
+    ///        The subset template is compiled once per subset variant from the table data.
+    ///
+    ///        Templates the decoder can't handle (long strings, unknown element types) are left
+    ///        to NCEPLIB-bufr. The first message of every template is decoded both ways and
+    ///        compared, and the decoder is only trusted with the template if they are the same
+    ///        (otherwise NCEPLIB-bufr keeps decoding it). Both standard and compressed messages
+    ///        are supported.
+    class NativeDecoder
+    {
+     public:
+        enum class Result
+        {
+            Decoded,     // The subsets are decoded (see vals and invs)
+            Validate,    // Decoded, but NCEPLIB-bufr has to decode the message too (see validate)
+            Unsupported  // NCEPLIB-bufr has to decode the message
+        };
+
+        /// \brief Decode the subsets of a message.
+        /// \param provider The provider the message is loaded in (for the table accessors, valid
+        ///                 while it runs).
+        /// \param tableData The table data of the current subset variant.
+        /// \param msg The bytes of the message.
+        /// \param size The number of bytes available at msg (at least the message length).
+        Result decode(const DataProvider& provider,
+                      const std::shared_ptr<TableData>& tableData,
+                      const unsigned char* msg,
+                      size_t size);
+
+        /// \brief The number of subsets in the decoded message.
+        size_t numSubsets() const { return subsetStarts_.size() - 1; }
+
+        /// \brief The values of a decoded subset.
+        gsl::span<const double> vals(size_t subsetIdx) const
+        {
+            return gsl::span<const double>(vals_.data() + subsetStarts_[subsetIdx],
+                                           subsetStarts_[subsetIdx + 1] -
+                                               subsetStarts_[subsetIdx]);
+        }
+
+        /// \brief The table node ids of the values of a decoded subset.
+        gsl::span<const int> invs(size_t subsetIdx) const
+        {
+            return gsl::span<const int>(invs_.data() + subsetStarts_[subsetIdx],
+                                        subsetStarts_[subsetIdx + 1] - subsetStarts_[subsetIdx]);
+        }
+
+        /// \brief Compare a subset decoded by NCEPLIB-bufr with ours (after decode returned
+        ///        Validate).
+        /// \param subsetIdx The index of the subset in the message.
+        /// \param vals The values NCEPLIB-bufr decoded.
+        /// \param invs The table node ids NCEPLIB-bufr decoded.
+        /// \param numVals The number of values in the subset.
+        void validate(size_t subsetIdx,
+                      gsl::span<const double> vals,
+                      gsl::span<const int> invs,
+                      size_t numVals);
+
+        /// \brief Conclude the validation of a message.
+        /// \param numValidated The number of subsets given to validate (if it isn't all of them
+        ///                     the next message of the template is validated instead).
+        void finishValidation(size_t numValidated);
+
+     private:
+        enum class Kind
+        {
+            Structural,     // Subset, sequence or the repeated sequence of a replication
+            Number,
+            Character,
+            DelayedRep,     // The delayed replication factor is in the data
+            DelayedBinary,  // 1 bit delayed replication (for optional sequences)
+            FixedRep
+        };
+
+        /// \brief A node of the subset template. The nodes are in table order, so the elements
+        ///        a replication repeats are the ones up to end.
+        struct Element
+        {
+            int nodeIdx = 0;
+            Kind kind = Kind::Structural;
+            int bits = 0;
+            int reference = 0;
+            double scaleFactor = 1;
+            size_t fixedCount = 0;
+            size_t end = 0;
+        };
+
+        enum class State
+        {
+            Unvalidated,
+            Trusted,
+            Unsupported
+        };
+
+        /// \brief The compiled template of a subset variant.
+        struct Plan
+        {
+            std::shared_ptr<TableData> tableData;
+            std::vector<Element> elements;
+            State state = State::Unvalidated;
+            bool hasDelayedRep = false;
+            int factorBits = 8;  // Width of the (non binary) delayed replication factors
+
+            // NCEPLIB-bufr keeps a value for the structural nodes too. They are constant, so
+            // they are taken from the validated messages.
+            std::vector<double> structuralVals;
+            std::vector<bool> isLearned;
+        };
+
+        std::unordered_map<SubsetVariant, Plan> plans_;
+        Plan* plan_ = nullptr;  // Of the current message
+        bool isMatching_ = false;  // Did the validated subsets match so far
+
+        std::vector<double> vals_;
+        std::vector<int> invs_;
+        std::vector<unsigned int> elementIdxs_;  // The element of every value (validation only)
+        std::vector<size_t> subsetStarts_ = {0};
+
+        // Compressed messages are decoded one element at a time for all the subsets.
+        std::vector<double> columns_;
+        std::vector<int> templateInvs_;
+        std::vector<unsigned int> templateElementIdxs_;
+
+        std::vector<unsigned char> section_;  // Section 4 data (padded for the bit reader)
+        size_t numBits_ = 0;
+        size_t bitPos_ = 0;
+
+        /// \brief The current plan didn't decode like NCEPLIB-bufr. Try the other delayed
+        ///        replication factor width, or leave the template to NCEPLIB-bufr.
+        void reject();
+
+        /// \brief Get the plan for the subset variant of the current message.
+        Plan& planFor(const DataProvider& provider, const std::shared_ptr<TableData>& tableData);
+
+        /// \brief Add the elements for a table node (and its children) to a plan.
+        /// \return false if the node can't be decoded natively.
+        bool compile(const DataProvider& provider, int nodeIdx, Plan& plan) const;
+
+        /// \brief Decode the standard (uncompressed) message subsets.
+        bool decodeSubsets(size_t numSubsets, bool isValidating);
+
+        /// \brief Decode the elements [begin, end) of one subset.
+        bool decodeElements(size_t begin, size_t end, size_t subsetStart, bool isValidating);
+
+        /// \brief Decode the subsets of a compressed message.
+        bool decodeCompressed(size_t numSubsets, bool isValidating);
+
+        /// \brief Decode the elements [begin, end) for all the subsets of a compressed message.
+        bool decodeCompressedElements(size_t begin,
+                                      size_t end,
+                                      size_t numSubsets,
+                                      bool isValidating);
+
+        /// \brief Get the value to use for a structural element.
+        /// \return false if it isn't known yet (and we aren't validating).
+        bool structuralVal(size_t elementIdx, bool isValidating, double& value) const;
+
+        /// \brief Read the next bits of the data section (most significant bit first).
+        /// \return false if that goes past the end of the section.
+        bool readBits(int numBits, std::uint64_t& value);
+
+        /// \brief Read characters from the data section into the 8 bytes of a double, padded with
+        ///        spaces (the way NCEPLIB-bufr keeps short strings).
+        bool readChars(size_t numChars, double& value);
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -21,9 +21,14 @@ namespace bufr {
 
     void NcepDataProvider::open()
     {
-        open_f(FileUnit, filePath_.c_str());
-        openbf_f(FileUnit, "IN", FileUnit);
+        std::lock_guard<std::recursive_mutex> lock(fortranMutex());
 
+        open_f(fileUnit_, openPath());
+
+        // Otherwise the DX tables are loaded from the messages as they are read.
+        openbf_f(fileUnit_, readsFromFile() ? "IN" : "INUL", fileUnit_);
+
+        resetMessagePosition();
         isOpen_ = true;
     }
 
@@ -69,6 +74,8 @@ namespace bufr {
             get_irf_f(&intPtr, &size);
             currentTableData_->irf = std::vector<int>(intPtr, intPtr + size);
         }
+
+        updateVariantIndex();
     }
 
     size_t NcepDataProvider::variantId() const
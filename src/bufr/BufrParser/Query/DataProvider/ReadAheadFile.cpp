@@ -0,0 +1,276 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "ReadAheadFile.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <utility>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "../Profiler.h"
+
+
+namespace
+{
+    const size_t Alignment = 4096;
+    const size_t ChunkSize = 1 << 23;
+    const size_t Headroom = 1 << 20;
+    const size_t NumChunks = 4;
+
+    const size_t Section0Size = 8;
+    const size_t EndSectionSize = 4;
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    ReadAheadFile::Chunk::Chunk() :
+        data(nullptr, std::free)
+    {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, Alignment, Headroom + ChunkSize) != 0) throw std::bad_alloc();
+        data.reset(static_cast<unsigned char*>(ptr));
+    }
+
+    ReadAheadFile::ReadAheadFile(const std::string& filePath) :
+        filePath_(filePath)
+    {
+        fd_ = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't open the BUFR file " << filePath << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        // Only a hint (it lets the kernel read further ahead and drop the pages behind us).
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        for (size_t chunkIdx = 0; chunkIdx < NumChunks; chunkIdx++)
+        {
+            freeChunks_.push_back(std::make_unique<Chunk>());
+        }
+
+        thread_ = std::thread(&ReadAheadFile::readFile, this);
+    }
+
+    ReadAheadFile::~ReadAheadFile()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+
+        chunkFreed_.notify_all();
+        thread_.join();
+        ::close(fd_);
+    }
+
+    bool ReadAheadFile::nextMessage(const unsigned char*& msg,
+                                    size_t& length,
+                                    std::uint64_t& offset)
+    {
+        const unsigned char marker[] = {'B', 'U', 'F', 'R'};
+        const auto skipTo = [this](const unsigned char* pos)
+        {
+            beginOffset_ += static_cast<std::uint64_t>(pos - begin_);
+            begin_ = pos;
+        };
+
+        while (true)
+        {
+            const auto found = std::search(begin_, end_, marker, marker + 4);
+            if (found == end_)
+            {
+                // Keep the tail in case the marker is split across chunks.
+                if (end_ - begin_ > 3) skipTo(end_ - 3);
+                if (!fill()) return false;
+                continue;
+            }
+
+            skipTo(found);
+            const auto available = static_cast<size_t>(end_ - begin_);
+            if (available < Section0Size)
+            {
+                if (!fill()) return false;
+                continue;
+            }
+
+            length = (static_cast<size_t>(begin_[4]) << 16) |
+                     (static_cast<size_t>(begin_[5]) << 8) |
+                     static_cast<size_t>(begin_[6]);
+            const auto edition = begin_[7];
+
+            // Skip anything that isn't a complete BUFR message (or one we can't handle).
+            if (edition < 2 || edition > 4 || length < Section0Size + EndSectionSize)
+            {
+                skipTo(begin_ + 4);
+                continue;
+            }
+
+            if (available < length)
+            {
+                if (!fill()) skipTo(begin_ + 4);
+                continue;
+            }
+
+            if (std::memcmp(begin_ + length - EndSectionSize, "7777", EndSectionSize) != 0)
+            {
+                skipTo(begin_ + 4);
+                continue;
+            }
+
+            msg = begin_;
+            offset = beginOffset_;
+            skipTo(begin_ + length);
+            return true;
+        }
+    }
+
+    void ReadAheadFile::readFile()
+    {
+        try
+        {
+            std::uint64_t offset = 0;
+            while (true)
+            {
+                std::unique_ptr<Chunk> chunk;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    chunkFreed_.wait(lock, [this]() { return stop_ || !freeChunks_.empty(); });
+                    if (stop_) break;
+
+                    chunk = std::move(freeChunks_.back());
+                    freeChunks_.pop_back();
+                }
+
+                // Have the kernel start on the next chunk while we read this one.
+                posix_fadvise(fd_,
+                              static_cast<off_t>(offset + ChunkSize),
+                              static_cast<off_t>(ChunkSize),
+                              POSIX_FADV_WILLNEED);
+
+                size_t size = 0;
+                {
+                    ScopedTimer timer("io.read");
+                    while (size < ChunkSize)
+                    {
+                        const auto numRead = pread(fd_,
+                                                   chunk->data.get() + Headroom + size,
+                                                   ChunkSize - size,
+                                                   static_cast<off_t>(offset + size));
+                        if (numRead < 0 && errno == EINTR) continue;
+                        if (numRead < 0)
+                        {
+                            std::ostringstream errStr;
+                            errStr << "Couldn't read the BUFR file " << filePath_ << " (";
+                            errStr << std::strerror(errno) << ").";
+                            throw eckit::BadValue(errStr.str());
+                        }
+
+                        if (numRead == 0) break;
+                        size += static_cast<size_t>(numRead);
+                    }
+                }
+
+                Profiler::count("io.bytes", size);
+                if (size == 0) break;
+
+                chunk->size = size;
+                chunk->offset = offset;
+                offset += size;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    readChunks_.push_back(std::move(chunk));
+                }
+
+                chunkRead_.notify_one();
+
+                if (size < ChunkSize) break;
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+
+        chunkRead_.notify_all();
+    }
+
+    bool ReadAheadFile::fill()
+    {
+        std::unique_ptr<Chunk> next;
+        {
+            ScopedTimer timer("io.wait");
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            chunkRead_.wait(lock, [this]() { return done_ || !readChunks_.empty(); });
+
+            if (readChunks_.empty())
+            {
+                if (error_) std::rethrow_exception(error_);
+                return false;
+            }
+
+            next = std::move(readChunks_.front());
+            readChunks_.pop_front();
+        }
+
+        // The bytes that are left are the start of a message, which are nearly always small
+        // enough to go in front of the next chunk.
+        const auto tail = static_cast<size_t>(end_ - begin_);
+        const auto nextBytes = next->data.get() + Headroom;
+        if (tail <= Headroom)
+        {
+            if (tail > 0) std::memcpy(nextBytes - tail, begin_, tail);
+            std::vector<unsigned char>().swap(spill_);
+
+            begin_ = nextBytes - tail;
+            end_ = nextBytes + next->size;
+        }
+        else
+        {
+            std::vector<unsigned char> spill;
+            spill.reserve(tail + next->size);
+            spill.insert(spill.end(), begin_, end_);
+            spill.insert(spill.end(), nextBytes, nextBytes + next->size);
+            spill_ = std::move(spill);
+
+            begin_ = spill_.data();
+            end_ = spill_.data() + spill_.size();
+        }
+
+        beginOffset_ = next->offset - tail;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (current_) freeChunks_.push_back(std::move(current_));
+            if (!spill_.empty()) freeChunks_.push_back(std::move(next));
+        }
+
+        chunkFreed_.notify_one();
+
+        current_ = std::move(next);
+        return true;
+    }
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,97 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Reads the BUFR messages of a local (uncompressed) file through large, page aligned
+    ///        buffers that a background thread fills ahead of the decoder, so the reads overlap
+    ///        the decoding instead of NCEPLIB-bufr waiting on small sequential reads (slow on
+    ///        parallel file systems like Lustre or GPFS). The kernel is told the file is read
+    ///        sequentially (posix_fadvise) and the chunk after the one being read is asked for
+    ///        early.
+    ///
+    ///        The bytes read, the time spent reading and the time the decoder had to wait for
+    ///        the reads go to the Profiler ("io.bytes", "io.read" and "io.wait"), so the I/O wait
+    ///        and the read throughput of each run are in its profile.
+    class ReadAheadFile
+    {
+     public:
+        /// \brief Constructor. Starts reading the file.
+        /// \param filePath Path to the BUFR file.
+        explicit ReadAheadFile(const std::string& filePath);
+
+        ~ReadAheadFile();
+
+        ReadAheadFile(const ReadAheadFile&) = delete;
+        ReadAheadFile& operator=(const ReadAheadFile&) = delete;
+
+        /// \brief Get the next (complete) BUFR message.
+        /// \param msg Set to the bytes of the message. They stay valid until the next call.
+        /// \param length Set to the length of the message in bytes.
+        /// \param offset Set to the offset of the message in the file.
+        /// \return false once there are no more messages.
+        bool nextMessage(const unsigned char*& msg, size_t& length, std::uint64_t& offset);
+
+     private:
+        /// \brief A page aligned buffer with room in front of the bytes read into it, where the
+        ///        start of a message that didn't fit in the buffer before is copied.
+        struct Chunk
+        {
+            std::unique_ptr<unsigned char, void(*)(void*)> data;
+            size_t size = 0;  // Bytes read (after the headroom)
+            std::uint64_t offset = 0;  // Offset of the bytes read in the file
+
+            Chunk();
+        };
+
+        const std::string filePath_;
+        int fd_ = -1;
+
+        // Chunks handed between the read thread and the reader
+        std::mutex mutex_;
+        std::condition_variable chunkRead_;
+        std::condition_variable chunkFreed_;
+        std::deque<std::unique_ptr<Chunk>> readChunks_;
+        std::vector<std::unique_ptr<Chunk>> freeChunks_;
+        bool done_ = false;
+        bool stop_ = false;
+        std::exception_ptr error_;
+        std::thread thread_;
+
+        // The bytes that haven't been read yet (only touched by the reader). They are in the
+        // current chunk, or in spill_ when they didn't fit in the headroom of the next chunk.
+        std::unique_ptr<Chunk> current_;
+        std::vector<unsigned char> spill_;
+        const unsigned char* begin_ = nullptr;
+        const unsigned char* end_ = nullptr;
+        std::uint64_t beginOffset_ = 0;  // Offset of begin_ in the file
+
+        /// \brief Read the file into chunks (runs on thread_).
+        void readFile();
+
+        /// \brief Move on to the next chunk, keeping the bytes that haven't been read yet in
+        ///        front of it.
+        /// \return false once the whole file has been read.
+        bool fill();
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,300 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "RemoteFile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#ifdef BUFR_HAS_CURL
+    #include <curl/curl.h>
+#endif
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    const char* S3Scheme = "s3://";
+    const char* RemoteSchemes[] = {"s3://", "http://", "https://"};
+
+    bool startsWith(const std::string& str, const char* prefix)
+    {
+        return str.compare(0, std::strlen(prefix), prefix) == 0;
+    }
+
+    /// \brief Turn an s3:// path into the https:// URL of the object.
+    std::string urlFor(const std::string& path)
+    {
+        if (!startsWith(path, S3Scheme)) return path;
+
+        const auto bucketAndKey = path.substr(std::strlen(S3Scheme));
+        const auto keyPos = bucketAndKey.find('/');
+        if (keyPos == std::string::npos || keyPos == 0)
+        {
+            std::ostringstream errStr;
+            errStr << "The S3 path " << path << " should look like s3://<bucket>/<key>.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const auto bucket = bucketAndKey.substr(0, keyPos);
+        const auto key = bucketAndKey.substr(keyPos + 1);
+
+        const char* endpoint = std::getenv("AWS_ENDPOINT_URL");
+        if (endpoint != nullptr && endpoint[0] != '\0')
+        {
+            std::string endpointUrl(endpoint);
+            if (endpointUrl.back() == '/') endpointUrl.pop_back();
+            return endpointUrl + "/" + bucket + "/" + key;
+        }
+
+        return "https://" + bucket + ".s3.amazonaws.com/" + key;
+    }
+
+#ifdef BUFR_HAS_CURL
+    size_t appendBody(char* data, size_t size, size_t count, void* body)
+    {
+        static_cast<std::string*>(body)->append(data, size * count);
+        return size * count;
+    }
+
+    /// \brief A curl handle for one request.
+    class Request
+    {
+     public:
+        explicit Request(const std::string& url)
+        {
+            static std::once_flag initFlag;
+            std::call_once(initFlag, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+            curl_ = curl_easy_init();
+            if (curl_ == nullptr)
+            {
+                throw eckit::BadValue("Couldn't create a curl handle.");
+            }
+
+            curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl_, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+        }
+
+        ~Request() { curl_easy_cleanup(curl_); }
+
+        CURL* handle() { return curl_; }
+
+        /// \brief Run the request.
+        /// \return The HTTP response code.
+        std::int64_t perform(const std::string& url)
+        {
+            const auto result = curl_easy_perform(curl_);
+            if (result != CURLE_OK)
+            {
+                std::ostringstream errStr;
+                errStr << "Request for " << url << " failed: " << curl_easy_strerror(result);
+                throw eckit::BadValue(errStr.str());
+            }
+
+            // curl writes a long into it.
+            static_assert(sizeof(std::int64_t) == sizeof(0L), "The response code is a long.");
+            std::int64_t responseCode = 0;
+            curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &responseCode);
+            return responseCode;
+        }
+
+     private:
+        CURL* curl_;
+    };
+#endif
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    RemoteFile::RemoteFile(const std::string& path,
+                           size_t blockSize,
+                           size_t readAhead,
+                           size_t maxBlocks) :
+        path_(path),
+        url_(urlFor(path)),
+        blockSize_(std::max<size_t>(blockSize, 1)),
+        readAhead_(readAhead),
+        maxBlocks_(std::max<size_t>(maxBlocks, readAhead + 1))
+    {
+#ifndef BUFR_HAS_CURL
+        std::ostringstream errStr;
+        errStr << "Can't read " << path << ". Remote BUFR files need libcurl, which wasn't ";
+        errStr << "available when the converters were built.";
+        throw eckit::BadParameter(errStr.str());
+#endif
+    }
+
+    bool RemoteFile::isRemote(const std::string& path)
+    {
+        for (const auto& scheme : RemoteSchemes)
+        {
+            if (startsWith(path, scheme)) return true;
+        }
+
+        return false;
+    }
+
+    std::uint64_t RemoteFile::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sizeLocked();
+    }
+
+    std::uint64_t RemoteFile::sizeLocked() const
+    {
+        if (!hasSize_)
+        {
+            size_ = fetchSize();
+            hasSize_ = true;
+        }
+
+        return size_;
+    }
+
+    void RemoteFile::read(std::uint64_t offset, size_t length, void* dst) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (offset + length > sizeLocked())
+        {
+            std::ostringstream errStr;
+            errStr << "Tried to read past the end of " << path_ << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        auto out = static_cast<char*>(dst);
+        while (length > 0)
+        {
+            const auto blockIdx = offset / blockSize_;
+            const auto blockOffset = static_cast<size_t>(offset % blockSize_);
+            const auto& data = block(blockIdx);
+
+            const auto numBytes = std::min(length, data.size() - blockOffset);
+            std::memcpy(out, data.data() + blockOffset, numBytes);
+
+            out += numBytes;
+            offset += numBytes;
+            length -= numBytes;
+        }
+    }
+
+    std::shared_ptr<const MessageBuffer> RemoteFile::readAll() const
+    {
+        const auto bytes = std::make_shared<std::string>(fetch(0, size()));
+        return std::make_shared<MessageBuffer>(bytes->data(), bytes->size(), bytes);
+    }
+
+    const RemoteFile::Block& RemoteFile::block(std::uint64_t blockIdx) const
+    {
+        auto blockIt = blocks_.find(blockIdx);
+        if (blockIt != blocks_.end())
+        {
+            recentBlocks_.splice(recentBlocks_.begin(), recentBlocks_, blockIt->second.second);
+            return blockIt->second.first;
+        }
+
+        // Fetch the block along with the next (missing) ones in one request.
+        const auto numBlocks = (sizeLocked() + blockSize_ - 1) / blockSize_;
+        auto lastIdx = blockIdx;
+        while (lastIdx + 1 < numBlocks &&
+               lastIdx - blockIdx < readAhead_ &&
+               blocks_.find(lastIdx + 1) == blocks_.end())
+        {
+            lastIdx++;
+        }
+
+        const auto begin = blockIdx * blockSize_;
+        const auto end = std::min<std::uint64_t>((lastIdx + 1) * blockSize_, sizeLocked());
+        const auto bytes = fetch(begin, end);
+
+        for (auto idx = blockIdx; idx <= lastIdx; idx++)
+        {
+            const auto blockBegin = static_cast<size_t>((idx - blockIdx) * blockSize_);
+            const auto blockEnd = std::min(blockBegin + blockSize_, bytes.size());
+
+            recentBlocks_.push_front(idx);
+            blocks_[idx] = {Block(bytes.begin() + blockBegin, bytes.begin() + blockEnd),
+                            recentBlocks_.begin()};
+        }
+
+        while (blocks_.size() > maxBlocks_)
+        {
+            blocks_.erase(recentBlocks_.back());
+            recentBlocks_.pop_back();
+        }
+
+        // The read ahead blocks went in front of the one we need, so put it back on top.
+        blockIt = blocks_.find(blockIdx);
+        recentBlocks_.splice(recentBlocks_.begin(), recentBlocks_, blockIt->second.second);
+        return blockIt->second.first;
+    }
+
+    std::string RemoteFile::fetch(std::uint64_t begin, std::uint64_t end) const
+    {
+        std::string body;
+        if (end <= begin) return body;
+
+#ifdef BUFR_HAS_CURL
+        std::ostringstream range;
+        range << begin << "-" << (end - 1);
+
+        Request request(url_);
+        curl_easy_setopt(request.handle(), CURLOPT_RANGE, range.str().c_str());
+        curl_easy_setopt(request.handle(), CURLOPT_WRITEFUNCTION, &appendBody);
+        curl_easy_setopt(request.handle(), CURLOPT_WRITEDATA, &body);
+        const auto responseCode = request.perform(url_);
+
+        // Servers that don't do ranges send the whole file.
+        if (responseCode == 200 && body.size() > end - begin)
+        {
+            body = body.substr(static_cast<size_t>(begin), static_cast<size_t>(end - begin));
+        }
+#endif
+
+        if (body.size() != end - begin)
+        {
+            std::ostringstream errStr;
+            errStr << "Got " << body.size() << " bytes instead of " << (end - begin);
+            errStr << " reading " << path_ << " at offset " << begin << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        return body;
+    }
+
+    std::uint64_t RemoteFile::fetchSize() const
+    {
+        std::uint64_t size = 0;
+
+#ifdef BUFR_HAS_CURL
+        Request request(url_);
+        curl_easy_setopt(request.handle(), CURLOPT_NOBODY, 1L);
+        request.perform(url_);
+
+        curl_off_t contentLength = -1;
+        curl_easy_getinfo(request.handle(), CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength);
+        if (contentLength < 0)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't get the size of " << path_ << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        size = static_cast<std::uint64_t>(contentLength);
+#endif
+
+        return size;
+    }
+}  // namespace bufr
+}  // namespace Ingester
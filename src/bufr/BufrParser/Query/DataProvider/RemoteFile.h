@@ -0,0 +1,94 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MessageBuffer.h"
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief A BUFR file in an object store or on a web server (s3://, http:// and https://
+    ///        paths), read with ranged GET requests. Reads go through a cache of fixed size
+    ///        blocks and fetch a few blocks ahead, since messages are mostly read in order.
+    ///        s3:// paths are anonymous (public buckets or presigned access) requests to
+    ///        https://<bucket>.s3.amazonaws.com/<key>, or to $AWS_ENDPOINT_URL/<bucket>/<key>
+    ///        when that is set. Needs libcurl (BUFR_HAS_CURL).
+    class RemoteFile
+    {
+     public:
+        static const size_t DefaultBlockSize = 1 << 20;
+        static const size_t DefaultReadAhead = 4;
+        static const size_t DefaultMaxBlocks = 64;
+
+        /// \brief Constructor.
+        /// \param path The s3://, http:// or https:// path of the file.
+        /// \param blockSize The size of the cached blocks.
+        /// \param readAhead The number of blocks to fetch past the ones that are needed.
+        /// \param maxBlocks The maximum number of blocks kept in the cache.
+        explicit RemoteFile(const std::string& path,
+                            size_t blockSize = DefaultBlockSize,
+                            size_t readAhead = DefaultReadAhead,
+                            size_t maxBlocks = DefaultMaxBlocks);
+
+        /// \brief True for the paths that need a RemoteFile (s3://, http:// and https://).
+        static bool isRemote(const std::string& path);
+
+        /// \brief The path the file was opened with.
+        const std::string& path() const { return path_; }
+
+        /// \brief The size of the file in bytes.
+        std::uint64_t size() const;
+
+        /// \brief Read part of the file.
+        /// \param offset The byte offset to start reading at.
+        /// \param length The number of bytes to read.
+        /// \param dst Where to put the bytes.
+        void read(std::uint64_t offset, size_t length, void* dst) const;
+
+        /// \brief Fetch the whole file into memory (bypassing the block cache).
+        std::shared_ptr<const MessageBuffer> readAll() const;
+
+     private:
+        typedef std::vector<char> Block;
+
+        const std::string path_;
+        const std::string url_;
+        const size_t blockSize_;
+        const size_t readAhead_;
+        const size_t maxBlocks_;
+
+        mutable std::mutex mutex_;
+        mutable std::uint64_t size_ = 0;
+        mutable bool hasSize_ = false;
+        mutable std::list<std::uint64_t> recentBlocks_;  // Most recently used first
+        mutable std::unordered_map<std::uint64_t,
+                                   std::pair<Block, std::list<std::uint64_t>::iterator>> blocks_;
+
+        /// \brief Get a block (fetching it and the ones after it as needed). Hold mutex_.
+        const Block& block(std::uint64_t blockIdx) const;
+
+        /// \brief Get the size of the file. Hold mutex_.
+        std::uint64_t sizeLocked() const;
+
+        /// \brief Get the bytes [begin, end) of the file from the server.
+        std::string fetch(std::uint64_t begin, std::uint64_t end) const;
+
+        /// \brief Ask the server for the size of the file.
+        std::uint64_t fetchSize() const;
+    };
+}  // namespace bufr
+}  // namespace Ingester
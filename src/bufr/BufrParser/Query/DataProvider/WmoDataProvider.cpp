@@ -7,8 +7,14 @@
 
 #include "WmoDataProvider.h"
 
+#include <sys/stat.h>
+
 #include <gsl/gsl-lite.hpp>
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
 #include <unordered_map>
 #include <vector>
 #include <iostream>
@@ -17,6 +23,49 @@
 #include "eckit/exception/Exceptions.h"
 #include "bufr_interface.h"
 
+
+namespace
+{
+    const char* TableCacheMagic = "BUFRTBL";
+    const int TableCacheVersion = 2;
+
+    /// \brief Size and modification time of a file (identifies the version of the BUFR file a
+    ///        table cache was made for).
+    bool statFile(const std::string& filePath, std::uint64_t& size, std::int64_t& modTime)
+    {
+        struct stat fileInfo;
+        if (stat(filePath.c_str(), &fileInfo) != 0) return false;
+
+        size = static_cast<std::uint64_t>(fileInfo.st_size);
+        modTime = static_cast<std::int64_t>(fileInfo.st_mtime);
+        return true;
+    }
+
+    template<typename T>
+    void writeInts(std::ostream& out, const std::vector<T>& values)
+    {
+        out << values.size();
+        for (const auto& value : values) out << " " << static_cast<int>(value);
+        out << "\n";
+    }
+
+    template<typename T>
+    void readInts(std::istream& in, std::vector<T>& values)
+    {
+        size_t size = 0;
+        in >> size;
+        if (!in) return;
+
+        values.resize(size);
+        for (auto& value : values)
+        {
+            int intVal = 0;
+            in >> intVal;
+            value = static_cast<T>(intVal);
+        }
+    }
+}  // namespace
+
 namespace Ingester {
 namespace bufr {
     WmoDataProvider::WmoDataProvider(const std::string& filePath,
@@ -29,10 +78,13 @@ namespace bufr {
 
     void WmoDataProvider::open()
     {
-        open_f(FileUnit, filePath_.c_str());
-        openbf_f(FileUnit, "SEC3", FileUnit);
+        std::lock_guard<std::recursive_mutex> lock(fortranMutex());
+
+        open_f(fileUnit_, openPath());
+        openbf_f(fileUnit_, "SEC3", fileUnit_);
         mtinfo_f(tableFilePath_.c_str(), FileUnitTable1, FileUnitTable2);
 
+        resetMessagePosition();
         isOpen_ = true;
     }
 
@@ -104,6 +156,18 @@ namespace bufr {
         }
 
         currentTableData_ = tableCache_[tagData.tagStr];
+        updateVariantIndex();
+
+        // The TypeInfo of the leaves go into the table cache file too, so read them while the
+        // tables are loaded.
+        if (tableData && !tableCachePath_.empty())
+        {
+            for (FortranIdx nodeIdx = 1; nodeIdx <= tableData->typ.size(); nodeIdx++)
+            {
+                const auto typ = tableData->typ[nodeIdx - 1];
+                if (typ == Typ::Number || typ == Typ::Character) getTypeInfo(nodeIdx);
+            }
+        }
     }
 
     size_t WmoDataProvider::variantId() const
@@ -125,12 +189,174 @@ namespace bufr {
             throw eckit::BadParameter(errStr.str());
         }
 
-        // Run through each message subset in order to cache the table information.
-        if (tableCache_.empty())
+        if (!tableCache_.empty()) return;
+
+        if (!tableCachePath_.empty() && readTableCache()) return;
+
+        // Run through each message in order to cache the table information (the subsets don't
+        // have to be decoded for that).
+        scanHeaders([](const MessageHeader&) {});
+
+        if (!tableCachePath_.empty()) writeTableCache();
+    }
+
+    void WmoDataProvider::shareTableData(const WmoDataProvider& other)
+    {
+        if (isOpen_)
+        {
+            std::ostringstream errStr;
+            errStr << "Tried to call DataProvider::shareTableData, but the file is already open!";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        // The tables aren't changed once they are made, so both providers point to the same ones.
+        tableCache_ = other.tableCache_;
+        variantCount_ = other.variantCount_;
+        typeInfos_ = other.typeInfos_;
+        currentTableData_ = nullptr;
+    }
+
+    bool WmoDataProvider::readTableCache()
+    {
+        std::ifstream file(tableCachePath_);
+        if (!file) return false;
+
+        std::string magic;
+        int version = 0;
+        std::uint64_t fileSize = 0;
+        std::int64_t fileModTime = 0;
+        std::string tablePath;
+        file >> magic >> version >> fileSize >> fileModTime >> std::quoted(tablePath);
+        if (!file || magic != TableCacheMagic || version != TableCacheVersion) return false;
+
+        std::uint64_t currentSize = 0;
+        std::int64_t currentModTime = 0;
+        if (!statFile(filePath_, currentSize, currentModTime) ||
+            currentSize != fileSize ||
+            currentModTime != fileModTime ||
+            tablePath != tableFilePath_)
+        {
+            return false;
+        }
+
+        size_t numSubsets = 0;
+        file >> numSubsets;
+
+        std::unordered_map<std::string, size_t> variantCount;
+        for (size_t subsetIdx = 0; subsetIdx < numSubsets && file; subsetIdx++)
+        {
+            std::string subset;
+            size_t count = 0;
+            file >> std::quoted(subset) >> count;
+            variantCount[subset] = count;
+        }
+
+        size_t numTables = 0;
+        file >> numTables;
+
+        std::unordered_map<std::string, std::shared_ptr<TableData>> tableCache;
+        for (size_t tableIdx = 0; tableIdx < numTables && file; tableIdx++)
+        {
+            std::string tagStr;
+            auto tableData = std::make_shared<TableData>();
+            file >> std::quoted(tagStr) >> tableData->varientNumber;
+
+            readInts(file, tableData->isc);
+            readInts(file, tableData->link);
+            readInts(file, tableData->itp);
+            readInts(file, tableData->jmpb);
+            readInts(file, tableData->irf);
+            readInts(file, tableData->typ);
+
+            size_t numTags = 0;
+            file >> numTags;
+            tableData->tag.resize(numTags);
+            for (auto& tag : tableData->tag) file >> std::quoted(tag);
+
+            tableCache[tagStr] = tableData;
+        }
+
+        size_t numTypeInfos = 0;
+        file >> numTypeInfos;
+
+        std::unordered_map<std::string, TypeInfo> typeInfos;
+        for (size_t infoIdx = 0; infoIdx < numTypeInfos && file; infoIdx++)
+        {
+            std::string tag;
+            TypeInfo info;
+            file >> std::quoted(tag) >> info.scale >> info.reference >> info.bits
+                 >> std::quoted(info.unit) >> std::quoted(info.description);
+            typeInfos[tag] = info;
+        }
+
+        if (!file) return false;
+
+        tableCache_ = std::move(tableCache);
+        variantCount_ = std::move(variantCount);
+        typeInfos_ = std::move(typeInfos);
+        return true;
+    }
+
+    void WmoDataProvider::writeTableCache() const
+    {
+        std::uint64_t fileSize = 0;
+        std::int64_t fileModTime = 0;
+        if (!statFile(filePath_, fileSize, fileModTime)) return;
+
+        // Write to a private file and move it into place so a concurrent reader never sees a
+        // partial cache. Not being able to store it only means the tables are read again.
+        const auto tmpPath = tableCachePath_ + ".tmp";
+        {
+            std::ofstream file(tmpPath);
+            if (!file) return;
+
+            file << TableCacheMagic << " " << TableCacheVersion << "\n";
+            file << fileSize << " " << fileModTime << " " << std::quoted(tableFilePath_) << "\n";
+
+            file << variantCount_.size() << "\n";
+            for (const auto& count : variantCount_)
+            {
+                file << std::quoted(count.first) << " " << count.second << "\n";
+            }
+
+            file << tableCache_.size() << "\n";
+            for (const auto& table : tableCache_)
+            {
+                const auto& tableData = *table.second;
+                file << std::quoted(table.first) << " " << tableData.varientNumber << "\n";
+
+                writeInts(file, tableData.isc);
+                writeInts(file, tableData.link);
+                writeInts(file, tableData.itp);
+                writeInts(file, tableData.jmpb);
+                writeInts(file, tableData.irf);
+                writeInts(file, tableData.typ);
+
+                file << tableData.tag.size();
+                for (const auto& tag : tableData.tag) file << " " << std::quoted(tag);
+                file << "\n";
+            }
+
+            file << typeInfos_.size() << "\n";
+            for (const auto& typeInfo : typeInfos_)
+            {
+                const auto& info = typeInfo.second;
+                file << std::quoted(typeInfo.first) << " " << info.scale << " " << info.reference
+                     << " " << info.bits << " " << std::quoted(info.unit) << " "
+                     << std::quoted(info.description) << "\n";
+            }
+
+            if (!file)
+            {
+                file.close();
+                std::remove(tmpPath.c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tmpPath.c_str(), tableCachePath_.c_str()) != 0)
         {
-            open();
-            run(QuerySet(), []() {});
-            close();
+            std::remove(tmpPath.c_str());
         }
     }
 }  // namespace bufr
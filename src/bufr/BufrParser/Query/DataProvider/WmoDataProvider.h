@@ -46,8 +46,25 @@ namespace bufr {
         bool hasVariants() const final;
 
         /// \brief Initialize the table cache in order to capture all the subset information.
+        ///        Reads the tables from the table cache file (see setTableCachePath) instead of
+        ///        running through the BUFR file when that file is up to date.
         void initAllTableData() final;
 
+        /// \brief Store the table cache built by initAllTableData in a sidecar file, so later
+        ///        runs on the same BUFR file only have to go through it once.
+        /// \param tableCachePath Path to the table cache file (empty to not store it).
+        void setTableCachePath(const std::string& tableCachePath)
+        {
+            tableCachePath_ = tableCachePath;
+        }
+
+        /// \brief Use the tables (and TypeInfo) another provider for the same files has loaded
+        ///        with initAllTableData, so the variants are numbered the same way without going
+        ///        through the file again (ex: to read the file on several threads, one provider
+        ///        per thread). The file can't be open.
+        /// \param other The provider to copy the tables of.
+        void shareTableData(const WmoDataProvider& other);
+
      private:
         static const int FileUnitTable1 = 13;
         static const int FileUnitTable2 = 14;
@@ -56,6 +73,16 @@ namespace bufr {
         std::unordered_map<std::string, std::shared_ptr<TableData>> tableCache_;
         std::shared_ptr<TableData> currentTableData_ = nullptr;
         std::unordered_map<std::string, size_t> variantCount_;
+        std::string tableCachePath_;
+
+        /// \brief Load tableCache_, variantCount_ and the TypeInfo of the mnemonics from the table
+        ///        cache file.
+        /// \return false if the file doesn't exist or wasn't made for this BUFR file.
+        bool readTableCache();
+
+        /// \brief Write tableCache_, variantCount_ and the TypeInfo of the mnemonics to the table
+        ///        cache file.
+        void writeTableCache() const;
 
         /// \brief Update the table data for the currently loaded subset.
         /// \param subset The subset string.
@@ -0,0 +1,43 @@
+! (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+!
+! This software is licensed under the terms of the Apache Licence Version 2.0
+! which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+
+!> C bindings for the NCEPLIB-bufr routines that aren't exposed through bufr_interface.h
+
+module bufr_ext_c_interface_mod
+
+  use iso_c_binding
+
+  implicit none
+
+  private
+  public:: readerme_c
+
+contains
+
+  subroutine readerme_c(mesg, lunit, subset, subset_str_len, jdate, iret) &
+                        bind(C, name='readerme_f')
+
+    integer(c_int),         intent(in)    :: mesg(*)
+    integer(c_int), value,  intent(in)    :: lunit
+    character(kind=c_char), intent(inout) :: subset(*)
+    integer(c_int), value,  intent(in)    :: subset_str_len
+    integer(c_int),         intent(out)   :: jdate
+    integer(c_int),         intent(out)   :: iret
+
+    character(len=8) :: subset_f
+    integer :: i, str_len
+
+    subset_f = ' '
+    call readerme(mesg, lunit, subset_f, jdate, iret)
+
+    str_len = min(len_trim(subset_f), subset_str_len - 1)
+    do i = 1, str_len
+      subset(i) = subset_f(i:i)
+    end do
+    subset(str_len + 1) = c_null_char
+
+  end subroutine readerme_c
+
+end module bufr_ext_c_interface_mod
@@ -0,0 +1,32 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+/** @file
+    @brief Signatures for the NCEPLIB-bufr routines that are not part of the library's own
+    C interface (bufr_interface.h), so they can be called from C and C++.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /// \brief Read a BUFR message from a memory buffer into the internal arrays of the already
+  ///        opened (openbf) Fortran unit (NCEPLIB-bufr readerme).
+  /// \param mesg The BUFR message (whole 4-byte words, as it was stored in the file).
+  /// \param lunit The Fortran unit of the open BUFR file to load the message into.
+  /// \param subset Buffer to receive the null terminated subset name.
+  /// \param subsetStrLen Length of the subset buffer.
+  /// \param jdate Receives the message date (YYYYMMDDHH).
+  /// \param iret Receives the return code (0 success, 11 DX table message, -1 error).
+  void readerme_f(const int* mesg, int lunit, char* subset, int subsetStrLen, int* jdate,
+                  int* iret);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,42 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Number of days between 1970-01-01 and the given (proleptic Gregorian) date. Pure
+    ///        integer arithmetic (no libc time calls) so loops over many dates can be vectorized.
+    ///        See http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+    inline constexpr std::int64_t daysFromCivil(std::int64_t year, std::int64_t month,
+                                                std::int64_t day)
+    {
+        year -= (month <= 2);
+        const std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+        const std::int64_t yearOfEra = year - era * 400;
+        const std::int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5
+                                       + day - 1;
+        const std::int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100
+                                      + dayOfYear;
+        return era * 146097 + dayOfEra - 719468;
+    }
+
+    /// \brief Seconds since 1970-01-01T00:00:00Z for the given UTC date and time (same result as
+    ///        timegm for in range values).
+    inline constexpr std::int64_t secondsSinceEpoch(std::int64_t year, std::int64_t month,
+                                                    std::int64_t day, std::int64_t hour,
+                                                    std::int64_t minute = 0,
+                                                    std::int64_t second = 0)
+    {
+        return daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    }
+}  // namespace bufr
+}  // namespace Ingester
@@ -8,31 +8,320 @@
 #include "File.h"
 
 #include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <mutex>  // NOLINT
+#include <sstream>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
 
 #include "bufr_interface.h"
 
+#include "Parallel.h"
 #include "QueryRunner.h"
 #include "QuerySet.h"
+#include "SubsetLookupTable.h"
+#include "DataProvider/CompressedStream.h"
 #include "DataProvider/DataProvider.h"
 #include "DataProvider/NcepDataProvider.h"
 #include "DataProvider/WmoDataProvider.h"
 
 
+namespace
+{
+    // Number of consecutive (matching) messages a parallel worker handles at a time.
+    const size_t MessageBlockSize = 16;
+
+    // Number of subsets the decoding thread hands to a collecting worker at a time.
+    const size_t SubsetBatchSize = 64;
+
+    // Name used in place of the file path for messages read from memory.
+    const char* MemoryFileName = "<memory>";
+
+    using Ingester::bufr::DataProvider;
+    using Ingester::bufr::QueryRunner;
+    using Ingester::bufr::QuerySet;
+    using Ingester::bufr::ResultSet;
+    using Ingester::bufr::SharedTargetCache;
+    using Ingester::bufr::SubsetLookupTable;
+
+    /// \brief Consecutive subsets captured on the decoding thread, with the captures for each
+    ///        query set. The captures are kept when the batch is reused so their storage is too.
+    struct SubsetBatch
+    {
+        size_t batchIdx = 0;
+        size_t numSubsets = 0;
+        std::vector<std::vector<QueryRunner::CapturedSubset>> captures;
+        std::vector<size_t> numCaptures;
+
+        explicit SubsetBatch(size_t numQuerySets) :
+            captures(numQuerySets),
+            numCaptures(numQuerySets, 0)
+        {
+        }
+
+        void clear()
+        {
+            numSubsets = 0;
+            std::fill(numCaptures.begin(), numCaptures.end(), 0);
+        }
+    };
+
+    /// \brief The QueryRunners for several query sets that collect from the same DataProvider,
+    ///        each only collecting the subsets its query set includes.
+    class QueryRunners
+    {
+     public:
+        QueryRunners(const std::vector<QuerySet>& querySets,
+                     const std::shared_ptr<DataProvider>& dataProvider,
+                     const std::shared_ptr<SharedTargetCache>& targetCache) :
+            querySets_(querySets),
+            dataProvider_(dataProvider),
+            resultSets_(querySets.size()),
+            unionQuerySet_(querySets.size() > 1 ? QuerySet::unionOf(querySets) : QuerySet())
+        {
+            for (size_t setIdx = 0; setIdx < querySets_.size(); setIdx++)
+            {
+                runners_.push_back(std::make_unique<QueryRunner>(querySets_[setIdx],
+                                                                 resultSets_[setIdx],
+                                                                 dataProvider_,
+                                                                 targetCache));
+            }
+        }
+
+        QueryRunners(const QueryRunners&) = delete;
+        QueryRunners& operator=(const QueryRunners&) = delete;
+
+        /// \brief The query set to run the DataProvider with.
+        const QuerySet& runQuerySet() const
+        {
+            return querySets_.size() > 1 ? unionQuerySet_ : querySets_.front();
+        }
+
+        /// \brief Collect the current subset.
+        void accumulate()
+        {
+            if (runners_.size() == 1)
+            {
+                runners_.front()->accumulate();
+                return;
+            }
+
+            const auto subset = dataProvider_->getSubset();
+            for (size_t setIdx = 0; setIdx < runners_.size(); setIdx++)
+            {
+                if (querySets_[setIdx].includesSubset(subset)) runners_[setIdx]->accumulate();
+            }
+        }
+
+        /// \brief Capture the current subset for the query sets that include it (see
+        ///        QueryRunner::capture).
+        void capture(SubsetBatch& batch)
+        {
+            const auto subset = dataProvider_->getSubset();
+            for (size_t setIdx = 0; setIdx < runners_.size(); setIdx++)
+            {
+                if (runners_.size() > 1 && !querySets_[setIdx].includesSubset(subset)) continue;
+
+                auto& captures = batch.captures[setIdx];
+                auto& numCaptures = batch.numCaptures[setIdx];
+                if (numCaptures == captures.size()) captures.emplace_back();
+                runners_[setIdx]->capture(captures[numCaptures++]);
+            }
+
+            batch.numSubsets++;
+        }
+
+        /// \brief Collect a batch of captured subsets. Can run on several threads at once.
+        /// \param batch The captured subsets.
+        /// \param frame The lookup table to load the subsets into (one per thread).
+        /// \return One ResultSet per query set.
+        std::vector<ResultSet> collect(const SubsetBatch& batch, SubsetLookupTable& frame) const
+        {
+            std::vector<ResultSet> resultSets(runners_.size());
+            for (size_t setIdx = 0; setIdx < runners_.size(); setIdx++)
+            {
+                for (size_t captureIdx = 0; captureIdx < batch.numCaptures[setIdx]; captureIdx++)
+                {
+                    runners_[setIdx]->accumulate(batch.captures[setIdx][captureIdx],
+                                                 frame,
+                                                 resultSets[setIdx]);
+                }
+            }
+
+            return resultSets;
+        }
+
+        /// \brief Take the data collected so far (collecting starts over with empty ResultSets).
+        std::vector<ResultSet> takeResults()
+        {
+            std::vector<ResultSet> resultSets(resultSets_.size());
+            for (size_t setIdx = 0; setIdx < resultSets_.size(); setIdx++)
+            {
+                resultSets[setIdx] = std::move(resultSets_[setIdx]);
+                resultSets_[setIdx] = ResultSet();
+            }
+
+            return resultSets;
+        }
+
+     private:
+        const std::vector<QuerySet>& querySets_;
+        const std::shared_ptr<DataProvider> dataProvider_;
+        std::vector<ResultSet> resultSets_;
+        const QuerySet unionQuerySet_;
+        std::vector<std::unique_ptr<QueryRunner>> runners_;
+    };
+}  // namespace
+
 namespace Ingester {
 namespace bufr {
-    File::File(const std::string &filename, const std::string &wmoTablePath)
+    File::File(const std::string &filename,
+               const std::string &wmoTablePath,
+               const std::string &indexPath,
+               const std::string &tableCachePath) :
+        filename_(filename),
+        wmoTablePath_(wmoTablePath),
+        tableCachePath_(tableCachePath)
+    {
+        // The messages of compressed files can't be read from their offsets, so those are
+        // just streamed.
+        if (!indexPath.empty() && CompressedStream::detect(filename_) == Compression::None)
+        {
+            index_ = MessageIndex::load(filename_, indexPath, wmoTablePath_);
+        }
+
+        if (RemoteFile::isRemote(filename_))
+        {
+            // Through the index only the messages that get read are fetched. Without one the
+            // whole file is needed anyway, so fetch it in one go.
+            auto remoteFile = std::make_shared<RemoteFile>(filename_);
+            if (index_)
+            {
+                remoteFile_ = remoteFile;
+            }
+            else
+            {
+                buffer_ = remoteFile->readAll();
+            }
+        }
+
+        dataProvider_ = makeDataProvider();
+        if (!wmoTablePath_.empty() && !tableCachePath_.empty())
+        {
+            dataProvider_->initAllTableData();
+        }
+
+        dataProvider_->open();
+    }
+
+    File::File(const std::shared_ptr<const MessageBuffer>& buffer,
+               const std::string& wmoTablePath) :
+        filename_(MemoryFileName),
+        wmoTablePath_(wmoTablePath),
+        buffer_(buffer)
+    {
+        if (buffer_ == nullptr)
+        {
+            throw eckit::BadParameter("File needs a MessageBuffer to read the messages from.");
+        }
+
+        dataProvider_ = makeDataProvider();
+        dataProvider_->open();
+    }
+
+    std::shared_ptr<DataProvider> File::makeDataProvider() const
     {
-        if (wmoTablePath.empty())
+        std::shared_ptr<DataProvider> dataProvider;
+        if (wmoTablePath_.empty())
         {
-            dataProvider_ = std::make_shared<Ingester::bufr::NcepDataProvider>(filename);
+            dataProvider = std::make_shared<Ingester::bufr::NcepDataProvider>(filename_);
         }
         else
         {
-            dataProvider_ = std::make_shared<Ingester::bufr::WmoDataProvider>(filename,
-                                                                             wmoTablePath);
+            auto wmoDataProvider =
+                std::make_shared<Ingester::bufr::WmoDataProvider>(filename_, wmoTablePath_);
+            wmoDataProvider->setTableCachePath(tableCachePath_);
+            dataProvider = wmoDataProvider;
         }
 
+        if (index_) dataProvider->setMessageIndex(index_);
+        if (buffer_) dataProvider->setMessageBuffer(buffer_);
+        if (remoteFile_) dataProvider->setRemoteFile(remoteFile_);
+        if (nativeDecoding_) dataProvider->setNativeDecoding(true);
+        if (readAhead_) dataProvider->setReadAhead(true);
+
+        return dataProvider;
+    }
+
+    void File::setNativeDecoding(bool enable)
+    {
+        if (enable == nativeDecoding_) return;
+        nativeDecoding_ = enable;
+
+        const size_t position = dataProvider_->getMessagesRead();
+        dataProvider_->close();
+        dataProvider_->setNativeDecoding(enable);
         dataProvider_->open();
+        dataProvider_->skipMessages(position);
+    }
+
+    void File::setReadAhead(bool enable)
+    {
+        if (enable == readAhead_) return;
+        readAhead_ = enable;
+
+        const size_t position = dataProvider_->getMessagesRead();
+        dataProvider_->close();
+        dataProvider_->setReadAhead(enable);
+        dataProvider_->open();
+        dataProvider_->skipMessages(position);
+    }
+
+    size_t File::messagesRead() const
+    {
+        return dataProvider_->getMessagesRead();
+    }
+
+    void File::skipMessages(size_t count)
+    {
+        dataProvider_->skipMessages(count);
+    }
+
+    std::vector<MessageIndexEntry> File::dataMessages() const
+    {
+        std::shared_ptr<const MessageIndex> index = index_;
+        if (!index)
+        {
+            if (filename_ == MemoryFileName)
+            {
+                throw eckit::BadParameter("Can't list the messages of a File read from memory.");
+            }
+
+            if (CompressedStream::detect(filename_) != Compression::None)
+            {
+                std::ostringstream errStr;
+                errStr << "Can't list the messages of " << filename_ << " without ";
+                errStr << "decompressing it (compressed files have no message index).";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            index = std::make_shared<MessageIndex>(MessageIndex::build(filename_, wmoTablePath_));
+        }
+
+        std::vector<MessageIndexEntry> entries;
+        std::copy_if(index->entries().begin(),
+                     index->entries().end(),
+                     std::back_inserter(entries),
+                     [](const MessageIndexEntry& entry) { return !entry.isDictionary; });
+
+        return entries;
     }
 
     void File::close()
@@ -43,22 +332,42 @@ namespace bufr {
     void File::rewind()
     {
         dataProvider_->rewind();
+        messagesProcessed_ = 0;
     }
 
-    ResultSet File::execute(const QuerySet &querySet, size_t next)
+    ResultSet File::execute(const QuerySet &querySet, size_t next, size_t threads)
     {
+        return std::move(execute(std::vector<QuerySet>{querySet}, next, threads).front());
+    }
+
+    std::vector<ResultSet> File::execute(const std::vector<QuerySet>& querySets,
+                                         size_t next,
+                                         size_t threads)
+    {
+        if (querySets.empty()) return {};
+
+        // WMO files carry a table per message and number the subset variants in the order they
+        // are encountered, so workers reading their own copies would not agree on them. Those
+        // are decoded by one thread, and the other threads collect the subsets. Either way no
+        // more threads than the Executor has are used.
+        threads = std::min(threads, Executor::numThreads());
+        if (threads > 1)
+        {
+            if (wmoTablePath_.empty()) return executeParallel(querySets, next, threads);
+            return executePipelined(querySets, next, threads);
+        }
+
         size_t msgCnt = 0;
-        auto resultSet = ResultSet();
-        auto queryRunner = QueryRunner(querySet, resultSet, dataProvider_);
+        auto queryRunners = QueryRunners(querySets, dataProvider_, targetCache_);
 
         auto processMsg = [&msgCnt] () mutable
         {
             msgCnt++;
         };
 
-        auto processSubset = [&queryRunner]() mutable
+        auto processSubset = [&queryRunners]() mutable
         {
-            queryRunner.accumulate();
+            queryRunners.accumulate();
         };
 
         auto continueProcessing = [next, &msgCnt]() -> bool
@@ -71,12 +380,326 @@ namespace bufr {
             return true;
         };
 
-        dataProvider_->run(querySet,
+        dataProvider_->run(queryRunners.runQuerySet(),
                            processSubset,
                            processMsg,
                            continueProcessing);
 
-        return resultSet;
+        messagesProcessed_ += msgCnt;
+        return queryRunners.takeResults();
+    }
+
+    bool File::executeChunk(const QuerySet& querySet,
+                            size_t msgsPerChunk,
+                            ResultSet& resultSet,
+                            size_t threads)
+    {
+        if (msgsPerChunk == 0)
+        {
+            throw eckit::BadParameter("File::executeChunk needs at least 1 message per chunk.");
+        }
+
+        const size_t startMsg = dataProvider_->getMessagesRead();
+        resultSet = execute(querySet, msgsPerChunk, threads);
+
+        return dataProvider_->getMessagesRead() > startMsg;
+    }
+
+    void File::executeChunks(const QuerySet& querySet,
+                             size_t msgsPerChunk,
+                             const std::function<void(ResultSet&&)>& processChunk,
+                             size_t threads)
+    {
+        auto resultSet = ResultSet();
+        while (executeChunk(querySet, msgsPerChunk, resultSet, threads))
+        {
+            if (!resultSet.empty())
+            {
+                processChunk(std::move(resultSet));
+                resultSet = ResultSet();
+            }
+        }
+    }
+
+    std::vector<ResultSet> File::executePipelined(const std::vector<QuerySet>& querySets,
+                                                  size_t next,
+                                                  size_t threads)
+    {
+        size_t msgCnt = 0;
+        auto queryRunners = QueryRunners(querySets, dataProvider_, targetCache_);
+
+        // The batches go round from the decoding thread to the workers and back, so at most
+        // MaxBatches batches worth of subsets are held at a time.
+        const size_t MaxBatches = 2 * threads;
+
+        std::mutex mutex;
+        std::condition_variable batchReady;
+        std::condition_variable batchFree;
+        std::deque<std::unique_ptr<SubsetBatch>> readyBatches;
+        std::vector<std::unique_ptr<SubsetBatch>> freeBatches;
+        std::map<size_t, std::vector<ResultSet>> batchResults;
+        std::exception_ptr workerError;
+        bool isDone = false;
+
+        for (size_t batchIdx = 0; batchIdx < MaxBatches; batchIdx++)
+        {
+            freeBatches.push_back(std::make_unique<SubsetBatch>(querySets.size()));
+        }
+
+        auto work = [&]()
+        {
+            SubsetLookupTable frame;
+            for (;;)
+            {
+                std::unique_ptr<SubsetBatch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    batchReady.wait(lock, [&]() { return !readyBatches.empty() || isDone; });
+                    if (readyBatches.empty()) return;
+
+                    batch = std::move(readyBatches.front());
+                    readyBatches.pop_front();
+                }
+
+                std::vector<ResultSet> resultSets;
+                std::exception_ptr error;
+                try
+                {
+                    resultSets = queryRunners.collect(*batch, frame);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (error && !workerError) workerError = error;
+                    batchResults[batch->batchIdx] = std::move(resultSets);
+                    freeBatches.push_back(std::move(batch));
+                }
+
+                batchFree.notify_one();
+            }
+        };
+
+        // The collectors wait for the decoding thread, which may itself be running an Executor
+        // job, so they can't be jobs too. They have threads of their own instead.
+        std::vector<std::thread> workers;
+        for (size_t workerIdx = 0; workerIdx < threads; workerIdx++)
+        {
+            workers.emplace_back(work);
+        }
+
+        std::unique_ptr<SubsetBatch> batch;
+        size_t numBatches = 0;
+
+        auto submitBatch = [&]()
+        {
+            if (!batch) return;
+
+            batch->batchIdx = numBatches++;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                readyBatches.push_back(std::move(batch));
+            }
+
+            batchReady.notify_one();
+        };
+
+        auto processMsg = [&msgCnt]() mutable
+        {
+            msgCnt++;
+        };
+
+        // The subsets are copied while NCEPLIB-bufr has them open (the only part that has to
+        // happen on this thread) and collected by the workers.
+        auto processSubset = [&]() mutable
+        {
+            if (!batch)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                batchFree.wait(lock, [&]() { return !freeBatches.empty(); });
+
+                batch = std::move(freeBatches.back());
+                freeBatches.pop_back();
+                batch->clear();
+            }
+
+            queryRunners.capture(*batch);
+            if (batch->numSubsets == SubsetBatchSize) submitBatch();
+        };
+
+        auto continueProcessing = [&]() -> bool
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (workerError) return false;
+            }
+
+            if (next > 0)
+            {
+                return msgCnt < next;
+            }
+
+            return true;
+        };
+
+        std::exception_ptr decodeError;
+        try
+        {
+            dataProvider_->run(queryRunners.runQuerySet(),
+                               processSubset,
+                               processMsg,
+                               continueProcessing);
+
+            submitBatch();
+        }
+        catch (...)
+        {
+            decodeError = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isDone = true;
+        }
+
+        batchReady.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        if (decodeError) std::rethrow_exception(decodeError);
+        if (workerError) std::rethrow_exception(workerError);
+
+        // Merge the batches back together in subset order.
+        std::vector<ResultSet> resultSets(querySets.size());
+        for (auto& batchResult : batchResults)
+        {
+            for (size_t setIdx = 0; setIdx < resultSets.size(); setIdx++)
+            {
+                resultSets[setIdx].merge(std::move(batchResult.second[setIdx]));
+            }
+        }
+
+        messagesProcessed_ += msgCnt;
+        return resultSets;
+    }
+
+    std::vector<ResultSet> File::executeParallel(const std::vector<QuerySet>& querySets,
+                                                 size_t next,
+                                                 size_t threads)
+    {
+        const size_t startMsg = dataProvider_->getMessagesRead();
+
+        // Open the worker files up front. NCEPLIB-bufr updates its internal tables when a file
+        // is opened, which must not happen while the other workers are decoding.
+        std::vector<std::shared_ptr<DataProvider>> providers(threads);
+        for (auto& provider : providers)
+        {
+            provider = makeDataProvider();
+            provider->open();
+            provider->skipMessages(startMsg);
+        }
+
+        // The workers all see the same tables, so only one of them has to resolve the queries.
+        auto targetCache = targetCache_;
+        if (!targetCache) targetCache = std::make_shared<SharedTargetCache>();
+
+        typedef std::pair<size_t, std::vector<ResultSet>> BlockResult;
+        std::vector<std::vector<BlockResult>> blockResults(threads);
+        std::vector<size_t> msgCnts(threads, 0);
+
+        // Each worker only needs its own provider, so the Executor may run them in any order
+        // (or some in turn on the same thread when there are fewer free threads).
+        parallelFor(threads, threads, [&](size_t workerIdx)
+        {
+            auto& blocks = blockResults[workerIdx];
+            auto& msgCnt = msgCnts[workerIdx];
+            size_t blockIdx = 0;
+            bool blockStarted = false;
+
+            auto queryRunners = QueryRunners(querySets, providers[workerIdx], targetCache);
+
+            // Every worker sees every message, but only decodes the blocks it owns.
+            auto decodeMsg = [&]() -> bool
+            {
+                const size_t msgBlockIdx = msgCnt / MessageBlockSize;
+                if (msgBlockIdx % threads != workerIdx)
+                {
+                    msgCnt++;
+                    return false;
+                }
+
+                if (blockStarted && msgBlockIdx != blockIdx)
+                {
+                    blocks.emplace_back(blockIdx, queryRunners.takeResults());
+                }
+
+                blockIdx = msgBlockIdx;
+                blockStarted = true;
+                return true;
+            };
+
+            auto processMsg = [&msgCnt]() mutable
+            {
+                msgCnt++;
+            };
+
+            auto processSubset = [&queryRunners]() mutable
+            {
+                queryRunners.accumulate();
+            };
+
+            auto continueProcessing = [next, &msgCnt]() -> bool
+            {
+                if (next > 0)
+                {
+                    return msgCnt < next;
+                }
+
+                return true;
+            };
+
+            providers[workerIdx]->run(queryRunners.runQuerySet(),
+                                      processSubset,
+                                      processMsg,
+                                      continueProcessing,
+                                      decodeMsg);
+
+            if (blockStarted)
+            {
+                blocks.emplace_back(blockIdx, queryRunners.takeResults());
+            }
+        });
+
+        // Merge the blocks back together in message order.
+        std::vector<BlockResult> blocks;
+        for (auto& workerBlocks : blockResults)
+        {
+            std::move(workerBlocks.begin(), workerBlocks.end(), std::back_inserter(blocks));
+        }
+
+        std::sort(blocks.begin(), blocks.end(),
+                  [](const BlockResult& a, const BlockResult& b) { return a.first < b.first; });
+
+        std::vector<ResultSet> resultSets(querySets.size());
+        for (auto& block : blocks)
+        {
+            for (size_t setIdx = 0; setIdx < resultSets.size(); setIdx++)
+            {
+                resultSets[setIdx].merge(std::move(block.second[setIdx]));
+            }
+        }
+
+        // Leave the file positioned the same way a serial run would have. Every worker sees
+        // all the messages, so they all counted the same ones.
+        dataProvider_->skipMessages(providers.front()->getMessagesRead() - startMsg);
+        messagesProcessed_ += msgCnts.front();
+
+        return resultSets;
     }
 }  // namespace bufr
 }  // namespace Ingester
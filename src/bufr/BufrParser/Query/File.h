@@ -7,10 +7,17 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "QuerySet.h"
 #include "ResultSet.h"
+#include "TargetCache.h"
+#include "DataProvider/MessageBuffer.h"
+#include "DataProvider/MessageIndex.h"
+#include "DataProvider/RemoteFile.h"
 
 namespace Ingester {
 namespace bufr {
@@ -21,15 +28,117 @@ namespace bufr {
      public:
         File() = delete;
 
+        /// \brief Open a BUFR file.
+        /// \param filename Path to the BUFR file. s3://, http:// and https:// paths are read
+        /// from the object store or web server (see RemoteFile), best together with an indexPath
+        /// so only the messages that are needed are fetched.
+        /// Files compressed with gzip, bzip2 or zstd are decompressed as they are read (see
+        /// CompressedStream).
+        /// \param wmoTablePath (Optional) Path to the WMO master tables (for WMO BUFR files).
+        /// \param indexPath (Optional) Path to a message index sidecar file. When given, messages
+        /// are read through the index (built and stored there if it is missing or out of date),
+        /// so messages for subsets that aren't queried are never read. Ignored for compressed
+        /// files.
+        /// \param tableCachePath (Optional) Path to a table cache sidecar file (WMO BUFR files
+        /// only). When given, the tables of all the subset variants are collected up front so the
+        /// variants are numbered consistently. They are stored in the sidecar (with the type
+        /// information of their mnemonics) so later runs on the same file don't have to go
+        /// through it twice.
         File(const std::string& filename,
-             const std::string& wmoTablePath = "");
+             const std::string& wmoTablePath = "",
+             const std::string& indexPath = "",
+             const std::string& tableCachePath = "");
+
+        /// \brief Open BUFR messages held in memory (ex: bulletins received from a message queue
+        /// or a memory mapped file), without going through the file system.
+        /// \param buffer The BUFR messages (the contents of a BUFR file).
+        /// \param wmoTablePath (Optional) Path to the WMO master tables (for WMO BUFR files).
+        explicit File(const std::shared_ptr<const MessageBuffer>& buffer,
+                      const std::string& wmoTablePath = "");
 
         /// \brief Execute the queries given in the query set over the BUFR file and accumulate the
         /// resulting data in the ResultSet.
         /// \param query_set The queryset object that contains the collection of desired queries
         /// \param next The number of messages worth of data to run. 0 reads all messages in the
         /// file.
-        ResultSet execute(const QuerySet& query_set, size_t next = 0);
+        /// \param threads The number of worker threads to use. For NCEP files each worker opens
+        /// its own copy of the file and handles an interleaved set of message blocks. WMO files
+        /// are decoded by one thread, which hands batches of subsets to the workers to collect.
+        /// The results are merged in message order, so the ResultSet is the same as the one from
+        /// a serial run.
+        ResultSet execute(const QuerySet& query_set, size_t next = 0, size_t threads = 1);
+
+        /// \brief Execute several query sets in one pass over the file (ex: the observations
+        /// entries of a YAML that read the same file). Every subset is decoded once and collected
+        /// for each of the query sets that include it, so the ResultSets are the same as the ones
+        /// from running the query sets one at a time.
+        /// \param querySets The query sets. They must have the same time window (or none).
+        /// \param next The number of messages worth of data to run (see execute).
+        /// \param threads The number of worker threads to use (see execute).
+        /// \return One ResultSet per query set.
+        std::vector<ResultSet> execute(const std::vector<QuerySet>& querySets,
+                                       size_t next = 0,
+                                       size_t threads = 1);
+
+        /// \brief Execute the query set over the next chunk of messages. The file position is
+        /// kept, so calling this repeatedly walks through the file in bounded pieces.
+        /// \param query_set The queryset object that contains the collection of desired queries
+        /// \param msgsPerChunk The number of messages worth of data in the chunk.
+        /// \param resultSet Receives the data for the chunk (can be empty if none of the messages
+        /// in the chunk matched the queried subsets).
+        /// \param threads The number of worker threads to use (see execute).
+        /// \return false if there were no messages left to read.
+        bool executeChunk(const QuerySet& query_set,
+                          size_t msgsPerChunk,
+                          ResultSet& resultSet,
+                          size_t threads = 1);
+
+        /// \brief Execute the query set over the rest of the file, msgsPerChunk messages at a
+        /// time. Each chunk's ResultSet is handed to processChunk and released afterwards, so
+        /// only one chunk is held in memory at a time. Empty chunks are skipped.
+        /// \param query_set The queryset object that contains the collection of desired queries
+        /// \param msgsPerChunk The number of messages worth of data in each chunk.
+        /// \param processChunk The function to call with the results of each chunk.
+        /// \param threads The number of worker threads to use (see execute).
+        void executeChunks(const QuerySet& query_set,
+                           size_t msgsPerChunk,
+                           const std::function<void(ResultSet&&)>& processChunk,
+                           size_t threads = 1);
+
+        /// \brief Share the targets (resolved queries) with the Files in a FileSet so each
+        /// table structure only has its queries resolved once.
+        /// \param targetCache The shared targets.
+        void setTargetCache(const std::shared_ptr<SharedTargetCache>& targetCache)
+        {
+            targetCache_ = targetCache;
+        }
+
+        /// \brief Decode the data sections with the native decoder where it can (see
+        /// DataProvider::setNativeDecoding). The file is reopened at the same message.
+        /// \param enable Use the native decoder.
+        void setNativeDecoding(bool enable);
+
+        /// \brief Read the file through buffers filled ahead of the decoding (see
+        /// DataProvider::setReadAhead). The file is reopened at the same message.
+        /// \param enable Read ahead.
+        void setReadAhead(bool enable);
+
+        /// \brief Get the number of messages read so far.
+        size_t messagesRead() const;
+
+        /// \brief Get the number of messages the queries ran over so far, which are the ones
+        /// the next argument of execute counts (messages for the queried subsets, within the
+        /// time window).
+        size_t messagesProcessed() const { return messagesProcessed_; }
+
+        /// \brief Read past the next messages without decoding them.
+        /// \param count The number of (data) messages to skip.
+        void skipMessages(size_t count);
+
+        /// \brief Get the index entries of all the data messages in the file, in file order.
+        /// The index is built when the file has none. Not supported for compressed files or
+        /// messages read from memory.
+        std::vector<MessageIndexEntry> dataMessages() const;
 
         /// \brief Close the currently opened BUFR file.
         void close();
@@ -38,7 +147,31 @@ namespace bufr {
         void rewind();
 
      private:
+        const std::string filename_;
+        const std::string wmoTablePath_;
+        const std::string tableCachePath_;
+        std::shared_ptr<const MessageIndex> index_;
+        std::shared_ptr<const MessageBuffer> buffer_;
+        std::shared_ptr<const RemoteFile> remoteFile_;
         std::shared_ptr<DataProvider> dataProvider_;
+        std::shared_ptr<SharedTargetCache> targetCache_;
+        size_t messagesProcessed_ = 0;
+        bool nativeDecoding_ = false;
+        bool readAhead_ = false;
+
+        /// \brief Create a new (unopened) DataProvider for the file.
+        std::shared_ptr<DataProvider> makeDataProvider() const;
+
+        /// \brief Execute the query sets with one thread decoding the subsets and a pool of
+        /// worker threads collecting them (see execute).
+        std::vector<ResultSet> executePipelined(const std::vector<QuerySet>& querySets,
+                                                size_t next,
+                                                size_t threads);
+
+        /// \brief Execute the query sets with a pool of worker threads (see execute).
+        std::vector<ResultSet> executeParallel(const std::vector<QuerySet>& querySets,
+                                               size_t next,
+                                               size_t threads);
     };
 }  // namespace bufr
 }  // namespace Ingester
@@ -0,0 +1,294 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "FileSet.h"
+
+#include <glob.h>
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "Parallel.h"
+
+
+namespace
+{
+    bool isPattern(const std::string& path)
+    {
+        return path.find_first_of("*?[") != std::string::npos;
+    }
+
+    std::string fileName(const std::string& path)
+    {
+        const auto slashPos = path.find_last_of('/');
+        return slashPos == std::string::npos ? path : path.substr(slashPos + 1);
+    }
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    FileSet::FileSet(const std::vector<std::string>& filenames,
+                     const std::string& wmoTablePath,
+                     const std::string& indexPath,
+                     const std::string& tableCachePath) :
+        filenames_(expand(filenames)),
+        wmoTablePath_(wmoTablePath),
+        indexPath_(indexPath),
+        tableCachePath_(tableCachePath),
+        targetCache_(std::make_shared<SharedTargetCache>()),
+        messagesRead_(filenames_.size(), 0)
+    {
+        if (filenames_.size() == 1)
+        {
+            file_ = openFile(0);
+        }
+    }
+
+    std::vector<std::string> FileSet::expand(const std::vector<std::string>& patterns)
+    {
+        std::vector<std::string> paths;
+        for (const auto& pattern : patterns)
+        {
+            if (!isPattern(pattern))
+            {
+                paths.push_back(pattern);
+                continue;
+            }
+
+            glob_t matches;
+            const auto result = glob(pattern.c_str(), 0, nullptr, &matches);
+            if (result == 0)
+            {
+                // glob sorts the matches
+                for (size_t matchIdx = 0; matchIdx < matches.gl_pathc; matchIdx++)
+                {
+                    paths.emplace_back(matches.gl_pathv[matchIdx]);
+                }
+            }
+
+            globfree(&matches);
+
+            if (result != 0)
+            {
+                std::ostringstream errStr;
+                errStr << "No BUFR files match " << pattern << ".";
+                throw eckit::BadParameter(errStr.str());
+            }
+        }
+
+        if (paths.empty())
+        {
+            throw eckit::BadParameter("No BUFR files were given.");
+        }
+
+        return paths;
+    }
+
+    ResultSet FileSet::execute(const QuerySet& querySet, size_t next, size_t threads)
+    {
+        return std::move(execute(std::vector<QuerySet>{querySet}, next, threads).front());
+    }
+
+    std::vector<ResultSet> FileSet::execute(const std::vector<QuerySet>& querySets,
+                                            size_t next,
+                                            size_t threads)
+    {
+        if (file_) return file_->execute(querySets, next, threads);
+
+        if (next == 0 && skipMessages_ == 0) return executeParallel(querySets, threads);
+
+        const bool readAll = (next == 0);
+        std::vector<ResultSet> resultSets(querySets.size());
+        for (size_t fileIdx = 0; fileIdx < filenames_.size() && (readAll || next > 0); fileIdx++)
+        {
+            auto file = openFile(fileIdx);
+            if (skipMessages_ > 0)
+            {
+                file->skipMessages(skipMessages_);
+                skipMessages_ -= std::min(skipMessages_, file->messagesRead());
+                if (skipMessages_ > 0)
+                {
+                    messagesRead_[fileIdx] = file->messagesRead();
+                    file->close();
+                    continue;
+                }
+            }
+
+            auto fileResults = file->execute(querySets, next, threads);
+            for (size_t setIdx = 0; setIdx < resultSets.size(); setIdx++)
+            {
+                resultSets[setIdx].merge(std::move(fileResults[setIdx]));
+            }
+
+            if (!readAll) next -= std::min(next, file->messagesProcessed());
+            messagesRead_[fileIdx] = file->messagesRead();
+            file->close();
+        }
+
+        return resultSets;
+    }
+
+    void FileSet::skipMessages(size_t count)
+    {
+        if (file_)
+        {
+            file_->skipMessages(count);
+            return;
+        }
+
+        skipMessages_ += count;
+    }
+
+    std::vector<size_t> FileSet::messagesRead() const
+    {
+        if (file_) return {file_->messagesRead()};
+
+        return messagesRead_;
+    }
+
+    std::vector<MessageRange> FileSet::splitMessages(const std::vector<QuerySet>& querySets,
+                                                     size_t numRanges,
+                                                     size_t maxMessages) const
+    {
+        if (numRanges == 0)
+        {
+            throw eckit::BadParameter("FileSet::splitMessages needs at least one range.");
+        }
+
+        // Which messages the queries run over (and how many subsets they have), the same way
+        // the DataProvider decides it.
+        const auto querySet = querySets.size() > 1 ? QuerySet::unionOf(querySets)
+                                                   : querySets.front();
+
+        std::vector<char> isProcessed;
+        std::vector<size_t> weights;
+        size_t numProcessed = 0;
+        for (size_t fileIdx = 0; fileIdx < filenames_.size(); fileIdx++)
+        {
+            const auto entries = file_ ? file_->dataMessages() : openFile(fileIdx)->dataMessages();
+            for (const auto& entry : entries)
+            {
+                const bool processed =
+                    (maxMessages == 0 || numProcessed < maxMessages) &&
+                    querySet.includesSubset(entry.subset) &&
+                    !(querySet.hasTimeWindow() &&
+                      querySet.timeWindow().excludesMessage(entry.date));
+
+                isProcessed.push_back(processed);
+                weights.push_back(processed ? std::max(entry.numSubsets, 1) : 0);
+                if (processed) numProcessed++;
+            }
+        }
+
+        size_t totalWeight = 0;
+        for (const auto weight : weights) totalWeight += weight;
+
+        // Cut the messages where the running number of subsets passes each share.
+        std::vector<MessageRange> ranges(numRanges);
+        size_t msgIdx = 0;
+        size_t weightSoFar = 0;
+        for (size_t rangeIdx = 0; rangeIdx < numRanges; rangeIdx++)
+        {
+            const bool isLast = (rangeIdx + 1 == numRanges);
+            const size_t rangeEnd = totalWeight * (rangeIdx + 1) / numRanges;
+
+            ranges[rangeIdx].first = msgIdx;
+            while (msgIdx < weights.size() && (isLast || weightSoFar < rangeEnd))
+            {
+                weightSoFar += weights[msgIdx];
+                if (isProcessed[msgIdx]) ranges[rangeIdx].count++;
+                msgIdx++;
+            }
+        }
+
+        return ranges;
+    }
+
+    void FileSet::setTargetCache(const std::shared_ptr<SharedTargetCache>& targetCache)
+    {
+        targetCache_ = targetCache;
+        if (file_) file_->setTargetCache(targetCache_);
+    }
+
+    void FileSet::rewind()
+    {
+        if (file_) file_->rewind();
+
+        std::fill(messagesRead_.begin(), messagesRead_.end(), 0);
+    }
+
+    void FileSet::setNativeDecoding(bool enable)
+    {
+        nativeDecoding_ = enable;
+        if (file_) file_->setNativeDecoding(enable);
+    }
+
+    void FileSet::setReadAhead(bool enable)
+    {
+        readAhead_ = enable;
+        if (file_) file_->setReadAhead(enable);
+    }
+
+    void FileSet::close()
+    {
+        if (file_) file_->close();
+    }
+
+    std::unique_ptr<File> FileSet::openFile(size_t fileIdx) const
+    {
+        auto file = std::make_unique<File>(filenames_[fileIdx],
+                                           wmoTablePath_,
+                                           sidecarPath(indexPath_, fileIdx, ".idx"),
+                                           sidecarPath(tableCachePath_, fileIdx, ".tables"));
+        file->setTargetCache(targetCache_);
+        if (nativeDecoding_) file->setNativeDecoding(true);
+        if (readAhead_) file->setReadAhead(true);
+        return file;
+    }
+
+    std::string FileSet::sidecarPath(const std::string& path,
+                                     size_t fileIdx,
+                                     const std::string& extension) const
+    {
+        if (path.empty() || filenames_.size() == 1) return path;
+
+        return path + "/" + fileName(filenames_[fileIdx]) + extension;
+    }
+
+    std::vector<ResultSet> FileSet::executeParallel(const std::vector<QuerySet>& querySets,
+                                                    size_t threads)
+    {
+        const size_t numWorkers = std::max<size_t>(1, std::min(threads, filenames_.size()));
+        const size_t threadsPerFile = std::max<size_t>(1, threads / numWorkers);
+
+        // The files are handed out one at a time to the threads of the Executor.
+        std::vector<std::vector<ResultSet>> fileResults(filenames_.size());
+        parallelFor(filenames_.size(), numWorkers, [&](size_t fileIdx)
+        {
+            auto file = openFile(fileIdx);
+            fileResults[fileIdx] = file->execute(querySets, 0, threadsPerFile);
+            messagesRead_[fileIdx] = file->messagesRead();
+            file->close();
+        });
+
+        // Merge the files in order.
+        std::vector<ResultSet> resultSets(querySets.size());
+        for (auto& fileResult : fileResults)
+        {
+            for (size_t setIdx = 0; setIdx < resultSets.size(); setIdx++)
+            {
+                resultSets[setIdx].merge(std::move(fileResult[setIdx]));
+            }
+        }
+
+        return resultSets;
+    }
+}  // namespace bufr
+}  // namespace Ingester
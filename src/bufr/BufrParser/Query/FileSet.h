@@ -0,0 +1,152 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "File.h"
+#include "QuerySet.h"
+#include "ResultSet.h"
+#include "TargetCache.h"
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief A range of the messages of a FileSet (see FileSet::splitMessages).
+    struct MessageRange
+    {
+        size_t first = 0;  // Data messages to skip, counted over the files in order
+        size_t count = 0;  // Messages to run the queries over (see File::messagesProcessed)
+    };
+
+    /// \brief A list of BUFR files (ex: the hourly or per satellite dumps of a cycle) that are
+    ///        queried together. The files are decoded concurrently and their data is merged
+    ///        into one ResultSet in the order of the files. The queries are only resolved once
+    ///        for each table structure, no matter how many files use it.
+    class FileSet
+    {
+     public:
+        FileSet() = delete;
+
+        /// \brief Constructor.
+        /// \param filenames Paths or glob patterns (ex: "gdas.*.1bamua.tm00.bufr_d") of the BUFR
+        /// files. Pattern matches are sorted, otherwise the order is kept.
+        /// \param wmoTablePath (Optional) Path to the WMO master tables (for WMO BUFR files).
+        /// \param indexPath (Optional) Path to the message index sidecar file (see File). With
+        /// more than one file this is the directory to keep the sidecars in, named after the
+        /// files (<indexPath>/<file name>.idx).
+        /// \param tableCachePath (Optional) Path to the table cache sidecar file (see File). With
+        /// more than one file this is the directory to keep the sidecars in, named after the
+        /// files (<tableCachePath>/<file name>.tables).
+        explicit FileSet(const std::vector<std::string>& filenames,
+                         const std::string& wmoTablePath = "",
+                         const std::string& indexPath = "",
+                         const std::string& tableCachePath = "");
+
+        /// \brief Expand the glob patterns in a list of paths.
+        /// \param patterns Paths or glob patterns.
+        static std::vector<std::string> expand(const std::vector<std::string>& patterns);
+
+        /// \brief The (expanded) paths of the files.
+        const std::vector<std::string>& filenames() const { return filenames_; }
+
+        /// \brief Execute the queries over the files and merge the data into one ResultSet.
+        /// \param querySet The queries to execute.
+        /// \param next The number of messages worth of data to run, counted over the files in
+        /// order. 0 reads all the messages. A single file keeps its position between calls,
+        /// several files are always read from the start.
+        /// \param threads The number of worker threads. With several files each worker decodes
+        /// whole files (left over threads are used within the files, see File::execute). The
+        /// files are read one after the other when next is given.
+        ResultSet execute(const QuerySet& querySet, size_t next = 0, size_t threads = 1);
+
+        /// \brief Execute several query sets in one pass over the files (see File::execute).
+        /// \return One ResultSet per query set.
+        std::vector<ResultSet> execute(const std::vector<QuerySet>& querySets,
+                                       size_t next = 0,
+                                       size_t threads = 1);
+
+        /// \brief Read past the next data messages (counted over the files in order) without
+        ///        decoding them. Applies to the next call to execute.
+        /// \param count The number of messages to skip.
+        void skipMessages(size_t count);
+
+        /// \brief Get the number of data messages read from each file so far (skipped ones
+        ///        included), in the order of the files. Files that weren't read count 0.
+        std::vector<size_t> messagesRead() const;
+
+        /// \brief Split the messages the query sets run over into contiguous ranges with about
+        ///        the same number of subsets each (ex: one per MPI rank). The ranges come from
+        ///        the message indexes (built for the files that have none), and running them one
+        ///        after the other (skipMessages, then execute with next = count) gives the same
+        ///        data as running all the messages at once. Ranges can be empty (count == 0).
+        /// \param querySets The query sets that will be executed.
+        /// \param numRanges The number of ranges.
+        /// \param maxMessages Only split the first maxMessages messages (0 for all of them).
+        std::vector<MessageRange> splitMessages(const std::vector<QuerySet>& querySets,
+                                                size_t numRanges,
+                                                size_t maxMessages = 0) const;
+
+        /// \brief Share the targets (resolved queries) with other FileSets, ex: the ones a
+        ///        long running process makes for each new file (see File::setTargetCache).
+        /// \param targetCache The shared targets.
+        void setTargetCache(const std::shared_ptr<SharedTargetCache>& targetCache);
+
+        /// \brief Rewind the files to the beginning.
+        void rewind();
+
+        /// \brief Decode the data sections with the native decoder where it can (see
+        ///        File::setNativeDecoding).
+        /// \param enable Use the native decoder.
+        void setNativeDecoding(bool enable);
+
+        /// \brief Read the files through buffers filled ahead of the decoding (see
+        ///        File::setReadAhead).
+        /// \param enable Read ahead.
+        void setReadAhead(bool enable);
+
+        /// \brief Close the files.
+        void close();
+
+     private:
+        const std::vector<std::string> filenames_;
+        const std::string wmoTablePath_;
+        const std::string indexPath_;
+        const std::string tableCachePath_;
+        std::shared_ptr<SharedTargetCache> targetCache_;
+
+        /// \brief A single file is kept open (like a File). Several are only opened while they
+        ///        are being read, since NCEPLIB-bufr can't have many files open at once.
+        std::unique_ptr<File> file_;
+
+        /// \brief Messages to skip before the next execute (several files only).
+        size_t skipMessages_ = 0;
+
+        /// \brief Messages read from each file (several files only, see messagesRead).
+        std::vector<size_t> messagesRead_;
+
+        bool nativeDecoding_ = false;
+        bool readAhead_ = false;
+
+        /// \brief Open one of the files.
+        std::unique_ptr<File> openFile(size_t fileIdx) const;
+
+        /// \brief The path of a sidecar file for one of the files (see the constructor).
+        std::string sidecarPath(const std::string& path,
+                                size_t fileIdx,
+                                const std::string& extension) const;
+
+        /// \brief Execute the query sets over several files with the threads of the Executor.
+        std::vector<ResultSet> executeParallel(const std::vector<QuerySet>& querySets,
+                                               size_t threads);
+    };
+}  // namespace bufr
+}  // namespace Ingester
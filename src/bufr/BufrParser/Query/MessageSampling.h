@@ -0,0 +1,60 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Picks the data messages of a file to read for a quick preview: every k-th one, a
+    ///        random fraction of them, or both. The choice only depends on the position of the
+    ///        message in the file (and the seed), so it is the same however the file is read
+    ///        (in chunks, by parallel workers, over MPI ranks ...). Messages that are left out
+    ///        are skipped like the ones outside of a time window (through a message index they
+    ///        aren't even read).
+    struct MessageSampling
+    {
+        /// \brief Read one data message out of every (1 reads them all).
+        size_t every = 1;
+
+        /// \brief Fraction of the data messages to read (1 reads them all).
+        double fraction = 1.0;
+
+        /// \brief Seed of the random choice (see fraction).
+        std::uint64_t seed = 0;
+
+        /// \brief True if some messages are left out.
+        bool isSampling() const { return every > 1 || fraction < 1.0; }
+
+        /// \brief True if the data message at the given (0 based) position in the file is read.
+        bool includes(size_t msgIdx) const
+        {
+            if (every > 1 && msgIdx % every != 0) return false;
+            if (fraction >= 1.0) return true;
+
+            // splitmix64 of the seed and the position, as a number in [0, 1).
+            std::uint64_t hash = seed + 0x9E3779B97F4A7C15ULL * (msgIdx + 1);
+            hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+            hash = hash ^ (hash >> 31);
+
+            return static_cast<double>(hash >> 11) / static_cast<double>(1ULL << 53) < fraction;
+        }
+
+        bool operator==(const MessageSampling& other) const
+        {
+            return every == other.every && fraction == other.fraction && seed == other.seed;
+        }
+
+        bool operator!=(const MessageSampling& other) const { return !(*this == other); }
+    };
+}  // namespace bufr
+}  // namespace Ingester
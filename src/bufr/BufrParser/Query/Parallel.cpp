@@ -0,0 +1,272 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "Parallel.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+
+namespace
+{
+    /// \brief The CPUs the process may run on.
+    std::vector<int> allowedCpus()
+    {
+        std::vector<int> cpus;
+#ifdef __linux__
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &mask)) cpus.push_back(cpu);
+            }
+        }
+#endif
+        return cpus;
+    }
+
+    void pinThread(std::thread& thread, int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(mask), &mask);
+#endif
+    }
+
+    /// \brief The workers and the queue of jobs.
+    class Pool
+    {
+     public:
+        Pool() : numThreads_(Ingester::bufr::Executor::availableCpus()) {}
+
+        ~Pool() { stop(); }
+
+        void configure(size_t numThreads, bool pinThreads)
+        {
+            stop();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            numThreads_ = numThreads > 0 ? numThreads : Ingester::bufr::Executor::availableCpus();
+            pinThreads_ = pinThreads;
+        }
+
+        size_t numThreads() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return numThreads_;
+        }
+
+        bool isPinningThreads() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return pinThreads_;
+        }
+
+        void post(std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (workers_.empty()) start();
+                jobs_.push_back(std::move(job));
+            }
+
+            jobReady_.notify_one();
+        }
+
+     private:
+        mutable std::mutex mutex_;
+        std::condition_variable jobReady_;
+        std::deque<std::function<void()>> jobs_;
+        std::vector<std::thread> workers_;
+        size_t numThreads_;
+        bool pinThreads_ = false;
+        bool stopping_ = false;
+
+        /// \brief Start the workers (the mutex is held).
+        void start()
+        {
+            const auto cpus = pinThreads_ ? allowedCpus() : std::vector<int>();
+            const size_t numWorkers = std::max<size_t>(1, numThreads_ - 1);
+            for (size_t workerIdx = 0; workerIdx < numWorkers; ++workerIdx)
+            {
+                workers_.emplace_back(&Pool::work, this);
+                if (!cpus.empty()) pinThread(workers_.back(), cpus[workerIdx % cpus.size()]);
+            }
+        }
+
+        /// \brief Let the workers finish the queued jobs and join them.
+        void stop()
+        {
+            std::vector<std::thread> workers;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+                workers.swap(workers_);
+            }
+
+            jobReady_.notify_all();
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = false;
+        }
+
+        void work()
+        {
+            for (;;)
+            {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    jobReady_.wait(lock, [this]() { return !jobs_.empty() || stopping_; });
+                    if (jobs_.empty()) return;
+
+                    job = std::move(jobs_.front());
+                    jobs_.pop_front();
+                }
+
+                job();
+            }
+        }
+    };
+
+    Pool& pool()
+    {
+        static Pool pool;
+        return pool;
+    }
+
+    /// \brief The state of one parallelFor call shared with the workers that help with it.
+    ///        Helpers that start after the loop is closed leave without touching func (which
+    ///        lives on the stack of the calling thread).
+    struct Loop
+    {
+        Loop(size_t count, const std::function<void(size_t)>& func) :
+            count(count),
+            func(func)
+        {
+        }
+
+        const size_t count;
+        const std::function<void(size_t)>& func;
+        std::atomic<size_t> nextIdx{0};
+
+        std::mutex mutex;
+        std::condition_variable helpersDone;
+        size_t numHelpers = 0;
+        bool isClosed = false;
+        std::exception_ptr error;
+
+        void run()
+        {
+            try
+            {
+                for (size_t idx = nextIdx++; idx < count; idx = nextIdx++)
+                {
+                    func(idx);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = std::current_exception();
+                nextIdx = count;
+            }
+        }
+
+        void help()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (isClosed) return;
+                numHelpers++;
+            }
+
+            run();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                numHelpers--;
+            }
+
+            helpersDone.notify_all();
+        }
+    };
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    void Executor::configure(size_t numThreads, bool pinThreads)
+    {
+        pool().configure(numThreads, pinThreads);
+    }
+
+    size_t Executor::numThreads()
+    {
+        return pool().numThreads();
+    }
+
+    bool Executor::isPinningThreads()
+    {
+        return pool().isPinningThreads();
+    }
+
+    size_t Executor::availableCpus()
+    {
+        const auto cpus = allowedCpus();
+        if (!cpus.empty()) return cpus.size();
+
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    void Executor::post(std::function<void()> job)
+    {
+        pool().post(std::move(job));
+    }
+
+    namespace details
+    {
+        void parallelFor(size_t count, size_t numThreads, const std::function<void(size_t)>& func)
+        {
+            auto loop = std::make_shared<Loop>(count, func);
+            for (size_t helperIdx = 1; helperIdx < numThreads; ++helperIdx)
+            {
+                Executor::post([loop]() { loop->help(); });
+            }
+
+            // The calling thread works on the loop too, so it finishes even if every worker is
+            // busy (ex: with the outer loop of a nested one).
+            loop->run();
+
+            std::unique_lock<std::mutex> lock(loop->mutex);
+            loop->isClosed = true;
+            loop->helpersDone.wait(lock, [&loop]() { return loop->numHelpers == 0; });
+
+            if (loop->error) std::rethrow_exception(loop->error);
+        }
+    }  // namespace details
+}  // namespace bufr
+}  // namespace Ingester
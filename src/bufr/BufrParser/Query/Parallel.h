@@ -0,0 +1,90 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief The process wide pool of worker threads every parallel stage runs on (decoding
+    ///        the files, collecting the fields, exporting the variables ...), so nested and
+    ///        concurrent stages share one budget of threads instead of each starting their own.
+    ///        The workers are started on first use.
+    ///
+    ///        By default the pool has one thread per CPU the process may run on (its affinity
+    ///        mask, which is what an MPI launcher binds a rank to), so every rank keeps to its
+    ///        own cores. The thread that starts a loop always works on it too, so a pool of N
+    ///        threads has N - 1 workers.
+    class Executor
+    {
+     public:
+        Executor() = delete;
+
+        /// \brief Set the size of the pool. The workers that exist are stopped (once they have
+        ///        run the jobs they have) and new ones start on the next use, so this should be
+        ///        called before the conversion, not while parallel work is running.
+        /// \param numThreads The number of threads the parallel stages can use (the thread that
+        ///        starts a loop included). 0 uses the CPUs the process may run on.
+        /// \param pinThreads Bind each worker to one of the CPUs the process may run on (in
+        ///        turn), so they don't migrate between cores.
+        static void configure(size_t numThreads, bool pinThreads = false);
+
+        /// \brief The number of threads the parallel stages can use.
+        static size_t numThreads();
+
+        /// \brief True if the workers are bound to CPUs.
+        static bool isPinningThreads();
+
+        /// \brief The number of CPUs in the affinity mask of the process.
+        static size_t availableCpus();
+
+        /// \brief Queue a job for the workers. Jobs must never wait for other queued jobs
+        ///        (they may not have started), parallelFor is built so they don't.
+        /// \param job The job to run.
+        static void post(std::function<void()> job);
+    };
+
+    namespace details
+    {
+        /// \brief The parallel part of parallelFor.
+        void parallelFor(size_t count, size_t numThreads, const std::function<void(size_t)>& func);
+    }  // namespace details
+
+    /// \brief Call func(idx) for every idx in [0, count) using up to numThreads threads of the
+    ///        Executor (the calling thread included). The indices are handed out one at a time
+    ///        so uneven work is balanced between the threads, and idle workers join whatever
+    ///        loop is running, nested ones included. The first exception thrown by func is
+    ///        rethrown once all the threads are done.
+    /// \param count The number of indices.
+    /// \param numThreads The maximum number of threads to use (1 runs everything in the calling
+    ///        thread).
+    /// \param func The function to call.
+    template<typename Func>
+    void parallelFor(size_t count, size_t numThreads, Func func)
+    {
+        numThreads = std::min(numThreads, count);
+        if (numThreads > 1) numThreads = std::min(numThreads, Executor::numThreads());
+
+        if (numThreads <= 1)
+        {
+            for (size_t idx = 0; idx < count; ++idx)
+            {
+                func(idx);
+            }
+
+            return;
+        }
+
+        details::parallelFor(count, numThreads, func);
+    }
+}  // namespace bufr
+}  // namespace Ingester
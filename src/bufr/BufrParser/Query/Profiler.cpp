@@ -0,0 +1,273 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "Profiler.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>  // NOLINT
+#include <sstream>
+
+
+namespace
+{
+    struct TimerStats
+    {
+        std::uint64_t calls = 0;
+        double seconds = 0;
+        double maxSeconds = 0;
+    };
+
+    struct MemoryStats
+    {
+        std::uint64_t maxStartRss = 0;
+        std::uint64_t maxEndRss = 0;
+        std::uint64_t peakRss = 0;  // The high-water mark when the stage last ended
+        std::uint64_t maxPeakGrowth = 0;  // How far one call raised the high-water mark
+    };
+
+    struct Records
+    {
+        std::mutex mutex;
+        std::map<std::string, TimerStats> timers;
+        std::map<std::string, std::uint64_t> counters;
+        std::map<std::string, MemoryStats> memory;
+        std::map<std::string, std::uint64_t> bytes;
+    };
+
+    Records& records()
+    {
+        static Records records;
+        return records;
+    }
+
+    std::string jsonString(const std::string& str)
+    {
+        std::ostringstream ostr;
+        ostr << '"';
+        for (const char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                ostr << '\\' << c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                ostr << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                     << static_cast<int>(c) << std::dec;
+            }
+            else
+            {
+                ostr << c;
+            }
+        }
+
+        ostr << '"';
+        return ostr.str();
+    }
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    std::atomic<bool> Profiler::enabled_(false);
+    std::atomic<bool> Profiler::trackingMemory_(false);
+
+    void Profiler::enable(bool enable, bool trackMemory)
+    {
+        enabled_ = enable;
+        trackingMemory_ = trackMemory;
+    }
+
+    void Profiler::reset()
+    {
+        auto& recs = records();
+        std::lock_guard<std::mutex> lock(recs.mutex);
+        recs.timers.clear();
+        recs.counters.clear();
+        recs.memory.clear();
+        recs.bytes.clear();
+    }
+
+    void Profiler::addCount(const std::string& name, std::uint64_t amount)
+    {
+        auto& recs = records();
+        std::lock_guard<std::mutex> lock(recs.mutex);
+        recs.counters[name] += amount;
+    }
+
+    void Profiler::addTime(const std::string& name, double seconds)
+    {
+        if (!isEnabled()) return;
+
+        auto& recs = records();
+        std::lock_guard<std::mutex> lock(recs.mutex);
+        auto& stats = recs.timers[name];
+        stats.calls++;
+        stats.seconds += seconds;
+        stats.maxSeconds = std::max(stats.maxSeconds, seconds);
+    }
+
+    Profiler::MemorySample Profiler::memory()
+    {
+        MemorySample sample;
+
+        // The second number is the resident pages.
+        std::ifstream statm("/proc/self/statm");
+        std::uint64_t pages = 0;
+        std::uint64_t residentPages = 0;
+        if (statm >> pages >> residentPages)
+        {
+            sample.rss = residentPages * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+        }
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+#ifdef __APPLE__
+            sample.peakRss = static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+            sample.peakRss = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;  // KiB
+#endif
+        }
+
+        sample.peakRss = std::max(sample.peakRss, sample.rss);
+        return sample;
+    }
+
+    void Profiler::addMemory(const std::string& name,
+                             const MemorySample& start,
+                             const MemorySample& end)
+    {
+        if (!isTrackingMemory()) return;
+
+        auto& recs = records();
+        std::lock_guard<std::mutex> lock(recs.mutex);
+        auto& stats = recs.memory[name];
+        stats.maxStartRss = std::max(stats.maxStartRss, start.rss);
+        stats.maxEndRss = std::max(stats.maxEndRss, end.rss);
+        stats.peakRss = std::max(stats.peakRss, end.peakRss);
+        if (end.peakRss > start.peakRss)
+        {
+            stats.maxPeakGrowth = std::max(stats.maxPeakGrowth, end.peakRss - start.peakRss);
+        }
+    }
+
+    void Profiler::recordBytes(const std::string& name, std::uint64_t bytes)
+    {
+        if (!isTrackingMemory()) return;
+
+        auto& recs = records();
+        std::lock_guard<std::mutex> lock(recs.mutex);
+        auto& maxBytes = recs.bytes[name];
+        maxBytes = std::max(maxBytes, bytes);
+    }
+
+    void Profiler::writeJson(std::ostream& out)
+    {
+        auto& recs = records();
+        std::lock_guard<std::mutex> lock(recs.mutex);
+
+        out << "{\n";
+        out << "  \"timers\": {";
+        bool isFirst = true;
+        for (const auto& timer : recs.timers)
+        {
+            out << (isFirst ? "\n" : ",\n") << "    " << jsonString(timer.first) << ": ";
+            out << "{\"calls\": " << timer.second.calls;
+            out << ", \"seconds\": " << timer.second.seconds;
+            out << ", \"max_seconds\": " << timer.second.maxSeconds << "}";
+            isFirst = false;
+        }
+
+        out << (isFirst ? "},\n" : "\n  },\n");
+        out << "  \"counters\": {";
+        isFirst = true;
+        for (const auto& counter : recs.counters)
+        {
+            out << (isFirst ? "\n" : ",\n") << "    " << jsonString(counter.first) << ": "
+                << counter.second;
+            isFirst = false;
+        }
+
+        out << (isFirst ? "}" : "\n  }");
+
+        if (isTrackingMemory())
+        {
+            out << ",\n  \"memory\": {";
+            isFirst = true;
+            for (const auto& stage : recs.memory)
+            {
+                out << (isFirst ? "\n" : ",\n") << "    " << jsonString(stage.first) << ": ";
+                out << "{\"max_start_rss_bytes\": " << stage.second.maxStartRss;
+                out << ", \"max_end_rss_bytes\": " << stage.second.maxEndRss;
+                out << ", \"peak_rss_bytes\": " << stage.second.peakRss;
+                out << ", \"max_peak_growth_bytes\": " << stage.second.maxPeakGrowth << "}";
+                isFirst = false;
+            }
+
+            out << (isFirst ? "}" : "\n  }");
+            out << ",\n  \"max_bytes\": {";
+            isFirst = true;
+            for (const auto& bytes : recs.bytes)
+            {
+                out << (isFirst ? "\n" : ",\n") << "    " << jsonString(bytes.first) << ": "
+                    << bytes.second;
+                isFirst = false;
+            }
+
+            out << (isFirst ? "}" : "\n  }");
+            out << ",\n  \"peak_rss_bytes\": " << memory().peakRss;
+        }
+
+        out << "\n}" << std::endl;
+    }
+
+    std::string Profiler::report()
+    {
+        std::ostringstream out;
+        writeJson(out);
+        return out.str();
+    }
+
+    ScopedTimer::ScopedTimer(const char* name) :
+        isRunning_(Profiler::isEnabled())
+    {
+        if (!isRunning_) return;
+
+        name_ = name;
+        if (Profiler::isTrackingMemory()) startMemory_ = Profiler::memory();
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    ScopedTimer::ScopedTimer(const char* prefix, const std::string& name) :
+        isRunning_(Profiler::isEnabled())
+    {
+        if (!isRunning_) return;
+
+        name_ = std::string(prefix) + name;
+        if (Profiler::isTrackingMemory()) startMemory_ = Profiler::memory();
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    ScopedTimer::~ScopedTimer()
+    {
+        if (!isRunning_) return;
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+        Profiler::addTime(name_, elapsed.count());
+        if (Profiler::isTrackingMemory())
+        {
+            Profiler::addMemory(name_, startMemory_, Profiler::memory());
+        }
+    }
+}  // namespace bufr
+}  // namespace Ingester
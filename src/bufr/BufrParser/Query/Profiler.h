@@ -0,0 +1,135 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Process wide timers and counters for the stages of a conversion (decoding,
+    ///        collecting the fields, filters, splits, variables, encoding ...), reported as
+    ///        JSON (bufr2ioda.x --profile). Off by default, in which case the timers and
+    ///        counters cost a flag check. Timers that run on several threads at once add up
+    ///        the time of every thread.
+    ///
+    ///        With memory tracking the timers also sample the resident memory when their stage
+    ///        starts and ends, and the process high-water mark, so the report shows which stage
+    ///        raised the peak (stages that overlap on other threads share the blame). The
+    ///        largest sizes of the data structures (see recordBytes) are reported too.
+    class Profiler
+    {
+     public:
+        /// \brief The memory of the process at some point.
+        struct MemorySample
+        {
+            std::uint64_t rss = 0;  // Resident memory (bytes)
+            std::uint64_t peakRss = 0;  // Highest resident memory so far (bytes)
+        };
+
+        Profiler() = delete;
+
+        /// \brief True if the timers and counters are recorded.
+        static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+        /// \brief True if the timers also sample the memory.
+        static bool isTrackingMemory()
+        {
+            return isEnabled() && trackingMemory_.load(std::memory_order_relaxed);
+        }
+
+        /// \brief Turn the recording on or off.
+        /// \param enable Record the timers and counters.
+        /// \param trackMemory Also sample the memory at the start and end of the stages.
+        static void enable(bool enable = true, bool trackMemory = false);
+
+        /// \brief Forget everything that was recorded.
+        static void reset();
+
+        /// \brief Add to a counter (when enabled).
+        /// \param name The name of the counter.
+        /// \param amount The amount to add.
+        static void count(const std::string& name, std::uint64_t amount = 1)
+        {
+            if (isEnabled()) addCount(name, amount);
+        }
+
+        /// \brief Add to a counter (when enabled), without making a string when it isn't.
+        static void count(const char* name, std::uint64_t amount = 1)
+        {
+            if (isEnabled()) addCount(name, amount);
+        }
+
+        /// \brief Add a call to a timer (when enabled).
+        /// \param name The name of the timer.
+        /// \param seconds The duration of the call.
+        static void addTime(const std::string& name, double seconds);
+
+        /// \brief Get the memory of the process now.
+        static MemorySample memory();
+
+        /// \brief Add the memory samples of a call to a timer (when tracking memory).
+        /// \param name The name of the timer.
+        /// \param start The memory when the stage started.
+        /// \param end The memory when the stage ended.
+        static void addMemory(const std::string& name,
+                              const MemorySample& start,
+                              const MemorySample& end);
+
+        /// \brief Record the size of a data structure (when tracking memory). The largest size
+        ///        recorded for each name is reported.
+        /// \param name The name of the data structure (ex: "query.result_set").
+        /// \param bytes Its size.
+        static void recordBytes(const std::string& name, std::uint64_t bytes);
+
+        /// \brief Write the timers (calls, total and longest seconds), the counters and the
+        ///        memory (with memory tracking) as JSON.
+        /// \param out The stream to write to.
+        static void writeJson(std::ostream& out);
+
+        /// \brief Get the JSON report (see writeJson).
+        static std::string report();
+
+     private:
+        static std::atomic<bool> enabled_;
+        static std::atomic<bool> trackingMemory_;
+
+        static void addCount(const std::string& name, std::uint64_t amount);
+    };
+
+    /// \brief Times its own scope into a Profiler timer.
+    class ScopedTimer
+    {
+     public:
+        /// \brief Start the timer (if the Profiler is enabled).
+        /// \param name The name of the timer.
+        explicit ScopedTimer(const char* name);
+
+        /// \brief Start the timer named prefix + name, which is only put together when the
+        ///        Profiler is enabled.
+        ScopedTimer(const char* prefix, const std::string& name);
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        /// \brief Stop the timer and record it.
+        ~ScopedTimer();
+
+     private:
+        const bool isRunning_;
+        std::string name_;
+        std::chrono::steady_clock::time_point start_;
+        Profiler::MemorySample startMemory_;
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -15,9 +15,12 @@
 #endif
 
 #include "Constants.h"
+#include "Data.h"
 #include "SubsetTable.h"
 #include "VectorMath.h"
+#include "Profiler.h"
 #include "SubsetLookupTable.h"
+#include "TargetCache.h"
 
 
 namespace Ingester {
@@ -25,28 +28,214 @@ namespace bufr
 {
     QueryRunner::QueryRunner(const QuerySet &querySet,
                              ResultSet &resultSet,
-                             const DataProviderType &dataProvider) :
+                             const DataProviderType &dataProvider,
+                             const std::shared_ptr<SharedTargetCache>& sharedTargets) :
         querySet_(querySet),
         resultSet_(resultSet),
-        dataProvider_(dataProvider)
+        dataProvider_(dataProvider),
+        sharedTargets_(sharedTargets)
     {
     }
 
     void QueryRunner::accumulate()
     {
-        resultSet_.addFrame(SubsetLookupTable(dataProvider_, getTargets()));
+        frame_.load(dataProvider_, getLayout());
+
+        if (!querySet_.valueConstraints().empty() &&
+            !resultSet_.empty() &&
+            !isAllowed(frame_, getConstraintTargets()))
+        {
+            return;
+        }
+
+        resultSet_.addFrame(frame_);
+    }
+
+    void QueryRunner::capture(CapturedSubset& subset)
+    {
+        SubsetLookupTable::capture(dataProvider_, getLayout(), subset.snapshot);
+
+        subset.constraintTargets = nullptr;
+        if (!querySet_.valueConstraints().empty())
+        {
+            // The cached targets don't move, so the workers can use them while more are added.
+            subset.constraintTargets = &getConstraintTargets();
+        }
+
+        subset.isFirst = !hasCaptured_;
+        hasCaptured_ = true;
+    }
+
+    void QueryRunner::accumulate(const CapturedSubset& subset,
+                                 SubsetLookupTable& frame,
+                                 ResultSet& resultSet) const
+    {
+        frame.load(subset.snapshot);
+
+        if (subset.constraintTargets != nullptr &&
+            !subset.isFirst &&
+            !isAllowed(frame, *subset.constraintTargets))
+        {
+            return;
+        }
+
+        resultSet.addFrame(frame);
+    }
+
+    bool QueryRunner::isAllowed(const SubsetLookupTable& frame,
+                                const std::vector<TargetPtr>& targets) const
+    {
+        const auto& constraints = querySet_.valueConstraints();
+
+        for (size_t constraintIdx = 0; constraintIdx < constraints.size(); ++constraintIdx)
+        {
+            const auto& constraint = constraints[constraintIdx];
+            const auto& target = targets[constraintIdx];
+            if (!target) continue;
+
+            // Rows without values (the query doesn't apply or wasn't repeated) are missing.
+            const auto data = target->nodeIdx == 0 ? SubsetLookupTable::DataView()
+                                                   : frame.data(target->nodeIdx);
+            if (data.isLongStr) continue;
+
+            bool isAnyAllowed = data.octets.empty() && constraint.allowsMissing;
+            for (const auto value : data.octets)
+            {
+                if (Data::isMissingOctet(value) ? constraint.allowsMissing
+                                                : constraint.allows(value))
+                {
+                    isAnyAllowed = true;
+                    break;
+                }
+            }
+
+            if (!isAnyAllowed) return false;
+        }
+
+        return true;
+    }
+
+    QueryRunner::VariantCache& QueryRunner::variantCache()
+    {
+        const auto variantIdx = dataProvider_->getVariantIndex();
+        if (variantIdx >= variantCaches_.size()) variantCaches_.resize(variantIdx + 1);
+
+        auto& cache = variantCaches_[variantIdx];
+        if (cache == nullptr) cache = std::make_unique<VariantCache>();
+
+        return *cache;
+    }
+
+    const std::vector<TargetPtr>& QueryRunner::getConstraintTargets()
+    {
+        auto& cache = variantCache();
+        if (cache.hasConstraintTargets)
+        {
+            return cache.constraintTargets;
+        }
+
+        const auto targets = getTargets();
+
+        std::vector<TargetPtr> constraintTargets;
+        for (const auto& constraint : querySet_.valueConstraints())
+        {
+            TargetPtr constraintTarget;
+            for (const auto& target : *targets)
+            {
+                if (target->name == constraint.name)
+                {
+                    constraintTarget = target;
+                    break;
+                }
+            }
+
+            constraintTargets.push_back(constraintTarget);
+        }
+
+        cache.constraintTargets = std::move(constraintTargets);
+        cache.hasConstraintTargets = true;
+        return cache.constraintTargets;
+    }
+
+    std::shared_ptr<const SubsetLookupLayout> QueryRunner::getLayout()
+    {
+        auto& cache = variantCache();
+        if (cache.layout == nullptr)
+        {
+            cache.layout = std::make_shared<const SubsetLookupLayout>(dataProvider_, getTargets());
+        }
+
+        return cache.layout;
     }
 
     std::shared_ptr<Targets> QueryRunner::getTargets()
     {
         // Attempt to get targets from the cache
-        if (targetsCache_.find(dataProvider_->getSubsetVariant()) != targetsCache_.end())
+        auto& cache = variantCache();
+        if (cache.targets != nullptr)
+        {
+            Profiler::count("targets.runner_hits");
+            return cache.targets;
+        }
+
+        std::shared_ptr<Targets> targets;
+        if (sharedTargets_)
+        {
+            targets = sharedTargets_->find(dataProvider_, querySet_);
+            if (targets != nullptr)
+            {
+                Profiler::count("targets.shared_hits");
+                cache.targets = targets;
+                return targets;
+            }
+        }
+
+        if (!querySet_.planCacheDir().empty())
+        {
+            const auto planCache = TargetCache(querySet_.planCacheDir());
+            targets = planCache.load(dataProvider_, querySet_);
+
+            if (targets != nullptr)
+            {
+                Profiler::count("targets.plan_cache_hits");
+                for (const auto& target : *targets)
+                {
+                    if (target->nodeIdx == 0) warnMissingTarget(target->queryStr);
+                }
+            }
+            else
+            {
+                targets = compileTargets();
+                planCache.store(dataProvider_, querySet_, *targets);
+            }
+        }
+        else
+        {
+            targets = compileTargets();
+        }
+
+        // Targets with the same query string share their data (see QuerySet::sharedHandle).
+        for (size_t targetIdx = 0; targetIdx < targets->size(); ++targetIdx)
         {
-            return targetsCache_.at(dataProvider_->getSubsetVariant());
+            (*targets)[targetIdx]->sharedIdx = querySet_.sharedHandle(targetIdx);
         }
 
+        // Cache the targets and masks we just found
+        cache.targets = targets;
+        if (sharedTargets_) sharedTargets_->insert(dataProvider_, querySet_, targets);
+
+        return targets;
+    }
+
+    std::shared_ptr<Targets> QueryRunner::compileTargets()
+    {
+        Profiler::count("targets.compiled");
+        ScopedTimer timer("targets.compile");
+
         auto table = SubsetTable(dataProvider_);
+        std::vector<size_t> nodes;
 
+        const auto variant = dataProvider_->getSubsetVariant();
         const auto targets = std::make_shared<Targets>();
         targets->reserve(querySet_.names().size());
         for (const auto &name : querySet_.names())
@@ -54,16 +243,16 @@ namespace bufr
             // Find the table node for the query. Loop through all the sub-queries until you find
             // one.
             Query foundQuery;
-            std::shared_ptr<BufrNode> tableNode;
+            size_t tableNodeId = BufrNode::NoNode;
             for (const auto &query : querySet_.queriesFor(name))
             {
                 if (query.subset->isAnySubset ||
-                    (query.subset->name == dataProvider_->getSubsetVariant().subset &&
-                     query.subset->index == dataProvider_->getSubsetVariant().variantId))
+                    (query.subset->name == variant.subset &&
+                     query.subset->index == variant.variantId))
                 {
-                    tableNode = table.getNodeForPath(query.path);
+                    tableNodeId = table.getNodeForPath(query.path);
                     foundQuery = query;
-                    if (tableNode != nullptr) break;
+                    if (tableNodeId != BufrNode::NoNode) break;
                 }
             }
 
@@ -71,7 +260,7 @@ namespace bufr
 
             // There was no corresponding table node for any of the sub-queries so create empty
             // target.
-            if (tableNode == nullptr)
+            if (tableNodeId == BufrNode::NoNode)
             {
                 // Create empty target
                 target->name = name;
@@ -82,23 +271,7 @@ namespace bufr
                 target->exportDimIdxs = {0};
                 targets->push_back(target);
 
-#ifdef BUILD_IODA_BINDING
-                // Print message to inform the user of the missing targets
-                oops::Log::warning() << "Warning: Query String ";
-                oops::Log::warning() << querySet_.queriesFor(name)[0].str();
-                oops::Log::warning() << " didn't apply to subset ";
-                oops::Log::warning() << dataProvider_->getSubsetVariant().str();
-                oops::Log::warning() << std::endl;
-#endif
-
-#ifndef BUILD_IODA_BINDING
-                std::cout << "Warning: Query String ";
-                std::cout << querySet_.queriesFor(name)[0].str();
-                std::cout << " didn't apply to subset ";
-                std::cout << dataProvider_->getSubsetVariant().str();
-                std::cout << std::endl;
-#endif
-
+                warnMissingTarget(target->queryStr);
                 continue;
             }
 
@@ -111,37 +284,56 @@ namespace bufr
 
             int pathIdx = 0;
             path[pathIdx].queryComponent = foundQuery.subset;
-            path[pathIdx].nodeId = table.getRoot()->nodeIdx;
+            path[pathIdx].nodeId = table.getRoot().nodeIdx;
             path[pathIdx].parentNodeId = 0;
             path[pathIdx].parentDimensionNodeId = 0;
             path[pathIdx].setType(Typ::Subset);
             pathIdx++;
 
-            auto nodes = tableNode->getPathNodes();
+            table.getPathNodes(tableNodeId, nodes);
             for (size_t nodeIdx = 1; nodeIdx < nodes.size(); nodeIdx++)
             {
+                const auto& node = table.getNode(nodes[nodeIdx]);
                 path[pathIdx].queryComponent = foundQuery.path[nodeIdx - 1];
-                path[pathIdx].nodeId = nodes[nodeIdx]->nodeIdx;
-                path[pathIdx].parentNodeId = nodes[nodeIdx]->getParent()->nodeIdx;
-                path[pathIdx].parentDimensionNodeId =
-                    nodes[nodeIdx]->getDimensionParent()->nodeIdx;
-                path[pathIdx].setType(nodes[nodeIdx]->type);
-                path[pathIdx].fixedRepeatCount = nodes[nodeIdx]->fixedRepCount;
+                path[pathIdx].nodeId = node.nodeIdx;
+                path[pathIdx].parentNodeId = table.getNode(node.parent).nodeIdx;
+                path[pathIdx].parentDimensionNodeId = table.getNode(node.dimParent).nodeIdx;
+                path[pathIdx].setType(node.type);
+                path[pathIdx].fixedRepeatCount = node.fixedRepCount;
                 pathIdx++;
             }
 
+            const auto& tableNode = table.getNode(tableNodeId);
             target->setPath(path);
-            target->typeInfo = tableNode->typeInfo;
-            target->nodeIdx = tableNode->nodeIdx;
-            target->longStrId = tableNode->mnemonic + "#" + std::to_string(tableNode->mnemonicIdx);
+            target->typeInfo = tableNode.typeInfo;
+            target->nodeIdx = tableNode.nodeIdx;
+            target->longStrId = table.getMnemonic(tableNodeId) + "#" +
+                                std::to_string(tableNode.mnemonicIdx);
 
             targets->push_back(target);
         }
 
-        // Cache the targets and masks we just found
-        targetsCache_.insert({dataProvider_->getSubsetVariant(), targets});
-
         return targets;
     }
+
+    void QueryRunner::warnMissingTarget(const std::string& queryStr) const
+    {
+#ifdef BUILD_IODA_BINDING
+        // Print message to inform the user of the missing targets
+        oops::Log::warning() << "Warning: Query String ";
+        oops::Log::warning() << queryStr;
+        oops::Log::warning() << " didn't apply to subset ";
+        oops::Log::warning() << dataProvider_->getSubsetVariant().str();
+        oops::Log::warning() << std::endl;
+#endif
+
+#ifndef BUILD_IODA_BINDING
+        std::cout << "Warning: Query String ";
+        std::cout << queryStr;
+        std::cout << " didn't apply to subset ";
+        std::cout << dataProvider_->getSubsetVariant().str();
+        std::cout << std::endl;
+#endif
+    }
 }  // namespace bufr
 }  // namespace Ingester
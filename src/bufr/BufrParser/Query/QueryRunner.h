@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <memory>
 #include <unordered_map>
 
 #include "QuerySet.h"
@@ -17,6 +18,8 @@
 #include "DataProvider/DataProvider.h"
 #include "DataProvider/SubsetVariant.h"
 #include "Target.h"
+#include "TargetCache.h"
+#include "SubsetLookupTable.h"
 
 namespace Ingester {
 namespace bufr {
@@ -29,25 +32,94 @@ namespace bufr {
         /// \param[in] querySet The set of queries to execute against the BUFR file.
         /// \param[in, out] resultSet The object used to store the accumulated collected data.
         /// \param[in] dataProvider The BUFR data provider to use.
+        /// \param[in] sharedTargets (Optional) Targets shared with other runners, so each table
+        /// structure only has its queries resolved once.
         QueryRunner(const QuerySet& querySet,
                     ResultSet& resultSet,
-                    const DataProviderType& dataProvider);
+                    const DataProviderType& dataProvider,
+                    const std::shared_ptr<SharedTargetCache>& sharedTargets = nullptr);
 
         /// \brief Run the queries against the currently open BUFR message subset. Collect the
-        /// results into the ResultSet.
+        /// results into the ResultSet, unless the subset has no values the value constraints of
+        /// the QuerySet allow (the first subset is always collected so the ResultSet isn't
+        /// empty).
         void accumulate();
 
+        /// \brief A subset copied on the thread that decodes the file, to be collected later
+        /// (see capture).
+        struct CapturedSubset
+        {
+            SubsetLookupTable::Snapshot snapshot;
+            const std::vector<TargetPtr>* constraintTargets = nullptr;
+            bool isFirst = false;
+        };
+
+        /// \brief Copy the currently open BUFR message subset so it can be collected with
+        /// accumulate(subset, ...) once NCEPLIB-bufr moved on. Resolves the queries for the
+        /// subset if needed, so it must be called from within DataProvider::run, like
+        /// accumulate().
+        /// \param[out] subset The captured subset (its storage is reused).
+        void capture(CapturedSubset& subset);
+
+        /// \brief Collect a captured subset into a ResultSet (with the same value constraints as
+        /// accumulate()). Only reads the captured subset, so several threads can collect the
+        /// subsets captured by the same runner at once (each with its own frame and ResultSet).
+        /// \param[in] subset The captured subset.
+        /// \param[in, out] frame The lookup table to load the subset into (storage is reused).
+        /// \param[in, out] resultSet The ResultSet to add the subset to.
+        void accumulate(const CapturedSubset& subset,
+                        SubsetLookupTable& frame,
+                        ResultSet& resultSet) const;
+
      private:
         const QuerySet querySet_;
         ResultSet& resultSet_;
         const DataProviderType& dataProvider_;
+        const std::shared_ptr<SharedTargetCache> sharedTargets_;
+
+        /// \brief What is cached for a subset variant.
+        struct VariantCache
+        {
+            std::shared_ptr<Targets> targets;
+            std::shared_ptr<const SubsetLookupLayout> layout;
+            std::vector<TargetPtr> constraintTargets;
+            bool hasConstraintTargets = false;
+        };
+
+        /// \brief The caches of the subset variants by their index (see
+        /// DataProvider::getVariantIndex). They don't move once they are made.
+        std::vector<std::unique_ptr<VariantCache>> variantCaches_;
+        SubsetLookupTable frame_;
+        bool hasCaptured_ = false;
 
-        std::unordered_map<SubsetVariant, std::shared_ptr<Targets>> targetsCache_;
+        /// \brief Get the cache for the currently active BUFR message subset.
+        VariantCache& variantCache();
 
         /// \brief Look for the list of targets for the currently active BUFR message subset that
         /// apply to the QuerySet and cache them.
         /// \param[in, out] targets The list of targets to populate.
         std::shared_ptr<Targets> getTargets();
+
+        /// \brief Resolve the queries against the table of the currently active BUFR message
+        /// subset (the expensive part of getTargets).
+        std::shared_ptr<Targets> compileTargets();
+
+        /// \brief Tell the user a query didn't apply to the currently active subset.
+        /// \param[in] queryStr The query string.
+        void warnMissingTarget(const std::string& queryStr) const;
+
+        /// \brief Is some value of every constrained query in the frame allowed?
+        /// \param[in] frame The frame.
+        /// \param[in] targets The targets of the value constraints (see getConstraintTargets).
+        bool isAllowed(const SubsetLookupTable& frame, const std::vector<TargetPtr>& targets) const;
+
+        /// \brief Get the (cached) targets of the value constraints of the QuerySet for the
+        /// currently active BUFR message subset (null for constraints on unknown queries).
+        const std::vector<TargetPtr>& getConstraintTargets();
+
+        /// \brief Get the (cached) layout of the lookup tables for the currently active BUFR
+        /// message subset.
+        std::shared_ptr<const SubsetLookupLayout> getLayout();
     };
 }  // namespace bufr
 }  // namespace Ingester
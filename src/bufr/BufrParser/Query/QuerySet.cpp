@@ -9,6 +9,8 @@
 
 #include <algorithm>
 
+#include "eckit/exception/Exceptions.h"
+
 
 namespace Ingester {
 namespace bufr {
@@ -75,11 +77,76 @@ namespace bufr {
             queries.emplace_back(query);
         }
 
+        if (queryMap_.find(name) == queryMap_.end())
+        {
+            names_.push_back(name);
+        }
+
         queryMap_[name] = queries;
+        queryStrs_[name] = queryStr;
+        updateSharedHandles();
+    }
+
+    void QuerySet::updateSharedHandles()
+    {
+        std::unordered_map<std::string, FieldHandle> firstHandles;  // By query string
+        sharedHandles_.resize(names_.size());
+        for (size_t handle = 0; handle < names_.size(); ++handle)
+        {
+            sharedHandles_[handle] =
+                firstHandles.emplace(queryStrs_.at(names_[handle]), handle).first->second;
+        }
+    }
+
+    QuerySet QuerySet::unionOf(const std::vector<QuerySet>& querySets)
+    {
+        QuerySet combined;
+        combined.unionOf_.reserve(querySets.size());
+        for (const auto& querySet : querySets)
+        {
+            combined.unionOf_.push_back(querySet);
+        }
+
+        for (const auto& querySet : querySets)
+        {
+            if (querySet.hasTimeWindow_ != querySets.front().hasTimeWindow_ ||
+                (querySet.hasTimeWindow_ &&
+                 (querySet.timeWindow_.start != querySets.front().timeWindow_.start ||
+                  querySet.timeWindow_.end != querySets.front().timeWindow_.end ||
+                  querySet.timeWindow_.margin != querySets.front().timeWindow_.margin)))
+            {
+                throw eckit::BadParameter(
+                    "QuerySet::unionOf: The query sets have different time windows.");
+            }
+
+            if (querySet.sampling_ != querySets.front().sampling_)
+            {
+                throw eckit::BadParameter(
+                    "QuerySet::unionOf: The query sets sample different messages.");
+            }
+        }
+
+        if (!querySets.empty() && querySets.front().hasTimeWindow_)
+        {
+            combined.setTimeWindow(querySets.front().timeWindow_);
+        }
+
+        if (!querySets.empty()) combined.setSampling(querySets.front().sampling_);
+
+        return combined;
     }
 
     bool QuerySet::includesSubset(const std::string& subset) const
     {
+        if (!unionOf_.empty())
+        {
+            return std::any_of(unionOf_.begin(), unionOf_.end(),
+                               [&subset](const QuerySet& querySet)
+                               {
+                                   return querySet.includesSubset(subset);
+                               });
+        }
+
         bool includesSubset = true;
         if (!includesAllSubsets_)
         {
@@ -96,15 +163,15 @@ namespace bufr {
         return includesSubset;
     }
 
-    std::vector<std::string> QuerySet::names() const
+    QuerySet::FieldHandle QuerySet::handleFor(const std::string& name) const
     {
-        std::vector<std::string> names;
-        for (auto const& query : queryMap_)
+        const auto nameIt = std::find(names_.begin(), names_.end(), name);
+        if (nameIt == names_.end())
         {
-            names.push_back(query.first);
+            throw eckit::BadParameter("QuerySet::handleFor: There is no query named " + name + ".");
         }
 
-        return names;
+        return static_cast<FieldHandle>(nameIt - names_.begin());
     }
 
     std::vector<Query> QuerySet::queriesFor(const std::string& name) const
@@ -7,13 +7,17 @@
 
 #pragma once
 
+#include <limits>
 #include <unordered_map>
 #include <vector>
 #include <set>
 #include <string>
 #include <map>
 
+#include "MessageSampling.h"
 #include "QueryParser.h"
+#include "TimeWindow.h"
+#include "ValueConstraint.h"
 
 namespace Ingester {
 namespace bufr
@@ -26,6 +30,12 @@ namespace bufr
     class QuerySet
     {
      public:
+        /// \brief Integer handle of a query (field) name, see handleFor.
+        typedef size_t FieldHandle;
+
+        /// \brief Handle that doesn't refer to any field (ex: no group_by field).
+        static constexpr FieldHandle NoHandle = std::numeric_limits<size_t>::max();
+
         QuerySet();
         explicit QuerySet(const std::vector<std::string>& subsets);
         ~QuerySet() = default;
@@ -38,9 +48,23 @@ namespace bufr
         /// \brief Returns the size of the collection.
         size_t size() const { return queryMap_.size(); }
 
-        /// \brief Returns the names of all the queries.
+        /// \brief Returns the names of all the queries (in the order they were first added).
         /// \return A vector of the names of all the queries.
-        std::vector<std::string> names() const;
+        const std::vector<std::string>& names() const { return names_; }
+
+        /// \brief Returns the handle of a query name: its position in names(), which is also
+        ///        the position of its target in the ResultSets made with this QuerySet. Looking
+        ///        fields up by handle (ex: ResultSet::get) avoids comparing names.
+        /// \param[in] name The name of the query.
+        /// \return The handle.
+        FieldHandle handleFor(const std::string& name) const;
+
+        /// \brief Returns the handle of the first query that has the same query string as the
+        ///        given one (the handle itself if there is none). Fields with the same query
+        ///        string share their target data in the ResultSets (it is collected once).
+        /// \param[in] handle The handle of the query.
+        /// \return The handle of the first query with the same query string.
+        FieldHandle sharedHandle(FieldHandle handle) const { return sharedHandles_.at(handle); }
 
         /// \brief Returns a list of subsets.
         /// \return A vector of the names of all the queries.
@@ -51,12 +75,74 @@ namespace bufr
         /// \return A vector of queries.
         std::vector<Query> queriesFor(const std::string& name) const;
 
+        /// \brief Only collect the data that falls within a time window. Messages that are
+        ///        entirely outside of it (according to their dates) aren't decoded.
+        /// \param[in] timeWindow The time window.
+        void setTimeWindow(const TimeWindow& timeWindow)
+        {
+            timeWindow_ = timeWindow;
+            hasTimeWindow_ = true;
+        }
+
+        /// \brief True if a time window was set.
+        bool hasTimeWindow() const { return hasTimeWindow_; }
+
+        /// \brief Get the time window (see hasTimeWindow).
+        const TimeWindow& timeWindow() const { return timeWindow_; }
+
+        /// \brief Only read some of the data messages (see MessageSampling), ex: for a quick
+        ///        preview of a large file. The messages that are left out aren't decoded and
+        ///        don't count as processed (see File::execute).
+        /// \param[in] sampling The messages to read.
+        void setSampling(const MessageSampling& sampling) { sampling_ = sampling; }
+
+        /// \brief Get the message sampling (reads every message unless it was set).
+        const MessageSampling& sampling() const { return sampling_; }
+
+        /// \brief Only collect the subsets where some value of a query is allowed by the
+        ///        constraint. The subsets that are dropped don't count towards the dimensions of
+        ///        the data (which is then as if the file only had the other subsets).
+        /// \param[in] constraint The constraint (for one of the queries of the set).
+        void addValueConstraint(const ValueConstraint& constraint)
+        {
+            valueConstraints_.push_back(constraint);
+        }
+
+        /// \brief Get the value constraints (see addValueConstraint).
+        const std::vector<ValueConstraint>& valueConstraints() const { return valueConstraints_; }
+
+        /// \brief Store the compiled query plans (see TargetCache) in a directory so later runs
+        ///        on the same kind of data don't have to compile them again.
+        /// \param[in] cacheDir The (existing) directory for the plans. Empty disables the cache.
+        void setPlanCacheDir(const std::string& cacheDir) { planCacheDir_ = cacheDir; }
+
+        /// \brief Get the query plan cache directory (empty if there is none).
+        const std::string& planCacheDir() const { return planCacheDir_; }
+
+        /// \brief Make a QuerySet that includes the subsets of all the given ones, used to read
+        ///        a file once on behalf of several query sets. It has no queries of its own. The
+        ///        query sets must all have the same time window (or none) and sampling.
+        /// \param[in] querySets The query sets to combine.
+        static QuerySet unionOf(const std::vector<QuerySet>& querySets);
+
      private:
         std::unordered_map<std::string, std::vector<Query>> queryMap_;
+        std::vector<std::string> names_;
+        std::unordered_map<std::string, std::string> queryStrs_;  // By name
+        std::vector<FieldHandle> sharedHandles_;  // Per name (see sharedHandle)
         bool includesAllSubsets_;
         bool addHasBeenCalled_;
         const Subsets limitSubsets_;
         Subsets presentSubsets_;
+        bool hasTimeWindow_ = false;
+        TimeWindow timeWindow_;
+        MessageSampling sampling_;
+        std::string planCacheDir_;
+        std::vector<ValueConstraint> valueConstraints_;
+        std::vector<QuerySet> unionOf_;  // The combined query sets (see unionOf)
+
+        /// \brief Find the first name with the same query string for every name.
+        void updateSharedHandles();
     };
 }  // namespace bufr
 }  // namespace Ingester
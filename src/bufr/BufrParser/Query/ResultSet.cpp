@@ -14,7 +14,6 @@
 #include <iostream>
 
 #ifdef BUILD_PYTHON_BINDING
-    #include <time.h>
     #include <pybind11/pybind11.h>
     #include <pybind11/numpy.h>
     #include <pybind11/stl.h>
@@ -23,43 +22,648 @@
 #endif
 
 #include "Constants.h"
+#include "EpochTime.h"
 #include "VectorMath.h"
+#include "Parallel.h"
 
 
 namespace Ingester {
 namespace bufr {
+namespace {
+
+    /// \brief Copy count values starting at begin, converting the octets to the narrow storage
+    ///        types.
+    template<typename T>
+    void copyValues(const gsl::span<const double>& values, size_t begin, size_t count, T* output)
+    {
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            output[idx] = Data::narrow<T>(values[begin + idx]);
+        }
+    }
+
+    inline void copyValues(const gsl::span<const double>& values,
+                           size_t begin,
+                           size_t count,
+                           double* output)
+    {
+        std::copy(values.data() + begin, values.data() + begin + count, output);
+    }
+
+    inline void copyValues(const LongStrSpan& values,
+                           size_t begin,
+                           size_t count,
+                           std::string* output)
+    {
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            const auto& ref = values.refs[begin + idx];
+            output[idx].assign(values.chars + ref.offset, ref.size);
+        }
+    }
+
+    /// \brief The values of a frame that go into data stored as T (long strings or octets).
+    template<typename T>
+    gsl::span<const double> frameValues(const SubsetLookupTable::DataView& view, const T*)
+    {
+        return view.isLongStr ? gsl::span<const double>() : view.octets;
+    }
+
+    inline LongStrSpan frameValues(const SubsetLookupTable::DataView& view, const std::string*)
+    {
+        return view.isLongStr ? view.strings : LongStrSpan();
+    }
+
+    /// \brief Call func with a (default) value of the type the storage holds, so generic code
+    ///        can be written once for all the storage types.
+    template<typename Func>
+    void withStorageType(Data::Storage storage, Func&& func)
+    {
+        switch (storage)
+        {
+            case Data::Storage::Strings: func(std::string()); break;
+            case Data::Storage::Floats: func(float()); break;
+            case Data::Storage::Ints: func(int32_t()); break;
+            default: func(double());
+        }
+    }
+
+    /// \brief Broadcasts each of the first numValues values of the input numReps times onto the
+    ///        end of the output. The output is written once (it isn't filled with missing values
+    ///        first) and a single repetition is a plain copy.
+    template<typename T>
+    void replicateValues(const std::vector<T>& input,
+                         size_t numValues,
+                         size_t numReps,
+                         std::vector<T>& output)
+    {
+        if (output.empty()) output = BufferPool::take<T>(numValues * numReps);
+
+        if (numReps == 1)
+        {
+            output.insert(output.end(), input.begin(), input.begin() + numValues);
+            return;
+        }
+
+        output.reserve(output.size() + numValues * numReps);
+        for (size_t valueIdx = 0; valueIdx < numValues; ++valueIdx)
+        {
+            output.insert(output.end(), numReps, input[valueIdx]);
+        }
+    }
+
+    /// \brief The least number of runs of a field analyzed as a part of its own (see
+    ///        ResultSet::analyzeTargets).
+    const size_t MinAnalysisRuns = 4096;
+
+    /// \brief The least number of values of a field copied as a range of its own (see
+    ///        ResultSet::assembleData).
+    const size_t MinAssemblyValues = 1 << 18;
+
+    /// \brief The number of ranges the copy of a large field is split into per thread (so the
+    ///        threads stay busy when the ranges take uneven times).
+    const size_t RangesPerThread = 4;
+
+    /// \brief Fold the metadata of a part of the runs of a field into the metadata of the runs
+    ///        before it, so analyzing a field in parts gives what one pass over it gives (with
+    ///        the same rules as ResultSet::analyzeFrame).
+    /// \param metaData The metadata of the earlier runs.
+    /// \param part The metadata of the part.
+    /// \param hasTargets Did any frame of the part have a target (so its type info counts)?
+    void mergeMetaData(details::TargetMetaData& metaData,
+                       const details::TargetMetaData& part,
+                       bool hasTargets)
+    {
+        if (part.rawDims.size() > metaData.rawDims.size())
+        {
+            metaData.rawDims.resize(part.rawDims.size(), 0);
+        }
+
+        for (size_t dimIdx = 0; dimIdx < part.rawDims.size(); ++dimIdx)
+        {
+            metaData.rawDims[dimIdx] = std::max(metaData.rawDims[dimIdx], part.rawDims[dimIdx]);
+        }
+
+        if (part.dims.size() > metaData.dims.size())
+        {
+            metaData.dims.resize(part.dims.size(), 1);
+        }
+
+        for (size_t dimIdx = 0; dimIdx < part.dims.size(); ++dimIdx)
+        {
+            metaData.dims[dimIdx] = std::max(metaData.dims[dimIdx], part.dims[dimIdx]);
+        }
+
+        if (!hasTargets) return;
+
+        metaData.typeInfo.reference = std::min(metaData.typeInfo.reference,
+                                               part.typeInfo.reference);
+        metaData.typeInfo.bits = std::max(metaData.typeInfo.bits, part.typeInfo.bits);
+
+        if (std::abs(part.typeInfo.scale) > metaData.typeInfo.scale)
+        {
+            metaData.typeInfo.scale = part.typeInfo.scale;
+        }
+
+        if (metaData.typeInfo.unit.empty()) metaData.typeInfo.unit = part.typeInfo.unit;
+
+        if (metaData.dimPaths.size() < part.dimPaths.size())
+        {
+            metaData.dimPaths = part.dimPaths;
+        }
+    }
+
+    /// \brief A contiguous block of values of a frame and where it goes in the frame's row.
+    struct Segment
+    {
+        size_t inputOffset;
+        size_t outputOffset;
+        size_t count;
+    };
+
+    /// \brief Finds where the values a frame collected for a target go in the (padded) output
+    ///        row, walking the repetition counts of the target path with an explicit stack
+    ///        instead of recursing once per dimension. Values that are contiguous in both the
+    ///        frame and the row are merged into one segment.
+    /// \param column The column of the target (for the counts).
+    /// \param frameIdx The frame.
+    /// \param numDims The number of dimensioning path elements of the target in this frame.
+    /// \param repeatSizes For each dimension, the output size of one repeat (product of the
+    ///        raw dims after it).
+    /// \param numValues The number of values of the frame.
+    /// \param[out] segments The segments (cleared first).
+    void frameSegments(const details::Column& column,
+                       size_t frameIdx,
+                       size_t numDims,
+                       const std::vector<size_t>& repeatSizes,
+                       size_t numValues,
+                       std::vector<Segment>& segments)
+    {
+        segments.clear();
+        if (numDims == 0 || numDims > repeatSizes.size() || numValues == 0) return;
+
+        struct Level
+        {
+            SubsetLookupTable::Counts counts;
+            size_t countIdx = 0;  // Next instance of the level in counts
+            size_t dimIdx = 0;
+            int repeatsLeft = 0;
+            size_t outputOffset = 0;  // Where the next repeat goes
+        };
+
+        thread_local std::vector<Level> levels;
+        levels.resize(numDims);
+        for (size_t dimIdx = 0; dimIdx < numDims; ++dimIdx)
+        {
+            levels[dimIdx].counts = column.counts(frameIdx, dimIdx);
+            levels[dimIdx].countIdx = 0;
+            levels[dimIdx].dimIdx = dimIdx;
+
+            // Without counts for a level none of the values can be placed.
+            if (levels[dimIdx].counts.empty()) return;
+        }
+
+        const size_t lastDimIdx = numDims - 1;
+        size_t inputOffset = 0;
+
+        // Start the next instance of a level at the given output offset. Returns false once the
+        // counts of the level are used up.
+        auto enter = [&](size_t dimIdx, size_t outputOffset)
+        {
+            auto& level = levels[dimIdx];
+            if (level.countIdx >= level.counts.size()) return false;
+
+            const int count = level.counts[level.countIdx++];
+            if (dimIdx == lastDimIdx)
+            {
+                const auto numCopied = std::min(static_cast<size_t>(std::max(count, 0)),
+                                                numValues - inputOffset);
+                if (numCopied > 0)
+                {
+                    if (!segments.empty() &&
+                        segments.back().inputOffset + segments.back().count == inputOffset &&
+                        segments.back().outputOffset + segments.back().count == outputOffset)
+                    {
+                        segments.back().count += numCopied;
+                    }
+                    else
+                    {
+                        segments.push_back({inputOffset, outputOffset, numCopied});
+                    }
+                }
+
+                inputOffset += numCopied;
+            }
+            else
+            {
+                level.repeatsLeft = count;
+                level.outputOffset = outputOffset;
+            }
+
+            return true;
+        };
+
+        thread_local std::vector<Level*> stack;
+        stack.clear();
+
+        if (!enter(0, 0)) return;
+        if (lastDimIdx > 0) stack.push_back(&levels[0]);
+
+        while (!stack.empty())
+        {
+            auto& level = *stack.back();
+            if (level.repeatsLeft <= 0)
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            --level.repeatsLeft;
+            const auto outputOffset = level.outputOffset;
+            level.outputOffset += repeatSizes[level.dimIdx];
+
+            const auto childIdx = level.dimIdx + 1;
+            if (!enter(childIdx, outputOffset))
+            {
+                stack.clear();
+                break;
+            }
+
+            if (childIdx < lastDimIdx) stack.push_back(&levels[childIdx]);
+        }
+    }
+}  // namespace
+
+    void ResultSet::addFrame(const Frame& frame)
+    {
+        // Frames of the same subset variant tend to come one after the other so check the last
+        // layout first.
+        const auto& layout = frame.layout();
+        if (frameLayouts_.empty() || layouts_[frameLayouts_.back()] != layout)
+        {
+            auto layoutIt = std::find(layouts_.begin(), layouts_.end(), layout);
+            if (layoutIt == layouts_.end())
+            {
+                if (layouts_.empty()) indexTargets(*layout);
+                layouts_.push_back(layout);
+                layoutIt = layouts_.end() - 1;
+            }
+
+            frameLayouts_.push_back(static_cast<unsigned int>(layoutIt - layouts_.begin()));
+        }
+        else
+        {
+            frameLayouts_.push_back(frameLayouts_.back());
+        }
+
+        const auto& targets = *layout->targets();
+        columns_.resize(targets.size());
+        for (size_t targetIdx = 0; targetIdx < targets.size(); ++targetIdx)
+        {
+            // The targets that share the data of another one have no data of their own.
+            if (targets[targetIdx]->sharedIdx != targetIdx) continue;
+
+            columns_[targetIdx].append(frame, targets[targetIdx]);
+        }
+
+        ++numFrames_;
+        cache_->clear();
+    }
+
+    size_t ResultSet::byteSize() const
+    {
+        size_t bytes = frameLayouts_.capacity() * sizeof(unsigned int);
+        for (const auto& column : columns_)
+        {
+            bytes += column.byteSize();
+        }
+
+        return bytes;
+    }
+
+    void ResultSet::merge(ResultSet&& other)
+    {
+        if (other.empty()) return;
+
+        // Map the layouts of the other ResultSet onto ours.
+        std::vector<unsigned int> layoutMap(other.layouts_.size());
+        for (size_t layoutIdx = 0; layoutIdx < other.layouts_.size(); ++layoutIdx)
+        {
+            auto layoutIt = std::find(layouts_.begin(), layouts_.end(), other.layouts_[layoutIdx]);
+            if (layoutIt == layouts_.end())
+            {
+                if (layouts_.empty()) indexTargets(*other.layouts_[layoutIdx]);
+                layouts_.push_back(other.layouts_[layoutIdx]);
+                layoutIt = layouts_.end() - 1;
+            }
+
+            layoutMap[layoutIdx] = static_cast<unsigned int>(layoutIt - layouts_.begin());
+        }
+
+        frameLayouts_.reserve(frameLayouts_.size() + other.frameLayouts_.size());
+        for (const auto& layoutIdx : other.frameLayouts_)
+        {
+            frameLayouts_.push_back(layoutMap[layoutIdx]);
+        }
+
+        columns_.resize(other.columns_.size());
+        for (size_t targetIdx = 0; targetIdx < columns_.size(); ++targetIdx)
+        {
+            columns_[targetIdx].append(std::move(other.columns_[targetIdx]));
+        }
+
+        numFrames_ += other.numFrames_;
+        other = ResultSet();
+        cache_->clear();
+    }
+
+    void ResultSet::release(const std::string& fieldName)
+    {
+        const auto targetIt = targetIdxs_.find(fieldName);
+        if (targetIt == targetIdxs_.end()) return;
+
+        // The data is memoized by shared name (see getMany).
+        const auto& name = layouts_.front()->targets()->at(targetIt->second)->name;
+
+        std::lock_guard<std::mutex> lock(cache_->mutex);
+        cache_->metaData.erase(name);
+
+        auto dataIt = cache_->data.lower_bound(std::make_tuple(name, "", Data::Storage::Octets));
+        while (dataIt != cache_->data.end() && std::get<0>(dataIt->first) == name)
+        {
+            dataIt = cache_->data.erase(dataIt);
+        }
+    }
+
+    void ResultSet::setCaching(bool caching)
+    {
+        caching_ = caching;
+        if (!caching_) cache_->clear();
+    }
+
+    void ResultSet::indexTargets(const SubsetLookupLayout& layout)
+    {
+        const auto& targets = *layout.targets();
+        targetIdxs_.clear();
+        targetIdxs_.reserve(targets.size());
+        for (size_t idx = 0; idx < targets.size(); ++idx)
+        {
+            targetIdxs_.emplace(targets[idx]->name, targets[idx]->sharedIdx);
+        }
+    }
+
+    const std::string& ResultSet::sharedName(const std::string& name) const
+    {
+        if (name.empty()) return name;
+        return layouts_.front()->targets()->at(targetIdx(name))->name;
+    }
+
+    size_t ResultSet::targetIdx(const std::string& name) const
+    {
+        const auto targetIt = targetIdxs_.find(name);
+        if (targetIt == targetIdxs_.end())
+        {
+            std::ostringstream errStr;
+            errStr << "ResultSet: There is no field named " << name << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        return targetIt->second;
+    }
+
+    const std::string& ResultSet::fieldName(QuerySet::FieldHandle field) const
+    {
+        if (layouts_.empty())
+        {
+            throw eckit::BadValue("ResultSet has no data.");
+        }
+
+        const auto& targets = *layouts_.front()->targets();
+        if (field >= targets.size())
+        {
+            std::ostringstream errStr;
+            errStr << "ResultSet: There is no field with handle " << field << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        return targets[field]->name;
+    }
+
+    std::shared_ptr<Ingester::DataObjectBase>
+        ResultSet::get(QuerySet::FieldHandle field,
+                       QuerySet::FieldHandle groupBy,
+                       const std::string& overrideType) const
+    {
+        return get(fieldName(field),
+                   groupBy == QuerySet::NoHandle ? std::string() : fieldName(groupBy),
+                   overrideType);
+    }
+
+    std::vector<std::shared_ptr<Ingester::DataObjectBase>>
+        ResultSet::getMany(const std::vector<QuerySet::FieldHandle>& fields, size_t threads) const
+    {
+        std::vector<FieldRequest> requests;
+        requests.reserve(fields.size());
+        for (const auto field : fields)
+        {
+            requests.push_back({fieldName(field), "", ""});
+        }
+
+        return getMany(requests, threads);
+    }
 
     std::shared_ptr<Ingester::DataObjectBase>
         ResultSet::get(const std::string& fieldName,
                        const std::string& groupByFieldName,
                        const std::string& overrideType) const
+    {
+        return getMany({{fieldName, groupByFieldName, overrideType}}).front();
+    }
+
+    std::vector<std::shared_ptr<Ingester::DataObjectBase>>
+        ResultSet::getMany(const std::vector<FieldRequest>& fields, size_t threads) const
     {
         // Make sure we have accumulated frames otherwise something is wrong.
-        if (frames_.size() == 0)
+        if (numFrames_ == 0)
         {
             throw eckit::BadValue("ResultSet has no data.");
         }
 
-        // Get the metadata for the target
-        const auto targetMetaData = analyzeTarget(fieldName);
+        // Fields with the same query string share their target, so the data is assembled in
+        // terms of the shared names and only once for all the fields that share it. The
+        // identical requests also share their DataObject (the others are named after their own
+        // fields, so they get their own).
+        typedef std::tuple<std::string, std::string, std::string> RequestKey;
+        std::vector<FieldRequest> dataRequests;  // In terms of the shared names
+        std::vector<size_t> objectDataIdxs;
+        std::vector<size_t> objectFieldIdxs;
+        std::vector<size_t> fieldObjectIdxs(fields.size());
+        {
+            std::map<RequestKey, size_t> dataIdxs;
+            std::map<RequestKey, size_t> objectIdxs;
+            for (size_t fieldIdx = 0; fieldIdx < fields.size(); ++fieldIdx)
+            {
+                const auto& field = fields[fieldIdx];
+                const auto objectIt = objectIdxs.emplace(RequestKey(field.fieldName,
+                                                                    field.groupByFieldName,
+                                                                    field.overrideType),
+                                                         objectFieldIdxs.size()).first;
+                fieldObjectIdxs[fieldIdx] = objectIt->second;
+                if (objectIt->second < objectFieldIdxs.size()) continue;
+
+                const auto dataRequest = FieldRequest{sharedName(field.fieldName),
+                                                      sharedName(field.groupByFieldName),
+                                                      field.overrideType};
+                const auto dataIt = dataIdxs.emplace(RequestKey(dataRequest.fieldName,
+                                                                dataRequest.groupByFieldName,
+                                                                dataRequest.overrideType),
+                                                     dataRequests.size()).first;
+                if (dataIt->second == dataRequests.size()) dataRequests.push_back(dataRequest);
+
+                objectFieldIdxs.push_back(fieldIdx);
+                objectDataIdxs.push_back(dataIt->second);
+            }
+        }
+
+        // Find all the distinct targets (including the group_by fields) so they can be analyzed
+        // together.
+        std::vector<std::string> names;
+        std::unordered_map<std::string, size_t> nameIdxs;
+        auto addName = [&names, &nameIdxs](const std::string& name)
+        {
+            if (!name.empty() && nameIdxs.find(name) == nameIdxs.end())
+            {
+                nameIdxs[name] = names.size();
+                names.push_back(name);
+            }
+        };
+
+        for (const auto& request : dataRequests)
+        {
+            addName(request.fieldName);
+            addName(request.groupByFieldName);
+        }
+
+        // Get the metadata for the targets
+        const auto metaDataList = metaDataFor(names, threads);
+
+        // The fields are independent so they are built in parallel.
+        std::vector<details::ResultDataPtr> dataList(dataRequests.size());
+        parallelFor(dataRequests.size(), threads, [&](size_t dataIdx)
+        {
+            const auto& request = dataRequests[dataIdx];
+            const auto& targetMetaData = metaDataList[nameIdxs.at(request.fieldName)];
+
+            details::TargetMetaDataPtr groupByMetaData;
+            if (!request.groupByFieldName.empty())
+            {
+                groupByMetaData = metaDataList[nameIdxs.at(request.groupByFieldName)];
+            }
+
+            dataList[dataIdx] = resultData(request, targetMetaData, groupByMetaData, threads);
+        });
+
+        std::vector<std::shared_ptr<Ingester::DataObjectBase>> objects(objectFieldIdxs.size());
+        parallelFor(objects.size(), threads, [&](size_t objectIdx)
+        {
+            const auto& field = fields[objectFieldIdxs[objectIdx]];
+            const auto dataIdx = objectDataIdxs[objectIdx];
+            const auto& data = dataList[dataIdx];
+            objects[objectIdx] = makeDataObject(
+                field.fieldName,
+                field.groupByFieldName,
+                metaDataList[nameIdxs.at(dataRequests[dataIdx].fieldName)]->typeInfo,
+                field.overrideType,
+                data->buffer,
+                data->validity,
+                data->dims,
+                data->dimPaths);
+        });
+
+        std::vector<std::shared_ptr<Ingester::DataObjectBase>> fieldObjects(fields.size());
+        for (size_t fieldIdx = 0; fieldIdx < fields.size(); ++fieldIdx)
+        {
+            fieldObjects[fieldIdx] = objects[fieldObjectIdxs[fieldIdx]];
+        }
+
+        return fieldObjects;
+    }
+
+    std::vector<details::TargetMetaDataPtr>
+        ResultSet::metaDataFor(const std::vector<std::string>& names, size_t threads) const
+    {
+        std::vector<details::TargetMetaDataPtr> metaDataList(names.size());
+        std::vector<std::string> missingNames;
+        std::vector<size_t> missingIdxs;
+        {
+            std::lock_guard<std::mutex> lock(cache_->mutex);
+            for (size_t nameIdx = 0; nameIdx < names.size(); ++nameIdx)
+            {
+                const auto metaDataIt = cache_->metaData.find(names[nameIdx]);
+                if (metaDataIt != cache_->metaData.end())
+                {
+                    metaDataList[nameIdx] = metaDataIt->second;
+                }
+                else
+                {
+                    missingNames.push_back(names[nameIdx]);
+                    missingIdxs.push_back(nameIdx);
+                }
+            }
+        }
+
+        if (missingNames.empty()) return metaDataList;
+
+        const auto analyzed = analyzeTargets(missingNames, threads);
+
+        std::lock_guard<std::mutex> lock(cache_->mutex);
+        for (size_t idx = 0; idx < analyzed.size(); ++idx)
+        {
+            metaDataList[missingIdxs[idx]] = analyzed[idx];
+            if (caching_) cache_->metaData[missingNames[idx]] = analyzed[idx];
+        }
+
+        return metaDataList;
+    }
+
+    details::ResultDataPtr
+        ResultSet::resultData(const FieldRequest& field,
+                              const details::TargetMetaDataPtr& targetMetaData,
+                              const details::TargetMetaDataPtr& groupByMetaData,
+                              size_t threads) const
+    {
+        const auto storage = storageFor(targetMetaData->typeInfo, field.overrideType);
+        const auto key = std::make_tuple(field.fieldName, field.groupByFieldName, storage);
+        {
+            std::lock_guard<std::mutex> lock(cache_->mutex);
+            const auto dataIt = cache_->data.find(key);
+            if (dataIt != cache_->data.end()) return dataIt->second;
+        }
 
         // Assemble Result Data
-        auto data = assembleData(targetMetaData);
+        auto data = std::make_shared<details::ResultData>(assembleData(targetMetaData,
+                                                                              storage,
+                                                                              threads));
 
-        if (!groupByFieldName.empty())
+        if (groupByMetaData)
         {
-            applyGroupBy(data, targetMetaData, groupByFieldName);
+            applyGroupBy(*data, targetMetaData, groupByMetaData);
         }
 
-        auto object = makeDataObject(fieldName,
-                                     groupByFieldName,
-                                     targetMetaData->typeInfo,
-                                     overrideType,
-                                     data.buffer,
-                                     data.dims,
-                                     data.dimPaths);
+        // The missing values of numbers are found once here instead of by every check of the
+        // DataObjects made from the data (strings are trimmed, so blank ones end up missing).
+        if (!targetMetaData->typeInfo.isString() && !targetMetaData->typeInfo.isLongString())
+        {
+            data->validity = std::make_shared<const Validity>(Validity::of(data->buffer));
+        }
 
-        return object;
+        if (caching_)
+        {
+            std::lock_guard<std::mutex> lock(cache_->mutex);
+            cache_->data.emplace(key, data);
+        }
+
+        return data;
     }
 
 #ifdef BUILD_PYTHON_BINDING
@@ -67,7 +671,13 @@ namespace bufr {
                                            const std::string& groupByFieldName,
                                            const std::string& overrideType) const
         {
-            auto dataObj = get(fieldName, groupByFieldName, overrideType);
+            std::shared_ptr<DataObjectBase> dataObj;
+            {
+                // The field is built without the GIL (see python_bindings.cpp).
+                py::gil_scoped_release release;
+                dataObj = get(fieldName, groupByFieldName, overrideType);
+            }
+
             return dataObj->getNumpyArray();
         }
 
@@ -79,65 +689,66 @@ namespace bufr {
                                                    const std::string& second,
                                                    const std::string& groupBy) const
         {
-            std::shared_ptr<DataObjectBase> yearObj = get(year, groupBy);
-            std::shared_ptr<DataObjectBase> monthObj = get(month, groupBy);
-            std::shared_ptr<DataObjectBase> dayObj = get(day, groupBy);
-            std::shared_ptr<DataObjectBase> hourObj = get(hour, groupBy);
-
-            std::shared_ptr<DataObjectBase> minuteObj = nullptr;
-            std::shared_ptr<DataObjectBase> secondObj = nullptr;
-
-            if (!minute.empty())
+            // Get all the fields in one go, as 32 bit ints so their buffers can be used directly.
+            std::vector<FieldRequest> fields = {{year, groupBy, "int"},
+                                                {month, groupBy, "int"},
+                                                {day, groupBy, "int"},
+                                                {hour, groupBy, "int"}};
+            if (!minute.empty()) fields.push_back({minute, groupBy, "int"});
+            if (!second.empty()) fields.push_back({second, groupBy, "int"});
+
+            std::vector<std::shared_ptr<DataObjectBase>> objects;
             {
-                minuteObj = get(minute, groupBy);
+                py::gil_scoped_release release;
+                objects = getMany(fields);
             }
 
-            if (!second.empty())
+            typedef DataObject<int32_t> IntObject;
+            auto values = [&objects](size_t fieldIdx) -> const int32_t*
             {
-                secondObj = get(second, groupBy);
-            }
+                return std::static_pointer_cast<IntObject>(objects[fieldIdx])->getRawData().data();
+            };
 
-            // make strides array
-            std::vector<ssize_t> strides(yearObj->getDims().size());
-            strides[0] = sizeof(int64_t);
-            for (size_t i = 1; i < yearObj->getDims().size(); ++i)
-            {
-                strides[i] = sizeof(int64_t) * yearObj->getDims()[i];
-            }
+            const int32_t* years = values(0);
+            const int32_t* months = values(1);
+            const int32_t* days = values(2);
+            const int32_t* hours = values(3);
+            const int32_t* minutes = minute.empty() ? nullptr : values(4);
+            const int32_t* seconds = second.empty() ? nullptr : values(minute.empty() ? 4 : 5);
+
+            const auto& dims = objects.front()->getDims();
+            const auto size = objects.front()->size();
 
-            auto array = py::array(py::dtype("datetime64[s]"), yearObj->getDims(), strides);
+            auto array = py::array(py::dtype("datetime64[s]"), dims);
             auto arrayPtr = static_cast<int64_t*>(array.mutable_data());
 
-            for (size_t i = 0; i < yearObj->size(); ++i)
-            {
-                std::tm time;
-                time.tm_year = yearObj->getAsInt(i) - 1900;
-                time.tm_mon = monthObj->getAsInt(i) - 1;
-                time.tm_mday = dayObj->getAsInt(i);
-                time.tm_hour = hourObj->getAsInt(i);
-                time.tm_min = minuteObj ? minuteObj->getAsInt(i) : 0;
-                time.tm_sec = secondObj ? secondObj->getAsInt(i) : 0;
-                time.tm_isdst = 0;
+            py::array_t<bool> mask(dims);
+            bool* maskPtr = static_cast<bool*>(mask.mutable_data());
 
-                arrayPtr[i] = static_cast<int64_t>(timegm(&time));
+            const int32_t missing = IntObject::missingValue();
+            for (size_t idx = 0; idx < size; ++idx)
+            {
+                const int32_t minuteVal = minutes ? minutes[idx] : 0;
+                const int32_t secondVal = seconds ? seconds[idx] : 0;
+
+                const bool isMissing = years[idx] == missing ||
+                                       months[idx] == missing ||
+                                       days[idx] == missing ||
+                                       hours[idx] == missing ||
+                                       minuteVal == missing ||
+                                       secondVal == missing;
+
+                maskPtr[idx] = isMissing;
+                arrayPtr[idx] = isMissing ? 0 : secondsSinceEpoch(years[idx],
+                                                                  months[idx],
+                                                                  days[idx],
+                                                                  hours[idx],
+                                                                  minuteVal,
+                                                                  secondVal);
             }
 
-            // Create the mask array
             py::object numpyModule = py::module::import("numpy");
 
-            // Create the mask array
-            py::array_t<bool> mask(yearObj->getDims());
-            bool* maskPtr = static_cast<bool*>(mask.mutable_data());
-            for (size_t idx = 0; idx < yearObj->size(); idx++)
-            {
-                maskPtr[idx] = yearObj->isMissing(idx) ||
-                               monthObj->isMissing(idx) ||
-                               dayObj->isMissing(idx) ||
-                               hourObj->isMissing(idx) ||
-                               (minuteObj ? minuteObj->isMissing(idx) : false) ||
-                               (secondObj ? secondObj->isMissing(idx) : false);
-            }
-
             // Create a masked array from the data and mask arrays
             py::array maskedArray = numpyModule.attr("ma").attr("masked_array")(array, mask);
             numpyModule.attr("ma").attr("set_fill_value")(maskedArray, 0);
@@ -146,127 +757,189 @@ namespace bufr {
         }
 #endif
 
-    details::TargetMetaDataPtr ResultSet::analyzeTarget(const std::string& name) const
+    std::vector<details::TargetMetaDataPtr>
+        ResultSet::analyzeTargets(const std::vector<std::string>& names, size_t threads) const
     {
-        auto metaData = std::make_shared<details::TargetMetaData>();
-        metaData->targetIdx = frames_.front().getTargetIdx(name);
-        metaData->missingFrames.resize(frames_.size(), false);
+        std::vector<details::TargetMetaDataPtr> metaDataList;
+        metaDataList.reserve(names.size());
+        for (const auto& name : names)
+        {
+            auto metaData = std::make_shared<details::TargetMetaData>();
+            metaData->targetIdx = targetIdx(name);
+            metaData->missingFrames.resize(numFrames_, false);
+            metaDataList.push_back(metaData);
+        }
 
         // Loop through the frames to determine the overall parameters for the result data. We will
         // want to find the dimension information and determine if the array could be jagged which
-        // means we will need to do extra work later (otherwise we can quickly copy the data).
-        size_t frameIdx = 0;
-        for (const auto& frame : frames_)
+        // means we will need to do extra work later (otherwise we can quickly copy the data). The
+        // frames of a run (see details::Column) all have the same shape so only the first frame of
+        // each run is analyzed. When there are fewer fields than threads, the fields with many
+        // runs are split into ranges of runs that are analyzed on their own and merged in order
+        // (see mergeMetaData), so one very large field doesn't hold up the others.
+        struct Part
         {
-            const auto &target = frame.targetAtIdx(metaData->targetIdx);
-
-            if (target->path.size() == 0)
-            {
-                metaData->missingFrames[frameIdx] = true;
-                ++frameIdx;
-                continue;
-            }
-
-            if (target->path.size() - 1 > metaData->rawDims.size())
+            size_t metaIdx;
+            size_t runBegin;
+            size_t runEnd;
+            details::TargetMetaData metaData;
+            bool hasTargets = false;  // Did any of its frames have a target (and its type)?
+        };
+
+        const auto partsPerField = std::max<size_t>(threads / std::max<size_t>(names.size(), 1),
+                                                    1);
+        std::vector<Part> parts;
+        for (size_t metaIdx = 0; metaIdx < metaDataList.size(); ++metaIdx)
+        {
+            const auto numRuns = columns_.at(metaDataList[metaIdx]->targetIdx).numRuns();
+            const auto numParts = std::max<size_t>(std::min(partsPerField,
+                                                            numRuns / MinAnalysisRuns), 1);
+            for (size_t partIdx = 0; partIdx < numParts; ++partIdx)
             {
-                metaData->rawDims.resize(target->path.size() -  1, 0);
+                Part part;
+                part.metaIdx = metaIdx;
+                part.runBegin = numRuns * partIdx / numParts;
+                part.runEnd = numRuns * (partIdx + 1) / numParts;
+                part.metaData.targetIdx = metaDataList[metaIdx]->targetIdx;
+                parts.push_back(std::move(part));
             }
+        }
 
-            // Resize the dims if necessary
-            // Jagged if the dims need a resize (skip first one)
-            if (target->exportDimIdxs.size() > metaData->dims.size())
-            {
-                metaData->dims.resize(target->exportDimIdxs.size(), 1);
-                metaData->filteredDims.resize(target->exportDimIdxs.size(), 0);
-            }
+        parallelFor(parts.size(), threads, [&](size_t partIdx)
+        {
+            auto& part = parts[partIdx];
+            const auto& column = columns_.at(metaDataList[part.metaIdx]->targetIdx);
 
-            // Capture the dimensional information
-            auto pathIdx = 0;
-            auto exportIdxIdx = 0;
-            for (auto p = target->path.begin(); p != target->path.end() - 1; ++p)
+            // The parts of a field mark the missing frames of their own runs.
+            auto& missingFrames = metaDataList[part.metaIdx]->missingFrames;
+            for (size_t runIdx = part.runBegin; runIdx < part.runEnd; ++runIdx)
             {
-                const auto& counts = frame[p->nodeId].counts;
-                if (counts.empty())
+                const auto runBegin = column.runBegin(runIdx);
+                const char isMissing = !analyzeFrame(part.metaData, runBegin);
+                if (!targetAt(runBegin, part.metaData.targetIdx)->path.empty())
                 {
-                    metaData->missingFrames[frameIdx] = true;
-                    break;
+                    part.hasTargets = true;
                 }
 
-                const auto maxCount = std::max(max(counts), 1);
-                if (maxCount > metaData->rawDims[pathIdx])
-                {
-                    metaData->rawDims[pathIdx] = maxCount;
-                }
+                std::fill(missingFrames.begin() + runBegin,
+                          missingFrames.begin() + column.runEnd(runIdx),
+                          isMissing);
+            }
+        });
 
-                if (target->exportDimIdxs.size() - 1 < static_cast<size_t>(exportIdxIdx))
-                {
-                    ++pathIdx;
-                    continue;
-                }
+        for (const auto& part : parts)
+        {
+            mergeMetaData(*metaDataList[part.metaIdx], part.metaData, part.hasTargets);
+        }
 
-                if (target->exportDimIdxs[exportIdxIdx] != pathIdx)
-                {
-                    ++pathIdx;
-                    continue;
-                }
+        for (const auto& metaData : metaDataList)
+        {
+            finishAnalysis(*metaData);
+        }
 
-                const auto newDimVal = std::max(metaData->dims[exportIdxIdx],
-                                                std::max(max(counts), 1));
+        return metaDataList;
+    }
 
-                metaData->dims[exportIdxIdx] = newDimVal;
+    bool ResultSet::analyzeFrame(details::TargetMetaData& metaData, size_t frameIdx) const
+    {
+        const auto& column = columns_.at(metaData.targetIdx);
+        const auto &target = targetAt(frameIdx, metaData.targetIdx);
 
-                // Capture the filtered dimension information
-                if (!p->queryComponent->filter.empty())
-                {
-                    metaData->filteredDims[exportIdxIdx] =
-                        std::max(metaData->filteredDims[exportIdxIdx],
-                        static_cast<int> (p->queryComponent->filter.size()));
-                }
+        if (target->path.size() == 0)
+        {
+            return false;
+        }
 
-                pathIdx++;
-                exportIdxIdx++;
-            }
+        if (target->path.size() - 1 > metaData.rawDims.size())
+        {
+            metaData.rawDims.resize(target->path.size() -  1, 0);
+        }
+
+        // Resize the dims if necessary
+        // Jagged if the dims need a resize (skip first one)
+        if (target->exportDimIdxs.size() > metaData.dims.size())
+        {
+            metaData.dims.resize(target->exportDimIdxs.size(), 1);
+        }
 
-            // Fill in the type information
-            metaData->typeInfo.reference =
-                std::min(metaData->typeInfo.reference, target->typeInfo.reference);
-            metaData->typeInfo.bits = std::max(metaData->typeInfo.bits, target->typeInfo.bits);
+        // Capture the dimensional information
+        bool hasData = true;
+        auto pathIdx = 0;
+        auto exportIdxIdx = 0;
+        for (auto p = target->path.begin(); p != target->path.end() - 1; ++p)
+        {
+            const auto counts = column.counts(frameIdx, p - target->path.begin());
+            if (counts.empty())
+            {
+                hasData = false;
+                break;
+            }
+            // The counts of a filtered dimension are the numbers of the repeats that were kept
+            // (see details::Column), it has room for every value of the filter.
+            auto maxCount = std::max(*std::max_element(counts.begin(), counts.end()), 1);
+            if (!target->filterMasks[pathIdx].empty())
+            {
+                maxCount = std::max(maxCount, static_cast<int>(p->queryComponent->filter.size()));
+            }
 
-            if (std::abs(target->typeInfo.scale) > metaData->typeInfo.scale)
+            if (maxCount > metaData.rawDims[pathIdx])
             {
-                metaData->typeInfo.scale = target->typeInfo.scale;
+                metaData.rawDims[pathIdx] = maxCount;
             }
 
-            if (metaData->typeInfo.unit.empty()) metaData->typeInfo.unit = target->typeInfo.unit;
+            if (target->exportDimIdxs.size() - 1 < static_cast<size_t>(exportIdxIdx))
+            {
+                ++pathIdx;
+                continue;
+            }
 
-            // Fill in the dimPaths data
-            if (!target->dimPaths.empty() &&
-                metaData->dimPaths.size() < target->dimPaths.size())
+            if (target->exportDimIdxs[exportIdxIdx] != pathIdx)
             {
-                metaData->dimPaths = target->dimPaths;
+                ++pathIdx;
+                continue;
             }
 
-            ++frameIdx;
+            const auto newDimVal = std::max(metaData.dims[exportIdxIdx], maxCount);
+
+            metaData.dims[exportIdxIdx] = newDimVal;
+
+            pathIdx++;
+            exportIdxIdx++;
         }
 
-        if (metaData->dimPaths.empty())
+        // Fill in the type information
+        metaData.typeInfo.reference =
+            std::min(metaData.typeInfo.reference, target->typeInfo.reference);
+        metaData.typeInfo.bits = std::max(metaData.typeInfo.bits, target->typeInfo.bits);
+
+        if (std::abs(target->typeInfo.scale) > metaData.typeInfo.scale)
         {
-            metaData->dimPaths = {Query()};
+            metaData.typeInfo.scale = target->typeInfo.scale;
         }
 
-        // Fill the filtered dims array with the raw dims for elements that are not filtered
-        for (size_t dimIdx = 0; dimIdx < metaData->filteredDims.size(); ++dimIdx)
+        if (metaData.typeInfo.unit.empty()) metaData.typeInfo.unit = target->typeInfo.unit;
+
+        // Fill in the dimPaths data
+        if (!target->dimPaths.empty() &&
+            metaData.dimPaths.size() < target->dimPaths.size())
         {
-            if (metaData->filteredDims[dimIdx] == 0)
-            {
-                metaData->filteredDims[dimIdx] = metaData->dims[dimIdx];
-            }
+            metaData.dimPaths = target->dimPaths;
         }
 
-        return metaData;
+        return hasData;
     }
 
-    details::ResultData ResultSet::assembleData(const details::TargetMetaDataPtr& metaData) const
+    void ResultSet::finishAnalysis(details::TargetMetaData& metaData) const
+    {
+        if (metaData.dimPaths.empty())
+        {
+            metaData.dimPaths = {Query()};
+        }
+    }
+
+    details::ResultData ResultSet::assembleData(const details::TargetMetaDataPtr& metaData,
+                                                Data::Storage storage,
+                                                size_t threads) const
     {
         int rowLength = 1;
         for (size_t dimIdx = 1; dimIdx < metaData->rawDims.size(); ++dimIdx)
@@ -278,10 +951,10 @@ namespace bufr {
         rowLength = std::max(rowLength, 1);
 
         // Allocate the output data
-        auto totalRows = frames_.size();
+        auto totalRows = numFrames_;
         auto data = details::ResultData();
-        data.buffer.isLongStr(metaData->typeInfo.isLongString());
-        data.buffer.resize(totalRows * rowLength);
+        data.buffer.setStorage(storage);
+        data.buffer.allocate(totalRows * rowLength);
         data.dims = metaData->dims;
         data.rawDims = metaData->rawDims;
         data.dimPaths = metaData->dimPaths;
@@ -290,157 +963,85 @@ namespace bufr {
         data.dims[0] = totalRows;
         data.rawDims[0] = totalRows;
 
-        bool needsFiltering = false;
-
-        // Copy the data fragments into the raw data array.
-        for (size_t frameIdx=0; frameIdx < frames_.size(); ++frameIdx)
+        // The output size of one repeat of each dimension (same for all the frames).
+        std::vector<size_t> repeatSizes(metaData->rawDims.size(), 1);
+        for (size_t dimIdx = repeatSizes.size(); dimIdx-- > 1;)
         {
-            if (metaData->missingFrames[frameIdx])
-            {
-                continue;
-            }
-
-            const auto& frame = frames_[frameIdx];
-            const auto& target = frame.targetAtIdx(metaData->targetIdx);
-            copyData(data, frame, target, frameIdx * rowLength);
-
-            if (target->usesFilters) needsFiltering = true;
+            repeatSizes[dimIdx - 1] = repeatSizes[dimIdx] *
+                                      static_cast<size_t>(std::max(metaData->rawDims[dimIdx], 0));
         }
 
-        if (needsFiltering)
+        // Copy the data fragments into the raw data array. The frames of a run have the same
+        // shape, so where their values go in a row is worked out once per run. Every frame has
+        // its own row, so a large field is split into ranges of frames (cutting through runs)
+        // that are copied on several threads.
+        const auto& column = columns_.at(metaData->targetIdx);
+        const auto totalValues = totalRows * static_cast<size_t>(rowLength);
+        const auto numRanges = std::max<size_t>(std::min(threads * RangesPerThread,
+                                                         totalValues / MinAssemblyValues), 1);
+        withStorageType(storage, [&](auto typeTag)
         {
-            int filteredRowLength = 1;
-            for (size_t dimIdx = 1; dimIdx < metaData->filteredDims.size(); ++dimIdx)
+            typedef decltype(typeTag) T;
+            auto output = data.buffer.values<T>().data();
+            parallelFor(numRanges, threads, [&](size_t rangeIdx)
             {
-                filteredRowLength *= metaData->filteredDims[dimIdx];
-            }
-
-            auto filteredData = details::ResultData();
-            filteredData.buffer.isLongStr(metaData->typeInfo.isLongString());
-            filteredData.buffer.resize(totalRows * filteredRowLength);
-
-            for (size_t frameIdx = 0; frameIdx < frames_.size(); ++frameIdx)
-            {
-                const auto &frame = frames_[frameIdx];
-                const auto &target = frame.targetAtIdx(metaData->targetIdx);
-
-                size_t inputOffset = frameIdx * rowLength;
-                size_t outputOffset = frameIdx * filteredRowLength;
-                size_t maxDepth = target->path.size() - 1;
-
-                copyFilteredData(filteredData,
-                                 data,
-                                 target,
-                                 inputOffset,
-                                 outputOffset,
-                                 1,
-                                 maxDepth,
-                                 target->filterDataList,
-                                 false);
-            }
-
-            filteredData.dimPaths = metaData->dimPaths;
-            filteredData.dims = metaData->filteredDims;
-            filteredData.dims[0] = data.dims[0];
-
-            data = std::move(filteredData);
-        }
-
-        return data;
-    }
-
-    void ResultSet::copyData(details::ResultData& data,
-                             const Frame& frame,
-                             const TargetPtr& target,
-                             size_t outputOffset) const
-    {
-        size_t inputOffset = 0;
-        size_t dimIdx = 0;
-        size_t countNumber = 1;
-        size_t countOffset = 0;
-
-        _copyData(data,
-                  frame,
-                  target,
-                  outputOffset,
-                  inputOffset,
-                  dimIdx,
-                  countNumber,
-                  countOffset);
-    }
+                const auto rangeBegin = totalRows * rangeIdx / numRanges;
+                const auto rangeEnd = totalRows * (rangeIdx + 1) / numRanges;
+                if (rangeBegin == rangeEnd) return;
+
+                std::vector<Segment> segments;
+                for (size_t runIdx = column.runOf(rangeBegin);
+                     runIdx < column.numRuns() && column.runBegin(runIdx) < rangeEnd;
+                     ++runIdx)
+                {
+                    const auto runBegin = column.runBegin(runIdx);
+                    if (metaData->missingFrames[runBegin])
+                    {
+                        continue;
+                    }
 
-    void ResultSet::_copyData(details::ResultData& data,
-                              const Frame& frame,
-                              const TargetPtr& target,
-                              size_t& outputOffset,
-                              size_t& inputOffset,
-                              const size_t dimIdx,
-                              const size_t countNumber,
-                              const size_t countOffset) const
-    {
-        size_t totalDimSize = 1;
-        for (size_t i = dimIdx; i < data.rawDims.size(); ++i)
-        {
-            totalDimSize *= data.rawDims[i];
-        }
+                    // The frames of the run in the range.
+                    const auto framesBegin = std::max(runBegin, rangeBegin);
+                    const auto framesEnd = std::min(column.runEnd(runIdx), rangeEnd);
 
-        if (!totalDimSize ||
-            dimIdx > data.rawDims.size() - 1 ||
-            frame[target->nodeIdx].data.empty()) return;
+                    const auto& target = targetAt(runBegin, metaData->targetIdx);
 
-        const auto& counts = frame[target->path[dimIdx].nodeId].counts;
-        if (counts.empty())
-        {
-            outputOffset += totalDimSize;
-            return;
-        }
+                    const auto values = frameValues(column.data(framesBegin,
+                                                                framesEnd,
+                                                                target->typeInfo.isLongString()),
+                                                    output);
+                    const auto frameSize = values.size() / (framesEnd - framesBegin);
+                    auto framesOutput = output + framesBegin * rowLength;
 
-        size_t newOffset = 0;
-        for (size_t countIdx = 0; countIdx < countNumber; ++countIdx)
-        {
-            const auto& count = counts[countIdx + countOffset];
-            if (count == 0)
-            {
-                outputOffset += totalDimSize;
-                continue;
-            }
+                    // Frames that fill their whole row (every count is the max count, which is
+                    // always the case for fixed repeats) are already laid out like the output so
+                    // they are copied in bulk.
+                    if (target->path.size() - 1 == metaData->rawDims.size() &&
+                        frameSize == static_cast<size_t>(rowLength))
+                    {
+                        copyValues(values, 0, values.size(), framesOutput);
+                        continue;
+                    }
 
-            // When we reach the last layer of counts then copy the data
-            // Ignore the subset path element (reason for -2)
-            if (dimIdx == target->path.size() - 2)
-            {
-                const auto& fragment = frame[target->nodeIdx].data;
+                    frameSegments(column, runBegin, target->path.size() - 1, repeatSizes,
+                                  frameSize, segments);
 
-                if (fragment.isLongStr())
-                {
-                    std::copy(fragment.value.strings.begin() + inputOffset,
-                              fragment.value.strings.begin() + inputOffset + count,
-                              data.buffer.value.strings.begin() + outputOffset);
-                }
-                else
-                {
-                    std::copy(fragment.value.octets.begin() + inputOffset,
-                              fragment.value.octets.begin() + inputOffset + count,
-                              data.buffer.value.octets.begin() + outputOffset);
+                    for (size_t frameOffset = 0; frameOffset < framesEnd - framesBegin;
+                         ++frameOffset)
+                    {
+                        const auto inputOffset = frameOffset * frameSize;
+                        auto rowOutput = framesOutput + frameOffset * rowLength;
+                        for (const auto& segment : segments)
+                        {
+                            copyValues(values, inputOffset + segment.inputOffset, segment.count,
+                                       rowOutput + segment.outputOffset);
+                        }
+                    }
                 }
+            });
+        });
 
-                inputOffset += count;
-                outputOffset += totalDimSize;
-            }
-            else
-            {
-                _copyData(data,
-                          frame,
-                          target,
-                          outputOffset,
-                          inputOffset,
-                          dimIdx + 1,
-                          count,
-                          newOffset);
-            }
-
-            newOffset++;
-        }
+        return data;
     }
 
     void ResultSet::validateGroupByField(const details::TargetMetaDataPtr& targetMetaData,
@@ -468,95 +1069,10 @@ namespace bufr {
         }
     }
 
-    void ResultSet:: copyFilteredData(details::ResultData& resData,
-                                      const details::ResultData& srcData,
-                                      const TargetPtr& target,
-                                      size_t& inputOffset,
-                                      size_t& outputOffset,
-                                      size_t depth,
-                                      size_t maxDepth,
-                                      const FilterDataList& filterDataList,
-                                      bool skipResult) const
-    {
-        if (depth == maxDepth)
-        {
-            if (!skipResult)
-            {
-                if (resData.buffer.isLongStr())
-                {
-                    resData.buffer.value.strings[outputOffset] =
-                        srcData.buffer.value.strings[inputOffset];
-                }
-                else
-                {
-                    resData.buffer.value.octets[outputOffset] =
-                        srcData.buffer.value.octets[inputOffset];
-                }
-
-                outputOffset++;
-            }
-
-            inputOffset++;
-
-            return;
-        }
-
-        const auto& filterData = filterDataList[depth];
-
-        if (filterData.isEmpty)
-        {
-            for (size_t count = 1; count <= static_cast<size_t>(srcData.rawDims[depth]); count++)
-            {
-                copyFilteredData(resData,
-                                 srcData,
-                                 target,
-                                 inputOffset,
-                                 outputOffset,
-                                 depth + 1,
-                                 maxDepth,
-                                 filterDataList,
-                                 skipResult);
-            }
-        }
-        else
-        {
-            size_t filterIdx = 0;
-            auto nextFilterCount = filterData.filter[filterIdx];
-            for (size_t count = 1; count <= static_cast<size_t>(srcData.rawDims[depth]); count++)
-            {
-                bool skip = skipResult;
-                if (!skip)
-                {
-                    if (nextFilterCount == count)
-                    {
-                        filterIdx++;
-                        if (filterIdx < filterData.filter.size())
-                            nextFilterCount = filterData.filter.at(filterIdx);
-                    }
-                    else
-                    {
-                        skip = true;
-                    }
-                }
-
-                copyFilteredData(resData,
-                                 srcData,
-                                 target,
-                                 inputOffset,
-                                 outputOffset,
-                                 depth + 1,
-                                 maxDepth,
-                                 filterDataList,
-                                 skip);
-            }
-        }
-    }
-
     void ResultSet::applyGroupBy(details::ResultData& resData,
                                  const details::TargetMetaDataPtr& targetMetaData,
-                                 const std::string& groupByFieldName) const
+                                 const details::TargetMetaDataPtr& groupByMetaData) const
     {
-        const auto groupByMetaData = analyzeTarget(groupByFieldName);
         validateGroupByField(targetMetaData, groupByMetaData);
 
         // If the groupby field has more dims than the target then we must duplicate the
@@ -564,9 +1080,8 @@ namespace bufr {
         if (groupByMetaData->dims.size() > targetMetaData->dims.size())
         {
             auto newData = details::ResultData();
-            newData.buffer.isLongStr(resData.buffer.isLongStr());
+            newData.buffer.setStorage(resData.buffer.storage());
             newData.dims = {resData.dims[0] * product(groupByMetaData->dims)};
-            newData.buffer.resize(resData.dims[0] * product(groupByMetaData->dims));
 
             const auto numTargetVals = static_cast<size_t>(product(targetMetaData->dims));
 
@@ -581,22 +1096,14 @@ namespace bufr {
             const auto numReps =
                 static_cast<size_t>(product(groupByMetaData->dims) / numTargetVals);
 
-            for (size_t targIdx = 0; targIdx < numTargetVals * resData.dims[0]; targIdx++)
+            withStorageType(resData.buffer.storage(), [&](auto typeTag)
             {
-                for (size_t rep = 0; rep < numReps; rep++)
-                {
-                    if (resData.buffer.isLongStr())
-                    {
-                        newData.buffer.value.strings[targIdx * numReps + rep] =
-                            resData.buffer.value.strings[targIdx];
-                    }
-                    else
-                    {
-                        newData.buffer.value.octets[targIdx * numReps + rep] =
-                            resData.buffer.value.octets[targIdx];
-                    }
-                }
-            }
+                typedef decltype(typeTag) T;
+                replicateValues(resData.buffer.values<T>(),
+                                numTargetVals * resData.dims[0],
+                                numReps,
+                                newData.buffer.values<T>());
+            });
 
             newData.dimPaths = {targetMetaData->dimPaths.back()};
             resData = std::move(newData);
@@ -624,8 +1131,7 @@ namespace bufr {
 
     std::string ResultSet::unit(const std::string& fieldName) const
     {
-        const auto targetIdx = frames_.front().getTargetIdx(fieldName);
-        const auto& target = frames_.front().targetAtIdx(targetIdx);
+        const auto& target = targetAt(0, targetIdx(fieldName));
         return target->typeInfo.unit;
     }
 
@@ -635,6 +1141,7 @@ namespace bufr {
                                 const TypeInfo& info,
                                 const std::string& overrideType,
                                 const Data& data,
+                                const std::shared_ptr<const Validity>& validity,
                                 const std::vector<int>& dims,
                                 const std::vector<Query>& dimPaths) const
     {
@@ -658,6 +1165,8 @@ namespace bufr {
         }
 
         object->setData(data);
+        if (validity) object->setValidity(validity);
+        if (overrideType.empty() && info.isInteger()) object->packIntegers(info.bits);
         object->setDims(dims);
         object->setFieldName(fieldName);
         object->setGroupByFieldName(groupByFieldName);
@@ -666,6 +1175,31 @@ namespace bufr {
         return object;
     }
 
+    Data::Storage ResultSet::storageFor(const TypeInfo& info,
+                                        const std::string& overrideType) const
+    {
+        if (info.isLongString()) return Data::Storage::Strings;
+
+        // Strings are made from the octets (and conversions to numbers are errors anyway).
+        if (info.isString()) return Data::Storage::Octets;
+
+        if (overrideType.empty())
+        {
+            if (info.isInteger())
+            {
+                return (info.isSigned() && !info.is64Bit()) ? Data::Storage::Ints
+                                                            : Data::Storage::Octets;
+            }
+
+            return info.is64Bit() ? Data::Storage::Octets : Data::Storage::Floats;
+        }
+
+        if (overrideType == "int" || overrideType == "int32") return Data::Storage::Ints;
+        if (overrideType == "float" || overrideType == "float32") return Data::Storage::Floats;
+
+        return Data::Storage::Octets;
+    }
+
     std::shared_ptr<DataObjectBase> ResultSet::objectByTypeInfo(const TypeInfo &info) const
     {
         std::shared_ptr<DataObjectBase> object;
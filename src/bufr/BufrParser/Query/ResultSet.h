@@ -7,7 +7,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>  // NOLINT
+#include <tuple>
 #include <unordered_map>
 #include <memory>
 #include <string>
@@ -23,11 +28,14 @@
     namespace py = pybind11;
 #endif
 
+#include "BufferPool.h"
 #include "DataProvider/DataProvider.h"
 #include "DataObject.h"
 #include "Target.h"
 #include "SubsetLookupTable.h"
+#include "QuerySet.h"
 #include "Data.h"
+#include "Validity.h"
 
 
 namespace Ingester {
@@ -41,7 +49,6 @@ namespace details
         TypeInfo typeInfo;
         std::vector<int> dims = {0};
         std::vector<int> rawDims = {0};
-        std::vector<int> filteredDims = {0};
         std::vector<int> groupedDims = {};
         std::vector<char> missingFrames;
         std::vector<Query> dimPaths;
@@ -53,30 +60,438 @@ namespace details
         std::vector<int> dims;
         std::vector<int> rawDims;
         std::vector<Query> dimPaths;
+
+        /// \brief Which values of the buffer are there (numeric fields only, null otherwise).
+        std::shared_ptr<const Validity> validity;
     };
 
     typedef std::shared_ptr<TargetMetaData> TargetMetaDataPtr;
+    typedef std::shared_ptr<const ResultData> ResultDataPtr;
+
+    /// \brief The metadata and the assembled (and grouped) data of the fields already requested
+    /// from a ResultSet, so asking for a field again doesn't redo the work.
+    struct FieldCache
+    {
+        typedef std::tuple<std::string, std::string, Data::Storage> DataKey;  // field, group_by
+
+        std::mutex mutex;
+        std::unordered_map<std::string, TargetMetaDataPtr> metaData;  // By field name
+        std::map<DataKey, ResultDataPtr> data;
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            metaData.clear();
+            data.clear();
+        }
+    };
+
+    /// \brief The data collected for one target over all the frames. Every frame has a range of
+    /// values (octets or long strings) and a range of counts for each of the dimensioning path
+    /// elements (all but the last) of the target. The ranges are stored as running end offsets so
+    /// the storage is a handful of contiguous arrays no matter how many frames there are.
+    ///
+    /// \par Consecutive frames with the same shape (same target, same counts for every dimension
+    /// and the same number of values) are grouped into runs as they are appended. Long runs are
+    /// common (ex: all the scans of one satellite) and the frames of a run can be analyzed and
+    /// copied as one block since their values are laid out the same way.
+    ///
+    /// \par The values and counts go back to the BufferPool when the column is destroyed, and
+    /// grow into pooled buffers when columns are merged.
+    class Column
+    {
+     public:
+        Column() = default;
+        Column(const Column&) = default;
+        Column(Column&&) = default;
+        Column& operator=(const Column&) = default;
+        Column& operator=(Column&&) = default;
+
+        ~Column()
+        {
+            BufferPool::give(octets_);
+            BufferPool::give(counts_);
+        }
+
+        /// \brief Append the data a frame collected for a target. The repeats the filters of
+        ///        the target leave out aren't kept, so the frame is stored (and assembled) as if
+        ///        it only had the repeats that were asked for.
+        /// \param frame The frame.
+        /// \param target The target (as resolved for the subset variant of the frame).
+        void append(const SubsetLookupTable& frame, const TargetPtr& target)
+        {
+            const size_t frameIdx = numFrames();
+            const size_t numDims = target->path.empty() ? 0 : target->path.size() - 1;
+            if (target->usesFilters && numDims > 1)
+            {
+                appendFiltered(frame, *target, numDims);
+            }
+            else
+            {
+                for (size_t dimIdx = 0; dimIdx < numDims; ++dimIdx)
+                {
+                    const auto dimCounts = frame.counts(target->path[dimIdx].nodeId);
+                    counts_.insert(counts_.end(), dimCounts.begin(), dimCounts.end());
+                    countEnds_.push_back(counts_.size());
+                }
+
+                const auto data = frame.data(target->nodeIdx);
+                octets_.insert(octets_.end(), data.octets.begin(), data.octets.end());
+                appendStrings(data.strings);
+            }
+
+            dimEnds_.push_back(countEnds_.size());
+            octetEnds_.push_back(octets_.size());
+            stringEnds_.push_back(strings_.size());
+
+            if (frameIdx > 0 && target.get() == lastTarget_ && sameShape(frameIdx - 1, frameIdx))
+            {
+                ++runEnds_.back();
+            }
+            else
+            {
+                runEnds_.push_back(frameIdx + 1);
+            }
+
+            lastTarget_ = target.get();
+        }
+
+        /// \brief Move the frames of another column onto the end of this one.
+        /// \param other The column to take the frames from.
+        void append(Column&& other)
+        {
+            // The first run of the other column is kept as a run of its own.
+            appendOffsets(runEnds_, other.runEnds_, numFrames());
+            if (!other.runEnds_.empty()) lastTarget_ = other.lastTarget_;
+
+            appendOffsets(countEnds_, other.countEnds_, counts_.size());
+            appendOffsets(dimEnds_, other.dimEnds_, countEnds_.size() - other.countEnds_.size());
+            appendOffsets(octetEnds_, other.octetEnds_, octets_.size());
+            appendOffsets(stringEnds_, other.stringEnds_, strings_.size());
+
+            appendValues(counts_, other.counts_);
+            appendValues(octets_, other.octets_);
+
+            strings_.reserve(strings_.size() + other.strings_.size());
+            for (const auto& ref : other.strings_)
+            {
+                strings_.push_back({ref.offset + chars_.size(), ref.size});
+            }
+            chars_.append(other.chars_);
+
+            BufferPool::give(other.octets_);
+            BufferPool::give(other.counts_);
+            other = Column();
+        }
+
+        /// \brief Get the counts of a dimensioning path element in a frame.
+        /// \param frameIdx The frame.
+        /// \param dimIdx The index of the path element.
+        SubsetLookupTable::Counts counts(size_t frameIdx, size_t dimIdx) const
+        {
+            const auto countIdx = begin(dimEnds_, frameIdx) + dimIdx;
+            if (countIdx >= dimEnds_[frameIdx]) return SubsetLookupTable::Counts();
+
+            const auto countsBegin = begin(countEnds_, countIdx);
+            return SubsetLookupTable::Counts(counts_.data() + countsBegin,
+                                             countEnds_[countIdx] - countsBegin);
+        }
+
+        /// \brief Get the data of a frame.
+        /// \param frameIdx The frame.
+        /// \param isLongStr Whether the target holds long strings in that frame.
+        SubsetLookupTable::DataView data(size_t frameIdx, bool isLongStr) const
+        {
+            return data(frameIdx, frameIdx + 1, isLongStr);
+        }
+
+        /// \brief Get the data of a range of frames (the values of the frames one after the
+        ///        other).
+        /// \param frameBegin The first frame.
+        /// \param frameEnd The frame after the last one.
+        /// \param isLongStr Whether the target holds long strings in those frames.
+        SubsetLookupTable::DataView data(size_t frameBegin, size_t frameEnd, bool isLongStr) const
+        {
+            SubsetLookupTable::DataView view;
+            view.isLongStr = isLongStr;
+            if (isLongStr)
+            {
+                const auto dataBegin = begin(stringEnds_, frameBegin);
+                view.strings.chars = chars_.data();
+                view.strings.refs = gsl::span<const LongStrRef>(strings_.data() + dataBegin,
+                                                                stringEnds_[frameEnd - 1] -
+                                                                    dataBegin);
+            }
+            else
+            {
+                const auto dataBegin = begin(octetEnds_, frameBegin);
+                view.octets = gsl::span<const double>(octets_.data() + dataBegin,
+                                                      octetEnds_[frameEnd - 1] - dataBegin);
+            }
+
+            return view;
+        }
+
+        /// \brief The number of frames in the column.
+        size_t numFrames() const { return dimEnds_.size(); }
+
+        /// \brief The number of runs of same shaped frames.
+        size_t numRuns() const { return runEnds_.size(); }
+
+        /// \brief The first frame of a run.
+        size_t runBegin(size_t runIdx) const { return begin(runEnds_, runIdx); }
+
+        /// \brief The frame after the last frame of a run.
+        size_t runEnd(size_t runIdx) const { return runEnds_[runIdx]; }
+
+        /// \brief The run a frame is in.
+        size_t runOf(size_t frameIdx) const
+        {
+            return std::upper_bound(runEnds_.begin(), runEnds_.end(), frameIdx) -
+                   runEnds_.begin();
+        }
+
+        /// \brief The bytes the column holds on to (the capacity of its arrays).
+        size_t byteSize() const
+        {
+            return capacityBytes(counts_) + capacityBytes(countEnds_) + capacityBytes(dimEnds_) +
+                   capacityBytes(octets_) + capacityBytes(octetEnds_) + capacityBytes(strings_) +
+                   capacityBytes(stringEnds_) + capacityBytes(runEnds_) + chars_.capacity();
+        }
+
+     private:
+        std::vector<int> counts_;
+        std::vector<size_t> countEnds_;  // Per frame and dimension, end offset in counts_
+        std::vector<size_t> dimEnds_;  // Per frame, end offset in countEnds_
+        std::vector<double> octets_;
+        std::vector<size_t> octetEnds_;  // Per frame, end offset in octets_
+        std::vector<LongStrRef> strings_;
+        std::vector<size_t> stringEnds_;  // Per frame, end offset in strings_
+        std::string chars_;  // The characters of the long strings
+        std::vector<size_t> runEnds_;  // Per run of same shaped frames, the frame after its last
+        const Target* lastTarget_ = nullptr;  // The target of the last frame
+
+        /// \brief Do two frames have the same counts (for every dimension) and number of values?
+        bool sameShape(size_t frameIdx, size_t otherFrameIdx) const
+        {
+            const auto dimBegin = begin(dimEnds_, frameIdx);
+            const auto otherDimBegin = begin(dimEnds_, otherFrameIdx);
+            const auto numDims = dimEnds_[frameIdx] - dimBegin;
+            if (dimEnds_[otherFrameIdx] - otherDimBegin != numDims) return false;
+
+            if (octetEnds_[frameIdx] - begin(octetEnds_, frameIdx) !=
+                    octetEnds_[otherFrameIdx] - begin(octetEnds_, otherFrameIdx) ||
+                stringEnds_[frameIdx] - begin(stringEnds_, frameIdx) !=
+                    stringEnds_[otherFrameIdx] - begin(stringEnds_, otherFrameIdx))
+            {
+                return false;
+            }
+
+            for (size_t dimIdx = 0; dimIdx < numDims; ++dimIdx)
+            {
+                const auto counts = this->counts(frameIdx, dimIdx);
+                const auto otherCounts = this->counts(otherFrameIdx, dimIdx);
+                if (counts.size() != otherCounts.size() ||
+                    !std::equal(counts.begin(), counts.end(), otherCounts.begin()))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /// \brief The state of the walk through the repeats of a frame (see appendFiltered).
+        struct FilterWalk
+        {
+            struct Level
+            {
+                SubsetLookupTable::Counts counts;
+                size_t countIdx = 0;  // Next instance of the level in counts
+                std::vector<int> keptCounts;
+            };
+
+            const Target* target = nullptr;
+            SubsetLookupTable::DataView data;
+            size_t valueIdx = 0;
+            std::vector<Level> levels;
+            std::vector<LongStrRef> keptStrings;
+        };
+
+        /// \brief Append the counts and values of a frame that the filters of the target keep.
+        ///        The repeats of every dimension are walked in the order their values come in,
+        ///        the ones that are left out (or that are in a repeat that is) are skipped and
+        ///        each count becomes the number of repeats that are kept.
+        /// \param frame The frame.
+        /// \param target The target.
+        /// \param numDims The number of dimensioning path elements of the target.
+        void appendFiltered(const SubsetLookupTable& frame, const Target& target, size_t numDims)
+        {
+            thread_local FilterWalk walk;
+            walk.target = &target;
+            walk.data = frame.data(target.nodeIdx);
+            walk.valueIdx = 0;
+            walk.keptStrings.clear();
+            walk.levels.resize(numDims);
+            for (size_t dimIdx = 0; dimIdx < numDims; ++dimIdx)
+            {
+                auto& level = walk.levels[dimIdx];
+                level.counts = frame.counts(target.path[dimIdx].nodeId);
+                level.countIdx = 0;
+                level.keptCounts.clear();
+            }
+
+            while (walk.levels[0].countIdx < walk.levels[0].counts.size())
+            {
+                walkFiltered(walk, 0, true);
+            }
+
+            for (const auto& level : walk.levels)
+            {
+                counts_.insert(counts_.end(), level.keptCounts.begin(), level.keptCounts.end());
+                countEnds_.push_back(counts_.size());
+            }
+
+            LongStrSpan strings;
+            strings.chars = walk.data.strings.chars;
+            strings.refs = gsl::span<const LongStrRef>(walk.keptStrings.data(),
+                                                       walk.keptStrings.size());
+            appendStrings(strings);
+        }
+
+        /// \brief Walk the next instance of a level (missing counts are taken to be 0), keeping
+        ///        the values of the kept repeats and its count if the instance itself is kept.
+        /// \param walk The state of the walk.
+        /// \param dimIdx The level.
+        /// \param isKept Whether the instance is kept.
+        void walkFiltered(FilterWalk& walk, size_t dimIdx, bool isKept)
+        {
+            auto& level = walk.levels[dimIdx];
+            const int count = (level.countIdx < level.counts.size()) ?
+                std::max(level.counts[level.countIdx++], 0) : 0;
+
+            const bool isLastLevel = (dimIdx + 1 == walk.levels.size());
+            int numKept = 0;
+            for (int repeat = 1; repeat <= count; ++repeat)
+            {
+                const bool keepsRepeat = isKept && walk.target->keepsRepeat(dimIdx, repeat);
+                if (!isLastLevel)
+                {
+                    walkFiltered(walk, dimIdx + 1, keepsRepeat);
+                }
+                else if (walk.valueIdx < walk.data.size())
+                {
+                    if (keepsRepeat && walk.data.isLongStr)
+                    {
+                        walk.keptStrings.push_back(walk.data.strings.refs[walk.valueIdx]);
+                    }
+                    else if (keepsRepeat)
+                    {
+                        octets_.push_back(walk.data.octets[walk.valueIdx]);
+                    }
+
+                    ++walk.valueIdx;
+                }
+                else
+                {
+                    break;
+                }
+
+                numKept += keepsRepeat;
+            }
+
+            if (isKept) level.keptCounts.push_back(numKept);
+        }
+
+        /// \brief Append long strings, copying the part of their buffer they use.
+        void appendStrings(const LongStrSpan& strings)
+        {
+            if (strings.empty()) return;
+
+            size_t charsBegin = strings.refs[0].offset;
+            size_t charsEnd = charsBegin;
+            for (const auto& ref : strings.refs)
+            {
+                charsBegin = std::min(charsBegin, ref.offset);
+                charsEnd = std::max(charsEnd, ref.offset + ref.size);
+            }
+
+            const auto offset = chars_.size();
+            chars_.append(strings.chars + charsBegin, charsEnd - charsBegin);
+            for (const auto& ref : strings.refs)
+            {
+                strings_.push_back({ref.offset - charsBegin + offset, ref.size});
+            }
+        }
+
+        template<typename T>
+        static void appendValues(std::vector<T>& values, const std::vector<T>& otherValues)
+        {
+            const auto size = values.size();
+            BufferPool::resize(values, size + otherValues.size());
+            std::copy(otherValues.begin(), otherValues.end(), values.begin() + size);
+        }
+
+        template<typename T>
+        static size_t capacityBytes(const std::vector<T>& vec)
+        {
+            return vec.capacity() * sizeof(T);
+        }
+
+        static size_t begin(const std::vector<size_t>& ends, size_t idx)
+        {
+            return idx == 0 ? 0 : ends[idx - 1];
+        }
 
+        static void appendOffsets(std::vector<size_t>& ends,
+                                  const std::vector<size_t>& otherEnds,
+                                  size_t offset)
+        {
+            ends.reserve(ends.size() + otherEnds.size());
+            for (const auto& end : otherEnds)
+            {
+                ends.push_back(end + offset);
+            }
+        }
+    };
 }  // namespace details
 
     typedef SubsetLookupTable Frame;
-    typedef std::vector<Frame> Frames;
 
     /// \brief This class acts as the container for all the data that is collected during the
-    /// the BUFR querying process in the form of SubsetLookupTable instances.
+    /// the BUFR querying process. Each SubsetLookupTable (frame) that is added is appended
+    /// target by target to columns (see details::Column), so the accumulated data is stored
+    /// contiguously per target rather than as a list of frames.
     ///
     /// \par The getter functions for the data construct the final output based on the data and
-    /// metadata in these lookup tables. There are many complications. For one the data may be
-    /// jagged (lookup table instances don't necessarily all have the same number of elements
+    /// metadata in these columns. There are many complications. For one the data may be
+    /// jagged (frames don't necessarily all have the same number of elements
     /// [repeated data could have a different number of repeats per instance]). Another is the
     /// application group_by fields which affect the dimensionality of the data. In order to make
     /// the data into rectangular arrays it may be necessary to strategically fill in missing values
     /// so that the data is organized correctly in each dimension.
     ///
+    /// \par The data is assembled at the width of the type it will end up as (float and 32 bit
+    /// int fields are stored narrow, see Data::Storage) so the DataObjects can take it as is.
+    ///
+    /// \par The metadata and the assembled data of every field that is requested are memoized
+    /// (keyed by field, group_by field and storage) until the field is released (see release)
+    /// or more frames are added.
+    ///
     class ResultSet
     {
      public:
+        /// \brief Describes one field to get from the ResultSet (see get).
+        struct FieldRequest
+        {
+            std::string fieldName;
+            std::string groupByFieldName;
+            std::string overrideType;
+        };
+
         ResultSet() = default;
+        ResultSet(ResultSet&&) = default;
+        ResultSet& operator=(ResultSet&&) = default;
         ~ResultSet() = default;
 
         /// \brief Gets the resulting data for a specific field with a given name grouped by the
@@ -91,12 +506,66 @@ namespace details
             const std::string& groupByFieldName = "",
             const std::string& overrideType = "") const;
 
-        /// \brief Move a new frame into the ResultSet.
-        /// \param frame The NodeLookupTable to std::move.
-        void addFrame(Frame&& frame)
-        {
-            frames_.push_back(std::move(frame));
-        }
+        /// \brief Gets the resulting data for a field given its handle (see QuerySet::handleFor,
+        /// the ResultSet must have been made with that QuerySet).
+        /// \param field The handle of the field.
+        /// \param groupBy The handle of the field to group the data by (or QuerySet::NoHandle).
+        /// \param overrideType The name of the override type to convert the data to.
+        /// \return A Result object containing the data.
+        std::shared_ptr<Ingester::DataObjectBase>
+        get(QuerySet::FieldHandle field,
+            QuerySet::FieldHandle groupBy = QuerySet::NoHandle,
+            const std::string& overrideType = "") const;
+
+        /// \brief Gets the resulting data for many fields at once. This is faster than calling
+        /// get for each field as the frames are only analyzed once for all the fields (and their
+        /// group_by fields).
+        /// \param fields The fields to get.
+        /// \param threads The number of threads to use to build the fields.
+        /// \return The DataObjects for the fields (in the same order).
+        std::vector<std::shared_ptr<Ingester::DataObjectBase>>
+        getMany(const std::vector<FieldRequest>& fields, size_t threads = 1) const;
+
+        /// \brief Gets the resulting data for many (ungrouped) fields given their handles (see
+        /// QuerySet::handleFor).
+        /// \param fields The handles of the fields to get.
+        /// \param threads The number of threads to use to build the fields.
+        /// \return The DataObjects for the fields (in the same order).
+        std::vector<std::shared_ptr<Ingester::DataObjectBase>>
+        getMany(const std::vector<QuerySet::FieldHandle>& fields, size_t threads = 1) const;
+
+        /// \brief Gets the name of the field with the given handle.
+        /// \param field The handle of the field.
+        const std::string& fieldName(QuerySet::FieldHandle field) const;
+
+        /// \brief Free the memoized metadata and data of a field (for all its group_by fields)
+        ///        once it is no longer needed. The field can still be requested afterwards. The
+        ///        fields with the same query string are released with it.
+        /// \param fieldName The name of the field.
+        void release(const std::string& fieldName);
+
+        /// \brief Turn the memoization of the requested fields on or off (on by default). Turn
+        ///        it off when each field is only requested once, so the assembled data isn't kept
+        ///        alongside the DataObjects made from it.
+        /// \param caching Whether to memoize the fields.
+        void setCaching(bool caching);
+
+        /// \brief Append the data of a frame to the ResultSet.
+        /// \param frame The SubsetLookupTable to add (can be reused once added).
+        void addFrame(const Frame& frame);
+
+        /// \brief True if no data (frames) were collected.
+        bool empty() const { return numFrames_ == 0; }
+
+        /// \brief The number of frames (subsets) that were collected.
+        size_t numFrames() const { return numFrames_; }
+
+        /// \brief The bytes the collected frames hold on to (not counting the memoized fields).
+        size_t byteSize() const;
+
+        /// \brief Move all the frames of another ResultSet onto the end of this one.
+        /// \param other The ResultSet to take the frames from (left empty).
+        void merge(ResultSet&& other);
 
 #ifdef BUILD_PYTHON_BINDING
         /// \brief Gets a numpy array for the resulting data for a specific field with a given
@@ -128,45 +597,87 @@ namespace details
 #endif
 
      private:
-        Frames frames_;
+        size_t numFrames_ = 0;
+        std::vector<std::shared_ptr<const SubsetLookupLayout>> layouts_;
+        std::vector<unsigned int> frameLayouts_;  // Per frame, the index in layouts_
+        std::vector<details::Column> columns_;  // One per target (empty for shared targets)
+        std::unordered_map<std::string, size_t> targetIdxs_;  // Shared target idx by name
+        bool caching_ = true;
+        std::unique_ptr<details::FieldCache> cache_ = std::make_unique<details::FieldCache>();
+
+        /// \brief Gets the target for the given target idx as resolved for a frame.
+        /// \param frameIdx The frame.
+        /// \param targetIdx The target idx.
+        const TargetPtr& targetAt(size_t frameIdx, size_t targetIdx) const
+        {
+            return layouts_[frameLayouts_[frameIdx]]->targets()->at(targetIdx);
+        }
+
+        /// \brief Gets the idx for the target with the given name. Targets with the same query
+        ///        string share the idx of the first one (see Target::sharedIdx).
+        /// \param name The name of the target.
+        size_t targetIdx(const std::string& name) const;
+
+        /// \brief Gets the name of the target whose data the field with the given name uses.
+        /// \param name The name of the field (empty for none).
+        const std::string& sharedName(const std::string& name) const;
+
+        /// \brief Maps the names of the targets to their (shared) idx (the targets are in the
+        ///        same order in all the layouts, see QuerySet::handleFor). Done with the first
+        ///        layout.
+        /// \param layout The layout.
+        void indexTargets(const SubsetLookupLayout& layout);
+
+        /// \brief Gets the metadata for targets, from the cache when they were already analyzed.
+        /// \param names The names of the targets to get the metadata for.
+        /// \param threads The number of threads to use to analyze the targets.
+        /// \return The TargetMetaData objects (in the same order).
+        std::vector<details::TargetMetaDataPtr>
+        metaDataFor(const std::vector<std::string>& names, size_t threads) const;
 
-        /// \brief Computes and returns metadata associated with a target.
-        /// \param name The name of the target to get the metadata for.
-        /// \return A TargetMetaData object containing the metadata.
-        details::TargetMetaDataPtr analyzeTarget(const std::string& name) const;
+        /// \brief Gets the assembled (and grouped) data for a field, from the cache when it was
+        ///        already built.
+        /// \param field The field.
+        /// \param targetMetaData The metadata for the field.
+        /// \param groupByMetaData The metadata for the group_by field (if there is one).
+        /// \param threads The number of threads to assemble the field with.
+        details::ResultDataPtr resultData(const FieldRequest& field,
+                                          const details::TargetMetaDataPtr& targetMetaData,
+                                          const details::TargetMetaDataPtr& groupByMetaData,
+                                          size_t threads = 1) const;
+
+        /// \brief Computes and returns the metadata for targets in one pass over the frames.
+        /// \param names The names of the targets to get the metadata for.
+        /// \param threads The number of threads to spread the targets (and the runs of their
+        ///        frames) over.
+        /// \return The TargetMetaData objects (in the same order).
+        std::vector<details::TargetMetaDataPtr>
+        analyzeTargets(const std::vector<std::string>& names, size_t threads = 1) const;
+
+        /// \brief Updates the metadata of a target with the information in a frame.
+        /// \param metaData The metadata to update.
+        /// \param frameIdx The frame.
+        /// \return False if the frame has no data for the target.
+        bool analyzeFrame(details::TargetMetaData& metaData, size_t frameIdx) const;
+
+        /// \brief Completes the metadata of a target once all the frames were analyzed.
+        /// \param metaData The metadata to complete.
+        void finishAnalysis(details::TargetMetaData& metaData) const;
 
         /// \brief Assembles the data fragments for a target into a single ResultData object.
         /// \param targetMetaData The metadata for the target to assemble the data for.
+        /// \param storage How to store the data (see storageFor).
+        /// \param threads The number of threads to copy the frames of a large field with.
         /// \return A ResultData object containing the data.
-        details::ResultData assembleData(const details::TargetMetaDataPtr& targetMetaData) const;
-
-        /// \brief Copies the data from a frame into a ResultData object.
-        /// \param data The ResultData object to copy the data into.
-        /// \param frame The frame to copy the data from.
-        /// \param target The target to copy the data for.
-        /// \param outputOffset The offset into the ResultData object to copy the data to.
-        void copyData(details::ResultData& data,
-                      const Frame& frame,
-                      const TargetPtr& target,
-                      size_t outputOffset) const;
-
-        /// \brief Copies the data from a frame into a ResultData object.
-        /// \param data The ResultData object to copy the data into.
-        /// \param frame The frame to copy the data from.
-        /// \param target The target to copy the data for.
-        /// \param outputOffset The offset into the ResultData object to copy the data to.
-        /// \param inputOffset The offset into the frame to copy the data from.
-        /// \param dimIdx The index of the dimension to copy the data for.
-        /// \param countNumber The current count
-        /// \param countOffset The offset into the count array.
-        void _copyData(details::ResultData& data,
-                       const Frame& frame,
-                       const TargetPtr& target,
-                       size_t& outputOffset,
-                       size_t& inputOffset,
-                       const size_t dimIdx,
-                       const size_t countNumber,
-                       const size_t countOffset) const;
+        details::ResultData assembleData(const details::TargetMetaDataPtr& targetMetaData,
+                                         Data::Storage storage,
+                                         size_t threads = 1) const;
+
+        /// \brief Get the narrowest storage that holds the values of a field without changing
+        ///        the DataObject made from it (the type override or the type for the TypeInfo).
+        /// \param info The meta data for the element.
+        /// \param overrideType The name of the override type (if any).
+        Data::Storage storageFor(const TypeInfo& info, const std::string& overrideType) const;
 
         /// \brief Validates that the group_by field is valid for the target. Throws an exception if
         ///        it is not.
@@ -176,34 +687,13 @@ namespace details
                                   const details::TargetMetaDataPtr& groupByMetaData) const;
 
 
-        /// \brief Copies filtered data from a source ResultData object into a destination
-        ///        ResultData object.
-        /// \param resData The ResultData object to copy the data into.
-        /// \param srcData The ResultData object to copy the data from.
-        /// \param target The target to copy the data for.
-        /// \param inputOffset The offset into the source ResultData object to copy the data from.
-        /// \param outputOffset The offset into the destination ResultData object to copy the data
-        ///        to.
-        /// \param depth The depth of the dimension to copy the data for.
-        /// \param filterDataList The list of filter data to apply.
-        /// \param skipResult Whether to skip copying the result data.
-        void copyFilteredData(details::ResultData& resData,
-                              const details::ResultData& srcData,
-                              const TargetPtr& target,
-                              size_t& inputOffset,
-                              size_t& outputOffset,
-                              size_t depth,
-                              size_t maxDepth,
-                              const FilterDataList& filterDataList,
-                              bool skipResult) const;
-
         /// \brief Modify the ResultData object to apply the group_by field.
         /// \param resData The ResultData object to modify.
         /// \param targetMetaData The metadata for the target.
-        /// \param groupByFieldName The name of the field to group the data by.
+        /// \param groupByMetaData The metadata for the field to group the data by.
         void applyGroupBy(details::ResultData& resData,
                           const details::TargetMetaDataPtr& targetMetaData,
-                          const std::string& groupByFieldName) const;
+                          const details::TargetMetaDataPtr& groupByMetaData) const;
 
         /// \brief Is the field a string field?
         /// \param fieldName The name of the field.
@@ -216,6 +706,7 @@ namespace details
         /// \param overrideType The name of the override type to convert the data to. Possible
         /// values are int, uint, int32, uint32, int64, uint64, float, double
         /// \param data The data
+        /// \param validity Which values of the data are there (can be null).
         /// \param dims The dimensioning information
         /// \param dimPaths The sub-query path strings for each dimension.
         /// \return A Result DataObject containing the data.
@@ -225,6 +716,7 @@ namespace details
                                 const TypeInfo& info,
                                 const std::string& overrideType,
                                 const Data& data,
+                                const std::shared_ptr<const Validity>& validity,
                                 const std::vector<int>& dims,
                                 const std::vector<Query>& dimPaths) const;
 
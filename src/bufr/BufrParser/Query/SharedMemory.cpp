@@ -0,0 +1,139 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "SharedMemory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    std::string segmentName(const std::string& name)
+    {
+        return (!name.empty() && name[0] == '/') ? name : "/" + name;
+    }
+
+    void* mapSegment(int fd, size_t size)
+    {
+        // mmap fails with a size of 0, the segment is then mapped with one (unused) byte.
+        void* addr = mmap(nullptr, size == 0 ? 1 : size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          fd, 0);
+        return addr == MAP_FAILED ? nullptr : addr;
+    }
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    std::shared_ptr<SharedMemory> SharedMemory::create(const std::string& name, size_t size)
+    {
+        const auto fullName = segmentName(name);
+        const int fd = shm_open(fullName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't create the shared memory segment " << fullName << " ("
+                   << std::strerror(errno) << ").";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        void* addr = nullptr;
+        if (ftruncate(fd, static_cast<off_t>(size == 0 ? 1 : size)) == 0)
+        {
+            addr = mapSegment(fd, size);
+        }
+
+        const auto mapError = errno;
+        ::close(fd);
+
+        if (addr == nullptr)
+        {
+            shm_unlink(fullName.c_str());
+
+            std::ostringstream errStr;
+            errStr << "Couldn't allocate " << size << " bytes of shared memory for "
+                   << fullName << " (" << std::strerror(mapError) << ").";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        return std::shared_ptr<SharedMemory>(new SharedMemory(fullName, addr, size, true));
+    }
+
+    std::shared_ptr<SharedMemory> SharedMemory::open(const std::string& name)
+    {
+        const auto fullName = segmentName(name);
+        const int fd = shm_open(fullName.c_str(), O_RDWR, 0);
+        if (fd < 0)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't open the shared memory segment " << fullName << " ("
+                   << std::strerror(errno) << ").";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        struct stat info;
+        void* addr = nullptr;
+        size_t size = 0;
+        if (fstat(fd, &info) == 0)
+        {
+            size = static_cast<size_t>(info.st_size);
+            addr = mapSegment(fd, size);
+        }
+
+        ::close(fd);
+
+        if (addr == nullptr)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't map the shared memory segment " << fullName << ".";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        return std::shared_ptr<SharedMemory>(new SharedMemory(fullName, addr, size, false));
+    }
+
+    std::string SharedMemory::uniqueName()
+    {
+        static std::atomic<size_t> counter(0);
+
+        std::ostringstream name;
+        name << "/bufr_" << getpid() << "_" << counter++;
+        return name.str();
+    }
+
+    SharedMemory::SharedMemory(const std::string& name, void* data, size_t size, bool isOwner) :
+        name_(name),
+        data_(static_cast<unsigned char*>(data)),
+        size_(size),
+        isOwner_(isOwner)
+    {
+    }
+
+    SharedMemory::~SharedMemory()
+    {
+        munmap(data_, size_ == 0 ? 1 : size_);
+        unlink();
+    }
+
+    void SharedMemory::unlink()
+    {
+        if (!isOwner_) return;
+
+        shm_unlink(name_.c_str());
+        isOwner_ = false;
+    }
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,60 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief A POSIX shared memory segment (shm_open) mapped into the process, so other
+    ///        processes can map the same bytes by name without copying them (ex: the fields of a
+    ///        ResultSet handed to Python multiprocessing workers). The segment that created the
+    ///        name removes it when it is destroyed, the mappings of the other processes stay
+    ///        valid until they are destroyed too.
+    class SharedMemory
+    {
+     public:
+        /// \brief Create a new segment.
+        /// \param name The name of the segment (a '/' is prepended if it doesn't start with one).
+        ///        Fails if a segment with that name exists.
+        /// \param size The size of the segment in bytes.
+        static std::shared_ptr<SharedMemory> create(const std::string& name, size_t size);
+
+        /// \brief Map an existing segment (read and write).
+        /// \param name The name of the segment.
+        static std::shared_ptr<SharedMemory> open(const std::string& name);
+
+        /// \brief Make a name no other segment of this process has (ex: "/bufr_1234_7").
+        static std::string uniqueName();
+
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        ~SharedMemory();
+
+        /// \brief Remove the name of the segment (the segment is freed once nobody maps it).
+        ///        Done on destruction for the segments this process created.
+        void unlink();
+
+        unsigned char* data() const { return data_; }
+        size_t size() const { return size_; }
+        const std::string& name() const { return name_; }
+
+     private:
+        std::string name_;
+        unsigned char* data_ = nullptr;
+        size_t size_ = 0;
+        bool isOwner_ = false;
+
+        SharedMemory(const std::string& name, void* data, size_t size, bool isOwner);
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -7,110 +7,317 @@
 
 #include "SubsetLookupTable.h"
 
+#include <algorithm>
+
 
 namespace Ingester {
 namespace bufr {
-    SubsetLookupTable::SubsetLookupTable(const std::shared_ptr<DataProvider>& dataProvider,
-                                         const std::shared_ptr<Targets>& targets) :
+    SubsetLookupLayout::SubsetLookupLayout(const std::shared_ptr<DataProvider>& dataProvider,
+                                           const std::shared_ptr<Targets>& targets) :
         targets_(targets),
-        lookupTable_(makeLookupTable(dataProvider, *targets))
+        startNode_(dataProvider->getInode())
     {
+        nodeSlots_.assign(dataProvider->getIsc(dataProvider->getInode()) - startNode_ + 1, NoSlot);
+
+        // Add slots for all the path nodes in the targets that are containers (can contain)
+        // children. Uses merged data from the Subset metadata and Query strings.
+        for (const auto& target : *targets_)
+        {
+            for (const auto& path : target->path)
+            {
+                if (path.isContainer())
+                {
+                    auto& slot = slotFor(path.nodeId);
+                    slot.collectsCounts = true;
+                    slot.type = path.type;
+                    slot.fixedRepeatCount = path.fixedRepeatCount;
+                }
+            }
+        }
+
+        // Add slots for the target nodes themselves.
+        for (const auto& target : *targets_)
+        {
+            if (target->nodeIdx == 0) { continue; }
+
+            auto& slot = slotFor(target->nodeIdx);
+            slot.collectsData = true;
+            slot.isLongStr = target->typeInfo.isLongString();
+            slot.longStrId = target->longStrId;
+        }
     }
 
-    SubsetLookupTable::LookupTable
-    SubsetLookupTable::makeLookupTable(const std::shared_ptr<DataProvider>& dataProvider,
-                                       const Targets& targets) const
+    SubsetLookupLayout::Slot& SubsetLookupLayout::slotFor(size_t nodeId)
     {
-        auto lookupTable = LookupTable(dataProvider->getInode(),
-                                       dataProvider->getIsc(dataProvider->getInode()));
+        auto& slotIdx = nodeSlots_[nodeId - startNode_];
+        if (slotIdx == NoSlot)
+        {
+            slotIdx = static_cast<int>(slots_.size());
+            slots_.emplace_back();
+            slots_.back().nodeId = nodeId;
+        }
 
-        auto lookupMetaTable = LookupMetaTable(dataProvider->getInode(),
-                                               dataProvider->getIsc(dataProvider->getInode()));
+        return slots_[slotIdx];
+    }
 
-        // Populate the lookup table with the counts and data corresponding to each BUFR node
-        // we care about.
-        addCounts(dataProvider, targets, lookupTable, lookupMetaTable);
-        addData(dataProvider, targets, lookupTable, lookupMetaTable);
+    SubsetLookupTable::SubsetLookupTable(const std::shared_ptr<DataProvider>& dataProvider,
+                                         const std::shared_ptr<const SubsetLookupLayout>& layout)
+    {
+        load(dataProvider, layout);
+    }
 
-        return lookupTable;
+    void SubsetLookupTable::load(const std::shared_ptr<DataProvider>& dataProvider,
+                                 const std::shared_ptr<const SubsetLookupLayout>& layout)
+    {
+        layout_ = layout;
+
+        const auto numVals = static_cast<size_t>(dataProvider->getNVal());
+
+        // Populate the buffers with the counts and data corresponding to each BUFR node we care
+        // about.
+        collect(gsl::span<const double>(dataProvider->getVals().data(), numVals),
+                gsl::span<const int>(dataProvider->getInvs().data(), numVals),
+                [&dataProvider](const std::vector<std::string>& longStrIds,
+                                const std::vector<size_t>&,
+                                std::string& chars,
+                                std::vector<size_t>& ends)
+                {
+                    dataProvider->readLongStrs(longStrIds, chars, ends);
+                });
     }
 
-    void SubsetLookupTable::addCounts(const std::shared_ptr<DataProvider>& dataProvider,
-                                      const Targets &targets,
-                                      LookupTable& lookup,
-                                      LookupMetaTable& lookupMeta) const
+    void SubsetLookupTable::load(const Snapshot& snapshot)
     {
-        // Add entries for all the path nodes in the targets that are containers (can contain)
-        // children. Uses merged data from the Subset metadata and Query strings.
-        for (const auto& target : targets)
+        layout_ = snapshot.layout;
+
+        collect(gsl::span<const double>(snapshot.vals.data(), snapshot.vals.size()),
+                gsl::span<const int>(snapshot.invs.data(), snapshot.invs.size()),
+                [&snapshot](const std::vector<std::string>&,
+                            const std::vector<size_t>& longStrSlots,
+                            std::string& chars,
+                            std::vector<size_t>& ends)
+                {
+                    ends.resize(longStrSlots.size());
+                    for (size_t strIdx = 0; strIdx < longStrSlots.size(); ++strIdx)
+                    {
+                        const auto& ref = snapshot.longStrs[longStrSlots[strIdx]];
+                        chars.append(snapshot.chars, ref.offset, ref.size);
+                        ends[strIdx] = chars.size();
+                    }
+                });
+    }
+
+    void SubsetLookupTable::capture(const std::shared_ptr<DataProvider>& dataProvider,
+                                    const std::shared_ptr<const SubsetLookupLayout>& layout,
+                                    Snapshot& snapshot)
+    {
+        snapshot.layout = layout;
+
+        const auto numVals = static_cast<size_t>(dataProvider->getNVal());
+        const auto val = dataProvider->getVals();
+        const auto inv = dataProvider->getInvs();
+        snapshot.vals.assign(val.begin(), val.begin() + numVals);
+        snapshot.invs.assign(inv.begin(), inv.begin() + numVals);
+
+        // The long strings can only be read while the subset is open, so read the ones of the
+        // slots that have values now (the same ones collect would read).
+        thread_local std::vector<std::string> longStrIds;
+        thread_local std::vector<size_t> longStrSlots;
+        thread_local std::vector<size_t> longStrEnds;
+        longStrIds.clear();
+        longStrSlots.clear();
+        snapshot.longStrs.assign(layout->numSlots(), LongStrRef());
+        snapshot.chars.clear();
+
+        const auto& nodeSlots = layout->nodeSlots();
+        const auto startNode = layout->startNode();
+        for (const auto nodeId : snapshot.invs)
         {
-            for (const auto& path : target->path)
+            const auto nodeOffset = static_cast<size_t>(nodeId) - startNode;
+            if (nodeOffset >= nodeSlots.size()) continue;
+
+            const auto slotIdx = nodeSlots[nodeOffset];
+            if (slotIdx == SubsetLookupLayout::NoSlot) continue;
+
+            const auto& slot = layout->slot(slotIdx);
+            if (slot.isLongStr && slot.collectsData &&
+                std::find(longStrSlots.begin(), longStrSlots.end(), slotIdx) == longStrSlots.end())
             {
-                if (path.isContainer())
-                {
-                    lookupMeta[path.nodeId].component = path;
-                    lookupMeta[path.nodeId].collectedCounts = true;
-                }
+                longStrIds.push_back(slot.longStrId);
+                longStrSlots.push_back(static_cast<size_t>(slotIdx));
             }
         }
 
-        // Collect all the counts for the nodes that were flagged from the BUFR subset data section.
-        for (size_t cursor = 1; cursor <= dataProvider->getNVal(); ++cursor)
+        dataProvider->readLongStrs(longStrIds, snapshot.chars, longStrEnds);
+        for (size_t strIdx = 0; strIdx < longStrSlots.size(); ++strIdx)
         {
-            const auto& nodeId = dataProvider->getInv(cursor);
-            if (lookupMeta[nodeId].collectedCounts)
+            auto& ref = snapshot.longStrs[longStrSlots[strIdx]];
+            ref.offset = strIdx == 0 ? 0 : longStrEnds[strIdx - 1];
+            ref.size = longStrEnds[strIdx] - ref.offset;
+        }
+    }
+
+    SubsetLookupTable::Counts SubsetLookupTable::counts(size_t nodeId) const
+    {
+        const auto slotIdx = layout_->slotIdx(nodeId);
+        if (slotIdx == SubsetLookupLayout::NoSlot) return Counts();
+
+        const auto& range = countRanges_[slotIdx];
+        return Counts(counts_.data() + range.begin, range.size);
+    }
+
+    SubsetLookupTable::DataView SubsetLookupTable::data(size_t nodeId) const
+    {
+        DataView view;
+
+        const auto slotIdx = layout_->slotIdx(nodeId);
+        if (slotIdx == SubsetLookupLayout::NoSlot) return view;
+
+        const auto& range = dataRanges_[slotIdx];
+        view.isLongStr = layout_->slot(slotIdx).isLongStr;
+        if (view.isLongStr)
+        {
+            view.strings.chars = chars_.data();
+            view.strings.refs = gsl::span<const LongStrRef>(strings_.data() + range.begin,
+                                                            range.size);
+        }
+        else
+        {
+            view.octets = gsl::span<const double>(octets_.data() + range.begin, range.size);
+        }
+
+        return view;
+    }
+
+    template<typename ReadLongStrs>
+    void SubsetLookupTable::collect(gsl::span<const double> val,
+                                    gsl::span<const int> inv,
+                                    ReadLongStrs&& readLongStrs)
+    {
+        // Data elements that belong to a slot (slot index and position in the val array). Kept
+        // between frames so its storage is reused.
+        struct Hit
+        {
+            int slotIdx;
+            int valIdx;
+        };
+        thread_local std::vector<Hit> hits;
+        hits.clear();
+
+        countRanges_.assign(layout_->numSlots(), Range());
+        dataRanges_.assign(layout_->numSlots(), Range());
+
+        const auto& nodeSlots = layout_->nodeSlots();
+        const auto startNode = layout_->startNode();
+        const auto numVals = static_cast<int>(val.size());
+
+        // The one pass over the subset data section. Finds the elements we care about and sizes
+        // the slots.
+        for (int valIdx = 0; valIdx < numVals; ++valIdx)
+        {
+            const auto nodeOffset = static_cast<size_t>(inv[valIdx]) - startNode;
+            if (nodeOffset >= nodeSlots.size()) continue;
+
+            const auto slotIdx = nodeSlots[nodeOffset];
+            if (slotIdx == SubsetLookupLayout::NoSlot) continue;
+
+            hits.push_back({slotIdx, valIdx});
+
+            const auto& slot = layout_->slot(slotIdx);
+            countRanges_[slotIdx].size += slot.collectsCounts;
+            dataRanges_[slotIdx].size += slot.collectsData;
+        }
+
+        // Pack the slots one after the other in the buffers. The sizes are reset so they can be
+        // used as insertion points while filling.
+        size_t numCounts = 0;
+        size_t numOctets = 0;
+        size_t numStrings = 0;
+        for (size_t slotIdx = 0; slotIdx < layout_->numSlots(); ++slotIdx)
+        {
+            auto& countRange = countRanges_[slotIdx];
+            countRange.begin = numCounts;
+            numCounts += countRange.size;
+            countRange.size = 0;
+
+            auto& dataRange = dataRanges_[slotIdx];
+            auto& numData = layout_->slot(slotIdx).isLongStr ? numStrings : numOctets;
+            dataRange.begin = numData;
+            numData += dataRange.size;
+            dataRange.size = 0;
+        }
+
+        counts_.resize(numCounts);
+        octets_.resize(numOctets);
+        strings_.resize(numStrings);
+
+        // Read the long strings of the subset in one go. NCEPLIB-bufr returns the same value for
+        // every element of a node (readlc is by mnemonic and occurrence), so every slot needs a
+        // single read and all its values share the characters.
+        thread_local std::vector<std::string> longStrIds;
+        thread_local std::vector<size_t> longStrSlots;
+        thread_local std::vector<size_t> longStrEnds;
+        thread_local std::vector<LongStrRef> slotLongStrs;
+        thread_local std::vector<bool> hasLongStr;
+        longStrIds.clear();
+        longStrSlots.clear();
+        slotLongStrs.assign(layout_->numSlots(), LongStrRef());
+        hasLongStr.assign(layout_->numSlots(), false);
+        for (const auto& hit : hits)
+        {
+            const auto& slot = layout_->slot(hit.slotIdx);
+            if (slot.isLongStr && slot.collectsData && !hasLongStr[hit.slotIdx])
             {
-                const auto &component = lookupMeta[nodeId].component;
+                hasLongStr[hit.slotIdx] = true;
+                longStrIds.push_back(slot.longStrId);
+                longStrSlots.push_back(static_cast<size_t>(hit.slotIdx));
+            }
+        }
+
+        chars_.clear();
+        readLongStrs(longStrIds, longStrSlots, chars_, longStrEnds);
+        for (size_t strIdx = 0; strIdx < longStrSlots.size(); ++strIdx)
+        {
+            auto& ref = slotLongStrs[longStrSlots[strIdx]];
+            ref.offset = strIdx == 0 ? 0 : longStrEnds[strIdx - 1];
+            ref.size = longStrEnds[strIdx] - ref.offset;
+        }
 
-                if (component.type == TargetComponent::Type::Subset)
+        for (const auto& hit : hits)
+        {
+            const auto& slot = layout_->slot(hit.slotIdx);
+            if (slot.collectsCounts)
+            {
+                auto& range = countRanges_[hit.slotIdx];
+                auto& count = counts_[range.begin + range.size++];
+
+                if (slot.type == TargetComponent::Type::Subset)
                 {
                     // Subsets always have a count of 1.
-                    lookup[nodeId].counts.push_back(1);
+                    count = 1;
                 }
-                else if (component.fixedRepeatCount > 1)
+                else if (slot.fixedRepeatCount > 1)
                 {
                     // Fixed repeat counts are stored in the component.
-                    lookup[nodeId].counts.push_back(component.fixedRepeatCount);
+                    count = static_cast<int>(slot.fixedRepeatCount);
                 }
                 else
                 {
                     // Otherwise, the count is stored in the val array.
-                    lookup[nodeId].counts.push_back(dataProvider->getVal(cursor));
+                    count = static_cast<int>(val[hit.valIdx]);
                 }
             }
-        }
-    }
 
-    void SubsetLookupTable::addData(const std::shared_ptr<DataProvider>& dataProvider,
-                                    const Targets &targets,
-                                    LookupTable& lookup,
-                                    LookupMetaTable& lookupMeta) const
-    {
-        // Reserve space for the data in the lookup table by summing the counts for each node.
-        for (const auto& target : targets)
-        {
-            if (target->nodeIdx == 0) { continue; }
-            const auto &path = target->path.back();
-
-            lookup[target->nodeIdx].data.isLongStr(target->typeInfo.isLongString());
-            lookup[target->nodeIdx].data.reserve(sum(lookup[path.parentDimensionNodeId].counts));
-            lookupMeta[target->nodeIdx].collectedData = true;
-            lookupMeta[target->nodeIdx].longStrId = target->longStrId;
-        }
-
-        for (size_t cursor = 1; cursor <= dataProvider->getNVal(); ++cursor)
-        {
-            const auto& nodeId = dataProvider->getInv(cursor);
-            if (lookupMeta[nodeId].collectedData)
+            if (slot.collectsData)
             {
-                if (lookup[nodeId].data.isLongStr())
+                auto& range = dataRanges_[hit.slotIdx];
+                if (slot.isLongStr)
                 {
-                    auto longStr = dataProvider->getLongStr(lookupMeta[nodeId].longStrId);
-                    lookup[nodeId].data.push_back(longStr);
+                    strings_[range.begin + range.size++] = slotLongStrs[hit.slotIdx];
                 }
                 else
                 {
-                    lookup[nodeId].data.push_back(dataProvider->getVal(cursor));
+                    octets_[range.begin + range.size++] = val[hit.valIdx];
                 }
             }
         }
@@ -8,78 +8,165 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
 
-#include "VectorMath.h"
+#include <gsl/gsl-lite.hpp>
+
 #include "DataProvider/DataProvider.h"
-#include "SubsetTable.h"
 #include "Target.h"
 #include "Constants.h"
-#include "Data.h"
 
 
 namespace Ingester {
 namespace bufr {
 
-    namespace __details
+    /// \brief Location of a long string value in a shared character buffer.
+    struct LongStrRef
     {
-        /// \brief BUFR messages are indexed according to start and stop values that are dependant
-        /// on the message itself (the indexing is a property of the message). This object allows
-        /// lets you make an array where the indexing is offset with respect to the actual position
-        /// of the object in the array.
-        template <typename T>
-        class OffsetArray
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    /// \brief View on long string values packed into a shared character buffer (so collecting
+    ///        them doesn't allocate a std::string per value).
+    struct LongStrSpan
+    {
+        const char* chars = nullptr;
+        gsl::span<const LongStrRef> refs;
+
+        size_t size() const { return refs.size(); }
+        bool empty() const { return refs.empty(); }
+
+        /// \brief Get the value at idx as a string.
+        std::string str(size_t idx) const
         {
-         public:
-            OffsetArray(size_t startIdx, size_t endIdx)
-                : offset_(startIdx)
-            {
-                data_.resize(endIdx - startIdx + 1);
-            }
+            return std::string(chars + refs[idx].offset, refs[idx].size);
+        }
+    };
 
-            T& operator[](size_t idx) { return data_[idx - offset_]; }
-            const T& operator[](size_t idx) const { return data_[idx - offset_]; }
+    /// \brief Describes which BUFR nodes of a subset variant we need to collect counts and data
+    /// for (the containers along the target paths and the targets themselves). Each such node is
+    /// given a slot. The layout only depends on the subset variant and the targets so it is
+    /// computed once per variant and shared by all the SubsetLookupTable frames built with it.
+    class SubsetLookupLayout
+    {
+     public:
+        static constexpr int NoSlot = -1;
 
-         private:
-            std::vector<T> data_;
-            size_t offset_;
+        struct Slot
+        {
+            size_t nodeId = 0;
+            bool collectsCounts = false;
+            bool collectsData = false;
+            TargetComponent::Type type = TargetComponent::Type::Unknown;
+            size_t fixedRepeatCount = 0;
+            bool isLongStr = false;
+            std::string longStrId;
         };
-    }  // namespace __details
+
+        SubsetLookupLayout(const std::shared_ptr<DataProvider>& dataProvider,
+                           const std::shared_ptr<Targets>& targets);
+
+        /// \brief Get the slot index for a BUFR node.
+        /// \param[in] nodeId The id of the node.
+        /// \return The slot index or NoSlot if the node isn't collected.
+        inline int slotIdx(size_t nodeId) const
+        {
+            if (nodeId < startNode_ || nodeId - startNode_ >= nodeSlots_.size()) return NoSlot;
+            return nodeSlots_[nodeId - startNode_];
+        }
+
+        /// \brief Get the node to slot map (NoSlot for the nodes to ignore), starting at
+        ///        startNode().
+        const std::vector<int>& nodeSlots() const { return nodeSlots_; }
+        size_t startNode() const { return startNode_; }
+
+        const Slot& slot(size_t idx) const { return slots_[idx]; }
+        size_t numSlots() const { return slots_.size(); }
+        const std::shared_ptr<Targets>& targets() const { return targets_; }
+
+     private:
+        const std::shared_ptr<Targets> targets_;
+        size_t startNode_;
+        std::vector<int> nodeSlots_;
+        std::vector<Slot> slots_;
+
+        /// \brief Get the slot for a BUFR node, creating it if it doesn't exist yet.
+        Slot& slotFor(size_t nodeId);
+    };
 
     /// \brief Lookup table that maps BUFR subset node ids to the data and counts found in the BUFR
     /// message subset data section. This makes it possible to quickly access the data and counts
-    /// information for a given node.
+    /// information for a given node. Only the nodes in the SubsetLookupLayout are stored, and their
+    /// counts and data are packed into contiguous buffers.
     class SubsetLookupTable
     {
      public:
-        typedef std::vector<int> CountsVector;
+        typedef gsl::span<const int> Counts;
 
-        struct NodeMetaData
+        /// \brief View on the data collected for a node.
+        struct DataView
         {
-            TargetComponent component;
-            std::string longStrId;
-            bool collectedCounts = false;
-            bool collectedData = false;
+            bool isLongStr = false;
+            gsl::span<const double> octets;
+            LongStrSpan strings;
+
+            size_t size() const { return isLongStr ? strings.size() : octets.size(); }
+            bool empty() const { return size() == 0; }
         };
 
-        struct NodeData
+        /// \brief Copy of the data section of a subset (and of the long strings the layout
+        ///        needs), so the table can be loaded from it after NCEPLIB-bufr moved on to the
+        ///        next subset (ex: on another thread, see capture).
+        struct Snapshot
         {
-            Data data;
-            CountsVector counts;
+            std::shared_ptr<const SubsetLookupLayout> layout;
+            std::vector<double> vals;
+            std::vector<int> invs;
+            std::vector<LongStrRef> longStrs;  // By slot
+            std::string chars;  // The characters of the long strings
         };
 
-        typedef __details::OffsetArray<NodeData> LookupTable;
-        typedef __details::OffsetArray<NodeMetaData> LookupMetaTable;
+        SubsetLookupTable() = default;
 
         SubsetLookupTable(const std::shared_ptr<DataProvider>& dataProvider,
-                          const std::shared_ptr<Targets>& targets);
-
-        /// \brief Returns the NodeData for a given bufr node.
+                          const std::shared_ptr<const SubsetLookupLayout>& layout);
+
+        /// \brief Replace the contents of the table with the counts and data of the currently
+        ///        open BUFR message subset. The storage of the table is reused.
+        /// \param[in] dataProvider The BUFR data provider.
+        /// \param[in] layout The layout for the subset variant of the current subset.
+        void load(const std::shared_ptr<DataProvider>& dataProvider,
+                  const std::shared_ptr<const SubsetLookupLayout>& layout);
+
+        /// \brief Replace the contents of the table with the counts and data of a captured
+        ///        subset. Doesn't call into NCEPLIB-bufr, so tables can be loaded from snapshots
+        ///        on several threads at once.
+        /// \param[in] snapshot The captured subset.
+        void load(const Snapshot& snapshot);
+
+        /// \brief Copy the currently open BUFR message subset into a snapshot. The storage of
+        ///        the snapshot is reused.
+        /// \param[in] dataProvider The BUFR data provider.
+        /// \param[in] layout The layout for the subset variant of the current subset.
+        /// \param[out] snapshot The snapshot.
+        static void capture(const std::shared_ptr<DataProvider>& dataProvider,
+                            const std::shared_ptr<const SubsetLookupLayout>& layout,
+                            Snapshot& snapshot);
+
+        /// \brief Get the layout the table was built with.
+        const std::shared_ptr<const SubsetLookupLayout>& layout() const { return layout_; }
+
+        /// \brief Returns the counts for a given bufr node.
+        /// \param[in] nodeId The id of the node to get the counts for.
+        /// \return The counts (empty if there are none) for the given node.
+        Counts counts(size_t nodeId) const;
+
+        /// \brief Returns the data for a given bufr node.
         /// \param[in] nodeId The id of the node to get the data for.
-        /// \return The NodeData for the given node.
-        const NodeData& operator[](size_t nodeId) const { return lookupTable_[nodeId]; }
+        /// \return The data (empty if there is none) for the given node.
+        DataView data(size_t nodeId) const;
 
         /// \brief Gets the idx for the target with the given name.
         /// \param[in] name The name of the target to get the idx for.
@@ -87,7 +174,7 @@ namespace bufr {
         size_t getTargetIdx(std::string name) const
         {
             size_t idx = 0;
-            for (const auto& target : *targets_)
+            for (const auto& target : *layout_->targets())
             {
                 if (target->name == name) { break; }
                 ++idx;
@@ -99,33 +186,37 @@ namespace bufr {
         /// \brief Gets the target at the given idx.
         /// \param[in] idx The idx of the target to get.
         /// \return The target at the given idx.
-        std::shared_ptr<Target>& targetAtIdx(size_t idx) const { return targets_->at(idx); }
+        std::shared_ptr<Target>& targetAtIdx(size_t idx) const
+        {
+            return layout_->targets()->at(idx);
+        }
 
      private:
-        const std::shared_ptr<Targets> targets_;
-        LookupTable lookupTable_;
-
-        /// \brief Creates a lookup table that maps node ids to NodeData objects.
-        /// \param[in] targets The targets to create the lookup table for.
-        /// \return The lookup table.
-        LookupTable makeLookupTable(const std::shared_ptr<DataProvider>& dataProvider,
-                                    const Targets& targets) const;
-
-        /// \brief Adds the counts data for the given targets to the lookup table.
-        /// \param[in] targets The targets to add the counts data for.
-        /// \param[in, out] lookup The lookup table to add the counts data to.
-        void addCounts(const std::shared_ptr<DataProvider>& dataProvider,
-                       const Targets& targets,
-                       LookupTable& lookup,
-                       LookupMetaTable& lookupMeta) const;
-
-        /// \brief Adds the data for the given targets to the lookup table.
-        /// \param[in] targets The targets to add the data for.
-        /// \param[in, out] lookup The lookup table to add the data to.
-        void addData(const std::shared_ptr<DataProvider>& dataProvider,
-                     const Targets& targets,
-                     LookupTable& lookup,
-                     LookupMetaTable& lookupMeta) const;
+        struct Range
+        {
+            size_t begin = 0;
+            size_t size = 0;
+        };
+
+        std::shared_ptr<const SubsetLookupLayout> layout_;
+
+        std::vector<Range> countRanges_;
+        std::vector<Range> dataRanges_;
+        std::vector<int> counts_;
+        std::vector<double> octets_;
+        std::vector<LongStrRef> strings_;
+        std::string chars_;  // The characters of the long strings
+
+        /// \brief Collect the counts and data for all the slots from the subset data section
+        ///        (one pass over the inv/val arrays) and pack them into the buffers.
+        /// \param[in] val The values of the subset.
+        /// \param[in] inv The table node ids of the values.
+        /// \param[in] readLongStrs Function that appends the long strings of the given slots
+        ///            (ids, slot indices) to a buffer and fills in their end offsets.
+        template<typename ReadLongStrs>
+        void collect(gsl::span<const double> val,
+                     gsl::span<const int> inv,
+                     ReadLongStrs&& readLongStrs);
     };
 }  // namespace bufr
 }  // namespace Ingester
@@ -24,129 +24,229 @@ namespace bufr {
 
     void SubsetTable::initialize()
     {
-        root_ = std::make_shared<BufrNode>();
-        root_->mnemonic = dataProvider_->getTag(dataProvider_->getInode());
-        root_->type = Typ::Subset;
-        root_->nodeIdx = dataProvider_->getInode();
+        const auto inode = dataProvider_->getInode();
+        nodes_.reserve(dataProvider_->getIsc(inode) - inode + 1);
+
+        BufrNode root;
+        root.mnemonicId = internMnemonic(dataProvider_->getTag(inode));
+        root.type = Typ::Subset;
+        root.nodeIdx = inode;
+        root.numDims = 1;
+        nodes_.push_back(root);
+
+        // Recursively parse the entire tree of BUFR nodes (the leaves are found along the way)
+        processNode(0);
+    }
 
-        // Recursively parse the entire tree of BUFR nodes
-        processNode(root_);
+    size_t SubsetTable::internMnemonic(const std::string& mnemonic)
+    {
+        auto it = mnemonicIds_.find(mnemonic);
+        if (it == mnemonicIds_.end())
+        {
+            it = mnemonicIds_.emplace(mnemonic, mnemonics_.size()).first;
+            mnemonics_.push_back(mnemonic);
+            mnemonicCnts_.push_back(0);
+        }
 
-        // Find all the leaves of the tree
-        leaves_ = root_->getLeaves();
+        return it->second;
     }
 
-    void SubsetTable::processNode(std::shared_ptr<BufrNode>& parent)
+    void SubsetTable::processNode(size_t parentId)
     {
-        if (!parent->isContainer())
+        if (!nodes_[parentId].isContainer())
         {
             return;
         }
 
-        auto nodeIdx = static_cast<int> (parent->nodeIdx + 1);
-        auto lastNode = static_cast<int>(dataProvider_->getLink(parent->nodeIdx) - 1);
+        auto nodeIdx = static_cast<int> (nodes_[parentId].nodeIdx + 1);
+        auto lastNode = static_cast<int>(dataProvider_->getLink(nodes_[parentId].nodeIdx) - 1);
         if (lastNode == -1) lastNode = dataProvider_->getIsc(dataProvider_->getInode());
 
-        auto mnemonicCounts = std::unordered_map<std::string, size_t>();
-        auto mnemonicMaps =
-            std::unordered_map<std::string, std::vector<std::shared_ptr<BufrNode>>>();
+        // The first node with each mnemonic (by mnemonic id) among the children and the number
+        // of children with that mnemonic.
+        auto mnemonicMaps = std::unordered_map<size_t, std::pair<size_t, size_t>>();
 
+        size_t lastChildId = BufrNode::NoNode;
         while (nodeIdx != 0 && nodeIdx <= lastNode)
         {
-            parent->children.push_back(std::make_shared<BufrNode>());
-            auto& newNode = parent->children.back();
-            newNode->nodeIdx = nodeIdx;
-            newNode->mnemonic = dataProvider_->getTag(nodeIdx);
-            newNode->type = dataProvider_->getTyp(nodeIdx);
-            newNode->parent = parent;
+            const auto& parent = nodes_[parentId];
+
+            BufrNode newNode;
+            newNode.nodeIdx = nodeIdx;
+            newNode.mnemonicId = internMnemonic(dataProvider_->getTag(nodeIdx));
+            newNode.type = dataProvider_->getTyp(nodeIdx);
+            newNode.parent = parentId;
+            newNode.dimParent = parent.isDimensioningNode() ? parentId : parent.dimParent;
+            newNode.queryPath = parent.isQueryPathParentNode();
+            newNode.numDims = parent.numDims + (newNode.isDimensioningNode() ? 1 : 0);
 
             // For hacky reasons we track the number of times we've seen a mnemonic
             // this is because NCEPLIB_bufr doeen't have a consept of unique nodes but relies
             // on mnemonics (which aren't unique) in an extremely bad way.
-            if (mnemonicCnts_.find(newNode->mnemonic) == mnemonicCnts_.end())
-            {
-                mnemonicCnts_[newNode->mnemonic] = 1;
-            }
-            else
-            {
-                mnemonicCnts_[newNode->mnemonic]++;
-            }
-            newNode->mnemonicIdx = mnemonicCnts_[newNode->mnemonic];
+            newNode.mnemonicIdx = ++mnemonicCnts_[newNode.mnemonicId];
 
-            if (newNode->type == Typ::FixedRep)
-            {
-                newNode->fixedRepCount = dataProvider_->getIrf(nodeIdx);
-            }
-            else
+            if (newNode.type == Typ::FixedRep)
             {
-                newNode->fixedRepCount = 1;
+                newNode.fixedRepCount = dataProvider_->getIrf(nodeIdx);
             }
 
+            const size_t newNodeId = nodes_.size();
+
             // add to and increment duplicate mnemonic count, update duplicate status if there are
             // duplicates
-            const auto& mnemonic = newNode->mnemonic;
-            if (mnemonicMaps.find(mnemonic) == mnemonicMaps.end())
-            {
-                mnemonicMaps[mnemonic] = std::vector<std::shared_ptr<BufrNode>>();
-            }
-
-            mnemonicMaps[mnemonic].push_back(newNode);
-            newNode->copyIdx = mnemonicMaps[mnemonic].size();
+            auto& mnemonicMap = mnemonicMaps.emplace(newNode.mnemonicId,
+                                                     std::make_pair(newNodeId, 0)).first->second;
+            newNode.copyIdx = ++mnemonicMap.second;
 
-            if (parent->isQueryPathParentNode() && parent->hasDuplicates)
+            if (parent.isQueryPathParentNode() && parent.hasDuplicates)
             {
-                newNode->copyIdx = parent->copyIdx;
+                newNode.copyIdx = parent.copyIdx;
             }
 
-            if (newNode->copyIdx > 1)
+            if (newNode.copyIdx > 1)
             {
                 // We need to fix the initial nodes to indicate that they are duplicates
-                mnemonicMaps[mnemonic][0]->hasDuplicates = true;
-                if (mnemonicMaps[mnemonic][0]->isQueryPathParentNode())
+                if (mnemonicMap.first != newNodeId)
                 {
-                    mnemonicMaps[mnemonic][0]->children[0]->hasDuplicates = true;
+                    auto& firstNode = nodes_[mnemonicMap.first];
+                    firstNode.hasDuplicates = true;
+                    if (firstNode.isQueryPathParentNode())
+                    {
+                        nodes_[firstNode.firstChild].hasDuplicates = true;
+                    }
                 }
 
-                newNode->hasDuplicates = true;
+                newNode.hasDuplicates = true;
             }
 
-            processNode(newNode);
+            if (newNode.isLeaf())
+            {
+                newNode.typeInfo = dataProvider_->getTypeInfo(newNode.nodeIdx);
+                leaves_.push_back(newNodeId);
+            }
 
-            if (newNode->isLeaf())
+            // Link the new node to its parent (nodes_ may be reallocated, so no references are
+            // kept across the push_back).
+            nodes_.push_back(newNode);
+            if (lastChildId == BufrNode::NoNode)
+            {
+                nodes_[parentId].firstChild = newNodeId;
+            }
+            else
             {
-                newNode->typeInfo = dataProvider_->getTypeInfo(newNode->nodeIdx);
+                nodes_[lastChildId].nextSibling = newNodeId;
             }
+            lastChildId = newNodeId;
+
+            processNode(newNodeId);
 
             nodeIdx = dataProvider_->getLink(nodeIdx);
         }
     }
 
-    std::shared_ptr<BufrNode>
-        SubsetTable::getNodeForPath(const std::vector<std::shared_ptr<PathComponent>>& path)
+    size_t SubsetTable::getChild(size_t parentId, size_t mnemonicId, size_t index) const
     {
-        auto node = root_;
+        size_t currentIdx = 0;
+        for (auto childId = nodes_[parentId].firstChild;
+             childId != BufrNode::NoNode;
+             childId = nodes_[childId].nextSibling)
+        {
+            const auto& child = nodes_[childId];
+            if (child.mnemonicId == mnemonicId)
+            {
+                // Check for query with invalid nodes (nodes shouldn't be in the query string).
+                if (!child.isQueryPathNode() && !child.isLeaf()) return BufrNode::NoNode;
+
+                currentIdx++;
+                if (currentIdx == index || index == 0) return childId;
+            }
+            else if (child.isQueryPathParentNode() &&
+                     nodes_[child.firstChild].mnemonicId == mnemonicId)
+            {
+                currentIdx++;
+                if (currentIdx == index || index == 0) return child.firstChild;
+            }
+            else if (child.isContainer() && !child.isQueryPathNode())
+            {
+                const auto nodeId = getChild(childId, mnemonicId, index);
+                if (nodeId != BufrNode::NoNode) return nodeId;
+            }
+        }
+
+        return BufrNode::NoNode;
+    }
+
+    size_t SubsetTable::getNodeForPath(
+        const std::vector<std::shared_ptr<PathComponent>>& path) const
+    {
+        size_t nodeId = 0;
         for (const auto& component : path)
         {
-            if (node->isContainer())
+            if (!nodes_[nodeId].isContainer()) return BufrNode::NoNode;
+
+            const auto mnemonicIt = mnemonicIds_.find(component->name);
+            if (mnemonicIt == mnemonicIds_.end()) return BufrNode::NoNode;
+
+            nodeId = getChild(nodeId, mnemonicIt->second, component->index);
+            if (nodeId == BufrNode::NoNode) return BufrNode::NoNode;
+        }
+
+        return nodeId;
+    }
+
+    void SubsetTable::getPathNodes(size_t id, std::vector<size_t>& pathNodes) const
+    {
+        // Walk up to the root, then put the nodes in root to leaf order.
+        pathNodes.clear();
+        for (auto nodeId = id; nodeId != BufrNode::NoNode; nodeId = nodes_[nodeId].parent)
+        {
+            const auto& node = nodes_[nodeId];
+            if (node.isQueryPathNode())
             {
-                auto child = node->getChild(component->name, component->index);
-                if (child)
-                {
-                    node = child;
-                }
-                else
-                {
-                    return nullptr;
-                }
+                pathNodes.push_back(node.parent);
             }
-            else
+            else if (node.isLeaf())
             {
-                return nullptr;
+                pathNodes.push_back(nodeId);
             }
         }
 
-        return node;
+        std::reverse(pathNodes.begin(), pathNodes.end());
     }
 
+    std::vector<std::string> SubsetTable::getDimPaths(size_t id) const
+    {
+        std::vector<std::string> dimPaths;
+        std::vector<size_t> chain;
+        for (auto nodeId = id; nodeId != BufrNode::NoNode; nodeId = nodes_[nodeId].parent)
+        {
+            chain.push_back(nodeId);
+        }
+
+        // The sub path of every query path node whose parent is a dimensioning node.
+        std::string subPath;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            const auto& node = nodes_[*it];
+            if (node.parent == BufrNode::NoNode)
+            {
+                subPath = "*";  // Always insert * for the subset
+                dimPaths.push_back(subPath);
+                continue;
+            }
+
+            if (node.isQueryPathNode() || node.isLeaf())
+            {
+                subPath += "/" + getMnemonic(*it);
+            }
+
+            if (nodes_[node.parent].isDimensioningNode() && node.isQueryPathNode())
+            {
+                dimPaths.push_back(subPath);
+            }
+        }
+
+        return dimPaths;
+    }
 }  // namespace bufr
 }  // namespace Ingester
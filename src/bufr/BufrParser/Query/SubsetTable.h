@@ -7,12 +7,15 @@
 
 #pragma once
 
-#include <vector>
-#include <string>
-#include <unordered_map>
-#include <set>
+#include <cstddef>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <set>
 #include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "DataProvider/DataProvider.h"
 
@@ -21,23 +24,31 @@ namespace bufr {
 
     struct PathComponent;
 
-    /// \brief A node in the bufr data tree (metadata). This is a recursive data structure.
-    struct BufrNode : public std::enable_shared_from_this<BufrNode>
+    /// \brief A node in the bufr data tree (metadata). The nodes live in a flat array owned by
+    ///        their SubsetTable and refer to each other by their position in it (ex: parent).
+    struct BufrNode
     {
-        std::weak_ptr<BufrNode> parent;
-        std::string mnemonic;
-        Typ type;
-        std::vector<std::shared_ptr<BufrNode>> children;
-        size_t nodeIdx;
-        size_t copyIdx;
-        size_t mnemonicIdx;
-        bool hasDuplicates;
+        /// \brief Position of a node that doesn't exist (ex: the parent of the root).
+        static constexpr size_t NoNode = std::numeric_limits<size_t>::max();
+
+        size_t parent = NoNode;
+        size_t dimParent = NoNode;  // The closest dimensioning ancestor
+        size_t firstChild = NoNode;
+        size_t nextSibling = NoNode;
+        size_t mnemonicId = 0;  // Position of the mnemonic in SubsetTable::getMnemonics()
+        Typ type = Typ::Subset;
+        size_t nodeIdx = 0;
+        size_t copyIdx = 1;
+        size_t mnemonicIdx = 1;
+        bool hasDuplicates = false;
+        bool queryPath = true;  // See isQueryPathNode
+        size_t numDims = 0;  // Number of dimensioning nodes from the root to this node
         TypeInfo typeInfo;
-        size_t fixedRepCount;
+        size_t fixedRepCount = 1;
 
         /// \brief Do this nodes child sequences appear as parts of the query string?
         /// \return True if this node is a parent of a query path node.
-        bool isQueryPathParentNode()
+        bool isQueryPathParentNode() const
         {
             return type == Typ::DelayedRep ||
                    type == Typ::FixedRep ||
@@ -45,22 +56,14 @@ namespace bufr {
                    type == Typ::DelayedBinary;
         }
 
-        /// \brief Does this node appear as part of the query string?
+        /// \brief Does this node appear as part of the query string? (i.e. is it the root or
+        ///        the child of a query path parent node)
         /// \return True if this node is a query path node.
-        bool isQueryPathNode()
-        {
-            bool isQueryPath = true;
-            if (!parent.expired())
-            {
-                isQueryPath = parent.lock()->isQueryPathParentNode();
-            }
-
-            return isQueryPath;
-        }
+        bool isQueryPathNode() const { return queryPath; }
 
         /// \brief Does this node add dimension to the resulting data? (i.e. is it a repeat node)
         /// \return True if this node is a dimensioning node.
-        bool isDimensioningNode()
+        bool isDimensioningNode() const
         {
             return type == Typ::DelayedRep ||
                    type == Typ::FixedRep ||
@@ -89,230 +92,11 @@ namespace bufr {
                    type == Typ::Sequence ||
                    type == Typ::Subset;
         }
-
-        /// \brief Recursively get the path to this node as a vector of strings.
-        /// \return The path to this node as a vector of strings.
-        std::vector<std::string> getPath()
-        {
-            std::vector<std::string> components;
-            return getPath(components);
-        }
-
-        /// \brief Recursively get the path to this node as a vector of strings.
-        /// \param components The path to this node as a vector of strings.
-        /// \return The path to this node as a vector of strings.
-        std::vector<std::string> getPath(std::vector<std::string>& components)
-        {
-            if (!parent.expired())
-            {
-                components = parent.lock()->getPath(components);
-            }
-
-            if (isQueryPathNode() || isLeaf())
-            {
-                components.push_back(mnemonic);
-            }
-
-            return components;
-        }
-
-        /// \brief Recursively get the path to this node as a vector of BufrNodes.
-        /// \return The path to this node as a vector of BufrNodes.
-        std::vector<std::shared_ptr<BufrNode>> getPathNodes()
-        {
-            std::vector<std::shared_ptr<BufrNode>> components;
-            return getPathNodes(components);
-        }
-
-        /// \brief Recursively get the path to this node as a vector of BufrNodes.
-        /// \param components The path to this node as a vector of BufrNodes.
-        /// \return The path to this node as a vector of BufrNodes.
-        std::vector<std::shared_ptr<BufrNode>>
-            getPathNodes(std::vector<std::shared_ptr<BufrNode>>& components)
-        {
-            if (!parent.expired())
-            {
-                components = parent.lock()->getPathNodes(components);
-            }
-
-            if (isQueryPathNode())
-            {
-                components.push_back(parent.lock());
-            }
-            else if (isLeaf())
-            {
-                components.push_back(shared_from_this());
-            }
-
-            return components;
-        }
-
-        /// \brief Get the sub paths of this node that map to a dimension.
-        /// \return The sub paths of this node that map to a dimension.
-        std::vector<std::string> getDimPaths()
-        {
-            std::vector<std::string> components;
-            getDimPaths(components);
-            return components;
-        }
-
-        /// \brief Recursively get the sub paths of this node that map to a dimension.
-        /// \param components The sub paths of this node that map to a dimension.
-        void getDimPaths(std::vector<std::string>& components)
-        {
-            if (!parent.expired())
-            {
-                parent.lock()->getDimPaths(components);
-            }
-
-            if (parent.expired())
-            {
-                components.push_back("*");
-            }
-            else if (parent.lock()->isDimensioningNode() && isQueryPathNode())
-            {
-                std::ostringstream pathSubStr;
-                auto subPath = getPath();
-                for (auto it = subPath.begin(); it != subPath.end(); ++it)
-                {
-                    if (it == subPath.begin())
-                    {
-                        pathSubStr << "*";  // Always insert * for the subset
-                    }
-                    else
-                    {
-                        pathSubStr << "/" << *it;
-                    }
-                }
-
-                components.push_back(pathSubStr.str());
-            }
-        }
-
-        /// \brief Get the nodes that are the leaves of the tree.
-        /// \return The nodes that are the leaves of the tree.
-        std::vector<std::shared_ptr<BufrNode>> getLeaves()
-        {
-            std::vector<std::shared_ptr<BufrNode>> leaves;
-            getLeaves(leaves);
-            return leaves;
-        }
-
-        /// \brief Recursively get the nodes that are the leaves of the tree.
-        /// \param leaves The nodes that are the leaves of the tree.
-        void getLeaves(std::vector<std::shared_ptr<BufrNode>>& leaves)
-        {
-            if (isLeaf())
-            {
-                leaves.push_back(shared_from_this());
-            }
-            else
-            {
-                for (auto& child : children)
-                {
-                    child->getLeaves(leaves);
-                }
-            }
-        }
-
-        /// \brief Get the indices of the nodes that add dimensions to the data.
-        /// \return The indices of the nodes that add dimensions to the data.
-        std::vector<int> getDimIdxs()
-        {
-            std::vector<int> idxs;
-            int depth = 0;
-            return getDimIdxs(idxs, depth);
-        }
-
-        /// \brief Recursively get the indices of the nodes that add dimensions to the data.
-        /// \param idxs The indices of the nodes that add dimensions to the data.
-        /// \param depth The depth of this node in the tree.
-        std::vector<int> getDimIdxs(std::vector<int>& idxs, int& depth)
-        {
-            if (!parent.expired())
-            {
-                idxs = parent.lock()->getDimIdxs(idxs, depth);
-            }
-
-            if (isDimensioningNode())
-            {
-                idxs.push_back(depth);
-            }
-
-            if (isQueryPathNode())
-            {
-                depth++;
-            }
-
-            return idxs;
-        }
-
-        /// \brief Get the children of this node.
-        /// \return The children of this node.
-        std::shared_ptr<BufrNode> getChild(const std::string& mnemonic, size_t index)
-        {
-            size_t currentIdx = 0;
-            for (const auto& child : children)
-            {
-                if (child->mnemonic == mnemonic)
-                {
-                    // Check for query with invalid nodes (nodes shouldn't be in the query string).
-                    if (!child->isQueryPathNode() && !child->isLeaf()) return nullptr;
-
-                    currentIdx++;
-                    if (currentIdx == index || index == 0) return child;
-                }
-                else if (child->isQueryPathParentNode() && child->children[0]->mnemonic == mnemonic)
-                {
-                    currentIdx++;
-                    if (currentIdx == index || index == 0) return child->children[0];
-                }
-                else if (child->isContainer() && !child->isQueryPathNode())
-                {
-                    auto node = child->getChild(mnemonic, index);
-                    if (node != nullptr) return node;
-                }
-            }
-
-            return nullptr;
-        }
-
-        /// \brief Get the dimensioning parent of this node.
-        /// \return The dimensioning parent of this node.
-        std::shared_ptr<BufrNode> getParent()
-        {
-            if (!parent.expired())
-            {
-                return parent.lock();
-            }
-
-            return nullptr;
-        }
-
-        /// \brief Get the dimensioning parent of this node.
-        /// \return The dimensioning parent of this node.
-        std::shared_ptr<BufrNode> getDimensionParent()
-        {
-            if (!parent.expired())
-            {
-                if (parent.lock()->isDimensioningNode())
-                {
-                    return parent.lock();
-                }
-                else
-                {
-                    return parent.lock()->getDimensionParent();
-                }
-            }
-
-            return nullptr;
-        }
     };
 
-    typedef std::vector<std::shared_ptr<Ingester::bufr::BufrNode>> BufrNodeVector;
-
-
-    /// \brief Parses the BUFR message subset Meta data tables.
+    /// \brief Parses the BUFR message subset Meta data tables. The nodes are stored in a
+    ///        contiguous array (the root first, then depth first), their mnemonics are interned
+    ///        and their parents precomputed so looking up paths doesn't allocate.
     class SubsetTable
     {
      public:
@@ -320,34 +104,70 @@ namespace bufr {
         explicit SubsetTable(const DataProviderType& dataProvider);
         ~SubsetTable() = default;
 
-        /// \brief Returns all the leaf data elements in the subset table.
-        /// \returns A vector of BufrNode objects.
-        const BufrNodeVector& getLeaves() const { return leaves_; }
+        /// \brief Returns all the nodes of the table (the root is the first one).
+        const std::vector<BufrNode>& getNodes() const { return nodes_; }
+
+        /// \brief Returns the node at the given position in the table.
+        const BufrNode& getNode(size_t id) const { return nodes_[id]; }
+
+        /// \brief Returns the root (subset) node.
+        const BufrNode& getRoot() const { return nodes_.front(); }
 
-        const std::shared_ptr<BufrNode> getRoot() const { return root_; }
+        /// \brief Returns the positions of all the leaf data elements in the subset table.
+        const std::vector<size_t>& getLeaves() const { return leaves_; }
+
+        /// \brief Returns the distinct mnemonics of the table (see BufrNode::mnemonicId).
+        const std::vector<std::string>& getMnemonics() const { return mnemonics_; }
+
+        /// \brief Returns the mnemonic of a node.
+        const std::string& getMnemonic(size_t id) const
+        {
+            return mnemonics_[nodes_[id].mnemonicId];
+        }
 
         /// \brief Gets the node for the path that is passed in.
         /// \param path The path to the node.
-        /// \returns A shared pointer to the node.
-        std::shared_ptr<BufrNode>
-            getNodeForPath(const std::vector<std::shared_ptr<PathComponent>>& path);
+        /// \returns The position of the node, BufrNode::NoNode if there is none.
+        size_t getNodeForPath(const std::vector<std::shared_ptr<PathComponent>>& path) const;
+
+        /// \brief Gets the nodes that make up the query path of a node: for each node from the
+        ///        root to this one, the parent of the query path nodes (BufrNode::NoNode for the
+        ///        root) and the leaf itself.
+        /// \param id The position of the node.
+        /// \param[out] pathNodes The positions of the path nodes (cleared first).
+        void getPathNodes(size_t id, std::vector<size_t>& pathNodes) const;
+
+        /// \brief Gets the sub paths of a node that map to a dimension (ex: "*/BRITCSTC").
+        /// \param id The position of the node.
+        /// \return The sub paths.
+        std::vector<std::string> getDimPaths(size_t id) const;
 
      private:
         const DataProviderType dataProvider_;
-        std::shared_ptr<BufrNode> root_;
-        BufrNodeVector leaves_;
-        std::unordered_map<size_t, std::shared_ptr<BufrNode>> nodeIdxMap_;
-        std::unordered_map<std::string, size_t> mnemonicCnts_;
+        std::vector<BufrNode> nodes_;
+        std::vector<size_t> leaves_;
+        std::vector<std::string> mnemonics_;
+        std::unordered_map<std::string, size_t> mnemonicIds_;
+        std::vector<size_t> mnemonicCnts_;
 
         /// \brief Initializes the subset table.
         void initialize();
 
-        /// \brief Parses the BUFR message subset Meta data tables in a recursive ve fashion.
-        /// \param[in] parent The current parent node in the tree.
-        void processNode(std::shared_ptr<BufrNode>& parent);
+        /// \brief Parses the BUFR message subset Meta data tables in a recursive fashion.
+        /// \param[in] parentId The position of the current parent node in the table.
+        void processNode(size_t parentId);
+
+        /// \brief Returns the id of a mnemonic, adding it to the table if it is new.
+        size_t internMnemonic(const std::string& mnemonic);
+
+        /// \brief Finds the child of a node for a path component.
+        /// \param parentId The position of the node.
+        /// \param mnemonicId The id of the mnemonic of the component.
+        /// \param index The index of the component (0 if any).
+        /// \return The position of the child, BufrNode::NoNode if there is none.
+        size_t getChild(size_t parentId, size_t mnemonicId, size_t index) const;
     };
 
     typedef std::shared_ptr<SubsetTable> SubsetTableType;
 }  // namespace bufr
 }  // namespace Ingester
-
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -75,16 +76,6 @@ namespace bufr {
 
     typedef std::vector<TargetComponent> TargetComponents;
 
-    /// \brief For performance reasons we want to maintain a list of the indices of filtered
-    ///        data.
-    struct FilterData
-    {
-        const std::vector<size_t>& filter;
-        bool isEmpty;
-    };
-
-    typedef std::vector<FilterData> FilterDataList;
-
     /// \brief The information or Meta data for a BUFR field whose data we wish to capture when
     /// we execute a query.
     struct Target
@@ -101,13 +92,30 @@ namespace bufr {
         std::vector<Query> dimPaths;
         std::vector<int> exportDimIdxs;
         std::vector<int> seqPath;
-        FilterDataList filterDataList;
+
+        /// \brief For each component of the path, which (1 based) repeats its filter keeps
+        ///        (empty for the components without a filter). The filter values are matched in
+        ///        order, so only the increasing part of a filter list is used.
+        std::vector<std::vector<char>> filterMasks;
 
         bool hasDelayedRepeats = false;
         bool usesFilters = false;
 
+        /// \brief Position of the first target with the same query string (see
+        ///        QuerySet::sharedHandle). The ResultSet only collects the data of that target.
+        size_t sharedIdx = 0;
+
         Target() = default;
 
+        /// \brief Does the filter of a path component keep a repeat.
+        /// \param componentIdx The index of the component in the path.
+        /// \param repeat The (1 based) repeat.
+        bool keepsRepeat(size_t componentIdx, size_t repeat) const
+        {
+            const auto& mask = filterMasks[componentIdx];
+            return mask.empty() || (repeat < mask.size() && mask[repeat]);
+        }
+
         /// \brief Sets metadata for a target given the TargetComponents in the path to the target.
         ///        It not only sets the path but also sets the dimensioning paths, the sequence
         ///        paths and the idxs for the exported components (the ones that add dimensions).
@@ -117,7 +125,7 @@ namespace bufr {
             exportDimIdxs = {};
             seqPath.reserve(components.size());
             exportDimIdxs.reserve(components.size());
-            filterDataList.reserve(components.size());
+            filterMasks.assign(components.size(), std::vector<char>());
 
             std::string currentPath;
             std::vector<std::shared_ptr<QueryComponent>> queryComponents;
@@ -126,10 +134,22 @@ namespace bufr {
             {
                 queryComponents.push_back(component.queryComponent);
 
-                if (component.type == TargetComponent::Type::Repeat &&
-                    !component.queryComponent->filter.empty())
+                const auto& filter = component.queryComponent->filter;
+                if (component.type == TargetComponent::Type::Repeat && !filter.empty())
                 {
                     usesFilters = true;
+
+                    auto& mask = filterMasks[componentIdx];
+                    mask.assign(*std::max_element(filter.begin(), filter.end()) + 1, false);
+                    size_t filterIdx = 0;
+                    for (size_t repeat = 1; repeat < mask.size(); ++repeat)
+                    {
+                        if (filterIdx < filter.size() && filter[filterIdx] == repeat)
+                        {
+                            mask[repeat] = true;
+                            filterIdx++;
+                        }
+                    }
                 }
 
                 if (component.addsDimension())
@@ -158,9 +178,6 @@ namespace bufr {
                     seqPath.push_back(component.nodeId);
                 }
 
-                filterDataList.push_back({component.queryComponent->filter,
-                                          component.queryComponent->filter.empty()});
-
                 componentIdx++;
             }
 
@@ -0,0 +1,319 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "TargetCache.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+
+namespace
+{
+    const char* PlanMagic = "BUFRPLAN";
+    const int PlanVersion = 1;
+    const int EmptyTarget = -1;
+
+    /// \brief 64 bit FNV-1a hash (stable across runs and platforms unlike std::hash).
+    class Hasher
+    {
+     public:
+        void add(const std::string& str)
+        {
+            for (auto c : str) addByte(static_cast<unsigned char>(c));
+            addByte(0);  // Separator so "ab" + "c" and "a" + "bc" differ
+        }
+
+        void add(std::int64_t value)
+        {
+            for (int byteIdx = 0; byteIdx < 8; byteIdx++)
+            {
+                addByte(static_cast<unsigned char>((value >> (byteIdx * 8)) & 0xff));
+            }
+        }
+
+        std::uint64_t value() const { return hash_; }
+
+     private:
+        std::uint64_t hash_ = 14695981039346656037ULL;
+
+        void addByte(unsigned char byte)
+        {
+            hash_ ^= byte;
+            hash_ *= 1099511628211ULL;
+        }
+    };
+
+    bool sameTypeInfo(const Ingester::bufr::TypeInfo& lhs, const Ingester::bufr::TypeInfo& rhs)
+    {
+        return lhs.scale == rhs.scale &&
+               lhs.reference == rhs.reference &&
+               lhs.bits == rhs.bits &&
+               lhs.unit == rhs.unit &&
+               lhs.description == rhs.description;
+    }
+
+    /// \brief The index of the query (in QuerySet::queriesFor) that the target was made from.
+    int queryIdxFor(const Ingester::bufr::Target& target,
+                    const std::vector<Ingester::bufr::Query>& queries)
+    {
+        if (target.nodeIdx == 0) return EmptyTarget;
+
+        for (size_t queryIdx = 0; queryIdx < queries.size(); queryIdx++)
+        {
+            if (queries[queryIdx].str() == target.queryStr) return static_cast<int>(queryIdx);
+        }
+
+        return EmptyTarget;
+    }
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+
+    TargetCache::TargetCache(const std::string& cacheDir) :
+        cacheDir_(cacheDir)
+    {
+    }
+
+    std::uint64_t TargetCache::keyFor(const DataProviderType& dataProvider,
+                                      const QuerySet& querySet)
+    {
+        Hasher hasher;
+        hasher.add(dataProvider->getSubsetVariant().str());
+
+        // The nodes of the subset's table (everything the SubsetTable is built from)
+        const auto inode = dataProvider->getInode();
+        for (auto nodeIdx = inode; nodeIdx <= dataProvider->getIsc(inode); nodeIdx++)
+        {
+            hasher.add(dataProvider->getTag(nodeIdx));
+            hasher.add(static_cast<std::int64_t>(dataProvider->getTyp(nodeIdx)));
+            hasher.add(static_cast<std::int64_t>(dataProvider->getLink(nodeIdx)));
+            hasher.add(static_cast<std::int64_t>(dataProvider->getJmpb(nodeIdx)));
+            hasher.add(static_cast<std::int64_t>(dataProvider->getIrf(nodeIdx)));
+            hasher.add(static_cast<std::int64_t>(dataProvider->getItp(nodeIdx)));
+        }
+
+        // Sort the names so the key doesn't depend on the order the queries were added in
+        auto names = querySet.names();
+        std::sort(names.begin(), names.end());
+        for (const auto& name : names)
+        {
+            hasher.add(name);
+            for (const auto& query : querySet.queriesFor(name))
+            {
+                hasher.add(query.str());
+            }
+        }
+
+        return hasher.value();
+    }
+
+    std::shared_ptr<Targets> TargetCache::load(const DataProviderType& dataProvider,
+                                                const QuerySet& querySet) const
+    {
+        std::ifstream file(pathFor(keyFor(dataProvider, querySet)));
+        if (!file) return nullptr;
+
+        std::string magic;
+        int version = 0;
+        size_t numTargets = 0;
+        file >> magic >> version >> numTargets;
+        if (!file || magic != PlanMagic || version != PlanVersion) return nullptr;
+
+        const auto names = querySet.names();
+        std::unordered_map<std::string, TargetPtr> targetMap;
+        for (size_t targetIdx = 0; targetIdx < numTargets; targetIdx++)
+        {
+            auto target = std::make_shared<Target>();
+
+            int queryIdx = EmptyTarget;
+            size_t numComponents = 0;
+            file >> std::quoted(target->name) >> queryIdx >> target->nodeIdx
+                 >> std::quoted(target->longStrId)
+                 >> target->typeInfo.scale >> target->typeInfo.reference
+                 >> target->typeInfo.bits >> std::quoted(target->typeInfo.unit)
+                 >> std::quoted(target->typeInfo.description) >> numComponents;
+
+            TargetComponents path(numComponents);
+            for (auto& component : path)
+            {
+                int type = 0;
+                file >> type >> component.nodeId >> component.parentNodeId
+                     >> component.parentDimensionNodeId >> component.fixedRepeatCount;
+                component.type = static_cast<TargetComponent::Type>(type);
+            }
+
+            if (!file) return nullptr;
+
+            // Plans for other query sets can't end up here unless there was a hash collision,
+            // but check the plan still lines up with the queries.
+            if (std::find(names.begin(), names.end(), target->name) == names.end())
+            {
+                return nullptr;
+            }
+
+            const auto queries = querySet.queriesFor(target->name);
+            if (queryIdx == EmptyTarget)
+            {
+                target->nodeIdx = 0;
+                target->queryStr = queries[0].str();
+                target->dimPaths.push_back({Query()});
+                target->typeInfo = TypeInfo();
+                target->exportDimIdxs = {0};
+            }
+            else
+            {
+                if (queryIdx >= static_cast<int>(queries.size())) return nullptr;
+
+                const auto& query = queries[queryIdx];
+                if (path.size() != query.path.size() + 1) return nullptr;
+
+                // The table B entries can change without the structure of the table changing
+                // (ex: a new master table version), so never reuse stale type information.
+                if (!sameTypeInfo(target->typeInfo, dataProvider->getTypeInfo(target->nodeIdx)))
+                {
+                    return nullptr;
+                }
+
+                path[0].queryComponent = query.subset;
+                for (size_t pathIdx = 1; pathIdx < path.size(); pathIdx++)
+                {
+                    path[pathIdx].queryComponent = query.path[pathIdx - 1];
+                }
+
+                target->queryStr = query.str();
+                target->setPath(path);
+            }
+
+            targetMap[target->name] = target;
+        }
+
+        // Return the targets in the same order QueryRunner would have made them in.
+        auto targets = std::make_shared<Targets>();
+        targets->reserve(targetMap.size());
+        for (const auto& name : names)
+        {
+            auto targetIt = targetMap.find(name);
+            if (targetIt == targetMap.end()) return nullptr;
+
+            targets->push_back(targetIt->second);
+        }
+
+        return targets;
+    }
+
+    void TargetCache::store(const DataProviderType& dataProvider,
+                            const QuerySet& querySet,
+                            const Targets& targets) const
+    {
+        const auto path = pathFor(keyFor(dataProvider, querySet));
+
+        // Several processes (or threads) can compile the same plan at the same time, so write
+        // to a private file and move it into place.
+        std::ostringstream tmpPath;
+        tmpPath << path << "." << getpid() << "."
+                << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+        {
+            std::ofstream file(tmpPath.str());
+            if (!file) return;
+
+            file << PlanMagic << " " << PlanVersion << "\n";
+            file << targets.size() << "\n";
+
+            for (const auto& target : targets)
+            {
+                file << std::quoted(target->name) << " "
+                     << queryIdxFor(*target, querySet.queriesFor(target->name)) << " "
+                     << target->nodeIdx << " "
+                     << std::quoted(target->longStrId) << " "
+                     << target->typeInfo.scale << " "
+                     << target->typeInfo.reference << " "
+                     << target->typeInfo.bits << " "
+                     << std::quoted(target->typeInfo.unit) << " "
+                     << std::quoted(target->typeInfo.description) << " "
+                     << target->path.size() << "\n";
+
+                for (const auto& component : target->path)
+                {
+                    file << static_cast<int>(component.type) << " "
+                         << component.nodeId << " "
+                         << component.parentNodeId << " "
+                         << component.parentDimensionNodeId << " "
+                         << component.fixedRepeatCount << "\n";
+                }
+            }
+
+            if (!file)
+            {
+                file.close();
+                std::remove(tmpPath.str().c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tmpPath.str().c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmpPath.str().c_str());
+        }
+    }
+
+    std::string TargetCache::pathFor(std::uint64_t key) const
+    {
+        std::ostringstream path;
+        path << cacheDir_ << "/" << std::hex << std::setw(16) << std::setfill('0') << key
+             << ".plan";
+        return path.str();
+    }
+
+    std::shared_ptr<Targets> SharedTargetCache::find(const DataProviderType& dataProvider,
+                                                     const QuerySet& querySet) const
+    {
+        const auto key = TargetCache::keyFor(dataProvider, querySet);
+
+        std::shared_ptr<Targets> targets;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto targetsIt = targets_.find(key);
+            if (targetsIt == targets_.end()) return nullptr;
+
+            targets = targetsIt->second;
+        }
+
+        // Files can have the same table structure with different table B entries.
+        for (const auto& target : *targets)
+        {
+            if (target->nodeIdx != 0 &&
+                !sameTypeInfo(target->typeInfo, dataProvider->getTypeInfo(target->nodeIdx)))
+            {
+                return nullptr;
+            }
+        }
+
+        return targets;
+    }
+
+    void SharedTargetCache::insert(const DataProviderType& dataProvider,
+                                   const QuerySet& querySet,
+                                   const std::shared_ptr<Targets>& targets)
+    {
+        const auto key = TargetCache::keyFor(dataProvider, querySet);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        targets_[key] = targets;
+    }
+}  // namespace bufr
+}  // namespace Ingester
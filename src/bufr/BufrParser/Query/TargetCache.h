@@ -0,0 +1,92 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+
+#include "DataProvider/DataProvider.h"
+#include "QuerySet.h"
+#include "Target.h"
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief On disk cache of the Targets (the compiled query plan) for subset variants. Each
+    ///        plan is stored in its own file in the cache directory, named after a hash of the
+    ///        variant's table data and of the query set, so repeated runs over the same product
+    ///        don't have to build a SubsetTable to resolve the queries.
+    class TargetCache
+    {
+     public:
+        /// \brief Constructor.
+        /// \param cacheDir The (existing) directory to store the plans in.
+        explicit TargetCache(const std::string& cacheDir);
+
+        /// \brief Get the cached targets for the currently active subset variant.
+        /// \param dataProvider The BUFR data provider (positioned on a subset).
+        /// \param querySet The queries to resolve.
+        /// \return The targets or an empty pointer if there is no (valid) cached plan.
+        std::shared_ptr<Targets> load(const DataProviderType& dataProvider,
+                                      const QuerySet& querySet) const;
+
+        /// \brief Store the targets for the currently active subset variant. Failing to write
+        ///        the plan isn't an error, it will just be compiled again next time.
+        /// \param dataProvider The BUFR data provider (positioned on a subset).
+        /// \param querySet The queries the targets were resolved for.
+        /// \param targets The targets.
+        void store(const DataProviderType& dataProvider,
+                   const QuerySet& querySet,
+                   const Targets& targets) const;
+
+        /// \brief Hash of the table data of the active subset variant and of the query set.
+        /// \param dataProvider The BUFR data provider (positioned on a subset).
+        /// \param querySet The queries.
+        static std::uint64_t keyFor(const DataProviderType& dataProvider,
+                                    const QuerySet& querySet);
+
+     private:
+        const std::string cacheDir_;
+
+        /// \brief Path of the file holding the plan with the given key.
+        std::string pathFor(std::uint64_t key) const;
+    };
+
+    /// \brief In memory cache of Targets shared by several QueryRunners (ex: the ones for the
+    ///        files of a FileSet). The targets are keyed the same way as in the TargetCache, so
+    ///        they are only shared between subset variants with the same table structure.
+    class SharedTargetCache
+    {
+     public:
+        SharedTargetCache() = default;
+
+        /// \brief Get the targets for the currently active subset variant.
+        /// \param dataProvider The BUFR data provider (positioned on a subset).
+        /// \param querySet The queries to resolve.
+        /// \return The targets or an empty pointer if no runner has compiled them yet.
+        std::shared_ptr<Targets> find(const DataProviderType& dataProvider,
+                                      const QuerySet& querySet) const;
+
+        /// \brief Store the targets compiled for the currently active subset variant.
+        /// \param dataProvider The BUFR data provider (positioned on a subset).
+        /// \param querySet The queries the targets were resolved for.
+        /// \param targets The targets.
+        void insert(const DataProviderType& dataProvider,
+                    const QuerySet& querySet,
+                    const std::shared_ptr<Targets>& targets);
+
+     private:
+        mutable std::mutex mutex_;
+        std::unordered_map<std::uint64_t, std::shared_ptr<Targets>> targets_;
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "EpochTime.h"
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Time window (seconds since the epoch, UTC) used to skip the BUFR messages and
+    ///        subsets that fall outside of it.
+    struct TimeWindow
+    {
+        /// \brief Length of the time span covered by one message date (YYYYMMDDHH).
+        static const std::int64_t MessageSpan = 3600;
+
+        std::int64_t start = 0;
+        std::int64_t end = 0;
+
+        /// \brief Extra time allowed around a message's date (obs in a message don't always
+        ///        fall in the hour the message is dated with).
+        std::int64_t margin = 3600;
+
+        bool contains(std::int64_t time) const { return time >= start && time <= end; }
+
+        /// \brief True if all the obs in a message with the given date can be outside the window.
+        bool excludesMessage(int msgDate) const
+        {
+            const auto msgTime = messageTime(msgDate);
+            return msgTime + MessageSpan + margin < start || msgTime - margin > end;
+        }
+
+        /// \brief True if all the obs in a message with the given date must be in the window.
+        bool includesMessage(int msgDate) const
+        {
+            const auto msgTime = messageTime(msgDate);
+            return msgTime - margin >= start && msgTime + MessageSpan + margin <= end;
+        }
+
+        /// \brief Convert a date (and time) to seconds since the epoch.
+        static std::int64_t toEpoch(int year, int month, int day, int hour,
+                                    int minute = 0, int second = 0)
+        {
+            return secondsSinceEpoch(year, month, day, hour, minute, second);
+        }
+
+        /// \brief Convert a message date as returned by ireadmg_f to seconds since the epoch.
+        ///        Handles both the YYYYMMDDHH and the (default) YYMMDDHH forms.
+        static std::int64_t messageTime(int msgDate)
+        {
+            int year = msgDate / 1000000;
+            if (year < 100)
+            {
+                // Same century cutoff NCEPLIB-bufr uses (i4dy)
+                year += (year > 40) ? 1900 : 2000;
+            }
+
+            return toEpoch(year,
+                           (msgDate / 10000) % 100,
+                           (msgDate / 100) % 100,
+                           msgDate % 100);
+        }
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,151 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "Constants.h"
+#include "Data.h"
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief Which values of a field are there (1) and which are missing (0), packed 8 to a
+    ///        byte with the first value in the lowest bit (the layout of an Arrow validity
+    ///        buffer, so it is exported as it is). It is made once when the field is assembled
+    ///        (see ResultSet), after which finding the missing values doesn't compare every
+    ///        value with the missing value of its type.
+    class Validity
+    {
+     public:
+        Validity() = default;
+
+        /// \brief The validity of size values that are all missing.
+        explicit Validity(size_t size) :
+            size_(size),
+            numMissing_(size),
+            bits_((size + 7) / 8, 0)
+        {
+        }
+
+        /// \brief Make the validity of size values.
+        /// \param isValid True if the value at an index is there.
+        template<typename IsValid>
+        static Validity make(size_t size, IsValid isValid)
+        {
+            Validity validity(size);
+            validity.numMissing_ = 0;
+            for (size_t byteIdx = 0; byteIdx < validity.bits_.size(); ++byteIdx)
+            {
+                const size_t begin = byteIdx * 8;
+                const size_t end = std::min(begin + 8, size);
+
+                uint8_t byte = 0;
+                for (size_t idx = begin; idx < end; ++idx)
+                {
+                    byte |= static_cast<uint8_t>((isValid(idx) ? 1u : 0u) << (idx - begin));
+                }
+
+                validity.bits_[byteIdx] = byte;
+                validity.numMissing_ += (end - begin) - countBits(byte);
+            }
+
+            return validity;
+        }
+
+        /// \brief Make the validity of the values of assembled data (one pass over them).
+        static Validity of(const Data& data)
+        {
+            switch (data.storage())
+            {
+                case Data::Storage::Strings:
+                {
+                    const auto& values = data.values<std::string>();
+                    return make(values.size(), [&values](size_t idx)
+                    {
+                        return values[idx] != MissingStringValue;
+                    });
+                }
+                case Data::Storage::Floats:
+                {
+                    const auto& values = data.values<float>();
+                    return make(values.size(), [&values](size_t idx)
+                    {
+                        return values[idx] != Data::missingValue<float>();
+                    });
+                }
+                case Data::Storage::Ints:
+                {
+                    const auto& values = data.values<int32_t>();
+                    return make(values.size(), [&values](size_t idx)
+                    {
+                        return values[idx] != Data::missingValue<int32_t>();
+                    });
+                }
+                default:
+                {
+                    const auto& values = data.values<double>();
+                    return make(values.size(), [&values](size_t idx)
+                    {
+                        return !Data::isMissingOctet(values[idx]);
+                    });
+                }
+            }
+        }
+
+        /// \brief The number of values.
+        size_t size() const { return size_; }
+
+        /// \brief The number of missing values.
+        size_t numMissing() const { return numMissing_; }
+
+        /// \brief Is the value at the index there (not missing).
+        bool isValid(size_t idx) const { return (bits_[idx >> 3] >> (idx & 7)) & 1u; }
+
+        /// \brief The packed bits.
+        const std::vector<uint8_t>& bits() const { return bits_; }
+
+        /// \brief Keep only the values that are also there in another validity of the same
+        ///        number of values (ex: the fields of a datetime are all there or it's missing).
+        void intersect(const Validity& other)
+        {
+            if (other.size_ != size_)
+            {
+                std::ostringstream errStr;
+                errStr << "Can't combine the validity of " << other.size_ << " values with the ";
+                errStr << "one of " << size_ << " values.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            numMissing_ = size_;
+            for (size_t byteIdx = 0; byteIdx < bits_.size(); ++byteIdx)
+            {
+                bits_[byteIdx] &= other.bits_[byteIdx];
+                numMissing_ -= countBits(bits_[byteIdx]);
+            }
+        }
+
+     private:
+        size_t size_ = 0;
+        size_t numMissing_ = 0;
+        std::vector<uint8_t> bits_;
+
+        static size_t countBits(uint8_t byte) { return std::bitset<8>(byte).count(); }
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,61 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+namespace Ingester {
+namespace bufr {
+
+    /// \brief The values of a query the exports can keep (ex: the categories of a split with a
+    ///        map, the bounds of a filter). Subsets where no value of the query is allowed are
+    ///        dropped as they are read, since none of their rows would be exported.
+    struct ValueConstraint
+    {
+        /// \brief The name of the query.
+        std::string name;
+
+        /// \brief The allowed (integer) values, sorted. Any value is allowed if empty.
+        std::vector<int> categories;
+
+        /// \brief The allowed range (compared in single precision, like the filters).
+        float lower = std::numeric_limits<float>::lowest();
+        float upper = std::numeric_limits<float>::max();
+
+        /// \brief True if missing values are allowed.
+        bool allowsMissing = false;
+
+        /// \brief Is a (non missing) value allowed?
+        bool allows(double value) const
+        {
+            if (!categories.empty())
+            {
+                if (!(value >= std::numeric_limits<int>::lowest() &&
+                      value <= std::numeric_limits<int>::max()))
+                {
+                    return false;
+                }
+
+                if (!std::binary_search(categories.begin(),
+                                        categories.end(),
+                                        static_cast<int>(value)))
+                {
+                    return false;
+                }
+            }
+
+            const auto narrowValue = static_cast<float>(value);
+            return narrowValue >= lower && narrowValue <= upper;
+        }
+    };
+}  // namespace bufr
+}  // namespace Ingester
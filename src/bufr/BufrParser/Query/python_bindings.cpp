@@ -6,12 +6,32 @@
  */
 
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
 #include <vector>
 #include <string>
 
+#include "ArrowExport.h"
+#include "BufferPool.h"
 #include "QuerySet.h"
 #include "File.h"
+#include "FileSet.h"
+#include "Parallel.h"
+#include "Profiler.h"
 #include "ResultSet.h"
+#include "SharedMemory.h"
+
+#ifdef BUFR_HAS_PIPELINE
+    #include "eckit/config/YAMLConfiguration.h"
+    #include "eckit/filesystem/PathName.h"
+
+    #include "../BufrParser.h"
+    #include "../../DataContainer.h"
+#endif
 
 
 namespace py = pybind11;
@@ -19,25 +39,437 @@ namespace py = pybind11;
 using Ingester::bufr::ResultSet;
 using Ingester::bufr::QuerySet;
 using Ingester::bufr::File;
+using Ingester::bufr::FileSet;
+using Ingester::bufr::MessageBuffer;
+using Ingester::bufr::Profiler;
+using Ingester::bufr::SharedMemory;
+
+namespace
+{
+    /// \brief Python iterator that walks through a File a chunk of messages at a time.
+    class ChunkIterator
+    {
+     public:
+        ChunkIterator(File& file,
+                      const QuerySet& querySet,
+                      size_t msgsPerChunk,
+                      size_t threads) :
+            file_(file),
+            querySet_(querySet),
+            msgsPerChunk_(msgsPerChunk),
+            threads_(threads)
+        {
+        }
+
+        ResultSet next()
+        {
+            auto resultSet = ResultSet();
+            {
+                py::gil_scoped_release release;
+                while (file_.executeChunk(querySet_, msgsPerChunk_, resultSet, threads_))
+                {
+                    if (!resultSet.empty()) return resultSet;
+                }
+            }
+
+            throw py::stop_iteration();
+        }
+
+     private:
+        File& file_;
+        const QuerySet querySet_;
+        const size_t msgsPerChunk_;
+        const size_t threads_;
+    };
+
+    /// \brief Python object that exports a column through the Arrow PyCapsule interface
+    ///        (__arrow_c_array__), so pyarrow, polars etc. can import it without copying.
+    class ArrowColumns
+    {
+     public:
+        explicit ArrowColumns(Ingester::arrow::Column column) :
+            column_(std::move(column))
+        {
+        }
+
+        py::tuple capsules(const py::object& requestedSchema) const
+        {
+            if (!requestedSchema.is_none())
+            {
+                throw py::not_implemented_error("Casting to a requested schema is not supported.");
+            }
+
+            auto schema = new ArrowSchema();
+            auto array = new ArrowArray();
+            Ingester::arrow::exportColumn(Ingester::arrow::Column(column_), schema, array);
+
+            return py::make_tuple(py::capsule(schema, "arrow_schema", &releaseSchema),
+                                  py::capsule(array, "arrow_array", &releaseArray));
+        }
+
+     private:
+        const Ingester::arrow::Column column_;
+
+        // Capsule destructors. The consumer marks the structures it took over as released.
+        static void releaseSchema(PyObject* capsule)
+        {
+            auto schema = static_cast<ArrowSchema*>(PyCapsule_GetPointer(capsule, "arrow_schema"));
+            if (schema->release != nullptr) schema->release(schema);
+            delete schema;
+        }
+
+        static void releaseArray(PyObject* capsule)
+        {
+            auto array = static_cast<ArrowArray*>(PyCapsule_GetPointer(capsule, "arrow_array"));
+            if (array->release != nullptr) array->release(array);
+            delete array;
+        }
+    };
+
+    /// \brief Convert the fields argument of get_many and get_arrow (field names or
+    ///        (name, group_by, type) tuples) to field requests.
+    std::vector<ResultSet::FieldRequest> toFieldRequests(const py::list& fields)
+    {
+        std::vector<ResultSet::FieldRequest> requests;
+        requests.reserve(fields.size());
+        for (const auto& field : fields)
+        {
+            if (py::isinstance<py::str>(field))
+            {
+                requests.push_back({field.cast<std::string>(), "", ""});
+                continue;
+            }
+
+            const auto parts = field.cast<std::vector<std::string>>();
+            if (parts.empty() || parts.size() > 3)
+            {
+                throw py::value_error("Fields must be a name or a (name, group_by, type) tuple.");
+            }
+
+            requests.push_back({parts[0],
+                                parts.size() > 1 ? parts[1] : "",
+                                parts.size() > 2 ? parts[2] : ""});
+        }
+
+        return requests;
+    }
+
+    /// \brief Offset of the first byte after the given one where a shared array can start.
+    size_t alignShared(size_t offset)
+    {
+        constexpr size_t Alignment = 64;
+        return (offset + Alignment - 1) / Alignment * Alignment;
+    }
+
+    /// \brief Make the masked arrays described by a shared memory handle (see get_shared). The
+    ///        arrays are views on the shared memory, which stays mapped while any of them exists.
+    py::dict makeSharedViews(const std::shared_ptr<SharedMemory>& memory, const py::dict& handle)
+    {
+        py::object numpyModule = py::module::import("numpy");
+
+        py::dict arrays;
+        for (const auto& fieldObj : handle["fields"].cast<py::list>())
+        {
+            const auto field = fieldObj.cast<py::dict>();
+            const auto dtype = py::dtype::from_args(field["dtype"]);
+            const auto shape = field["shape"].cast<std::vector<ssize_t>>();
+            const auto offset = field["offset"].cast<size_t>();
+            const auto maskOffset = field["mask_offset"].cast<size_t>();
+
+            size_t numValues = 1;
+            for (const auto dim : shape) numValues *= static_cast<size_t>(dim);
+
+            if (offset + numValues * dtype.itemsize() > memory->size() ||
+                maskOffset + numValues > memory->size())
+            {
+                throw py::value_error("The field " + field["name"].cast<std::string>() +
+                                      " doesn't fit in the shared memory segment " +
+                                      memory->name() + ".");
+            }
+
+            auto owner = new std::shared_ptr<SharedMemory>(memory);
+            py::capsule base(owner, [](void* ptr)
+            {
+                delete static_cast<std::shared_ptr<SharedMemory>*>(ptr);
+            });
+
+            py::array data(dtype, shape, memory->data() + offset, base);
+            py::array_t<bool> mask(shape,
+                                   reinterpret_cast<bool*>(memory->data() + maskOffset),
+                                   base);
+
+            py::object maskedArray = numpyModule.attr("ma").attr("masked_array")(
+                data, py::arg("mask") = mask, py::arg("copy") = false);
+            numpyModule.attr("ma").attr("set_fill_value")(maskedArray, field["fill_value"]);
+            arrays[field["name"]] = maskedArray;
+        }
+
+        return arrays;
+    }
+
+    /// \brief Fields of a ResultSet copied into a POSIX shared memory segment. The handle is a
+    ///        small picklable dict other processes give to open_shared to map the arrays without
+    ///        copying them. The segment is removed (unlinked) when this object is destroyed, the
+    ///        processes that already mapped it keep their arrays.
+    class SharedArrays
+    {
+     public:
+        SharedArrays(std::shared_ptr<SharedMemory> memory, py::dict handle) :
+            memory_(std::move(memory)),
+            handle_(std::move(handle))
+        {
+        }
+
+        const py::dict& handle() const { return handle_; }
+        py::dict arrays() const { return makeSharedViews(memory_, handle_); }
+        void unlink() { memory_->unlink(); }
+
+     private:
+        const std::shared_ptr<SharedMemory> memory_;
+        const py::dict handle_;
+    };
 
+#ifdef BUFR_HAS_PIPELINE
+    /// \brief Get the BUFR description (the obs space) of a bufr2ioda.x configuration given as
+    ///        a dict, the path of a YAML file or YAML text. A configuration with observations
+    ///        gives the obs space of one of them.
+    eckit::LocalConfiguration descriptionConf(const py::object& config, size_t entry)
+    {
+        std::unique_ptr<eckit::YAMLConfiguration> yaml;
+        if (py::isinstance<py::dict>(config))
+        {
+            // JSON is YAML.
+            const auto json = py::module::import("json").attr("dumps")(config);
+            yaml = std::make_unique<eckit::YAMLConfiguration>(json.cast<std::string>());
+        }
+        else
+        {
+            const auto text = py::str(config).cast<std::string>();
+            if (eckit::PathName(text).exists())
+            {
+                yaml = std::make_unique<eckit::YAMLConfiguration>(eckit::PathName(text));
+            }
+            else
+            {
+                yaml = std::make_unique<eckit::YAMLConfiguration>(text);
+            }
+        }
+
+        eckit::LocalConfiguration conf(*yaml);
+        if (conf.has("observations"))
+        {
+            const auto obsConfs = conf.getSubConfigurations("observations");
+            if (entry >= obsConfs.size())
+            {
+                throw py::index_error("The configuration has " + std::to_string(obsConfs.size()) +
+                                      " observations, there is no entry " +
+                                      std::to_string(entry) + ".");
+            }
+
+            conf = obsConfs[entry];
+        }
+
+        if (conf.has("obs space")) conf = conf.getSubConfiguration("obs space");
+        return conf;
+    }
+#endif
+}  // namespace
+
+    // The GIL is released while the files are decoded and while the fields are built, so
+    // Python threads can work on different File (or FileSet) objects at the same time (the
+    // calls into NCEPLIB-bufr are still made one at a time, see DataProvider::fortranMutex).
+    // A File shouldn't be used by several threads at once. ResultSets can be read (get,
+    // get_many ...) from several threads.
     PYBIND11_MODULE(bufr, m)
     {
-        m.doc() = "Provides the ability to get data from BUFR files via query strings.";
+        m.doc() = "Provides the ability to get data from BUFR files via query strings. The GIL "
+                  "is released while files are decoded and fields are built, so threads can "
+                  "work on different File objects (and read ResultSets) at the same time.";
+
+        m.def("enable_profiling", &Profiler::enable,
+              py::arg("enable") = true,
+              py::arg("track_memory") = false,
+              "Record the time spent in each stage (decoding, collecting the fields ...) and "
+              "the counters (messages, subsets, values, target cache hits ...). With "
+              "track_memory the resident memory of the stages and the sizes of the collected "
+              "data are recorded too.");
+        m.def("reset_profile", &Profiler::reset, "Forget the recorded timers and counters.");
+        m.def("profile_report", &Profiler::report,
+              "Get the recorded timers and counters as a JSON string.");
+        m.def("set_threads", &Executor::configure,
+              py::arg("threads") = 0,
+              py::arg("pin") = false,
+              "Set the number of threads every parallel stage (decoding, building the fields "
+              "...) shares, at most. 0 uses the CPUs the process may run on (the default). "
+              "With pin each worker is bound to one of those CPUs. Call it before decoding.");
+        m.def("get_threads", &Executor::numThreads,
+              "Get the number of threads the parallel stages share.");
+        m.def("set_buffer_pool", &BufferPool::setLimit,
+              py::arg("max_bytes"),
+              "Keep up to max_bytes of the large numeric buffers (query results, fields) that "
+              "are let go, for the next files to reuse instead of allocating them again. 0 (the "
+              "default) frees them.");
+
+#ifdef BUFR_HAS_PIPELINE
+        m.def("parse",
+              [](const py::object& config, size_t threads, size_t maxMessages, size_t entry)
+              {
+                  const auto conf = descriptionConf(config, entry);
+
+                  // The exported variables of every split category.
+                  std::vector<std::vector<std::string>> categories;
+                  std::vector<std::vector<std::string>> fieldNames;
+                  std::vector<std::vector<std::shared_ptr<Ingester::DataObjectBase>>> objects;
+                  {
+                      py::gil_scoped_release release;
+
+                      Ingester::BufrParser parser(conf);
+                      const auto container = parser.parse(maxMessages, threads);
+                      categories = container->allSubCategories();
+                      for (const auto& category : categories)
+                      {
+                          fieldNames.push_back(container->fieldNames(category));
+                          objects.emplace_back();
+                          for (const auto& fieldName : fieldNames.back())
+                          {
+                              objects.back().push_back(container->get(fieldName, category));
+                          }
+                      }
+                  }
+
+                  py::dict data;
+                  for (size_t catIdx = 0; catIdx < categories.size(); ++catIdx)
+                  {
+                      py::dict arrays;
+                      for (size_t fieldIdx = 0; fieldIdx < fieldNames[catIdx].size(); ++fieldIdx)
+                      {
+                          arrays[py::str(fieldNames[catIdx][fieldIdx])] =
+                              objects[catIdx][fieldIdx]->getNumpyArray();
+                      }
+
+                      data[py::tuple(py::cast(categories[catIdx]))] = arrays;
+                  }
+
+                  return data;
+              },
+              py::arg("config"),
+              py::arg("threads") = static_cast<size_t>(1),
+              py::arg("max_messages") = static_cast<size_t>(0),
+              py::arg("entry") = static_cast<size_t>(0),
+              "Run the whole bufr2ioda.x pipeline (queries, filters, splits, derived variables) "
+              "in memory, without writing any file. config is a bufr2ioda.x configuration (a "
+              "dict, the path of a YAML file or YAML text) or just its obs space. Only the "
+              "given entry of its observations is parsed. Returns the exported variables as a "
+              "dict of masked arrays by variable name for each split category (a tuple of the "
+              "categories, () without splits). Numeric arrays share the data of the variables "
+              "(nothing is copied). Releases the GIL while parsing.");
+#endif
 
         py::class_<QuerySet>(m, "QuerySet")
             .def(py::init<>())
             .def(py::init<const std::vector<std::string>&>())
             .def("size", &QuerySet::size, "Get the number of queries in the query set.")
-            .def("add", &QuerySet::add, "Add a query to the query set.");
+            .def("add", &QuerySet::add, "Add a query to the query set.")
+            .def("set_time_window",
+                 [](QuerySet& querySet, int64_t start, int64_t end, int64_t margin)
+                 {
+                     Ingester::bufr::TimeWindow timeWindow;
+                     timeWindow.start = start;
+                     timeWindow.end = end;
+                     timeWindow.margin = margin;
+                     querySet.setTimeWindow(timeWindow);
+                 },
+                 py::arg("start"),
+                 py::arg("end"),
+                 py::arg("margin") = static_cast<int64_t>(3600),
+                 "Only collect data between start and end (seconds since 1970-01-01T00:00:00Z). "
+                 "Messages dated more than margin seconds outside the window are not decoded.")
+            .def("set_sampling",
+                 [](QuerySet& querySet, size_t every, double fraction, uint64_t seed)
+                 {
+                     if (every < 1 || fraction <= 0 || fraction > 1)
+                     {
+                         throw py::value_error(
+                             "every has to be at least 1 and fraction in (0, 1].");
+                     }
+
+                     Ingester::bufr::MessageSampling sampling;
+                     sampling.every = every;
+                     sampling.fraction = fraction;
+                     sampling.seed = seed;
+                     querySet.setSampling(sampling);
+                 },
+                 py::arg("every") = static_cast<size_t>(1),
+                 py::arg("fraction") = 1.0,
+                 py::arg("seed") = static_cast<uint64_t>(0),
+                 "Only read every n-th data message of the file and/or a random fraction of them "
+                 "(picked by their position in the file and the seed), for quick previews. The "
+                 "other messages are not decoded.")
+            .def("set_plan_cache_dir", &QuerySet::setPlanCacheDir,
+                 py::arg("cache_dir"),
+                 "Store the compiled query plans in an (existing) directory so they can be reused "
+                 "by later runs on the same kind of data.");
 
         py::class_<File>(m, "File")
-            .def(py::init<const std::string&, const std::string&>(),
+            .def(py::init([](const py::buffer& buffer, const std::string& wmoTablePath)
+                 {
+                     // The bytes are copied so the File doesn't depend on the lifetime (or the
+                     // GIL) of the Python object.
+                     const auto info = buffer.request();
+                     return new File(MessageBuffer::copyOf(info.ptr, info.size * info.itemsize),
+                                     wmoTablePath);
+                 }),
+                 py::arg("buffer"),
+                 py::arg("wmoTablePath") = std::string(""),
+                 "Open BUFR messages held in memory (bytes, bytearray, memoryview, mmap...).")
+            .def(py::init<const std::string&,
+                          const std::string&,
+                          const std::string&,
+                          const std::string&>(),
                  py::arg("filename"),
-                 py::arg("wmoTablePath") = std::string(""))
-            .def("execute", &File::execute,
+                 py::arg("wmoTablePath") = std::string(""),
+                 py::arg("indexPath") = std::string(""),
+                 py::arg("tableCachePath") = std::string(""),
+                 py::call_guard<py::gil_scoped_release>())
+            .def("execute", py::overload_cast<const QuerySet&, size_t, size_t>(&File::execute),
                              py::arg("query_set"),
                              py::arg("next") = static_cast<int>(0),
-                             "Execute a query set on the file. Returns a ResultSet object.")
+                             py::arg("threads") = static_cast<int>(1),
+                             py::call_guard<py::gil_scoped_release>(),
+                             "Execute a query set on the file. Returns a ResultSet object. "
+                             "Use threads > 1 to process blocks of messages in parallel. "
+                             "Releases the GIL.")
+            .def("execute_chunks",
+                 [](File& f, const QuerySet& querySet, size_t msgsPerChunk, size_t threads)
+                 {
+                     return ChunkIterator(f, querySet, msgsPerChunk, threads);
+                 },
+                 py::arg("query_set"),
+                 py::arg("msgs_per_chunk"),
+                 py::arg("threads") = static_cast<int>(1),
+                 py::keep_alive<0, 1>(),
+                 "Iterate over the file msgs_per_chunk messages at a time. Yields a ResultSet "
+                 "for each chunk, so only one chunk is held in memory at a time.")
+            .def("iter_execute",
+                 [](File& f, const QuerySet& querySet, size_t msgsPerChunk, size_t threads)
+                 {
+                     return ChunkIterator(f, querySet, msgsPerChunk, threads);
+                 },
+                 py::arg("query_set"),
+                 py::arg("messages_per_chunk") = static_cast<int>(100),
+                 py::arg("threads") = static_cast<int>(1),
+                 py::keep_alive<0, 1>(),
+                 "Same as execute_chunks (for rs in f.iter_execute(q, messages_per_chunk=...)). "
+                 "Yields a ResultSet for every messages_per_chunk messages (chunks without data "
+                 "are skipped), so huge files can be converted with constant memory.")
+            .def("set_native_decoding", &File::setNativeDecoding,
+                 py::arg("enable"),
+                 "Decode the data sections with the native decoder where it can (NCEPLIB-bufr "
+                 "decodes the rest).")
+            .def("set_read_ahead", &File::setReadAhead,
+                 py::arg("enable"),
+                 "Read the file through large buffers that a background thread fills ahead of "
+                 "the decoding (local, uncompressed file without an index).")
             .def("rewind", &File::rewind,
                            "Rewind the file to the beginning.")
             .def("close", &File::close,
@@ -45,6 +477,76 @@ using Ingester::bufr::File;
             .def("__enter__", [](File &f) { return &f; })
             .def("__exit__", [](File &f, py::args args) { f.close(); });
 
+        py::class_<FileSet>(m, "FileSet")
+            .def(py::init<const std::vector<std::string>&,
+                          const std::string&,
+                          const std::string&,
+                          const std::string&>(),
+                 py::arg("filenames"),
+                 py::arg("wmoTablePath") = std::string(""),
+                 py::arg("indexPath") = std::string(""),
+                 py::arg("tableCachePath") = std::string(""),
+                 py::call_guard<py::gil_scoped_release>(),
+                 "Open a list of BUFR files (paths or glob patterns) to query together.")
+            .def_property_readonly("filenames", &FileSet::filenames,
+                                   "The (expanded) paths of the files.")
+            .def("execute",
+                 py::overload_cast<const QuerySet&, size_t, size_t>(&FileSet::execute),
+                 py::arg("query_set"),
+                 py::arg("next") = static_cast<int>(0),
+                 py::arg("threads") = static_cast<int>(1),
+                 py::call_guard<py::gil_scoped_release>(),
+                 "Execute a query set on the files. Returns one ResultSet with the data of all "
+                 "the files in order. Use threads > 1 to decode the files in parallel. Releases "
+                 "the GIL.")
+            .def("set_native_decoding", &FileSet::setNativeDecoding,
+                 py::arg("enable"),
+                 "Decode the data sections with the native decoder where it can (NCEPLIB-bufr "
+                 "decodes the rest).")
+            .def("set_read_ahead", &FileSet::setReadAhead,
+                 py::arg("enable"),
+                 "Read the files through large buffers that a background thread fills ahead of "
+                 "the decoding (local, uncompressed files without an index).")
+            .def("rewind", &FileSet::rewind,
+                           "Rewind the files to the beginning.")
+            .def("close", &FileSet::close,
+                          "Close the files.")
+            .def("__enter__", [](FileSet &f) { return &f; })
+            .def("__exit__", [](FileSet &f, py::args args) { f.close(); });
+
+        py::class_<ArrowColumns>(m, "ArrowColumns")
+            .def("__arrow_c_array__", &ArrowColumns::capsules,
+                 py::arg("requested_schema") = py::none(),
+                 "Export the columns through the Arrow PyCapsule interface.");
+
+        py::class_<ChunkIterator>(m, "ChunkIterator")
+            .def("__iter__", [](ChunkIterator& it) -> ChunkIterator& { return it; })
+            .def("__next__", &ChunkIterator::next);
+
+        py::class_<SharedArrays>(m, "SharedArrays")
+            .def_property_readonly("handle", &SharedArrays::handle,
+                 "Picklable description of the shared memory segment and of the arrays in it "
+                 "(give it to open_shared).")
+            .def("arrays", &SharedArrays::arrays,
+                 "Get the shared fields as a dict of masked arrays by field name (views on the "
+                 "shared memory).")
+            .def("unlink", &SharedArrays::unlink,
+                 "Remove the name of the segment now (processes that already opened it keep "
+                 "their arrays). Done automatically when this object is destroyed.")
+            .def("__enter__", [](SharedArrays& s) { return &s; })
+            .def("__exit__", [](SharedArrays& s, py::args args) { s.unlink(); });
+
+        m.def("open_shared",
+              [](const py::dict& handle)
+              {
+                  return makeSharedViews(SharedMemory::open(handle["name"].cast<std::string>()),
+                                         handle);
+              },
+              py::arg("handle"),
+              "Map the fields shared by ResultSet.get_shared (given its handle) as a dict of "
+              "masked arrays by field name. The arrays are views on the shared memory, nothing "
+              "is copied.");
+
         py::class_<ResultSet>(m, "ResultSet")
             .def("get", &ResultSet::getNumpyArray,
                         py::arg("field_name"),
@@ -53,6 +555,185 @@ using Ingester::bufr::File;
                         "Get a numpy array of the specified field name. If the group_by "
                         "field is specified, the array is grouped by the specified field."
                         "It is also possible to specify a type to override the default type.")
+            .def("get_many",
+                 [](const ResultSet& resultSet,
+                    const py::list& fields,
+                    size_t threads,
+                    bool asDict) -> py::object
+                 {
+                     const auto requests = toFieldRequests(fields);
+
+                     std::vector<std::shared_ptr<Ingester::DataObjectBase>> objects;
+                     {
+                         py::gil_scoped_release release;
+                         objects = resultSet.getMany(requests, threads);
+                     }
+
+                     if (asDict)
+                     {
+                         py::dict arrays;
+                         for (size_t idx = 0; idx < objects.size(); ++idx)
+                         {
+                             const auto& name = requests[idx].fieldName;
+                             if (arrays.contains(name))
+                             {
+                                 throw py::value_error("The field " + name + " is requested "
+                                                       "more than once (use as_dict=False).");
+                             }
+
+                             arrays[py::str(name)] = objects[idx]->getNumpyArray();
+                         }
+
+                         return arrays;
+                     }
+
+                     py::list arrays;
+                     for (const auto& object : objects)
+                     {
+                         arrays.append(object->getNumpyArray());
+                     }
+
+                     return arrays;
+                 },
+                 py::arg("fields"),
+                 py::arg("threads") = 1,
+                 py::arg("as_dict") = false,
+                 "Get the numpy arrays for many fields at once (faster than calling get for "
+                 "each, the frames are only traversed once). Each field is either a field name "
+                 "or a (field_name, group_by, type) tuple. The arrays are returned as a list in "
+                 "the same order, or with as_dict=True as a dict by field name. The fields are "
+                 "built using up to the given number of threads.")
+            .def("get_shared",
+                 [](const ResultSet& resultSet,
+                    const py::list& fields,
+                    size_t threads,
+                    const std::string& name)
+                 {
+                     const auto requests = toFieldRequests(fields);
+
+                     std::vector<std::shared_ptr<Ingester::DataObjectBase>> objects;
+                     {
+                         py::gil_scoped_release release;
+                         objects = resultSet.getMany(requests, threads);
+                     }
+
+                     // Lay out the data and the mask of each field
+                     py::object numpyModule = py::module::import("numpy");
+                     std::vector<py::array> sources;
+                     std::vector<size_t> offsets;
+                     py::list fieldInfos;
+                     size_t size = 0;
+                     for (size_t idx = 0; idx < objects.size(); ++idx)
+                     {
+                         const auto& fieldName = requests[idx].fieldName;
+                         for (size_t prevIdx = 0; prevIdx < idx; ++prevIdx)
+                         {
+                             if (requests[prevIdx].fieldName == fieldName)
+                             {
+                                 throw py::value_error("The field " + fieldName + " is "
+                                                       "requested more than once.");
+                             }
+                         }
+
+                         py::object maskedArray = objects[idx]->getNumpyArray();
+                         const auto kind = maskedArray.attr("dtype").attr("kind")
+                                                      .cast<std::string>();
+                         if (kind == "O" || kind == "U" || kind == "S")
+                         {
+                             throw py::value_error("The field " + fieldName + " holds strings, "
+                                                   "which can't be shared.");
+                         }
+
+                         py::array data = numpyModule.attr("ascontiguousarray")(
+                             maskedArray.attr("data"));
+                         py::array mask = numpyModule.attr("ascontiguousarray")(
+                             numpyModule.attr("ma").attr("getmaskarray")(maskedArray));
+
+                         const auto offset = alignShared(size);
+                         const auto dataSize = static_cast<size_t>(data.nbytes());
+                         const auto maskOffset = alignShared(offset + dataSize);
+                         size = maskOffset + static_cast<size_t>(mask.nbytes());
+
+                         py::dict info;
+                         info["name"] = fieldName;
+                         info["dtype"] = data.dtype().attr("str");
+                         info["shape"] = maskedArray.attr("shape");
+                         info["offset"] = offset;
+                         info["mask_offset"] = maskOffset;
+                         info["fill_value"] = maskedArray.attr("fill_value").attr("item")();
+                         fieldInfos.append(info);
+
+                         offsets.push_back(offset);
+                         sources.push_back(data);
+                         offsets.push_back(maskOffset);
+                         sources.push_back(mask);
+                     }
+
+                     auto memory = SharedMemory::create(
+                         name.empty() ? SharedMemory::uniqueName() : name, size);
+
+                     std::vector<std::pair<const void*, size_t>> buffers;
+                     for (const auto& source : sources)
+                     {
+                         buffers.emplace_back(source.data(), static_cast<size_t>(source.nbytes()));
+                     }
+
+                     {
+                         py::gil_scoped_release release;
+                         for (size_t idx = 0; idx < buffers.size(); ++idx)
+                         {
+                             std::memcpy(memory->data() + offsets[idx],
+                                         buffers[idx].first,
+                                         buffers[idx].second);
+                         }
+                     }
+
+                     py::dict handle;
+                     handle["name"] = memory->name();
+                     handle["size"] = size;
+                     handle["fields"] = fieldInfos;
+                     return SharedArrays(std::move(memory), std::move(handle));
+                 },
+                 py::arg("fields"),
+                 py::arg("threads") = 1,
+                 py::arg("name") = std::string(""),
+                 "Copy the fields (same arguments as get_many) into a POSIX shared memory "
+                 "segment, so other processes (ex: multiprocessing workers) can use them "
+                 "without copying. Give the handle of the returned object to open_shared in the "
+                 "other processes. The segment is named after the process unless a name is "
+                 "given. String fields are not supported.")
+            .def("get_arrow",
+                 [](const ResultSet& resultSet, const py::list& fields, size_t threads)
+                 {
+                     const auto requests = toFieldRequests(fields);
+
+                     std::vector<std::shared_ptr<Ingester::DataObjectBase>> objects;
+                     std::vector<Ingester::arrow::Column> columns;
+                     {
+                         py::gil_scoped_release release;
+                         objects = resultSet.getMany(requests, threads);
+                         for (size_t idx = 0; idx < objects.size(); ++idx)
+                         {
+                             columns.push_back(
+                                 objects[idx]->makeArrowColumn(requests[idx].fieldName));
+                         }
+                     }
+
+                     const int64_t numRows = objects.empty() ? 0 : objects[0]->getDims()[0];
+                     return ArrowColumns(Ingester::arrow::makeStruct("", numRows,
+                                                                     std::move(columns)));
+                 },
+                 py::arg("fields"),
+                 py::arg("threads") = 1,
+                 "Get the fields (same arguments as get_many) as an Arrow struct array with one "
+                 "field per requested field. The returned object implements the Arrow PyCapsule "
+                 "interface (ex: pyarrow.record_batch(result_set.get_arrow(fields))). Missing "
+                 "values are null, extra dimensions are fixed size lists and strings are "
+                 "dictionary encoded. Numeric data is not copied.")
+            .def("release", &ResultSet::release,
+                 py::arg("field_name"),
+                 "Free the memory used to remember the data of a field that was already "
+                 "requested (the field can still be requested again).")
             .def("get_datetime", &ResultSet::getNumpyDatetimeArray,
                         py::arg("year"),
                         py::arg("month"),
@@ -0,0 +1,202 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "ResultCache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <thread>  // NOLINT
+
+#include "BufrDataTransfer.h"
+#include "BufrDescription.h"
+#include "Exports/Variables/Variable.h"
+#include "Query/DataProvider/RemoteFile.h"
+
+
+namespace
+{
+    const char* ResultMagic = "BUFRRESULTS";
+    const int ResultVersion = 1;
+
+    /// \brief 64 bit FNV-1a hash of a string (to name the cache files).
+    std::uint64_t hashOf(const std::string& str)
+    {
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (auto c : str)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    /// \brief Describe the version of a file (its size and modification time).
+    std::string fileVersion(const std::string& filePath)
+    {
+        std::ostringstream version;
+
+        // Object stores don't give a usable modification time, so remote files are checked by
+        // size only.
+        if (Ingester::bufr::RemoteFile::isRemote(filePath))
+        {
+            version << Ingester::bufr::RemoteFile(filePath).size();
+            return version.str();
+        }
+
+        struct stat fileInfo;
+        if (stat(filePath.c_str(), &fileInfo) != 0) return "missing";
+
+        version << fileInfo.st_size << " " << fileInfo.st_mtime;
+        return version.str();
+    }
+}  // namespace
+
+namespace Ingester
+{
+    ResultCache::ResultCache(const std::string& cacheDir) :
+        cacheDir_(cacheDir)
+    {
+    }
+
+    std::string ResultCache::keyFor(const std::vector<std::string>& filePaths,
+                                    const BufrDescription& description)
+    {
+        std::ostringstream key;
+        key << ResultVersion << "\n";
+
+        for (const auto& filePath : filePaths)
+        {
+            key << "file " << std::quoted(filePath) << " " << fileVersion(filePath) << "\n";
+        }
+
+        key << "tables " << std::quoted(description.tablepath()) << "\n";
+
+        const auto exportDescription = description.getExport();
+        for (const auto& subset : exportDescription.getSubsets())
+        {
+            key << "subset " << subset << "\n";
+        }
+
+        if (description.hasTimeWindow())
+        {
+            const auto timeWindow = description.timeWindow();
+            key << "window " << timeWindow.start << " " << timeWindow.end << " "
+                << timeWindow.margin << "\n";
+        }
+
+        const auto sampling = description.sampling();
+        if (sampling.isSampling())
+        {
+            key << "sampling " << sampling.every << " " << std::setprecision(17)
+                << sampling.fraction << " " << sampling.seed << "\n";
+        }
+
+        for (const auto& var : exportDescription.getVariables())
+        {
+            for (const auto& queryInfo : var->getQueryList())
+            {
+                key << "query " << std::quoted(queryInfo.name) << " "
+                    << std::quoted(queryInfo.query) << " "
+                    << std::quoted(queryInfo.groupByField) << " "
+                    << std::quoted(queryInfo.type) << "\n";
+            }
+        }
+
+        for (const auto& constraint : exportDescription.getValueConstraints())
+        {
+            key << "constraint " << std::quoted(constraint.name) << " "
+                << std::setprecision(9) << constraint.lower << " " << constraint.upper << " "
+                << constraint.allowsMissing;
+            for (const auto category : constraint.categories) key << " " << category;
+            key << "\n";
+        }
+
+        return key.str();
+    }
+
+    bool ResultCache::load(const std::string& key, BufrDataMap& dataMap) const
+    {
+        std::ifstream file(pathFor(key), std::ios::binary);
+        if (!file) return false;
+
+        std::string magic;
+        int version = 0;
+        std::uint64_t keySize = 0;
+        file >> magic >> version >> keySize;
+        file.get();  // End of the line
+        if (!file || magic != ResultMagic || version != ResultVersion) return false;
+
+        // The files are named by the hash of the key, so make sure it's really the same key.
+        std::string storedKey(static_cast<size_t>(keySize), '\0');
+        file.read(&storedKey[0], static_cast<std::streamsize>(storedKey.size()));
+        if (!file || storedKey != key) return false;
+
+        const std::string buffer((std::istreambuf_iterator<char>(file)),
+                                 std::istreambuf_iterator<char>());
+        try
+        {
+            dataMap = BufrDataTransfer::unpack(buffer);
+        }
+        catch (const std::exception&)
+        {
+            return false;  // Truncated (a broken cache entry is the same as a missing one)
+        }
+
+        return true;
+    }
+
+    void ResultCache::store(const std::string& key, const BufrDataMap& dataMap) const
+    {
+        const auto path = pathFor(key);
+
+        // Several processes can store the same results at the same time, so write to a private
+        // file and move it into place.
+        std::ostringstream tmpPath;
+        tmpPath << path << "." << getpid() << "."
+                << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+        {
+            std::ofstream file(tmpPath.str(), std::ios::binary);
+            if (!file) return;
+
+            const auto buffer = BufrDataTransfer::pack(dataMap);
+            file << ResultMagic << " " << ResultVersion << " " << key.size() << "\n";
+            file.write(key.data(), static_cast<std::streamsize>(key.size()));
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+            if (!file)
+            {
+                file.close();
+                std::remove(tmpPath.str().c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tmpPath.str().c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmpPath.str().c_str());
+        }
+    }
+
+    std::string ResultCache::pathFor(const std::string& key) const
+    {
+        std::ostringstream path;
+        path << cacheDir_ << "/" << std::hex << std::setw(16) << std::setfill('0') << hashOf(key)
+             << ".results";
+        return path.str();
+    }
+}  // namespace Ingester
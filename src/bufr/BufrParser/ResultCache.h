@@ -0,0 +1,56 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "IngesterTypes.h"
+
+
+namespace Ingester
+{
+    class BufrDescription;
+
+    /// \brief Keeps the fields collected from BUFR files (see BufrParser::collectFields) in a
+    ///        directory, so later runs that only change how the fields are exported (filters,
+    ///        splits, variables, ioda section) don't decode the files again. The entries are
+    ///        keyed by the files (path, size and modification time) and everything that goes
+    ///        into collecting the fields (subsets, queries, group by fields, types, value
+    ///        constraints and time window).
+    class ResultCache
+    {
+     public:
+        /// \brief Constructor.
+        /// \param cacheDir The (existing) directory for the cache files.
+        explicit ResultCache(const std::string& cacheDir);
+
+        /// \brief Make the key for the fields of a description.
+        /// \param filePaths The (expanded) paths of the BUFR files.
+        /// \param description The description the fields are collected for.
+        static std::string keyFor(const std::vector<std::string>& filePaths,
+                                  const BufrDescription& description);
+
+        /// \brief Load the fields stored for a key.
+        /// \param key The key (see keyFor).
+        /// \param dataMap Filled with the fields.
+        /// \return false if there are none.
+        bool load(const std::string& key, BufrDataMap& dataMap) const;
+
+        /// \brief Store the fields for a key. Failing to write the cache isn't an error.
+        /// \param key The key (see keyFor).
+        /// \param dataMap The fields.
+        void store(const std::string& key, const BufrDataMap& dataMap) const;
+
+     private:
+        const std::string cacheDir_;
+
+        /// \brief Get the path of the cache file for a key.
+        std::string pathFor(const std::string& key) const;
+    };
+}  // namespace Ingester
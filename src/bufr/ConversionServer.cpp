@@ -0,0 +1,380 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "ConversionServer.h"
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>  // NOLINT
+
+#include "eckit/config/YAMLConfiguration.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/filesystem/PathName.h"
+#include "oops/util/Logger.h"
+
+#include "BufrParser/BufrParser.h"
+#include "BufrParser/Query/BufferPool.h"
+#include "BufrParser/Query/TargetCache.h"
+#include "IodaEncoder/IodaEncoder.h"
+
+
+namespace
+{
+    const char* InputPlaceholder = "{input}";
+
+    /// \brief The most bytes of buffers kept between the files (see bufr::BufferPool), unless
+    ///        the pool was already set up.
+    const size_t BufferPoolBytes = static_cast<size_t>(1) << 30;
+
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void requestStop(int signalNumber)
+    {
+        stopRequested = 1;
+    }
+
+    /// \brief Stop the server loops on SIGINT and SIGTERM. The handlers don't restart the
+    ///        system calls, so a blocked accept or read returns right away.
+    void handleStopSignals()
+    {
+        stopRequested = 0;
+
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = requestStop;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+    }
+
+    std::string fileName(const std::string& path)
+    {
+        const auto slashPos = path.find_last_of('/');
+        return slashPos == std::string::npos ? path : path.substr(slashPos + 1);
+    }
+
+    std::string replaceAll(std::string str, const std::string& from, const std::string& to)
+    {
+        for (auto pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos))
+        {
+            str.replace(pos, from.size(), to);
+            pos += to.size();
+        }
+
+        return str;
+    }
+
+    /// \brief Send all of a string to a socket.
+    bool sendAll(int socketFd, const std::string& str)
+    {
+        size_t sent = 0;
+        while (sent < str.size())
+        {
+            const auto result = send(socketFd, str.data() + sent, str.size() - sent, MSG_NOSIGNAL);
+            if (result < 0 && errno == EINTR && !stopRequested) continue;
+            if (result <= 0) return false;
+            sent += static_cast<size_t>(result);
+        }
+
+        return true;
+    }
+}  // namespace
+
+namespace Ingester
+{
+    ConversionServer::ConversionServer(const std::string& yamlPath, size_t numThreads) :
+        numThreads_(numThreads),
+        targetCache_(std::make_shared<bufr::SharedTargetCache>())
+    {
+        // The files are converted one after the other, so their buffers are recycled.
+        if (bufr::BufferPool::limit() == 0) bufr::BufferPool::setLimit(BufferPoolBytes);
+
+        const eckit::PathName yamlFile(yamlPath);
+        const eckit::YAMLConfiguration yaml(yamlFile);
+        if (!yaml.has("observations"))
+        {
+            throw eckit::BadParameter("No section named \"observations\"");
+        }
+
+        for (const auto& obsConf : yaml.getSubConfigurations("observations"))
+        {
+            if (!obsConf.has("obs space") || !obsConf.has("ioda"))
+            {
+                throw eckit::BadParameter(
+                    "Incomplete obs found. All obs must have a obs space and ioda.");
+            }
+
+            Entry entry{BufrDescription(obsConf.getSubConfiguration("obs space")),
+                        obsConf.getSubConfiguration("ioda"),
+                        {}};
+
+            for (const auto& path : entry.description.filepaths())
+            {
+                entry.namePatterns.push_back(fileName(path));
+            }
+
+            // The sidecars and cached results are named for the files of the YAML, and the
+            // files that arrive are only read once.
+            entry.description.setIndexpath("");
+            entry.description.setTableCachePath("");
+            entry.description.setResultCachePath("");
+            entry.description.setTargetCache(targetCache_);
+
+            entries_.push_back(entry);
+        }
+    }
+
+    bool ConversionServer::convert(const std::string& filePath)
+    {
+        const auto name = fileName(filePath);
+
+        std::vector<size_t> entryIdxs;
+        for (size_t entryIdx = 0; entryIdx < entries_.size(); entryIdx++)
+        {
+            for (const auto& pattern : entries_[entryIdx].namePatterns)
+            {
+                if (fnmatch(pattern.c_str(), name.c_str(), 0) == 0)
+                {
+                    entryIdxs.push_back(entryIdx);
+                    break;
+                }
+            }
+        }
+
+        if (entryIdxs.empty()) return false;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        // The entries that read the file the same way decode it together (see
+        // BufrParser::parseShared).
+        std::vector<std::vector<size_t>> groups;
+        std::vector<BufrDescription> descriptions;
+        for (const auto entryIdx : entryIdxs)
+        {
+            descriptions.push_back(entries_[entryIdx].description);
+            descriptions.back().setFilepath(filePath);
+
+            bool isGrouped = false;
+            for (auto& group : groups)
+            {
+                if (descriptions[group.front()].hasSameInput(descriptions.back()))
+                {
+                    group.push_back(descriptions.size() - 1);
+                    isGrouped = true;
+                    break;
+                }
+            }
+
+            if (!isGrouped) groups.push_back({descriptions.size() - 1});
+        }
+
+        for (const auto& group : groups)
+        {
+            std::vector<BufrDescription> groupDescriptions;
+            for (const auto descIdx : group)
+            {
+                groupDescriptions.push_back(descriptions[descIdx]);
+            }
+
+            auto data = BufrParser::parseShared(groupDescriptions, 0, numThreads_);
+            for (size_t dataIdx = 0; dataIdx < group.size(); dataIdx++)
+            {
+                auto iodaConf = entries_[entryIdxs[group[dataIdx]]].iodaConf;
+                if (iodaConf.has("obsdataout"))
+                {
+                    iodaConf.set("obsdataout", replaceAll(iodaConf.getString("obsdataout"),
+                                                          InputPlaceholder,
+                                                          name));
+                }
+
+                IodaEncoder(iodaConf).encode(data[dataIdx]);
+                data[dataIdx].reset();
+            }
+        }
+
+        auto timeElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime);
+        oops::Log::info() << "ConversionServer: Converted " << filePath << " ["
+                          << timeElapsed.count() / 1000.0 << "s]" << std::endl;
+
+        return true;
+    }
+
+    void ConversionServer::watch(const std::string& dirPath, double pollSeconds)
+    {
+        handleStopSignals();
+
+        // The sizes of the files that weren't converted yet, as of the last scan.
+        std::map<std::string, std::int64_t> pending;
+        std::set<std::string> seen;
+
+        oops::Log::info() << "ConversionServer: Watching " << dirPath << std::endl;
+        while (!stopRequested)
+        {
+            DIR* dir = opendir(dirPath.c_str());
+            if (dir == nullptr)
+            {
+                std::ostringstream errStr;
+                errStr << "ConversionServer: Can't read the directory " << dirPath << ".";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            std::vector<std::pair<std::string, std::int64_t>> files;
+            while (const auto* dirEntry = readdir(dir))
+            {
+                const std::string name(dirEntry->d_name);
+                if (name.empty() || name[0] == '.') continue;
+
+                const auto path = dirPath + "/" + name;
+                struct stat fileInfo;
+                if (stat(path.c_str(), &fileInfo) != 0 || !S_ISREG(fileInfo.st_mode)) continue;
+
+                files.emplace_back(path, static_cast<std::int64_t>(fileInfo.st_size));
+            }
+
+            closedir(dir);
+            std::sort(files.begin(), files.end());
+
+            // Forget the files that were removed, so a new file with the same name is converted.
+            std::set<std::string> present;
+            for (const auto& file : files) present.insert(file.first);
+            for (auto seenIt = seen.begin(); seenIt != seen.end();)
+            {
+                seenIt = present.count(*seenIt) ? std::next(seenIt) : seen.erase(seenIt);
+            }
+
+            for (const auto& file : files)
+            {
+                if (stopRequested) break;
+                if (seen.find(file.first) != seen.end()) continue;
+
+                const auto pendingIt = pending.find(file.first);
+                if (pendingIt == pending.end() || pendingIt->second != file.second)
+                {
+                    pending[file.first] = file.second;
+                    continue;
+                }
+
+                pending.erase(pendingIt);
+                seen.insert(file.first);
+
+                try
+                {
+                    convert(file.first);
+                }
+                catch (const std::exception& e)
+                {
+                    oops::Log::error() << "ConversionServer: Failed to convert " << file.first
+                                       << ": " << e.what() << std::endl;
+                }
+            }
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(pollSeconds));
+        }
+    }
+
+    void ConversionServer::listen(const std::string& socketPath)
+    {
+        handleStopSignals();
+
+        struct sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path))
+        {
+            std::ostringstream errStr;
+            errStr << "ConversionServer: The socket path " << socketPath << " is too long.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+        const int serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(socketPath.c_str());
+        if (serverFd < 0 ||
+            bind(serverFd, reinterpret_cast<const struct sockaddr*>(&address),
+                 sizeof(address)) != 0 ||
+            ::listen(serverFd, SOMAXCONN) != 0)
+        {
+            const std::string reason = std::strerror(errno);
+            if (serverFd >= 0) close(serverFd);
+
+            std::ostringstream errStr;
+            errStr << "ConversionServer: Can't listen on " << socketPath << " (" << reason
+                   << ").";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        oops::Log::info() << "ConversionServer: Listening on " << socketPath << std::endl;
+
+        // The clients are served one at a time, NCEPLIB-bufr only decodes one file at once
+        // anyway.
+        while (!stopRequested)
+        {
+            const int clientFd = accept(serverFd, nullptr, nullptr);
+            if (clientFd < 0) continue;  // Interrupted (or the client went away)
+
+            std::string buffer;
+            char chunk[4096];
+            bool isConnected = true;
+            while (isConnected && !stopRequested)
+            {
+                const auto numRead = read(clientFd, chunk, sizeof(chunk));
+                if (numRead < 0 && errno == EINTR) continue;
+                if (numRead <= 0) break;
+                buffer.append(chunk, static_cast<size_t>(numRead));
+
+                for (auto endPos = buffer.find('\n');
+                     isConnected && endPos != std::string::npos;
+                     endPos = buffer.find('\n'))
+                {
+                    auto path = buffer.substr(0, endPos);
+                    buffer.erase(0, endPos + 1);
+                    if (!path.empty() && path.back() == '\r') path.pop_back();
+                    if (path.empty()) continue;
+
+                    std::ostringstream reply;
+                    try
+                    {
+                        reply << (convert(path) ? "OK " : "SKIPPED ") << path << "\n";
+                    }
+                    catch (const std::exception& e)
+                    {
+                        oops::Log::error() << "ConversionServer: Failed to convert " << path
+                                           << ": " << e.what() << std::endl;
+                        reply << "ERROR " << path << ": " << replaceAll(e.what(), "\n", " ")
+                              << "\n";
+                    }
+
+                    isConnected = sendAll(clientFd, reply.str());
+                }
+            }
+
+            close(clientFd);
+        }
+
+        close(serverFd);
+        unlink(socketPath.c_str());
+    }
+}  // namespace Ingester
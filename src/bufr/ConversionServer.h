@@ -0,0 +1,74 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "eckit/config/LocalConfiguration.h"
+
+#include "BufrParser/BufrDescription.h"
+
+
+namespace Ingester
+{
+    /// \brief Converts BUFR files one at a time as they arrive, for services that would
+    ///        otherwise start bufr2ioda.x for every small file. The YAML is read and the
+    ///        descriptions are built once, and the compiled queries are shared by all the
+    ///        files (the NCEPLIB-bufr master tables also stay loaded in the process).
+    ///
+    ///        A file is converted by the observations entries whose obsdatain file names (or
+    ///        glob patterns) match its name, as if it were their only input file. The
+    ///        {input} placeholder in obsdataout is replaced with the name of the file (without
+    ///        its directory), so each file gets its own outputs.
+    ///
+    ///        The large buffers of each file (the query results, the fields) are kept in the
+    ///        bufr::BufferPool for the next file instead of being freed.
+    class ConversionServer
+    {
+     public:
+        /// \brief Constructor.
+        /// \param yamlPath Path to the bufr2ioda YAML file.
+        /// \param numThreads Number of threads used to decode each file and build its variables.
+        explicit ConversionServer(const std::string& yamlPath, size_t numThreads = 1);
+
+        /// \brief Convert one file.
+        /// \param filePath Path to the BUFR file.
+        /// \return false if no observations entry reads files with its name.
+        bool convert(const std::string& filePath);
+
+        /// \brief Convert the files that appear in a directory (and the ones already in it),
+        ///        until the process gets SIGINT or SIGTERM. A file is converted once its size
+        ///        stayed the same for a polling interval, so files that are still being written
+        ///        aren't read. Failed conversions are logged.
+        /// \param dirPath Path to the directory.
+        /// \param pollSeconds Seconds between the scans of the directory.
+        void watch(const std::string& dirPath, double pollSeconds = 1.0);
+
+        /// \brief Convert the files whose paths are sent to a Unix domain socket, until the
+        ///        process gets SIGINT or SIGTERM. Clients send one path per line, and get one
+        ///        line back for each ("OK <path>", "SKIPPED <path>" when no entry reads it, or
+        ///        "ERROR <path>: <message>") once it is converted.
+        /// \param socketPath Path of the socket (replaced if it exists).
+        void listen(const std::string& socketPath);
+
+     private:
+        /// \brief An observations entry of the YAML.
+        struct Entry
+        {
+            BufrDescription description;
+            eckit::LocalConfiguration iodaConf;
+            std::vector<std::string> namePatterns;  // The file names of obsdatain
+        };
+
+        const size_t numThreads_;
+        std::vector<Entry> entries_;
+        std::shared_ptr<bufr::SharedTargetCache> targetCache_;
+    };
+}  // namespace Ingester
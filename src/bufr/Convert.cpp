@@ -0,0 +1,133 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "Convert.h"
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <memory>
+
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/config/YAMLConfiguration.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/filesystem/PathName.h"
+
+#include "BufrParser/BufrDescription.h"
+#include "BufrParser/BufrParser.h"
+#include "IodaEncoder/IodaEncoder.h"
+
+
+namespace
+{
+    namespace ConfKeys
+    {
+        const char* Observations = "observations";
+        const char* ObsSpace = "obs space";
+        const char* Ioda = "ioda";
+        const char* Backend = "backend";
+    }  // namespace ConfKeys
+
+    /// \brief The ioda section of an entry, with the netcdf backend swapped for ObsStore.
+    eckit::LocalConfiguration inMemoryConf(const eckit::LocalConfiguration& iodaConf)
+    {
+        auto conf = iodaConf;
+        if (conf.has(ConfKeys::Backend) &&
+            boost::algorithm::to_lower_copy(conf.getString(ConfKeys::Backend)) == "netcdf")
+        {
+            conf.set(ConfKeys::Backend, "inmemory");
+        }
+
+        return conf;
+    }
+}  // namespace
+
+namespace Ingester
+{
+    std::vector<ObsGroups> convert(const eckit::Configuration& conf,
+                                   size_t numMsgs,
+                                   size_t numThreads)
+    {
+        if (!conf.has(ConfKeys::Observations))
+        {
+            throw eckit::BadParameter("No section named \"observations\"");
+        }
+
+        const auto obsConfs = conf.getSubConfigurations(ConfKeys::Observations);
+
+        // Group the entries that read the same BUFR files, in the order of their first entry.
+        std::vector<BufrDescription> descriptions;
+        std::vector<std::vector<size_t>> groups;
+        for (size_t obsIdx = 0; obsIdx < obsConfs.size(); ++obsIdx)
+        {
+            const auto& obsConf = obsConfs[obsIdx];
+            if (!obsConf.has(ConfKeys::ObsSpace) || !obsConf.has(ConfKeys::Ioda))
+            {
+                throw eckit::BadParameter(
+                    "Incomplete obs found. All obs must have a obs space and ioda.");
+            }
+
+            descriptions.emplace_back(obsConf.getSubConfiguration(ConfKeys::ObsSpace));
+
+            auto groupIt = std::find_if(groups.begin(), groups.end(),
+                [&descriptions](const std::vector<size_t>& group)
+                {
+                    return descriptions[group.front()].hasSameInput(descriptions.back());
+                });
+
+            if (groupIt != groups.end())
+            {
+                groupIt->push_back(obsIdx);
+            }
+            else
+            {
+                groups.push_back({obsIdx});
+            }
+        }
+
+        std::vector<ObsGroups> obsGroups(obsConfs.size());
+        for (const auto& group : groups)
+        {
+            std::vector<std::shared_ptr<DataContainer>> data;
+            if (group.size() == 1)
+            {
+                BufrParser parser(descriptions[group.front()]);
+                data.push_back(parser.parse(numMsgs, numThreads));
+            }
+            else
+            {
+                std::vector<BufrDescription> groupDescriptions;
+                for (const auto obsIdx : group)
+                {
+                    groupDescriptions.push_back(descriptions[obsIdx]);
+                }
+
+                data = BufrParser::parseShared(groupDescriptions, numMsgs, numThreads);
+            }
+
+            for (size_t entryIdx = 0; entryIdx < group.size(); ++entryIdx)
+            {
+                const auto obsIdx = group[entryIdx];
+                auto encoder = IodaEncoder(
+                    inMemoryConf(obsConfs[obsIdx].getSubConfiguration(ConfKeys::Ioda)));
+
+                obsGroups[obsIdx] = encoder.encode(data[entryIdx]);
+                data[entryIdx].reset();
+            }
+        }
+
+        return obsGroups;
+    }
+
+    std::vector<ObsGroups> convert(const std::string& yamlPath,
+                                   size_t numMsgs,
+                                   size_t numThreads)
+    {
+        const auto yaml = eckit::YAMLConfiguration(eckit::PathName(yamlPath));
+        return convert(yaml, numMsgs, numThreads);
+    }
+}  // namespace Ingester
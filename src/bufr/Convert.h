@@ -0,0 +1,48 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "eckit/config/Configuration.h"
+#include "ioda/ObsGroup.h"
+
+#include "DataContainer.h"
+
+
+namespace Ingester
+{
+    /// \brief The ObsGroups of an observations entry, one per split category.
+    typedef std::map<SubCategory, ioda::ObsGroup> ObsGroups;
+
+    /// \brief Convert the observations of a bufr2ioda configuration in this process, without
+    ///        writing files. Entries with the netcdf backend are kept in memory (ObsStore)
+    ///        instead, the in-memory backends (inmemory and hdf5mem) are used as they are.
+    ///        Entries that read the same BUFR files are decoded together (see
+    ///        BufrParser::parseShared).
+    /// \param conf The configuration (with the observations list).
+    /// \param numMsgs Number of BUFR messages to parse (0 for all of them).
+    /// \param numThreads Number of threads used to decode the BUFR messages and to build the
+    ///        variables.
+    /// \return The ObsGroups of each entry, in the order of the entries.
+    std::vector<ObsGroups> convert(const eckit::Configuration& conf,
+                                   size_t numMsgs = 0,
+                                   size_t numThreads = 1);
+
+    /// \brief Convert the observations of a bufr2ioda YAML file in this process (see above).
+    /// \param yamlPath Path to the YAML file.
+    /// \param numMsgs Number of BUFR messages to parse (0 for all of them).
+    /// \param numThreads Number of threads used to decode the BUFR messages and to build the
+    ///        variables.
+    /// \return The ObsGroups of each entry, in the order of the entries.
+    std::vector<ObsGroups> convert(const std::string& yamlPath,
+                                   size_t numMsgs = 0,
+                                   size_t numThreads = 1);
+}  // namespace Ingester
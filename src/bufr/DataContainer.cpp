@@ -6,12 +6,23 @@
  */
 
 
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <string>
 #include <ostream>
+#include <utility>
+#include <vector>
 
 #include "eckit/exception/Exceptions.h"
+#include "oops/util/Logger.h"
 
 #include "DataContainer.h"
+#include "BufrParser/BufrDataTransfer.h"
 
 
 namespace Ingester
@@ -28,6 +39,14 @@ namespace Ingester
         makeDataSets();
     }
 
+    DataContainer::~DataContainer()
+    {
+        for (const auto& spillFile : spillFiles_)
+        {
+            std::remove(spillFile.second.c_str());
+        }
+    }
+
     void DataContainer::add(const std::string& fieldName,
                             const std::shared_ptr<DataObjectBase> data,
                             const SubCategory& categoryId)
@@ -40,6 +59,22 @@ namespace Ingester
             throw eckit::BadParameter(errorStr.str());
         }
 
+        if (spillFiles_.find(categoryId) != spillFiles_.end())
+        {
+            std::ostringstream errorStr;
+            errorStr << "ERROR: Can't add " << fieldName << " to the spilled subcategory ";
+            errorStr << makeSubCategoryStr(categoryId) << std::endl;
+            throw eckit::BadParameter(errorStr.str());
+        }
+
+        if (producer_)
+        {
+            std::ostringstream errorStr;
+            errorStr << "ERROR: Can't add " << fieldName << " to the subcategory ";
+            errorStr << makeSubCategoryStr(categoryId) << " (its fields are made on demand).";
+            throw eckit::BadParameter(errorStr.str());
+        }
+
         dataSets_.at(categoryId).insert({fieldName, data});
     }
 
@@ -56,7 +91,7 @@ namespace Ingester
             throw eckit::BadParameter(errStr.str());
         }
 
-        return dataSets_.at(categoryId).at(fieldName);
+        return dataSet(categoryId)->at(fieldName);
     }
 
     std::shared_ptr<DataObjectBase> DataContainer::getGroupByObject(
@@ -73,13 +108,14 @@ namespace Ingester
             throw eckit::BadParameter(errStr.str());
         }
 
-        auto& dataObject = dataSets_.at(categoryId).at(fieldName);
+        const auto fields = dataSet(categoryId);
+        auto& dataObject = fields->at(fieldName);
         const auto& groupByFieldName = dataObject->getGroupByFieldName();
 
         std::shared_ptr<DataObjectBase> groupByObject = dataObject;
         if (!groupByFieldName.empty())
         {
-            for (const auto &obj : dataSets_.at(categoryId))
+            for (const auto &obj : *fields)
             {
                 if (obj.second->getFieldName() == groupByFieldName)
                 {
@@ -105,6 +141,27 @@ namespace Ingester
         return hasKey;
     }
 
+    std::vector<std::string> DataContainer::fieldNames(const SubCategory& categoryId) const
+    {
+        if (dataSets_.find(categoryId) == dataSets_.end())
+        {
+            std::ostringstream errStr;
+            errStr << "ERROR: Category called " << makeSubCategoryStr(categoryId);
+            errStr << " does not exist.";
+
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        // The fields of the spilled (and produced) sub categories are listed too.
+        std::vector<std::string> names;
+        for (const auto& dataPair : dataSets_.at(categoryId))
+        {
+            names.push_back(dataPair.first);
+        }
+
+        return names;
+    }
+
     size_t DataContainer::size(const SubCategory &categoryId) const
     {
         if (dataSets_.find(categoryId) == dataSets_.end())
@@ -116,7 +173,9 @@ namespace Ingester
             throw eckit::BadParameter(errStr.str());
         }
 
-        return  dataSets_.at(categoryId).begin()->second->getDims().at(0);
+        if (producer_) return producedRows_.at(categoryId);
+
+        return  dataSet(categoryId)->begin()->second->getDims().at(0);
     }
 
     std::vector<SubCategory> DataContainer::allSubCategories() const
@@ -131,6 +190,155 @@ namespace Ingester
         return allCategories;
     }
 
+    size_t DataContainer::byteSize(const SubCategory& categoryId) const
+    {
+        size_t bytes = 0;
+        for (const auto& dataPair : dataSets_.at(categoryId))
+        {
+            if (dataPair.second) bytes += dataPair.second->byteSize();
+        }
+
+        return bytes;
+    }
+
+    size_t DataContainer::byteSize() const
+    {
+        size_t bytes = 0;
+        for (const auto& dataSetPair : dataSets_)
+        {
+            bytes += byteSize(dataSetPair.first);
+        }
+
+        return bytes;
+    }
+
+    void DataContainer::limitMemory(size_t budget, const std::string& spillDir)
+    {
+        std::vector<std::pair<size_t, SubCategory>> categorySizes;
+        size_t totalBytes = 0;
+        for (const auto& dataSetPair : dataSets_)
+        {
+            const auto bytes = byteSize(dataSetPair.first);
+            categorySizes.push_back({bytes, dataSetPair.first});
+            totalBytes += bytes;
+        }
+
+        // Spill the largest sub categories first (the fewest files).
+        std::sort(categorySizes.begin(), categorySizes.end(),
+                  [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        for (const auto& categorySize : categorySizes)
+        {
+            if (totalBytes <= budget || categorySize.first == 0) break;
+
+            spill(categorySize.second, spillDir);
+            totalBytes -= categorySize.first;
+        }
+    }
+
+    void DataContainer::produceOnDemand(const std::vector<std::string>& fieldNames,
+                                        const std::map<SubCategory, size_t>& numRows,
+                                        CategoryProducer producer)
+    {
+        for (auto& dataSetPair : dataSets_)
+        {
+            if (!dataSetPair.second.empty())
+            {
+                std::ostringstream errStr;
+                errStr << "ERROR: The subcategory " << makeSubCategoryStr(dataSetPair.first);
+                errStr << " already has fields, they can't also be made on demand.";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            // The fields are listed (so hasKey works) but null until the sub category is made.
+            for (const auto& fieldName : fieldNames)
+            {
+                dataSetPair.second.insert({fieldName, nullptr});
+            }
+
+            producedRows_[dataSetPair.first] = numRows.at(dataSetPair.first);
+        }
+
+        producer_ = std::move(producer);
+    }
+
+    void DataContainer::spill(const SubCategory& categoryId, const std::string& spillDir)
+    {
+        auto& fields = dataSets_.at(categoryId);
+
+        BufrDataMap dataMap(fields.begin(), fields.end());
+        const auto buffer = BufrDataTransfer::pack(dataMap);
+
+        auto path = (spillDir.empty() ? std::string(".") : spillDir) + "/bufr2ioda_spill_XXXXXX";
+        const auto fd = mkstemp(&path[0]);
+        const bool written = (fd >= 0) &&
+                             (write(fd, buffer.data(), buffer.size()) ==
+                              static_cast<ssize_t>(buffer.size()));
+        if (fd >= 0) close(fd);
+
+        if (!written)
+        {
+            if (fd >= 0) std::remove(path.c_str());
+
+            std::ostringstream errStr;
+            errStr << "ERROR: Couldn't spill subcategory " << makeSubCategoryStr(categoryId);
+            errStr << " to " << spillDir << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        oops::Log::info() << "DataContainer: Spilled " << makeSubCategoryStr(categoryId) << " ("
+                          << buffer.size() / (1024 * 1024) << " MB) to " << path << std::endl;
+
+        spillFiles_.insert({categoryId, path});
+        for (auto& field : fields)
+        {
+            field.second.reset();
+        }
+    }
+
+    std::shared_ptr<const DataSetMap> DataContainer::dataSet(const SubCategory& categoryId) const
+    {
+        const auto spillFile = spillFiles_.find(categoryId);
+        if (spillFile == spillFiles_.end() && !producer_)
+        {
+            // Not owned (the map is kept by the container).
+            return std::shared_ptr<const DataSetMap>(std::shared_ptr<const DataSetMap>(),
+                                                     &dataSets_.at(categoryId));
+        }
+
+        std::lock_guard<std::mutex> lock(spillMutex_);
+        if (producer_ && (!loadedDataSet_ || loadedCategory_ != categoryId))
+        {
+            // Free the last one before making the next.
+            loadedDataSet_.reset();
+            loadedDataSet_ = std::make_shared<const DataSetMap>(producer_(categoryId));
+            loadedCategory_ = categoryId;
+        }
+        else if (!loadedDataSet_ || loadedCategory_ != categoryId)
+        {
+            // Free the last one before reading the next.
+            loadedDataSet_.reset();
+
+            std::ifstream file(spillFile->second, std::ios::binary);
+            if (!file)
+            {
+                std::ostringstream errStr;
+                errStr << "ERROR: Couldn't read back subcategory ";
+                errStr << makeSubCategoryStr(categoryId) << " from " << spillFile->second << ".";
+                throw eckit::BadValue(errStr.str());
+            }
+
+            const std::string buffer((std::istreambuf_iterator<char>(file)),
+                                     std::istreambuf_iterator<char>());
+
+            const auto dataMap = BufrDataTransfer::unpack(buffer);
+            loadedDataSet_ = std::make_shared<const DataSetMap>(dataMap.begin(), dataMap.end());
+            loadedCategory_ = categoryId;
+        }
+
+        return loadedDataSet_;
+    }
+
     void DataContainer::makeDataSets()
     {
         std::function<void(std::vector<size_t>&, const std::vector<size_t>&, size_t)> incIdx;
@@ -182,6 +390,35 @@ namespace Ingester
         }
     }
 
+    void DataContainer::exportArrow(ArrowSchema* schema,
+                                    ArrowArray* array,
+                                    const SubCategory& categoryId) const
+    {
+        if (dataSets_.find(categoryId) == dataSets_.end())
+        {
+            std::ostringstream errStr;
+            errStr << "ERROR: Category called " << makeSubCategoryStr(categoryId);
+            errStr << " does not exist.";
+
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const auto fieldMap = dataSet(categoryId);
+
+        std::vector<arrow::Column> fields;
+        for (const auto& dataPair : *fieldMap)
+        {
+            fields.push_back(dataPair.second->makeArrowColumn(dataPair.first));
+        }
+
+        const auto numRows = fieldMap->empty() ? 0 : static_cast<int64_t>(size(categoryId));
+        arrow::exportColumn(arrow::makeStruct(makeSubCategoryStr(categoryId),
+                                              numRows,
+                                              std::move(fields)),
+                            schema,
+                            array);
+    }
+
     std::string DataContainer::makeSubCategoryStr(const SubCategory &categoryId)
     {
         std::ostringstream catStr;
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
+#include <mutex>  // NOLINT
 #include <string>
 #include <vector>
 #include <memory>
@@ -35,6 +37,9 @@ namespace Ingester
     class DataContainer
     {
      public:
+        /// \brief Makes the fields of a sub category (see produceOnDemand).
+        typedef std::function<DataSetMap(const SubCategory&)> CategoryProducer;
+
         /// \brief Simple constructor
         DataContainer();
 
@@ -46,6 +51,12 @@ namespace Ingester
         ///        for the category type ex: {"GOES-15", "GOES-16", "GOES-17"}.
         explicit DataContainer(const CategoryMap& categoryMap);
 
+        /// \brief Destructor (removes the files of the spilled sub categories).
+        ~DataContainer();
+
+        DataContainer(const DataContainer&) = delete;
+        DataContainer& operator=(const DataContainer&) = delete;
+
         /// \brief Add a DataObject to the collection
         /// \param fieldName The unique (export) string that identifies this data
         /// \param data The DataObject to store
@@ -72,6 +83,10 @@ namespace Ingester
         bool hasKey(const std::string& fieldName,
                     const SubCategory& categoryId = {}) const;
 
+        /// \brief Get the names of the fields of the specified sub category
+        /// \param categoryId The vector<string> for the subcategory
+        std::vector<std::string> fieldNames(const SubCategory& categoryId = {}) const;
+
         /// \brief Get the number of rows of the specified sub category
         /// \param categoryId The vector<string> for the subcategory
         size_t size(const SubCategory& categoryId = {}) const;
@@ -79,6 +94,42 @@ namespace Ingester
         /// \brief Get the number of rows of the specified sub category
         std::vector<SubCategory> allSubCategories() const;
 
+        /// \brief Get the number of bytes of memory the fields of a sub category take (0 once
+        ///        it is spilled, see limitMemory).
+        /// \param categoryId The vector<string> for the subcategory
+        size_t byteSize(const SubCategory& categoryId) const;
+
+        /// \brief Get the number of bytes of memory the fields of all the sub categories take.
+        size_t byteSize() const;
+
+        /// \brief Keep the fields under a memory budget. The largest sub categories are spilled
+        ///        to temporary files (one column per field) until the others fit in the budget.
+        ///        Spilled sub categories are read back one at a time when their fields are
+        ///        needed (ex: while they are encoded). Call this once all the fields are added.
+        /// \param budget The number of bytes the fields can take.
+        /// \param spillDir The directory for the temporary files.
+        void limitMemory(size_t budget, const std::string& spillDir);
+
+        /// \brief Make the fields of the sub categories only when they are needed instead of
+        ///        holding all of them. The fields of one sub category are kept at a time (the
+        ///        last one that was asked for), so going through the sub categories in order
+        ///        (ex: while they are encoded) makes each of them once. Call this instead of add.
+        /// \param fieldNames The names of the fields every sub category has.
+        /// \param numRows The number of rows of each sub category (see size).
+        /// \param producer Makes the fields of a sub category.
+        void produceOnDemand(const std::vector<std::string>& fieldNames,
+                             const std::map<SubCategory, size_t>& numRows,
+                             CategoryProducer producer);
+
+        /// \brief Export the variables of a sub category through the Arrow C data interface, as
+        ///        a struct array with one field per variable (see DataObjectBase::exportArrow).
+        /// \param schema The (uninitialized) schema structure to fill.
+        /// \param array The (uninitialized) array structure to fill.
+        /// \param categoryId The vector<string> for the subcategory
+        void exportArrow(ArrowSchema* schema,
+                         ArrowArray* array,
+                         const SubCategory& categoryId = {}) const;
+
         /// \brief Get the map of categories
         inline CategoryMap getCategoryMap() const { return categoryMap_; }
 
@@ -86,9 +137,32 @@ namespace Ingester
         /// Category map given (see constructor).
         const CategoryMap categoryMap_;
 
-        /// Map of data for each possible subcategory
+        /// Map of data for each possible subcategory (the fields of the spilled sub categories
+        /// are null).
         DataSets dataSets_;
 
+        /// The files of the spilled sub categories.
+        std::map<SubCategory, std::string> spillFiles_;
+
+        /// Makes the fields of the sub categories (see produceOnDemand) and their rows.
+        CategoryProducer producer_;
+        std::map<SubCategory, size_t> producedRows_;
+
+        /// The spilled (or produced) sub category that was read back (or made) last.
+        mutable SubCategory loadedCategory_;
+        mutable std::shared_ptr<const DataSetMap> loadedDataSet_;
+        mutable std::mutex spillMutex_;
+
+        /// \brief Get the fields of a sub category (reads them back if it was spilled, makes
+        ///        them if they are produced on demand).
+        /// \param categoryId The vector<string> for the subcategory
+        std::shared_ptr<const DataSetMap> dataSet(const SubCategory& categoryId) const;
+
+        /// \brief Write the fields of a sub category to a temporary file and free them.
+        /// \param categoryId The vector<string> for the subcategory
+        /// \param spillDir The directory for the file.
+        void spill(const SubCategory& categoryId, const std::string& spillDir);
+
         /// \brief Uses category map to generate listings of all possible subcategories.
         void makeDataSets();
 
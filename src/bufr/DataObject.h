@@ -8,20 +8,30 @@
 #pragma once
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <string>
 #include <memory>
 #include <type_traits>
+#include <unordered_map>
 #include <iostream>
 #include <numeric>
 #include <limits>
+#include <mutex>  // NOLINT
 #include <math.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 
 #include "eckit/exception/Exceptions.h"
+#include <gsl/gsl-lite.hpp>
 
 #ifdef BUILD_IODA_BINDING
     #include "ioda/ObsGroup.h"
     #include "ioda/defs.h"
+
+    #include "IodaEncoder/ChunkWriter.h"
 #endif
 
 #ifdef BUILD_PYTHON_BINDING
@@ -33,15 +43,43 @@
 #endif
 
 
+#include "ArrowExport.h"
+#include "BufrParser/Query/BufferPool.h"
 #include "BufrParser/Query/Constants.h"
 #include "BufrParser/Query/QueryParser.h"
 #include "BufrParser/Query/Data.h"
+#include "BufrParser/Query/Validity.h"
 
 namespace Ingester
 {
     typedef std::vector<int> Dimensions;
     typedef Dimensions Location;
 
+    /// \brief The rows of buffers made while slicing fields that are slices themselves, by the
+    ///        rows the fields were sliced by (see DataObjectBase::slice).
+    typedef std::map<const std::vector<std::size_t>*,
+                     std::shared_ptr<const std::vector<std::size_t>>> SliceCache;
+
+    /// \brief How the values of a variable are compressed in the output file.
+    struct Compression
+    {
+        enum class Codec
+        {
+            None,
+            Gzip,
+            Szip
+        };
+
+        Codec codec = Codec::Gzip;
+        int level = 6;  // GZip compression level (0-9)
+        int significantBits = 0;  // Mantissa bits kept in floating point values (0 keeps all)
+
+        /// \brief Width of the fixed-length strings of string variables (0 writes variable length
+        ///        strings, AutoStringLength the width of the longest value).
+        int stringLength = 0;
+        static constexpr int AutoStringLength = -1;
+    };
+
 #ifdef BUILD_IODA_BINDING
     struct DimensionDataBase
     {
@@ -88,7 +126,7 @@ namespace Ingester
 
     /// \brief Abstract base class for intermediate data object that bridges the Parsers with the
     /// IodaEncoder.
-    class DataObjectBase
+    class DataObjectBase : public std::enable_shared_from_this<DataObjectBase>
     {
      public:
         explicit DataObjectBase(const std::string& fieldName,
@@ -124,12 +162,29 @@ namespace Ingester
         std::vector<bufr::Query> getDimPaths() const { return dimPaths_; }
 
 #ifdef BUILD_PYTHON_BINDING
-       /// \brief Return a numpy array of the data.
+       /// \brief Return a numpy array of the data. For numeric data owned by a std::shared_ptr
+       ///        the array shares the data buffer of this object (no copy) and keeps the object
+       ///        alive.
        virtual py::array getNumpyArray() const = 0;
 #endif
 
         bool hasSamePath(const std::shared_ptr<DataObjectBase>& dataObject);
 
+        /// \brief Make an Arrow column of the data. There is one row per element of the first
+        ///        dimension, the other dimensions become nested fixed size lists (items named
+        ///        after the dimension paths). Missing values are null and strings are dictionary
+        ///        encoded. Numeric data owned by a std::shared_ptr is shared, not copied.
+        /// \param name The name to give the column.
+        virtual arrow::Column makeArrowColumn(const std::string& name) const = 0;
+
+        /// \brief Export the data through the Arrow C data interface (see makeArrowColumn).
+        /// \param schema The (uninitialized) schema structure to fill.
+        /// \param array The (uninitialized) array structure to fill.
+        void exportArrow(ArrowSchema* schema, ArrowArray* array) const
+        {
+            arrow::exportColumn(makeArrowColumn(fieldName_), schema, array);
+        }
+
         /// \brief Print the data object to a output stream.
         virtual void print(std::ostream &out) const = 0;
 
@@ -157,6 +212,32 @@ namespace Ingester
         /// \return bool data.
         virtual bool isMissing(size_t idx) const = 0;
 
+        /// \brief Set which values are there (made when the field was assembled, see
+        ///        bufr::Validity), so the missing values are found without comparing every value
+        ///        with the missing value. It is kept by the slices of this object and dropped
+        ///        when the values are replaced (or changed in ways that can make them missing).
+        /// \param validity The validity of the values (null to drop it).
+        void setValidity(std::shared_ptr<const bufr::Validity> validity)
+        {
+            if (validity && validity->size() != size())
+            {
+                std::ostringstream errStr;
+                errStr << "Field " << fieldName_ << " has " << size() << " values but its ";
+                errStr << "validity has " << validity->size() << ".";
+                throw eckit::BadParameter(errStr.str());
+            }
+
+            validity_ = std::move(validity);
+        }
+
+        /// \brief Does this object know which values are there (see setValidity).
+        bool hasValidity() const { return validity_ != nullptr; }
+
+        /// \brief Get which values are there, in order (from the validity that was set if there
+        ///        is one, otherwise by comparing the values with the missing value).
+        /// \return The validity.
+        virtual bufr::Validity validity() const = 0;
+
         /// \brief Get the data at the Location as an string.
         /// \return String data.
         virtual std::string getAsString(const Location& loc) const = 0;
@@ -169,19 +250,42 @@ namespace Ingester
         /// \return Data size.
         virtual size_t size() const = 0;
 
+        /// \brief Get the number of bytes an element takes in a file (the pointer for variable
+        ///        length strings).
+        /// \return Element size.
+        virtual size_t elementSize() const = 0;
+
+        /// \brief Get the number of bytes of memory the values take. A slice counts the values
+        ///        it has (not the whole buffer it shares), its rows and the copy of its values.
+        /// \return Memory size.
+        virtual size_t byteSize() const = 0;
+
+        /// \brief Keep integer values in 1 or 2 bytes each if the BUFR field they come from has
+        ///        at most 16 bits and they fit (see DataObject::packIntegers).
+        /// \param bits The number of bits of the BUFR field.
+        virtual void packIntegers(int bits) = 0;
+
 #ifdef BUILD_IODA_BINDING
         /// \brief Makes an ioda::Variable and adds it to the given ioda::ObsGroup
         /// \param obsGroup Obsgroup where to add the variable
         /// \param name The name to associate with the variable (ex "latitude@MetaData")
         /// \param dimensions List of Variables to use as the dimensions for this new variable
         /// \param chunks List of integers specifying the chunking dimensions
-        /// \param compressionLevel The GZip compression level to use, must be 0-9
+        /// \param compression How to compress the values
+        /// \param chunkWriter (Optional) Writes the chunks of gzip variables compressed in
+        ///        parallel (see ChunkWriter)
         virtual ioda::Variable createVariable(
                                       ioda::ObsGroup& obsGroup,
                                       const std::string& name,
                                       const std::vector<ioda::Variable>& dimensions,
                                       const std::vector<ioda::Dimensions_t>& chunks,
-                                      int compressionLevel) const = 0;
+                                      const Compression& compression,
+                                      const ChunkWriter* chunkWriter = nullptr) const = 0;
+
+        /// \brief Write the data into rows of an existing ioda::Variable (ex: after it grew)
+        /// \param var The variable (its dimensions past the first must be the data's)
+        /// \param rowOffset The first row to write
+        virtual void writeRows(ioda::Variable& var, std::size_t rowOffset) const = 0;
 
         /// \brief Makes a new dimension scale using this data object as the source
         /// \param name The name of the dimension variable.
@@ -201,8 +305,37 @@ namespace Ingester
         /// \brief Slice the data object given a vector of row indices.
         /// \param slice The indices to slice.
         /// \return Slice of the data object.
+        std::shared_ptr<DataObjectBase> slice(const std::vector<std::size_t>& rows) const
+        {
+            return slice(std::make_shared<const std::vector<std::size_t>>(rows));
+        }
+
+        /// \brief Slice the data object given shared row indices (see the next overload).
+        /// \param slice The indices to slice.
+        /// \return Slice of the data object.
+        std::shared_ptr<DataObjectBase>
+            slice(const std::shared_ptr<const std::vector<std::size_t>>& rows) const
+        {
+            SliceCache cache;
+            return slice(rows, cache);
+        }
+
+        /// \brief Slice the data object given shared row indices (ex: the rows of a category
+        ///        that every field of a BufrDataMap is sliced by). The slices of the fields that
+        ///        aren't slices themselves all share the indices instead of copying them, and
+        ///        so do the slices of the fields that are slices of the same rows (the rows are
+        ///        only combined once, through the cache).
+        /// \param slice The indices to slice.
+        /// \param cache The rows combined so far for these indices (only use a cache with one
+        ///        list of indices).
+        /// \return Slice of the data object.
         virtual std::shared_ptr<DataObjectBase>
-            slice(const std::vector<std::size_t>& rows) const = 0;
+            slice(const std::shared_ptr<const std::vector<std::size_t>>& rows,
+                  SliceCache& cache) const = 0;
+
+        /// \brief Free the copy a slice made of its values the last time they were needed all
+        ///        together (ex: once the slice was written). They are copied again if needed.
+        virtual void releaseValues() const = 0;
 
         /// \brief Multiply the stored values in this data object by a scalar.
         /// \param val Scalar to multiply to the data..
@@ -212,12 +345,43 @@ namespace Ingester
         /// \param val Scalar to add to the data..
         virtual void offsetBy(double val) = 0;
 
+        /// \brief Replace the stored (non missing) values with a function of them. The function
+        ///        is called on blocks of the values converted to double. Results that aren't
+        ///        finite become missing.
+        /// \param func Function that modifies count values in place.
+        virtual void mapValues(const std::function<void(double* values, size_t count)>& func) = 0;
+
+        /// \brief Get the values without copying them. The stored type must be T.
+        /// \return The values.
+        template<typename T>
+        gsl::span<const T> asSpan() const;
+
+        /// \brief Copy the values into a vector of another type (one virtual call for all of
+        ///        them). Missing values become the missing value of T.
+        /// \param dst The vector to fill (resized to the number of values).
+        template<typename T>
+        void copyAs(std::vector<T>& dst) const { copyValues(dst); }
+
+        /// \brief Copy the values into a vector of another type (see copyAs).
+        /// \param dst The vector to fill.
+        virtual void copyValues(std::vector<float>& dst) const = 0;
+        virtual void copyValues(std::vector<double>& dst) const = 0;
+        virtual void copyValues(std::vector<int32_t>& dst) const = 0;
+        virtual void copyValues(std::vector<uint32_t>& dst) const = 0;
+        virtual void copyValues(std::vector<int64_t>& dst) const = 0;
+        virtual void copyValues(std::vector<uint64_t>& dst) const = 0;
+        virtual void copyValues(std::vector<std::string>& dst) const = 0;
+
      protected:
         std::string fieldName_;
         std::string groupByFieldName_;
         Dimensions dims_;
         std::string query_;
         std::vector<bufr::Query> dimPaths_;
+
+        /// \brief Which values are there (null if unknown). Indexed like the stored values, so
+        ///        the slices of an object share it.
+        std::shared_ptr<const bufr::Validity> validity_;
     };
 
 
@@ -252,8 +416,23 @@ namespace Ingester
                    const std::string& query,
                    const std::vector<bufr::Query>& dimPaths) :
             DataObjectBase(field_name, group_by_field_name, dimensions, query, dimPaths),
-            data_(data)
-        {};
+            buffer_(bufr::BufferPool::share(std::vector<T>(data)))
+        {
+            _encodeDictionary();
+        };
+
+        /// \brief Constructor that takes the values over (they aren't copied).
+        DataObject(std::vector<T>&& data,
+                   const std::string& field_name,
+                   const std::string& group_by_field_name,
+                   const Dimensions& dimensions,
+                   const std::string& query,
+                   const std::vector<bufr::Query>& dimPaths) :
+            DataObjectBase(field_name, group_by_field_name, dimensions, query, dimPaths),
+            buffer_(bufr::BufferPool::share(std::move(data)))
+        {
+            _encodeDictionary();
+        };
 
         virtual ~DataObject() = default;
 
@@ -275,19 +454,31 @@ namespace Ingester
         py::array _getNumpyArray(
             typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
         {
-            // Create the data array
-            py::array_t<T> data(dims_);
-            T* dataPtr = static_cast<T*>(data.mutable_data());
-            std::copy(data_.begin(), data_.end(), dataPtr);
+            // Create the data array. Wrap our own buffer if we can keep this object alive for as
+            // long as the array exists (a capsule holding a reference to it is used as the base
+            // of the array). Otherwise copy the data.
+            py::array_t<T> data;
+            if (auto self = std::const_pointer_cast<DataObjectBase>(weak_from_this().lock()))
+            {
+                auto owner = new std::shared_ptr<DataObjectBase>(std::move(self));
+                py::capsule base(owner, [](void* ptr)
+                {
+                    delete static_cast<std::shared_ptr<DataObjectBase>*>(ptr);
+                });
 
-            // Create the mask array
-            py::array_t<bool> mask(dims_);
-            bool* maskPtr = static_cast<bool*>(mask.mutable_data());
-            for (size_t idx = 0; idx < data_.size(); idx++)
+                data = py::array_t<T>(dims_, values().data(), base);
+            }
+            else
             {
-                maskPtr[idx] = isMissing(idx);
+                data = py::array_t<T>(dims_);
+                T* dataPtr = static_cast<T*>(data.mutable_data());
+                std::copy(values().begin(), values().end(), dataPtr);
             }
 
+            // Create the mask array
+            py::array_t<bool> mask(dims_);
+            _fillMask(static_cast<bool*>(mask.mutable_data()));
+
             // Create a masked array from the data and mask arrays
             py::object numpyModule = py::module::import("numpy");
             py::array maskedArray = numpyModule.attr("ma").attr("masked_array")(data, mask);
@@ -300,12 +491,13 @@ namespace Ingester
         py::array _getNumpyArray(
             typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr) const
         {
-            py::list pyStrList(data_.size());
+            const auto& dataValues = values();
+            py::list pyStrList(dataValues.size());
 
             // Convert the std::vector<std::string> into a list of Python Unicode strings
-            for (size_t i = 0; i < data_.size(); ++i)
+            for (size_t i = 0; i < dataValues.size(); ++i)
             {
-                pyStrList[i] = py::str(data_[i]);
+                pyStrList[i] = py::str(dataValues[i]);
             }
 
             // Create a NumPy array of Python Unicode strings with the correct dimensions
@@ -315,11 +507,7 @@ namespace Ingester
 
             // Create the mask array
             py::array_t<bool> mask(dims_);
-            bool* maskPtr = static_cast<bool*>(mask.mutable_data());
-            for (size_t idx = 0; idx < data_.size(); idx++)
-            {
-                maskPtr[idx] = isMissing(idx);
-            }
+            _fillMask(static_cast<bool*>(mask.mutable_data()));
 
             // Create a masked array from the data and mask arrays
             py::array maskedArray = numpyModule.attr("ma").attr("masked_array")(data, mask);
@@ -327,27 +515,112 @@ namespace Ingester
 
             return maskedArray;
         }
+
+        /// \brief Fill the mask of a numpy masked array (true for the missing values).
+        /// \param mask The mask (size() elements).
+        void _fillMask(bool* mask) const
+        {
+            const auto numValues = size();
+            if (validity_)
+            {
+                for (size_t idx = 0; idx < numValues; idx++)
+                {
+                    mask[idx] = !validity_->isValid(_position(idx));
+                }
+
+                return;
+            }
+
+            const T missing = missingValue();
+            const auto& dataValues = values();
+            for (size_t idx = 0; idx < numValues; idx++)
+            {
+                mask[idx] = (dataValues[idx] == missing);
+            }
+        }
 #endif
 
+        /// \brief Make an Arrow column of the data.
+        /// \param name The name to give the column.
+        arrow::Column makeArrowColumn(const std::string& name) const final
+        {
+            std::vector<std::string> dimNames;
+            for (const auto& dimPath : dimPaths_)
+            {
+                dimNames.push_back(dimPath.str());
+            }
+
+            auto dims = dims_;
+            if (dims.empty()) dims = {static_cast<int>(size())};
+
+            return arrow::nestDims(_makeArrowValues(name), dims, dimNames);
+        }
+
 #ifdef BUILD_IODA_BINDING
         /// \brief Makes an ioda::Variable and adds it to the given ioda::ObsGroup
         /// \param obsGroup Obsgroup were to add the variable
         /// \param name The name to associate with the variable (ex "latitude@MetaData")
         /// \param dimensions List of Variables to use as the dimensions for this new variable
         /// \param chunks List of integers specifying the chunking dimensions
-        /// \param compressionLevel The GZip compression level to use, must be 0-9
+        /// \param compression How to compress the values
+        /// \param chunkWriter (Optional) Writes the chunks of gzip variables compressed in
+        ///        parallel (see ChunkWriter)
         ioda::Variable createVariable(ioda::ObsGroup& obsGroup,
                                       const std::string& name,
                                       const std::vector<ioda::Variable>& dimensions,
                                       const std::vector<ioda::Dimensions_t>& chunks,
-                                      int compressionLevel) const final
+                                      const Compression& compression,
+                                      const ChunkWriter* chunkWriter = nullptr) const final
         {
-            auto params = makeCreationParams(chunks, compressionLevel);
+            if (compression.stringLength != 0)
+            {
+                return _createFixedStringVariable(obsGroup, name, dimensions, chunks,
+                                                  compression, chunkWriter);
+            }
+
+            auto params = makeCreationParams(chunks, compression);
             auto var = obsGroup.vars.createWithScales<T>(name, dimensions, params);
-            var.write(data_);
+
+            std::vector<T> quantized;
+            const std::vector<T>* data = &values();
+            if (compression.significantBits > 0 && std::is_floating_point<T>::value)
+            {
+                quantized = _quantized(compression.significantBits);
+                data = &quantized;
+            }
+
+            // The variables the chunk writer can't write (other filters ...) go through ioda.
+            if (chunkWriter == nullptr ||
+                compression.codec != Compression::Codec::Gzip ||
+                !_writeChunks(*chunkWriter, name, *data))
+            {
+                var.write(*data);
+            }
+
             return var;
         };
 
+        /// \brief Write the data into rows of an existing ioda::Variable (ex: after it grew)
+        /// \param var The variable (its dimensions past the first must be the data's)
+        /// \param rowOffset The first row to write
+        void writeRows(ioda::Variable& var, std::size_t rowOffset) const final
+        {
+            const auto varDims = var.getDimensions().dimsCur;
+
+            std::vector<ioda::Dimensions_t> count(dims_.begin(), dims_.end());
+            if (count.empty()) count = {static_cast<ioda::Dimensions_t>(size())};
+
+            std::vector<ioda::Dimensions_t> start(count.size(), 0);
+            ioda::Selection memSelection;
+            memSelection.extent(count).select({ioda::SelectionOperator::SET, start, count});
+
+            start[0] = static_cast<ioda::Dimensions_t>(rowOffset);
+            ioda::Selection fileSelection;
+            fileSelection.extent(varDims).select({ioda::SelectionOperator::SET, start, count});
+
+            var.write(values(), memSelection, fileSelection);
+        }
+
         /// \brief Makes a new dimension scale using this data object as the source
         /// \param name The name of the dimension variable.
         /// \param dimIdx The idx of the data dimension to use.
@@ -357,17 +630,18 @@ namespace Ingester
             auto dimData = std::make_shared<DimensionData<T>>(getDims()[dimIdx]);
             dimData->dimScale = ioda::NewDimensionScale<T>(name, getDims()[dimIdx]);
 
-            std::copy(data_.begin(),
-                      data_.begin() + dimData->data.size(),
+            const auto& dataValues = values();
+            std::copy(dataValues.begin(),
+                      dataValues.begin() + dimData->data.size(),
                       dimData->data.begin());
 
             // Validate this data object is a valid (has values that repeat for each frame
-            for (size_t idx = 0; idx < data_.size(); idx += dimData->data.size())
+            for (size_t idx = 0; idx < dataValues.size(); idx += dimData->data.size())
             {
-                if (!std::equal(data_.begin(),
-                                data_.begin() + dimData->data.size(),
-                                data_.begin() + idx,
-                                data_.begin() + idx + dimData->data.size()))
+                if (!std::equal(dataValues.begin(),
+                                dataValues.begin() + dimData->data.size(),
+                                dataValues.begin() + idx,
+                                dataValues.begin() + idx + dimData->data.size()))
                 {
                     std::stringstream errStr;
                     errStr << "Dimension " << name << " has an invalid source field. ";
@@ -395,9 +669,10 @@ namespace Ingester
         void print(std::ostream &out) const final
         {
             out << "DataObject " << fieldName_ << ":";
-            for (auto val = data_.cbegin(); val != data_.cend(); ++val)
+            const auto& dataValues = values();
+            for (auto val = dataValues.cbegin(); val != dataValues.cend(); ++val)
             {
-                if (val != data_.cbegin()) out << ", ";
+                if (val != dataValues.cbegin()) out << ", ";
                 out << *val;
             }
 
@@ -405,36 +680,169 @@ namespace Ingester
         };
 
         /// \brief Get the raw data.
-        std::vector<T> getRawData() const { return data_; }
+        const std::vector<T>& getRawData() const { return values(); }
+
+        /// \brief Set the raw data (pass an rvalue to hand the values over without a copy).
+        void setRawData(std::vector<T> data) { resetValues(std::move(data)); }
+
+        /// \brief An N-d view of the values with the strides of the dimensions computed once (use
+        ///        it instead of get(Location) in loops over the data). The rows are spans of the
+        ///        buffer the values are kept in, so the values of a slice aren't copied (the ones
+        ///        of dictionary encoded strings are). The view keeps the values alive but doesn't
+        ///        see later changes to the DataObject.
+        class View
+        {
+         public:
+            /// \brief Iterator over the rows (spans) of a View.
+            class RowIterator
+            {
+             public:
+                RowIterator(const View& view, size_t rowIdx) : view_(view), rowIdx_(rowIdx) {}
+
+                gsl::span<const T> operator*() const { return view_.row(rowIdx_); }
+                RowIterator& operator++() { ++rowIdx_; return *this; }
+                bool operator!=(const RowIterator& other) const { return rowIdx_ != other.rowIdx_; }
+
+             private:
+                const View& view_;
+                size_t rowIdx_;
+            };
+
+            explicit View(const DataObject<T>& dataObject) :
+                buffer_((dataObject.codes_ || dataObject.packed_) ?
+                        std::make_shared<const std::vector<T>>(dataObject.values()) :
+                        dataObject.buffer_),
+                rows_((dataObject.codes_ || dataObject.packed_) ? nullptr : dataObject.rows_),
+                numRows_(dataObject.dims_.empty() ? dataObject.size() : dataObject.dims_[0]),
+                strides_(dataObject.dims_.size() > 1 ? dataObject.dims_.size() - 1 : 0, 1)
+            {
+                for (size_t dimIdx = dataObject.dims_.size(); dimIdx-- > 1;)
+                {
+                    rowSize_ *= dataObject.dims_[dimIdx];
+                    if (dimIdx > 1) strides_[dimIdx - 2] = rowSize_;
+                }
+            }
+
+            /// \brief The number of rows (the size of the first dimension).
+            size_t numRows() const { return numRows_; }
+
+            /// \brief The number of values in a row.
+            size_t rowSize() const { return rowSize_; }
+
+            /// \brief Get the values of a row.
+            /// \param rowIdx The index of the row.
+            gsl::span<const T> row(size_t rowIdx) const
+            {
+                const auto bufferRow = rows_ ? (*rows_)[rowIdx] : rowIdx;
+                return gsl::span<const T>(buffer_->data() + bufferRow * rowSize_, rowSize_);
+            }
+
+            /// \brief Get the value at a location (ex: at(2, 4) for 2d data).
+            /// \param rowIdx The index along the first dimension.
+            /// \param idxs The indices along the next dimensions (the ones left out are 0).
+            template<typename... Idxs>
+            const T& at(size_t rowIdx, Idxs... idxs) const
+            {
+                const size_t rowIdxs[sizeof...(Idxs) + 1] = {static_cast<size_t>(idxs)..., 0};
 
-        /// \brief Set the raw data.
-        void setRawData(std::vector<T> data) { data_ = data; }
+                size_t offset = 0;
+                for (size_t dimIdx = 0; dimIdx < sizeof...(Idxs); ++dimIdx)
+                {
+                    offset += rowIdxs[dimIdx] * strides_[dimIdx];
+                }
+
+                return row(rowIdx)[offset];
+            }
+
+            RowIterator begin() const { return RowIterator(*this, 0); }
+            RowIterator end() const { return RowIterator(*this, numRows_); }
+
+         private:
+            const std::shared_ptr<const std::vector<T>> buffer_;
+            const std::shared_ptr<const std::vector<std::size_t>> rows_;
+            const size_t numRows_;
+            size_t rowSize_ = 1;
+
+            /// \brief The number of values between consecutive indices of the dimensions after
+            ///        the first one.
+            std::vector<size_t> strides_;
+        };
+
+        /// \brief Get an N-d view of the values (see View).
+        View view() const { return View(*this); }
 
         /// \brief Get data associated with a given location.
         /// \param location The location to get data for.
         /// \return The data at the given location.
         T get(const Location& loc) const
         {
-            size_t dim_prod = 1;
-            for (int dim_idx = dims_.size(); dim_idx > static_cast<int>(loc.size()); --dim_idx)
+            return valueAt(_indexOf(loc));
+        };
+
+        /// \brief Get the size of the data.
+        /// \return The size of the data.
+        size_t size() const
+        {
+            if (rows_) return rows_->size() * rowSize_;
+            if (packed_) return packed_->size() / packedWidth_;
+            return codes_ ? codes_->size() : buffer_->size();
+        }
+
+        /// \brief Are the values packed (see packIntegers).
+        bool isPacked() const { return packed_ != nullptr; }
+
+        /// \brief Keep the values in 1 or 2 bytes each (offsets from the smallest one) if the
+        ///        BUFR field they come from has at most 16 bits and they fit (integers only).
+        ///        They are widened when they are needed all together (ex: when written).
+        /// \param bits The number of bits of the BUFR field.
+        void packIntegers(int bits) final { _packIntegers(bits); }
+
+        /// \brief Is the data dictionary encoded (see codes_).
+        bool isDictionaryEncoded() const { return codes_ != nullptr; }
+
+        /// \brief Get the number of bytes an element takes in a file (the pointer for variable
+        ///        length strings).
+        /// \return Element size.
+        size_t elementSize() const final
+        {
+            return std::is_same<T, std::string>::value ? sizeof(char*) : sizeof(T);
+        }
+
+        /// \brief Get the number of bytes of memory the values take (see
+        ///        DataObjectBase::byteSize).
+        /// \return Memory size.
+        size_t byteSize() const final
+        {
+            if (packed_)
             {
-                dim_prod *= dims_[dim_idx];
+                std::lock_guard<std::mutex> lock(materializeMutex_);
+                return packed_->size() +
+                       (rows_ ? rows_->size() * sizeof(std::size_t) : 0) +
+                       (isMaterialized_ ? materialized_.size() * sizeof(T) : 0);
             }
 
-            // Compute the index into the data array
-            size_t index = 0;
-            for (int dim_idx = loc.size() - 1; dim_idx >= 0; --dim_idx)
+            if (codes_)
             {
-                index += dim_prod*loc[dim_idx];
-                dim_prod *= dims_[dim_idx];
+                std::lock_guard<std::mutex> lock(materializeMutex_);
+                return codes_->size() * sizeof(int32_t) +
+                       (rows_ ? rows_->size() * sizeof(std::size_t) : 0) +
+                       _byteSize(buffer_->begin(), buffer_->end()) +
+                       (isMaterialized_ ? _byteSize(materialized_.begin(), materialized_.end())
+                                        : 0);
             }
 
-            return data_[index];
-        };
+            if (!rows_) return _byteSize(buffer_->begin(), buffer_->end());
 
-        /// \brief Get the size of the data.
-        /// \return The size of the data.
-        size_t size() const { return data_.size(); }
+            size_t valueBytes = 0;
+            for (const auto row : *rows_)
+            {
+                valueBytes += _byteSize(buffer_->begin() + row * rowSize_,
+                                        buffer_->begin() + (row + 1) * rowSize_);
+            }
+
+            std::lock_guard<std::mutex> lock(materializeMutex_);
+            return rows_->size() * sizeof(std::size_t) + (isMaterialized_ ? 2 : 1) * valueBytes;
+        }
 
         /// \brief Get the data at the location as an integer.
         /// \param loc The coordinate for the data point (ex: if data 2d then loc {2,4} gets data
@@ -460,7 +868,7 @@ namespace Ingester
         /// \return bool data.
         bool isMissing(const Location& loc) const final
         {
-            return get(loc) == missingValue();
+            return isMissing(_indexOf(loc));
         }
 
         /// \brief Get the data at the index into the internal 1d array as a int. This function
@@ -492,15 +900,53 @@ namespace Ingester
         /// \return bool data.
         bool isMissing(const size_t idx) const final
         {
-            return data_[idx] == missingValue();
+            if (validity_) return !validity_->isValid(_position(idx));
+            return valueAt(idx) == missingValue();
+        }
+
+        /// \brief Get which values are there (see DataObjectBase::validity).
+        /// \return The validity.
+        bufr::Validity validity() const final
+        {
+            if (validity_ && !rows_) return *validity_;
+
+            if (validity_)
+            {
+                return bufr::Validity::make(size(), [this](size_t idx)
+                {
+                    return validity_->isValid(_position(idx));
+                });
+            }
+
+            return bufr::Validity::make(size(), [this](size_t idx)
+            {
+                return !(valueAt(idx) == missingValue());
+            });
         }
 
 
-        /// \brief Slice the dta object according to a list of indices.
-        /// \param rows The indices to slice the data object by.
+        /// \brief Copy the values into a vector of another type (see DataObjectBase::copyAs).
+        /// \param dst The vector to fill.
+        void copyValues(std::vector<float>& dst) const final { _copyValues(dst); }
+        void copyValues(std::vector<double>& dst) const final { _copyValues(dst); }
+        void copyValues(std::vector<int32_t>& dst) const final { _copyValues(dst); }
+        void copyValues(std::vector<uint32_t>& dst) const final { _copyValues(dst); }
+        void copyValues(std::vector<int64_t>& dst) const final { _copyValues(dst); }
+        void copyValues(std::vector<uint64_t>& dst) const final { _copyValues(dst); }
+        void copyValues(std::vector<std::string>& dst) const final { _copyValues(dst); }
+
+        /// \brief Slice the dta object according to a list of indices. The slice is a view that
+        ///        shares the values of this object (they are only copied when the slice needs
+        ///        them all together, ex: to write them, or when either object is changed).
+        /// \param sliceRows The indices to slice the data object by.
         /// \return Sliced DataObject.
-        std::shared_ptr<DataObjectBase> slice(const std::vector<std::size_t>& rows) const final
+        using DataObjectBase::slice;
+        std::shared_ptr<DataObjectBase>
+            slice(const std::shared_ptr<const std::vector<std::size_t>>& sliceRows,
+                  SliceCache& cache) const final
         {
+            const auto& rows = *sliceRows;
+
             // Compute product of extra dimensions)
             std::size_t extraDims = 1;
             for (std::size_t i = 1; i < dims_.size(); ++i)
@@ -508,57 +954,523 @@ namespace Ingester
                 extraDims *= dims_[i];
             }
 
-            // Make new DataObject with the rows we want
-            std::vector<T> newData;
-            newData.reserve(rows.size() * extraDims);
-            for (std::size_t i = 0; i < rows.size(); ++i)
+            auto sliceDims = dims_;
+            sliceDims[0] = rows.size();
+
+            auto sliced = std::make_shared<DataObject<T>>();
+            sliced->fieldName_ = fieldName_;
+            sliced->groupByFieldName_ = groupByFieldName_;
+            sliced->dims_ = sliceDims;
+            sliced->query_ = query_;
+            sliced->dimPaths_ = dimPaths_;
+            sliced->buffer_ = buffer_;
+            sliced->codes_ = codes_;
+            sliced->packed_ = packed_;
+            sliced->packedBase_ = packedBase_;
+            sliced->packedWidth_ = packedWidth_;
+            sliced->validity_ = validity_;
+            sliced->rowSize_ = extraDims;
+
+            // Keeping every row in order shares the rows of this object.
+            const size_t numRows = (extraDims > 0) ? size() / extraDims : 0;
+            bool allRows = (rows.size() == numRows);
+            for (std::size_t i = 0; allRows && i < rows.size(); ++i)
             {
-                newData.insert(newData.end(),
-                               data_.begin() + rows[i] * extraDims,
-                               data_.begin() + (rows[i] + 1) * extraDims);
+                allRows = (rows[i] == i);
             }
 
-            auto sliceDims = dims_;
-            sliceDims[0] = rows.size();
+            if (allRows)
+            {
+                sliced->rows_ = rows_;
+            }
+            else
+            {
+                // Rows of a view are rows of the buffer it shares.
+                if (rows_)
+                {
+                    auto& bufferRows = cache[rows_.get()];
+                    if (!bufferRows)
+                    {
+                        auto newRows = std::make_shared<std::vector<std::size_t>>(rows);
+                        for (auto& row : *newRows) row = (*rows_)[row];
+                        bufferRows = newRows;
+                    }
 
-            return std::make_shared<DataObject<T>>(newData,
-                                                   fieldName_,
-                                                   groupByFieldName_,
-                                                   sliceDims,
-                                                   query_,
-                                                   dimPaths_);
+                    sliced->rows_ = bufferRows;
+                }
+                else
+                {
+                    sliced->rows_ = sliceRows;
+                }
+            }
+
+            return sliced;
+        }
+
+        /// \brief Free the copy a slice made of its values (see DataObjectBase::releaseValues).
+        void releaseValues() const final
+        {
+            std::lock_guard<std::mutex> lock(materializeMutex_);
+            materialized_ = std::vector<T>();
+            isMaterialized_ = false;
         }
 
      private:
-        std::vector<T> data_;
+        /// \brief Strings are dictionary encoded when there are at least this many values and
+        ///        at most one distinct value for every DictionaryRatio of them.
+        static constexpr size_t MinDictionaryValues = 256;
+        static constexpr size_t DictionaryRatio = 4;
+
+        /// \brief The values. Shared with the slices of this object, so it is copied before it
+        ///        is changed while they exist.
+        std::shared_ptr<std::vector<T>> buffer_ = std::make_shared<std::vector<T>>();
+
+        /// \brief The rows of buffer_ this object is a slice of (null for all of them).
+        std::shared_ptr<const std::vector<std::size_t>> rows_;
+
+        /// \brief Small range integers: the offsets of the values from packedBase_ in
+        ///        packedWidth_ (1 or 2) bytes each, the largest offset for the missing values
+        ///        (null when buffer_ holds the values). The rows of a slice are rows of these.
+        std::shared_ptr<const std::vector<uint8_t>> packed_;
+        int64_t packedBase_ = 0;
+        size_t packedWidth_ = 0;
+
+        /// \brief Dictionary encoded strings: the index of each value in buffer_, which only
+        ///        holds the distinct values (null when buffer_ holds the values themselves). The
+        ///        rows of a slice are rows of the codes.
+        std::shared_ptr<const std::vector<int32_t>> codes_;
+
+        /// \brief The number of values in a row of buffer_ (slices only).
+        std::size_t rowSize_ = 1;
+
+        /// \brief The values of a slice, copied out of buffer_ the first time they are needed
+        ///        all together (until releaseValues).
+        mutable std::vector<T> materialized_;
+        mutable bool isMaterialized_ = false;
+        mutable std::mutex materializeMutex_;
+
+        /// \brief Numbers are returned by value (they may be packed), strings by reference.
+        typedef typename std::conditional<std::is_arithmetic<T>::value, T, const T&>::type
+            ValueRef;
+
+        /// \brief Get the value at an index into the (1d) values without copying a slice.
+        ValueRef valueAt(std::size_t idx) const
+        {
+            const auto pos = _position(idx);
+            if (codes_) return (*buffer_)[(*codes_)[pos]];
+            if (packed_) return _unpackedAt(pos);
+            return (*buffer_)[pos];
+        }
+
+        /// \brief Get the index into the (1d) values of a location.
+        /// \param loc The location.
+        /// \return The index.
+        size_t _indexOf(const Location& loc) const
+        {
+            size_t dim_prod = 1;
+            for (int dim_idx = dims_.size(); dim_idx > static_cast<int>(loc.size()); --dim_idx)
+            {
+                dim_prod *= dims_[dim_idx];
+            }
+
+            // Compute the index into the data array
+            size_t index = 0;
+            for (int dim_idx = loc.size() - 1; dim_idx >= 0; --dim_idx)
+            {
+                index += dim_prod*loc[dim_idx];
+                dim_prod *= dims_[dim_idx];
+            }
+
+            return index;
+        }
+
+        /// \brief Get the position in the stored values (or codes) of an index into the values.
+        std::size_t _position(std::size_t idx) const
+        {
+            return rows_ ? (*rows_)[idx / rowSize_] * rowSize_ + idx % rowSize_ : idx;
+        }
+
+        /// \brief Get all the values (copies the values of a slice when they aren't, thread safe).
+        const std::vector<T>& values() const
+        {
+            if (!rows_ && !codes_ && !packed_) return *buffer_;
+
+            std::lock_guard<std::mutex> lock(materializeMutex_);
+            if (!isMaterialized_ && (codes_ || packed_))
+            {
+                // Expand the dictionary (or widen the packed integers).
+                const auto numValues = size();
+                materialized_.reserve(numValues);
+                for (size_t idx = 0; idx < numValues; idx++)
+                {
+                    materialized_.push_back(valueAt(idx));
+                }
+
+                isMaterialized_ = true;
+            }
+            else if (!isMaterialized_)
+            {
+                materialized_.reserve(rows_->size() * rowSize_);
+                for (const auto row : *rows_)
+                {
+                    materialized_.insert(materialized_.end(),
+                                         buffer_->begin() + row * rowSize_,
+                                         buffer_->begin() + (row + 1) * rowSize_);
+                }
+
+                isMaterialized_ = true;
+            }
+
+            return materialized_;
+        }
+
+        /// \brief Get the values to change them. They stop being shared with the slices of this
+        ///        object (or with the object this one is a slice of). The validity is kept (in
+        ///        the order of the copied values).
+        std::vector<T>& mutableValues()
+        {
+            if (rows_ || codes_ || packed_ || buffer_.use_count() > 1)
+            {
+                auto validity = (validity_ && rows_) ?
+                    std::make_shared<const bufr::Validity>(this->validity()) : validity_;
+                resetValues(std::vector<T>(values()));
+                validity_ = std::move(validity);
+            }
+
+            return *buffer_;
+        }
+
+        /// \brief Replace the values (stops sharing them, drops the validity).
+        void resetValues(std::vector<T>&& values)
+        {
+            buffer_ = bufr::BufferPool::share(std::move(values));
+            validity_.reset();
+            rows_.reset();
+            codes_.reset();
+            packed_.reset();
+            materialized_ = std::vector<T>();
+            isMaterialized_ = false;
+        }
+
+        /// \brief Get a packed integer (see packed_).
+        template<typename U = void>
+        T _unpackedAt(std::size_t pos,
+            typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
+        {
+            uint32_t code;
+            if (packedWidth_ == 1)
+            {
+                code = (*packed_)[pos];
+            }
+            else
+            {
+                uint16_t wideCode;
+                std::memcpy(&wideCode, packed_->data() + pos * sizeof(wideCode), sizeof(wideCode));
+                code = wideCode;
+            }
+
+            return code == _missingCode(packedWidth_) ? missingValue()
+                                                      : static_cast<T>(packedBase_ + code);
+        }
+
+        /// \brief Strings are never packed.
+        template<typename U = void>
+        const T& _unpackedAt(std::size_t pos,
+            typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr) const
+        {
+            return (*buffer_)[pos];
+        }
+
+        /// \brief The code of the missing values of packed integers.
+        static uint32_t _missingCode(size_t width) { return (1u << (8 * width)) - 1; }
+
+        /// \brief Pack the values (see packIntegers, integers only).
+        template<typename U = void>
+        void _packIntegers(int bits,
+            typename std::enable_if<std::is_integral<T>::value, U>::type* = nullptr)
+        {
+            if (rows_ || packed_ || bits <= 0 || bits > 16) return;
+
+            const size_t width = (bits <= 8) ? 1 : 2;
+            const auto missingCode = _missingCode(width);
+
+            // The values of the field have to fit (ex: with a negative scale they don't).
+            bool hasValues = false;
+            T minValue = 0;
+            T maxValue = 0;
+            for (const auto value : *buffer_)
+            {
+                if (value == missingValue()) continue;
+
+                minValue = hasValues ? std::min(minValue, value) : value;
+                maxValue = hasValues ? std::max(maxValue, value) : value;
+                hasValues = true;
+            }
+
+            if (static_cast<double>(maxValue) - static_cast<double>(minValue) >= missingCode ||
+                static_cast<double>(minValue) > std::numeric_limits<int64_t>::max())
+            {
+                return;
+            }
+
+            const auto base = static_cast<int64_t>(minValue);
+            auto packed = std::make_shared<std::vector<uint8_t>>(buffer_->size() * width);
+            for (size_t pos = 0; pos < buffer_->size(); pos++)
+            {
+                const auto value = (*buffer_)[pos];
+                const auto code = (value == missingValue()) ?
+                    missingCode : static_cast<uint32_t>(static_cast<int64_t>(value) - base);
+
+                if (width == 1)
+                {
+                    (*packed)[pos] = static_cast<uint8_t>(code);
+                }
+                else
+                {
+                    const auto wideCode = static_cast<uint16_t>(code);
+                    std::memcpy(packed->data() + pos * width, &wideCode, width);
+                }
+            }
+
+            buffer_ = std::make_shared<std::vector<T>>();
+            packed_ = packed;
+            packedBase_ = base;
+            packedWidth_ = width;
+        }
+
+        /// \brief Only integers are packed.
+        template<typename U = void>
+        void _packIntegers(int,
+            typename std::enable_if<!std::is_integral<T>::value, U>::type* = nullptr)
+        {
+        }
+
+        /// \brief Dictionary encode the values if there are few distinct ones (strings only).
+        template<typename U = void>
+        void _encodeDictionary(
+            typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr)
+        {
+        }
+
+        /// \brief Dictionary encode the values if there are few distinct ones (strings only).
+        template<typename U = void>
+        void _encodeDictionary(
+            typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr)
+        {
+            if (rows_ || codes_ || buffer_->size() < MinDictionaryValues) return;
+
+            auto codes = std::make_shared<std::vector<int32_t>>();
+            auto distinct = std::make_shared<std::vector<T>>();
+            codes->reserve(buffer_->size());
+
+            std::unordered_map<std::string, int32_t> codeOf;
+            for (auto& value : *buffer_)
+            {
+                auto codeIt = codeOf.find(value);
+                if (codeIt == codeOf.end())
+                {
+                    // Not worth it with this many distinct values.
+                    if (distinct->size() * DictionaryRatio >= buffer_->size()) return;
+
+                    codeIt = codeOf.insert({value, static_cast<int32_t>(distinct->size())}).first;
+                    distinct->push_back(value);
+                }
+
+                codes->push_back(codeIt->second);
+            }
+
+            buffer_ = distinct;
+            codes_ = codes;
+        }
 
 #ifdef BUILD_IODA_BINDING
         /// \brief Make the variable creation parameters.
         /// \param chunks The chunk sizes
-        /// \param compressionLevel The compression level
+        /// \param compression How to compress the values
         /// \return The variable creation patterns.
         ioda::VariableCreationParameters makeCreationParams(
                 const std::vector<ioda::Dimensions_t>& chunks,
-                int compressionLevel) const
+                const Compression& compression) const
+        {
+            auto params = _makeCreationParams(chunks);
+            _setCompression(params, compression);
+
+            return params;
+        }
+
+        /// \brief Set the compression of variable creation parameters.
+        /// \param params The variable creation parameters
+        /// \param compression How to compress the values
+        static void _setCompression(ioda::VariableCreationParameters& params,
+                                    const Compression& compression)
+        {
+            switch (compression.codec)
+            {
+                case Compression::Codec::None:
+                    params.noCompress();
+                    break;
+                case Compression::Codec::Gzip:
+                    params.compressWithGZIP(compression.level);
+                    break;
+                case Compression::Codec::Szip:
+                    params.compressWithSZIP();
+                    break;
+            }
+        }
+
+        /// \brief Make a variable of null padded fixed-length strings (string data). They are
+        ///        stored in the chunks themselves (variable length strings are stored apart from
+        ///        them in the global heap, which the filters don't compress). Longer values are
+        ///        truncated to the string length.
+        /// \return The variable.
+        template<typename U = void>
+        ioda::Variable _createFixedStringVariable(ioda::ObsGroup& obsGroup,
+                                                  const std::string& name,
+                                                  const std::vector<ioda::Variable>& dimensions,
+                                                  const std::vector<ioda::Dimensions_t>& chunks,
+                                                  const Compression& compression,
+                                                  const ChunkWriter* chunkWriter,
+            typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr) const
+        {
+            const auto& dataValues = values();
+
+            size_t width = 1;
+            if (compression.stringLength != Compression::AutoStringLength)
+            {
+                width = static_cast<size_t>(compression.stringLength);
+            }
+            else
+            {
+                for (const auto& value : dataValues)
+                {
+                    width = std::max(width, value.size());
+                }
+            }
+
+            // The fill value is the default one (all nulls, the empty string).
+            ioda::VariableCreationParameters params;
+            params.chunk = true;
+            params.chunks = chunks;
+            _setCompression(params, compression);
+
+            const auto type = obsGroup.vars.getTypeProvider()->makeStringType(
+                typeid(std::string), width);
+            auto var = obsGroup.vars.createWithScales(name, dimensions, type, params);
+
+            std::vector<char> buffer(dataValues.size() * width, '\0');
+            for (size_t valIdx = 0; valIdx < dataValues.size(); valIdx++)
+            {
+                const auto& value = dataValues[valIdx];
+                std::copy_n(value.begin(), std::min(value.size(), width),
+                            buffer.begin() + valIdx * width);
+            }
+
+            const std::vector<char> fillValue(width, '\0');
+            if (chunkWriter == nullptr ||
+                compression.codec != Compression::Codec::Gzip ||
+                !chunkWriter->write(name, buffer.data(), dataValues.size(), width,
+                                    fillValue.data()))
+            {
+                var.write(gsl::span<const char>(buffer.data(), buffer.size()), type);
+            }
+
+            return var;
+        }
+
+        /// \brief Fixed-length strings only apply to string data.
+        template<typename U = void>
+        ioda::Variable _createFixedStringVariable(ioda::ObsGroup&,
+                                                  const std::string& name,
+                                                  const std::vector<ioda::Variable>&,
+                                                  const std::vector<ioda::Dimensions_t>&,
+                                                  const Compression&,
+                                                  const ChunkWriter*,
+            typename std::enable_if<!std::is_same<T, std::string>::value, U>::type* = nullptr) const
+        {
+            std::ostringstream errStr;
+            errStr << "Variable " << name << " has a stringLength but isn't a string variable.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        /// \brief Copy the values with their mantissas rounded to the given number of bits, so
+        ///        the trailing bits are zeros that compress well (floating point data). The
+        ///        missing values, infinities and NaNs are kept as they are.
+        /// \param significantBits The mantissa bits to keep.
+        template<typename U = void>
+        std::vector<T> _quantized(int significantBits,
+            typename std::enable_if<std::is_floating_point<T>::value, U>::type* = nullptr) const
+        {
+            typedef typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type Bits;
+            const int mantissaBits = std::numeric_limits<T>::digits - 1;
+            if (significantBits >= mantissaBits) return values();
+
+            const int dropBits = mantissaBits - significantBits;
+            const Bits half = static_cast<Bits>(1) << (dropBits - 1);
+            const Bits mask = ~((static_cast<Bits>(1) << dropBits) - 1);
+
+            std::vector<T> quantized(values());
+            for (auto& value : quantized)
+            {
+                if (value == missingValue() || !std::isfinite(value)) continue;
+
+                Bits bits;
+                std::memcpy(&bits, &value, sizeof(T));
+                const Bits rounded = (bits + half) & mask;
+                T roundedValue;
+                std::memcpy(&roundedValue, &rounded, sizeof(T));
+
+                // Keep the value when rounding up would overflow it.
+                if (std::isfinite(roundedValue)) value = roundedValue;
+            }
+
+            return quantized;
+        }
+
+        /// \brief Quantization doesn't apply to integer and string data.
+        template<typename U = void>
+        std::vector<T> _quantized(int,
+            typename std::enable_if<!std::is_floating_point<T>::value, U>::type* = nullptr) const
+        {
+            return values();
+        }
+
+        /// \brief Write the values with gzip compressed chunks made in parallel (numeric data).
+        /// \param chunkWriter The chunk writer.
+        /// \param name The name of the variable.
+        /// \param data The values.
+        /// \return False if the values still need to be written.
+        template<typename U = void>
+        bool _writeChunks(const ChunkWriter& chunkWriter,
+                          const std::string& name,
+                          const std::vector<T>& data,
+            typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
+        {
+            const T fillValue = static_cast<T>(missingValue());
+            return chunkWriter.write(name, data.data(), data.size(), sizeof(T), &fillValue);
+        }
+
+        /// \brief String data is written through ioda (its values are variable length).
+        template<typename U = void>
+        bool _writeChunks(const ChunkWriter&,
+                          const std::string&,
+                          const std::vector<T>&,
+            typename std::enable_if<!std::is_arithmetic<T>::value, U>::type* = nullptr) const
         {
-            return _makeCreationParams(chunks, compressionLevel);
+            return false;
         }
 
 
         /// \brief Make the variable creation parameters for numeric data.
         /// \param chunks The chunk sizes
-        /// \param compressionLevel The compression level
         /// \return The variable creation patterns.
         template<typename U = void>
         ioda::VariableCreationParameters _makeCreationParams(
             const std::vector<ioda::Dimensions_t>& chunks,
-            int compressionLevel,
             typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
         {
             ioda::VariableCreationParameters params;
             params.chunk = true;
             params.chunks = chunks;
-            params.compressWithGZIP(compressionLevel);
             params.setFillValue<T>(static_cast<T>(missingValue()));
 
             return params;
@@ -567,24 +1479,49 @@ namespace Ingester
 
         /// \brief Make the variable creation parameters for string data.
         /// \param chunks The chunk sizes
-        /// \param compressionLevel The compression level
         /// \return The variable creation patterns.
         template<typename U = void>
         ioda::VariableCreationParameters _makeCreationParams(
             const std::vector<ioda::Dimensions_t>& chunks,
-            int compressionLevel,
             typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr) const
         {
             ioda::VariableCreationParameters params;
             params.chunk = true;
             params.chunks = chunks;
-            params.compressWithGZIP(compressionLevel);
             params.setFillValue<T>(static_cast<T>(std::string("")));
 
             return params;
         }
 #endif
 
+        /// \brief Make the flat Arrow column of the values (numeric data). Shares the values if
+        ///        this object is owned by a std::shared_ptr.
+        template<typename U = void>
+        arrow::Column _makeArrowValues(const std::string& name,
+            typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
+        {
+            auto owner = std::shared_ptr<const void>(weak_from_this().lock());
+            if (!validity_) return arrow::makeNumeric(name, values(), missingValue(), owner);
+
+            // The validity is the Arrow validity buffer (gathered for a slice).
+            const auto validity = rows_ ?
+                std::make_shared<const bufr::Validity>(this->validity()) : validity_;
+            return arrow::makeNumeric(name,
+                                      values(),
+                                      validity->bits().data(),
+                                      static_cast<int64_t>(validity->numMissing()),
+                                      validity,
+                                      owner);
+        }
+
+        /// \brief Make the flat Arrow column of the values (string data).
+        template<typename U = void>
+        arrow::Column _makeArrowValues(const std::string& name,
+            typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr) const
+        {
+            return arrow::makeDictionaryStrings(name, values(), missingValue());
+        }
+
         /// \brief Get the data at the location as a float for numeric data.
         /// \return Float data.
         template<typename U = void>
@@ -645,7 +1582,7 @@ namespace Ingester
         int _getAsInt(size_t idx,
             typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
         {
-            return static_cast<int>(data_[idx]);
+            return static_cast<int>(valueAt(idx));
         }
 
         /// \brief Get the data at the index as a int for non-numeric data.
@@ -663,7 +1600,7 @@ namespace Ingester
         float _getAsFloat(size_t idx,
             typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
         {
-            return static_cast<float>(data_[idx]);
+            return static_cast<float>(valueAt(idx));
         }
 
         /// \brief Get the data at the index as a float for non-numeric data.
@@ -683,7 +1620,7 @@ namespace Ingester
                                  typename std::enable_if<std::is_arithmetic<T>::value,
                                  U>::type* = nullptr) const
         {
-            return std::to_string(data_[idx]);
+            return std::to_string(valueAt(idx));
         }
 
         /// \brief Get the data at the index as a int for non-numeric data.
@@ -693,7 +1630,106 @@ namespace Ingester
                                  typename std::enable_if<!std::is_arithmetic<T>::value,
                                  U>::type* = nullptr) const
         {
-            return data_[idx];
+            return valueAt(idx);
+        }
+
+        /// \brief Get the memory size of some numeric values.
+        template<typename It, typename U = void>
+        static size_t _byteSize(It begin, It end,
+            typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr)
+        {
+            return static_cast<size_t>(end - begin) * sizeof(T);
+        }
+
+        /// \brief Get the memory size of some strings (with the characters that aren't kept in
+        ///        the strings themselves).
+        template<typename It, typename U = void>
+        static size_t _byteSize(It begin, It end,
+            typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr)
+        {
+            size_t bytes = static_cast<size_t>(end - begin) * sizeof(T);
+            for (auto it = begin; it != end; ++it)
+            {
+                // Short strings are kept in place.
+                const auto chars = reinterpret_cast<const char*>(it->data());
+                const auto object = reinterpret_cast<const char*>(&*it);
+                if (chars < object || chars >= object + sizeof(T)) bytes += it->capacity() + 1;
+            }
+
+            return bytes;
+        }
+
+        /// \brief Convert a value to another numeric type (keeps missing values missing).
+        template<typename D>
+        static D _convert(const T& value)
+        {
+            return (value == missingValue()) ? DataObject<D>::missingValue()
+                                             : static_cast<D>(value);
+        }
+
+        /// \brief Copy the values into a vector of a numeric type (numeric data).
+        /// \param dst The vector to fill.
+        template<typename D, typename U = void>
+        void _copyValues(std::vector<D>& dst,
+            typename std::enable_if<std::is_arithmetic<T>::value &&
+                                    std::is_arithmetic<D>::value, U>::type* = nullptr) const
+        {
+            dst.resize(size());
+            if (packed_)
+            {
+                for (size_t idx = 0; idx < dst.size(); idx++)
+                {
+                    dst[idx] = _convert<D>(valueAt(idx));
+                }
+
+                return;
+            }
+
+            if (!rows_)
+            {
+                std::transform(buffer_->begin(), buffer_->end(), dst.begin(), _convert<D>);
+                return;
+            }
+
+            auto dstIt = dst.begin();
+            for (const auto row : *rows_)
+            {
+                dstIt = std::transform(buffer_->begin() + row * rowSize_,
+                                       buffer_->begin() + (row + 1) * rowSize_,
+                                       dstIt,
+                                       _convert<D>);
+            }
+        }
+
+        /// \brief Copy the values into a vector of strings (numeric data).
+        /// \param dst The vector to fill.
+        template<typename U = void>
+        void _copyValues(std::vector<std::string>& dst,
+            typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr) const
+        {
+            dst.resize(size());
+            for (size_t idx = 0; idx < dst.size(); idx++)
+            {
+                dst[idx] = std::to_string(valueAt(idx));
+            }
+        }
+
+        /// \brief Copy the values into a vector of strings (string data).
+        /// \param dst The vector to fill.
+        template<typename U = void>
+        void _copyValues(std::vector<std::string>& dst,
+            typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr) const
+        {
+            dst = values();
+        }
+
+        /// \brief Copy the values into a vector of a numeric type (string data).
+        template<typename D, typename U = void>
+        void _copyValues(std::vector<D>&,
+            typename std::enable_if<std::is_same<T, std::string>::value &&
+                                    std::is_arithmetic<D>::value, U>::type* = nullptr) const
+        {
+            throw std::runtime_error("The stored value is not a number");
         }
 
         /// \brief Set the data associated with this data object (numeric DataObject).
@@ -709,21 +1745,57 @@ namespace Ingester
                 str << "Can't make numerical field from string data.";
                 throw std::runtime_error(str.str());
             }
+            else if (data.storage() == bufr::Data::Storage::Floats)
+            {
+                _setNarrowData(data.values<float>());
+            }
+            else if (data.storage() == bufr::Data::Storage::Ints)
+            {
+                _setNarrowData(data.values<int32_t>());
+            }
             else
             {
-                data_ = std::vector<T>(data.size());
+                auto values = bufr::BufferPool::take<T>(data.size());
+                values.resize(data.size());
                 for (size_t idx = 0; idx < data.size(); ++idx)
                 {
                     if (!data.isMissing(idx))
                     {
-                        data_[idx] = data.value.octets[idx];
+                        values[idx] = data.value.octets[idx];
                     }
                     else
                     {
-                        data_[idx] = missingValue();
+                        values[idx] = missingValue();
                     }
                 }
+
+                resetValues(std::move(values));
+            }
+        }
+
+        /// \brief Set the data from narrow storage that already has the type of this object.
+        /// \param values The values.
+        void _setNarrowData(const std::vector<T>& values)
+        {
+            auto data = bufr::BufferPool::take<T>(values.size());
+            data.assign(values.begin(), values.end());
+            resetValues(std::move(data));
+        }
+
+        /// \brief Set the data from narrow storage of another type.
+        /// \param values The values.
+        template<typename N>
+        void _setNarrowData(const std::vector<N>& values)
+        {
+            auto data = bufr::BufferPool::take<T>(values.size());
+            data.resize(values.size());
+            for (size_t idx = 0; idx < values.size(); ++idx)
+            {
+                data[idx] = (values[idx] == bufr::Data::missingValue<N>()) ?
+                                missingValue() : static_cast<T>(values[idx]);
             }
+
+            resetValues(std::move(data));
         }
 
         /// \brief Set the data associated with this data object (string DataObject).
@@ -734,10 +1806,14 @@ namespace Ingester
             const bufr::Data& data,
             typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr)
         {
-            data_ = std::vector<std::string>();
+            std::vector<std::string> dataValues;
             if (data.isLongStr())
             {
-                data_ = data.value.strings;
+                dataValues = data.value.strings;
+            }
+            else if (data.storage() != bufr::Data::Storage::Octets)
+            {
+                throw std::runtime_error("Can't make string field from numerical data.");
             }
             else
             {
@@ -754,14 +1830,17 @@ namespace Ingester
                                                [](char c) { return !std::isspace(c); }).base(),
                                   str.end());
 
-                        data_.push_back(str);
+                        dataValues.push_back(str);
                     }
                     else
                     {
-                        data_.push_back("");
+                        dataValues.push_back("");
                     }
                 }
             }
+
+            resetValues(std::move(dataValues));
+            _encodeDictionary();
         }
 
         /// \brief Multiply the stored values in this data object by a scalar.
@@ -781,11 +1860,12 @@ namespace Ingester
                 typeid(T) == typeid(double) ||  // NOLINT
                 trunc(val) == val)
             {
-                for (size_t i = 0; i < data_.size(); i++)
+                auto& dataValues = mutableValues();
+                for (size_t i = 0; i < dataValues.size(); i++)
                 {
-                    if (data_[i] != missingValue())
+                    if (dataValues[i] != missingValue())
                     {
-                        data_[i] = static_cast<T>(static_cast<double>(data_[i]) * val);
+                        dataValues[i] = static_cast<T>(static_cast<double>(dataValues[i]) * val);
                     }
                 }
             }
@@ -822,11 +1902,12 @@ namespace Ingester
         void _offsetBy(double val,
                        typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr)
         {
-            for (size_t i = 0; i < data_.size(); i++)
+            auto& dataValues = mutableValues();
+            for (size_t i = 0; i < dataValues.size(); i++)
             {
-                if (data_[i] != missingValue())
+                if (dataValues[i] != missingValue())
                 {
-                    data_[i] = data_[i] + static_cast<T>(val);
+                    dataValues[i] = dataValues[i] + static_cast<T>(val);
                 }
             }
         }
@@ -840,5 +1921,93 @@ namespace Ingester
         {
             throw std::runtime_error("Trying to offset a string by a number");
         }
+
+        /// \brief Replace the stored values with a function of them.
+        /// \param func Function that modifies count values in place.
+        void mapValues(const std::function<void(double* values, size_t count)>& func) final
+        {
+            _mapValues(func);
+        }
+
+        /// \brief Replace the stored values with a function of them (numeric version).
+        /// \param func Function that modifies count values in place.
+        template<typename U = void>
+        void _mapValues(const std::function<void(double* values, size_t count)>& func,
+                        typename std::enable_if<std::is_arithmetic<T>::value, U>::type* = nullptr)
+        {
+            constexpr size_t BlockSize = 256;
+
+            // Results that aren't finite become missing.
+            auto& dataValues = mutableValues();
+            validity_.reset();
+            double block[BlockSize];
+            size_t blockIdxs[BlockSize];
+
+            auto flush = [&](size_t num)
+            {
+                func(block, num);
+                for (size_t i = 0; i < num; i++)
+                {
+                    const double result = block[i];
+                    if (!std::isfinite(result))
+                    {
+                        dataValues[blockIdxs[i]] = missingValue();
+                    }
+                    else if (std::is_integral<T>::value && trunc(result) != result)
+                    {
+                        std::ostringstream str;
+                        str << "Transforming integer field \"" << fieldName_ << "\" into ";
+                        str << "non-integers is illegal. Please convert it to a float or double.";
+                        throw std::runtime_error(str.str());
+                    }
+                    else
+                    {
+                        dataValues[blockIdxs[i]] = static_cast<T>(result);
+                    }
+                }
+            };
+
+            size_t num = 0;
+            for (size_t i = 0; i < dataValues.size(); i++)
+            {
+                if (dataValues[i] == missingValue()) continue;
+
+                block[num] = static_cast<double>(dataValues[i]);
+                blockIdxs[num] = i;
+                if (++num == BlockSize)
+                {
+                    flush(num);
+                    num = 0;
+                }
+            }
+
+            if (num > 0) flush(num);
+        }
+
+        /// \brief Replace the stored values with a function of them (string version).
+        /// \param func Function that modifies count values in place.
+        template<typename U = void>
+        void _mapValues(
+            const std::function<void(double* values, size_t count)>& func,
+            typename std::enable_if<std::is_same<T, std::string>::value, U>::type* = nullptr)
+        {
+            throw std::runtime_error("Trying to apply an expression to a string field");
+        }
     };
+
+    template<typename T>
+    gsl::span<const T> DataObjectBase::asSpan() const
+    {
+        auto typedObject = dynamic_cast<const DataObject<T>*>(this);
+        if (!typedObject)
+        {
+            std::ostringstream errStr;
+            errStr << "Field " << fieldName_ << " doesn't have the requested type. Use copyAs to ";
+            errStr << "convert it.";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        const auto& values = typedObject->getRawData();
+        return gsl::span<const T>(values.data(), values.size());
+    }
 }  // namespace Ingester
@@ -0,0 +1,210 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "IncrementalState.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "eckit/exception/Exceptions.h"
+
+
+namespace
+{
+    const char* StateMagic = "BUFRINCREMENTAL";
+    const int StateVersion = 1;
+}  // namespace
+
+namespace Ingester
+{
+    IncrementalState::IncrementalState(const std::string& path) :
+        path_(path)
+    {
+        std::ifstream file(path_);
+        if (!file) return;  // Nothing was converted yet
+
+        std::string magic;
+        int version = 0;
+        file >> magic >> version;
+        if (!file || magic != StateMagic || version != StateVersion)
+        {
+            std::ostringstream errStr;
+            errStr << path_ << " isn't an incremental state file (version " << StateVersion
+                   << ").";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        std::string tag;
+        while (file >> tag)
+        {
+            std::string key;
+            size_t numFiles = 0;
+            file >> std::quoted(key) >> numFiles;
+
+            std::vector<FileState> files(numFiles);
+            for (auto& fileState : files)
+            {
+                file >> std::quoted(fileState.path) >> fileState.size >> fileState.messages;
+            }
+
+            if (!file || tag != "output")
+            {
+                std::ostringstream errStr;
+                errStr << "The incremental state file " << path_ << " is corrupt.";
+                throw eckit::BadValue(errStr.str());
+            }
+
+            outputs_[key] = files;
+        }
+    }
+
+    std::vector<std::int64_t> IncrementalState::fileSizes(
+        const std::vector<std::string>& filePaths)
+    {
+        std::vector<std::int64_t> sizes;
+        for (const auto& filePath : filePaths)
+        {
+            struct stat fileInfo;
+            sizes.push_back(stat(filePath.c_str(), &fileInfo) == 0 ?
+                            static_cast<std::int64_t>(fileInfo.st_size) : -1);
+        }
+
+        return sizes;
+    }
+
+    bool IncrementalState::isUpToDate(const std::string& key,
+                                      const std::vector<std::string>& filePaths,
+                                      const std::vector<std::int64_t>& sizes) const
+    {
+        const auto outputIt = outputs_.find(key);
+        if (outputIt == outputs_.end() || outputIt->second.size() != filePaths.size())
+        {
+            return false;
+        }
+
+        for (size_t fileIdx = 0; fileIdx < filePaths.size(); fileIdx++)
+        {
+            const auto& fileState = outputIt->second[fileIdx];
+            if (fileState.path != filePaths[fileIdx] || fileState.size != sizes[fileIdx])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    size_t IncrementalState::convertedMessages(const std::string& key,
+                                               const std::vector<std::string>& filePaths,
+                                               const std::vector<std::int64_t>& sizes) const
+    {
+        const auto outputIt = outputs_.find(key);
+        if (outputIt == outputs_.end()) return 0;
+
+        const auto& files = outputIt->second;
+        size_t messages = 0;
+        for (size_t fileIdx = 0; fileIdx < files.size(); fileIdx++)
+        {
+            const auto& fileState = files[fileIdx];
+            const bool isLast = (fileIdx + 1 == files.size());
+
+            std::string problem;
+            if (fileIdx >= filePaths.size() || filePaths[fileIdx] != fileState.path)
+            {
+                problem = "is no longer one of (or in the same place in) the input files";
+            }
+            else if (sizes[fileIdx] < fileState.size)
+            {
+                problem = "got smaller";
+            }
+            else if (!isLast && sizes[fileIdx] != fileState.size)
+            {
+                problem = "changed, but only the last converted file can grow";
+            }
+
+            if (!problem.empty())
+            {
+                std::ostringstream errStr;
+                errStr << "Can't convert " << key << " incrementally. " << fileState.path << " "
+                       << problem << " since it was converted (see " << path_ << ").";
+                throw eckit::BadValue(errStr.str());
+            }
+
+            messages += fileState.messages;
+        }
+
+        return messages;
+    }
+
+    void IncrementalState::update(const std::string& key,
+                                  const std::vector<std::string>& filePaths,
+                                  const std::vector<std::int64_t>& sizes,
+                                  const std::vector<size_t>& messagesRead)
+    {
+        if (sizes.size() != filePaths.size() || messagesRead.size() != filePaths.size())
+        {
+            throw eckit::BadValue("IncrementalState::update: Expected a size and a message "
+                                  "count for every file.");
+        }
+
+        std::vector<FileState> files(filePaths.size());
+        for (size_t fileIdx = 0; fileIdx < filePaths.size(); fileIdx++)
+        {
+            files[fileIdx].path = filePaths[fileIdx];
+            files[fileIdx].size = sizes[fileIdx];
+            files[fileIdx].messages = messagesRead[fileIdx];
+        }
+
+        outputs_[key] = files;
+    }
+
+    void IncrementalState::write() const
+    {
+        // The state has to match the outputs, so it is never left half written.
+        std::ostringstream tmpPath;
+        tmpPath << path_ << "." << getpid() << ".tmp";
+
+        {
+            std::ofstream file(tmpPath.str());
+            file << StateMagic << " " << StateVersion << "\n";
+            for (const auto& output : outputs_)
+            {
+                file << "output " << std::quoted(output.first) << " " << output.second.size()
+                     << "\n";
+                for (const auto& fileState : output.second)
+                {
+                    file << std::quoted(fileState.path) << " " << fileState.size << " "
+                         << fileState.messages << "\n";
+                }
+            }
+
+            if (!file)
+            {
+                file.close();
+                std::remove(tmpPath.str().c_str());
+
+                std::ostringstream errStr;
+                errStr << "Couldn't write the incremental state file " << path_ << ".";
+                throw eckit::BadValue(errStr.str());
+            }
+        }
+
+        if (std::rename(tmpPath.str().c_str(), path_.c_str()) != 0)
+        {
+            std::remove(tmpPath.str().c_str());
+
+            std::ostringstream errStr;
+            errStr << "Couldn't replace the incremental state file " << path_ << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+    }
+}  // namespace Ingester
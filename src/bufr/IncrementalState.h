@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace Ingester
+{
+    /// \brief Remembers how much of the BUFR files of each output was converted, so a later run
+    ///        (ex: of a real time dump that is still being written) only decodes the messages
+    ///        that were added since and appends them to the output (bufr2ioda.x --incremental).
+    ///        Files can only grow at the end: new files may follow the converted ones, and the
+    ///        last converted file may get more messages, but the others have to stay the same.
+    class IncrementalState
+    {
+     public:
+        /// \brief What was converted of one BUFR file.
+        struct FileState
+        {
+            std::string path;
+            std::int64_t size = 0;  // Size of the file (bytes) before it was read
+            size_t messages = 0;  // Data messages that were converted
+        };
+
+        /// \brief Constructor. Reads the state file if it exists.
+        /// \param path Path to the state file.
+        explicit IncrementalState(const std::string& path);
+
+        /// \brief Get the size of the files now (-1 for the ones that can't be found).
+        /// \param filePaths The (expanded) paths of the BUFR files.
+        static std::vector<std::int64_t> fileSizes(const std::vector<std::string>& filePaths);
+
+        /// \brief True if nothing was added to the files since they were converted.
+        /// \param key The output the files are converted to.
+        /// \param filePaths The (expanded) paths of the BUFR files.
+        /// \param sizes Their sizes now (see fileSizes).
+        bool isUpToDate(const std::string& key,
+                        const std::vector<std::string>& filePaths,
+                        const std::vector<std::int64_t>& sizes) const;
+
+        /// \brief Get the number of data messages (counted over the files in order) that were
+        ///        already converted. Throws if the files changed in a way that can't be
+        ///        appended to the output.
+        /// \param key The output the files are converted to.
+        /// \param filePaths The (expanded) paths of the BUFR files.
+        /// \param sizes Their sizes now (see fileSizes).
+        size_t convertedMessages(const std::string& key,
+                                 const std::vector<std::string>& filePaths,
+                                 const std::vector<std::int64_t>& sizes) const;
+
+        /// \brief Record the messages that were converted.
+        /// \param key The output the files are converted to.
+        /// \param filePaths The (expanded) paths of the BUFR files.
+        /// \param sizes Their sizes before they were read (see fileSizes).
+        /// \param messagesRead The data messages read from each file (converted before or now).
+        void update(const std::string& key,
+                    const std::vector<std::string>& filePaths,
+                    const std::vector<std::int64_t>& sizes,
+                    const std::vector<size_t>& messagesRead);
+
+        /// \brief Write the state file (replaces it in one step).
+        void write() const;
+
+     private:
+        const std::string path_;
+        std::map<std::string, std::vector<FileState>> outputs_;
+    };
+}  // namespace Ingester
@@ -0,0 +1,712 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "IodaConcat.h"
+
+#include <hdf5.h>
+#include <hdf5_hl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "../IodaEncoder/Hdf5Handle.h"
+
+
+namespace
+{
+    using Ingester::Hdf5Handle;
+
+    /// \brief The number of rows of chunks read and written at once when rows go through the
+    ///        filters.
+    const hsize_t RewriteChunkRows = 16;
+
+    /// \brief An object of a file (the groups come before the objects in them).
+    struct Entry
+    {
+        std::string path;
+        bool isGroup;
+    };
+
+    /// \brief A dataset of the first file.
+    struct VarInfo
+    {
+        std::string path;
+        bool isAlong;  // Along the concatenated dimension
+        bool isScale;
+        std::vector<std::vector<std::string>> scales;  // The paths of the scales of each dim
+    };
+
+    void check(herr_t status, const std::string& what)
+    {
+        if (status < 0)
+        {
+            std::ostringstream errStr;
+            errStr << "Couldn't " << what << ".";
+            throw eckit::BadValue(errStr.str());
+        }
+    }
+
+    hid_t checked(hid_t id, const std::string& what)
+    {
+        check(id < 0 ? -1 : 0, what);
+        return id;
+    }
+
+    /// \brief Is the type (or a part of it) of variable length? Their values hold pointers, so
+    ///        they are never copied as raw bytes.
+    bool isVariable(hid_t type)
+    {
+        return H5Tdetect_class(type, H5T_VLEN) > 0 ||
+               (H5Tget_class(type) == H5T_STRING && H5Tis_variable_str(type) > 0);
+    }
+
+    /// \brief Free the memory HDF5 allocated for the variable length values read into buffer.
+    void reclaim(hid_t memType, hid_t space, void* buffer)
+    {
+#if H5_VERSION_GE(1, 12, 0)
+        H5Treclaim(memType, space, H5P_DEFAULT, buffer);
+#else
+        H5Dvlen_reclaim(memType, space, H5P_DEFAULT, buffer);
+#endif
+    }
+
+    std::vector<hsize_t> extent(hid_t dataset, std::vector<hsize_t>* maxDims = nullptr)
+    {
+        Hdf5Handle space(H5Dget_space(dataset), H5Sclose);
+        const int rank = H5Sget_simple_extent_ndims(space.get());
+        std::vector<hsize_t> dims(std::max(rank, 0));
+        if (maxDims) maxDims->resize(dims.size());
+        H5Sget_simple_extent_dims(space.get(), dims.data(), maxDims ? maxDims->data() : nullptr);
+        return dims;
+    }
+
+    /// \brief Make the dataspace of a dataset of the output.
+    /// \param dataset The dataset of the first file.
+    /// \param isAlong Is it along the concatenated dimension?
+    /// \param numRows The rows of the output along the dimension.
+    hid_t outputSpace(hid_t dataset, bool isAlong, hsize_t numRows)
+    {
+        std::vector<hsize_t> maxDims;
+        auto dims = extent(dataset, &maxDims);
+        if (dims.empty())
+        {
+            Hdf5Handle space(H5Dget_space(dataset), H5Sclose);
+            return H5Scopy(space.get());
+        }
+
+        if (isAlong)
+        {
+            dims[0] = numRows;
+            if (maxDims[0] != H5S_UNLIMITED) maxDims[0] = numRows;
+        }
+
+        return H5Screate_simple(static_cast<int>(dims.size()), dims.data(), maxDims.data());
+    }
+
+    /// \brief Iterate the links of groups (and attributes) in creation order when the file
+    ///        keeps it, so the output is laid out like the input.
+    H5_index_t linkIndex(hid_t group)
+    {
+        unsigned int flags = 0;
+        Hdf5Handle plist(H5Gget_create_plist(group), H5Pclose);
+        if (plist.isValid()) H5Pget_link_creation_order(plist.get(), &flags);
+        return (flags & H5P_CRT_ORDER_INDEXED) ? H5_INDEX_CRT_ORDER : H5_INDEX_NAME;
+    }
+
+    void listGroup(hid_t group, const std::string& path, std::vector<Entry>& entries)
+    {
+        H5G_info_t info;
+        check(H5Gget_info(group, &info), "read the group " + path);
+
+        const auto index = linkIndex(group);
+        for (hsize_t linkIdx = 0; linkIdx < info.nlinks; linkIdx++)
+        {
+            const auto size = H5Lget_name_by_idx(group, ".", index, H5_ITER_INC, linkIdx,
+                                                 nullptr, 0, H5P_DEFAULT);
+            if (size < 0) continue;
+
+            std::string name(static_cast<size_t>(size) + 1, '\0');
+            H5Lget_name_by_idx(group, ".", index, H5_ITER_INC, linkIdx, &name[0], name.size(),
+                               H5P_DEFAULT);
+            name.resize(static_cast<size_t>(size));
+
+            hid_t objId;
+            H5E_BEGIN_TRY
+            {
+                objId = H5Oopen(group, name.c_str(), H5P_DEFAULT);
+            }
+            H5E_END_TRY;
+
+            Hdf5Handle object(objId, H5Oclose);
+            if (!object.isValid()) continue;
+
+            const std::string objPath = (path == "/" ? "" : path) + "/" + name;
+            const auto type = H5Iget_type(object.get());
+            if (type == H5I_GROUP)
+            {
+                entries.push_back({objPath, true});
+                listGroup(object.get(), objPath, entries);
+            }
+            else if (type == H5I_DATASET)
+            {
+                entries.push_back({objPath, false});
+            }
+        }
+    }
+
+    std::vector<Entry> listEntries(hid_t file)
+    {
+        Hdf5Handle root(checked(H5Gopen2(file, "/", H5P_DEFAULT), "open the root group"),
+                        H5Gclose);
+        std::vector<Entry> entries;
+        listGroup(root.get(), "/", entries);
+        return entries;
+    }
+
+    herr_t collectAttrName(hid_t, const char* name, const H5A_info_t*, void* data)
+    {
+        static_cast<std::vector<std::string>*>(data)->emplace_back(name);
+        return 0;
+    }
+
+    /// \brief Copy the attributes of an object, except the ones that refer to other objects
+    ///        (the dimension lists), which are made again by attaching the scales.
+    void copyAttributes(hid_t src, hid_t dst, const std::string& path)
+    {
+        std::vector<std::string> names;
+        herr_t status;
+        H5E_BEGIN_TRY
+        {
+            status = H5Aiterate2(src, H5_INDEX_CRT_ORDER, H5_ITER_INC, nullptr, collectAttrName,
+                                 &names);
+        }
+        H5E_END_TRY;
+
+        if (status < 0)
+        {
+            names.clear();
+            check(H5Aiterate2(src, H5_INDEX_NAME, H5_ITER_INC, nullptr, collectAttrName, &names),
+                  "read the attributes of " + path);
+        }
+
+        for (const auto& name : names)
+        {
+            if (name == "DIMENSION_LIST" || name == "REFERENCE_LIST") continue;
+
+            const std::string what = "copy the attribute " + name + " of " + path;
+            Hdf5Handle attr(checked(H5Aopen(src, name.c_str(), H5P_DEFAULT), what), H5Aclose);
+            Hdf5Handle type(checked(H5Aget_type(attr.get()), what), H5Tclose);
+            Hdf5Handle space(checked(H5Aget_space(attr.get()), what), H5Sclose);
+            Hdf5Handle memType(checked(H5Tget_native_type(type.get(), H5T_DIR_DEFAULT), what),
+                               H5Tclose);
+
+            const auto numValues = std::max<hssize_t>(H5Sget_simple_extent_npoints(space.get()),
+                                                      1);
+            std::vector<unsigned char> buffer(numValues * H5Tget_size(memType.get()));
+            check(H5Aread(attr.get(), memType.get(), buffer.data()), what);
+
+            Hdf5Handle newAttr(checked(H5Acreate2(dst, name.c_str(), type.get(), space.get(),
+                                                  H5P_DEFAULT, H5P_DEFAULT), what),
+                               H5Aclose);
+            const auto writeStatus = H5Awrite(newAttr.get(), memType.get(), buffer.data());
+            if (isVariable(memType.get())) reclaim(memType.get(), space.get(), buffer.data());
+            check(writeStatus, what);
+        }
+    }
+
+    /// \brief The paths of the dimension scales attached to each dimension of a dataset.
+    std::vector<std::vector<std::string>> scalePaths(hid_t dataset, size_t rank)
+    {
+        std::vector<std::vector<std::string>> scales(rank);
+        for (size_t dimIdx = 0; dimIdx < rank; dimIdx++)
+        {
+            if (H5DSget_num_scales(dataset, static_cast<unsigned int>(dimIdx)) <= 0) continue;
+
+            auto visit = [](hid_t, unsigned int, hid_t scale, void* data) -> herr_t
+            {
+                const auto size = H5Iget_name(scale, nullptr, 0);
+                if (size > 0)
+                {
+                    std::string name(static_cast<size_t>(size) + 1, '\0');
+                    H5Iget_name(scale, &name[0], name.size());
+                    name.resize(static_cast<size_t>(size));
+                    static_cast<std::vector<std::string>*>(data)->push_back(name);
+                }
+
+                return 0;
+            };
+
+            H5DSiterate_scales(dataset, static_cast<unsigned int>(dimIdx), nullptr, visit,
+                               &scales[dimIdx]);
+        }
+
+        return scales;
+    }
+
+    /// \brief Are the chunks of two datasets made the same way (same chunks and filters), so
+    ///        the chunks of one can be copied into the other as they are?
+    bool sameChunking(hid_t src, hid_t dst)
+    {
+        Hdf5Handle srcPlist(H5Dget_create_plist(src), H5Pclose);
+        Hdf5Handle dstPlist(H5Dget_create_plist(dst), H5Pclose);
+        if (H5Pget_layout(srcPlist.get()) != H5D_CHUNKED ||
+            H5Pget_layout(dstPlist.get()) != H5D_CHUNKED)
+        {
+            return false;
+        }
+
+        const int rank = H5Pget_chunk(srcPlist.get(), 0, nullptr);
+        if (rank <= 0 || H5Pget_chunk(dstPlist.get(), 0, nullptr) != rank) return false;
+
+        std::vector<hsize_t> srcChunks(rank);
+        std::vector<hsize_t> dstChunks(rank);
+        H5Pget_chunk(srcPlist.get(), rank, srcChunks.data());
+        H5Pget_chunk(dstPlist.get(), rank, dstChunks.data());
+        if (srcChunks != dstChunks) return false;
+
+        const int numFilters = H5Pget_nfilters(srcPlist.get());
+        if (numFilters != H5Pget_nfilters(dstPlist.get())) return false;
+
+        for (int filterIdx = 0; filterIdx < numFilters; filterIdx++)
+        {
+            unsigned int flags[2] = {0, 0};
+            size_t numValues[2] = {8, 8};
+            unsigned int values[2][8] = {};
+            unsigned int config = 0;
+            const auto srcFilter = H5Pget_filter2(srcPlist.get(), filterIdx, &flags[0],
+                                                  &numValues[0], values[0], 0, nullptr, &config);
+            const auto dstFilter = H5Pget_filter2(dstPlist.get(), filterIdx, &flags[1],
+                                                  &numValues[1], values[1], 0, nullptr, &config);
+            if (srcFilter != dstFilter || numValues[0] != numValues[1] ||
+                !std::equal(values[0], values[0] + std::min<size_t>(numValues[0], 8), values[1]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /// \brief Read the values of a dataset, one string (of bytes) per value. Used to compare
+    ///        the dimension scales of the files.
+    std::vector<std::string> readValues(hid_t dataset)
+    {
+        Hdf5Handle type(H5Dget_type(dataset), H5Tclose);
+        Hdf5Handle memType(H5Tget_native_type(type.get(), H5T_DIR_DEFAULT), H5Tclose);
+        Hdf5Handle space(H5Dget_space(dataset), H5Sclose);
+        const auto numValues = static_cast<size_t>(H5Sget_simple_extent_npoints(space.get()));
+        const auto typeSize = H5Tget_size(memType.get());
+
+        std::vector<unsigned char> buffer(std::max<size_t>(numValues, 1) * typeSize);
+        check(H5Dread(dataset, memType.get(), H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data()),
+              "read a dimension scale");
+
+        const bool isVarString = H5Tget_class(memType.get()) == H5T_STRING &&
+                                 H5Tis_variable_str(memType.get()) > 0;
+
+        std::vector<std::string> values;
+        values.reserve(numValues);
+        for (size_t valIdx = 0; valIdx < numValues; valIdx++)
+        {
+            if (isVarString)
+            {
+                const char* str;
+                std::memcpy(&str, &buffer[valIdx * typeSize], sizeof(str));
+                values.emplace_back(str ? str : "");
+            }
+            else
+            {
+                values.emplace_back(reinterpret_cast<const char*>(&buffer[valIdx * typeSize]),
+                                    typeSize);
+            }
+        }
+
+        if (isVarString) reclaim(memType.get(), space.get(), buffer.data());
+        return values;
+    }
+
+    /// \brief Read rows of a dataset and write them into rows of another one through HDF5 (so
+    ///        every value goes through the filters again).
+    /// \param src The dataset to read.
+    /// \param dst The dataset to write.
+    /// \param rowBegin The first row to read.
+    /// \param rowEnd The row after the last one to read.
+    /// \param rowOffset Where the rows of src start in dst.
+    void rewriteRows(hid_t src, hid_t dst, hsize_t rowBegin, hsize_t rowEnd, hsize_t rowOffset)
+    {
+        Hdf5Handle type(H5Dget_type(src), H5Tclose);
+        Hdf5Handle memType(H5Tget_native_type(type.get(), H5T_DIR_DEFAULT), H5Tclose);
+        const bool hasPointers = isVariable(memType.get());
+        const auto typeSize = H5Tget_size(memType.get());
+
+        const auto dims = extent(src);
+        if (dims.empty())
+        {
+            std::vector<unsigned char> buffer(typeSize);
+            Hdf5Handle space(H5Dget_space(src), H5Sclose);
+            check(H5Dread(src, memType.get(), H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data()),
+                  "read a scalar variable");
+            const auto status = H5Dwrite(dst, memType.get(), H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                                         buffer.data());
+            if (hasPointers) reclaim(memType.get(), space.get(), buffer.data());
+            check(status, "write a scalar variable");
+            return;
+        }
+
+        hsize_t rowValues = 1;
+        for (size_t dimIdx = 1; dimIdx < dims.size(); dimIdx++) rowValues *= dims[dimIdx];
+        if (rowEnd <= rowBegin || rowValues == 0) return;
+
+        // Go through the rows a few rows of chunks at a time to bound the memory.
+        hsize_t blockRows = rowEnd - rowBegin;
+        Hdf5Handle plist(H5Dget_create_plist(src), H5Pclose);
+        if (H5Pget_layout(plist.get()) == H5D_CHUNKED)
+        {
+            std::vector<hsize_t> chunks(dims.size());
+            H5Pget_chunk(plist.get(), static_cast<int>(dims.size()), chunks.data());
+            blockRows = std::min(blockRows, std::max<hsize_t>(chunks[0], 1) * RewriteChunkRows);
+        }
+
+        const auto dstDims = extent(dst);
+        std::vector<unsigned char> buffer;
+        for (hsize_t row = rowBegin; row < rowEnd; row += blockRows)
+        {
+            std::vector<hsize_t> count(dims);
+            count[0] = std::min(blockRows, rowEnd - row);
+            std::vector<hsize_t> srcStart(dims.size(), 0);
+            std::vector<hsize_t> dstStart(dims.size(), 0);
+            srcStart[0] = row;
+            dstStart[0] = rowOffset + row;
+
+            Hdf5Handle memSpace(H5Screate_simple(static_cast<int>(count.size()), count.data(),
+                                                 nullptr),
+                                H5Sclose);
+            Hdf5Handle srcSpace(H5Dget_space(src), H5Sclose);
+            Hdf5Handle dstSpace(H5Screate_simple(static_cast<int>(dstDims.size()),
+                                                 dstDims.data(), nullptr),
+                                H5Sclose);
+            H5Sselect_hyperslab(srcSpace.get(), H5S_SELECT_SET, srcStart.data(), nullptr,
+                                count.data(), nullptr);
+            H5Sselect_hyperslab(dstSpace.get(), H5S_SELECT_SET, dstStart.data(), nullptr,
+                                count.data(), nullptr);
+
+            buffer.assign(count[0] * rowValues * typeSize, 0);
+            check(H5Dread(src, memType.get(), memSpace.get(), srcSpace.get(), H5P_DEFAULT,
+                          buffer.data()),
+                  "read the rows of a variable");
+
+            const auto status = H5Dwrite(dst, memType.get(), memSpace.get(), dstSpace.get(),
+                                         H5P_DEFAULT, buffer.data());
+            if (hasPointers) reclaim(memType.get(), memSpace.get(), buffer.data());
+            check(status, "write the rows of a variable");
+        }
+    }
+
+    /// \brief Copy the rows of a dataset into rows of another one. Whole chunks that land on
+    ///        chunk boundaries are copied as they are (still compressed), the other rows go
+    ///        through HDF5.
+    /// \param src The dataset to read.
+    /// \param dst The dataset to write.
+    /// \param rowOffset Where the rows of src start in dst.
+    /// \param isLast Are the rows of src the last rows of dst (so its partial last chunk is the
+    ///        partial last chunk of dst too)?
+    /// \param stats The stats to update.
+    void copyRows(hid_t src, hid_t dst, hsize_t rowOffset, bool isLast,
+                  Ingester::ConcatStats& stats)
+    {
+        const auto dims = extent(src);
+        const hsize_t numRows = dims.empty() ? 0 : dims[0];
+
+        Hdf5Handle type(H5Dget_type(src), H5Tclose);
+        hsize_t rowsDone = 0;
+        if (!dims.empty() && !isVariable(type.get()) && sameChunking(src, dst))
+        {
+            Hdf5Handle plist(H5Dget_create_plist(src), H5Pclose);
+            std::vector<hsize_t> chunks(dims.size());
+            H5Pget_chunk(plist.get(), static_cast<int>(dims.size()), chunks.data());
+
+            // The chunks of the other dimensions (they are the same in src and dst).
+            size_t numOtherChunks = 1;
+            std::vector<hsize_t> otherChunks(dims.size(), 1);
+            for (size_t dimIdx = 1; dimIdx < dims.size(); dimIdx++)
+            {
+                otherChunks[dimIdx] = (dims[dimIdx] + chunks[dimIdx] - 1) / chunks[dimIdx];
+                numOtherChunks *= otherChunks[dimIdx];
+            }
+
+            const hsize_t chunkRows = chunks[0];
+            if (rowOffset % chunkRows == 0)
+            {
+                std::vector<unsigned char> buffer;
+                std::vector<hsize_t> srcOffset(dims.size());
+                std::vector<hsize_t> dstOffset(dims.size());
+                for (hsize_t row = 0; row < numRows; row += chunkRows)
+                {
+                    if (row + chunkRows > numRows && !isLast) break;
+
+                    for (size_t otherIdx = 0; otherIdx < numOtherChunks; otherIdx++)
+                    {
+                        size_t rest = otherIdx;
+                        for (size_t dimIdx = dims.size(); dimIdx-- > 1;)
+                        {
+                            srcOffset[dimIdx] = (rest % otherChunks[dimIdx]) * chunks[dimIdx];
+                            rest /= otherChunks[dimIdx];
+                        }
+
+                        srcOffset[0] = row;
+                        dstOffset = srcOffset;
+                        dstOffset[0] = rowOffset + row;
+
+                        // Chunks that were never written read back as the fill value in both.
+                        hsize_t size = 0;
+                        herr_t status;
+                        H5E_BEGIN_TRY
+                        {
+                            status = H5Dget_chunk_storage_size(src, srcOffset.data(), &size);
+                        }
+                        H5E_END_TRY;
+                        if (status < 0 || size == 0) continue;
+
+                        uint32_t filterMask = 0;
+                        buffer.resize(size);
+                        check(H5Dread_chunk(src, H5P_DEFAULT, srcOffset.data(), &filterMask,
+                                            buffer.data()),
+                              "read a chunk");
+                        check(H5Dwrite_chunk(dst, H5P_DEFAULT, filterMask, dstOffset.data(),
+                                             size, buffer.data()),
+                              "write a chunk");
+                        stats.copiedChunks++;
+                    }
+
+                    rowsDone = std::min(numRows, row + chunkRows);
+                }
+            }
+        }
+
+        if (dims.empty() || rowsDone < numRows)
+        {
+            rewriteRows(src, dst, rowsDone, numRows, rowOffset);
+            stats.rewrittenRows += numRows - rowsDone;
+        }
+    }
+}  // namespace
+
+namespace Ingester
+{
+    IodaConcat::IodaConcat(const std::string& dimName) :
+        dimName_(dimName)
+    {
+    }
+
+    ConcatStats IodaConcat::concat(const std::vector<std::string>& inputs,
+                                   const std::string& output) const
+    {
+        if (inputs.empty())
+        {
+            throw eckit::BadParameter("There are no files to concatenate into " + output + ".");
+        }
+
+        std::vector<std::unique_ptr<Hdf5Handle>> files;
+        for (const auto& input : inputs)
+        {
+            hid_t fileId;
+            H5E_BEGIN_TRY
+            {
+                fileId = H5Fopen(input.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+            }
+            H5E_END_TRY;
+
+            if (fileId < 0) throw eckit::BadValue("Couldn't open the file " + input + ".");
+            files.push_back(std::make_unique<Hdf5Handle>(fileId, H5Fclose));
+        }
+
+        // Find the variables along the dimension in the first file.
+        const hid_t first = files.front()->get();
+        const auto entries = listEntries(first);
+        const std::string dimPath = "/" + dimName_;
+
+        std::vector<VarInfo> vars;
+        for (const auto& entry : entries)
+        {
+            if (entry.isGroup) continue;
+
+            Hdf5Handle dataset(H5Dopen2(first, entry.path.c_str(), H5P_DEFAULT), H5Dclose);
+            const auto dims = extent(dataset.get());
+
+            VarInfo var;
+            var.path = entry.path;
+            var.isScale = H5DSis_scale(dataset.get()) > 0;
+            var.scales = scalePaths(dataset.get(), dims.size());
+            var.isAlong = entry.path == dimPath ||
+                          (!dims.empty() && std::find(var.scales[0].begin(),
+                                                      var.scales[0].end(),
+                                                      dimPath) != var.scales[0].end());
+            vars.push_back(var);
+        }
+
+        if (std::none_of(vars.begin(), vars.end(),
+                         [&dimPath](const VarInfo& var) { return var.path == dimPath; }))
+        {
+            std::ostringstream errStr;
+            errStr << inputs.front() << " has no " << dimName_ << " dimension.";
+            throw eckit::BadValue(errStr.str());
+        }
+
+        // Check the files have the same schema, and the same dimension scales (except the one
+        // they are concatenated along) once.
+        std::vector<hsize_t> numRows;
+        for (size_t fileIdx = 0; fileIdx < files.size(); fileIdx++)
+        {
+            const hid_t file = files[fileIdx]->get();
+            Hdf5Handle dimVar(H5Dopen2(file, dimPath.c_str(), H5P_DEFAULT), H5Dclose);
+            const auto dimExtent = dimVar.isValid() ? extent(dimVar.get())
+                                                    : std::vector<hsize_t>();
+            numRows.push_back(dimExtent.empty() ? 0 : dimExtent[0]);
+            if (fileIdx == 0) continue;
+
+            auto mismatch = [&](const std::string& what)
+            {
+                std::ostringstream errStr;
+                errStr << inputs[fileIdx] << " can't be concatenated with " << inputs.front();
+                errStr << ": " << what << ".";
+                throw eckit::BadValue(errStr.str());
+            };
+
+            const auto fileEntries = listEntries(file);
+            if (fileEntries.size() != entries.size()) mismatch("they have different variables");
+
+            std::unordered_map<std::string, bool> kinds;
+            for (const auto& entry : fileEntries) kinds.insert({entry.path, entry.isGroup});
+            for (const auto& entry : entries)
+            {
+                const auto kindIt = kinds.find(entry.path);
+                if (kindIt == kinds.end() || kindIt->second != entry.isGroup)
+                {
+                    mismatch(entry.path + " is missing");
+                }
+            }
+
+            for (const auto& var : vars)
+            {
+                Hdf5Handle srcVar(H5Dopen2(first, var.path.c_str(), H5P_DEFAULT), H5Dclose);
+                Hdf5Handle fileVar(H5Dopen2(file, var.path.c_str(), H5P_DEFAULT), H5Dclose);
+                Hdf5Handle srcType(H5Dget_type(srcVar.get()), H5Tclose);
+                Hdf5Handle fileType(H5Dget_type(fileVar.get()), H5Tclose);
+                if (H5Tequal(srcType.get(), fileType.get()) <= 0)
+                {
+                    mismatch(var.path + " has another type");
+                }
+
+                auto srcDims = extent(srcVar.get());
+                auto fileDims = extent(fileVar.get());
+                if (var.isAlong && !fileDims.empty())
+                {
+                    if (fileDims[0] != numRows.back()) mismatch(var.path + " has other rows");
+                    srcDims[0] = fileDims[0];
+                }
+
+                if (srcDims != fileDims) mismatch(var.path + " has other dimensions");
+
+                if (var.isScale && !var.isAlong &&
+                    readValues(srcVar.get()) != readValues(fileVar.get()))
+                {
+                    mismatch("the values of the dimension " + var.path + " differ");
+                }
+            }
+        }
+
+        hsize_t totalRows = 0;
+        for (const auto rows : numRows) totalRows += rows;
+
+        // Make the output like the first file.
+        Hdf5Handle fcpl(H5Fget_create_plist(first), H5Pclose);
+        Hdf5Handle fapl(H5Fget_access_plist(first), H5Pclose);
+        Hdf5Handle out(checked(H5Fcreate(output.c_str(), H5F_ACC_TRUNC, fcpl.get(), fapl.get()),
+                               "create the file " + output),
+                       H5Fclose);
+
+        {
+            Hdf5Handle srcRoot(H5Gopen2(first, "/", H5P_DEFAULT), H5Gclose);
+            Hdf5Handle outRoot(H5Gopen2(out.get(), "/", H5P_DEFAULT), H5Gclose);
+            copyAttributes(srcRoot.get(), outRoot.get(), "/");
+        }
+
+        for (const auto& entry : entries)
+        {
+            const std::string what = "create " + entry.path + " in " + output;
+            if (entry.isGroup)
+            {
+                Hdf5Handle srcGroup(H5Gopen2(first, entry.path.c_str(), H5P_DEFAULT), H5Gclose);
+                Hdf5Handle gcpl(H5Gget_create_plist(srcGroup.get()), H5Pclose);
+                Hdf5Handle group(checked(H5Gcreate2(out.get(), entry.path.c_str(), H5P_DEFAULT,
+                                                    gcpl.get(), H5P_DEFAULT), what),
+                                 H5Gclose);
+                copyAttributes(srcGroup.get(), group.get(), entry.path);
+                continue;
+            }
+
+            const auto& var = *std::find_if(vars.begin(), vars.end(),
+                [&entry](const VarInfo& info) { return info.path == entry.path; });
+
+            Hdf5Handle srcVar(H5Dopen2(first, entry.path.c_str(), H5P_DEFAULT), H5Dclose);
+            Hdf5Handle type(H5Dget_type(srcVar.get()), H5Tclose);
+            Hdf5Handle dcpl(H5Dget_create_plist(srcVar.get()), H5Pclose);
+
+            Hdf5Handle space(outputSpace(srcVar.get(), var.isAlong, totalRows), H5Sclose);
+            Hdf5Handle dataset(checked(H5Dcreate2(out.get(), entry.path.c_str(), type.get(),
+                                                  space.get(), H5P_DEFAULT, dcpl.get(),
+                                                  H5P_DEFAULT), what),
+                               H5Dclose);
+            copyAttributes(srcVar.get(), dataset.get(), entry.path);
+        }
+
+        // Attach the dimension scales again (once they all exist), then copy the rows.
+        ConcatStats stats;
+        for (const auto& var : vars)
+        {
+            Hdf5Handle dataset(H5Dopen2(out.get(), var.path.c_str(), H5P_DEFAULT), H5Dclose);
+            for (size_t dimIdx = 0; dimIdx < var.scales.size(); dimIdx++)
+            {
+                for (const auto& scalePath : var.scales[dimIdx])
+                {
+                    if (scalePath == var.path) continue;
+
+                    Hdf5Handle scale(checked(H5Dopen2(out.get(), scalePath.c_str(),
+                                                      H5P_DEFAULT),
+                                             "open the dimension " + scalePath),
+                                     H5Dclose);
+                    check(H5DSattach_scale(dataset.get(), scale.get(),
+                                           static_cast<unsigned int>(dimIdx)),
+                          "attach the dimension " + scalePath + " to " + var.path);
+                }
+            }
+
+            hsize_t rowOffset = 0;
+            const size_t numSources = var.isAlong ? files.size() : 1;
+            for (size_t fileIdx = 0; fileIdx < numSources; fileIdx++)
+            {
+                Hdf5Handle srcVar(H5Dopen2(files[fileIdx]->get(), var.path.c_str(), H5P_DEFAULT),
+                                  H5Dclose);
+                copyRows(srcVar.get(), dataset.get(), rowOffset, fileIdx + 1 == numSources,
+                         stats);
+                rowOffset += var.isAlong ? numRows[fileIdx] : 0;
+            }
+        }
+
+        check(H5Fflush(out.get(), H5F_SCOPE_LOCAL), "write " + output);
+
+        stats.numFiles = files.size();
+        stats.numLocations = static_cast<size_t>(totalRows);
+        return stats;
+    }
+}  // namespace Ingester
@@ -0,0 +1,57 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace Ingester
+{
+    /// \brief What a concatenation did.
+    struct ConcatStats
+    {
+        size_t numFiles = 0;
+        size_t numLocations = 0;  // Along the concatenated dimension
+        size_t copiedChunks = 0;  // Chunks copied as they are (still compressed)
+        size_t rewrittenRows = 0;  // Rows read and written again through the filters
+    };
+
+    /// \brief Concatenates ioda (HDF5) files with the same schema along a dimension (Location
+    ///        by default), the way the files of the ranks, BUFR files or runs of a conversion
+    ///        are merged into one file per product.
+    ///
+    ///        The output is built like the first file: the same groups, attributes, types,
+    ///        chunks, filters and fill values, with the dimension scales attached again. The
+    ///        variables along the dimension get the rows of every file in order, the others
+    ///        (and the other dimension scales, which must be the same in every file) are taken
+    ///        from the first file. Chunks that land on a chunk boundary of the output are copied
+    ///        as they are without being decompressed (H5Dread_chunk / H5Dwrite_chunk), only the
+    ///        rest (ex: the partial last chunk of a file, or strings) is read and written again.
+    class IodaConcat
+    {
+     public:
+        /// \brief Constructor.
+        /// \param dimName The name of the dimension to concatenate along.
+        explicit IodaConcat(const std::string& dimName = "Location");
+
+        /// \brief Concatenate files into a new file (replaced if it exists). Throws if the files
+        ///        don't have the same variables, types and dimensions (other than dimName) or
+        ///        if their dimension scales differ.
+        /// \param inputs The paths of the files (in order).
+        /// \param output The path of the new file.
+        /// \return What was done.
+        ConcatStats concat(const std::vector<std::string>& inputs,
+                           const std::string& output) const;
+
+     private:
+        /// \brief The name of the dimension to concatenate along.
+        const std::string dimName_;
+    };
+}  // namespace Ingester
@@ -0,0 +1,250 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "ChunkWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "eckit/exception/Exceptions.h"
+
+#include "../BufrParser/Query/Parallel.h"
+#include "../BufrParser/Query/Profiler.h"
+
+#if defined(BUFR_HAS_ZLIB) && defined(BUFR_HAS_HDF5)
+    #include <hdf5.h>
+    #include <zlib.h>
+
+    #include "Hdf5Handle.h"
+
+    // H5Dwrite_chunk was added in HDF5 1.10.2.
+    #if H5_VERSION_GE(1, 10, 2)
+        #define BUFR_HAS_DIRECT_CHUNKS 1
+    #endif
+#endif
+
+
+#ifdef BUFR_HAS_DIRECT_CHUNKS
+namespace
+{
+    /// \brief The number of chunks compressed at once by each thread (bounds the memory held
+    ///        by the compressed chunks waiting to be written).
+    const size_t ChunksPerThread = 4;
+
+    /// \brief A chunk, compressed the way the deflate filter does it.
+    struct Chunk
+    {
+        std::vector<hsize_t> offset;
+        std::vector<unsigned char> bytes;
+    };
+}  // namespace
+#endif
+
+namespace Ingester
+{
+    ChunkWriter::ChunkWriter(const std::string& filePath, size_t numThreads) :
+        numThreads_(numThreads > 0 ? numThreads : bufr::Executor::numThreads())
+    {
+#ifdef BUFR_HAS_DIRECT_CHUNKS
+        if (numThreads_ <= 1) return;
+
+        // The file is already open (through ioda), so HDF5 shares it. It fails if the file was
+        // opened with other access properties, in which case the variables go through ioda.
+        H5E_BEGIN_TRY
+        {
+            fileId_ = H5Fopen(filePath.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+        }
+        H5E_END_TRY;
+#else
+        static_cast<void>(filePath);
+#endif
+    }
+
+    ChunkWriter::~ChunkWriter()
+    {
+#ifdef BUFR_HAS_DIRECT_CHUNKS
+        if (fileId_ >= 0) H5Fclose(static_cast<hid_t>(fileId_));
+#endif
+    }
+
+    bool ChunkWriter::write(const std::string& varPath,
+                            const void* values,
+                            size_t numValues,
+                            size_t elementSize,
+                            const void* fillValue) const
+    {
+#ifdef BUFR_HAS_DIRECT_CHUNKS
+        if (fileId_ < 0 || numValues == 0) return false;
+
+        bufr::ScopedTimer timer("encode.chunks");
+
+        // Only the variables with just the deflate filter are written this way, so the chunks
+        // are exactly what HDF5 would have written.
+        Hdf5Handle dataset(H5Dopen2(static_cast<hid_t>(fileId_), varPath.c_str(), H5P_DEFAULT),
+                           H5Dclose);
+        if (!dataset.isValid()) return false;
+
+        Hdf5Handle plist(H5Dget_create_plist(dataset.get()), H5Pclose);
+        Hdf5Handle type(H5Dget_type(dataset.get()), H5Tclose);
+        Hdf5Handle space(H5Dget_space(dataset.get()), H5Sclose);
+        if (!plist.isValid() || !type.isValid() || !space.isValid()) return false;
+
+        if (H5Pget_layout(plist.get()) != H5D_CHUNKED || H5Pget_nfilters(plist.get()) != 1)
+        {
+            return false;
+        }
+
+        unsigned int flags = 0;
+        size_t numLevels = 1;
+        unsigned int level = 0;
+        unsigned int filterConfig = 0;
+        const auto filter = H5Pget_filter2(plist.get(), 0, &flags, &numLevels, &level, 0,
+                                           nullptr, &filterConfig);
+        if (filter != H5Z_FILTER_DEFLATE || numLevels < 1) return false;
+
+        // The values are copied as they are, so they must be stored the way they are in memory.
+        // Fixed-length strings are bytes without an order.
+        const auto typeClass = H5Tget_class(type.get());
+        const bool isFixedString = typeClass == H5T_STRING && H5Tis_variable_str(type.get()) == 0;
+        if ((typeClass != H5T_INTEGER && typeClass != H5T_FLOAT && !isFixedString) ||
+            H5Tget_size(type.get()) != elementSize ||
+            (!isFixedString && H5Tget_order(type.get()) != H5Tget_order(H5T_NATIVE_INT)))
+        {
+            return false;
+        }
+
+        const int rank = H5Sget_simple_extent_ndims(space.get());
+        if (rank <= 0) return false;
+
+        std::vector<hsize_t> dims(rank);
+        std::vector<hsize_t> chunkDims(rank);
+        H5Sget_simple_extent_dims(space.get(), dims.data(), nullptr);
+        if (H5Pget_chunk(plist.get(), rank, chunkDims.data()) != rank) return false;
+
+        size_t totalValues = 1;
+        size_t chunkValues = 1;
+        size_t numChunks = 1;
+        std::vector<size_t> chunksPerDim(rank);
+        for (int dimIdx = 0; dimIdx < rank; dimIdx++)
+        {
+            if (chunkDims[dimIdx] == 0) return false;
+
+            totalValues *= dims[dimIdx];
+            chunkValues *= chunkDims[dimIdx];
+            chunksPerDim[dimIdx] = (dims[dimIdx] + chunkDims[dimIdx] - 1) / chunkDims[dimIdx];
+            numChunks *= chunksPerDim[dimIdx];
+        }
+
+        if (totalValues != numValues) return false;
+
+        const auto* src = static_cast<const unsigned char*>(values);
+        const size_t rowBytes = chunkDims[rank - 1] * elementSize;
+        const size_t chunkBytes = chunkValues * elementSize;
+
+        // Copy a chunk out of the values (the parts past the data are the fill value) and
+        // compress it.
+        auto makeChunk = [&](size_t chunkIdx, Chunk& chunk)
+        {
+            chunk.offset.assign(rank, 0);
+            for (int dimIdx = rank - 1; dimIdx >= 0; dimIdx--)
+            {
+                chunk.offset[dimIdx] = (chunkIdx % chunksPerDim[dimIdx]) * chunkDims[dimIdx];
+                chunkIdx /= chunksPerDim[dimIdx];
+            }
+
+            std::vector<unsigned char> raw(chunkBytes);
+            for (size_t valIdx = 0; valIdx < chunkValues; valIdx++)
+            {
+                std::memcpy(&raw[valIdx * elementSize], fillValue, elementSize);
+            }
+
+            // Copy the rows (along the last dimension) of the chunk that are in the data.
+            const size_t numRows = chunkValues / chunkDims[rank - 1];
+            const size_t rowLength = std::min(chunkDims[rank - 1],
+                                              dims[rank - 1] - chunk.offset[rank - 1]);
+            for (size_t rowIdx = 0; rowIdx < numRows; rowIdx++)
+            {
+                size_t srcIdx = chunk.offset[rank - 1];
+                size_t stride = dims[rank - 1];
+                size_t rest = rowIdx;
+                bool isInData = true;
+                for (int dimIdx = rank - 2; dimIdx >= 0 && isInData; dimIdx--)
+                {
+                    const hsize_t pos = chunk.offset[dimIdx] + rest % chunkDims[dimIdx];
+                    rest /= chunkDims[dimIdx];
+                    isInData = pos < dims[dimIdx];
+                    srcIdx += pos * stride;
+                    stride *= dims[dimIdx];
+                }
+
+                if (!isInData) continue;
+
+                std::memcpy(&raw[rowIdx * rowBytes],
+                            src + srcIdx * elementSize,
+                            rowLength * elementSize);
+            }
+
+            uLongf compressedSize = compressBound(static_cast<uLong>(chunkBytes));
+            chunk.bytes.resize(compressedSize);
+            const int status = compress2(chunk.bytes.data(),
+                                         &compressedSize,
+                                         raw.data(),
+                                         static_cast<uLong>(chunkBytes),
+                                         static_cast<int>(level));
+            if (status != Z_OK)
+            {
+                std::ostringstream errStr;
+                errStr << "Couldn't compress a chunk of " << varPath << ".";
+                throw eckit::BadValue(errStr.str());
+            }
+
+            chunk.bytes.resize(compressedSize);
+        };
+
+        // Compress a batch of chunks in parallel, then write them in order (HDF5 isn't thread
+        // safe).
+        const size_t batchSize = numThreads_ * ChunksPerThread;
+        std::vector<Chunk> batch;
+        for (size_t batchStart = 0; batchStart < numChunks; batchStart += batchSize)
+        {
+            const size_t batchCount = std::min(batchSize, numChunks - batchStart);
+            batch.resize(batchCount);
+            bufr::parallelFor(batchCount, numThreads_, [&](size_t idx)
+            {
+                makeChunk(batchStart + idx, batch[idx]);
+            });
+
+            for (const auto& chunk : batch)
+            {
+                if (H5Dwrite_chunk(dataset.get(),
+                                   H5P_DEFAULT,
+                                   0,
+                                   chunk.offset.data(),
+                                   chunk.bytes.size(),
+                                   chunk.bytes.data()) < 0)
+                {
+                    std::ostringstream errStr;
+                    errStr << "Couldn't write a chunk of " << varPath << ".";
+                    throw eckit::BadValue(errStr.str());
+                }
+            }
+        }
+
+        bufr::Profiler::count("encode.chunks", numChunks);
+        return true;
+#else
+        static_cast<void>(varPath);
+        static_cast<void>(values);
+        static_cast<void>(numValues);
+        static_cast<void>(elementSize);
+        static_cast<void>(fillValue);
+        return false;
+#endif
+    }
+}  // namespace Ingester
@@ -0,0 +1,61 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace Ingester
+{
+    /// \brief Writes the gzip compressed variables of an HDF5 file with its chunks compressed
+    ///        on the threads of the shared pool (see bufr::Executor) and written straight to the
+    ///        file (H5Dwrite_chunk). The deflate filter of HDF5 compresses them one after the
+    ///        other on the writing thread otherwise. The chunks are compressed the way the
+    ///        filter does (zlib at the level of the variable), so the files are the same and
+    ///        HDF5 reads them back with its filter. Needs zlib and HDF5 1.10.2 or newer
+    ///        (BUFR_HAS_ZLIB and BUFR_HAS_HDF5), the variables are written through ioda
+    ///        otherwise.
+    class ChunkWriter
+    {
+     public:
+        /// \brief Open an HDF5 file that is already open for writing (HDF5 shares the open
+        ///        file with the first handle).
+        /// \param filePath The path of the file.
+        /// \param numThreads The number of threads compressing the chunks (0 for all the
+        ///        threads of the shared pool).
+        ChunkWriter(const std::string& filePath, size_t numThreads);
+
+        ~ChunkWriter();
+
+        ChunkWriter(const ChunkWriter&) = delete;
+        ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+        /// \brief Write all the values of a variable that was just created.
+        /// \param varPath The path of the variable in the file (ex: MetaData/latitude).
+        /// \param values The values (in row major order).
+        /// \param numValues The number of values.
+        /// \param elementSize The size of a value (in bytes).
+        /// \param fillValue The value the parts of the edge chunks past the data are filled with.
+        /// \return False if the variable can't be written this way (it has other filters, the
+        ///         element size is different ...), in which case nothing was written.
+        bool write(const std::string& varPath,
+                   const void* values,
+                   size_t numValues,
+                   size_t elementSize,
+                   const void* fillValue) const;
+
+     private:
+        /// \brief The handle of the file (an hid_t, negative if it isn't open).
+        std::int64_t fileId_ = -1;
+
+        /// \brief The number of threads compressing the chunks.
+        size_t numThreads_;
+    };
+}  // namespace Ingester
@@ -0,0 +1,35 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <hdf5.h>
+
+
+namespace Ingester
+{
+    /// \brief Closes an HDF5 handle (file, group, dataset ...) when it goes out of scope.
+    class Hdf5Handle
+    {
+     public:
+        /// \brief Take a handle.
+        /// \param id The handle (negative if the call that made it failed).
+        /// \param close The function that closes it (ex: H5Dclose).
+        Hdf5Handle(hid_t id, herr_t (*close)(hid_t)) : id_(id), close_(close) {}
+        ~Hdf5Handle() { if (id_ >= 0) close_(id_); }
+
+        Hdf5Handle(const Hdf5Handle&) = delete;
+        Hdf5Handle& operator=(const Hdf5Handle&) = delete;
+
+        hid_t get() const { return id_; }
+        bool isValid() const { return id_ >= 0; }
+
+     private:
+        hid_t id_;
+        herr_t (*close_)(hid_t);
+    };
+}  // namespace Ingester
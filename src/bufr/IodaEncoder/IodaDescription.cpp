@@ -20,6 +20,10 @@ namespace
         const char* Dimensions = "dimensions";
         const char* Variables = "variables";
         const char* Globals = "globals";
+        const char* WriteProcesses = "writeProcesses";
+        const char* Appendable = "appendable";
+        const char* TargetChunkBytes = "targetChunkBytes";
+        const char* CompressionThreads = "compressionThreads";
 
         namespace Dimension
         {
@@ -39,6 +43,9 @@ namespace
             const char* Coords = "coordinates";
             const char* Chunks = "chunks";
             const char* CompressionLevel = "compressionLevel";
+            const char* Compression = "compression";
+            const char* SignificantBits = "significantBits";
+            const char* StringLength = "stringLength";
         }  // namespace Variable
 
         namespace Global
@@ -74,7 +81,8 @@ namespace Ingester
         }
         else
         {
-            if (backend_ == ioda::Engines::BackendNames::ObsStore)
+            if (backend_ == ioda::Engines::BackendNames::ObsStore ||
+                backend_ == ioda::Engines::BackendNames::Hdf5Mem)
             {
                 filepath_ = "";
             }
@@ -84,6 +92,44 @@ namespace Ingester
             }
         }
 
+        if (conf.has(ConfKeys::WriteProcesses))
+        {
+            const int writeProcesses = conf.getInt(ConfKeys::WriteProcesses);
+            if (writeProcesses < 1)
+            {
+                throw eckit::BadParameter("ioda::writeProcesses must be at least 1.");
+            }
+
+            writeProcesses_ = static_cast<size_t>(writeProcesses);
+        }
+
+        if (conf.has(ConfKeys::Appendable))
+        {
+            appendable_ = conf.getBool(ConfKeys::Appendable);
+        }
+
+        if (conf.has(ConfKeys::TargetChunkBytes))
+        {
+            const int targetChunkBytes = conf.getInt(ConfKeys::TargetChunkBytes);
+            if (targetChunkBytes < 0)
+            {
+                throw eckit::BadParameter("ioda::targetChunkBytes can't be negative.");
+            }
+
+            targetChunkBytes_ = static_cast<size_t>(targetChunkBytes);
+        }
+
+        if (conf.has(ConfKeys::CompressionThreads))
+        {
+            const int compressionThreads = conf.getInt(ConfKeys::CompressionThreads);
+            if (compressionThreads < 0)
+            {
+                throw eckit::BadParameter("ioda::compressionThreads can't be negative.");
+            }
+
+            compressionThreads_ = static_cast<size_t>(compressionThreads);
+        }
+
         if (conf.has(ConfKeys::Dimensions))
         {
             auto dimConfs = conf.getSubConfigurations(ConfKeys::Dimensions);
@@ -177,7 +223,32 @@ namespace Ingester
                 variable.chunks = chunks;
             }
 
-            variable.compressionLevel = 6;
+            if (varConf.has(ConfKeys::Variable::Compression))
+            {
+                auto codec = boost::algorithm::to_lower_copy(
+                    varConf.getString(ConfKeys::Variable::Compression));
+
+                if (codec == "gzip")
+                {
+                    variable.compression.codec = Compression::Codec::Gzip;
+                }
+                else if (codec == "szip")
+                {
+                    variable.compression.codec = Compression::Codec::Szip;
+                }
+                else if (codec == "none")
+                {
+                    variable.compression.codec = Compression::Codec::None;
+                }
+                else
+                {
+                    std::ostringstream errStr;
+                    errStr << "Unknown compression " << codec << " for variable ";
+                    errStr << variable.name << " (use gzip, szip or none).";
+                    throw eckit::BadParameter(errStr.str());
+                }
+            }
+
             if (varConf.has(ConfKeys::Variable::CompressionLevel))
             {
                 int compressionLevel = varConf.getInt(ConfKeys::Variable::CompressionLevel);
@@ -186,7 +257,50 @@ namespace Ingester
                     throw eckit::BadParameter("GZip compression level must be a number 0-9");
                 }
 
-                variable.compressionLevel = varConf.getInt(ConfKeys::Variable::CompressionLevel);
+                variable.compression.level = compressionLevel;
+            }
+
+            if (varConf.has(ConfKeys::Variable::SignificantBits))
+            {
+                int significantBits = varConf.getInt(ConfKeys::Variable::SignificantBits);
+                if (significantBits < 1)
+                {
+                    throw eckit::BadParameter("significantBits must be at least 1.");
+                }
+
+                variable.compression.significantBits = significantBits;
+            }
+
+            if (varConf.has(ConfKeys::Variable::StringLength))
+            {
+                if (varConf.isString(ConfKeys::Variable::StringLength))
+                {
+                    if (varConf.getString(ConfKeys::Variable::StringLength) != "auto")
+                    {
+                        throw eckit::BadParameter("stringLength must be a number or auto.");
+                    }
+
+                    variable.compression.stringLength = Compression::AutoStringLength;
+                }
+                else
+                {
+                    int stringLength = varConf.getInt(ConfKeys::Variable::StringLength);
+                    if (stringLength < 1)
+                    {
+                        throw eckit::BadParameter("stringLength must be at least 1.");
+                    }
+
+                    variable.compression.stringLength = stringLength;
+                }
+
+                // The width is fixed when the file is made, later locations may not fit.
+                if (appendable_)
+                {
+                    std::ostringstream errStr;
+                    errStr << "Variable " << variable.name << " can't have a stringLength ";
+                    errStr << "in an appendable output.";
+                    throw eckit::BadParameter(errStr.str());
+                }
             }
 
             addVariable(variable);
@@ -271,6 +385,10 @@ namespace Ingester
         {
             setBackend(ioda::Engines::BackendNames::ObsStore);
         }
+        else if (backend_lowercase == "hdf5mem" || backend_lowercase == "hdf5-mem")
+        {
+            setBackend(ioda::Engines::BackendNames::Hdf5Mem);
+        }
         else
         {
             throw eckit::BadParameter("Unknown ioda::backend specified.");
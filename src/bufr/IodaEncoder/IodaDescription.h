@@ -16,6 +16,7 @@
 #include "ioda/Group.h"
 
 #include "../BufrParser/Query/QueryParser.h"
+#include "../DataObject.h"
 
 namespace Ingester
 {
@@ -42,7 +43,7 @@ namespace Ingester
         std::shared_ptr<std::string> coordinates;  // Optional
         std::shared_ptr<Range> range;  // Optional
         std::vector<ioda::Dimensions_t> chunks;  // Optional
-        int compressionLevel;  // Optional
+        Compression compression;  // Optional
     };
 
     struct GlobalDescriptionBase
@@ -119,6 +120,10 @@ namespace Ingester
         inline DimDescriptions getDims() const { return dimensions_; }
         inline VariableDescriptions getVariables() const { return variables_; }
         inline GlobalDescriptions getGlobals() const { return globals_; }
+        inline size_t getWriteProcesses() const { return writeProcesses_; }
+        inline bool isAppendable() const { return appendable_; }
+        inline size_t getTargetChunkBytes() const { return targetChunkBytes_; }
+        inline size_t getCompressionThreads() const { return compressionThreads_; }
 
      private:
         /// \brief The backend type to use
@@ -136,6 +141,20 @@ namespace Ingester
         /// \brief Collection of defined globals
         GlobalDescriptions globals_;
 
+        /// \brief The number of processes that write the files of the categories concurrently
+        size_t writeProcesses_ = 1;
+
+        /// \brief Create the Location dimension unlimited so locations can be appended later
+        bool appendable_ = false;
+
+        /// \brief The size of the chunks picked for variables without chunks (0 uses the chunk
+        ///        sizes of their dimensions)
+        size_t targetChunkBytes_ = 1024 * 1024;
+
+        /// \brief The number of threads compressing the chunks of the gzip variables of the
+        ///        files (0 uses the threads of the shared pool, 1 leaves it to HDF5)
+        size_t compressionThreads_ = 0;
+
         /// \brief Collection of defined variables
         void setBackend(const std::string& backend);
     };
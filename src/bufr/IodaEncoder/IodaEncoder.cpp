@@ -7,10 +7,20 @@
 
 #include "IodaEncoder.h"
 
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
 #include <memory>
+#include <set>
 #include <map>
 #include <string>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "eckit/exception/Exceptions.h"
 #include "oops/util/Logger.h"
@@ -18,25 +28,76 @@
 #include "ioda/Layout.h"
 #include "ioda/Misc/DimensionScales.h"
 
+#include "../BufrParser/Query/Profiler.h"
+#include "ChunkWriter.h"
+
 
 namespace Ingester
 {
     static const char* LocationName = "Location";
     static const char* DefualtDimName = "dim";
 
+    /// \brief Pick the chunk shape of a variable. JEDI reads ranges of locations with all the
+    ///        values of each one, so the chunks keep the other dimensions whole and get as many
+    ///        locations as fit in the target size. When a single location doesn't fit, the largest
+    ///        other dimension is halved until it does.
+    static std::vector<ioda::Dimensions_t> autoChunks(const std::vector<int>& dims,
+                                                      size_t elementSize,
+                                                      size_t targetBytes)
+    {
+        std::vector<ioda::Dimensions_t> chunks(dims.begin(), dims.end());
+        for (auto& chunk : chunks) chunk = std::max<ioda::Dimensions_t>(chunk, 1);
+
+        auto rowBytes = [&chunks, elementSize]()
+        {
+            size_t bytes = elementSize;
+            for (size_t dimIdx = 1; dimIdx < chunks.size(); dimIdx++) bytes *= chunks[dimIdx];
+            return bytes;
+        };
+
+        while (rowBytes() > targetBytes)
+        {
+            auto largest = std::max_element(chunks.begin() + 1, chunks.end());
+            if (largest == chunks.end() || *largest == 1) break;
+            *largest = (*largest + 1) / 2;
+        }
+
+        const auto rows = std::max<size_t>(1, targetBytes / rowBytes());
+        chunks[0] = std::min(chunks[0], static_cast<ioda::Dimensions_t>(rows));
+
+        return chunks;
+    }
+
+    /// \brief Name a category for the Profiler timers (ex: "metop-b/north").
+    static std::string categoryLabel(const SubCategory& categories)
+    {
+        if (categories.empty()) return "all";
+
+        std::string label;
+        for (const auto& category : categories)
+        {
+            label += (label.empty() ? "" : "/") + category;
+        }
+
+        return label;
+    }
+
+    static bool fileExists(const std::string& path)
+    {
+        struct stat fileStat;
+        return stat(path.c_str(), &fileStat) == 0;
+    }
+
     IodaEncoder::IodaEncoder(const eckit::Configuration& conf):
-        description_(IodaDescription(conf))
+        description_(IodaDescription(conf)),
+        compressionThreads_(description_.getCompressionThreads())
     {
     }
 
     std::map<SubCategory, ioda::ObsGroup>
         IodaEncoder::encode(const std::shared_ptr<DataContainer>& dataContainer, bool append)
     {
-        auto backendParams = ioda::Engines::BackendCreationParameters();
-        std::map<SubCategory, ioda::ObsGroup> obsGroups;
-
         // Get the named dimensions
-        NamedPathDims namedLocDims;
         NamedPathDims namedExtraDims;
 
         // Get a list of all the named dimensions
@@ -80,236 +141,586 @@ namespace Ingester
             }
         }
 
-        // Got through each unique category
-        for (const auto& categories : dataContainer->allSubCategories())
+        // When we find that the primary index is zero we need to skip the category
+        auto isEmptyCategory = [this, &dataContainer](const SubCategory& categories)
         {
-            // Create the dimensions variables
-            std::map<std::string, std::shared_ptr<DimensionDataBase>> dimMap;
-
             auto dataObjectGroupBy = dataContainer->getGroupByObject(
                 description_.getVariables()[0].source, categories);
 
-            // When we find that the primary index is zero we need to skip this category
-            if (dataObjectGroupBy->getDims()[0] == 0)
+            if (dataObjectGroupBy->getDims()[0] != 0) return false;
+
+            for (auto category : categories)
             {
-                for (auto category : categories)
-                {
-                    oops::Log::warning() << "  Skipped category " << category << std::endl;
-                }
+                oops::Log::warning() << "  Skipped category " << category << std::endl;
+            }
+
+            return true;
+        };
 
-                continue;
+        // HDF5 isn't thread safe, so the files of the categories are written concurrently by
+        // child processes. The other backends keep the data in this process.
+        const bool isFile = (description_.getBackend() == ioda::Engines::BackendNames::Hdf5File);
+        const bool checkFirst = description_.getWriteProcesses() > 1 && isFile;
+        auto categoryList = checkFirst ? std::vector<SubCategory>()
+                                       : dataContainer->allSubCategories();
+        if (checkFirst)
+        {
+            for (const auto& categories : dataContainer->allSubCategories())
+            {
+                if (!isEmptyCategory(categories)) categoryList.push_back(categories);
             }
 
-            // Create the root Location dimension for this category
-            auto rootDim = std::make_shared<DimensionData<int>>(dataObjectGroupBy->getDims()[0]);
-            rootDim->dimScale =
-                ioda::NewDimensionScale<int>(LocationName, dataObjectGroupBy->getDims()[0]);
-            dimMap[LocationName] = rootDim;
+            if (categoryList.empty()) return {};
+
+            // Resolve the dimensions of the variables once. They have the same paths in every
+            // category.
+            const auto plan = makePlan(dataContainer, categoryList.front(), namedExtraDims);
+            const size_t numProcesses = std::min(description_.getWriteProcesses(),
+                                                 categoryList.size());
+            if (numProcesses > 1)
+            {
+                return encodeInProcesses(dataContainer, categoryList, numProcesses, append, plan);
+            }
+        }
+
+        // Go through each unique category, checking and encoding it in one go so the fields of
+        // the categories that are read back or made on demand (see DataContainer) are only
+        // loaded once.
+        std::map<SubCategory, ioda::ObsGroup> obsGroups;
+        std::unique_ptr<EncodePlan> plan;
+        for (const auto& categories : categoryList)
+        {
+            if (!checkFirst && isEmptyCategory(categories)) continue;
+
+            // Resolve the dimensions of the variables once (with the first category that has
+            // data). They have the same paths in every category.
+            const bool isFirst = !plan;
+            if (isFirst)
+            {
+                plan = std::make_unique<EncodePlan>(makePlan(dataContainer,
+                                                             categories,
+                                                             namedExtraDims));
+            }
+
+            obsGroups.insert({categories, encodeCategory(dataContainer,
+                                                         categories,
+                                                         append,
+                                                         *plan,
+                                                         isFirst)});
+        }
+
+        return obsGroups;
+    }
+
+    IodaEncoder::EncodePlan IodaEncoder::makePlan(
+        const std::shared_ptr<DataContainer>& dataContainer,
+        const SubCategory& categories,
+        NamedPathDims namedExtraDims) const
+    {
+        EncodePlan plan;
+
+        // The root Location dimension is the first dimension of the group by field
+        NamedPathDims namedLocDims;
+        {
+            auto dataObjectGroupBy = dataContainer->getGroupByObject(
+                description_.getVariables()[0].source, categories);
 
-            // Add the root Location dimension as a named dimension
             auto rootLocation = DimensionDescription();
             rootLocation.name = LocationName;
             rootLocation.source = "";
             namedLocDims[{dataObjectGroupBy->getDimPaths()[0]}] = rootLocation;
+        }
 
-            // Create the dimension data for dimensions which include source data
-            for (const auto& dimDesc : description_.getDims())
+        auto dimNamesOf = [&](const std::shared_ptr<DataObjectBase>& dataObject)
+        {
+            std::vector<std::string> dimNames;
+            for (size_t dimIdx = 0; dimIdx < dataObject->getDimPaths().size(); dimIdx++)
             {
-                if (!dimDesc.source.empty())
-                {
-                    auto dataObject = dataContainer->get(dimDesc.source, categories);
+                const auto& namedPathDims = (dimIdx == 0) ? namedLocDims : namedExtraDims;
+                dimNames.push_back(dimForDimPath(dataObject->getDimPaths()[dimIdx],
+                                                 namedPathDims).name);
+            }
 
-                    // Validate the path for the source field makes sense for the dimension
-                    if (std::find(dimDesc.paths.begin(),
-                                  dimDesc.paths.end(),
-                                  dataObject->getDimPaths().back()) == dimDesc.paths.end())
-                    {
-                        std::stringstream errStr;
-                        errStr << "ioda::dimensions: Source field " << dimDesc.source << " in ";
-                        errStr << dimDesc.name << " is not in the correct path.";
-                        throw eckit::BadParameter(errStr.str());
-                    }
+            return dimNames;
+        };
 
-                    // Create the dimension data
-                    dimMap[dimDesc.name] = dataObject->createDimensionFromData(
-                        dimDesc.name,
-                        dataObject->getDimPaths().size() - 1);
+        // The dimensions which include source data
+        for (const auto& dimDesc : description_.getDims())
+        {
+            if (!dimDesc.source.empty())
+            {
+                auto dataObject = dataContainer->get(dimDesc.source, categories);
+
+                // Validate the path for the source field makes sense for the dimension
+                if (std::find(dimDesc.paths.begin(),
+                              dimDesc.paths.end(),
+                              dataObject->getDimPaths().back()) == dimDesc.paths.end())
+                {
+                    std::stringstream errStr;
+                    errStr << "ioda::dimensions: Source field " << dimDesc.source << " in ";
+                    errStr << dimDesc.name << " is not in the correct path.";
+                    throw eckit::BadParameter(errStr.str());
                 }
+
+                plan.sourceDims.push_back(dimDesc);
             }
+        }
 
-            // Discover and create the dimension data for dimensions with no source field. If
-            // dim is un-named (not listed) then call it dim_<number>
-            int autoGenDimNumber = 2;
-            for (const auto& varDesc : description_.getVariables())
+        // Discover the dimensions with no source field. If dim is un-named (not listed) then
+        // call it dim_<number>
+        int autoGenDimNumber = 2;
+        std::set<std::string> plannedDims;
+        for (const auto& dimDesc : plan.sourceDims) plannedDims.insert(dimDesc.name);
+
+        const auto& varDescs = description_.getVariables();
+        for (size_t varIdx = 0; varIdx < varDescs.size(); varIdx++)
+        {
+            auto dataObject = dataContainer->get(varDescs[varIdx].source, categories);
+
+            for (std::size_t dimIdx  = 1; dimIdx < dataObject->getDimPaths().size(); dimIdx++)
             {
-                auto dataObject = dataContainer->get(varDesc.source, categories);
+                auto dimPath = dataObject->getDimPaths()[dimIdx];
+                std::string dimName = "";
 
-                for (std::size_t dimIdx  = 1; dimIdx < dataObject->getDimPaths().size(); dimIdx++)
+                if (existsInNamedPath(dimPath, namedExtraDims))
                 {
-                    auto dimPath = dataObject->getDimPaths()[dimIdx];
-                    std::string dimName = "";
-
-                    if (existsInNamedPath(dimPath, namedExtraDims))
-                    {
-                        dimName = dimForDimPath(dimPath, namedExtraDims).name;
-                    }
-                    else
-                    {
-                        auto newDimStr = std::ostringstream();
-                        newDimStr << DefualtDimName << "_" << autoGenDimNumber;
+                    dimName = dimForDimPath(dimPath, namedExtraDims).name;
+                }
+                else
+                {
+                    auto newDimStr = std::ostringstream();
+                    newDimStr << DefualtDimName << "_" << autoGenDimNumber;
 
-                        dimName = newDimStr.str();
+                    dimName = newDimStr.str();
 
-                        auto dimDesc = DimensionDescription();
-                        dimDesc.name = dimName;
-                        dimDesc.source = "";
+                    auto dimDesc = DimensionDescription();
+                    dimDesc.name = dimName;
+                    dimDesc.source = "";
 
-                        namedExtraDims[{dimPath}] = dimDesc;
-                        autoGenDimNumber++;
-                    }
+                    namedExtraDims[{dimPath}] = dimDesc;
+                    autoGenDimNumber++;
+                }
 
-                    if (dimMap.find(dimName) == dimMap.end())
-                    {
-                        dimMap[dimName] = dataObject->createEmptyDimension(dimName, dimIdx);
-                    }
+                if (plannedDims.insert(dimName).second)
+                {
+                    plan.emptyDims.push_back({dimName, varIdx, dimIdx});
                 }
             }
+        }
+
+        // The dimension variables to write and the dimensions of each variable
+        for (const auto& dimDesc : plan.sourceDims)
+        {
+            plan.sourceDimNames.push_back(dimNamesOf(dataContainer->get(dimDesc.source,
+                                                                        categories)));
+        }
 
-            // Make the filename string
-            if (description_.getBackend() == ioda::Engines::BackendNames::Hdf5File)
+        for (const auto& varDesc : varDescs)
+        {
+            plan.varDimNames.push_back(dimNamesOf(dataContainer->get(varDesc.source, categories)));
+        }
+
+        return plan;
+    }
+
+    ioda::ObsGroup IodaEncoder::encodeCategory(const std::shared_ptr<DataContainer>& dataContainer,
+                                               const SubCategory& categories,
+                                               bool append,
+                                               const EncodePlan& plan,
+                                               bool reportChunks)
+    {
+        bufr::ScopedTimer categoryTimer("encode.category.",
+                                        bufr::Profiler::isEnabled() ? categoryLabel(categories)
+                                                                    : std::string());
+
+        auto backendParams = ioda::Engines::BackendCreationParameters();
+
+        // Make the filename string
+        if (description_.getBackend() == ioda::Engines::BackendNames::Hdf5File)
+        {
+            backendParams.fileName = makeFilename(dataContainer, categories);
+
+            // Add the locations to the file if it was already written.
+            if (append && fileExists(backendParams.fileName))
+            {
+                return appendCategory(dataContainer, categories, backendParams.fileName);
+            }
+        }
+        else if (description_.getBackend() == ioda::Engines::BackendNames::Hdf5Mem)
+        {
+            // The in-memory HDF5 files need unique names, but the name is optional.
+            if (!description_.getFilepath().empty())
             {
-                std::string filename = description_.getFilepath();
+                backendParams.fileName = makeFilename(dataContainer, categories);
+            }
+            else
+            {
+                backendParams.fileName = "ioda";
+                for (const auto& category : categories) backendParams.fileName += "." + category;
+            }
+        }
+
+        // Create the dimensions variables
+        std::map<std::string, std::shared_ptr<DimensionDataBase>> dimMap;
+
+        auto dataObjectGroupBy = dataContainer->getGroupByObject(
+            description_.getVariables()[0].source, categories);
+
+        // Create the root Location dimension for this category. Appendable files can grow it
+        // later (HDF5 needs it to be chunked for that).
+        const auto numLocs = dataObjectGroupBy->getDims()[0];
+        auto rootDim = std::make_shared<DimensionData<int>>(numLocs);
+        rootDim->dimScale =
+            ioda::NewDimensionScale<int>(LocationName,
+                                         numLocs,
+                                         description_.isAppendable() ? ioda::Unlimited : numLocs,
+                                         numLocs);
+        dimMap[LocationName] = rootDim;
+
+        // Create the dimension data for dimensions which include source data
+        for (const auto& dimDesc : plan.sourceDims)
+        {
+            auto dataObject = dataContainer->get(dimDesc.source, categories);
+            dimMap[dimDesc.name] = dataObject->createDimensionFromData(
+                dimDesc.name,
+                dataObject->getDimPaths().size() - 1);
+        }
+
+        // Create the dimension data for dimensions with no source field.
+        const auto& varDescs = description_.getVariables();
+        for (const auto& emptyDim : plan.emptyDims)
+        {
+            auto dataObject = dataContainer->get(varDescs[emptyDim.varIdx].source, categories);
+            dimMap[emptyDim.name] = dataObject->createEmptyDimension(emptyDim.name,
+                                                                      emptyDim.dimIdx);
+        }
 
-                size_t catIdx = 0;
-                std::map<std::string, std::string> substitutions;
-                for (const auto &catPair : dataContainer->getCategoryMap())
+        backendParams.openMode = ioda::Engines::BackendOpenModes::Read_Write;
+        backendParams.createMode = ioda::Engines::BackendCreateModes::Truncate_If_Exists;
+        backendParams.action = ioda::Engines::BackendFileActions::Create;
+        backendParams.flush = (description_.getBackend() != ioda::Engines::BackendNames::Hdf5Mem);
+        backendParams.allocBytes = dataContainer->size(categories);
+
+        auto rootGroup = ioda::Engines::constructBackend(description_.getBackend(),
+                                                         backendParams);
+
+        ioda::NewDimensionScales_t allDims;
+        for (auto dimPair : dimMap)
+        {
+            allDims.push_back(dimPair.second->dimScale);
+        }
+
+        auto policy = ioda::detail::DataLayoutPolicy::Policies::ObsGroup;
+        auto layoutPolicy = ioda::detail::DataLayoutPolicy::generate(policy);
+        auto obsGroup = ioda::ObsGroup::generate(rootGroup, allDims, layoutPolicy);
+
+        // Compress the chunks of the gzip variables of the files in parallel.
+        std::unique_ptr<ChunkWriter> chunkWriter;
+        if (description_.getBackend() == ioda::Engines::BackendNames::Hdf5File &&
+            compressionThreads_ != 1)
+        {
+            chunkWriter = std::make_unique<ChunkWriter>(backendParams.fileName,
+                                                        compressionThreads_);
+        }
+
+        // Create Globals
+        for (auto& global : description_.getGlobals())
+        {
+            global->addTo(rootGroup);
+        }
+
+        // Write the Dimension Variables
+        for (const auto& dimNames : plan.sourceDimNames)
+        {
+            for (const auto& dimName : dimNames)
+            {
+                auto dimIt = dimMap.find(dimName);
+                if (dimIt == dimMap.end()) continue;
+
+                auto dimVar = obsGroup.vars[dimName];
+                dimIt->second->write(dimVar);
+            }
+        }
+
+        // Write all the other Variables
+        for (size_t varIdx = 0; varIdx < varDescs.size(); varIdx++)
+        {
+            const auto& varDesc = varDescs[varIdx];
+            const auto& dimNames = plan.varDimNames[varIdx];
+            bufr::ScopedTimer varTimer("encode.variable.", varDesc.name);
+
+            std::vector<ioda::Dimensions_t> chunks;
+            auto dimensions = std::vector<ioda::Variable>();
+            auto dataObject = dataContainer->get(varDesc.source, categories);
+            for (size_t dimIdx = 0; dimIdx < dimNames.size(); dimIdx++)
+            {
+                auto dimVar = obsGroup.vars[dimNames[dimIdx]];
+                dimensions.push_back(dimVar);
+
+                if (dimIdx < varDesc.chunks.size())
                 {
-                    substitutions.insert({catPair.first, categories.at(catIdx)});
-                    catIdx++;
+                    chunks.push_back(std::min(dimVar.getChunkSizes()[0],
+                                              varDesc.chunks[dimIdx]));
                 }
+                else
+                {
+                    chunks.push_back(dimVar.getChunkSizes()[0]);
+                }
+            }
 
-                backendParams.fileName = makeStrWithSubstitions(filename, substitutions);
+            // Variables without chunks get their shape from the target chunk size.
+            if (varDesc.chunks.empty() && description_.getTargetChunkBytes() > 0)
+            {
+                chunks = autoChunks(dataObject->getDims(),
+                                    dataObject->elementSize(),
+                                    description_.getTargetChunkBytes());
+
+                if (reportChunks)
+                {
+                    std::ostringstream chunkStr;
+                    for (const auto chunk : chunks) chunkStr << " " << chunk;
+                    oops::Log::info() << "  Chunks of " << varDesc.name << ":" << chunkStr.str()
+                                      << std::endl;
+                }
             }
 
-            backendParams.openMode = ioda::Engines::BackendOpenModes::Read_Write;
-            backendParams.createMode = ioda::Engines::BackendCreateModes::Truncate_If_Exists;
-            backendParams.action = append ? ioda::Engines::BackendFileActions::Open : \
-                                        ioda::Engines::BackendFileActions::Create;
-            backendParams.flush = true;
-            backendParams.allocBytes = dataContainer->size(categories);
+            auto var = dataObject->createVariable(obsGroup,
+                                                  varDesc.name,
+                                                  dimensions,
+                                                  chunks,
+                                                  varDesc.compression,
+                                                  chunkWriter.get());
 
-            auto rootGroup = ioda::Engines::constructBackend(description_.getBackend(),
-                                                             backendParams);
+            // The category is done with the values, free them if they were copied out of a
+            // split (see DataObject::slice).
+            dataObject->releaseValues();
+
+            var.atts.add<std::string>("long_name", { varDesc.longName }, {1});
 
-            ioda::NewDimensionScales_t allDims;
-            for (auto dimPair : dimMap)
+            if (!varDesc.units.empty())
             {
-                allDims.push_back(dimPair.second->dimScale);
+                var.atts.add<std::string>("units", { varDesc.units }, {1});
             }
 
-            auto policy = ioda::detail::DataLayoutPolicy::Policies::ObsGroup;
-            auto layoutPolicy = ioda::detail::DataLayoutPolicy::generate(policy);
-            auto obsGroup = ioda::ObsGroup::generate(rootGroup, allDims, layoutPolicy);
+            if (varDesc.coordinates)
+            {
+                var.atts.add<std::string>("coordinates", { *varDesc.coordinates }, {1});
+            }
 
-            // Create Globals
-            for (auto& global : description_.getGlobals())
+            if (varDesc.range)
             {
-                global->addTo(rootGroup);
+                var.atts.add<float>("valid_range",
+                                        {varDesc.range->start, varDesc.range->end},
+                                        {2});
             }
+        }
+
+        return obsGroup;
+    }
+
+    ioda::ObsGroup IodaEncoder::appendCategory(const std::shared_ptr<DataContainer>& dataContainer,
+                                               const SubCategory& categories,
+                                               const std::string& filename)
+    {
+        auto backendParams = ioda::Engines::BackendCreationParameters();
+        backendParams.fileName = filename;
+        backendParams.openMode = ioda::Engines::BackendOpenModes::Read_Write;
+        backendParams.action = ioda::Engines::BackendFileActions::Open;
+        backendParams.flush = true;
+
+        auto rootGroup = ioda::Engines::constructBackend(description_.getBackend(),
+                                                         backendParams);
+
+        auto policy = ioda::detail::DataLayoutPolicy::Policies::ObsGroup;
+        auto layoutPolicy = ioda::detail::DataLayoutPolicy::generate(policy);
+        auto obsGroup = ioda::ObsGroup(rootGroup, layoutPolicy);
+
+        auto locationVar = obsGroup.vars[LocationName];
+        const auto locationDims = locationVar.getDimensions();
+        if (locationDims.dimsMax[0] != ioda::Unlimited)
+        {
+            std::ostringstream errStr;
+            errStr << "Can't append to " << filename << ". Its " << LocationName;
+            errStr << " dimension isn't unlimited (write it with ioda::appendable).";
+            throw eckit::BadParameter(errStr.str());
+        }
 
-            // Write the Dimension Variables
-            for (const auto& dimDesc : description_.getDims())
+        const auto numLocs = locationDims.dimsCur[0];
+        const auto numNewLocs = dataContainer->getGroupByObject(
+            description_.getVariables()[0].source, categories)->getDims()[0];
+
+        // Check the other dimensions before anything is changed in the file.
+        std::vector<std::pair<ioda::Variable, std::shared_ptr<DataObjectBase>>> appends;
+        for (const auto& varDesc : description_.getVariables())
+        {
+            auto dataObject = dataContainer->get(varDesc.source, categories);
+            auto var = obsGroup.vars[varDesc.name];
+
+            const auto varDims = var.getDimensions().dimsCur;
+            const auto& dataDims = dataObject->getDims();
+            bool sameDims = (varDims.size() == dataDims.size());
+            for (size_t dimIdx = 1; sameDims && dimIdx < dataDims.size(); dimIdx++)
             {
-                if (!dimDesc.source.empty())
-                {
-                    auto dataObject = dataContainer->get(dimDesc.source, categories);
-                    for (size_t dimIdx = 0; dimIdx < dataObject->getDims().size(); dimIdx++)
-                    {
-                        auto dimPath = dataObject->getDimPaths()[dimIdx];
-
-                        NamedPathDims namedPathDims;
-                        if (dimIdx == 0)
-                        {
-                            namedPathDims = namedLocDims;
-                        }
-                        else
-                        {
-                            namedPathDims = namedExtraDims;
-                        }
-
-                        auto dimName = dimForDimPath(dimPath, namedPathDims).name;
-                        auto dimVar = obsGroup.vars[dimName];
-                        dimMap[dimName]->write(dimVar);
-                    }
-                }
+                sameDims = (varDims[dimIdx] == dataDims[dimIdx]);
             }
 
-            // Write all the other Variables
-            for (const auto& varDesc : description_.getVariables())
+            if (!sameDims)
             {
-                std::vector<ioda::Dimensions_t> chunks;
-                auto dimensions = std::vector<ioda::Variable>();
-                auto dataObject = dataContainer->get(varDesc.source, categories);
-                for (size_t dimIdx = 0; dimIdx < dataObject->getDims().size(); dimIdx++)
-                {
-                    auto dimPath = dataObject->getDimPaths()[dimIdx];
+                std::ostringstream errStr;
+                errStr << "Can't append " << varDesc.name << " to " << filename << ". ";
+                errStr << "Its dimensions (other than " << LocationName << ") are different.";
+                throw eckit::BadParameter(errStr.str());
+            }
 
-                    NamedPathDims namedPathDims;
-                    if (dimIdx == 0)
-                    {
-                        namedPathDims = namedLocDims;
-                    }
-                    else
-                    {
-                        namedPathDims = namedExtraDims;
-                    }
+            appends.push_back({var, dataObject});
+        }
 
-                    auto dimVar = obsGroup.vars[dimForDimPath(dimPath, namedPathDims).name];
-                    dimensions.push_back(dimVar);
+        obsGroup.resize({{locationVar, numLocs + numNewLocs}});
 
-                    if (dimIdx < varDesc.chunks.size())
-                    {
-                        chunks.push_back(std::min(dimVar.getChunkSizes()[0],
-                                                  varDesc.chunks[dimIdx]));
-                    }
-                    else
-                    {
-                        chunks.push_back(dimVar.getChunkSizes()[0]);
-                    }
-                }
+        for (auto& append : appends)
+        {
+            append.second->writeRows(append.first, numLocs);
+            append.second->releaseValues();
+        }
 
-                auto var = dataObject->createVariable(obsGroup,
-                                                      varDesc.name,
-                                                      dimensions,
-                                                      chunks,
-                                                      varDesc.compressionLevel);
+        return obsGroup;
+    }
 
-                var.atts.add<std::string>("long_name", { varDesc.longName }, {1});
+    std::map<SubCategory, ioda::ObsGroup>
+        IodaEncoder::encodeInProcesses(const std::shared_ptr<DataContainer>& dataContainer,
+                                       const std::vector<SubCategory>& categoryList,
+                                       size_t numProcesses,
+                                       bool append,
+                                       const EncodePlan& plan)
+    {
+        // Every child writes every numProcesses'th category. They get their copy of the data
+        // when they are forked, and report errors back through a pipe.
+        std::vector<pid_t> children;
+        std::vector<int> errorPipes;
+        std::string errorMsg;
+        for (size_t procIdx = 0; procIdx < numProcesses; ++procIdx)
+        {
+            int fds[2];
+            if (pipe(fds) != 0)
+            {
+                errorMsg = "Couldn't create a pipe for the processes writing the output files.";
+                break;
+            }
+
+            std::cout.flush();
+            std::cerr.flush();
+
+            const pid_t pid = fork();
+            if (pid < 0)
+            {
+                close(fds[0]);
+                close(fds[1]);
+                errorMsg = "Couldn't fork the processes writing the output files.";
+                break;
+            }
+
+            if (pid == 0)
+            {
+                close(fds[0]);
+
+                // The threads of the pool aren't in the child, so HDF5 compresses the chunks.
+                compressionThreads_ = 1;
 
-                if (!varDesc.units.empty())
+                int status = 0;
+                try
                 {
-                    var.atts.add<std::string>("units", { varDesc.units }, {1});
+                    for (size_t catIdx = procIdx; catIdx < categoryList.size();
+                         catIdx += numProcesses)
+                    {
+                        // The ObsGroup is destroyed (and the file closed) before the next one.
+                        encodeCategory(dataContainer, categoryList[catIdx], append, plan);
+                    }
                 }
-
-                if (varDesc.coordinates)
+                catch (const std::exception& e)
                 {
-                    var.atts.add<std::string>("coordinates", { *varDesc.coordinates }, {1});
+                    const std::string what = e.what();
+                    const auto written = write(fds[1], what.c_str(), what.size());
+                    static_cast<void>(written);
+                    status = 1;
                 }
-
-                if (varDesc.range)
+                catch (...)
                 {
-                    var.atts.add<float>("valid_range",
-                                            {varDesc.range->start, varDesc.range->end},
-                                            {2});
+                    status = 1;
                 }
+
+                close(fds[1]);
+
+                // Skip the exit handlers of the parent (they belong to its open files).
+                _exit(status);
             }
 
-            obsGroups.insert({categories, obsGroup});
+            close(fds[1]);
+            children.push_back(pid);
+            errorPipes.push_back(fds[0]);
+        }
+
+        // Wait for all the children (also the ones that started before a failed fork).
+        for (size_t procIdx = 0; procIdx < children.size(); ++procIdx)
+        {
+            std::string childMsg;
+            char buffer[1024];
+            ssize_t numRead;
+            while ((numRead = read(errorPipes[procIdx], buffer, sizeof(buffer))) > 0)
+            {
+                childMsg.append(buffer, static_cast<size_t>(numRead));
+            }
+
+            close(errorPipes[procIdx]);
+
+            int status = 0;
+            while (waitpid(children[procIdx], &status, 0) < 0 && errno == EINTR) {}
+
+            const bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            if (failed && errorMsg.empty())
+            {
+                errorMsg = childMsg.empty() ? "A process writing the output files failed."
+                                            : childMsg;
+            }
+        }
+
+        if (!errorMsg.empty())
+        {
+            throw eckit::BadValue(errorMsg);
+        }
+
+        // Open the files the children wrote.
+        std::map<SubCategory, ioda::ObsGroup> obsGroups;
+        for (const auto& categories : categoryList)
+        {
+            auto backendParams = ioda::Engines::BackendCreationParameters();
+            backendParams.fileName = makeFilename(dataContainer, categories);
+            backendParams.openMode = ioda::Engines::BackendOpenModes::Read_Only;
+            backendParams.action = ioda::Engines::BackendFileActions::Open;
+
+            auto rootGroup = ioda::Engines::constructBackend(description_.getBackend(),
+                                                             backendParams);
+            auto policy = ioda::detail::DataLayoutPolicy::Policies::ObsGroup;
+            auto layoutPolicy = ioda::detail::DataLayoutPolicy::generate(policy);
+            obsGroups.insert({categories, ioda::ObsGroup(rootGroup, layoutPolicy)});
         }
 
         return obsGroups;
     }
 
+    std::string IodaEncoder::makeFilename(const std::shared_ptr<DataContainer>& dataContainer,
+                                          const SubCategory& categories)
+    {
+        size_t catIdx = 0;
+        std::map<std::string, std::string> substitutions;
+        for (const auto &catPair : dataContainer->getCategoryMap())
+        {
+            substitutions.insert({catPair.first, categories.at(catIdx)});
+            catIdx++;
+        }
+
+        return makeStrWithSubstitions(description_.getFilepath(), substitutions);
+    }
+
     std::string IodaEncoder::makeStrWithSubstitions(const std::string& prototype,
                                                    const std::map<std::string, std::string>& subMap)
     {
@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "eckit/config/LocalConfiguration.h"
 #include "ioda/Group.h"
@@ -28,16 +31,47 @@ namespace Ingester
 
         /// \brief Encode the data into an ioda::ObsGroup object
         /// \param data The data container to use
-        /// \param append Add data to existing file?
+        /// \param append Add data to existing file? The locations are added to the files that
+        ///        exist (they must have been written with ioda::appendable), the others are
+        ///        created.
         std::map<SubCategory, ioda::ObsGroup> encode(const std::shared_ptr<DataContainer>& data,
                                                     bool append = false);
 
      private:
         typedef std::map<std::vector<bufr::Query>, DimensionDescription> NamedPathDims;
 
+        /// \brief A dimension with no source field, sized from a dimension of a variable.
+        struct EmptyDimension
+        {
+            std::string name;
+            size_t varIdx;  // Index of the variable in the description
+            size_t dimIdx;  // Index of the dimension in the variable's data
+        };
+
+        /// \brief The dimensions of the variables, resolved once for all the categories of a
+        ///        DataContainer (the fields have the same dimension paths in every category).
+        struct EncodePlan
+        {
+            /// \brief The dimensions which include source data
+            std::vector<DimensionDescription> sourceDims;
+
+            /// \brief The dimensions with no source field
+            std::vector<EmptyDimension> emptyDims;
+
+            /// \brief The ioda dimension of each data dimension of the sourceDims fields
+            std::vector<std::vector<std::string>> sourceDimNames;
+
+            /// \brief The ioda dimension of each data dimension of every variable
+            std::vector<std::vector<std::string>> varDimNames;
+        };
+
         /// \brief The description
         const IodaDescription description_;
 
+        /// \brief The number of threads compressing the chunks of the gzip variables (see
+        ///        ChunkWriter, 1 leaves it to HDF5)
+        size_t compressionThreads_;
+
         /// \brief Create a string from a template string.
         /// \param prototype A template string ex: "my {dogType} barks". Sections labeled {__key__}
         ///        are treated as keys into the dictionary that defines their replacment values.
@@ -55,6 +89,55 @@ namespace Ingester
         /// \return True if the subquery string is a named dimension.
         bool existsInNamedPath(const bufr::Query& path, const NamedPathDims& pathMap) const;
 
+        /// \brief Resolve the dimensions of the variables (see EncodePlan).
+        /// \param dataContainer The data container to use
+        /// \param categories A category with data
+        /// \param namedExtraDims The named dimensions (other than Location)
+        EncodePlan makePlan(const std::shared_ptr<DataContainer>& dataContainer,
+                            const SubCategory& categories,
+                            NamedPathDims namedExtraDims) const;
+
+        /// \brief Encode the data of one category into its ObsGroup.
+        /// \param dataContainer The data container to use
+        /// \param categories The category to encode
+        /// \param append Add data to existing file?
+        /// \param plan The resolved dimensions
+        /// \param reportChunks Log the chunks picked for the variables?
+        ioda::ObsGroup encodeCategory(const std::shared_ptr<DataContainer>& dataContainer,
+                                      const SubCategory& categories,
+                                      bool append,
+                                      const EncodePlan& plan,
+                                      bool reportChunks = false);
+
+        /// \brief Add the locations of one category to an existing (appendable) file.
+        /// \param dataContainer The data container to use
+        /// \param categories The category to encode
+        /// \param filename The file of the category
+        ioda::ObsGroup appendCategory(const std::shared_ptr<DataContainer>& dataContainer,
+                                      const SubCategory& categories,
+                                      const std::string& filename);
+
+        /// \brief Write the files of the categories concurrently with a pool of child processes
+        ///        (see IodaDescription::getWriteProcesses). The written files are opened read
+        ///        only for the result.
+        /// \param dataContainer The data container to use
+        /// \param categoryList The categories to encode
+        /// \param numProcesses The number of child processes
+        /// \param append Add data to existing file?
+        /// \param plan The resolved dimensions
+        std::map<SubCategory, ioda::ObsGroup>
+            encodeInProcesses(const std::shared_ptr<DataContainer>& dataContainer,
+                              const std::vector<SubCategory>& categoryList,
+                              size_t numProcesses,
+                              bool append,
+                              const EncodePlan& plan);
+
+        /// \brief Make the output filename of a category.
+        /// \param dataContainer The data container (has the category names)
+        /// \param categories The category
+        std::string makeFilename(const std::shared_ptr<DataContainer>& dataContainer,
+                                 const SubCategory& categories);
+
         /// \brief Get the description associated with the named dimension.
         /// \param path The subquery string for the dimension.
         /// \param pathMap The map of named dimensions.
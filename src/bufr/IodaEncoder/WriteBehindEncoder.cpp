@@ -0,0 +1,103 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "WriteBehindEncoder.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "IodaEncoder.h"
+
+
+namespace Ingester
+{
+    WriteBehindEncoder::WriteBehindEncoder(size_t maxPending) :
+        maxPending_(std::max<size_t>(maxPending, 1))
+    {
+        thread_ = std::thread(&WriteBehindEncoder::write, this);
+    }
+
+    WriteBehindEncoder::~WriteBehindEncoder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            jobs_.clear();
+        }
+
+        jobAdded_.notify_all();
+        jobDone_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    void WriteBehindEncoder::encode(const eckit::LocalConfiguration& iodaConf,
+                                    const std::shared_ptr<DataContainer>& data,
+                                    bool append)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobDone_.wait(lock, [this]() { return jobs_.size() < maxPending_ || error_; });
+            checkError();
+
+            jobs_.push_back({iodaConf, data, append});
+        }
+
+        jobAdded_.notify_one();
+    }
+
+    void WriteBehindEncoder::finish()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        jobDone_.wait(lock, [this]() { return (jobs_.empty() && !busy_) || error_; });
+        checkError();
+    }
+
+    void WriteBehindEncoder::write()
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                jobAdded_.wait(lock, [this]() { return !jobs_.empty() || stop_; });
+                if (stop_) return;
+
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+                busy_ = true;
+            }
+
+            // Let a waiting producer add the next container while this one is written.
+            jobDone_.notify_all();
+
+            try
+            {
+                auto encoder = IodaEncoder(job.iodaConf);
+                encoder.encode(job.data, job.append);
+                job.data.reset();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = std::current_exception();
+                jobs_.clear();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                busy_ = false;
+            }
+
+            jobDone_.notify_all();
+        }
+    }
+
+    void WriteBehindEncoder::checkError()
+    {
+        if (error_) std::rethrow_exception(error_);
+    }
+}  // namespace Ingester
@@ -0,0 +1,80 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "eckit/config/LocalConfiguration.h"
+
+#include "DataContainer.h"
+
+
+namespace Ingester
+{
+    /// \brief Encodes DataContainers (see IodaEncoder) on a background thread, so the next data
+    ///        can be parsed while the previous data is still being written. The containers are
+    ///        written one at a time in the order they were queued (HDF5 isn't thread safe), and
+    ///        only a few can wait in the queue so the parsed data doesn't pile up in memory.
+    class WriteBehindEncoder
+    {
+     public:
+        /// \brief Constructor. Starts the writer thread.
+        /// \param maxPending The number of containers that can wait to be written before encode
+        ///        blocks.
+        explicit WriteBehindEncoder(size_t maxPending = 1);
+
+        /// \brief Stops the writer thread. Containers that weren't written yet are dropped (call
+        ///        finish to wait for them).
+        ~WriteBehindEncoder();
+
+        WriteBehindEncoder(const WriteBehindEncoder&) = delete;
+        WriteBehindEncoder& operator=(const WriteBehindEncoder&) = delete;
+
+        /// \brief Queue a container to be encoded. Blocks while the queue is full. Throws the
+        ///        error of an earlier container that failed to be written.
+        /// \param iodaConf The ioda section of the observations entry (see IodaDescription).
+        /// \param data The data to encode.
+        /// \param append Add the data to the existing file (see IodaEncoder::encode).
+        void encode(const eckit::LocalConfiguration& iodaConf,
+                    const std::shared_ptr<DataContainer>& data,
+                    bool append = false);
+
+        /// \brief Wait until everything that was queued is written. Throws the error of the
+        ///        first container that failed to be written.
+        void finish();
+
+     private:
+        struct Job
+        {
+            eckit::LocalConfiguration iodaConf;
+            std::shared_ptr<DataContainer> data;
+            bool append;
+        };
+
+        const size_t maxPending_;
+        std::mutex mutex_;
+        std::condition_variable jobAdded_;
+        std::condition_variable jobDone_;
+        std::deque<Job> jobs_;
+        bool busy_ = false;
+        bool stop_ = false;
+        std::exception_ptr error_;
+        std::thread thread_;
+
+        /// \brief Write the queued containers (runs on thread_).
+        void write();
+
+        /// \brief Throw the stored error, if there is one (mutex_ must be held).
+        void checkError();
+    };
+}  // namespace Ingester
@@ -23,7 +23,9 @@ namespace Ingester
 
         /// \brief Parse the input.
         /// \param maxMsgsToParse Messages to parse (0 for everything)
-        virtual std::shared_ptr<DataContainer> parse(const size_t maxMsgsToParse = 0) = 0;
+        /// \param numThreads Number of threads to use while parsing
+        virtual std::shared_ptr<DataContainer> parse(const size_t maxMsgsToParse = 0,
+                                                     const size_t numThreads = 1) = 0;
 
         /// \brief Start over from the beginning
         virtual void reset() = 0;
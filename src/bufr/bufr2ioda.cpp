@@ -5,36 +5,167 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <iostream>
 #include <ostream>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "eckit/config/YAMLConfiguration.h"
 #include "eckit/exception/Exceptions.h"
 #include "eckit/filesystem/PathName.h"
+#include "eckit/mpi/Comm.h"
+#include "oops/util/Logger.h"
 
+#include "BufrParser/BufrDescription.h"
 #include "BufrParser/BufrParser.h"
+#include "BufrParser/Query/MessageSampling.h"
+#include "BufrParser/Query/Parallel.h"
+#include "BufrParser/Query/Profiler.h"
+#include "ConversionServer.h"
+#include "IncrementalState.h"
 #include "IodaEncoder/IodaDescription.h"
 #include "IodaEncoder/IodaEncoder.h"
-#include "ObjectFactory.h"
+#include "IodaEncoder/WriteBehindEncoder.h"
 
 
 namespace Ingester
 {
-    typedef ObjectFactory<Ingester::Parser, const eckit::LocalConfiguration&> ParseFactory;
-
-    void parse(const std::string& yamlPath, std::size_t numMsgs = 0)
+    namespace
     {
-        ParseFactory parseFactory;
-        parseFactory.registerObject<BufrParser>("bufr");
+        /// \brief Rough ratio between the memory it takes to parse and encode an entry and the
+        ///        size of its BUFR files (the decoded data is a lot bigger than the packed data).
+        const std::uint64_t MemoryPerInputByte = 10;
+
+        /// \brief Limits the estimated memory of the entries that are processed at once.
+        class MemoryBudget
+        {
+         public:
+            explicit MemoryBudget(std::uint64_t budget) :
+                budget_(budget),
+                available_(budget)
+            {}
+
+            /// \brief Wait until there is enough memory left and take it. Entries that need
+            ///        more than the whole budget wait until nothing else is running.
+            /// \return The amount that was taken (give it back with release).
+            std::uint64_t acquire(std::uint64_t bytes)
+            {
+                bytes = std::min(bytes, budget_);
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                released_.wait(lock, [this, bytes]() { return available_ >= bytes; });
+                available_ -= bytes;
+                return bytes;
+            }
+
+            void release(std::uint64_t bytes)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    available_ += bytes;
+                }
+
+                released_.notify_all();
+            }
+
+         private:
+            const std::uint64_t budget_;
+            std::uint64_t available_;
+            std::mutex mutex_;
+            std::condition_variable released_;
+        };
+
+        /// \brief The physical memory that is currently free.
+        std::uint64_t availableMemory()
+        {
+            const auto numPages = sysconf(_SC_AVPHYS_PAGES);
+            const auto pageSize = sysconf(_SC_PAGESIZE);
+            if (numPages <= 0 || pageSize <= 0)
+            {
+                return std::numeric_limits<std::uint64_t>::max();
+            }
+
+            return static_cast<std::uint64_t>(numPages) * static_cast<std::uint64_t>(pageSize);
+        }
+
+        /// \brief Estimate the memory needed to process the entries that read a description's
+        ///        input (remote files count as empty).
+        std::uint64_t estimateMemory(const BufrDescription& description)
+        {
+            std::uint64_t inputSize = 0;
+            for (const auto& path : bufr::FileSet::expand(description.filepaths()))
+            {
+                struct stat fileStat;
+                if (stat(path.c_str(), &fileStat) == 0)
+                {
+                    inputSize += static_cast<std::uint64_t>(fileStat.st_size);
+                }
+            }
+
+            return inputSize * MemoryPerInputByte;
+        }
+
+        /// \brief What an incremental conversion needs to know about a group of entries.
+        struct IncrementalGroup
+        {
+            std::string key;  // The output of the first entry (see IncrementalState)
+            std::vector<std::string> filePaths;
+            std::vector<std::int64_t> sizes;  // Of the files before they are read
+        };
+    }  // namespace
 
+    /// \brief Convert the observations of a YAML file.
+    /// \param yamlPath Path to the YAML file.
+    /// \param numMsgs Number of BUFR messages to parse (0 for all of them).
+    /// \param numThreads Number of threads used for each group of entries.
+    /// \param numJobs Number of groups of entries (see below) that are processed at once.
+    /// \param memoryLimit Estimated memory (bytes) the concurrent groups can use together. 0
+    ///        uses the physical memory that is free at the start.
+    /// \param append Add the locations to the output files that exist (see ioda::appendable).
+    /// \param statePath Only convert the BUFR messages added since the last run with this state
+    ///        file (see IncrementalState) and append them to the outputs. Empty converts all of
+    ///        them.
+    /// \param sampling Only read some of the data messages of every entry (overrides the
+    ///        sampling of the YAML, see bufr::MessageSampling).
+    void parse(const std::string& yamlPath,
+               std::size_t numMsgs = 0,
+               std::size_t numThreads = 1,
+               std::size_t numJobs = 1,
+               std::uint64_t memoryLimit = 0,
+               bool append = false,
+               const std::string& statePath = "",
+               const bufr::MessageSampling& sampling = bufr::MessageSampling())
+    {
         std::unique_ptr<eckit::YAMLConfiguration>
             yaml(new eckit::YAMLConfiguration(eckit::PathName(yamlPath)));
 
         if (yaml->has("observations"))
         {
-            for (const auto& obsConf : yaml->getSubConfigurations("observations"))
+            const auto obsConfs = yaml->getSubConfigurations("observations");
+
+            // Entries that read the same BUFR files are parsed together so the files are only
+            // decoded once (see BufrParser::parseShared). The groups keep the order of the
+            // entries they start with.
+            std::vector<BufrDescription> descriptions;
+            std::vector<std::vector<size_t>> groups;
+            for (size_t obsIdx = 0; obsIdx < obsConfs.size(); ++obsIdx)
             {
+                const auto& obsConf = obsConfs[obsIdx];
                 if (!obsConf.has("obs space") ||
                     !obsConf.has("ioda"))
                 {
@@ -42,13 +173,259 @@ namespace Ingester
                         "Incomplete obs found. All obs must have a obs space and ioda.");
                 }
 
-                auto configuration = obsConf.getSubConfiguration("obs space");
-                auto parser = parseFactory.create("bufr", configuration);
-                auto data = parser->parse(numMsgs);
+                descriptions.emplace_back(obsConf.getSubConfiguration("obs space"));
+                if (sampling.isSampling()) descriptions.back().setSampling(sampling);
+
+                // Without a memory budget of its own an entry gets its share of -m.
+                if (memoryLimit > 0 && descriptions.back().memoryBudget() == 0)
+                {
+                    descriptions.back().setMemoryBudget(memoryLimit / std::max<size_t>(numJobs, 1));
+                }
+
+                auto groupIt = std::find_if(groups.begin(), groups.end(),
+                    [&descriptions](const std::vector<size_t>& group)
+                    {
+                        return descriptions[group.front()].hasSameInput(descriptions.back());
+                    });
+
+                if (groupIt != groups.end())
+                {
+                    groupIt->push_back(obsIdx);
+                }
+                else
+                {
+                    groups.push_back({obsIdx});
+                }
+            }
+
+            const auto& comm = eckit::mpi::comm();
+
+            // Incremental conversions skip the messages that are already in the outputs, and
+            // the groups whose files didn't change.
+            std::unique_ptr<IncrementalState> state;
+            std::map<size_t, IncrementalGroup> incrementalGroups;
+            std::mutex stateMutex;
+            if (!statePath.empty())
+            {
+                if (comm.size() > 1)
+                {
+                    throw eckit::BadParameter(
+                        "bufr2ioda: Incremental conversions can't be run with MPI.");
+                }
+
+                if (std::any_of(descriptions.begin(), descriptions.end(),
+                                [](const BufrDescription& description)
+                                {
+                                    return description.sampling().isSampling();
+                                }))
+                {
+                    throw eckit::BadParameter(
+                        "bufr2ioda: Incremental conversions can't sample the messages.");
+                }
+
+                state = std::make_unique<IncrementalState>(statePath);
+                append = true;
+
+                std::vector<std::vector<size_t>> changedGroups;
+                for (const auto& group : groups)
+                {
+                    IncrementalGroup info;
+                    info.key = obsConfs[group.front()].getSubConfiguration("ioda")
+                                                      .getString("obsdataout", "");
+                    if (info.key.empty())
+                    {
+                        throw eckit::BadParameter(
+                            "bufr2ioda: Incremental conversions need ioda::obsdataout.");
+                    }
+
+                    info.filePaths = bufr::FileSet::expand(descriptions[group.front()].filepaths());
+                    info.sizes = IncrementalState::fileSizes(info.filePaths);
+                    if (state->isUpToDate(info.key, info.filePaths, info.sizes))
+                    {
+                        oops::Log::info() << "bufr2ioda: Nothing new for " << info.key
+                                          << std::endl;
+                        continue;
+                    }
+
+                    // The messages read have to be counted, so nothing comes from the cache.
+                    const auto converted = state->convertedMessages(info.key,
+                                                                    info.filePaths,
+                                                                    info.sizes);
+                    for (const auto obsIdx : group)
+                    {
+                        descriptions[obsIdx].setSkipMessages(converted);
+                        descriptions[obsIdx].setResultCachePath("");
+                    }
+
+                    incrementalGroups[group.front()] = info;
+                    changedGroups.push_back(group);
+                }
+
+                groups = changedGroups;
+            }
+
+            // Record the messages a group read (written once all the outputs are).
+            auto updateState = [&](const std::vector<size_t>& group,
+                                   const std::vector<size_t>& messagesRead)
+            {
+                if (!state) return;
+
+                std::lock_guard<std::mutex> lock(stateMutex);
+                const auto& info = incrementalGroups.at(group.front());
+                state->update(info.key, info.filePaths, info.sizes, messagesRead);
+            };
+
+            // The files are written on a background thread while the next data is parsed. HDF5
+            // isn't thread safe, so it is also the only thread that writes.
+            WriteBehindEncoder writer(std::max<size_t>(numJobs, 1));
+
+            // With several MPI ranks the messages of each group are split over the ranks, and
+            // the root rank writes the files.
+            if (comm.size() > 1)
+            {
+                if (numJobs > 1 && comm.rank() == 0)
+                {
+                    oops::Log::warning() << "bufr2ioda: -j is ignored when running with MPI. "
+                                         << "The observations are processed one at a time."
+                                         << std::endl;
+                }
+
+                for (const auto& group : groups)
+                {
+                    std::vector<BufrDescription> groupDescriptions;
+                    for (const auto obsIdx : group)
+                    {
+                        groupDescriptions.push_back(descriptions[obsIdx]);
+                    }
+
+                    auto data = BufrParser::parseDistributed(groupDescriptions,
+                                                             comm,
+                                                             numMsgs,
+                                                             numThreads);
+                    if (comm.rank() != 0) continue;
+
+                    for (size_t entryIdx = 0; entryIdx < group.size(); ++entryIdx)
+                    {
+                        const auto& obsConf = obsConfs[group[entryIdx]];
+                        writer.encode(obsConf.getSubConfiguration("ioda"), data[entryIdx], append);
+                        data[entryIdx].reset();
+                    }
+                }
+
+                writer.finish();
+                return;
+            }
+
+            auto processGroup = [&](const std::vector<size_t>& group)
+            {
+                if (group.size() == 1)
+                {
+                    const auto& obsConf = obsConfs[group.front()];
+                    BufrParser parser(descriptions[group.front()]);
+                    auto data = parser.parse(numMsgs, numThreads);
+                    updateState(group, parser.messagesRead());
+
+                    writer.encode(obsConf.getSubConfiguration("ioda"), data, append);
+                    return;
+                }
+
+                std::vector<BufrDescription> groupDescriptions;
+                for (const auto obsIdx : group)
+                {
+                    groupDescriptions.push_back(descriptions[obsIdx]);
+                }
+
+                std::vector<size_t> messagesRead;
+                auto data = BufrParser::parseShared(groupDescriptions,
+                                                    numMsgs,
+                                                    numThreads,
+                                                    &messagesRead);
+                updateState(group, messagesRead);
+
+                for (size_t entryIdx = 0; entryIdx < group.size(); ++entryIdx)
+                {
+                    const auto& obsConf = obsConfs[group[entryIdx]];
+                    writer.encode(obsConf.getSubConfiguration("ioda"), data[entryIdx], append);
+
+                    // The writer frees the data of the entry once it is written.
+                    data[entryIdx].reset();
+                }
+            };
+
+            if (numJobs <= 1 || groups.size() <= 1)
+            {
+                for (const auto& group : groups)
+                {
+                    processGroup(group);
+                }
+
+                writer.finish();
+                if (state) state->write();
+                return;
+            }
+
+            // Run the groups on a pool of workers, holding back the ones that would go over
+            // the memory budget until others are done.
+            MemoryBudget budget(memoryLimit > 0 ? memoryLimit : availableMemory());
+            std::vector<std::uint64_t> groupMemory;
+            for (const auto& group : groups)
+            {
+                groupMemory.push_back(estimateMemory(descriptions[group.front()]));
+            }
+
+            const auto numWorkers = std::min(numJobs, groups.size());
+            std::vector<std::exception_ptr> errors(numWorkers);
+            std::atomic<size_t> nextGroupIdx(0);
+
+            auto work = [&](size_t workerIdx)
+            {
+                try
+                {
+                    for (auto groupIdx = nextGroupIdx++;
+                         groupIdx < groups.size();
+                         groupIdx = nextGroupIdx++)
+                    {
+                        const auto reserved = budget.acquire(groupMemory[groupIdx]);
+                        try
+                        {
+                            processGroup(groups[groupIdx]);
+                        }
+                        catch (...)
+                        {
+                            budget.release(reserved);
+                            throw;
+                        }
+
+                        budget.release(reserved);
+                    }
+                }
+                catch (...)
+                {
+                    errors[workerIdx] = std::current_exception();
+
+                    // Stop the other workers too.
+                    nextGroupIdx = groups.size();
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (size_t workerIdx = 0; workerIdx < numWorkers; workerIdx++)
+            {
+                workers.emplace_back(work, workerIdx);
+            }
+
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
 
-                auto encoder = IodaEncoder(obsConf.getSubConfiguration("ioda"));
-                encoder.encode(data);
+            for (const auto& error : errors)
+            {
+                if (error) std::rethrow_exception(error);
             }
+
+            writer.finish();
+            if (state) state->write();
         }
         else
         {
@@ -60,10 +437,43 @@ namespace Ingester
 
 static void showHelp()
 {
-    std::cerr << "Usage: bufr2ioda.x [-n NUM_MESSAGES] YAML_PATH"
+    std::cerr << "Usage: bufr2ioda.x [-n NUM_MESSAGES] [-t NUM_THREADS] [-j NUM_JOBS]"
+              << " [--pin-threads] [--sample-every K] [--sample-fraction F [--sample-seed S]]"
+              << " [-m MAX_MEMORY_MB] [-a] [--incremental STATE_FILE]"
+              << " [--watch DIR | --listen SOCKET_PATH] [--profile JSON_PATH [--profile-memory]]"
+              << " YAML_PATH\n"
               << "Options:\n"
               << "  -h,  Show this help message\n"
-              << "  -n NUM_MESSAGES,  Number of BUFR messages to parse."
+              << "  -n NUM_MESSAGES,  Number of BUFR messages to parse.\n"
+              << "  -t NUM_THREADS,  Number of threads used to decode the BUFR messages and"
+              << " build the variables (shared by the concurrent entries, 0 uses the CPUs the"
+              << " process may run on).\n"
+              << "  --pin-threads,  Bind each worker thread to one of the CPUs the process may"
+              << " run on.\n"
+              << "  --sample-every K,  Only read every K-th data message of the files (a quick"
+              << " preview, -n then counts the messages that are read).\n"
+              << "  --sample-fraction F,  Only read a random fraction F (0 < F <= 1) of the data"
+              << " messages of the files.\n"
+              << "  --sample-seed S,  Seed of the random choice of --sample-fraction (0 by"
+              << " default).\n"
+              << "  -j NUM_JOBS,  Number of observations entries (with different input files)"
+              << " processed at once.\n"
+              << "  -m MAX_MEMORY_MB,  Estimated memory the concurrent entries can use"
+              << " together (defaults to the free memory). Each entry spills the sub"
+              << " categories that don't fit in its share to disk (see memorybudget).\n"
+              << "  -a,  Append the locations to the output files that exist (they must be"
+              << " written with ioda::appendable).\n"
+              << "  --incremental STATE_FILE,  Only convert the BUFR messages added since the"
+              << " last run with this state file, and append them to the outputs (implies -a).\n"
+              << "  --watch DIR,  Keep running and convert the files that appear in DIR (see"
+              << " ConversionServer).\n"
+              << "  --listen SOCKET_PATH,  Keep running and convert the files whose paths are"
+              << " sent (one per line) to this Unix domain socket.\n"
+              << "  --profile JSON_PATH,  Write the time spent in each stage and the counters"
+              << " (messages, subsets, values, target cache hits ...) to this JSON file.\n"
+              << "  --profile-memory,  Also report the resident memory at the start and end of"
+              << " each stage, which stages raised the peak, and the sizes of the collected"
+              << " frames, fields and data containers (needs --profile)."
               << std::endl;
 }
 
@@ -78,6 +488,17 @@ int main(int argc, char **argv)
 
     std::string yamlPath;
     std::size_t numMsgs = 0;
+    std::size_t numThreads = 1;
+    std::size_t numJobs = 1;
+    bool pinThreads = false;
+    Ingester::bufr::MessageSampling sampling;
+    std::uint64_t memoryLimit = 0;
+    bool append = false;
+    std::string statePath;
+    std::string watchDir;
+    std::string socketPath;
+    std::string profilePath;
+    bool profileMemory = false;
 
     std::size_t argIdx = 1;
     while (argIdx < static_cast<std::size_t> (argc))
@@ -96,6 +517,135 @@ int main(int argc, char **argv)
 
             argIdx += 2;
         }
+        else if (strcmp(argv[argIdx], "-t") == 0)
+        {
+            if (static_cast<std::size_t> (argc) > argIdx + 1)
+            {
+                numThreads = std::max(0, atoi(argv[argIdx + 1]));
+            }
+            else
+            {
+                showHelp();
+                return 0;
+            }
+
+            argIdx += 2;
+        }
+        else if (strcmp(argv[argIdx], "-j") == 0)
+        {
+            if (static_cast<std::size_t> (argc) > argIdx + 1)
+            {
+                numJobs = std::max(1, atoi(argv[argIdx + 1]));
+            }
+            else
+            {
+                showHelp();
+                return 0;
+            }
+
+            argIdx += 2;
+        }
+        else if (strcmp(argv[argIdx], "-m") == 0)
+        {
+            if (static_cast<std::size_t> (argc) > argIdx + 1)
+            {
+                memoryLimit = static_cast<std::uint64_t>(std::max(0, atoi(argv[argIdx + 1])))
+                              * 1024 * 1024;
+            }
+            else
+            {
+                showHelp();
+                return 0;
+            }
+
+            argIdx += 2;
+        }
+        else if (strcmp(argv[argIdx], "-a") == 0)
+        {
+            append = true;
+            argIdx++;
+        }
+        else if (strcmp(argv[argIdx], "--incremental") == 0)
+        {
+            if (static_cast<std::size_t> (argc) > argIdx + 1)
+            {
+                statePath = std::string(argv[argIdx + 1]);
+            }
+            else
+            {
+                showHelp();
+                return 0;
+            }
+
+            argIdx += 2;
+        }
+        else if (strcmp(argv[argIdx], "--watch") == 0 ||
+                 strcmp(argv[argIdx], "--listen") == 0)
+        {
+            if (static_cast<std::size_t> (argc) > argIdx + 1)
+            {
+                auto& path = (strcmp(argv[argIdx], "--watch") == 0) ? watchDir : socketPath;
+                path = std::string(argv[argIdx + 1]);
+            }
+            else
+            {
+                showHelp();
+                return 0;
+            }
+
+            argIdx += 2;
+        }
+        else if (strcmp(argv[argIdx], "--profile") == 0)
+        {
+            if (static_cast<std::size_t> (argc) > argIdx + 1)
+            {
+                profilePath = std::string(argv[argIdx + 1]);
+            }
+            else
+            {
+                showHelp();
+                return 0;
+            }
+
+            argIdx += 2;
+        }
+        else if (strcmp(argv[argIdx], "--profile-memory") == 0)
+        {
+            profileMemory = true;
+            argIdx++;
+        }
+        else if (strcmp(argv[argIdx], "--pin-threads") == 0)
+        {
+            pinThreads = true;
+            argIdx++;
+        }
+        else if (strcmp(argv[argIdx], "--sample-every") == 0 ||
+                 strcmp(argv[argIdx], "--sample-fraction") == 0 ||
+                 strcmp(argv[argIdx], "--sample-seed") == 0)
+        {
+            if (static_cast<std::size_t> (argc) > argIdx + 1)
+            {
+                if (strcmp(argv[argIdx], "--sample-every") == 0)
+                {
+                    sampling.every = std::max(1, atoi(argv[argIdx + 1]));
+                }
+                else if (strcmp(argv[argIdx], "--sample-fraction") == 0)
+                {
+                    sampling.fraction = atof(argv[argIdx + 1]);
+                }
+                else
+                {
+                    sampling.seed = std::strtoull(argv[argIdx + 1], nullptr, 10);
+                }
+            }
+            else
+            {
+                showHelp();
+                return 0;
+            }
+
+            argIdx += 2;
+        }
         else if (strcmp(argv[argIdx], "-h") == 0)
         {
             showHelp();
@@ -108,11 +658,77 @@ int main(int argc, char **argv)
         }
     }
 
-    Ingester::parse(yamlPath, numMsgs);
+    if (profileMemory && profilePath.empty())
+    {
+        std::cerr << "bufr2ioda: --profile-memory needs --profile." << std::endl;
+        return 1;
+    }
+
+    if (sampling.fraction <= 0 || sampling.fraction > 1)
+    {
+        std::cerr << "bufr2ioda: --sample-fraction has to be in (0, 1]." << std::endl;
+        return 1;
+    }
+
+    if (!profilePath.empty()) Ingester::bufr::Profiler::enable(true, profileMemory);
+
+    // Every parallel stage of every entry shares the same threads.
+    Ingester::bufr::Executor::configure(numThreads, pinThreads);
+    numThreads = Ingester::bufr::Executor::numThreads();
+
+    // Write the profile when the conversion (or the server) finishes.
+    auto writeProfile = [&profilePath]()
+    {
+        if (profilePath.empty()) return;
+
+        std::ofstream profileFile(profilePath);
+        Ingester::bufr::Profiler::writeJson(profileFile);
+        if (!profileFile)
+        {
+            std::cerr << "bufr2ioda: Couldn't write the profile to " << profilePath << std::endl;
+        }
+    };
+
+    if (!watchDir.empty() || !socketPath.empty())
+    {
+        Ingester::ConversionServer server(yamlPath, numThreads);
+        if (!watchDir.empty())
+        {
+            server.watch(watchDir);
+        }
+        else
+        {
+            server.listen(socketPath);
+        }
+
+        writeProfile();
+        return 0;
+    }
+
+    {
+        Ingester::bufr::ScopedTimer timer("bufr2ioda");
+        Ingester::parse(yamlPath,
+                        numMsgs,
+                        numThreads,
+                        numJobs,
+                        memoryLimit,
+                        append,
+                        statePath,
+                        sampling);
+    }
+
+    writeProfile();
 
     try
     {
-//        Ingester::parse(yamlPath, numMsgs);
+//        Ingester::parse(yamlPath,
+                        numMsgs,
+                        numThreads,
+                        numJobs,
+                        memoryLimit,
+                        append,
+                        statePath,
+                        sampling);
     }
     catch (const std::exception &e)
     {
@@ -0,0 +1,201 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <glob.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "IodaConcat/IodaConcat.h"
+
+
+namespace
+{
+    /// \brief The files to concatenate into one output.
+    struct ConcatJob
+    {
+        std::string output;
+        std::vector<std::string> inputs;
+    };
+
+    void printHelp()
+    {
+        std::cout << "Description: " << std::endl;
+        std::cout << "  Concatenates ioda files with the same variables along the Location"
+                  << std::endl;
+        std::cout << "  dimension (ex: the files of the MPI ranks or of the BUFR files of a"
+                  << std::endl;
+        std::cout << "  product). Compressed chunks are copied without being decompressed where"
+                  << std::endl;
+        std::cout << "  they line up." << std::endl;
+        std::cout << "Arguments: " << std::endl;
+        std::cout << "  -h             (Optional) Print out the help message." << std::endl;
+        std::cout << "  -j <processes> (Optional) Number of outputs to write at once." << std::endl;
+        std::cout << "  -d <dimension> (Optional) The dimension to concatenate along (default"
+                  << std::endl;
+        std::cout << "                 Location)." << std::endl;
+        std::cout << "  -o <output>    Output file, followed by its input files (paths or glob"
+                  << std::endl;
+        std::cout << "                 patterns, in order). Repeat for several outputs (ex: the"
+                  << std::endl;
+        std::cout << "                 split categories)." << std::endl;
+        std::cout << "Examples: " << std::endl;
+        std::cout << "  ./ioda_concat.x -o amsua.nc \"amsua.rank*.nc\"" << std::endl;
+        std::cout << "  ./ioda_concat.x -j 2 -o n19.nc \"n19.rank*.nc\" -o n18.nc \"n18.rank*.nc\""
+                  << std::endl;
+    }
+
+    /// \brief Expand a glob pattern (in sorted order, the other paths are kept as they are).
+    std::vector<std::string> expandPath(const std::string& pattern)
+    {
+        std::vector<std::string> paths;
+        glob_t matches;
+        if (glob(pattern.c_str(), GLOB_NOCHECK, nullptr, &matches) == 0)
+        {
+            for (size_t matchIdx = 0; matchIdx < matches.gl_pathc; matchIdx++)
+            {
+                paths.emplace_back(matches.gl_pathv[matchIdx]);
+            }
+        }
+
+        globfree(&matches);
+        return paths;
+    }
+
+    /// \brief Concatenate the files of a job and report it.
+    /// \return True if it worked.
+    bool runJob(const Ingester::IodaConcat& concat, const ConcatJob& job)
+    {
+        try
+        {
+            const auto stats = concat.concat(job.inputs, job.output);
+            std::cout << "Wrote " << job.output << " (" << stats.numLocations << " locations from "
+                      << stats.numFiles << " files, " << stats.copiedChunks
+                      << " chunks copied as they are, " << stats.rewrittenRows
+                      << " rows rewritten)" << std::endl;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<ConcatJob> jobs;
+    std::string dimName = "Location";
+    size_t numProcesses = 1;
+
+    int idx = 1;
+    while (idx < argc)
+    {
+        std::string arg = argv[idx];
+        const bool hasValue = idx + 1 < argc;
+        if (arg == "-h")
+        {
+            printHelp();
+            exit(0);
+        }
+        else if (arg == "-j" && hasValue)
+        {
+            numProcesses = static_cast<size_t>(std::max(std::stoi(argv[idx + 1]), 1));
+            idx = idx + 2;
+        }
+        else if (arg == "-d" && hasValue)
+        {
+            dimName = std::string(argv[idx + 1]);
+            idx = idx + 2;
+        }
+        else if (arg == "-o" && hasValue)
+        {
+            jobs.push_back({std::string(argv[idx + 1]), {}});
+            idx = idx + 2;
+        }
+        else if (!jobs.empty())
+        {
+            const auto paths = expandPath(arg);
+            jobs.back().inputs.insert(jobs.back().inputs.end(), paths.begin(), paths.end());
+            idx++;
+        }
+        else
+        {
+            printHelp();
+            std::cerr << "Error: " << arg << " comes before any output (-o)" << std::endl;
+            exit(1);
+        }
+    }
+
+    if (jobs.empty())
+    {
+        printHelp();
+        std::cerr << "Error: no output specified" << std::endl;
+        exit(1);
+    }
+
+    const Ingester::IodaConcat concat(dimName);
+    size_t numFailed = 0;
+    if (numProcesses <= 1 || jobs.size() == 1)
+    {
+        for (const auto& job : jobs)
+        {
+            if (!runJob(concat, job)) numFailed++;
+        }
+    }
+    else
+    {
+        // HDF5 isn't thread safe, so the outputs are written concurrently by child processes.
+        size_t numRunning = 0;
+        auto waitForOne = [&numRunning, &numFailed]()
+        {
+            int status = 0;
+            if (wait(&status) > 0)
+            {
+                numRunning--;
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) numFailed++;
+            }
+        };
+
+        for (const auto& job : jobs)
+        {
+            if (numRunning >= numProcesses) waitForOne();
+
+            std::cout.flush();
+            std::cerr.flush();
+
+            const pid_t pid = fork();
+            if (pid < 0)
+            {
+                std::cerr << "Error: couldn't fork the process writing " << job.output
+                          << std::endl;
+                numFailed++;
+                continue;
+            }
+
+            if (pid == 0)
+            {
+                const bool isOk = runJob(concat, job);
+                std::cout.flush();
+                std::cerr.flush();
+                _exit(isOk ? 0 : 1);
+            }
+
+            numRunning++;
+        }
+
+        while (numRunning > 0) waitForOne();
+    }
+
+    return numFailed == 0 ? 0 : 1;
+}
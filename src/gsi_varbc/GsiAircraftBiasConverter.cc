@@ -26,10 +26,11 @@
 #include "GsiAircraftBiasReader.h"
 
 ioda::ObsGroup makeObsBiasObject(ioda::Group &empty_base_object,
-                                 const std::string & coeffile,
-                                 const std::vector<std::string> & tailIds,
-                                 const std::vector<int> & lastCycleUpdatedYYYYMM,
+                                 const GsiAircraftBias & bias,
                                  const std::vector<std::string> & predictors) {
+  const std::vector<std::string> & tailIds = bias.tailIds;
+  const std::vector<int> & lastCycleUpdatedYYYYMM = bias.datetimes;
+
   /// Predictors
   int numPreds = predictors.size();
   int numIds = tailIds.size();
@@ -70,42 +71,32 @@ ioda::ObsGroup makeObsBiasObject(ioda::Group &empty_base_object,
                                             std::string("seconds since 1970-01-01T00:00:00Z"));
   lastCycleUpdatedVar.write(lastCycleUpdated);
 
-  /// Create 2D bias coefficient variable
-  Eigen::ArrayXXf biascoeffs(numIds, numPreds*3);
-
-  readObsBiasCoefficients(coeffile, biascoeffs);
+  /// Set up the creation parameters for the bias coefficients variables
+  ioda::VariableCreationParameters float_params;
+  float_params.chunk = true;               // allow chunking
+  float_params.compressWithGZIP();         // compress using gzip
+  float missing_value = util::missingValue<float>();
+  float_params.setFillValue<float>(missing_value);
 
+  /// Each predictor column is written whole, as read from the file
   for (int i = 0; i < numPreds; ++i) {
-    /// Set up the creation parameters for the bias coefficients variable
-    ioda::VariableCreationParameters float_params;
-    float_params.chunk = true;               // allow chunking
-    float_params.compressWithGZIP();         // compress using gzip
-    float missing_value = util::missingValue<float>();
-    float_params.setFillValue<float>(missing_value);
-
-    // Access predictor coefficient values column and create variable
-    Eigen::ArrayXXf subVar = biascoeffs.col(i);
-
     ioda::Variable biasVar = ogrp.vars.createWithScales<float>("BiasCoefficients/"+predictors[i],
                        {ogrp.vars["Variable"], ogrp.vars["Record"]}, float_params);
-    biasVar.writeWithEigenRegular(subVar);
-
-    // Access predictor background error values column and create variable
-    Eigen::ArrayXXf subVarBkgError = biascoeffs.col(i+6);
+    biasVar.write(bias.coeffs(i));
 
     ioda::Variable biasVarBkgError = ogrp.vars.createWithScales<float>(
                                                 "BiasCoefficientErrors/"+predictors[i],
                                                 {ogrp.vars["Variable"], ogrp.vars["Record"]},
                                                 float_params);
-    biasVarBkgError.writeWithEigenRegular(subVarBkgError);
+    biasVarBkgError.write(bias.errs(i));
   }
 
   // write out number of obs assimilated
-  Eigen::ArrayXXf numObs = biascoeffs.col(3);
+  std::vector<int> numObs(bias.nobs().begin(), bias.nobs().end());
   ioda::Variable numObsAssim = ogrp.vars.createWithScales<int>(
                                            "numberObservationsUsed",
                                            {ogrp.vars["Variable"], ogrp.vars["Record"]});
-  numObsAssim.writeWithEigenRegular(numObs);
+  numObsAssim.write(numObs);
 
   return ogrp;
 }
@@ -120,11 +111,8 @@ int main(int argc, char** argv) {
   /// Grab input coeff file
   const std::string coeffile = config.getString("input coeff file");
 
-  /// Use function to grab tail IDs from input coeff file
-  const std::vector<std::string> tailIds = findTailIds(coeffile);
-
-  /// Use function to grab datetimes
-  const std::vector<int> lastCycleUpdatedYYYYMM = findDatetimes(coeffile);
+  /// Read the tail IDs, datetimes and coefficients from input coeff file
+  const GsiAircraftBias bias = readAircraftBias(coeffile);
 
   /// Read from config file "output"
   std::vector<eckit::LocalConfiguration> configs = config.getSubConfigurations("output");
@@ -143,5 +131,5 @@ int main(int argc, char** argv) {
   /// Create ncfile
   ioda::Group group = ioda::Engines::HH::createFile(output_filename,
                       ioda::Engines::BackendCreateModes::Truncate_If_Exists);
-  makeObsBiasObject(group, coeffile, tailIds, lastCycleUpdatedYYYYMM, predictors);
+  makeObsBiasObject(group, bias, predictors);
 }
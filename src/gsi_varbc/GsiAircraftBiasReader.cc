@@ -7,98 +7,72 @@
 
 #include "GsiAircraftBiasReader.h"
 
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
-#include <fstream>
-#include <iostream>
 
-#include <Eigen/Dense>
+#include "eckit/exception/Exceptions.h"
 
-std::vector<std::string> findTailIds(const std::string& filename) {
-    std::vector<std::string> tailIds;
+namespace {
 
-    // Open the input file
-    std::ifstream fin(filename);
-
-    if (!fin.is_open()) {
-        std::cout << "Could not open the file." << std::endl;
-        return tailIds;
-    }
-
-    std::string line;
-    while (std::getline(fin, line)) {
-        std::istringstream ss(line);
-        std::string value;
-
-        // Read the first column value (using default white space delimiter)
-        if (ss >> value) {
-            tailIds.push_back(value);
-        }
-    }
-
-    fin.close();
-
-    return tailIds;
+const char * skipSpace(const char * pos) {
+  while (*pos != '\0' && std::isspace(static_cast<unsigned char>(*pos))) ++pos;
+  return pos;
 }
 
-
-//---------------------------------------------------------------------------------------
-std::vector<int> findDatetimes(const std::string& filename) {
-    std::vector<int> datetimes;
-
-    std::ifstream inputFile(filename);
-
-    if (!inputFile) {
-        std::cout << "Could not open the file." << std::endl;
-        return datetimes;
-    }
-
-    std::string line;
-    while (std::getline(inputFile, line)) {
-        std::istringstream iss(line);
-        int value;
-        std::string datetime;
-
-        // Read and discard other columns, keeping only the last one
-        while (iss >> datetime) {
-            // Try to convert the last column value to an integer
-            std::istringstream(datetime) >> value;
-        }
-
-        // Store the integer value from the last column
-        datetimes.push_back(value);
-    }
-
-    inputFile.close();  // Close the input file
-
-    return datetimes;
+void throwBadRow(const std::string & filename, size_t lineNumber) {
+  std::ostringstream error;
+  error << "Line " << lineNumber << " of " << filename << " isn't a tail id, a channel index, "
+        << gsi_nvalues << " values and a datetime";
+  throw eckit::BadValue(error.str(), Here());
 }
 
+}  // namespace
 
 //---------------------------------------------------------------------------------------
-void readObsBiasCoefficients(const std::string &filename, Eigen::ArrayXXf &coeffs) {
+GsiAircraftBias readAircraftBias(const std::string & filename) {
   std::ifstream infile(filename);
-
   if (!infile.is_open()) {
-    std::cerr << "Error: Unable to open file." << std::endl;
-    return;
+    throw eckit::CantOpenFile(filename, Here());
   }
 
-  // Grab total rows of file
-  std::size_t nrows = coeffs.rows();
-
-  // Define vars and loop through rows
-  std::string tailIds;
-  int ich;
-  int datetime;
-  for (std::size_t row = 0; row < nrows; ++row) {
-    infile >> tailIds;  // Skip the first two columns
-    infile >> ich;
-    for (std::size_t col = 0; col < 9; ++col) {
-      infile >> coeffs(row, col);  // Read data from columns 3 to 11
+  GsiAircraftBias bias;
+
+  // Each row is: tail id, channel index, the values and the datetime (YYYYMM)
+  std::string line;
+  size_t lineNumber = 0;
+  while (std::getline(infile, line)) {
+    ++lineNumber;
+    const char * pos = skipSpace(line.c_str());
+    if (*pos == '\0') continue;
+
+    const char * tailIdEnd = pos;
+    while (*tailIdEnd != '\0' && !std::isspace(static_cast<unsigned char>(*tailIdEnd))) {
+      ++tailIdEnd;
     }
-    infile >> datetime;
+    const std::string tailId(pos, tailIdEnd);
+
+    char * end;
+    std::strtol(tailIdEnd, &end, 10);  // channel index
+    if (end == tailIdEnd) throwBadRow(filename, lineNumber);
+    pos = end;
+
+    for (size_t icol = 0; icol < gsi_nvalues; ++icol) {
+      const float value = std::strtof(pos, &end);
+      if (end == pos) throwBadRow(filename, lineNumber);
+      bias.columns[icol].push_back(value);
+      pos = end;
+    }
+
+    const long datetime = std::strtol(pos, &end, 10);
+    if (end == pos) throwBadRow(filename, lineNumber);
+
+    bias.tailIds.push_back(tailId);
+    bias.datetimes.push_back(static_cast<int>(datetime));
   }
 
-  infile.close();
+  return bias;
 }
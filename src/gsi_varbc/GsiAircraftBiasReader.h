@@ -9,20 +9,30 @@
 
 #include <string>
 #include <vector>
-#include <fstream>
-#include <iostream>
-
-#include <Eigen/Dense>
 
 /// Number of predictors in GSI aircraft bias file
 constexpr size_t gsi_npredictors = 3;
 
-/// Find all tail ids in file
-std::vector<std::string> findTailIds(const std::string& filename);
+/// Number of value columns (between the channel index and the datetime) in each row of the
+/// GSI aircraft bias file: the coefficients of the predictors, the number of observations,
+/// two unused columns and the coefficients errors
+constexpr size_t gsi_nvalues = 9;
+
+/// Contents of a GSI aircraft bias file, one entry per row (tail id)
+struct GsiAircraftBias {
+  std::vector<std::string> tailIds;
+  std::vector<int> datetimes;  ///< last cycle updated (YYYYMM)
+
+  /// Value columns, each with one value per row
+  std::vector<std::vector<float>> columns = std::vector<std::vector<float>>(gsi_nvalues);
 
-/// Find datetimes in file
-std::vector<int> findDatetimes(const std::string& filename);
+  /// Bias coefficients of the \p ipred predictor
+  const std::vector<float> & coeffs(size_t ipred) const { return columns[ipred]; }
+  /// Bias coefficients errors of the \p ipred predictor
+  const std::vector<float> & errs(size_t ipred) const { return columns[ipred + 6]; }
+  /// Number of observations used
+  const std::vector<float> & nobs() const { return columns[3]; }
+};
 
-/// Read bias coefficients from GSI bias coefficients files
-void readObsBiasCoefficients(const std::string& inputFilePath,
-                             Eigen::ArrayXXf & biascoeffs);
+/// Read the tail ids, datetimes and bias coefficients of a GSI aircraft bias file in one pass
+GsiAircraftBias readAircraftBias(const std::string & filename);
@@ -7,142 +7,164 @@
 
 #include "GsiSatBiasReader.h"
 
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
-#include <fstream>
 
-#include <Eigen/Dense>
-
-/// Read info for one channel from the GSI text file
-/// Returns sensor (instrument + satellite) name and channel index
-void readOneChannel(std::ifstream & infile, std::string & sensor, size_t & channel) {
-  float tlap, tsum;
-  std::size_t ntlapupdate;
-  float par;
-  infile >> sensor;
-  infile >> channel;
-  infile >> tlap;
-  infile >> tsum;
-  infile >> ntlapupdate;
-  for (size_t ii = 0; ii < gsi_npredictors; ++ii) {
-    infile >> par;
+#include "eckit/exception/Exceptions.h"
+
+namespace {
+
+/// Whitespace separated tokens of a GSI text file. The whole file is read at once and the
+/// numbers are converted in place (no stream extraction per value).
+class GsiTextReader {
+ public:
+  explicit GsiTextReader(const std::string & filename) : filename_(filename) {
+    std::ifstream infile(filename, std::ios::binary);
+    if (!infile.is_open()) {
+      throw eckit::CantOpenFile(filename, Here());
+    }
+
+    std::ostringstream contents;
+    contents << infile.rdbuf();
+    text_ = contents.str();
+    pos_ = text_.c_str();
+  }
+
+  /// Returns true at the end of the file
+  bool atEnd() {
+    skipSpace();
+    return *pos_ == '\0';
+  }
+
+  size_t readSize() {
+    skipSpace();
+    char * end;
+    const auto value = std::strtoul(pos_, &end, 10);
+    checkToken(end, "an integer");
+    return static_cast<size_t>(value);
+  }
+
+  float readFloat() {
+    skipSpace();
+    char * end;
+    const float value = std::strtof(pos_, &end);
+    checkToken(end, "a number");
+    return value;
+  }
+
+  std::string readString() {
+    skipSpace();
+    const char * begin = pos_;
+    while (*pos_ != '\0' && !std::isspace(static_cast<unsigned char>(*pos_))) ++pos_;
+    checkToken(pos_, "a name", begin);
+    return std::string(begin, pos_);
+  }
+
+  void skipFloats(size_t count) {
+    for (size_t ii = 0; ii < count; ++ii) readFloat();
+  }
+
+ private:
+  const std::string filename_;
+  std::string text_;
+  const char * pos_;
+
+  void skipSpace() {
+    while (*pos_ != '\0' && std::isspace(static_cast<unsigned char>(*pos_))) ++pos_;
+  }
+
+  void checkToken(const char * end, const char * expected) {
+    checkToken(end, expected, pos_);
+    pos_ = end;
   }
-}
 
-/// Finds all sensors in the file (returned in \p sensors) and number of channels
-/// for all the sensors (returned in \p nchannels)
-void findSensorsChannels(const std::string & filename, std::vector<std::string> & sensors,
-                         std::vector<int> & nchannels) {
-  std::ifstream infile(filename);
-
-  std::size_t ich;     //  sequential number
-  std::string sensor;  //  sensor/instrument/satellite
-  std::size_t channel;  //  channel number
-
-  if (infile.is_open())
-  {
-    /// Read the first entry, save first sensor
-    infile >> ich;
-    readOneChannel(infile, sensor, channel);
-    sensors.push_back(sensor);
-    size_t nsensors = 0;
-    nchannels.push_back(1);
-
-    while (infile >> ich)
-    {
-      readOneChannel(infile, sensor, channel);
-      if (sensor == sensors[nsensors]) {
-        // still processing the same sensor, just update the number of channels
-        nchannels[nsensors]++;
-      } else {
-        // new sensor: move on
-        sensors.push_back(sensor);
-        nsensors++;
-        nchannels.push_back(1);
-      }
+  void checkToken(const char * end, const char * expected, const char * begin) const {
+    if (end == begin) {
+      std::ostringstream error;
+      error << "Expected " << expected << " at offset " << (begin - text_.c_str())
+            << " of " << filename_;
+      throw eckit::BadValue(error.str(), Here());
     }
-    infile.close();
   }
+};
+
+}  // namespace
+
+//---------------------------------------------------------------------------------------
+GsiSatBiasIndex::GsiSatBiasIndex(const std::string & coeffile, const std::string & errfile) {
+  readCoefficients(coeffile);
+  readCoeffErrors(errfile);
 }
 
 //---------------------------------------------------------------------------------------
-void readObsBiasCoefficients(const std::string & filename, const std::string & sensor,
-                             std::vector<int> & channels, Eigen::ArrayXXf & coeffs ) {
-  std::ifstream infile(filename);
-
-  std::size_t ich;     //  sequential number
-  std::string nusis;   //  sensor/instrument/satellite
-  std::size_t nuchan;  //  channel number
-  float tlap, tsum;
-  std::size_t ntlapupdate;
-
-  if (infile.is_open())
-  {
-    float par;
-    size_t jchan = 0;
-    while (infile >> ich)
-    {
-      infile >> nusis;
-      infile >> nuchan;
-      infile >> tlap;
-      infile >> tsum;
-      infile >> ntlapupdate;
-      if (nusis == sensor) {
-        /// it's the sensor we're interested in; read in coefficients and channel
-        /// indices
-        for (size_t jpred = 0; jpred < gsi_npredictors; ++jpred) {
-          infile >> par;
-          coeffs(jpred, jchan) = par;
-          channels[jchan] = nuchan;
-        }
-        jchan++;
-      } else {
-        /// not interested in this channel; passing
-        for (size_t jpred = 0; jpred < gsi_npredictors; ++jpred) {
-          infile >> par;
-        }
-      }
+const GsiSensorBias * GsiSatBiasIndex::find(const std::string & sensor) const {
+  const auto it = biases_.find(sensor);
+  return it == biases_.end() ? nullptr : &it->second;
+}
+
+//---------------------------------------------------------------------------------------
+/// Reads the satbias_in file. Each channel is:
+/// ich (sequential number), sensor, channel, tlap, tsum, ntlapupdate, predictor coefficients
+void GsiSatBiasIndex::readCoefficients(const std::string & filename) {
+  GsiTextReader infile(filename);
+
+  while (!infile.atEnd()) {
+    infile.readSize();  // sequential number
+    const std::string sensor = infile.readString();
+    const size_t channel = infile.readSize();
+    infile.skipFloats(2);  // tlap, tsum
+    infile.readSize();  // ntlapupdate
+
+    auto it = biases_.find(sensor);
+    if (it == biases_.end()) {
+      sensors_.push_back(sensor);
+      it = biases_.emplace(sensor, GsiSensorBias()).first;
+    }
+
+    GsiSensorBias & bias = it->second;
+    bias.channels.push_back(static_cast<int>(channel));
+    for (size_t jpred = 0; jpred < gsi_npredictors; ++jpred) {
+      bias.coeffs.push_back(infile.readFloat());
     }
-    infile.close();
   }
 }
 
 //---------------------------------------------------------------------------------------
-void readObsBiasCoeffErrors(const std::string & filename, const std::string & sensor,
-                           std::vector<int> & channels, Eigen::ArrayXXf & errs,
-                           Eigen::ArrayXf & nobs) {
-  std::ifstream infile(filename);
-
-  std::size_t ich;     //  sequential number
-  std::string nusis;   //  sensor/instrument/satellite
-  std::size_t nuchan;  //  channel number
-
-  if (infile.is_open())
-  {
-    float par;
-    size_t jchan = 0;
-    while (infile >> ich)
-    {
-      infile >> nusis;
-      infile >> nuchan;
-      infile >> par;
-      if (nusis == sensor) {
-        nobs(jchan) = par;
-        /// it's the sensor we're interested in; read in coefficients and channel
-        /// indices
-        for (size_t jpred = 0; jpred < gsi_npredictors; ++jpred) {
-          infile >> par;
-          errs(jpred, jchan) = par;
-          channels[jchan] = nuchan;
-        }
-        jchan++;
-      } else {
-        /// not interested in this channel; passing
-        for (size_t jpred = 0; jpred < gsi_npredictors; ++jpred) {
-          infile >> par;
-        }
-      }
+/// Reads the satbias_pc file. Each channel is:
+/// ich (sequential number), sensor, channel, nobs, predictor coefficients error variances.
+/// The channels of each sensor must be the ones (in the same order) of the satbias_in file.
+void GsiSatBiasIndex::readCoeffErrors(const std::string & filename) {
+  GsiTextReader infile(filename);
+
+  while (!infile.atEnd()) {
+    infile.readSize();  // sequential number
+    const std::string sensor = infile.readString();
+    const size_t channel = infile.readSize();
+    const float nobs = infile.readFloat();
+
+    const auto it = biases_.find(sensor);
+    if (it == biases_.end()) {
+      // not in the coefficients file; passing
+      infile.skipFloats(gsi_npredictors);
+      continue;
+    }
+
+    GsiSensorBias & bias = it->second;
+    const size_t jchan = bias.nobs.size();
+    if (jchan >= bias.nchannels() || bias.channels[jchan] != static_cast<int>(channel)) {
+      std::ostringstream error;
+      error << "Channel " << channel << " of " << sensor << " in " << filename
+            << " doesn't match the channels in the coefficients file";
+      throw eckit::BadValue(error.str(), Here());
+    }
+
+    bias.nobs.push_back(nobs);
+    for (size_t jpred = 0; jpred < gsi_npredictors; ++jpred) {
+      bias.errs.push_back(infile.readFloat());
     }
-    infile.close();
   }
 }
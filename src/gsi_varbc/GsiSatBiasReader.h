@@ -8,34 +8,52 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
-#include <fstream>
 
 #include <Eigen/Dense>
 
 /// Number of predictors in GSI satbias file
 constexpr size_t gsi_npredictors = 12;
 
-/// Finds all sensors in the file (returned in \p sensors) and number of channels
-/// for all the sensors (returned in \p nchannels)
-void findSensorsChannels(const std::string & filename, std::vector<std::string> & sensors,
-                         std::vector<int> & nchannels);
-
-/// Read bias coefficients from the GSI bias coefficients file (satbias_in)
-/// \param filename file with bias coefficients (GSI style)
-/// \param sensor instrument+satellite that is to be read from the file
-/// \param(out) channels channels for \p sensor
-/// \param(out) coeffs bias coefficients
-void readObsBiasCoefficients(const std::string & filename, const std::string & sensor,
-                             std::vector<int> & channels, Eigen::ArrayXXf & coeffs);
-
-/// Read bias coefficients errors from the GSI file (satbias_pc)
-/// \param filename file with bias coefficients (GSI style)
-/// \param sensor instrument+satellite that is to be read from the file
-/// \param(out) channels channels for \p sensor
-/// \param(out) errs bias coefficients error variances
-/// \param(out) nobs number of observations
-void readObsBiasCoeffErrors(const std::string & filename, const std::string & sensor,
-                           std::vector<int> & channels, Eigen::ArrayXXf & errs,
-                           Eigen::ArrayXf & nobs);
-
+/// Bias correction info for the channels of one sensor (instrument+satellite)
+struct GsiSensorBias {
+  std::vector<int> channels;      ///< channel numbers
+  std::vector<float> coeffs;      ///< bias coefficients (gsi_npredictors per channel)
+  std::vector<float> errs;        ///< bias coefficients error variances (same layout)
+  std::vector<float> nobs;        ///< number of observations (per channel)
+
+  size_t nchannels() const { return channels.size(); }
+
+  /// Bias coefficients as a (gsi_npredictors, nchannels) array
+  Eigen::Map<const Eigen::ArrayXXf> coeffsArray() const {
+    return Eigen::Map<const Eigen::ArrayXXf>(coeffs.data(), gsi_npredictors, nchannels());
+  }
+
+  /// Bias coefficients error variances as a (gsi_npredictors, nchannels) array
+  Eigen::Map<const Eigen::ArrayXXf> errsArray() const {
+    return Eigen::Map<const Eigen::ArrayXXf>(errs.data(), gsi_npredictors, nchannels());
+  }
+};
+
+/// Bias correction info of all the sensors in a pair of GSI files (satbias_in and satbias_pc).
+/// Each file is read and parsed once; the sensors are then looked up by name.
+class GsiSatBiasIndex {
+ public:
+  /// \param coeffile file with bias coefficients (GSI satbias_in)
+  /// \param errfile file with bias coefficients errors (GSI satbias_pc)
+  GsiSatBiasIndex(const std::string & coeffile, const std::string & errfile);
+
+  /// Sensors in the order they appear in the coefficients file
+  const std::vector<std::string> & sensors() const { return sensors_; }
+
+  /// Info for \p sensor, nullptr if the sensor isn't in the coefficients file
+  const GsiSensorBias * find(const std::string & sensor) const;
+
+ private:
+  std::vector<std::string> sensors_;
+  std::unordered_map<std::string, GsiSensorBias> biases_;
+
+  void readCoefficients(const std::string & filename);
+  void readCoeffErrors(const std::string & filename);
+};
@@ -5,6 +5,11 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
@@ -25,23 +30,23 @@
 
 // Return ObsGroup with bias coefficients for a given sensor
 ioda::ObsGroup makeObsBiasObject(ioda::Group &empty_base_object,
-                                 const std::string & coeffile, const std::string & errfile,
-                                 const std::string & sensor,
-                                 const std::vector<std::string> & predictors,
-                                 const size_t nchannels) {
+                                 const GsiSensorBias & bias, const std::string & sensor,
+                                 const std::vector<std::string> & predictors) {
   // Channels & predictors
-  std::vector<int> channels(nchannels), channels_in_errorfile(nchannels);
+  const std::vector<int> & channels = bias.channels;
   long numPreds = predictors.size();
   long numChans = channels.size();
   long numRecs = 1;
 
-  // Allocate space for bias coefficients and read them from GSI satbias file
-  Eigen::ArrayXXf biascoeffs(numPreds, numChans);
-  Eigen::ArrayXXf biascoefferrs(numPreds, numChans);
-  Eigen::ArrayXf  nobs(numChans);
-  readObsBiasCoefficients(coeffile, sensor, channels, biascoeffs);
-  readObsBiasCoeffErrors(errfile, sensor, channels_in_errorfile, biascoefferrs, nobs);
-  ASSERT(channels == channels_in_errorfile);
+  // Bias coefficients read from GSI satbias files
+  if (bias.nobs.size() != bias.nchannels()) {
+    const std::string error = "The channels of " + sensor + " in the input err file don't "
+                              "match the ones in the input coeff file";
+    throw eckit::BadValue(error, Here());
+  }
+  const auto biascoeffs = bias.coeffsArray();
+  const auto biascoefferrs = bias.errsArray();
+  const std::vector<float> & nobs = bias.nobs;
 
   // Creating dimensions: npredictors & nchannels
   ioda::NewDimensionScales_t newDims {
@@ -68,26 +73,26 @@ ioda::ObsGroup makeObsBiasObject(ioda::Group &empty_base_object,
   const float missing_value = util::missingValue<float>();
   float_params.setFillValue<float>(missing_value);
 
-  // Loop over the predictors and create variables for each
+  // Loop over the predictors and create variables for each. The coefficients of each
+  // predictor are gathered into one buffer that is reused for all the writes.
+  std::vector<float> predvalues(numChans);
   for (int ipred = 0; ipred < numPreds; ipred++) {
     // create and write the bias coeffs
     ioda::Variable biasVar = ogrp.vars.createWithScales<float>(
                        "BiasCoefficients/"+predictors[ipred],
                        {ogrp.vars["Record"], ogrp.vars["Channel"]}, float_params);
-    Eigen::ArrayXXf biascoeff(1, numChans);
     for (int ich = 0; ich < numChans; ich++) {
-      biascoeff(0, ich) = biascoeffs(ipred, ich);
+      predvalues[ich] = biascoeffs(ipred, ich);
     }
-    biasVar.writeWithEigenRegular(biascoeff);
+    biasVar.write(predvalues);
     // create and write the error variances
     ioda::Variable biaserrVar = ogrp.vars.createWithScales<float>(
                        "BiasCoefficientErrors/"+predictors[ipred],
                        {ogrp.vars["Record"], ogrp.vars["Channel"]}, float_params);
-    Eigen::ArrayXXf biascoefferr(1, numChans);
     for (int ich = 0; ich < numChans; ich++) {
-      biascoefferr(0, ich) = biascoefferrs(ipred, ich);
+      predvalues[ich] = biascoefferrs(ipred, ich);
     }
-    biaserrVar.writeWithEigenRegular(biascoefferr);
+    biaserrVar.write(predvalues);
   }
 
   // Create a variable for number of obs (used in the bias coeff error covariance)
@@ -95,12 +100,66 @@ ioda::ObsGroup makeObsBiasObject(ioda::Group &empty_base_object,
                      {ogrp.vars["Record"], ogrp.vars["Channel"]});
   Eigen::ArrayXXf nobs_out(1, numChans);
   for (int ich = 0; ich < numChans; ich++) {
-    nobs_out(0, ich) = nobs(ich);
+    nobs_out(0, ich) = nobs[ich];
   }
   nobsVar.writeWithEigenRegular(nobs_out);
   return ogrp;
 }
 
+/// One output file of the converter
+struct OutputJob {
+  std::string sensor;
+  std::string filename;
+  std::vector<std::string> predictors;
+  const GsiSensorBias * bias;
+};
+
+void writeOutput(const OutputJob & job) {
+  ioda::Group group = ioda::Engines::HH::createFile(job.filename,
+                      ioda::Engines::BackendCreateModes::Truncate_If_Exists);
+  makeObsBiasObject(group, *job.bias, job.sensor, job.predictors);
+}
+
+/// Write the output files with \p nworkers processes, each writing every nworkers-th file.
+/// Processes are used (not threads) since the HDF5 library can't be used by several threads.
+void writeOutputsInWorkers(const std::vector<OutputJob> & jobs, const size_t nworkers) {
+  std::cout.flush();
+
+  std::vector<pid_t> workers;
+  for (size_t jworker = 0; jworker < nworkers; ++jworker) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+      throw eckit::SeriousBug("Couldn't fork a process to write output files", Here());
+    }
+    if (pid == 0) {
+      int status = 0;
+      for (size_t jj = jworker; jj < jobs.size(); jj += nworkers) {
+        try {
+          writeOutput(jobs[jj]);
+        } catch (const std::exception & e) {
+          std::cerr << "Writing " << jobs[jj].filename << " failed: " << e.what() << std::endl;
+          status = 1;
+        }
+      }
+      _exit(status);
+    }
+    workers.push_back(pid);
+  }
+
+  size_t nfailed = 0;
+  for (const pid_t pid : workers) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      nfailed++;
+    }
+  }
+  if (nfailed > 0) {
+    const std::string error = std::to_string(nfailed) + " of the processes writing the "
+                              "output files failed";
+    throw eckit::SeriousBug(error, Here());
+  }
+}
+
 int main(int argc, char** argv) {
   /// Open yaml with configuration for this converter
   ASSERT(argc >= 2);
@@ -109,37 +168,45 @@ int main(int argc, char** argv) {
   const std::string coeffile = config.getString("input coeff file");
   const std::string errfile  = config.getString("input err file");
 
-  std::vector<std::string> sensors;
-  std::vector<int> nchannels;
+  /// Read all sensors from the GSI bias coefficients and errors files
+  const GsiSatBiasIndex biases(coeffile, errfile);
 
-  /// Find all sensors and number of channels in the GSI bias coefficients file
-  findSensorsChannels(coeffile, sensors, nchannels);
-
-  std::cout << "Found " << sensors.size() << " sensors:" << std::endl;
-  for (size_t jj = 0; jj < sensors.size(); ++jj) {
-    std::cout << "-- " << sensors[jj] << ", " << nchannels[jj] << " channels." << std::endl;
+  std::cout << "Found " << biases.sensors().size() << " sensors:" << std::endl;
+  for (const std::string & sensor : biases.sensors()) {
+    std::cout << "-- " << sensor << ", " << biases.find(sensor)->nchannels() << " channels."
+              << std::endl;
   }
 
+  /// Check all the outputs before writing any of them
+  std::vector<OutputJob> jobs;
   std::vector<eckit::LocalConfiguration> configs = config.getSubConfigurations("output");
   for (size_t jj = 0; jj < configs.size(); ++jj) {
-    const std::string sensor = configs[jj].getString("sensor");
-    const std::string output_filename = configs[jj].getString("output file");
-    const std::vector<std::string> predictors = configs[jj].getStringVector("predictors");
-    if (predictors.size() != gsi_npredictors) {
+    OutputJob job;
+    job.sensor = configs[jj].getString("sensor");
+    job.filename = configs[jj].getString("output file");
+    job.predictors = configs[jj].getStringVector("predictors");
+    if (job.predictors.size() != gsi_npredictors) {
       const std::string error = "Number of predictors specified in yaml must be " +
             std::to_string(gsi_npredictors) + " (same as number of predictors in GSI satinfo)";
       throw eckit::BadValue(error, Here());
     }
-    auto it = find(sensors.begin(), sensors.end(), sensor);
-    if (it != sensors.end()) {
-      int index = it - sensors.begin();
-      ioda::Group group = ioda::Engines::HH::createFile(output_filename,
-                          ioda::Engines::BackendCreateModes::Truncate_If_Exists);
-      makeObsBiasObject(group, coeffile, errfile, sensor, predictors, nchannels[index]);
-    } else {
-      const std::string error = "No " + sensor + " sensor in the input file";
+    job.bias = biases.find(job.sensor);
+    if (job.bias == nullptr) {
+      const std::string error = "No " + job.sensor + " sensor in the input file";
       throw eckit::BadValue(error, Here());
     }
+    jobs.push_back(job);
+  }
+
+  /// Write the output files, using several processes if asked to
+  const size_t nworkers = std::min(static_cast<size_t>(config.getInt("workers", 1)),
+                                   jobs.size());
+  if (nworkers <= 1) {
+    for (const OutputJob & job : jobs) {
+      writeOutput(job);
+    }
+  } else {
+    writeOutputsInWorkers(jobs, nworkers);
   }
   return 0;
 }
@@ -0,0 +1,433 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+/// \file Throughput benchmarks for the hot paths of the BUFR converter (decoding the subsets
+///       into the SubsetLookupTables of a ResultSet, building the fields, the filters, splits and
+///       variables, and the IODA encoding). Run it from the test directory of the build (it
+///       reads ./testinput and writes to ./testrun), ex:
+///
+///           bufr_benchmarks --benchmark_out=benchmarks.json --benchmark_out_format=json
+///
+///       and compare the JSON of two builds with the compare.py tool of google-benchmark.
+
+#include <sys/stat.h>
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/config/YAMLConfiguration.h"
+#include "eckit/exception/Exceptions.h"
+#include "eckit/filesystem/PathName.h"
+
+#include "BufrParser/BufrDescription.h"
+#include "BufrParser/BufrParser.h"
+#include "BufrParser/Exports/Filters/Filter.h"
+#include "BufrParser/Query/DataProvider/MessageBuffer.h"
+#include "BufrParser/Query/File.h"
+#include "BufrParser/Query/QuerySet.h"
+#include "BufrParser/Query/ResultSet.h"
+#include "DataContainer.h"
+#include "IodaEncoder/IodaEncoder.h"
+
+
+namespace
+{
+    const char* MhsYaml = "./testinput/bufr_ncep_1bmhs.yaml";
+    const char* FilteringYaml = "./testinput/bufr_filtering.yaml";
+    const char* SondeYaml = "./testinput/bufr_ncep_highRes_sonde.yaml";
+
+    /// \brief An observations entry of one of the test YAML files.
+    struct Observation
+    {
+        Ingester::BufrDescription description;
+        eckit::LocalConfiguration iodaConf;
+    };
+
+    Observation loadObservation(const std::string& yamlPath)
+    {
+        const eckit::PathName yamlFile(yamlPath);
+        const eckit::YAMLConfiguration yaml(yamlFile);
+        const auto obsConf = yaml.getSubConfigurations("observations").front();
+
+        auto description = Ingester::BufrDescription(obsConf.getSubConfiguration("obs space"));
+        description.setIndexpath("");
+        description.setTableCachePath("");
+        description.setResultCachePath("");
+
+        return {description, obsConf.getSubConfiguration("ioda")};
+    }
+
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::ostringstream errStr;
+            errStr << "bufr_benchmarks: Can't read " << path << " (run from the test directory).";
+            throw eckit::BadParameter(errStr.str());
+        }
+
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    /// \brief Synthetic large BUFR file, the messages of a file repeated copies times (the
+    ///        tables of NCEP files are repeated too, so each copy is a valid file).
+    std::shared_ptr<const Ingester::bufr::MessageBuffer> makeLargeFile(const std::string& path,
+                                                                       size_t copies)
+    {
+        const auto contents = readFile(path);
+
+        std::string large;
+        large.reserve(contents.size() * copies);
+        for (size_t copyIdx = 0; copyIdx < copies; ++copyIdx) large += contents;
+
+        return Ingester::bufr::MessageBuffer::copyOf(large.data(), large.size());
+    }
+
+    /// \brief The QuerySet of a description (what BufrParser runs).
+    Ingester::bufr::QuerySet makeQuerySet(const Ingester::BufrDescription& description)
+    {
+        auto querySet = Ingester::bufr::QuerySet(description.getExport().getSubsets());
+        for (const auto& var : description.getExport().getVariables())
+        {
+            for (const auto& queryInfo : var->getQueryList())
+            {
+                querySet.add(queryInfo.name, queryInfo.query);
+            }
+        }
+
+        return querySet;
+    }
+
+    Ingester::bufr::ResultSet execute(const Ingester::BufrDescription& description)
+    {
+        Ingester::bufr::File file(description.filepath());
+        auto resultSet = file.execute(makeQuerySet(description));
+        file.close();
+        return resultSet;
+    }
+
+    /// \brief The fields of a description (what BufrParser hands to the exports).
+    Ingester::BufrDataMap collectFields(const Ingester::BufrDescription& description,
+                                        const Ingester::bufr::ResultSet& resultSet)
+    {
+        auto fields = std::vector<Ingester::bufr::ResultSet::FieldRequest>();
+        for (const auto& var : description.getExport().getVariables())
+        {
+            for (const auto& queryInfo : var->getQueryList())
+            {
+                fields.push_back({queryInfo.name, queryInfo.groupByField, queryInfo.type});
+            }
+        }
+
+        auto dataMap = Ingester::BufrDataMap();
+        const auto dataObjects = resultSet.getMany(fields);
+        for (size_t fieldIdx = 0; fieldIdx < fields.size(); ++fieldIdx)
+        {
+            dataMap[fields[fieldIdx].fieldName] = dataObjects[fieldIdx];
+        }
+
+        return dataMap;
+    }
+
+    /// \brief The data the benchmarks share, loaded on first use.
+    struct Samples
+    {
+        Observation mhs = loadObservation(MhsYaml);
+        Observation filtering = loadObservation(FilteringYaml);
+        Observation sonde = loadObservation(SondeYaml);
+
+        Ingester::bufr::ResultSet mhsResults = execute(mhs.description);
+        Ingester::bufr::ResultSet sondeResults = execute(sonde.description);
+
+        Ingester::BufrDataMap mhsFields = collectFields(mhs.description, mhsResults);
+        Ingester::BufrDataMap filteringFields =
+            collectFields(filtering.description, execute(filtering.description));
+
+        std::shared_ptr<Ingester::DataContainer> filteringData =
+            Ingester::BufrParser(filtering.description).parse();
+
+        static Samples& get()
+        {
+            static Samples samples;
+            return samples;
+        }
+    };
+
+    std::int64_t fileSize(const std::string& path)
+    {
+        struct stat fileInfo;
+        return stat(path.c_str(), &fileInfo) == 0 ? static_cast<std::int64_t>(fileInfo.st_size) : 0;
+    }
+
+    // Decoding ---------------------------------------------------------------------------------
+
+    /// \brief Fill a ResultSet from a synthetic file of state.range(0) copies of the MHS test
+    ///        file, with the native decoder when state.range(1) is 1 (the SubsetLookupTable of
+    ///        every subset is built and appended to the columns).
+    void BM_Execute(benchmark::State& state)
+    {
+        const auto& samples = Samples::get();
+        const auto buffer = makeLargeFile(samples.mhs.description.filepath(),
+                                          static_cast<size_t>(state.range(0)));
+        const auto querySet = makeQuerySet(samples.mhs.description);
+
+        size_t numFrames = 0;
+        for (auto _ : state)
+        {
+            Ingester::bufr::File file(buffer);
+            file.setNativeDecoding(state.range(1) != 0);
+            auto resultSet = file.execute(querySet);
+            numFrames = resultSet.numFrames();
+            benchmark::DoNotOptimize(numFrames);
+        }
+
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * numFrames));
+        state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * buffer->size()));
+    }
+
+    BENCHMARK(BM_Execute)
+        ->ArgNames({"copies", "native"})
+        ->Args({1, 0})
+        ->Args({1, 1})
+        ->Args({16, 0})
+        ->Args({16, 1})
+        ->Unit(benchmark::kMillisecond);
+
+    // Building the fields ----------------------------------------------------------------------
+
+    void runGet(benchmark::State& state,
+                const Ingester::bufr::ResultSet& resultSet,
+                const std::string& fieldName,
+                const std::string& groupByFieldName = "")
+    {
+        size_t numValues = 0;
+        for (auto _ : state)
+        {
+            const auto dataObject = resultSet.get(fieldName, groupByFieldName);
+            numValues = dataObject->size();
+            benchmark::DoNotOptimize(numValues);
+        }
+
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * numValues));
+    }
+
+    /// \brief A jagged field (a different number of levels in each sounding).
+    void BM_GetJagged(benchmark::State& state)
+    {
+        auto& samples = Samples::get();
+        samples.sondeResults.setCaching(false);
+        runGet(state, samples.sondeResults, "pressure");
+    }
+
+    BENCHMARK(BM_GetJagged)->Unit(benchmark::kMicrosecond);
+
+    /// \brief A field grouped by another one (the levels become the locations).
+    void BM_GetGroupBy(benchmark::State& state)
+    {
+        auto& samples = Samples::get();
+        samples.sondeResults.setCaching(false);
+        runGet(state, samples.sondeResults, "airTemperature", "pressure");
+    }
+
+    BENCHMARK(BM_GetGroupBy)->Unit(benchmark::kMicrosecond);
+
+    /// \brief A field with a 2D (location, channel) shape.
+    void BM_GetChannels(benchmark::State& state)
+    {
+        auto& samples = Samples::get();
+        samples.mhsResults.setCaching(false);
+        runGet(state, samples.mhsResults, "antennaTemperature");
+    }
+
+    BENCHMARK(BM_GetChannels)->Unit(benchmark::kMicrosecond);
+
+    /// \brief A field picked out of a repeated sequence by index (a filtered target).
+    void BM_GetFiltered(benchmark::State& state)
+    {
+        const auto& samples = Samples::get();
+        auto querySet = Ingester::bufr::QuerySet();
+        querySet.add("channel2", "*/BRITCSTC/TMBR[2]");
+
+        Ingester::bufr::File file(samples.mhs.description.filepath());
+        auto resultSet = file.execute(querySet);
+        file.close();
+
+        resultSet.setCaching(false);
+        runGet(state, resultSet, "channel2");
+    }
+
+    BENCHMARK(BM_GetFiltered)->Unit(benchmark::kMicrosecond);
+
+    /// \brief All the fields of a description at once (ResultSet::getMany), with
+    ///        state.range(0) threads.
+    void BM_GetMany(benchmark::State& state)
+    {
+        auto& samples = Samples::get();
+        samples.mhsResults.setCaching(false);
+
+        auto fields = std::vector<Ingester::bufr::ResultSet::FieldRequest>();
+        for (const auto& var : samples.mhs.description.getExport().getVariables())
+        {
+            for (const auto& queryInfo : var->getQueryList())
+            {
+                fields.push_back({queryInfo.name, queryInfo.groupByField, queryInfo.type});
+            }
+        }
+
+        for (auto _ : state)
+        {
+            auto dataObjects =
+                samples.mhsResults.getMany(fields, static_cast<size_t>(state.range(0)));
+            benchmark::DoNotOptimize(dataObjects);
+        }
+
+        state.SetItemsProcessed(static_cast<std::int64_t>(
+            state.iterations() * fields.size()));
+    }
+
+    BENCHMARK(BM_GetMany)->Arg(1)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+    // Exports ----------------------------------------------------------------------------------
+
+    /// \brief The satellite id CategorySplit of the MHS test.
+    void BM_CategorySplit(benchmark::State& state)
+    {
+        const auto& samples = Samples::get();
+        const auto splits = samples.mhs.description.getExport().getSplits();
+
+        size_t numCategories = 0;
+        for (auto _ : state)
+        {
+            const auto splitData = splits.front()->split(samples.mhsFields);
+            numCategories = splitData.size();
+            benchmark::DoNotOptimize(numCategories);
+        }
+
+        state.counters["categories"] = static_cast<double>(numCategories);
+    }
+
+    BENCHMARK(BM_CategorySplit)->Unit(benchmark::kMicrosecond);
+
+    /// \brief The latitude and longitude BoundingFilters of the filtering test.
+    void BM_BoundingFilter(benchmark::State& state)
+    {
+        const auto& samples = Samples::get();
+        const auto filters = samples.filtering.description.getExport().getFilters();
+
+        for (auto _ : state)
+        {
+            auto dataMap = samples.filteringFields;
+            Ingester::Filter::apply(filters, dataMap);
+            benchmark::DoNotOptimize(dataMap);
+        }
+    }
+
+    BENCHMARK(BM_BoundingFilter)->Unit(benchmark::kMicrosecond);
+
+    /// \brief The timestamp DatetimeVariable of the MHS test.
+    void BM_DatetimeVariable(benchmark::State& state)
+    {
+        const auto& samples = Samples::get();
+        std::shared_ptr<Ingester::Variable> timestamp;
+        for (const auto& var : samples.mhs.description.getExport().getVariables())
+        {
+            if (var->getExportName() == "timestamp") timestamp = var;
+        }
+
+        size_t numValues = 0;
+        for (auto _ : state)
+        {
+            const auto dataObject = timestamp->exportData(samples.mhsFields);
+            numValues = dataObject->size();
+            benchmark::DoNotOptimize(numValues);
+        }
+
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * numValues));
+    }
+
+    BENCHMARK(BM_DatetimeVariable)->Unit(benchmark::kMicrosecond);
+
+    // Encoding ---------------------------------------------------------------------------------
+
+    /// \brief Write the filtering test output with the codec settings of every variable
+    ///        overridden, to compare the write throughput with the size of the file.
+    void runEncode(benchmark::State& state, const eckit::LocalConfiguration& codecConf)
+    {
+        const auto& samples = Samples::get();
+        const std::string outputPath = "./testrun/bufr_benchmarks_encode.nc";
+
+        auto iodaConf = samples.filtering.iodaConf;
+        iodaConf.set("obsdataout", outputPath);
+
+        auto varConfs = iodaConf.getSubConfigurations("variables");
+        for (auto& varConf : varConfs)
+        {
+            for (const auto& key : codecConf.keys())
+            {
+                if (codecConf.isString(key))
+                {
+                    varConf.set(key, codecConf.getString(key));
+                }
+                else
+                {
+                    varConf.set(key, codecConf.getInt(key));
+                }
+            }
+        }
+
+        iodaConf.set("variables", varConfs);
+
+        for (auto _ : state)
+        {
+            // The ObsGroups are closed (and the file flushed) at the end of the iteration.
+            auto obsGroups = Ingester::IodaEncoder(iodaConf).encode(samples.filteringData);
+            benchmark::DoNotOptimize(obsGroups);
+        }
+
+        state.counters["file_bytes"] = static_cast<double>(fileSize(outputPath));
+    }
+
+    void BM_EncodeNoCompression(benchmark::State& state)
+    {
+        eckit::LocalConfiguration codecConf;
+        codecConf.set("compression", "none");
+        runEncode(state, codecConf);
+    }
+
+    void BM_EncodeGzip(benchmark::State& state)
+    {
+        eckit::LocalConfiguration codecConf;
+        codecConf.set("compression", "gzip");
+        codecConf.set("compressionLevel", static_cast<int>(state.range(0)));
+        runEncode(state, codecConf);
+    }
+
+    void BM_EncodeQuantizedGzip(benchmark::State& state)
+    {
+        eckit::LocalConfiguration codecConf;
+        codecConf.set("compression", "gzip");
+        codecConf.set("compressionLevel", 4);
+        codecConf.set("significantBits", static_cast<int>(state.range(0)));
+        runEncode(state, codecConf);
+    }
+
+    BENCHMARK(BM_EncodeNoCompression)->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_EncodeGzip)->ArgName("level")->Arg(1)->Arg(4)->Arg(6)->Arg(9)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK(BM_EncodeQuantizedGzip)->ArgName("bits")->Arg(8)->Arg(12)->Arg(16)
+        ->Unit(benchmark::kMillisecond);
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,153 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#define ECKIT_TESTING_SELF_REGISTER_CASES 0
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "eckit/testing/Test.h"
+#include "ioda/Engines/EngineUtils.h"
+#include "ioda/ObsGroup.h"
+#include "oops/runs/Test.h"
+#include "oops/util/Expect.h"
+
+#include "DataObject.h"
+
+
+namespace Ingester
+{
+    namespace test
+    {
+        /// \brief Write values with significantBits to an in memory file and read them back.
+        template<typename T>
+        void test_quantized(int significantBits)
+        {
+            typedef typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type Bits;
+
+            const T missing = Ingester::DataObject<T>::missingValue();
+            const T largest = std::numeric_limits<T>::max();
+            const std::vector<T> values = {static_cast<T>(1.2345678),
+                                           static_cast<T>(-98.7654321),
+                                           static_cast<T>(3.0e10),
+                                           static_cast<T>(1.0e-20),
+                                           static_cast<T>(0),
+                                           missing,
+                                           std::numeric_limits<T>::infinity(),
+                                           -std::numeric_limits<T>::infinity(),
+                                           std::numeric_limits<T>::quiet_NaN(),
+                                           largest};
+
+            const auto numLocs = static_cast<ioda::Dimensions_t>(values.size());
+            const Ingester::DataObject<T> data(values,
+                                               "value",
+                                               "",
+                                               {static_cast<int>(values.size())},
+                                               "*/VALUE",
+                                               {});
+
+            auto backendParams = ioda::Engines::BackendCreationParameters();
+            backendParams.fileName = "quantized_" + std::to_string(significantBits);
+            backendParams.openMode = ioda::Engines::BackendOpenModes::Read_Write;
+            backendParams.createMode = ioda::Engines::BackendCreateModes::Truncate_If_Exists;
+            backendParams.action = ioda::Engines::BackendFileActions::Create;
+            backendParams.flush = false;
+            backendParams.allocBytes = 1024 * 1024;
+
+            auto rootGroup = ioda::Engines::constructBackend(
+                ioda::Engines::BackendNames::Hdf5Mem, backendParams);
+            auto policy = ioda::detail::DataLayoutPolicy::Policies::ObsGroup;
+            auto obsGroup = ioda::ObsGroup::generate(
+                rootGroup,
+                {ioda::NewDimensionScale<int>("Location", numLocs, numLocs, numLocs)},
+                ioda::detail::DataLayoutPolicy::generate(policy));
+
+            Compression compression;
+            compression.significantBits = significantBits;
+            auto var = data.createVariable(obsGroup,
+                                           "ObsValue/value",
+                                           {obsGroup.vars["Location"]},
+                                           {numLocs},
+                                           compression);
+
+            std::vector<T> written;
+            var.read<T>(written);
+            EXPECT(written.size() == values.size());
+
+            const int mantissaBits = std::numeric_limits<T>::digits - 1;
+            const int dropBits = std::max(mantissaBits - significantBits, 0);
+            const double precision = std::ldexp(1.0, -(std::min(significantBits,
+                                                                mantissaBits) + 1));
+            for (size_t valIdx = 0; valIdx < values.size(); valIdx++)
+            {
+                const T value = values[valIdx];
+                const T writtenValue = written[valIdx];
+
+                // Missing values, infinities and NaNs are kept as they are.
+                if (std::isnan(value))
+                {
+                    EXPECT(std::isnan(writtenValue));
+                    continue;
+                }
+
+                if (value == missing || std::isinf(value))
+                {
+                    EXPECT(writtenValue == value);
+                    continue;
+                }
+
+                // Rounded to the kept bits (half a unit of the last kept bit at most) ...
+                EXPECT(std::abs(static_cast<double>(writtenValue) - value) <=
+                       std::abs(static_cast<double>(value)) * precision);
+
+                // ... so the dropped bits are zeros (except where rounding up would overflow).
+                if (value == largest || dropBits == 0) continue;
+
+                Bits bits;
+                std::memcpy(&bits, &writtenValue, sizeof(T));
+                EXPECT((bits & ((static_cast<Bits>(1) << dropBits) - 1)) == 0);
+            }
+        }
+
+        class DataObject : public oops::Test
+        {
+         public:
+            DataObject() = default;
+            virtual ~DataObject() = default;
+         private:
+            std::string testid() const override { return "ingester::test::DataObject"; }
+            void register_tests() const override
+            {
+                std::vector<eckit::testing::Test>& ts = eckit::testing::specification();
+
+                ts.emplace_back(CASE("ingester/DataObject/testQuantizedFloat")
+                {
+                    test_quantized<float>(10);
+                    test_quantized<float>(23);
+                });
+
+                ts.emplace_back(CASE("ingester/DataObject/testQuantizedDouble")
+                {
+                    test_quantized<double>(20);
+                    test_quantized<double>(52);
+                });
+            }
+
+            void clear() const override
+            {
+            }
+        };
+    }  // namespace test
+}  // namespace Ingester
@@ -0,0 +1,66 @@
+# (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+#
+# This software is licensed under the terms of the Apache Licence Version 2.0
+# which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+
+import netCDF4
+import numpy as np
+
+OUTPUT_PATH = './testrun/gdas.t18z.1bmhs.tm00.chunks_{}.nc'
+VARIABLES = ['MetaData/dateTime',
+             'MetaData/latitude',
+             'MetaData/longitude',
+             'MetaData/fieldOfViewNumber',
+             'ObsValue/brightnessTemperature']
+
+
+def target_chunks(shape, element_size, target_bytes):
+    # The chunks bufr2ioda.x picks without a chunks option (see targetChunkBytes)
+    chunks = [max(dim, 1) for dim in shape]
+    while element_size * int(np.prod(chunks[1:])) > target_bytes:
+        largest = int(np.argmax(chunks[1:])) + 1
+        if chunks[largest] == 1:
+            break
+        chunks[largest] = (chunks[largest] + 1) // 2
+
+    rows = max(1, target_bytes // (element_size * int(np.prod(chunks[1:]))))
+    chunks[0] = min(chunks[0], rows)
+    return chunks
+
+
+def variable(dataset, name):
+    group, var = name.split('/')
+    return dataset.groups[group].variables[var]
+
+
+def test_chunks():
+    datasets = {kind: netCDF4.Dataset(OUTPUT_PATH.format(kind))
+                for kind in ['default', 'small', 'none']}
+
+    for name in VARIABLES:
+        default = variable(datasets['default'], name)
+        shape = list(default.shape)
+        size = default.dtype.itemsize
+
+        # 1 MiB chunks by default, 4 KiB ones when asked for
+        assert default.chunking() == target_chunks(shape, size, 1024 * 1024)
+        small = variable(datasets['small'], name)
+        assert small.chunking() == target_chunks(shape, size, 4096)
+
+        # Without a target size the chunks are the ones of the dimensions (all the locations)
+        none = variable(datasets['none'], name)
+        assert none.chunking()[0] == shape[0]
+
+        # The chunks don't change the values
+        for var in [small, none]:
+            assert np.ma.allequal(var[:], default[:])
+
+    # The small chunks really split the locations
+    assert variable(datasets['small'], 'MetaData/dateTime').chunking()[0] == 512
+
+    for dataset in datasets.values():
+        dataset.close()
+
+
+if __name__ == '__main__':
+    test_chunks()
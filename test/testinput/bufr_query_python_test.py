@@ -3,6 +3,14 @@
 # This software is licensed under the terms of the Apache Licence Version 2.0
 # which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
 
+import bz2
+from concurrent.futures import ThreadPoolExecutor
+import datetime
+import gzip
+import multiprocessing
+import os
+import tempfile
+
 from pyiodaconv import bufr
 import numpy as np
 
@@ -115,6 +123,851 @@ def test_invalid_query():
     assert False, "Didn't throw exception for invalid query."
 
 
+def test_threaded_execute():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    # Run the same queries serially and with worker threads
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    with bufr.File(DATA_PATH) as f:
+        r_threaded = f.execute(q, threads=4)
+
+    # The merged result must match the serial one exactly
+    assert np.array_equal(r.get('latitude'), r_threaded.get('latitude'))
+    assert np.ma.allequal(r.get('radiance'), r_threaded.get('radiance'))
+
+    # The file position must match too when only some of the messages are run
+    with bufr.File(DATA_PATH) as f:
+        r_first = f.execute(q, next=5, threads=3)
+        r_next = f.execute(q, next=5)
+
+    with bufr.File(DATA_PATH) as f:
+        r_first_serial = f.execute(q, next=5)
+        r_next_serial = f.execute(q, next=5)
+
+    assert np.array_equal(r_first.get('latitude'), r_first_serial.get('latitude'))
+    assert np.array_equal(r_next.get('latitude'), r_next_serial.get('latitude'))
+
+def test_message_index():
+    DATA_PATH = './testinput/gdas.t12z.adpupa.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('borg', '*/BID/BORG')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        index_path = os.path.join(tmp_dir, 'adpupa.idx')
+
+        # The first File builds the sidecar, the second one reads it back
+        with bufr.File(DATA_PATH, indexPath=index_path) as f:
+            r_built = f.execute(q)
+
+        assert os.path.exists(index_path)
+
+        with bufr.File(DATA_PATH, indexPath=index_path) as f:
+            r_read = f.execute(q)
+
+    assert np.array_equal(r.get('latitude'), r_built.get('latitude'))
+    assert np.array_equal(r.get('latitude'), r_read.get('latitude'))
+    assert np.array_equal(r.get('borg'), r_read.get('borg'))
+
+def test_plan_cache():
+    DATA_PATH = './testinput/gdas.t12z.adpupa.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('pressure', '*/UARLV/PRLC')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        q.set_plan_cache_dir(tmp_dir)
+
+        # The first run compiles and stores the plans, the second one reads them back
+        with bufr.File(DATA_PATH) as f:
+            r_compiled = f.execute(q)
+
+        assert len(os.listdir(tmp_dir)) > 0
+
+        with bufr.File(DATA_PATH) as f:
+            r_cached = f.execute(q)
+
+    assert np.array_equal(r.get('latitude'), r_compiled.get('latitude'))
+    assert np.array_equal(r.get('latitude'), r_cached.get('latitude'))
+    assert np.array_equal(r.get('pressure'), r_cached.get('pressure'))
+    assert r.get('pressure').shape == r_cached.get('pressure').shape
+
+
+def test_wmo_table_cache():
+    DATA_PATH = './testinput/amdar_wmo_multi.bufr'
+    TABLE_PATH = './testinput/bufr_tables'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLATH')
+    q.add('pressureAltitude', '[*/FLVLST, */AMDARNOL/FLVLST]')
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        cache_path = os.path.join(tmp_dir, 'amdar.tables')
+
+        # The first File goes through the file to store the tables, the second one reads them
+        with bufr.File(DATA_PATH, TABLE_PATH, tableCachePath=cache_path) as f:
+            r_built = f.execute(q)
+
+        assert os.path.exists(cache_path)
+
+        with bufr.File(DATA_PATH, TABLE_PATH, tableCachePath=cache_path) as f:
+            r_read = f.execute(q)
+
+    assert np.array_equal(r_built.get('latitude'), r_read.get('latitude'))
+    assert np.array_equal(r_built.get('pressureAltitude'), r_read.get('pressureAltitude'))
+
+
+def test_memory_file():
+    DATA_PATH = './testinput/gdas.t12z.adpupa.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('pressure', '*/UARLV/PRLC')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    with open(DATA_PATH, 'rb') as data_file:
+        data = data_file.read()
+
+    # Decode the same messages straight from memory
+    with bufr.File(memoryview(data)) as f:
+        r_memory = f.execute(q)
+
+    assert np.array_equal(r.get('latitude'), r_memory.get('latitude'))
+    assert np.array_equal(r.get('pressure'), r_memory.get('pressure'))
+
+
+def test_compressed_file():
+    DATA_PATH = './testinput/gdas.t12z.adpupa.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('pressure', '*/UARLV/PRLC')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    with open(DATA_PATH, 'rb') as data_file:
+        data = data_file.read()
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        for ext, compress in [('gz', gzip.compress), ('bz2', bz2.compress)]:
+            compressed_path = os.path.join(tmp_dir, f'adpupa.bufr_d.{ext}')
+            with open(compressed_path, 'wb') as compressed_file:
+                compressed_file.write(compress(data))
+
+            with bufr.File(compressed_path) as f:
+                r_compressed = f.execute(q)
+
+            assert np.array_equal(r.get('latitude'), r_compressed.get('latitude'))
+            assert np.array_equal(r.get('pressure'), r_compressed.get('pressure'))
+
+
+def test_file_set():
+    DATA_PATH = './testinput/gdas.t12z.adpupa.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('pressure', '*/UARLV/PRLC')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    # Two files and a pattern matching one of them, merged in order
+    files = bufr.FileSet([DATA_PATH, DATA_PATH, './testinput/gdas.t12z.adpupa.tm00.bufr_*'])
+    assert len(files.filenames) == 3
+
+    r_merged = files.execute(q, threads=2)
+
+    assert np.array_equal(r_merged.get('latitude'), np.concatenate([r.get('latitude')] * 3))
+    assert np.array_equal(r_merged.get('pressure'), np.concatenate([r.get('pressure')] * 3))
+
+
+def test_concurrent_files():
+    DATA_PATHS = ['./testinput/gdas.t12z.adpupa.tm00.bufr_d',
+                  './testinput/gdas.t12z.1bmhs.tm00.bufr_d'] * 2
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+
+    def read_latitudes(path):
+        with bufr.File(path) as f:
+            r = f.execute(q)
+        return r.get('latitude')
+
+    serial = [read_latitudes(path) for path in DATA_PATHS]
+
+    # Each thread has its own File (and Fortran unit), the GIL is released while they decode
+    with ThreadPoolExecutor(max_workers=len(DATA_PATHS)) as executor:
+        concurrent = list(executor.map(read_latitudes, DATA_PATHS))
+
+    for serial_lats, concurrent_lats in zip(serial, concurrent):
+        assert np.array_equal(serial_lats, concurrent_lats)
+
+
+def test_execute_chunks():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    # Walk through the file a few messages at a time
+    with bufr.File(DATA_PATH) as f:
+        lats = [chunk.get('latitude') for chunk in f.execute_chunks(q, 3)]
+
+    assert len(lats) > 1
+    assert np.array_equal(r.get('latitude'), np.concatenate(lats))
+
+    with bufr.File(DATA_PATH) as f:
+        chunks = [chunk.get_many(['latitude', 'radiance'], as_dict=True)
+                  for chunk in f.iter_execute(q, messages_per_chunk=3)]
+
+    assert np.array_equal(np.concatenate([c['latitude'] for c in chunks]), r.get('latitude'))
+    assert np.array_equal(np.concatenate([c['radiance'] for c in chunks]), r.get('radiance'))
+
+
+def test_get_many():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('day', '*/DAYS')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    lat, day, rad_grouped = r.get_many(['latitude',
+                                        ('day', '', 'float'),
+                                        ('radiance', 'radiance')])
+
+    assert np.array_equal(lat, r.get('latitude'))
+    assert day.dtype == 'float32'
+    assert np.array_equal(day, r.get('day', type='float'))
+    assert np.array_equal(rad_grouped, r.get('radiance', 'radiance'))
+
+    # The same arrays by field name
+    arrays = r.get_many(['latitude', ('day', '', 'float'), ('radiance', 'radiance')],
+                        as_dict=True)
+    assert list(arrays.keys()) == ['latitude', 'day', 'radiance']
+    assert np.array_equal(arrays['day'], day)
+    assert np.array_equal(arrays['radiance'], rad_grouped)
+
+    # Building the fields with several threads gives the same arrays
+    threaded = r.get_many(['latitude', ('day', '', 'float'), ('radiance', 'radiance')],
+                          threads=3)
+    assert np.array_equal(threaded[0], lat)
+    assert np.array_equal(threaded[1], day)
+    assert np.array_equal(threaded[2], rad_grouped)
+
+
+def _shared_sum(handle):
+    arrays = bufr.open_shared(handle)
+    return float(arrays['radiance'].sum())
+
+
+def test_get_shared():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    with r.get_shared(['latitude', 'radiance']) as shared:
+        # The arrays opened from the handle are the ones of the ResultSet
+        arrays = bufr.open_shared(shared.handle)
+        assert np.array_equal(arrays['latitude'], r.get('latitude'))
+        assert np.array_equal(arrays['radiance'].mask, r.get('radiance').mask)
+        assert arrays['radiance'].fill_value == r.get('radiance').fill_value
+
+        # Other processes see the same data
+        with multiprocessing.get_context('spawn').Pool(2) as pool:
+            sums = pool.map(_shared_sum, [shared.handle] * 2)
+        assert sums == [float(r.get('radiance').sum())] * 2
+
+    # The arrays stay valid after the segment is unlinked
+    assert np.array_equal(arrays['latitude'], r.get('latitude'))
+
+
+def test_array_outlives_result_set():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLON')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    # The array shares its buffer with the data built by the ResultSet
+    lat = r.get('latitude')
+    del r
+
+    assert np.allclose(lat[0:3], np.array([166.7977, 166.4078, 165.992]))
+    assert lat.mask.shape == lat.shape
+
+
+def test_release_field():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    # Asking for a field again (memoized) or after it was released gives the same data
+    rad = r.get('radiance', 'radiance')
+    assert np.array_equal(r.get('radiance', 'radiance'), rad)
+    assert r.get('radiance', 'radiance', 'double').dtype == 'float64'
+
+    r.release('radiance')
+    assert np.array_equal(r.get('radiance', 'radiance'), rad)
+    assert np.array_equal(r.get('radiance'), r.get_many(['radiance'])[0])
+
+
+def test_shared_queries():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('radiance', '*/BRIT/TMBR')
+    q.add('latitude', '*/CLAT')
+    q.add('radiance_copy', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    # Fields with the same query string share their data but are still separate fields
+    rad = r.get('radiance', 'radiance')
+    assert np.array_equal(r.get('radiance_copy', 'radiance'), rad)
+    assert np.array_equal(r.get('radiance_copy', 'radiance_copy'), rad)
+    assert np.array_equal(r.get('radiance_copy'), r.get('radiance'))
+
+    rad_copy, lat = r.get_many(['radiance_copy', 'latitude'])
+    assert np.array_equal(rad_copy, r.get('radiance'))
+    assert np.array_equal(lat, r.get('latitude'))
+
+    r.release('radiance_copy')
+    assert np.array_equal(r.get('radiance', 'radiance'), rad)
+
+
+def test_get_arrow():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    columns = r.get_arrow(['latitude', 'radiance'])
+    schema, array = columns.__arrow_c_array__()
+    assert type(schema).__name__ == 'PyCapsule'
+    assert type(array).__name__ == 'PyCapsule'
+
+    try:
+        import pyarrow as pa
+    except ImportError:
+        return
+
+    batch = pa.record_batch(columns)
+    lat = r.get('latitude')
+    rad = r.get('radiance')
+
+    assert batch.num_rows == lat.shape[0]
+    assert np.array_equal(batch.column('latitude').to_numpy(zero_copy_only=False), lat)
+    assert batch.column('radiance').type.list_size == rad.shape[1]
+    assert batch.column('radiance').flatten().null_count == np.count_nonzero(rad.mask)
+
+
+def test_time_window():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    # Make the QuerySet for all the data we want
+    q = bufr.QuerySet()
+    q.add('year', '*/YEAR')
+    q.add('month', '*/MNTH')
+    q.add('day', '*/DAYS')
+    q.add('hour', '*/HOUR')
+    q.add('minute', '*/MINU')
+    q.add('second', '*/SECO')
+    q.add('latitude', '*/CLAT')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    times = r.get_datetime('year', 'month', 'day', 'hour', 'minute', 'second')
+    times = times.astype('datetime64[s]').astype(np.int64)
+
+    # Use a window covering the first half of the obs. The wide margin makes every
+    # message get checked subset by subset.
+    start = int(times.min())
+    end = int((times.min() + times.max()) // 2)
+    q.set_time_window(start, end, margin=86400)
+
+    with bufr.File(DATA_PATH) as f:
+        r_window = f.execute(q)
+
+    window_times = r_window.get_datetime('year', 'month', 'day', 'hour', 'minute', 'second')
+    window_times = window_times.astype('datetime64[s]').astype(np.int64)
+
+    assert np.all((window_times >= start) & (window_times <= end))
+    assert len(window_times) == np.count_nonzero((times >= start) & (times <= end))
+
+
+def test_shared_executor():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    # Asking for more threads than the executor has uses the executor's
+    bufr.set_threads(2, pin=True)
+    assert bufr.get_threads() == 2
+
+    with bufr.File(DATA_PATH) as f:
+        r_threaded = f.execute(q, threads=4)
+
+    assert np.array_equal(r.get('latitude'), r_threaded.get('latitude'))
+    assert np.ma.allequal(r.get_many(['radiance'], threads=4)[0], r.get('radiance'))
+
+    bufr.set_threads()
+    assert bufr.get_threads() >= 1
+
+
+def test_buffer_pool():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('radiance', '*/BRIT/TMBR')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+    lat = r.get('latitude')
+    rad = r.get('radiance')
+
+    # The second run gets the buffers the first one let go, the results are the same
+    bufr.set_buffer_pool(256 * 1024 * 1024)
+    for _ in range(2):
+        with bufr.File(DATA_PATH) as f:
+            r_pooled = f.execute(q)
+
+        assert np.array_equal(r_pooled.get('latitude'), lat)
+        assert np.ma.allequal(r_pooled.get('radiance'), rad)
+        del r_pooled
+
+    bufr.set_buffer_pool(0)
+
+
+def test_message_sampling():
+    DATA_PATH = './testinput/gdas.t00z.1bhrs4.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+
+    with bufr.File(DATA_PATH) as f:
+        lat = f.execute(q).get('latitude')
+
+    # Every other message, the same with worker threads
+    q.set_sampling(every=2)
+    with bufr.File(DATA_PATH) as f:
+        lat_every = f.execute(q).get('latitude')
+
+    with bufr.File(DATA_PATH) as f:
+        assert np.array_equal(f.execute(q, threads=2).get('latitude'), lat_every)
+
+    assert 0 < len(lat_every) < len(lat)
+    assert np.all(np.isin(lat_every, lat))
+
+    # A random fraction is picked the same way for the same seed
+    q.set_sampling(fraction=0.25, seed=7)
+    with bufr.File(DATA_PATH) as f:
+        lat_fraction = f.execute(q).get('latitude')
+
+    with bufr.File(DATA_PATH) as f:
+        assert np.array_equal(f.execute(q).get('latitude'), lat_fraction)
+
+    assert len(lat_fraction) < len(lat)
+
+    try:
+        q.set_sampling(fraction=0)
+        assert False, "Expected the sampling to be rejected"
+    except ValueError:
+        pass
+
+
+def test_read_ahead():
+    DATA_PATH = './testinput/gdas.t12z.adpupa.tm00.bufr_d'
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('pressure', '*/UARLV/PRLC')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    # The same messages read through the read ahead buffers
+    with bufr.File(DATA_PATH) as f:
+        f.set_read_ahead(True)
+        r_ahead = f.execute(q)
+
+    assert np.array_equal(r.get('latitude'), r_ahead.get('latitude'))
+    assert np.array_equal(r.get('pressure'), r_ahead.get('pressure'))
+
+
+def test_parse():
+    DATA_PATH = './testinput/gdas.t12z.adpupa.tm00.bufr_d'
+
+    # Only built along with the BUFR converter
+    if not hasattr(bufr, 'parse'):
+        return
+
+    config = {'obsdatain': DATA_PATH,
+              'exports': {'variables': {'latitude': {'query': '*/CLAT'},
+                                        'pressure': {'query': '*/UARLV/PRLC'}}}}
+
+    data = bufr.parse({'observations': [{'obs space': config}]}, threads=2)
+    assert list(data.keys()) == [()]
+
+    q = bufr.QuerySet()
+    q.add('latitude', '*/CLAT')
+    q.add('pressure', '*/UARLV/PRLC')
+
+    with bufr.File(DATA_PATH) as f:
+        r = f.execute(q)
+
+    assert np.array_equal(data[()]['latitude'], r.get('latitude'))
+    assert np.array_equal(data[()]['pressure'], r.get('pressure'))
+
+
+def _duplicate_rows(keys, keep='first', priority=None):
+    # The rows the duplicates filter keeps, the keys are rounded like llround and the
+    # missing values are all the same key (and the worst priority)
+    codes = [np.ma.filled(np.sign(k) * np.floor(np.abs(k) + 0.5), np.inf) for k in keys]
+    if priority is not None:
+        priority = np.ma.filled(priority, np.nan)
+
+    kept = {}
+    for row, key in enumerate(zip(*codes)):
+        if key not in kept:
+            kept[key] = row
+        elif keep == 'last':
+            kept[key] = row
+        elif priority is not None and not np.isnan(priority[row]):
+            best = priority[kept[key]]
+            if np.isnan(best) or priority[row] < best:
+                kept[key] = row
+
+    return np.sort(np.array(list(kept.values()), dtype=np.int64))
+
+
+def test_duplicates_filter():
+    DATA_PATH = './testinput/gdas.t18z.1bmhs.tm00.bufr_d'
+
+    # Only built along with the BUFR converter
+    if not hasattr(bufr, 'parse'):
+        return
+
+    variables = {'latitude': {'query': '*/CLAT'},
+                 'longitude': {'query': '*/CLON'},
+                 'fovn': {'query': '*/FOVN'}}
+
+    def parse(duplicates=None):
+        exports = {'variables': variables}
+        if duplicates is not None:
+            exports['filters'] = [{'duplicates': duplicates}]
+
+        config = {'obsdatain': DATA_PATH, 'exports': exports}
+        return bufr.parse({'observations': [{'obs space': config}]})[()]
+
+    data = parse()
+    keys = [data['latitude'].astype(np.float64), data['longitude'].astype(np.float64)]
+    fovn = data['fovn'].astype(np.float64)
+
+    # One degree cells hold many locations, so which one is kept matters
+    for keep in ['first', 'last']:
+        rows = _duplicate_rows(keys, keep=keep)
+        assert len(rows) < len(fovn)
+
+        kept = parse({'variables': ['latitude', 'longitude'],
+                      'resolutions': [1.0, 1.0],
+                      'keep': keep})
+
+        assert np.array_equal(kept['latitude'], data['latitude'][rows])
+        assert np.array_equal(kept['fovn'], data['fovn'][rows])
+
+    # The lowest fov in the cell, ties keep the earlier row
+    rows = _duplicate_rows(keys, priority=fovn)
+    kept = parse({'variables': ['latitude', 'longitude'],
+                  'resolutions': [1.0, 1.0],
+                  'priority': 'fovn',
+                  'prefer': 'lowest'})
+
+    assert np.array_equal(kept['latitude'], data['latitude'][rows])
+    assert np.array_equal(kept['fovn'], data['fovn'][rows])
+
+
+def _thinning_cell(lat, lon, resolution):
+    # The cell of the thinning filter's equal area grid
+    band_height = min(180.0, resolution / (6371.0 * np.pi / 180.0))
+    num_bands = int(np.ceil(180.0 / band_height))
+
+    band = min(int((lat + 90.0) / band_height), num_bands - 1)
+    center = min(90.0, -90.0 + (band + 0.5) * band_height)
+    num_cells = int(max(1.0, np.floor(360.0 * np.cos(center * np.pi / 180.0) / band_height + 0.5)))
+
+    lon = np.fmod(lon + 180.0, 360.0)
+    if lon < 0:
+        lon += 360.0
+
+    return band, min(int(lon / 360.0 * num_cells), num_cells - 1)
+
+
+def test_thinning_filter():
+    DATA_PATH = './testinput/gdas.t18z.1bmhs.tm00.bufr_d'
+
+    # Only built along with the BUFR converter
+    if not hasattr(bufr, 'parse'):
+        return
+
+    thinned = bufr.parse('./testinput/bufr_thinning.yaml')[()]
+
+    config = {'obsdatain': DATA_PATH,
+              'exports': {'variables': {'latitude': {'query': '*/CLAT'},
+                                        'longitude': {'query': '*/CLON'},
+                                        'vza': {'query': '*/SAZA'}}}}
+
+    data = bufr.parse({'observations': [{'obs space': config}]})[()]
+    lats = np.ma.filled(data['latitude'].astype(np.float64), np.nan)
+    lons = np.ma.filled(data['longitude'].astype(np.float64), np.nan)
+    vzas = np.ma.filled(data['vza'].astype(np.float64), np.nan)
+
+    # The lowest zenith angle of each cell (the first one of equal ones), locations without
+    # coordinates are all kept
+    best = {}
+    rows = []
+    for row in range(len(lats)):
+        if not (abs(lats[row]) <= 90) or not np.isfinite(lons[row]):
+            rows.append(row)
+            continue
+
+        cell = _thinning_cell(lats[row], lons[row], 100.0)
+        if cell not in best:
+            best[cell] = row
+        elif not np.isnan(vzas[row]) and (np.isnan(vzas[best[cell]]) or
+                                          vzas[row] < vzas[best[cell]]):
+            best[cell] = row
+
+    rows = np.sort(np.array(rows + list(best.values()), dtype=np.int64))
+    assert 0 < len(rows) < len(lats)
+
+    assert np.array_equal(thinned['latitude'], data['latitude'][rows])
+    assert np.array_equal(thinned['longitude'], data['longitude'][rows])
+    assert np.ma.allequal(thinned['vza'], data['vza'][rows])
+
+
+def test_sort():
+    DATA_PATH = './testinput/gdas.t18z.1bmhs.tm00.bufr_d'
+
+    # Only built along with the BUFR converter
+    if not hasattr(bufr, 'parse'):
+        return
+
+    variables = {'latitude': {'query': '*/CLAT'},
+                 'longitude': {'query': '*/CLON'},
+                 'fovn': {'query': '*/FOVN'}}
+
+    def parse(sort=None, threads=1):
+        exports = {'variables': variables}
+        if sort is not None:
+            exports['sort'] = sort
+
+        config = {'obsdatain': DATA_PATH, 'exports': exports}
+        return bufr.parse({'observations': [{'obs space': config}]}, threads=threads)[()]
+
+    data = parse()
+
+    # By fov, then by latitude (missing values last, equal rows in the order of the file)
+    rows = np.argsort(np.ma.filled(data['latitude'].astype(np.float64), np.inf), kind='stable')
+    fovn = np.ma.filled(data['fovn'].astype(np.float64), np.inf)
+    rows = rows[np.argsort(fovn[rows], kind='stable')]
+
+    for threads in [1, 4]:
+        sorted_data = parse({'variables': ['fovn', 'latitude']}, threads=threads)
+        assert np.array_equal(sorted_data['fovn'], data['fovn'][rows])
+        assert np.array_equal(sorted_data['latitude'], data['latitude'][rows])
+        assert np.array_equal(sorted_data['longitude'], data['longitude'][rows])
+
+    # Along the curve the rows are the same ones, in the same order with any number of threads
+    curve = {'curve': 'hilbert', 'latitude': 'latitude', 'longitude': 'longitude'}
+    sorted_data = parse(curve)
+    assert not np.array_equal(sorted_data['latitude'], data['latitude'])
+    assert np.array_equal(np.sort(sorted_data['latitude']), np.sort(data['latitude']))
+    assert np.array_equal(np.sort(sorted_data['longitude']), np.sort(data['longitude']))
+
+    threaded_data = parse(curve, threads=4)
+    assert np.array_equal(threaded_data['latitude'], sorted_data['latitude'])
+    assert np.array_equal(threaded_data['longitude'], sorted_data['longitude'])
+
+
+def test_time_split():
+    DATA_PATH = './testinput/gdas.t18z.1bmhs.tm00.bufr_d'
+
+    # Only built along with the BUFR converter
+    if not hasattr(bufr, 'parse'):
+        return
+
+    variables = {'timestamp': {'datetime': {'year': '*/YEAR',
+                                            'month': '*/MNTH',
+                                            'day': '*/DAYS',
+                                            'hour': '*/HOUR',
+                                            'minute': '*/MINU',
+                                            'second': '*/SECO'}},
+                 'latitude': {'query': '*/CLAT'}}
+
+    config = {'obsdatain': DATA_PATH, 'exports': {'variables': variables}}
+    data = bufr.parse({'observations': [{'obs space': config}]})[()]
+
+    times = np.ma.filled(data['timestamp'].astype(np.int64), np.iinfo(np.int64).min)
+    valid = ~np.ma.getmaskarray(data['timestamp'])
+
+    def iso(time):
+        time = datetime.datetime.fromtimestamp(int(time), datetime.timezone.utc)
+        return time.strftime('%Y-%m-%dT%H:%M:%SZ')
+
+    # Windows ending and beginning at a time of the data, one overlapping both and one with
+    # all the times
+    t0 = int(np.sort(times[valid])[np.count_nonzero(valid) // 2])
+    windows = {'before': (t0 - 1800, 'PT30M', t0 - 3600, t0),
+               'after': (t0 + 1800, 'PT30M', t0, t0 + 3600),
+               'around': (t0, 'PT1H', t0 - 3600, t0 + 3600),
+               'all': (t0, 'P3650D', t0 - 3650 * 86400, t0 + 3650 * 86400)}
+
+    split = {'time': {'variable': 'timestamp',
+                      'windows': [{'center': iso(center), 'name': name, 'halfWidth': width}
+                                  for name, (center, width, _, _) in windows.items()]}}
+
+    config['exports']['splits'] = {'window': split}
+    split_data = bufr.parse({'observations': [{'obs space': config}]})
+    assert sorted(split_data.keys()) == sorted((name,) for name in windows)
+
+    # The windows hold the times in (begin, end], the rows with missing times are in none
+    for name, (_, _, begin, end) in windows.items():
+        rows = np.nonzero(valid & (times > begin) & (times <= end))[0]
+        assert np.array_equal(split_data[(name,)]['timestamp'], data['timestamp'][rows])
+        assert np.array_equal(split_data[(name,)]['latitude'], data['latitude'][rows])
+
+    assert t0 in split_data[('before',)]['timestamp']
+    assert t0 not in split_data[('after',)]['timestamp']
+    assert len(split_data[('around',)]['timestamp']) == \
+        len(split_data[('before',)]['timestamp']) + len(split_data[('after',)]['timestamp'])
+    assert len(split_data[('all',)]['timestamp']) == np.count_nonzero(valid)
+
+
+def test_geobox_split():
+    DATA_PATH = './testinput/gdas.t18z.1bmhs.tm00.bufr_d'
+
+    # Only built along with the BUFR converter
+    if not hasattr(bufr, 'parse'):
+        return
+
+    variables = {'latitude': {'query': '*/CLAT'},
+                 'longitude': {'query': '*/CLON'}}
+
+    config = {'obsdatain': DATA_PATH, 'exports': {'variables': variables}}
+    data = bufr.parse({'observations': [{'obs space': config}]})[()]
+
+    lats = np.ma.filled(data['latitude'].astype(np.float64), np.nan)
+    lons = np.ma.filled(data['longitude'].astype(np.float64), np.nan)
+
+    # Degrees east of 170 (like the split wraps the longitudes)
+    def east_of_west(lon):
+        if not (-180.0 <= lon < 180.0):
+            lon = np.fmod(lon + 180.0, 360.0)
+            lon = (lon + 360.0 if lon < 0 else lon) - 180.0
+
+        east = lon - 170.0
+        return east + 360.0 if east < 0 else east
+
+    # 10 degree tiles from 170 to -170 (across the dateline), with the south and north bounds
+    # on the most southern and northern locations between them
+    easts = np.array([east_of_west(lon) if np.isfinite(lon) else np.nan for lon in lons])
+    in_lons = np.isfinite(lats) & (easts <= 20.0)
+    south = float(lats[in_lons].min())
+    north = float(lats[in_lons].max())
+
+    split = {'geobox': {'latitude': 'latitude',
+                        'longitude': 'longitude',
+                        'latitudeStep': 10,
+                        'south': south,
+                        'north': north,
+                        'west': 170,
+                        'east': -170}}
+
+    config['exports']['splits'] = {'box': split}
+    split_data = bufr.parse({'observations': [{'obs space': config}]})
+
+    # The rows of each tile in their order (the north and east bounds are in the last tiles)
+    num_lat_tiles = int(np.ceil((north - south) / 10))
+    tiles = {}
+    for row in np.nonzero(in_lons)[0]:
+        lat_tile = min(int((lats[row] - south) / 10), num_lat_tiles - 1)
+        lon_tile = min(int(easts[row] / 10), 1)
+
+        tile_south = south + lat_tile * 10
+        name = 'lat_%g_%g__lon_%s' % (tile_south, min(tile_south + 10, north),
+                                      ['170_180', '-180_-170'][lon_tile])
+        tiles.setdefault(name, []).append(row)
+
+    assert any(name.endswith('_170_180') for name in tiles)
+    assert any(name.endswith('_-180_-170') for name in tiles)
+    assert sorted(split_data.keys()) == sorted((name,) for name in tiles)
+
+    for name, rows in tiles.items():
+        assert np.array_equal(split_data[(name,)]['latitude'], data['latitude'][rows])
+        assert np.array_equal(split_data[(name,)]['longitude'], data['longitude'][rows])
+
+    # The locations on the south and north edges are in the tiles
+    split_lats = np.concatenate([split_data[(name,)]['latitude'] for name in tiles])
+    assert np.count_nonzero(split_lats == data['latitude'][in_lons].min()) > 0
+    assert np.count_nonzero(split_lats == data['latitude'][in_lons].max()) > 0
+    assert len(split_lats) == np.count_nonzero(in_lons)
 
 if __name__ == '__main__':
     test_basic_query()
@@ -122,3 +975,29 @@ if __name__ == '__main__':
     test_long_str_field()
     test_type_override()
     test_invalid_query()
+    test_threaded_execute()
+    test_message_index()
+    test_plan_cache()
+    test_wmo_table_cache()
+    test_memory_file()
+    test_compressed_file()
+    test_file_set()
+    test_concurrent_files()
+    test_execute_chunks()
+    test_get_many()
+    test_get_shared()
+    test_array_outlives_result_set()
+    test_release_field()
+    test_shared_queries()
+    test_get_arrow()
+    test_time_window()
+    test_shared_executor()
+    test_buffer_pool()
+    test_message_sampling()
+    test_read_ahead()
+    test_parse()
+    test_duplicates_filter()
+    test_thinning_filter()
+    test_sort()
+    test_time_split()
+    test_geobox_split()
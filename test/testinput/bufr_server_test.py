@@ -0,0 +1,67 @@
+# (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+#
+# This software is licensed under the terms of the Apache Licence Version 2.0
+# which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+
+# Starts bufr2ioda.x --listen, has it convert the MHS file and stops it. The output
+# (testrun/gdas.t18z.1bmhs.tm00.bufr_d.server.nc) is compared to the reference by the next test.
+
+import os
+import signal
+import socket
+import subprocess
+import sys
+import time
+
+SOCKET_PATH = './testrun/bufr_server.sock'
+YAML_PATH = './testinput/bufr_mhs_server.yaml'
+BUFR_PATH = './testinput/gdas.t18z.1bmhs.tm00.bufr_d'
+TIMEOUT = 300
+
+
+def wait_for_socket(server):
+    start = time.time()
+    while not os.path.exists(SOCKET_PATH):
+        assert server.poll() is None, f'bufr2ioda.x exited with {server.returncode}'
+        assert time.time() - start < TIMEOUT, 'bufr2ioda.x did not listen on the socket'
+        time.sleep(0.1)
+
+
+def convert(path):
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as client:
+        client.settimeout(TIMEOUT)
+        client.connect(SOCKET_PATH)
+        client.sendall((path + '\n').encode())
+
+        reply = b''
+        while not reply.endswith(b'\n'):
+            data = client.recv(4096)
+            assert data, 'bufr2ioda.x closed the connection'
+            reply += data
+
+    return reply.decode().strip()
+
+
+def test_server(bufr2ioda):
+    if os.path.exists(SOCKET_PATH):
+        os.remove(SOCKET_PATH)
+
+    server = subprocess.Popen([bufr2ioda, '--listen', SOCKET_PATH, YAML_PATH])
+    try:
+        wait_for_socket(server)
+
+        reply = convert(BUFR_PATH)
+        assert reply == f'OK {BUFR_PATH}', reply
+
+        # Files no observations entry reads are skipped.
+        reply = convert('./testinput/unknown.bufr_d')
+        assert reply == 'SKIPPED ./testinput/unknown.bufr_d', reply
+    finally:
+        server.send_signal(signal.SIGTERM)
+        server.wait(timeout=TIMEOUT)
+
+    assert server.returncode == 0, f'bufr2ioda.x exited with {server.returncode}'
+
+
+if __name__ == '__main__':
+    test_server(sys.argv[1])
@@ -0,0 +1,31 @@
+# (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+#
+# This software is licensed under the terms of the Apache Licence Version 2.0
+# which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+
+import numpy as np
+
+from pyioda import ioda_obs_space as ioda_ospace
+
+OUTPUT_PATH = './testrun/bufr_ncep_long_strs_fixed.nc'
+
+
+def read_strings(obsspace, name):
+    return [str(value) for value in np.array(obsspace.Variable(name).read_data()).ravel()]
+
+
+def test_string_length():
+    obsspace = ioda_ospace.ObsSpace(OUTPUT_PATH)
+
+    # Values longer than the string length are truncated, the shorter ones are kept
+    wgoslid = read_strings(obsspace, 'MetaData/wgoslid')
+    assert any(len(value) > 6 for value in wgoslid)
+    assert read_strings(obsspace, 'MetaData/wgoslidFixed') == [value[:6] for value in wgoslid]
+
+    # With auto nothing is truncated
+    lstn = read_strings(obsspace, 'MetaData/lstn')
+    assert read_strings(obsspace, 'MetaData/lstnFixed') == lstn
+
+
+if __name__ == '__main__':
+    test_string_length()
@@ -0,0 +1,283 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "Inventory.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+#include "../../../src/bufr/BufrParser/Query/Constants.h"
+#include "../../../src/bufr/BufrParser/Query/Parallel.h"
+#include "../../../src/bufr/BufrParser/Query/QuerySet.h"
+#include "../../../src/bufr/BufrParser/Query/DataProvider/MessageIndex.h"
+#include "../../../src/bufr/BufrParser/Query/DataProvider/NcepDataProvider.h"
+#include "../../../src/bufr/BufrParser/Query/DataProvider/WmoDataProvider.h"
+
+
+namespace
+{
+    // Every scanning thread has a BUFR file open, and NCEPLIB-bufr can only have so many.
+    const size_t MaxThreads = 16;
+
+    std::string jsonString(const std::string& str)
+    {
+        std::ostringstream ostr;
+        ostr << '"';
+        for (const char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                ostr << '\\' << c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                ostr << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                     << static_cast<int>(c) << std::dec;
+            }
+            else
+            {
+                ostr << c;
+            }
+        }
+
+        ostr << '"';
+        return ostr.str();
+    }
+
+    /// \brief Write the statistics of the subset variants (and their sum) as the members of a
+    ///        JSON object.
+    void writeSubsets(const Ingester::bufr::SubsetStatsMap& subsets,
+                      const std::string& indent,
+                      std::ostream& out)
+    {
+        Ingester::bufr::SubsetStats total;
+        for (const auto& subset : subsets)
+        {
+            total.add(subset.second);
+        }
+
+        out << indent << "\"messages\": " << total.messages << ",\n";
+        out << indent << "\"subsets\": " << total.subsets << ",\n";
+        out << indent << "\"bytes\": " << total.bytes << ",\n";
+        out << indent << "\"subset_variants\": [";
+
+        bool isFirst = true;
+        for (const auto& subset : subsets)
+        {
+            const auto& stats = subset.second;
+            out << (isFirst ? "\n" : ",\n") << indent << "  {\n";
+            isFirst = false;
+
+            const std::string inner = indent + "    ";
+            out << inner << "\"subset\": " << jsonString(subset.first.first) << ",\n";
+            out << inner << "\"variant\": " << subset.first.second << ",\n";
+            out << inner << "\"messages\": " << stats.messages << ",\n";
+            out << inner << "\"subsets\": " << stats.subsets << ",\n";
+            out << inner << "\"bytes\": " << stats.bytes << ",\n";
+            out << inner << "\"first_date\": " << stats.firstDate << ",\n";
+            out << inner << "\"last_date\": " << stats.lastDate;
+
+            if (!stats.mnemonics.empty())
+            {
+                out << ",\n" << inner << "\"mnemonics\": {";
+
+                bool isFirstMnemonic = true;
+                for (const auto& mnemonic : stats.mnemonics)
+                {
+                    const auto& counts = mnemonic.second;
+                    const double missingRate = counts.values > 0 ?
+                        static_cast<double>(counts.missing) / static_cast<double>(counts.values) :
+                        0.0;
+
+                    out << (isFirstMnemonic ? "\n" : ",\n") << inner << "  ";
+                    out << jsonString(mnemonic.first) << ": {\"values\": " << counts.values;
+                    out << ", \"missing\": " << counts.missing;
+                    out << ", \"missing_rate\": " << missingRate << "}";
+                    isFirstMnemonic = false;
+                }
+
+                out << "\n" << inner << "}";
+            }
+
+            out << "\n" << indent << "  }";
+        }
+
+        out << (isFirst ? "]" : "\n" + indent + "]");
+    }
+}  // namespace
+
+namespace Ingester {
+namespace bufr {
+    void SubsetStats::addMessage(int date, std::uint64_t numSubsets, std::uint64_t length)
+    {
+        if (messages == 0 || date < firstDate) firstDate = date;
+        if (messages == 0 || date > lastDate) lastDate = date;
+
+        messages++;
+        subsets += numSubsets;
+        bytes += length;
+    }
+
+    void SubsetStats::add(const SubsetStats& other)
+    {
+        if (other.messages == 0) return;
+
+        if (messages == 0 || other.firstDate < firstDate) firstDate = other.firstDate;
+        if (messages == 0 || other.lastDate > lastDate) lastDate = other.lastDate;
+
+        messages += other.messages;
+        subsets += other.subsets;
+        bytes += other.bytes;
+
+        for (const auto& mnemonic : other.mnemonics)
+        {
+            auto& counts = mnemonics[mnemonic.first];
+            counts.values += mnemonic.second.values;
+            counts.missing += mnemonic.second.missing;
+        }
+    }
+
+    Inventory::Inventory(const InventoryOptions& options) :
+        options_(options)
+    {
+    }
+
+    void Inventory::scan(const std::vector<std::string>& paths, size_t threads)
+    {
+        files_.clear();
+        files_.resize(paths.size());
+        parallelFor(paths.size(),
+                    std::min(std::max<size_t>(threads, 1), MaxThreads),
+                    [this, &paths](size_t fileIdx)
+                    {
+                        files_[fileIdx] = scanFile(paths[fileIdx]);
+                    });
+    }
+
+    void Inventory::writeJson(std::ostream& out) const
+    {
+        SubsetStatsMap total;
+
+        out << "{\n";
+        out << "  \"files\": [";
+        for (size_t fileIdx = 0; fileIdx < files_.size(); fileIdx++)
+        {
+            const auto& file = files_[fileIdx];
+            out << (fileIdx == 0 ? "\n" : ",\n") << "    {\n";
+            out << "      \"path\": " << jsonString(file.path) << ",\n";
+            writeSubsets(file.subsets, "      ", out);
+            out << "\n    }";
+
+            for (const auto& subset : file.subsets)
+            {
+                total[subset.first].add(subset.second);
+            }
+        }
+
+        out << (files_.empty() ? "],\n" : "\n  ],\n");
+        out << "  \"total\": {\n";
+        writeSubsets(total, "    ", out);
+        out << "\n  }\n";
+        out << "}" << std::endl;
+    }
+
+    FileInventory Inventory::scanFile(const std::string& path) const
+    {
+        FileInventory inventory;
+        inventory.path = path;
+
+        std::shared_ptr<const MessageIndex> index;
+        if (options_.useIndex)
+        {
+            index = MessageIndex::load(path, MessageIndex::defaultPath(path), options_.tablePath);
+        }
+
+        // NCEP files have no subset variants, so the index has everything.
+        if (index && options_.tablePath.empty() && !options_.missingRates)
+        {
+            for (const auto& entry : index->entries())
+            {
+                if (entry.isDictionary) continue;
+
+                inventory.subsets[{entry.subset, 0}].addMessage(entry.date,
+                                                                entry.numSubsets,
+                                                                entry.length);
+            }
+
+            return inventory;
+        }
+
+        std::shared_ptr<DataProvider> dataProvider;
+        if (options_.tablePath.empty())
+        {
+            dataProvider = std::make_shared<NcepDataProvider>(path);
+        }
+        else
+        {
+            dataProvider = std::make_shared<WmoDataProvider>(path, options_.tablePath);
+        }
+
+        if (index) dataProvider->setMessageIndex(index);
+
+        auto& subsets = inventory.subsets;
+        dataProvider->scanHeaders([&subsets](const MessageHeader& header)
+        {
+            subsets[{header.variant.subset, header.variant.variantId}].addMessage(
+                header.date,
+                header.numSubsets,
+                header.length);
+        });
+
+        if (options_.missingRates)
+        {
+            dataProvider->open();
+            countMissing(dataProvider, subsets);
+            dataProvider->close();
+        }
+
+        return inventory;
+    }
+
+    void Inventory::countMissing(const std::shared_ptr<DataProvider>& dataProvider,
+                                 SubsetStatsMap& subsets) const
+    {
+        // The counts for every table node of each variant (only the numbers are counted, the
+        // rest point to ignored).
+        std::unordered_map<SubsetVariant, std::vector<MnemonicStats*>> nodeCounts;
+        MnemonicStats ignored;
+
+        auto processSubset = [&dataProvider, &subsets, &nodeCounts, &ignored]()
+        {
+            const auto variant = dataProvider->getSubsetVariant();
+            auto& stats = subsets[{variant.subset, variant.variantId}];
+            auto& counts = nodeCounts[variant];
+
+            const auto vals = dataProvider->getVals();
+            const auto invs = dataProvider->getInvs();
+            const auto numVals = static_cast<size_t>(dataProvider->getNVal());
+            for (size_t valIdx = 0; valIdx < numVals; valIdx++)
+            {
+                const auto nodeIdx = static_cast<size_t>(invs[valIdx]);
+                if (nodeIdx >= counts.size()) counts.resize(nodeIdx + 1, nullptr);
+
+                if (counts[nodeIdx] == nullptr)
+                {
+                    counts[nodeIdx] = (dataProvider->getTyp(nodeIdx) == Typ::Number) ?
+                        &stats.mnemonics[dataProvider->getTag(nodeIdx)] : &ignored;
+                }
+
+                counts[nodeIdx]->values++;
+                if (vals[valIdx] >= MissingOctetValue) counts[nodeIdx]->missing++;
+            }
+        };
+
+        dataProvider->run(QuerySet(), processSubset);
+    }
+}  // namespace bufr
+}  // namespace Ingester
@@ -0,0 +1,94 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../../src/bufr/BufrParser/Query/DataProvider/DataProvider.h"
+
+
+namespace Ingester {
+namespace bufr {
+    /// \brief How to take the inventory of the files.
+    struct InventoryOptions
+    {
+        std::string tablePath;  // WMO master tables (for WMO BUFR files)
+        bool useIndex = false;  // Use (or build) the <file>.idx message index sidecars
+        bool missingRates = false;  // Decode the subsets to count the missing values
+    };
+
+    /// \brief The number of values of a mnemonic and how many of them are missing.
+    struct MnemonicStats
+    {
+        std::uint64_t values = 0;
+        std::uint64_t missing = 0;
+    };
+
+    /// \brief The statistics of the messages of one subset variant.
+    struct SubsetStats
+    {
+        std::uint64_t messages = 0;
+        std::uint64_t subsets = 0;
+        std::uint64_t bytes = 0;
+        int firstDate = 0;  // YYYYMMDDHH
+        int lastDate = 0;  // YYYYMMDDHH
+        std::map<std::string, MnemonicStats> mnemonics;  // Only with missing rates
+
+        /// \brief Count a message.
+        void addMessage(int date, std::uint64_t numSubsets, std::uint64_t length);
+
+        /// \brief Add the statistics of other messages of the variant.
+        void add(const SubsetStats& other);
+    };
+
+    /// \brief The subset variants (by subset name and variant id) found in a file.
+    typedef std::map<std::pair<std::string, size_t>, SubsetStats> SubsetStatsMap;
+
+    /// \brief The inventory of one BUFR file.
+    struct FileInventory
+    {
+        std::string path;
+        SubsetStatsMap subsets;
+    };
+
+    /// \brief Takes the inventory of BUFR files (the messages, subsets, dates and sizes for each
+    ///        subset variant) from their message headers, so the subsets don't have to be
+    ///        decoded (unless the missing rates are wanted).
+    class Inventory
+    {
+     public:
+        explicit Inventory(const InventoryOptions& options);
+
+        /// \brief Take the inventory of the files.
+        /// \param paths The paths of the BUFR files.
+        /// \param threads The number of files to scan at the same time.
+        void scan(const std::vector<std::string>& paths, size_t threads);
+
+        /// \brief Write the inventory (per file and in total) as JSON.
+        /// \param out The stream to write to.
+        void writeJson(std::ostream& out) const;
+
+     private:
+        const InventoryOptions options_;
+        std::vector<FileInventory> files_;
+
+        /// \brief Take the inventory of one file.
+        FileInventory scanFile(const std::string& path) const;
+
+        /// \brief Count the values of every mnemonic, and the missing ones.
+        void countMissing(const std::shared_ptr<DataProvider>& dataProvider,
+                          SubsetStatsMap& subsets) const;
+    };
+}  // namespace bufr
+}  // namespace Ingester
@@ -23,9 +23,10 @@ namespace bufr {
     {
     }
 
-    SubsetTableType NcepQueryPrinter::getTable(const SubsetVariant& variant)
+    SubsetTableType NcepQueryPrinter::buildTable(const SubsetVariant& variant,
+                                                 const std::shared_ptr<DataProvider>& dataProvider)
     {
-        if (dataProvider_->isFileOpen())
+        if (dataProvider->isFileOpen())
         {
             std::ostringstream errStr;
             errStr << "Tried to call QueryPrinter::getTable, but the file is already open!";
@@ -34,10 +35,9 @@ namespace bufr {
 
         bool finished = false;
 
-        dataProvider_->open();
+        dataProvider->open();
 
         std::shared_ptr<SubsetTable> subsetTable;
-        auto& dataProvider = dataProvider_;
         auto processSubset = [&subsetTable, &finished, &dataProvider]() mutable
         {
             subsetTable = std::make_shared<SubsetTable>(dataProvider);
@@ -49,16 +49,21 @@ namespace bufr {
             return !finished;
         };
 
-        dataProvider_->run(QuerySet({variant.subset}),
-                           processSubset,
+        dataProvider->run(QuerySet({variant.subset}),
+                          processSubset,
                           [](){},
-                           continueProcessing);
+                          continueProcessing);
 
-        dataProvider_->close();
+        dataProvider->close();
 
         return subsetTable;
     }
 
+    std::shared_ptr<DataProvider> NcepQueryPrinter::makeDataProvider() const
+    {
+        return std::make_shared<NcepDataProvider>(dataProvider_->getFilepath());
+    }
+
     std::set<SubsetVariant> NcepQueryPrinter::getSubsetVariants() const
     {
         if (dataProvider_->isFileOpen())
@@ -68,23 +73,14 @@ namespace bufr {
             throw eckit::BadParameter(errStr.str());
         }
 
-        dataProvider_->open();
-
-        std::set<SubsetVariant> subsets;
-
-        auto& dataProvider = dataProvider_;
-        auto processMsg = [&subsets, &dataProvider] () mutable
+        // Only the message headers are needed, so none of the subsets are decoded.
+        std::set<SubsetVariant> variants;
+        dataProvider_->scanHeaders([&variants](const MessageHeader& header)
         {
-            subsets.insert(dataProvider->getSubsetVariant());
-        };
-
-        dataProvider_->run(QuerySet(),
-                           [](){},
-                           processMsg);
-
-        dataProvider_->close();
+            variants.insert(header.variant);
+        });
 
-        return subsets;
+        return variants;
     }
 }  // namespace bufr
 }  // namespace Ingester
@@ -9,6 +9,7 @@
 
 #include "QueryPrinter.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -21,15 +22,22 @@ namespace bufr {
      public:
         explicit NcepQueryPrinter(const std::string& filepath);
 
-        /// \brief Get the query data for a specific subset variant type
-        /// \param variant The subset variant
-        /// \returns Vector of SubsetTable BufrNode objects
-        SubsetTableType getTable(const SubsetVariant& variant) final;
-
         /// \brief Get a complete set of subset variants in the data file. WARNING: using this will
         ///        be slow and reset the file pointer.
         /// \returns Vector of subset variants
         std::set<SubsetVariant> getSubsetVariants() const final;
+
+     private:
+        /// \brief Get the query data for a specific subset variant type
+        /// \param variant The subset variant
+        /// \param dataProvider The data provider to read the file with (can't be open)
+        /// \returns Vector of SubsetTable BufrNode objects
+        SubsetTableType buildTable(const SubsetVariant& variant,
+                                   const std::shared_ptr<DataProvider>& dataProvider) final;
+
+        /// \brief Make another data provider for the file.
+        /// \returns The data provider
+        std::shared_ptr<DataProvider> makeDataProvider() const final;
     };
 }  // namespace bufr
 }  // namespace Ingester
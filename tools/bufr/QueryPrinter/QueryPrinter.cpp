@@ -10,7 +10,15 @@
 #include <algorithm>
 #include <iostream>
 #include <map>
+#include <vector>
 
+#include "../../../src/bufr/BufrParser/Query/Parallel.h"
+
+
+namespace
+{
+    const size_t MaxThreads = 16;
+}  // namespace
 
 namespace Ingester {
 namespace bufr {
@@ -55,9 +63,31 @@ namespace bufr {
                       << variants.size()
                       << std::endl << std::endl;
 
-            for (const auto& v : variants)
+            // The tables of the variants are built at the same time, each with its own data
+            // provider (the NCEPLIB-bufr calls still take turns), then printed in order.
+            const std::vector<SubsetVariant> variantList(variants.begin(), variants.end());
+            std::vector<SubsetTableType> tables(variantList.size());
+            const size_t numThreads = std::min(std::max<size_t>(numThreads_, 1), MaxThreads);
+            if (numThreads > 1 && variantList.size() > 1)
+            {
+                parallelFor(variantList.size(), numThreads,
+                            [this, &variantList, &tables](size_t idx)
+                            {
+                                tables[idx] = buildTable(variantList[idx], makeDataProvider());
+                            });
+            }
+            else
+            {
+                for (size_t idx = 0; idx < variantList.size(); idx++)
+                {
+                    tables[idx] = getTable(variantList[idx]);
+                }
+            }
+
+            for (size_t idx = 0; idx < variantList.size(); idx++)
             {
-                auto queries = getTable(v);
+                const auto& v = variantList[idx];
+                const auto& queries = tables[idx];
 
                 std::cout << v.str() << std::endl;
                 std::cout << " Dimensioning Sub-paths: " << std::endl;
@@ -75,11 +105,12 @@ namespace bufr {
     QueryPrinter::getDimPaths(const SubsetTableType& table)
     {
         std::map<std::string, std::pair<int, std::string>> dimPathMap;
-        for (const auto& leaf : table->getLeaves())
+        for (const auto leafId : table->getLeaves())
         {
-            for (const auto& path : leaf->getDimPaths())
+            const auto numDims = static_cast<int>(table->getNode(leafId).numDims);
+            for (const auto& path : table->getDimPaths(leafId))
             {
-                dimPathMap[path] = std::make_pair(leaf->getDimIdxs().size(), path);
+                dimPathMap[path] = std::make_pair(numDims, path);
             }
         }
 
@@ -162,32 +193,31 @@ namespace bufr {
 
     void QueryPrinter::printQueryList(const SubsetTableType& table)
     {
-        for (auto leaf : table->getLeaves())
+        for (const auto leafId : table->getLeaves())
         {
             std::vector<std::string> pathComponents;
-            std::shared_ptr<BufrNode> currentNode = leaf;
-
-            while (currentNode != nullptr)
+            for (auto nodeId = leafId; nodeId != BufrNode::NoNode;
+                 nodeId = table->getNode(nodeId).parent)
             {
-                if (currentNode->isQueryPathNode() || currentNode->isLeaf())
+                const auto& node = table->getNode(nodeId);
+                if (node.isQueryPathNode() || node.isLeaf())
                 {
                     std::ostringstream pathStr;
-                    pathStr << currentNode->mnemonic;
+                    pathStr << table->getMnemonic(nodeId);
 
-                    if (currentNode->hasDuplicates)
+                    if (node.hasDuplicates)
                     {
-                        pathStr << "[" << currentNode->copyIdx << "]";
+                        pathStr << "[" << node.copyIdx << "]";
                     }
 
                     pathComponents.push_back(pathStr.str());
                 }
-
-                currentNode = currentNode->parent.lock();
             }
 
+            const auto& leaf = table->getNode(leafId);
             std::ostringstream ostr;
-            ostr << dimStyledStr(static_cast<int>(leaf->getDimIdxs().size())) << "  ";
-            ostr << typeStyledStr(leaf->typeInfo) << "  ";
+            ostr << dimStyledStr(static_cast<int>(leaf.numDims)) << "  ";
+            ostr << typeStyledStr(leaf.typeInfo) << "  ";
 
             for (auto it = pathComponents.rbegin(); it != pathComponents.rend(); ++it)
             {
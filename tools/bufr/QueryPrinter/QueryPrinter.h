@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 
 #include "../../../src/bufr/BufrParser/Query/DataProvider/DataProvider.h"
@@ -32,7 +33,21 @@ namespace bufr {
         /// \brief Get the query data for a specific subset variant type
         /// \param variant The subset variant
         /// \returns Vector of SubsetTable QueryData objects
-        virtual SubsetTableType getTable(const SubsetVariant& variant) = 0;
+        SubsetTableType getTable(const SubsetVariant& variant)
+        {
+            return buildTable(variant, dataProvider_);
+        }
+
+        /// \brief Build the tables of the subset variants on up to this many threads (one data
+        ///        provider per thread, see makeDataProvider).
+        /// \param numThreads The number of threads
+        void setNumThreads(size_t numThreads) { numThreads_ = numThreads; }
+
+        /// \brief Build the table of a variant from its first subset in the file instead of
+        ///        going through all of them for the one with the most queries. Much faster on
+        ///        large files, but queries that only some of the subsets have can be left out.
+        /// \param firstSubsetOnly Stop at the first subset
+        void setFirstSubsetOnly(bool firstSubsetOnly) { firstSubsetOnly_ = firstSubsetOnly; }
 
         /// \brief Get a complete set of subsets in the data file.
         /// \returns Vector of subset variants
@@ -41,6 +56,20 @@ namespace bufr {
      protected:
         const int FileUnit = 12;
         std::shared_ptr<DataProvider> dataProvider_;
+        size_t numThreads_ = 1;
+        bool firstSubsetOnly_ = false;
+
+        /// \brief Get the query data for a specific subset variant type
+        /// \param variant The subset variant
+        /// \param dataProvider The data provider to read the file with (can't be open)
+        /// \returns Vector of SubsetTable QueryData objects
+        virtual SubsetTableType buildTable(const SubsetVariant& variant,
+                                           const std::shared_ptr<DataProvider>& dataProvider) = 0;
+
+        /// \brief Make another data provider for the file, ready to get the tables of the
+        ///        variants found with dataProvider_ (for the threads of printQueries).
+        /// \returns The data provider
+        virtual std::shared_ptr<DataProvider> makeDataProvider() const = 0;
 
         /// \brief Get the dimension paths for the given query data objects
         /// \param queryData Vector of QueryData objects
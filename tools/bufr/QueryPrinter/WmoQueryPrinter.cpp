@@ -10,8 +10,6 @@
 
 #include <iostream>
 #include <memory>
-#include <unordered_map>
-#include <unordered_set>
 #include <sstream>
 
 #include "eckit/exception/Exceptions.h"
@@ -21,30 +19,45 @@
 
 namespace Ingester {
 namespace bufr {
-    WmoQueryPrinter::WmoQueryPrinter(const std::string& filepath, const std::string& tablepath) :
-        QueryPrinter(std::make_shared<WmoDataProvider>(filepath, tablepath))
+    namespace
+    {
+        std::shared_ptr<WmoDataProvider> makeWmoDataProvider(const std::string& filepath,
+                                                             const std::string& tablepath,
+                                                             const std::string& tableCachePath)
+        {
+            auto dataProvider = std::make_shared<WmoDataProvider>(filepath, tablepath);
+            dataProvider->setTableCachePath(tableCachePath);
+            return dataProvider;
+        }
+    }  // namespace
+
+    WmoQueryPrinter::WmoQueryPrinter(const std::string& filepath,
+                                     const std::string& tablepath,
+                                     const std::string& tableCachePath) :
+        QueryPrinter(makeWmoDataProvider(filepath, tablepath, tableCachePath)),
+        tablePath_(tablepath),
+        tableCachePath_(tableCachePath)
     {
     }
 
-    SubsetTableType WmoQueryPrinter::getTable(const SubsetVariant& variant)
+    SubsetTableType WmoQueryPrinter::buildTable(const SubsetVariant& variant,
+                                                const std::shared_ptr<DataProvider>& dataProvider)
     {
-        if (dataProvider_->isFileOpen())
+        if (dataProvider->isFileOpen())
         {
             std::ostringstream errStr;
             errStr << "Tried to call QueryPrinter::getTable, but the file is already open!";
             throw eckit::BadParameter(errStr.str());
         }
 
-        dataProvider_->open();
-
-        std::unordered_map<SubsetVariant, BufrNodeVector> dataMap;
-
-        std::unordered_set<std::string> knownQueries;
+        dataProvider->open();
 
         size_t maxLeaves = 0;
+        bool finished = false;
         std::shared_ptr<SubsetTable> subsetTable;
-        auto& dataProvider = dataProvider_;
-        auto processSubset = [&variant, &subsetTable, &maxLeaves, &dataProvider]() mutable
+        const bool firstSubsetOnly = firstSubsetOnly_;
+        auto processSubset = [&variant, &subsetTable, &maxLeaves, &finished, &dataProvider,
+                              firstSubsetOnly]() mutable
         {
             auto subsetVariant = dataProvider->getSubsetVariant();
             if (subsetVariant == variant)
@@ -59,15 +72,36 @@ namespace bufr {
                     maxLeaves = leaves.size();
                     subsetTable = thisTable;
                 }
+
+                finished = firstSubsetOnly;
             }
         };
 
-        dataProvider_->run(QuerySet({variant.subset}), processSubset);
-        dataProvider_->close();
+        auto continueProcessing = [&finished]() -> bool
+        {
+            return !finished;
+        };
+
+        dataProvider->run(QuerySet({variant.subset}),
+                          processSubset,
+                          [](){},
+                          continueProcessing);
+
+        dataProvider->close();
 
         return subsetTable;
     }
 
+    std::shared_ptr<DataProvider> WmoQueryPrinter::makeDataProvider() const
+    {
+        auto dataProvider = makeWmoDataProvider(dataProvider_->getFilepath(),
+                                                tablePath_,
+                                                tableCachePath_);
+
+        dataProvider->shareTableData(*std::static_pointer_cast<WmoDataProvider>(dataProvider_));
+        return dataProvider;
+    }
+
     std::set<SubsetVariant> WmoQueryPrinter::getSubsetVariants() const
     {
         if (dataProvider_->isFileOpen())
@@ -77,19 +111,12 @@ namespace bufr {
             throw eckit::BadParameter(errStr.str());
         }
 
-        dataProvider_->open();
-
+        // Only the message headers are needed, so none of the subsets are decoded.
         std::set<SubsetVariant> variants;
-        auto& dataProvider = dataProvider_;
-
-        auto processSubset = [&variants, &dataProvider]()
+        dataProvider_->scanHeaders([&variants](const MessageHeader& header)
         {
-            variants.insert(dataProvider->getSubsetVariant());
-        };
-
-        dataProvider_->run(QuerySet(), processSubset);
-
-        dataProvider_->close();
+            variants.insert(header.variant);
+        });
 
         return variants;
     }
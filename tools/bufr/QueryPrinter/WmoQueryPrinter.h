@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+
 #include "QueryPrinter.h"
 
 
@@ -18,18 +21,36 @@ namespace bufr {
     class WmoQueryPrinter : public QueryPrinter
     {
      public:
-       WmoQueryPrinter(const std::string& filepath, const std::string& tablepath);
+       /// \param filepath Path to the BUFR file
+       /// \param tablepath Path to the WMO master tables
+       /// \param tableCachePath (Optional) Path to the table cache file of the BUFR file (see
+       ///        WmoDataProvider::setTableCachePath). Later runs on the file then don't have to
+       ///        go through it to find the variants.
+       WmoQueryPrinter(const std::string& filepath,
+                       const std::string& tablepath,
+                       const std::string& tableCachePath = "");
        ~WmoQueryPrinter() = default;
 
-        /// \brief Get the query data for a specific subset variant type
-        /// \param variant The subset variant
-        /// \returns Vector of BufrNode QueryData objects
-        SubsetTableType getTable(const SubsetVariant& variant) final;
-
         /// \brief Get a complete set of subsets in the data file. WARNING: using this will be slow
         ///        and reset the file pointer.
         /// \returns Vector of subset variants
         std::set<SubsetVariant> getSubsetVariants() const final;
+
+     private:
+        const std::string tablePath_;
+        const std::string tableCachePath_;
+
+        /// \brief Get the query data for a specific subset variant type
+        /// \param variant The subset variant
+        /// \param dataProvider The data provider to read the file with (can't be open)
+        /// \returns Vector of BufrNode QueryData objects
+        SubsetTableType buildTable(const SubsetVariant& variant,
+                                   const std::shared_ptr<DataProvider>& dataProvider) final;
+
+        /// \brief Make another data provider for the file that shares the tables of
+        ///        dataProvider_ (so the variants are numbered the same).
+        /// \returns The data provider
+        std::shared_ptr<DataProvider> makeDataProvider() const final;
     };
 }  // namespace bufr
 }  // namespace Ingester
@@ -0,0 +1,143 @@
+/*
+ * (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <glob.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Inventory/Inventory.h"
+
+
+void printHelp()
+{
+    std::cout << "Description: " << std::endl;
+    std::cout << "  Takes the inventory of BUFR files (messages, subsets, dates and bytes per"
+              << std::endl;
+    std::cout << "  subset variant) from their message headers, and writes it as JSON."
+              << std::endl;
+    std::cout << "Arguments: " << std::endl;
+    std::cout << "  -h             (Optional) Print out the help message." << std::endl;
+    std::cout << "  -t <tablepath> (Optional) Path to the WMO master tables (WMO BUFR files)."
+              << std::endl;
+    std::cout << "  -j <threads>   (Optional) Number of files to scan at once." << std::endl;
+    std::cout << "  -i             (Optional) Use (or build) the <file>.idx message indices."
+              << std::endl;
+    std::cout << "  -m             (Optional) Decode the subsets to report the missing value"
+              << std::endl;
+    std::cout << "                 rates of every mnemonic." << std::endl;
+    std::cout << "  -o <file>      (Optional) Write the JSON to this file (stdout by default)."
+              << std::endl;
+    std::cout << "  input_files    Paths (or glob patterns) of the BUFR files." << std::endl;
+    std::cout << "Examples: " << std::endl;
+    std::cout << "  ./bufr_inventory.x ../data/gdas.t00z.1bamua.tm00.bufr_d" << std::endl;
+    std::cout << "  ./bufr_inventory.x -j 8 -i -o inventory.json \"../data/gdas.*.bufr_d\""
+              << std::endl;
+}
+
+/// \brief Expand the glob patterns (the other paths are kept as they are).
+std::vector<std::string> expandPaths(const std::vector<std::string>& patterns)
+{
+    std::vector<std::string> paths;
+    for (const auto& pattern : patterns)
+    {
+        glob_t matches;
+        if (glob(pattern.c_str(), GLOB_NOCHECK, nullptr, &matches) == 0)
+        {
+            for (size_t matchIdx = 0; matchIdx < matches.gl_pathc; matchIdx++)
+            {
+                paths.emplace_back(matches.gl_pathv[matchIdx]);
+            }
+        }
+
+        globfree(&matches);
+    }
+
+    return paths;
+}
+
+int main(int argc, char** argv)
+{
+    Ingester::bufr::InventoryOptions options;
+    std::vector<std::string> inputFiles;
+    std::string outputFile = "";
+    size_t threads = 1;
+
+    int idx = 1;
+    while (idx < argc)
+    {
+        std::string arg = argv[idx];
+        const bool hasValue = idx + 1 < argc;
+        if (arg == "-h")
+        {
+            printHelp();
+            exit(0);
+        }
+        else if (arg == "-t" && hasValue)
+        {
+            options.tablePath = std::string(argv[idx + 1]);
+            idx = idx + 2;
+        }
+        else if (arg == "-j" && hasValue)
+        {
+            threads = static_cast<size_t>(std::max(std::stoi(argv[idx + 1]), 1));
+            idx = idx + 2;
+        }
+        else if (arg == "-o" && hasValue)
+        {
+            outputFile = std::string(argv[idx + 1]);
+            idx = idx + 2;
+        }
+        else if (arg == "-i")
+        {
+            options.useIndex = true;
+            idx++;
+        }
+        else if (arg == "-m")
+        {
+            options.missingRates = true;
+            idx++;
+        }
+        else
+        {
+            inputFiles.push_back(arg);
+            idx++;
+        }
+    }
+
+    const auto paths = expandPaths(inputFiles);
+    if (paths.empty())
+    {
+        printHelp();
+        std::cerr << "Error: no input files specified" << std::endl;
+        exit(1);
+    }
+
+    Ingester::bufr::Inventory inventory(options);
+    inventory.scan(paths, threads);
+
+    if (outputFile.empty())
+    {
+        inventory.writeJson(std::cout);
+    }
+    else
+    {
+        std::ofstream out(outputFile);
+        if (!out)
+        {
+            std::cerr << "Error: couldn't write to " << outputFile << std::endl;
+            exit(1);
+        }
+
+        inventory.writeJson(out);
+    }
+
+    return 0;
+}
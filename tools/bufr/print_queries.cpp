@@ -22,11 +22,18 @@ void printHelp()
     std::cout << "Arguments: " << std::endl;
     std::cout << "  -h          (Optional) Print out the help message." << std::endl;
     std::cout << "  -s <subset> (Optional) Print paths only for this subset." << std::endl;
+    std::cout << "  -t <path>   (Optional) Path to the WMO master tables." << std::endl;
+    std::cout << "  -c <path>   (Optional) Table cache file to read (or make) for the WMO "
+              << "variants." << std::endl;
+    std::cout << "  -j <num>    (Optional) Number of threads building the tables (default 1)."
+              << std::endl;
+    std::cout << "  -f          (Optional) Only use the first subset of each variant." << std::endl;
     std::cout << "  input_file  Path to the BUFR file." << std::endl;
     std::cout << "  output_file  (Optional) Save the output. " << std::endl;
     std::cout << "Examples: " << std::endl;
     std::cout << "  ./print_queries.x ../data/bufr_satwnd_old_format.bufr" << std::endl;
     std::cout << "  ./print_queries.x -s NC005066 ../data/bufr_satwnd_old_format.bufr" << std::endl;
+    std::cout << "  ./print_queries.x -j 8 -f -t ../tables -c gdas.tables gdas.bufr" << std::endl;
 }
 
 int main(int argc, char** argv)
@@ -34,6 +41,9 @@ int main(int argc, char** argv)
     std::string inputFile = "";
     std::string tablePath = "";
     std::string subset = "";
+    std::string tableCachePath = "";
+    size_t numThreads = 1;
+    bool firstSubsetOnly = false;
 
     int idx = 1;
     while (idx < argc)
@@ -62,6 +72,21 @@ int main(int argc, char** argv)
             tablePath = std::string(argv[idx + 1]);
             idx = idx + 2;
         }
+        else if (arg == "-c")
+        {
+            tableCachePath = std::string(argv[idx + 1]);
+            idx = idx + 2;
+        }
+        else if (arg == "-j")
+        {
+            numThreads = static_cast<size_t>(std::max(std::stoi(argv[idx + 1]), 1));
+            idx = idx + 2;
+        }
+        else if (arg == "-f")
+        {
+            firstSubsetOnly = true;
+            idx++;
+        }
         else
         {
             inputFile = arg;
@@ -85,9 +110,14 @@ int main(int argc, char** argv)
         }
         else
         {
-            printer = std::make_shared<Ingester::bufr::WmoQueryPrinter> (inputFile, tablePath);
+            printer = std::make_shared<Ingester::bufr::WmoQueryPrinter> (inputFile,
+                                                                         tablePath,
+                                                                         tableCachePath);
         }
 
+        printer->setNumThreads(numThreads);
+        printer->setFirstSubsetOnly(firstSubsetOnly);
+
         printer->printQueries(subset);
     }
     catch (const std::exception &e)
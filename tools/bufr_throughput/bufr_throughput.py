@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+#
+# (C) Copyright 2023 NOAA/NWS/NCEP/EMC
+#
+# This software is licensed under the terms of the Apache Licence Version 2.0
+# which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+#
+
+import argparse
+import json
+import os
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+import yaml
+
+
+# The curated configs (in the testinput directory), one per kind of workload.
+DEFAULT_CASES = [
+    'bufr_ncep_atms.yaml',
+    'bufr_ncep_1bamua_n15.yaml',
+    'bufr_ncep_mtiasi.yaml',
+    'bufr_ncep_prepbufr_adpupa.yaml',
+    'bufr_ncep_satwind_avhrr.yaml',
+]
+
+# The metrics compared with the baseline, and whether more is better.
+METRICS = {
+    'wall_seconds': False,
+    'subsets_per_second': True,
+    'mb_per_second': True,
+    'peak_rss_mb': False,
+}
+
+
+def _as_list(value):
+    return value if isinstance(value, list) else [value]
+
+
+def _make_inputs(paths, copies, work_dir):
+    """
+    Make the synthetic input files, each made of copies of a test file (the
+    messages and the tables they carry are repeated, so each copy is valid).
+    :return: The paths of the new files and their total size in bytes.
+    """
+    new_paths = []
+    num_bytes = 0
+    for path in paths:
+        new_path = os.path.join(work_dir, f'{copies}x_{os.path.basename(path)}')
+        if not os.path.exists(new_path):
+            with open(path, 'rb') as in_file:
+                contents = in_file.read()
+            with open(new_path, 'wb') as out_file:
+                for _ in range(copies):
+                    out_file.write(contents)
+
+        new_paths.append(new_path)
+        num_bytes += os.path.getsize(new_path)
+
+    return new_paths, num_bytes
+
+
+def _make_config(yaml_path, test_dir, copies, work_dir):
+    """
+    Make a copy of a config that reads the synthetic inputs and writes to the
+    work directory (the sidecar files are dropped so every run does the same
+    work).
+    :return: The path of the new config and the size of its inputs in bytes.
+    """
+    with open(yaml_path, 'r') as yaml_file:
+        config = yaml.safe_load(yaml_file)
+
+    num_bytes = 0
+    for obs in config['observations']:
+        obs_space = obs['obs space']
+        paths = [os.path.normpath(os.path.join(test_dir, path))
+                 for path in _as_list(obs_space['obsdatain'])]
+        paths, obs_bytes = _make_inputs(paths, copies, work_dir)
+        obs_space['obsdatain'] = paths if len(paths) > 1 else paths[0]
+        num_bytes += obs_bytes
+
+        for key in ['indexpath', 'tablecachepath', 'resultcachepath']:
+            obs_space.pop(key, None)
+
+        if 'obsdataout' in obs['ioda']:
+            out_name = os.path.basename(obs['ioda']['obsdataout'])
+            obs['ioda']['obsdataout'] = os.path.join(work_dir, 'out', out_name)
+
+    config_path = os.path.join(work_dir, os.path.basename(yaml_path))
+    with open(config_path, 'w') as config_file:
+        yaml.safe_dump(config, config_file, sort_keys=False)
+
+    return config_path, num_bytes
+
+
+def _run_once(command, run_dir):
+    """
+    Run bufr2ioda.x once.
+    :return: The wall seconds and the peak resident memory (MB) of the run.
+    """
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, cwd=run_dir)
+    _, status, usage = os.wait4(process.pid, 0)
+    wall_seconds = time.perf_counter() - start
+
+    # The process was reaped by wait4.
+    process.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+    if process.returncode != 0:
+        raise RuntimeError(f'{" ".join(command)} failed ({process.returncode}).')
+
+    # ru_maxrss is in KiB on Linux (bytes on macOS).
+    scale = 1 / (1024 * 1024) if sys.platform == 'darwin' else 1 / 1024
+    return wall_seconds, usage.ru_maxrss * scale
+
+
+def run_case(case, args, work_dir):
+    """
+    Convert the synthetic inputs of a config args.repeat times and keep the
+    fastest run (and the highest peak memory).
+    """
+    test_dir = os.path.dirname(os.path.abspath(args.testinput))
+    yaml_path = os.path.join(args.testinput, case)
+    config_path, num_bytes = _make_config(yaml_path, test_dir, args.copies, work_dir)
+    os.makedirs(os.path.join(work_dir, 'out'), exist_ok=True)
+
+    profile_path = os.path.join(work_dir, 'profile.json')
+    command = [args.bufr2ioda] + shlex.split(args.args) + \
+        ['--profile', profile_path, config_path]
+
+    wall_seconds = None
+    peak_rss_mb = 0.0
+    for _ in range(args.repeat):
+        run_seconds, run_rss_mb = _run_once(command, test_dir)
+        wall_seconds = run_seconds if wall_seconds is None else min(wall_seconds, run_seconds)
+        peak_rss_mb = max(peak_rss_mb, run_rss_mb)
+
+    with open(profile_path, 'r') as profile_file:
+        profile = json.load(profile_file)
+
+    subsets = profile['counters'].get('decode.subsets', 0)
+    return {
+        'wall_seconds': wall_seconds,
+        'subsets': subsets,
+        'subsets_per_second': subsets / wall_seconds,
+        'input_mb': num_bytes / (1024 * 1024),
+        'mb_per_second': num_bytes / (1024 * 1024) / wall_seconds,
+        'peak_rss_mb': peak_rss_mb,
+    }
+
+
+def compare(results, baseline, tolerance):
+    """
+    Compare the results with a baseline.
+    :return: The descriptions of the metrics that are worse than the baseline by more than
+             the tolerance (a fraction).
+    """
+    regressions = []
+    for case, metrics in results.items():
+        if case not in baseline:
+            print(f'{case}: not in the baseline')
+            continue
+
+        for metric, more_is_better in METRICS.items():
+            expected = baseline[case].get(metric)
+            if not expected:
+                continue
+
+            change = (metrics[metric] - expected) / expected
+            is_worse = -change > tolerance if more_is_better else change > tolerance
+            print(f'{case}: {metric} {metrics[metric]:.3f} (baseline {expected:.3f}, '
+                  f'{change:+.1%}){" REGRESSION" if is_worse else ""}')
+            if is_worse:
+                regressions.append(f'{case} {metric}')
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Measure the throughput of bufr2ioda.x on representative configs and '
+                    'compare it with a baseline.')
+    parser.add_argument('cases', nargs='*', default=DEFAULT_CASES,
+                        help='Configs (in the testinput directory) to run.')
+    parser.add_argument('--testinput', default='./testinput',
+                        help='The testinput directory (the paths of the configs are relative to '
+                             'its parent).')
+    parser.add_argument('--bufr2ioda', default='bufr2ioda.x', help='The bufr2ioda.x to run.')
+    parser.add_argument('--args', default='',
+                        help='More arguments for bufr2ioda.x (ex: "-t 4").')
+    parser.add_argument('--copies', type=int, default=10,
+                        help='The inputs are made of this many copies of the test files.')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='Runs of each config (the fastest is kept).')
+    parser.add_argument('--work-dir', help='Where to put the inputs and outputs (kept). A '
+                                           'temporary directory by default.')
+    parser.add_argument('-o', '--output', help='Write the results to this JSON file (ex: to '
+                                               'make a baseline).')
+    parser.add_argument('-b', '--baseline', help='Compare the results with this JSON file.')
+    parser.add_argument('--tolerance', type=float, default=0.1,
+                        help='How much worse than the baseline a metric can be (fraction).')
+    args = parser.parse_args()
+
+    bufr2ioda = shutil.which(args.bufr2ioda)
+    if bufr2ioda is None:
+        parser.error(f'Can\'t find {args.bufr2ioda}.')
+
+    # The conversions run in the test directory.
+    args.bufr2ioda = os.path.abspath(bufr2ioda)
+
+    work_dir = os.path.abspath(args.work_dir or tempfile.mkdtemp(prefix='bufr_throughput_'))
+    os.makedirs(work_dir, exist_ok=True)
+
+    try:
+        results = {}
+        for case in args.cases:
+            results[case] = run_case(case, args, work_dir)
+            result = results[case]
+            print(f'{case}: {result["wall_seconds"]:.3f}s, '
+                  f'{result["subsets_per_second"]:.0f} subsets/s, '
+                  f'{result["mb_per_second"]:.2f} MB/s, '
+                  f'{result["peak_rss_mb"]:.1f} MB peak RSS')
+    finally:
+        if not args.work_dir:
+            shutil.rmtree(work_dir, ignore_errors=True)
+
+    if args.output:
+        with open(args.output, 'w') as output_file:
+            json.dump(results, output_file, indent=2)
+
+    if args.baseline:
+        with open(args.baseline, 'r') as baseline_file:
+            baseline = json.load(baseline_file)
+
+        regressions = compare(results, baseline, args.tolerance)
+        if regressions:
+            print(f'{len(regressions)} regression(s): {", ".join(regressions)}')
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()